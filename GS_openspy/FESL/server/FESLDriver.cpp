@@ -49,7 +49,7 @@ namespace FESL {
 		gettimeofday(&m_server_start, NULL);
 
 		mp_mutex = OS::CreateMutex();
-		mp_thread = OS::CreateThread(Driver::TaskThread, this, true);
+		OS::TimerWheel::InitEntry(&m_reap_timer, Driver::OnReapTimer, this);
 
 		makeNonBlocking(m_sd);
 
@@ -118,6 +118,7 @@ namespace FESL {
 		}
 	}
 	Driver::~Driver() {
+		m_server->GetTimerWheel()->Cancel(&m_reap_timer);
 		std::vector<Peer *>::iterator it = m_connections.begin();
 		while (it != m_connections.end()) {
 			Peer *peer = *it;
@@ -126,7 +127,6 @@ namespace FESL {
 		}
 
 		delete mp_mutex;
-		delete mp_thread;
 
 		if(m_ssl_ctx)
 			SSL_CTX_free(m_ssl_ctx);
@@ -142,42 +142,52 @@ namespace FESL {
 			RSA_free(m_encrypted_login_info_key);
 		}
 	}
-	void *Driver::TaskThread(OS::CThread *thread) {
-		Driver *driver = (Driver *)thread->getParams();
-		for (;;) {
-			driver->mp_mutex->lock();
-			std::vector<Peer *>::iterator it = driver->m_connections.begin();
-			while (it != driver->m_connections.end()) {
-				Peer *peer = *it;
-				if (peer->ShouldDelete() && std::find(driver->m_peers_to_delete.begin(), driver->m_peers_to_delete.end(), peer) == driver->m_peers_to_delete.end()) {
-					//marked for delection, dec reference and delete when zero
-					it = driver->m_connections.erase(it);
-					peer->DecRef();
-
-					driver->m_server->UnregisterSocket(peer);
-
-					driver->m_stats_queue.push(peer->GetPeerStats());
-					driver->m_peers_to_delete.push_back(peer);
-					continue;
-				}
-				it++;
-			}
+	void Driver::OnPeerThink(INetPeer *inet_peer) {
+		Peer *peer = (Peer *)inet_peer;
+		mp_mutex->lock();
+		if (!peer->ShouldDelete()) {
+			peer->think(false);
+		}
+		if (peer->ShouldDelete()) {
+			DeletePeer(peer);
+		}
+		else {
+			peer->ScheduleThink(peer->GetThinkDelay());
+		}
+		mp_mutex->unlock();
+	}
+	void Driver::DeletePeer(Peer *peer) {
+		std::vector<Peer *>::iterator it = std::find(m_connections.begin(), m_connections.end(), peer);
+		if (it == m_connections.end()) {
+			return;
+		}
+		//marked for delection, dec reference and delete when zero
+		m_connections.erase(it);
+		peer->CancelThink();
+		peer->DecRef();
 
-			it = driver->m_peers_to_delete.begin();
-			while (it != driver->m_peers_to_delete.end()) {
-				FESL::Peer *p = *it;
-				if (p->GetRefCount() == 0) {
-					delete p;
-					it = driver->m_peers_to_delete.erase(it);
-					continue;
-				}
-				it++;
-			}
+		m_server->UnregisterSocket(peer);
 
-			driver->TickConnections();
-			driver->mp_mutex->unlock();
-			OS::Sleep(DRIVER_THREAD_TIME);
+		m_peers_to_delete.push_back(peer);
+		m_server->GetTimerWheel()->Schedule(&m_reap_timer, DRIVER_REAP_TIME, true);
+	}
+	void Driver::OnReapTimer(void *extra) {
+		Driver *driver = (Driver *)extra;
+		driver->mp_mutex->lock();
+		std::vector<Peer *>::iterator it = driver->m_peers_to_delete.begin();
+		while (it != driver->m_peers_to_delete.end()) {
+			FESL::Peer *p = *it;
+			if (p->GetRefCount() == 0) {
+				delete p;
+				it = driver->m_peers_to_delete.erase(it);
+				continue;
+			}
+			it++;
 		}
+		if (!driver->m_peers_to_delete.empty()) {
+			driver->m_server->GetTimerWheel()->Schedule(&driver->m_reap_timer, DRIVER_REAP_TIME, true);
+		}
+		driver->mp_mutex->unlock();
 	}
 	void Driver::think(bool listener_waiting) {
 		if (listener_waiting) {
@@ -193,6 +203,7 @@ namespace FESL {
 				mp_mutex->lock();
 				m_connections.push_back(mp_peer);
 				m_server->RegisterSocket(mp_peer);
+				mp_peer->ScheduleThink(mp_peer->GetThinkDelay());
 				mp_mutex->unlock();
 				//mp_peer->think(true);
 			}
@@ -281,51 +292,6 @@ namespace FESL {
 		return t;
 	}
 	
-	void Driver::TickConnections() {
-		std::vector<Peer *>::iterator it = m_connections.begin();
-		while (it != m_connections.end()) {
-			Peer *p = *it;
-			p->think(false);
-			it++;
-		}
-	}
-	OS::MetricInstance Driver::GetMetrics() {
-		OS::MetricInstance peer_metric;
-		OS::MetricValue arr_value2, value, peers;
-
-		mp_mutex->lock();
-
-		std::vector<Peer *>::iterator it = m_connections.begin();
-		while (it != m_connections.end()) {
-			INetPeer * peer = (INetPeer *)*it;
-			OS::Address address = *peer->getAddress();
-			value = peer->GetMetrics().value;
-
-			value.key = address.ToString(false);
-
-			peers.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, value));
-			it++;
-		}
-
-		while (!m_stats_queue.empty()) {
-			PeerStats stats = m_stats_queue.front();
-			m_stats_queue.pop();
-			peers.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, Peer::GetMetricItemFromStats(stats)));
-		}
-
-		peers.key = "peers";
-		arr_value2.type = OS::MetricType_Array;
-		peers.type = OS::MetricType_Array;
-		arr_value2.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, peers));
-
-
-		peer_metric.key = OS::Address(m_local_addr).ToString(false);
-		arr_value2.key = peer_metric.key;
-		peer_metric.value = arr_value2;
-
-		mp_mutex->unlock();
-		return peer_metric;
-	}
 	std::string Driver::decryptString(std::string input) {
 		std::string ret;
 		uint8_t *b64_out;
@@ -14,7 +14,7 @@
 #include <sys/time.h>
 #endif
 #include <openssl/ssl.h>
-#define DRIVER_THREAD_TIME 1000
+#define DRIVER_REAP_TIME 100 //how often deleted peers which are still referenced are checked on
 
 namespace FESL {
 	enum EFESLSSL_Type {
@@ -58,7 +58,8 @@ namespace FESL {
 
 		const std::vector<INetPeer *> getPeers(bool inc_ref = false);
 
-		OS::MetricInstance GetMetrics();
+
+		void OnPeerThink(INetPeer *peer);
 
 		SSL_CTX *getSSLCtx() { return m_ssl_ctx;  };
 
@@ -67,14 +68,13 @@ namespace FESL {
 
 		PublicInfo GetServerInfo() { return m_server_info; };
 	private:
-		static void *TaskThread(OS::CThread *thread);
-		void TickConnections();
+		static void OnReapTimer(void *extra);
+		void DeletePeer(Peer *peer);
 
 		int m_sd;
 		std::vector<FESL::Peer *> m_peers_to_delete;
 
 		//safe for now, until pointers one day get added
-		std::queue<PeerStats> m_stats_queue; //pending stats to be sent(deleted clients)
 
 		std::vector<Peer *> m_connections;
 		
@@ -82,8 +82,8 @@ namespace FESL {
 
 		struct timeval m_server_start;
 
+		OS::TimerWheelEntry m_reap_timer;
 		OS::CMutex *mp_mutex;
-		OS::CThread *mp_thread;
 
 		SSL_CTX *m_ssl_ctx;
 		RSA *m_encrypted_login_info_key;
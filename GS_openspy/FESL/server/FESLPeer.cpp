@@ -41,6 +41,7 @@ namespace FESL {
 		mp_mutex = OS::CreateMutex();
 		ResetMetrics();
 		gettimeofday(&m_last_ping, NULL);
+		gettimeofday(&m_last_recv, NULL);
 		if (driver->getSSLCtx() != NULL) {
 			m_ssl_ctx = SSL_new(driver->getSSLCtx());
 			SSL_set_fd(m_ssl_ctx, sd);
@@ -109,7 +110,7 @@ namespace FESL {
 			gettimeofday(&m_last_recv, NULL);
 			buf[len] = 0;
 
-			OS::KVReader kv_data(buf, '=', '\n');
+			OS::KVReader kv_data(std::string(buf), '=', '\n');
 			char *type;
 			for (int i = 0; i < sizeof(m_commands) / sizeof(CommandHandler); i++) {
 				if (Peer::m_commands[i].type == htonl(header.type)) {
@@ -138,6 +139,11 @@ namespace FESL {
 			m_delete_flag = true;
 		}
 	}
+	int Peer::GetThinkDelay() {
+		int delay = GetDelayUntil(m_last_ping, FESL_PING_TIME);
+		int timeout_delay = GetDelayUntil(m_last_recv, FESL_PING_TIME*2);
+		return delay < timeout_delay ? delay : timeout_delay;
+	}
 	void Peer::send_ping() {
 		//check for timeout
 		struct timeval current_time;
@@ -167,8 +173,8 @@ namespace FESL {
 			SSL_write(m_ssl_ctx, data.c_str(), data.length()+1);
 		}
 		else {
-			send(m_sd, (const char *)&header, sizeof(header), MSG_NOSIGNAL);
-			send(m_sd, data.c_str(), data.length() + 1, MSG_NOSIGNAL);
+			SendData(&header, sizeof(header));
+			SendData(data.c_str(), data.length() + 1);
 		}
 	}
 	void Peer::m_search_callback(OS::EProfileResponseType response_reason, std::vector<OS::Profile> results, std::map<int, OS::User> result_users, void *extra, INetPeer *peer) {
@@ -377,53 +383,6 @@ namespace FESL {
 		s << "errorCode=" << error << "\n";
 		SendPacket(type, s.str());
 	}
-	OS::MetricValue Peer::GetMetricItemFromStats(PeerStats stats) {
-		OS::MetricValue arr_value, value;
-		value.value._str = stats.m_address.ToString(false);
-		value.key = "ip";
-		value.type = OS::MetricType_String;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.disconnected;
-		value.key = "disconnected";
-		value.type = OS::MetricType_Integer;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.type = OS::MetricType_Integer;
-		value.value._int = stats.bytes_in;
-		value.key = "bytes_in";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.bytes_out;
-		value.key = "bytes_out";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.packets_in;
-		value.key = "packets_in";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.packets_out;
-		value.key = "packets_out";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.total_requests;
-		value.key = "pending_requests";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-		arr_value.type = OS::MetricType_Array;
-
-		value.type = OS::MetricType_String;
-		value.key = "gamename";
-		value.value._str = stats.from_game.gamename;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.type = OS::MetricType_Integer;
-		value.key = "version";
-		value.value._int = stats.version;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		arr_value.key = stats.m_address.ToString(false);
-		return arr_value;
-	}
 	void Peer::ResetMetrics() {
 		m_peer_stats.bytes_in = 0;
 		m_peer_stats.bytes_out = 0;
@@ -431,16 +390,6 @@ namespace FESL {
 		m_peer_stats.packets_out = 0;
 		m_peer_stats.total_requests = 0;
 	}
-	OS::MetricInstance Peer::GetMetrics() {
-		OS::MetricInstance peer_metric;
-
-		peer_metric.value = GetMetricItemFromStats(m_peer_stats);
-		peer_metric.key = "peer";
-
-		ResetMetrics();
-
-		return peer_metric;
-	}
 
 	bool Peer::m_acct_get_country_list(OS::KVReader kv_list) {
 		std::ostringstream s;
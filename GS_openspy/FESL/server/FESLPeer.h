@@ -121,6 +121,7 @@ namespace FESL {
 		~Peer();
 		
 		void think(bool packet_waiting);
+		int GetThinkDelay();
 		const struct sockaddr_in *getAddress() { return &m_address_info; }
 
 		int GetSocket() { return m_sd; };
@@ -130,9 +131,6 @@ namespace FESL {
 
 		void SendPacket(FESL_COMMAND_TYPE type, std::string data, int force_sequence = -1);
 
-		static OS::MetricValue GetMetricItemFromStats(PeerStats stats);
-		OS::MetricInstance GetMetrics();
-		PeerStats GetPeerStats() { if (m_delete_flag) m_peer_stats.disconnected = true; return m_peer_stats; };
 
 		void loginToSubAccount(std::string uniquenick);
 		void loginToPersona(std::string uniquenick);
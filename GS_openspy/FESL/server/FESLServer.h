@@ -11,9 +11,6 @@ namespace FESL {
 		void init();
 		void tick();
 		void shutdown();
-		OS::MetricInstance GetMetrics();
-	private:
-		struct timeval m_last_analytics_submit_time;
 	};
 }
 #endif //_SMSERVER_H
\ No newline at end of file
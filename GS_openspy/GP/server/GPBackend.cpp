@@ -15,30 +15,30 @@
 #include <sstream>
 
 #include <OS/Search/Profile.h>
-#include <curl/curl.h>
+#include <OS/HTTP.h>
+#include <OS/Analytics/Instrument.h>
 #include <jansson.h>
 
 namespace GPBackend {
-	struct curl_data {
-		std::string buffer;
-	};
-
 	OS::TaskPool<GPBackendRedisTask, GPBackendRedisRequest> *m_task_pool = NULL;
 	Redis::Connection *mp_redis_async_connection = NULL;
 	OS::CThread *mp_async_thread = NULL;
+	PresenceRouter *m_presence_router = NULL;
 	const char *gp_buddies_channel = "presence.buddies";
-	/* callback for curl fetch */
-	size_t curl_callback (void *contents, size_t size, size_t nmemb, void *userp) {
-		if (!contents) {
-			return 0;
-		}
-		size_t realsize = size * nmemb;                             /* calculate buffer size */
-		curl_data *data = (curl_data *)userp;
-		const char *p = (const char *)contents;
-		data->buffer += p;
-		return realsize;
-	}
 
+	static void DeliverStatusMessage(OS::KVReader &reader) {
+		GPShared::GPStatus status;
+		int profileid = reader.GetValueInt("profileid");
+		status.status = (GPShared::GPEnum)reader.GetValueInt("status");
+
+		status.status_str = reader.GetValue("status_string");
+		status.location_str = reader.GetValue("location_string");
+		status.quiet_flags = (GPShared::GPEnum)reader.GetValueInt("quiet_flags");
+		std::string ip = reader.GetValue("ip");
+		status.address.ip = htonl(inet_addr(OS::strip_quotes(ip).c_str()));
+		status.address.port = htons(reader.GetValueInt("port"));
+		m_presence_router->DeliverStatus(profileid, status);
+	}
 	void GPBackendRedisTask::onRedisMessage(Redis::Connection *c, Redis::Response reply, void *privdata) {
 		Redis::Value v = reply.values.front();
 
@@ -49,9 +49,19 @@ namespace GPBackend {
 		GP::Peer *peer = NULL;
 
 		if (v.type == Redis::REDIS_RESPONSE_TYPE_ARRAY) {
-			if (v.arr_value.values.size() == 3 && v.arr_value.values[2].first == Redis::REDIS_RESPONSE_TYPE_STRING) {
+			//the base channel is (re)subscribed each time the connection is made, the profile channels follow it
+			if (v.arr_value.values.size() == 3 && v.arr_value.values[2].first == Redis::REDIS_RESPONSE_TYPE_INTEGER) {
+				if (v.arr_value.values[0].second.value._str.compare("subscribe") == 0 && v.arr_value.values[1].second.value._str.compare(gp_buddies_channel) == 0) {
+					m_presence_router->OnSubscriberConnected(c);
+				}
+			}
+			else if (v.arr_value.values.size() == 3 && v.arr_value.values[2].first == Redis::REDIS_RESPONSE_TYPE_STRING) {
 
-				if (strcmp(v.arr_value.values[1].second.value._str.c_str(), gp_buddies_channel) == 0) {
+				if (strncmp(v.arr_value.values[1].second.value._str.c_str(), GP_STATUS_CHANNEL_PREFIX, sizeof(GP_STATUS_CHANNEL_PREFIX) - 1) == 0) {
+					OS::KVReader reader = v.arr_value.values[2].second.value._str;
+					DeliverStatusMessage(reader);
+				}
+				else if (strcmp(v.arr_value.values[1].second.value._str.c_str(), gp_buddies_channel) == 0) {
 					OS::KVReader reader = v.arr_value.values[2].second.value._str;
 					msg_type = reader.GetValue("type");
 					if (msg_type.compare("add_request") == 0) {
@@ -70,17 +80,8 @@ namespace GPBackend {
 							peer->send_authorize_add(from_profileid, reader.GetValueInt("silent"));
 						}
 					} else if (msg_type.compare("status_update") == 0) {
-						GPShared::GPStatus status;
-						from_profileid = reader.GetValueInt("profileid");
-						status.status = (GPShared::GPEnum)reader.GetValueInt("status");
-
-						status.status_str = reader.GetValue("status_string");
-						status.location_str = reader.GetValue("location_string");
-						status.quiet_flags = (GPShared::GPEnum)reader.GetValueInt("quiet_flags");
-						reason = reader.GetValue("ip");
-						status.address.ip = htonl(inet_addr(OS::strip_quotes(reason).c_str()));
-						status.address.port = htons(reader.GetValueInt("port"));
-						server->InformStatusUpdate(from_profileid, status);
+						//nodes which don't publish on the profile channels yet still broadcast here
+						DeliverStatusMessage(reader);
 					} else if (msg_type.compare("del_buddy") == 0) {
 						to_profileid = reader.GetValueInt("to_profileid");
 						from_profileid = reader.GetValueInt("from_profileid");
@@ -150,7 +151,7 @@ namespace GPBackend {
 		strncpy(req.uReqData.BuddyRequest.reason, reason.c_str(), len);
 		req.uReqData.BuddyRequest.reason[len] = 0;
 
-		m_task_pool->AddRequest(req);
+		m_task_pool->AddRequest(req, peer);
 	}
 	void GPBackendRedisTask::MakeDelBuddyRequest(GP::Peer *peer, int target) {
 		GPBackendRedisRequest req;
@@ -159,7 +160,7 @@ namespace GPBackend {
 		peer->IncRef();
 		req.uReqData.DelBuddy.from_profileid = peer->GetProfileID();
 		req.uReqData.DelBuddy.to_profileid = target;
-		m_task_pool->AddRequest(req);
+		m_task_pool->AddRequest(req, peer);
 	}
 	void GPBackendRedisTask::MakeRevokeAuthRequest(GP::Peer *peer, int target) {
 		GPBackendRedisRequest req;
@@ -168,7 +169,7 @@ namespace GPBackend {
 		peer->IncRef();
 		req.uReqData.DelBuddy.from_profileid = peer->GetProfileID();
 		req.uReqData.DelBuddy.to_profileid = target;
-		m_task_pool->AddRequest(req);
+		m_task_pool->AddRequest(req, peer);
 	}
 	void GPBackendRedisTask::MakeAuthorizeBuddyRequest(GP::Peer *peer, int target) {
 		GPBackendRedisRequest req;
@@ -177,24 +178,16 @@ namespace GPBackend {
 		peer->IncRef();
 		req.uReqData.AuthorizeAdd.from_profileid = peer->GetProfileID();
 		req.uReqData.AuthorizeAdd.to_profileid = target;
-		m_task_pool->AddRequest(req);
+		m_task_pool->AddRequest(req, peer);
 	}
 	void GPBackendRedisTask::SetPresenceStatus(int from_profileid, GPShared::GPStatus status, GP::Peer *peer) {
-		GPBackendRedisRequest req;
-		req.type = EGPRedisRequestType_UpdateStatus;
-		req.peer = peer;
-		peer->IncRef();
-		req.StatusInfo = status;
-		req.extra = (void *)peer;
-		m_task_pool->AddRequest(req);
+		m_presence_router->PublishStatus(peer, status);
 	}
 	void *GPBackendRedisTask::TaskThread(OS::CThread *thread) {
 		GPBackendRedisTask *task = (GPBackendRedisTask *)thread->getParams();
-		while (!task->m_request_list.empty() || task->mp_thread_poller->wait()) {
-			task->mp_mutex->lock();
-			while (!task->m_request_list.empty()) {
-				GPBackendRedisRequest task_params = task->m_request_list.front();
-				task->mp_mutex->unlock();
+		while (task->HasRequests() || task->mp_thread_poller->wait()) {
+			GPBackendRedisRequest task_params;
+			while (task->PopRequest(task_params)) {
 				switch (task_params.type) {
 				case EGPRedisRequestType_BuddyRequest:
 					task->Perform_BuddyRequest(task_params);
@@ -226,14 +219,9 @@ namespace GPBackend {
 					task->Perform_SendGPBuddyStatus(task_params);
 					break;
 				}
-
-				task->mp_mutex->lock();
 				if(task_params.peer)
 					task_params.peer->DecRef();
-				task->m_request_list.pop();
 			}
-
-			task->mp_mutex->unlock();
 		}
 		return NULL;
 	}
@@ -250,8 +238,8 @@ namespace GPBackend {
 		Redis::Command(mp_redis_connection, 0, "HSET status_%d port %d", profileid, request.StatusInfo.address.GetPort());
 		Redis::Command(mp_redis_connection, 0, "EXPIRE status_%d %d", profileid, GP_STATUS_EXPIRE_TIME);
 
-		Redis::Command(mp_redis_connection, 0, "PUBLISH %s '\\type\\status_update\\profileid\\%d\\status_string\\%s\\status\\%d\\location_string\\%s\\quiet_flags\\%d\\ip\\%s\\port\\%d'",
-		 gp_buddies_channel, profileid, request.StatusInfo.status_str.c_str(), request.StatusInfo.status, request.StatusInfo.location_str.c_str(),
+		Redis::Command(mp_redis_connection, 0, "PUBLISH " GP_STATUS_CHANNEL_PREFIX "%d '\\type\\status_update\\profileid\\%d\\status_string\\%s\\status\\%d\\location_string\\%s\\quiet_flags\\%d\\ip\\%s\\port\\%d'",
+		 profileid, profileid, request.StatusInfo.status_str.c_str(), request.StatusInfo.status, request.StatusInfo.location_str.c_str(),
 			request.StatusInfo.quiet_flags,ipinput.c_str(),request.StatusInfo.address.GetPort()); //TODO: escape this
 	}
 	void GPBackendRedisTask::Perform_BuddyRequest(GPBackendRedisRequest request) {
@@ -265,27 +253,15 @@ namespace GPBackend {
 			Redis::Command(mp_redis_connection, 0, "PUBLISH %s '\\type\\add_request\\from_profileid\\%d\\to_profileid\\%d'", gp_buddies_channel, request.uReqData.BuddyRequest.from_profileid, request.uReqData.BuddyRequest.to_profileid); //TODO: escape this
 	}
 	void GPBackendRedisTask::Perform_AuthorizeAdd(GPBackendRedisRequest request) {
-		curl_data recv_data;
 		json_t *send_obj = json_object();
 		json_object_set_new(send_obj, "mode", json_string("authorize_buddy_add"));
 		json_object_set_new(send_obj, "from_profileid", json_integer(request.uReqData.BuddyRequest.from_profileid));
 		json_object_set_new(send_obj, "to_profileid", json_integer(request.uReqData.BuddyRequest.to_profileid));
 
 
-		CURL *curl = curl_easy_init();
-		CURLcode res;
-		bool success = false;
-
 		char *json_data = json_dumps(send_obj, 0);
 
-		const char *server_response = NULL;
-
-
-
-		if(curl) {
-			ProfileReq_InitCurl(curl, json_data, (void *)&recv_data);
-			res = curl_easy_perform(curl);
-		}
+		ProfileReq_Post(json_data, request.peer);
 
 		if(json_data)
 			free((void *)json_data);
@@ -295,7 +271,6 @@ namespace GPBackend {
 
 	}
 	void GPBackendRedisTask::Perform_DelBuddy(GPBackendRedisRequest request) {
-		curl_data recv_data;
 		json_t *send_obj = json_object();
 		json_object_set_new(send_obj, "mode", json_string("del_buddy"));
 		json_object_set_new(send_obj, "from_profileid", json_integer(request.uReqData.BuddyRequest.from_profileid));
@@ -303,17 +278,9 @@ namespace GPBackend {
 		json_object_set_new(send_obj, "send_revoke", request.type == EGPRedisRequestType_RevokeAuth ? json_true() : json_false());
 
 
-		CURL *curl = curl_easy_init();
-		CURLcode res;
-		bool success = false;
-
 		char *json_data = json_dumps(send_obj, 0);
 
-
-		if(curl) {
-			ProfileReq_InitCurl(curl, json_data, (void *)&recv_data);
-			res = curl_easy_perform(curl);
-		}
+		ProfileReq_Post(json_data, request.peer);
 
 		if(json_data)
 			free((void *)json_data);
@@ -328,27 +295,18 @@ namespace GPBackend {
 		req.extra = (void *)peer;
 		req.peer = peer;
 		peer->IncRef();
-		m_task_pool->AddRequest(req);
+		m_task_pool->AddRequest(req, peer);
 
 	}
 	void GPBackendRedisTask::Perform_SendLoginEvent(GPBackendRedisRequest request) {
-		curl_data recv_data;
 		json_t *send_obj = json_object();
 		json_object_set_new(send_obj, "mode", json_string("send_presence_login_messages"));
 		json_object_set_new(send_obj, "profileid", json_integer(request.peer->GetProfileID()));
 
 
-		CURL *curl = curl_easy_init();
-		CURLcode res;
-		bool success = false;
-
 		char *json_data = json_dumps(send_obj, 0);
 
-
-		if(curl) {
-			ProfileReq_InitCurl(curl, json_data, (void *)&recv_data);
-			res = curl_easy_perform(curl);
-		}
+		ProfileReq_Post(json_data, request.peer);
 		if(json_data)
 			free((void *)json_data);
 
@@ -373,10 +331,9 @@ namespace GPBackend {
 
 		req.uReqData.BuddyMessage.type = msg_type;
 
-		m_task_pool->AddRequest(req);
+		m_task_pool->AddRequest(req, peer);
 	}
 	void GPBackendRedisTask::Perform_SendBuddyMessage(GPBackendRedisRequest request) {
-		curl_data recv_data;
 		json_t *send_obj = json_object();
 		json_object_set_new(send_obj, "mode", json_string("send_buddy_message"));
 		json_object_set_new(send_obj, "to_profileid", json_integer(request.uReqData.BuddyMessage.to_profileid));
@@ -385,17 +342,9 @@ namespace GPBackend {
 		json_object_set_new(send_obj, "message", json_string(request.uReqData.BuddyMessage.message));
 
 
-		CURL *curl = curl_easy_init();
-		CURLcode res;
-		bool success = false;
-
 		char *json_data = json_dumps(send_obj, 0);
 
-
-		if(curl) {
-			ProfileReq_InitCurl(curl, json_data, (void *)&recv_data);
-			res = curl_easy_perform(curl);
-		}
+		ProfileReq_Post(json_data, request.peer);
 
  		if(json_data)
 			free((void *)json_data);
@@ -411,7 +360,7 @@ namespace GPBackend {
 		req.peer = peer;
 		req.uReqData.BlockMessage.from_profileid = peer->GetProfileID();
 		req.uReqData.BlockMessage.to_profileid = block_id;
-		m_task_pool->AddRequest(req);
+		m_task_pool->AddRequest(req, peer);
 	}
 	void GPBackendRedisTask::MakeRemoveBlockRequest(GP::Peer *peer, int block_id) {
 		GPBackendRedisRequest req;
@@ -420,26 +369,18 @@ namespace GPBackend {
 		req.peer = peer;
 		req.uReqData.BlockMessage.from_profileid = peer->GetProfileID();
 		req.uReqData.BlockMessage.to_profileid = block_id;
-		m_task_pool->AddRequest(req);
+		m_task_pool->AddRequest(req, peer);
 	}
 	void GPBackendRedisTask::Perform_BlockBuddy(GPBackendRedisRequest request) {
-		curl_data recv_data;
 		json_t *send_obj = json_object();
 		json_object_set_new(send_obj, "mode", json_string("block_buddy"));
 		json_object_set_new(send_obj, "to_profileid", json_integer(request.uReqData.BuddyRequest.to_profileid));
 		json_object_set_new(send_obj, "from_profileid", json_integer(request.uReqData.BuddyRequest.from_profileid));
 
 
-		CURL *curl = curl_easy_init();
-		CURLcode res;
-		bool success = false;
-
 		char *json_data = json_dumps(send_obj, 0);
 
-		if(curl) {
-			ProfileReq_InitCurl(curl, json_data, (void *)&recv_data);
-			res = curl_easy_perform(curl);
-		}
+		ProfileReq_Post(json_data, request.peer);
 
 		if(json_data)
 			free((void *)json_data);
@@ -448,23 +389,15 @@ namespace GPBackend {
 			json_decref(send_obj);
 	}
 	void GPBackendRedisTask::Perform_DelBuddyBlock(GPBackendRedisRequest request) {
-		curl_data recv_data;
 		json_t *send_obj = json_object();
 		json_object_set_new(send_obj, "mode", json_string("del_block_buddy"));
 		json_object_set_new(send_obj, "to_profileid", json_integer(request.uReqData.BuddyRequest.to_profileid));
 		json_object_set_new(send_obj, "from_profileid", json_integer(request.uReqData.BuddyRequest.from_profileid));
 
 
-		CURL *curl = curl_easy_init();
-		CURLcode res;
-		bool success = false;
-
 		char *json_data = json_dumps(send_obj, 0);
 
-		if(curl) {
-			ProfileReq_InitCurl(curl, json_data, (void *)&recv_data);
-			res = curl_easy_perform(curl);
-		}
+		ProfileReq_Post(json_data, request.peer);
 
 		if(json_data)
 			free((void *)json_data);
@@ -544,37 +477,16 @@ namespace GPBackend {
 
 	}
 	void GPBackendRedisTask::Perform_SendGPBuddyStatus(GPBackendRedisRequest request) {
-		curl_data recv_data;
 		json_t *send_obj = json_object();
 		json_object_set_new(send_obj, "mode", request.type == EGPRedisRequestType_SendGPBuddyStatus ? json_string("get_buddies_status") : json_string("get_blocks_status"));
 		json_object_set_new(send_obj, "profileid", json_integer(request.peer->GetProfileID()));
 
 
-		CURL *curl = curl_easy_init();
-		CURLcode res;
-		bool success = false;
-
 		char *json_data = json_dumps(send_obj, 0);
 
-		if(curl) {
-			ProfileReq_InitCurl(curl, json_data, (void *)&recv_data);
-
-			res = curl_easy_perform(curl);
-
-			json_t *root = json_loads(recv_data.buffer.c_str(), 0, NULL);
-
-			json_t *status_array = json_object_get(root, "statuses");
-			if(status_array) {
-				int num_items = json_array_size(status_array);
-				for(int i=0;i<num_items;i++) {
-					json_t *status = json_array_get(status_array, i);
-					load_and_send_gpstatus(request.peer, status);
-				}
-			}
-
-			json_decref(root);
-
-		}
+		//released once the statuses have been sent
+		request.peer->IncRef();
+		ProfileReq_Post(json_data, request.peer, OnGPBuddyStatusResponse, request.peer);
 
 		if(json_data)
 			free((void *)json_data);
@@ -582,30 +494,28 @@ namespace GPBackend {
 		if(send_obj)
 			json_decref(send_obj);
 	}
-	void GPBackendRedisTask::ProfileReq_InitCurl(void *curl, char *post_data, void *write_data) {
-		struct curl_slist *chunk = NULL;
-		std::string apiKey = "APIKey: " + std::string(OS::g_webServicesAPIKey);
-		chunk = curl_slist_append(chunk, apiKey.c_str());
-		chunk = curl_slist_append(chunk, "Content-Type: application/json");
-		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, chunk);
-
-		curl_easy_setopt(curl, CURLOPT_URL, OPENSPY_PROFILEMGR_URL);
-		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, post_data);
+	void GPBackendRedisTask::OnGPBuddyStatusResponse(OS::HTTPResponse response, void *extra) {
+		GP::Peer *peer = (GP::Peer *)extra;
 
-		/* set default user agent */
-		curl_easy_setopt(curl, CURLOPT_USERAGENT, "OSGPBackendRedisTask");
+		json_t *root = json_loads(response.buffer.c_str(), 0, NULL);
 
-		/* set timeout */
-		curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5);
-
-		/* enable location redirects */
-		curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
+		json_t *status_array = json_object_get(root, "statuses");
+		if(status_array) {
+			int num_items = json_array_size(status_array);
+			for(int i=0;i<num_items;i++) {
+				json_t *status = json_array_get(status_array, i);
+				load_and_send_gpstatus(peer, status);
+			}
+		}
 
-		/* set maximum allowed redirects */
-		curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 1);
+		if(root)
+			json_decref(root);
 
-		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_callback);
-		curl_easy_setopt(curl, CURLOPT_WRITEDATA, write_data);
+		peer->DecRef();
+	}
+	void GPBackendRedisTask::ProfileReq_Post(const char *post_data, GP::Peer *peer, OS::HTTPCallback callback, void *extra) {
+		OS::HTTPClient client(OPENSPY_PROFILEMGR_URL, "OSGPBackendRedisTask");
+		client.PostAsync(post_data ? post_data : "", callback, extra, peer);
 	}
 	void GPBackendRedisTask::AddDriver(GP::Driver *driver) {
 		if (std::find(m_drivers.begin(), m_drivers.end(), driver) == m_drivers.end()) {
@@ -634,14 +544,21 @@ namespace GPBackend {
 		t.tv_usec = 0;
 		t.tv_sec = 60;
 
+		m_presence_router = new PresenceRouter(server);
 		mp_async_thread = OS::CreateThread(setup_redis_async, server, true);
 		OS::Sleep(200);
 
-		m_task_pool = new OS::TaskPool<GPBackendRedisTask, GPBackendRedisRequest>(NUM_PRESENCE_THREADS);
+		m_task_pool = new OS::TaskPool<GPBackendRedisTask, GPBackendRedisRequest>(NUM_PRESENCE_THREADS, OS::ETaskDispatch_Affinity);
 		server->SetTaskPool(m_task_pool);
+
+		OS::InstrumentRegistry::getSingleton()->AddCollector("gp_backend", m_task_pool);
+		OS::InstrumentRegistry::getSingleton()->AddCollector("gp_presence", m_presence_router);
 	}
 
 	void ShutdownTaskPool() {
+		OS::InstrumentRegistry::getSingleton()->RemoveCollectors(m_task_pool);
+		OS::InstrumentRegistry::getSingleton()->RemoveCollectors(m_presence_router);
+		delete m_presence_router;
 		delete m_task_pool;
 	}
 }
@@ -4,6 +4,8 @@
 #include <OS/OpenSpy.h>
 #include <OS/Redis.h>
 #include <OS/GPShared.h>
+#include <OS/HTTP.h>
+#include "GPPresence.h"
 
 #define GP_BACKEND_REDIS_DB 5
 #define BUDDY_ADDREQ_EXPIRETIME 604800
@@ -112,8 +114,10 @@ namespace GPBackend {
 			void Perform_DelBuddyBlock(GPBackendRedisRequest request);
 			void Perform_SendGPBuddyStatus(GPBackendRedisRequest request);
 
-			void load_and_send_gpstatus(GP::Peer *peer, json_t *json);
-			void ProfileReq_InitCurl(void *curl, char *post_data, void *write_data);
+			static void OnGPBuddyStatusResponse(OS::HTTPResponse response, void *extra);
+			static void load_and_send_gpstatus(GP::Peer *peer, json_t *json);
+			//posts are sent in order per peer, callback is called on the HTTP engine thread
+			static void ProfileReq_Post(const char *post_data, GP::Peer *peer, OS::HTTPCallback callback = NULL, void *extra = NULL);
 
 			Redis::Connection *mp_redis_connection;
 			std::vector<GP::Driver *> m_drivers;
@@ -121,6 +125,7 @@ namespace GPBackend {
 	};
 	#define NUM_PRESENCE_THREADS 8
 	extern OS::TaskPool<GPBackendRedisTask, GPBackendRedisRequest> *m_task_pool;
+	extern PresenceRouter *m_presence_router;
 	void SetupTaskPool(GP::Server *server);
 	void ShutdownTaskPool();
 	void *setup_redis_async(OS::CThread *thread);
@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include "../main.h"
 #include <OS/Net/NetDriver.h>
+#include <OS/Net/NetPeerIndex.h>
 
 #include "GPPeer.h"
 
@@ -17,7 +18,7 @@
 #include <OS/GPShared.h>
 
 #define GP_PING_TIME (600)
-#define DRIVER_THREAD_TIME 1000
+#define DRIVER_REAP_TIME 100 //how often deleted peers which are still referenced are checked on
 namespace GP {
 	class Peer;
 	class Driver;
@@ -36,29 +37,29 @@ namespace GP {
 
 		Peer *FindPeerByProfileID(int profileid);
 
-		void InformStatusUpdate(int from_profileid, GPShared::GPStatus status);
 
 		int GetNumConnections();
 		const std::vector<int> getSockets();
 		const std::vector<INetPeer *> getPeers(bool inc_ref = false);
-		OS::MetricInstance GetMetrics();
+
+		void OnPeerThink(INetPeer *peer);
 	private:
-		static void *TaskThread(OS::CThread *thread);
-		void TickConnections();
+		static void OnReapTimer(void *extra);
+		void DeletePeer(Peer *peer);
 
 		int m_sd;
 
 		std::vector<Peer *> m_connections;
+		NetPeerIndex<Peer> m_peer_index;
 		
 		struct sockaddr_in m_local_addr;
 
 		struct timeval m_server_start;
 
-		std::queue<PeerStats> m_stats_queue; //pending stats to be sent(deleted clients)
 
 		std::vector<GP::Peer *> m_peers_to_delete;
+		OS::TimerWheelEntry m_reap_timer;
 		OS::CMutex *mp_mutex;
-		OS::CThread *mp_thread;
 	};
 }
 #endif //_SBDRIVER_H
\ No newline at end of file
@@ -57,13 +57,9 @@ namespace GP {
 		delete mp_mutex;
 	}
 	void Peer::Delete() {
-		GPBackend::GPBackendRedisRequest req;
-		req.type = GPBackend::EGPRedisRequestType_UpdateStatus;
-		req.peer = this;
-		req.peer->IncRef();
-		req.StatusInfo = GPShared::gp_default_status;
-		req.extra = (void *)req.peer;
-		GPBackend::m_task_pool->AddRequest(req);
+		if (m_profile.id != 0) {
+			GPBackend::GPBackendRedisTask::SetPresenceStatus(m_profile.id, GPShared::gp_default_status, this);
+		}
 
 		m_delete_flag = true;
 	}
@@ -113,8 +109,13 @@ namespace GP {
 			Delete();
 		}
 	}
+	int Peer::GetThinkDelay() {
+		int delay = GetDelayUntil(m_last_ping, GP_PING_TIME);
+		int timeout_delay = GetDelayUntil(m_last_recv, GP_PING_TIME*2);
+		return delay < timeout_delay ? delay : timeout_delay;
+	}
 	void Peer::handle_packet(char *data, int len) {
-		OS::KVReader data_parser = OS::KVReader(std::string(data));
+		OS::KVReader data_parser(data, len);
 		gettimeofday(&m_last_recv, NULL);
 		if (data_parser.Size() < 1) {
 			struct timeval current_time;
@@ -128,59 +129,92 @@ namespace GP {
 			//send_error(GPShared::GP_PARSE);
 			return;
 		}
-		std::string command = data_parser.GetKeyByIdx(0);
-
-		// OS::KVReader data_parser
 
-		if(!command.compare("login")) {
-			handle_login(data_parser);
-			return;
-		} else if(!command.compare("ka")) {
-			handle_keepalive(data_parser);
-			return;
-		} else if (command.compare("logout") == 0) {
-			Delete();
-			return;
+		switch(data_parser.GetKeyHashByIdx(0)) {
+			case OS::KVHash("login"):
+				if (data_parser.IsKeyByIdx(0, "login"))
+					handle_login(data_parser);
+				return;
+			case OS::KVHash("ka"):
+				if (data_parser.IsKeyByIdx(0, "ka"))
+					handle_keepalive(data_parser);
+				return;
+			case OS::KVHash("logout"):
+				if (data_parser.IsKeyByIdx(0, "logout"))
+					Delete();
+				return;
+			case OS::KVHash("newuser"):
+				if (data_parser.IsKeyByIdx(0, "newuser"))
+					handle_newuser(data_parser);
+				return;
 		}
-		else if (command.compare("newuser") == 0) {
-			handle_newuser(data_parser);
+		if(m_backend_session_key.length() == 0) {
 			return;
 		}
-		if(m_backend_session_key.length() > 0) {
-			if(command.compare("status") == 0) {
-				handle_status(data_parser);
-			} else if(command.compare("addbuddy") == 0) {
-				handle_addbuddy(data_parser);
-			} else if(command.compare("delbuddy") == 0) {
-				handle_delbuddy(data_parser);
-			} else if(command.compare("addblock") == 0) {
-				handle_addblock(data_parser);
-			} else if(command.compare("removeblock") == 0) {
-				handle_removeblock(data_parser);
-			} else if(command.compare("revoke") == 0) {
-				handle_revoke(data_parser);
-			} else if(command.compare("authadd") == 0) {
-				handle_authadd(data_parser);
-			} else if(command.compare("getprofile") == 0) {
-				handle_getprofile(data_parser);
-			} else if(command.compare("bm") == 0) {
-				handle_bm(data_parser);
-			} else if(command.compare("pinvite") == 0) {
-				handle_pinvite(data_parser);
-			} else if(command.compare("newprofile") == 0) {
-				handle_newprofile(data_parser);
-			} else if(command.compare("delprofile") == 0) {
-				handle_delprofile(data_parser);
-			} else if(command.compare("registernick") == 0) {
-				handle_registernick(data_parser);
-			} else if(command.compare("registercdkey") == 0) {
-				handle_registercdkey(data_parser);
-			} else if(command.compare("updatepro") == 0) {
-				handle_updatepro(data_parser);
-			}
+		switch(data_parser.GetKeyHashByIdx(0)) {
+			case OS::KVHash("status"):
+				if (data_parser.IsKeyByIdx(0, "status"))
+					handle_status(data_parser);
+				break;
+			case OS::KVHash("addbuddy"):
+				if (data_parser.IsKeyByIdx(0, "addbuddy"))
+					handle_addbuddy(data_parser);
+				break;
+			case OS::KVHash("delbuddy"):
+				if (data_parser.IsKeyByIdx(0, "delbuddy"))
+					handle_delbuddy(data_parser);
+				break;
+			case OS::KVHash("addblock"):
+				if (data_parser.IsKeyByIdx(0, "addblock"))
+					handle_addblock(data_parser);
+				break;
+			case OS::KVHash("removeblock"):
+				if (data_parser.IsKeyByIdx(0, "removeblock"))
+					handle_removeblock(data_parser);
+				break;
+			case OS::KVHash("revoke"):
+				if (data_parser.IsKeyByIdx(0, "revoke"))
+					handle_revoke(data_parser);
+				break;
+			case OS::KVHash("authadd"):
+				if (data_parser.IsKeyByIdx(0, "authadd"))
+					handle_authadd(data_parser);
+				break;
+			case OS::KVHash("getprofile"):
+				if (data_parser.IsKeyByIdx(0, "getprofile"))
+					handle_getprofile(data_parser);
+				break;
+			case OS::KVHash("bm"):
+				if (data_parser.IsKeyByIdx(0, "bm"))
+					handle_bm(data_parser);
+				break;
+			case OS::KVHash("pinvite"):
+				if (data_parser.IsKeyByIdx(0, "pinvite"))
+					handle_pinvite(data_parser);
+				break;
+			case OS::KVHash("newprofile"):
+				if (data_parser.IsKeyByIdx(0, "newprofile"))
+					handle_newprofile(data_parser);
+				break;
+			case OS::KVHash("delprofile"):
+				if (data_parser.IsKeyByIdx(0, "delprofile"))
+					handle_delprofile(data_parser);
+				break;
+			case OS::KVHash("registernick"):
+				if (data_parser.IsKeyByIdx(0, "registernick"))
+					handle_registernick(data_parser);
+				break;
+			case OS::KVHash("registercdkey"):
+				if (data_parser.IsKeyByIdx(0, "registercdkey"))
+					handle_registercdkey(data_parser);
+				break;
+			case OS::KVHash("updatepro"):
+				if (data_parser.IsKeyByIdx(0, "updatepro"))
+					handle_updatepro(data_parser);
+				break;
 		}
 	}
-	void Peer::handle_newuser(OS::KVReader data_parser) {
+	void Peer::handle_newuser(OS::KVReader &data_parser) {
 		std::string nick;
 		std::string uniquenick;
 		std::string email;
@@ -281,7 +315,7 @@ namespace GP {
 	/*
 		Updates profile specific information
 	*/
-	void Peer::handle_updatepro(OS::KVReader data_parser) {
+	void Peer::handle_updatepro(OS::KVReader &data_parser) {
 		bool send_userupdate = false;
 
 		//OS::KVReader data_parser = OS::KVReader(std::string(data));
@@ -336,7 +370,7 @@ namespace GP {
 			OS::m_user_search_task_pool->AddRequest(user_request);
 		}
 	}
-	void Peer::handle_updateui(OS::KVReader data_parser) {
+	void Peer::handle_updateui(OS::KVReader &data_parser) {
 		char buff[GP_STATUS_STRING_LEN + 1];
 		OS::UserSearchRequest request;
 
@@ -372,10 +406,10 @@ namespace GP {
 		request.search_params = m_user;
 		OS::m_user_search_task_pool->AddRequest(request);
 	}
-	void Peer::handle_registernick(OS::KVReader data_parser) {
+	void Peer::handle_registernick(OS::KVReader &data_parser) {
 		
 	}
-	void Peer::handle_registercdkey(OS::KVReader data_parser) {
+	void Peer::handle_registercdkey(OS::KVReader &data_parser) {
 
 	}
 	void Peer::m_create_profile_callback(OS::EProfileResponseType response_reason, std::vector<OS::Profile> results, std::map<int, OS::User> result_users, void *extra, INetPeer *peer) {
@@ -383,7 +417,7 @@ namespace GP {
 			OS::Profile profile = results.front();
 		}
 	}
-	void Peer::handle_newprofile(OS::KVReader data_parser) {
+	void Peer::handle_newprofile(OS::KVReader &data_parser) {
 		OS::ProfileSearchRequest request;
 		int replace = data_parser.GetValueInt("replace");
 		std::string nick, oldnick;
@@ -407,7 +441,7 @@ namespace GP {
 		s << "\\dpr\\" << (int)(response_reason == OS::EProfileResponseType_Success);
 		((GP::Peer *)peer)->SendPacket((const uint8_t *)s.str().c_str(),s.str().length());
 	}
-	void Peer::handle_delprofile(OS::KVReader data_parser) {
+	void Peer::handle_delprofile(OS::KVReader &data_parser) {
 		OS::ProfileSearchRequest request;
 		request.profile_search_details.id = m_profile.id;
 		request.extra = this;
@@ -417,7 +451,7 @@ namespace GP {
 		request.callback = Peer::m_delete_profile_callback;
 		OS::m_profile_search_task_pool->AddRequest(request);
 	}
-	void Peer::handle_login(OS::KVReader data_parser) {
+	void Peer::handle_login(OS::KVReader &data_parser) {
 		char gamename[33 + 1];
 		
 		int partnercode = data_parser.GetValueInt("partnerid");
@@ -466,7 +500,7 @@ namespace GP {
 			perform_uniquenick_auth(uniquenick.c_str(), partnercode, namespaceid, m_challenge, challenge.c_str(), response.c_str(), operation_id, this);
 		}
 	}
-	void Peer::handle_pinvite(OS::KVReader data_parser) {
+	void Peer::handle_pinvite(OS::KVReader &data_parser) {
 		//profileid\10000\productid\1
 		std::ostringstream s;
 		//OS::KVReader data_parser = OS::KVReader(std::string(data));
@@ -484,7 +518,7 @@ namespace GP {
 		s << "|signed|d41d8cd98f00b204e9800998ecf8427e"; //temp until calculation fixed
 		GPBackend::GPBackendRedisTask::SendMessage(this, profileid, GPI_BM_INVITE, s.str().c_str());
 	}
-	void Peer::handle_status(OS::KVReader data_parser) {
+	void Peer::handle_status(OS::KVReader &data_parser) {
 		//OS::KVReader data_parser = OS::KVReader(std::string(data));
 		if (data_parser.HasKey("status")) {
 			m_status.status = (GPEnum)data_parser.GetValueInt("status");
@@ -498,10 +532,10 @@ namespace GP {
 
 		GPBackend::GPBackendRedisTask::SetPresenceStatus(m_profile.id, m_status, this);
 	}
-	void Peer::handle_statusinfo(OS::KVReader data_parser) {
+	void Peer::handle_statusinfo(OS::KVReader &data_parser) {
 
 	}
-	void Peer::handle_addbuddy(OS::KVReader data_parser) {
+	void Peer::handle_addbuddy(OS::KVReader &data_parser) {
 		//OS::KVReader data_parser = OS::KVReader(std::string(data));
 		int newprofileid = 0;
 		std::string reason;
@@ -555,6 +589,7 @@ namespace GP {
 
 				if(((GP::Peer *)peer)->m_buddies.find(p.id) == ((GP::Peer *)peer)->m_buddies.end())
 					((GP::Peer *)peer)->m_buddies[p.id] = GPShared::gp_default_status;
+				GPBackend::m_presence_router->AddWatch((GP::Peer *)peer, p.id);
 
 				it++;
 			}
@@ -578,6 +613,7 @@ namespace GP {
 				OS::Profile p = *it;
 				s << p.id << ",";
 				((GP::Peer *)peer)->m_blocks.push_back(p.id);
+				GPBackend::m_presence_router->AddWatch((GP::Peer *)peer, p.id);
 				it++;
 			}
 			str = s.str();
@@ -614,12 +650,15 @@ namespace GP {
 		request.callback = Peer::m_block_list_lookup_callback;
 		OS::m_profile_search_task_pool->AddRequest(request);
 	}
-	void Peer::handle_delbuddy(OS::KVReader data_parser) {
+	void Peer::handle_delbuddy(OS::KVReader &data_parser) {
 		if (data_parser.HasKey("delprofileid")) {
 			int delprofileid = data_parser.GetValueInt("delprofileid");
 			if (m_buddies.find(delprofileid) != m_buddies.end()) {
 				GPBackend::GPBackendRedisTask::MakeDelBuddyRequest(this, delprofileid);
 				m_buddies.erase(delprofileid);
+				if (std::find(m_blocks.begin(), m_blocks.end(), delprofileid) == m_blocks.end()) {
+					GPBackend::m_presence_router->RemoveWatch(this, delprofileid);
+				}
 			}
 		}
 		else {
@@ -627,7 +666,7 @@ namespace GP {
 			return;
 		}
 	}
-	void Peer::handle_revoke(OS::KVReader data_parser) {
+	void Peer::handle_revoke(OS::KVReader &data_parser) {
 		if (data_parser.HasKey("profileid")) {
 			int delprofileid = data_parser.GetValueInt("profileid");
 			GPBackend::GPBackendRedisTask::MakeRevokeAuthRequest(this, delprofileid);
@@ -637,7 +676,7 @@ namespace GP {
 		}
 
 	}
-	void Peer::handle_authadd(OS::KVReader data_parser) {
+	void Peer::handle_authadd(OS::KVReader &data_parser) {
 		if (data_parser.HasKey("fromprofileid")) {
 			int fromprofileid = data_parser.GetValueInt("fromprofileid");
 			GPBackend::GPBackendRedisTask::MakeAuthorizeBuddyRequest(this, fromprofileid);
@@ -673,6 +712,7 @@ namespace GP {
 		}
 
 		m_buddies[profileid] = GPShared::gp_default_status;
+		GPBackend::m_presence_router->AddWatch(this, profileid);
 
 		refresh_buddy_list();
 
@@ -699,7 +739,7 @@ namespace GP {
 		s << "\\msg\\" << msg;
 		SendPacket((const uint8_t *)s.str().c_str(),s.str().length());
 	}
-	void Peer::handle_getprofile(OS::KVReader data_parser) {
+	void Peer::handle_getprofile(OS::KVReader &data_parser) {
 		OS::ProfileSearchRequest request;
 		//OS::KVReader data_parser = OS::KVReader(std::string(data));
 		if (data_parser.HasKey("profileid") && data_parser.HasKey("id")) {
@@ -714,32 +754,46 @@ namespace GP {
 			OS::m_profile_search_task_pool->AddRequest(request);
 		}
 	}
-	void Peer::handle_addblock(OS::KVReader data_parser) {
+	void Peer::handle_addblock(OS::KVReader &data_parser) {
 		if (data_parser.HasKey("profileid")) {
 			int profileid = data_parser.GetValueInt("profileid");
 			GPBackend::GPBackendRedisTask::MakeBlockRequest(this, profileid);
+			mp_mutex->lock();
+			if (std::find(m_blocks.begin(), m_blocks.end(), profileid) == m_blocks.end()) {
+				m_blocks.push_back(profileid);
+			}
+			mp_mutex->unlock();
+			GPBackend::m_presence_router->AddWatch(this, profileid);
 		} else {
 			send_error(GPShared::GP_PARSE);
 			return;
 		}
 		
 	}
-	void Peer::handle_removeblock(OS::KVReader data_parser) {
+	void Peer::handle_removeblock(OS::KVReader &data_parser) {
 		//OS::KVReader data_parser = OS::KVReader(std::string(data));
 		if (data_parser.HasKey("profileid")) {
 			int profileid = data_parser.GetValueInt("profileid");
 			GPBackend::GPBackendRedisTask::MakeRemoveBlockRequest(this, profileid);
+			mp_mutex->lock();
+			m_blocks.erase(std::remove(m_blocks.begin(), m_blocks.end(), profileid), m_blocks.end());
+			bool is_buddy = m_buddies.find(profileid) != m_buddies.end();
+			mp_mutex->unlock();
+			//still watched while it's a buddy
+			if (!is_buddy) {
+				GPBackend::m_presence_router->RemoveWatch(this, profileid);
+			}
 		}  else {
 			send_error(GPShared::GP_PARSE);
 			return;
 		}
 	}
-	void Peer::handle_keepalive(OS::KVReader data_parser) {
+	void Peer::handle_keepalive(OS::KVReader &data_parser) {
 		//std::ostringstream s;
 		//s << "\\ka\\";
 		//SendPacket((const uint8_t *)s.str().c_str(),s.str().length());
 	}
-	void Peer::handle_bm(OS::KVReader data_parser) {
+	void Peer::handle_bm(OS::KVReader &data_parser) {
 		char msg[GP_REASON_LEN+1];
 
 
@@ -875,8 +929,7 @@ namespace GP {
 		if(attach_final) {
 			buffer.WriteBuffer((void *)"\\final\\", 7);
 		}
-		int c = send(m_sd, (const char *)buffer.GetHead(), buffer.size(), MSG_NOSIGNAL);
-		if(c < 0) {
+		if(!SendData(buffer.GetHead(), buffer.size())) {
 			Delete();
 		}
 	}
@@ -1061,53 +1114,6 @@ namespace GP {
 	int Peer::GetProfileID() {
 		return m_profile.id;
 	}
-	OS::MetricValue Peer::GetMetricItemFromStats(PeerStats stats) {
-		OS::MetricValue arr_value, value;
-		value.value._str = stats.m_address.ToString(false);
-		value.key = "ip";
-		value.type = OS::MetricType_String;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.disconnected;
-		value.key = "disconnected";
-		value.type = OS::MetricType_Integer;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.type = OS::MetricType_Integer;
-		value.value._int = stats.bytes_in;
-		value.key = "bytes_in";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.bytes_out;
-		value.key = "bytes_out";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.packets_in;
-		value.key = "packets_in";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.packets_out;
-		value.key = "packets_out";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.total_requests;
-		value.key = "pending_requests";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-		arr_value.type = OS::MetricType_Array;
-
-		value.type = OS::MetricType_String;
-		value.key = "gamename";
-		value.value._str = stats.from_game.gamename;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.type = OS::MetricType_Integer;
-		value.key = "version";
-		value.value._int = stats.version;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		arr_value.key = stats.m_address.ToString(false);
-		return arr_value;
-	}
 	void Peer::ResetMetrics() {
 		m_peer_stats.bytes_in = 0;
 		m_peer_stats.bytes_out = 0;
@@ -1115,14 +1121,4 @@ namespace GP {
 		m_peer_stats.packets_out = 0;
 		m_peer_stats.total_requests = 0;
 	}
-	OS::MetricInstance Peer::GetMetrics() {
-		OS::MetricInstance peer_metric;
-
-		peer_metric.value = GetMetricItemFromStats(m_peer_stats);
-		peer_metric.key = "peer";
-
-		ResetMetrics();
-
-		return peer_metric;
-	}
 }
\ No newline at end of file
@@ -55,6 +55,7 @@ namespace GP {
 		void Delete();
 		
 		void think(bool packet_waiting);
+		int GetThinkDelay();
 		void handle_packet(char *data, int len);
 		const struct sockaddr_in *getAddress() { return &m_address_info; }
 
@@ -83,48 +84,45 @@ namespace GP {
 		void send_user_block_deleted(int from_profileid);
 
 		//
-		static OS::MetricValue GetMetricItemFromStats(PeerStats stats);
-		OS::MetricInstance GetMetrics();
-		PeerStats GetPeerStats() { if (m_delete_flag) m_peer_stats.disconnected = true; return m_peer_stats; };
 	private:
 		void refresh_buddy_list();
 		//packet handlers
-		void handle_login(OS::KVReader data_parser);
-		void handle_auth(OS::KVReader data_parser); //possibly for unexpected loss of connection to retain existing session
+		void handle_login(OS::KVReader &data_parser);
+		void handle_auth(OS::KVReader &data_parser); //possibly for unexpected loss of connection to retain existing session
 
-		void handle_status(OS::KVReader data_parser);
-		void handle_statusinfo(OS::KVReader data_parser);
+		void handle_status(OS::KVReader &data_parser);
+		void handle_statusinfo(OS::KVReader &data_parser);
 
-		void handle_addbuddy(OS::KVReader data_parser);
-		void handle_delbuddy(OS::KVReader data_parser);
-		void handle_revoke(OS::KVReader data_parser);
-		void handle_authadd(OS::KVReader data_parser);
+		void handle_addbuddy(OS::KVReader &data_parser);
+		void handle_delbuddy(OS::KVReader &data_parser);
+		void handle_revoke(OS::KVReader &data_parser);
+		void handle_authadd(OS::KVReader &data_parser);
 
-		void handle_pinvite(OS::KVReader data_parser);
+		void handle_pinvite(OS::KVReader &data_parser);
 
-		void handle_getprofile(OS::KVReader data_parser);
+		void handle_getprofile(OS::KVReader &data_parser);
 
-		void handle_newprofile(OS::KVReader data_parser);
-		void handle_delprofile(OS::KVReader data_parser);
+		void handle_newprofile(OS::KVReader &data_parser);
+		void handle_delprofile(OS::KVReader &data_parser);
 
-		void handle_registernick(OS::KVReader data_parser);
-		void handle_registercdkey(OS::KVReader data_parser);
+		void handle_registernick(OS::KVReader &data_parser);
+		void handle_registercdkey(OS::KVReader &data_parser);
 
-		void handle_newuser(OS::KVReader data_parser);
+		void handle_newuser(OS::KVReader &data_parser);
 		static void m_newuser_cb(bool success, OS::User user, OS::Profile profile, OS::AuthData auth_data, void *extra, int operation_id, INetPeer *peer);
 
 		int m_search_operation_id;
 		static void m_getprofile_callback(OS::EProfileResponseType response_reason, std::vector<OS::Profile> results, std::map<int, OS::User> result_users, void *extra, INetPeer *peer);
 
-		void handle_bm(OS::KVReader data_parser);
+		void handle_bm(OS::KVReader &data_parser);
 
-		void handle_addblock(OS::KVReader data_parser);
-		void handle_removeblock(OS::KVReader data_parser);
+		void handle_addblock(OS::KVReader &data_parser);
+		void handle_removeblock(OS::KVReader &data_parser);
 
-		void handle_updatepro(OS::KVReader data_parser);
-		void handle_updateui(OS::KVReader data_parser);
+		void handle_updatepro(OS::KVReader &data_parser);
+		void handle_updateui(OS::KVReader &data_parser);
 
-		void handle_keepalive(OS::KVReader data_parser);
+		void handle_keepalive(OS::KVReader &data_parser);
 		//
 
 		//login
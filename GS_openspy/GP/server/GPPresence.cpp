@@ -0,0 +1,286 @@
+#include "GPPresence.h"
+#include "GPBackend.h"
+#include "GPServer.h"
+#include "GPPeer.h"
+#include <sstream>
+
+namespace GPBackend {
+	PresenceRouter::PresenceRouter(GP::Server *server) {
+		mp_server = server;
+		mp_subscriber = NULL;
+		m_num_published = 0;
+		m_num_coalesced = 0;
+		m_num_received = 0;
+		m_num_delivered = 0;
+		m_num_subscribe_commands = 0;
+		OS::TimerWheel::InitEntry(&m_flush_timer, PresenceRouter::OnSubscribeFlush, this);
+		mp_mutex = OS::CreateMutex();
+		mp_flush_mutex = OS::CreateMutex();
+	}
+	PresenceRouter::~PresenceRouter() {
+		mp_server->GetTimerWheel()->Cancel(&m_flush_timer);
+
+		std::map<int, PresencePublishWindow *>::iterator it = m_publish_windows.begin();
+		while (it != m_publish_windows.end()) {
+			PresencePublishWindow *window = (*it).second;
+			mp_server->GetTimerWheel()->Cancel(&window->timer);
+			if (window->peer) {
+				window->peer->DecRef();
+			}
+			delete window;
+			it++;
+		}
+		delete mp_flush_mutex;
+		delete mp_mutex;
+	}
+	void PresenceRouter::AddWatch(GP::Peer *peer, int profileid) {
+		mp_mutex->lock();
+		//a list lookup can complete after the peer was removed, it must not be indexed again
+		if (!peer->ShouldDelete() && m_watches[peer].insert(profileid).second) {
+			std::vector<GP::Peer *> &watchers = m_watchers[profileid];
+			watchers.push_back(peer);
+			if (watchers.size() == 1) {
+				QueueSubscription(profileid, true);
+			}
+		}
+		mp_mutex->unlock();
+	}
+	void PresenceRouter::RemoveWatch(GP::Peer *peer, int profileid) {
+		mp_mutex->lock();
+		std::map<GP::Peer *, std::set<int> >::iterator it = m_watches.find(peer);
+		if (it != m_watches.end() && (*it).second.erase(profileid)) {
+			if ((*it).second.empty()) {
+				m_watches.erase(it);
+			}
+
+			std::vector<GP::Peer *> &watchers = m_watchers[profileid];
+			std::vector<GP::Peer *>::iterator it2 = std::find(watchers.begin(), watchers.end(), peer);
+			if (it2 != watchers.end()) {
+				watchers.erase(it2);
+			}
+			if (watchers.empty()) {
+				m_watchers.erase(profileid);
+				QueueSubscription(profileid, false);
+			}
+		}
+		mp_mutex->unlock();
+	}
+	void PresenceRouter::RemovePeer(GP::Peer *peer) {
+		mp_mutex->lock();
+		std::map<GP::Peer *, std::set<int> >::iterator it = m_watches.find(peer);
+		if (it != m_watches.end()) {
+			std::set<int> watches = (*it).second;
+			std::set<int>::iterator it2 = watches.begin();
+			while (it2 != watches.end()) {
+				RemoveWatch(peer, *it2);
+				it2++;
+			}
+		}
+		mp_mutex->unlock();
+	}
+	void PresenceRouter::QueueSubscription(int profileid, bool subscribe) {
+		//a change undoing one which hasn't been sent yet cancels it out
+		if (subscribe) {
+			if (!m_pending_unsubscribe.erase(profileid)) {
+				m_pending_subscribe.insert(profileid);
+			}
+		}
+		else {
+			if (!m_pending_subscribe.erase(profileid)) {
+				m_pending_unsubscribe.insert(profileid);
+			}
+		}
+		mp_server->GetTimerWheel()->Schedule(&m_flush_timer, GP_SUBSCRIBE_FLUSH_TIME, true);
+	}
+	void PresenceRouter::OnSubscribeFlush(void *extra) {
+		PresenceRouter *router = (PresenceRouter *)extra;
+		router->FlushSubscriptions();
+	}
+	void PresenceRouter::FlushSubscriptions() {
+		std::set<int> subscribe, unsubscribe;
+
+		//the sends happen outside mp_mutex, as a reconnecting subscriber can hold the connection for seconds
+		mp_flush_mutex->lock();
+		mp_mutex->lock();
+		Redis::Connection *subscriber = mp_subscriber;
+		if (subscriber) {
+			subscribe.swap(m_pending_subscribe);
+			unsubscribe.swap(m_pending_unsubscribe);
+		}
+		mp_mutex->unlock();
+
+		//not connected yet, everything watched is subscribed to once it is
+		if (subscriber) {
+			SendChannels(subscriber, "SUBSCRIBE", subscribe);
+			SendChannels(subscriber, "UNSUBSCRIBE", unsubscribe);
+		}
+		mp_flush_mutex->unlock();
+	}
+	void PresenceRouter::SendChannels(Redis::Connection *subscriber, const char *command, std::set<int> &profileids) {
+		std::ostringstream s;
+		int count = 0;
+		std::set<int>::iterator it = profileids.begin();
+		while (it != profileids.end()) {
+			if (count == 0) {
+				s.str("");
+				s << command;
+			}
+			s << " " << GP_STATUS_CHANNEL_PREFIX << *it;
+			it++;
+			if (++count == GP_SUBSCRIBE_BATCH_SIZE || it == profileids.end()) {
+				Redis::SendCommand(subscriber, "%s", s.str().c_str());
+				OS::CMutex::SafeIncr(&m_num_subscribe_commands);
+				count = 0;
+			}
+		}
+	}
+	void PresenceRouter::OnSubscriberConnected(Redis::Connection *connection) {
+		std::set<int> subscribe;
+
+		//a new connection has none of the profile channels
+		mp_flush_mutex->lock();
+		mp_mutex->lock();
+		mp_subscriber = connection;
+		m_pending_subscribe.clear();
+		m_pending_unsubscribe.clear();
+		std::map<int, std::vector<GP::Peer *> >::iterator it = m_watchers.begin();
+		while (it != m_watchers.end()) {
+			subscribe.insert((*it).first);
+			it++;
+		}
+		mp_mutex->unlock();
+
+		SendChannels(connection, "SUBSCRIBE", subscribe);
+		mp_flush_mutex->unlock();
+	}
+	void PresenceRouter::DeliverStatus(int profileid, GPShared::GPStatus status) {
+		std::vector<GP::Peer *> peers;
+		OS::CMutex::SafeIncr(&m_num_received);
+
+		mp_mutex->lock();
+		std::map<int, std::vector<GP::Peer *> >::iterator it = m_watchers.find(profileid);
+		if (it != m_watchers.end()) {
+			peers = (*it).second;
+		}
+		std::vector<GP::Peer *>::iterator it2 = peers.begin();
+		while (it2 != peers.end()) {
+			(*it2)->IncRef();
+			it2++;
+		}
+		mp_mutex->unlock();
+
+		it2 = peers.begin();
+		while (it2 != peers.end()) {
+			GP::Peer *peer = *it2;
+			peer->inform_status_update(profileid, status);
+			peer->DecRef();
+			OS::CMutex::SafeIncr(&m_num_delivered);
+			it2++;
+		}
+	}
+	void PresenceRouter::PublishStatus(GP::Peer *peer, GPShared::GPStatus status) {
+		int profileid = peer->GetProfileID();
+
+		mp_mutex->lock();
+		std::map<int, PresencePublishWindow *>::iterator it = m_publish_windows.find(profileid);
+		if (it == m_publish_windows.end()) {
+			PresencePublishWindow *window = new PresencePublishWindow;
+			window->router = this;
+			window->profileid = profileid;
+			window->peer = NULL;
+			window->pending = false;
+			OS::TimerWheel::InitEntry(&window->timer, PresenceRouter::OnPublishWindowEnd, window);
+			m_publish_windows[profileid] = window;
+
+			peer->IncRef();
+			SubmitStatus(peer, status);
+			mp_server->GetTimerWheel()->Schedule(&window->timer, GP_STATUS_COALESCE_TIME);
+		}
+		else {
+			PresencePublishWindow *window = (*it).second;
+			if (window->pending) {
+				OS::CMutex::SafeIncr(&m_num_coalesced);
+			}
+			if (window->peer != peer) {
+				peer->IncRef();
+				if (window->peer) {
+					window->peer->DecRef();
+				}
+				window->peer = peer;
+			}
+			window->status = status;
+			window->pending = true;
+		}
+		mp_mutex->unlock();
+	}
+	void PresenceRouter::OnPublishWindowEnd(void *extra) {
+		PresencePublishWindow *window = (PresencePublishWindow *)extra;
+		PresenceRouter *router = window->router;
+
+		router->mp_mutex->lock();
+		if (window->pending) {
+			//the latest status goes out, and starts a new window
+			router->SubmitStatus(window->peer, window->status);
+			window->peer = NULL;
+			window->pending = false;
+			router->mp_server->GetTimerWheel()->Schedule(&window->timer, GP_STATUS_COALESCE_TIME);
+		}
+		else {
+			router->m_publish_windows.erase(window->profileid);
+			delete window;
+		}
+		router->mp_mutex->unlock();
+	}
+	//takes over the caller's reference on peer
+	void PresenceRouter::SubmitStatus(GP::Peer *peer, GPShared::GPStatus status) {
+		GPBackendRedisRequest req;
+		req.type = EGPRedisRequestType_UpdateStatus;
+		req.peer = peer;
+		req.StatusInfo = status;
+		req.extra = (void *)peer;
+		m_task_pool->AddRequest(req, peer);
+		OS::CMutex::SafeIncr(&m_num_published);
+	}
+	OS::MetricValue PresenceRouter::GetMetrics() {
+		OS::MetricValue arr_value, value;
+		value.type = OS::MetricType_Integer;
+
+		mp_mutex->lock();
+		value.value._int = m_watchers.size();
+		value.key = "watched_profiles";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = m_watches.size();
+		value.key = "watching_peers";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = m_publish_windows.size();
+		value.key = "publish_windows";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+		mp_mutex->unlock();
+
+		value.value._int = OS::CMutex::SafeAdd(&m_num_published, 0);
+		value.key = "published";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = OS::CMutex::SafeAdd(&m_num_coalesced, 0);
+		value.key = "coalesced";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = OS::CMutex::SafeAdd(&m_num_received, 0);
+		value.key = "received";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = OS::CMutex::SafeAdd(&m_num_delivered, 0);
+		value.key = "delivered";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = OS::CMutex::SafeAdd(&m_num_subscribe_commands, 0);
+		value.key = "subscribe_commands";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		arr_value.key = "presence";
+		arr_value.type = OS::MetricType_Array;
+		return arr_value;
+	}
+}
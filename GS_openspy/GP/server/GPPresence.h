@@ -0,0 +1,88 @@
+#ifndef _GP_PRESENCE_H
+#define _GP_PRESENCE_H
+#include <OS/OpenSpy.h>
+#include <OS/Mutex.h>
+#include <OS/Redis.h>
+#include <OS/GPShared.h>
+#include <OS/Timer/TimerWheel.h>
+#include <OS/Analytics/Metric.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+
+#define GP_STATUS_CHANNEL_PREFIX "presence.status."
+#define GP_STATUS_COALESCE_TIME 250 //ms, status changes within this long of the last one sent for a profile are merged into one
+#define GP_SUBSCRIBE_FLUSH_TIME 20 //ms, watch changes are batched into one SUBSCRIBE/UNSUBSCRIBE
+#define GP_SUBSCRIBE_BATCH_SIZE 256 //channels per command
+
+namespace GP {
+	class Server;
+	class Peer;
+}
+namespace GPBackend {
+	class PresenceRouter;
+
+	typedef struct {
+		PresenceRouter *router;
+		int profileid;
+		GP::Peer *peer; //holds a reference while status is pending
+		GPShared::GPStatus status;
+		bool pending;
+		OS::TimerWheelEntry timer; //ends the coalescing window
+	} PresencePublishWindow;
+
+	/*
+		Routes status changes only to the GP instances which have a buddy of the profile connected.
+		Each profile's status is published on its own channel, and every instance keeps a reverse buddy index
+		of its local peers, subscribing to the channels of the profiles they watch.
+		Status flaps are coalesced before publishing, so a burst of changes costs one message per window.
+	*/
+	class PresenceRouter {
+	public:
+		PresenceRouter(GP::Server *server);
+		~PresenceRouter();
+
+		//a peer watches every profile on its buddy and block lists, adding or removing a watch twice is harmless
+		void AddWatch(GP::Peer *peer, int profileid);
+		void RemoveWatch(GP::Peer *peer, int profileid);
+		void RemovePeer(GP::Peer *peer);
+
+		//sends now, unless a status was sent for the profile within the coalescing window, then it goes out when the window ends
+		void PublishStatus(GP::Peer *peer, GPShared::GPStatus status);
+
+		//subscriber thread
+		void OnSubscriberConnected(Redis::Connection *connection);
+		void DeliverStatus(int profileid, GPShared::GPStatus status);
+
+		OS::MetricValue GetMetrics();
+	private:
+		static void OnPublishWindowEnd(void *extra);
+		static void OnSubscribeFlush(void *extra);
+		void QueueSubscription(int profileid, bool subscribe);
+		void FlushSubscriptions();
+		void SendChannels(Redis::Connection *subscriber, const char *command, std::set<int> &profileids);
+		void SubmitStatus(GP::Peer *peer, GPShared::GPStatus status);
+
+		GP::Server *mp_server;
+		Redis::Connection *mp_subscriber;
+
+		std::map<int, std::vector<GP::Peer *> > m_watchers; //reverse buddy index, profileid -> local peers watching it
+		std::map<GP::Peer *, std::set<int> > m_watches; //what each peer watches, so it can be dropped on disconnect
+		std::set<int> m_pending_subscribe;
+		std::set<int> m_pending_unsubscribe;
+		OS::TimerWheelEntry m_flush_timer;
+
+		std::map<int, PresencePublishWindow *> m_publish_windows;
+
+		uint32_t m_num_published;
+		uint32_t m_num_coalesced;
+		uint32_t m_num_received;
+		uint32_t m_num_delivered;
+		uint32_t m_num_subscribe_commands;
+
+		OS::CMutex *mp_mutex;
+		OS::CMutex *mp_flush_mutex; //keeps subscription changes in order, held while they're sent
+	};
+}
+#endif //_GP_PRESENCE_H
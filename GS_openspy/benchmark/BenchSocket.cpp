@@ -0,0 +1,153 @@
+#include "BenchSocket.h"
+#include <OS/Analytics/Instrument.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/select.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#endif
+namespace Bench {
+	Socket::Socket() {
+		m_sd = -1;
+	}
+	Socket::~Socket() {
+		Close();
+	}
+	static bool ResolveAddress(const char *host, uint16_t port, struct sockaddr_in *address) {
+		memset(address, 0, sizeof(struct sockaddr_in));
+		address->sin_family = AF_INET;
+		address->sin_port = htons(port);
+		address->sin_addr.s_addr = inet_addr(host);
+		if (address->sin_addr.s_addr == INADDR_NONE) {
+			struct hostent *hp = gethostbyname(host);
+			if (!hp) {
+				return false;
+			}
+			memcpy(&address->sin_addr, hp->h_addr, sizeof(address->sin_addr));
+		}
+		return true;
+	}
+	bool Socket::ConnectTCP(const char *host, uint16_t port) {
+		struct sockaddr_in address;
+		int on = 1;
+		Close();
+		if (!ResolveAddress(host, port, &address)) {
+			return false;
+		}
+		if ((m_sd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0) {
+			m_sd = -1;
+			return false;
+		}
+		//requests are small and latency is what's measured
+		setsockopt(m_sd, IPPROTO_TCP, TCP_NODELAY, (const char *)&on, sizeof(on));
+		if (connect(m_sd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+			Close();
+			return false;
+		}
+		return true;
+	}
+	bool Socket::OpenUDP(const char *host, uint16_t port) {
+		struct sockaddr_in address;
+		Close();
+		if (!ResolveAddress(host, port, &address)) {
+			return false;
+		}
+		if ((m_sd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0) {
+			m_sd = -1;
+			return false;
+		}
+		//connected, so only the daemon's replies are received
+		if (connect(m_sd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+			Close();
+			return false;
+		}
+		return true;
+	}
+	void Socket::Close() {
+		if (m_sd != -1) {
+			close(m_sd);
+			m_sd = -1;
+		}
+		m_pending.clear();
+	}
+	bool Socket::Send(const void *data, int len) {
+		const char *p = (const char *)data;
+		while (len > 0) {
+			int sent = send(m_sd, p, len, MSG_NOSIGNAL);
+			if (sent <= 0) {
+				return false;
+			}
+			p += sent;
+			len -= sent;
+		}
+		return true;
+	}
+	int Socket::Recv(void *data, int len, int timeout_ms) {
+		fd_set fdset;
+		struct timeval timeout;
+		if (m_sd == -1) {
+			return -1;
+		}
+		timeout.tv_sec = timeout_ms / 1000;
+		timeout.tv_usec = (timeout_ms % 1000) * 1000;
+		FD_ZERO(&fdset);
+		FD_SET(m_sd, &fdset);
+		if (select(m_sd + 1, &fdset, NULL, NULL, &timeout) <= 0) {
+			return -1;
+		}
+		int r = recv(m_sd, (char *)data, len, 0);
+		if (r < 0) {
+			return -1;
+		}
+		return r;
+	}
+	bool Socket::ReadMore(int timeout_ms) {
+		char buffer[BENCH_RECV_BUFFER_SIZE];
+		int len = Recv(buffer, sizeof(buffer), timeout_ms);
+		if (len <= 0) {
+			return false;
+		}
+		m_pending.append(buffer, len);
+		return true;
+	}
+	bool Socket::ReadMessage(std::string &message, const char *terminator, int timeout_ms) {
+		uint64_t deadline = OS::GetMonotonicTimeUS() + (uint64_t)timeout_ms * 1000;
+		size_t searched = 0, terminator_len = strlen(terminator);
+		while (true) {
+			size_t pos = m_pending.find(terminator, searched);
+			if (pos != std::string::npos) {
+				message = m_pending.substr(0, pos + terminator_len);
+				m_pending.erase(0, pos + terminator_len);
+				return true;
+			}
+			if (m_pending.length() >= terminator_len) {
+				searched = m_pending.length() - terminator_len + 1;
+			}
+			uint64_t now = OS::GetMonotonicTimeUS();
+			if (now >= deadline || !ReadMore((int)((deadline - now) / 1000) + 1)) {
+				return false;
+			}
+		}
+	}
+	uint16_t Socket::GetLocalPort() {
+		struct sockaddr_in address;
+		socklen_t len = sizeof(address);
+		if (getsockname(m_sd, (struct sockaddr *)&address, &len) < 0) {
+			return 0;
+		}
+		return ntohs(address.sin_port);
+	}
+	std::string GetKVValue(const std::string &kv, const char *key) {
+		std::string search = std::string("\\") + key + "\\";
+		size_t pos = kv.find(search);
+		if (pos == std::string::npos) {
+			return std::string();
+		}
+		pos += search.length();
+		size_t end = kv.find('\\', pos);
+		if (end == std::string::npos) {
+			end = kv.length();
+		}
+		return kv.substr(pos, end - pos);
+	}
+}
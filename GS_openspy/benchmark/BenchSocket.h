@@ -0,0 +1,43 @@
+#ifndef _BENCH_SOCKET_H
+#define _BENCH_SOCKET_H
+#include <OS/OpenSpy.h>
+#include <string>
+
+#define BENCH_RECV_TIMEOUT 5000 //ms, a reply taking longer than this counts the operation as failed
+#define BENCH_RECV_BUFFER_SIZE 65536
+
+namespace Bench {
+	/*
+		Blocking client socket, TCP or connected UDP, with the small amount of message framing the clients need.
+	*/
+	class Socket {
+	public:
+		Socket();
+		~Socket();
+		bool ConnectTCP(const char *host, uint16_t port);
+		bool OpenUDP(const char *host, uint16_t port);
+		void Close();
+		bool IsOpen() { return m_sd != -1; };
+
+		bool Send(const void *data, int len);
+		bool Send(const std::string &data) { return Send(data.c_str(), data.length()); };
+
+		//a single recv, -1 on error or timeout, 0 if the peer closed the connection
+		int Recv(void *data, int len, int timeout_ms = BENCH_RECV_TIMEOUT);
+
+		//TCP only, the next message ending with terminator (included), anything read past it is kept for the next call
+		bool ReadMessage(std::string &message, const char *terminator, int timeout_ms = BENCH_RECV_TIMEOUT);
+		//TCP only, appends whatever arrives within timeout_ms to the pending data, false on timeout or once the connection is closed
+		bool ReadMore(int timeout_ms = BENCH_RECV_TIMEOUT);
+		std::string &GetPending() { return m_pending; };
+
+		uint16_t GetLocalPort(); //host order
+	private:
+		int m_sd;
+		std::string m_pending;
+	};
+
+	//value of key in a \key\value\ string, empty if it isn't there
+	std::string GetKVValue(const std::string &kv, const char *key);
+}
+#endif //_BENCH_SOCKET_H
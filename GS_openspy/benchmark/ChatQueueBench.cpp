@@ -0,0 +1,108 @@
+#include "ChatQueueBench.h"
+#include <OS/OpenSpy.h>
+#include <OS/TaskPool.h>
+#include <OS/Analytics/Instrument.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Bench {
+	typedef struct {
+		uint64_t submit_time;
+		uint32_t channel_key;
+		int sequence; //within its channel
+	} ChatQueueRequest;
+
+	class ChatQueueTask : public OS::Task<ChatQueueRequest> {
+	public:
+		static bool s_tick; //set before the pool is created
+		static OS::LatencyHistogram *sp_histogram;
+		static uint32_t s_out_of_order;
+		static uint32_t s_completed;
+
+		ChatQueueTask(int thread_index) {
+			m_running = true;
+			for (int i = 0; i < CHAT_QUEUE_CHANNELS; i++) {
+				m_last_sequence[i] = -1;
+			}
+			mp_thread = OS::CreateThread(ChatQueueTask::TaskThread, this, true);
+		}
+		~ChatQueueTask() {
+			m_running = false;
+			mp_thread_poller->signal();
+			delete mp_thread;
+		}
+	private:
+		static void *TaskThread(OS::CThread *thread) {
+			ChatQueueTask *task = (ChatQueueTask *)thread->getParams();
+			ChatQueueRequest request;
+			while (task->m_running) {
+				if (s_tick) {
+					OS::Sleep(CHAT_QUEUE_TICK);
+				}
+				else if (!task->HasRequests()) {
+					task->mp_thread_poller->wait();
+				}
+				while (task->PopRequest(request)) {
+					sp_histogram->Record(OS::GetMonotonicTimeUS() - request.submit_time);
+					//a channel's requests are only ever on this worker, so its last sequence is only read here
+					int channel = (request.channel_key - 1) % CHAT_QUEUE_CHANNELS;
+					if (request.sequence != task->m_last_sequence[channel] + 1) {
+						OS::CMutex::SafeIncr(&s_out_of_order);
+					}
+					task->m_last_sequence[channel] = request.sequence;
+					OS::CMutex::SafeIncr(&s_completed);
+				}
+			}
+			return NULL;
+		}
+
+		volatile bool m_running;
+		int m_last_sequence[CHAT_QUEUE_CHANNELS];
+	};
+	bool ChatQueueTask::s_tick = false;
+	OS::LatencyHistogram *ChatQueueTask::sp_histogram = NULL;
+	uint32_t ChatQueueTask::s_out_of_order = 0;
+	uint32_t ChatQueueTask::s_completed = 0;
+
+	static bool RunChatQueue(bool tick, int requests) {
+		OS::LatencyHistogram histogram("bench_chat_queue_wait", "Time from a chat request being added until it's run");
+		ChatQueueTask::s_tick = tick;
+		ChatQueueTask::sp_histogram = &histogram;
+		ChatQueueTask::s_out_of_order = 0;
+		ChatQueueTask::s_completed = 0;
+
+		OS::TaskPool<ChatQueueTask, ChatQueueRequest> *pool = new OS::TaskPool<ChatQueueTask, ChatQueueRequest>(CHAT_QUEUE_WORKERS, OS::ETaskDispatch_Affinity);
+		std::vector<int> sequences(CHAT_QUEUE_CHANNELS, 0);
+		for (int i = 0; i < requests; i++) {
+			ChatQueueRequest request;
+			int channel = i % CHAT_QUEUE_CHANNELS;
+			request.channel_key = channel + 1; //0 is no key
+			request.sequence = sequences[channel]++;
+			request.submit_time = OS::GetMonotonicTimeUS();
+			pool->AddRequestByKey(request, request.channel_key);
+			usleep(CHAT_QUEUE_SUBMIT_INTERVAL);
+		}
+		while (OS::CMutex::SafeAdd(&ChatQueueTask::s_completed, 0) < (uint32_t)requests) {
+			OS::Sleep(10);
+		}
+		delete pool;
+
+		printf("%-12s %10d %12llu %12llu %14u\n", tick ? "200ms tick" : "signalled", requests,
+			(unsigned long long)histogram.GetPercentile(0.5), (unsigned long long)histogram.GetPercentile(0.99), ChatQueueTask::s_out_of_order);
+		return ChatQueueTask::s_out_of_order == 0;
+	}
+
+	int RunChatQueueBench(int requests) {
+		printf("%d requests over %d channels on %d workers, one every %dus\n", requests, CHAT_QUEUE_CHANNELS, CHAT_QUEUE_WORKERS, CHAT_QUEUE_SUBMIT_INTERVAL);
+		printf("%-12s %10s %12s %12s %14s\n", "wakeup", "requests", "p50 us", "p99 us", "out of order");
+		bool in_order = RunChatQueue(true, requests);
+		in_order = RunChatQueue(false, requests) && in_order;
+		if (!in_order) {
+			fprintf(stderr, "a channel's requests ran out of the order they were added\n");
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+}
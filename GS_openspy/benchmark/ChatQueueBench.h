@@ -0,0 +1,18 @@
+#ifndef _BENCH_CHATQUEUEBENCH_H
+#define _BENCH_CHATQUEUEBENCH_H
+
+#define CHAT_QUEUE_DEFAULT_REQUESTS 2000
+#define CHAT_QUEUE_WORKERS 4 //NUM_CHAT_THREADS
+#define CHAT_QUEUE_CHANNELS 64 //channel keys the requests are spread over
+#define CHAT_QUEUE_SUBMIT_INTERVAL 500 //us between requests
+#define CHAT_QUEUE_TICK 200 //ms, CHAT_BACKEND_TICK, how often the chat backend used to look at its queue
+
+namespace Bench {
+	/*
+		In process, no daemons needed, times how long chat backend requests wait in a pool of workers keyed by channel,
+		as ChatBackendTask's is: workers which drain their queue every CHAT_QUEUE_TICK, as the backend did,
+		and workers woken as soon as a request is added. Each channel's requests must run in the order they were added.
+	*/
+	int RunChatQueueBench(int requests);
+}
+#endif //_BENCH_CHATQUEUEBENCH_H
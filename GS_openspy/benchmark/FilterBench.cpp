@@ -0,0 +1,143 @@
+#include "FilterBench.h"
+#include <OS/OpenSpy.h>
+#include <OS/Analytics/Instrument.h>
+#include <serverbrowsing/filter/CToken.h>
+#include <serverbrowsing/filter/CompiledFilter.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace Bench {
+	static const char *filter_bench_filters[] = {
+		"numplayers > 0 and numplayers < maxplayers",
+		"gametype = 'ctf' and password = 0 and gamever = '1.01'",
+		"hostport >= 27900 and hostport <= 27950 and numplayers + 2 > maxplayers - 8",
+		"mapname = 'q3dm17' and numplayers >= 4 and hostname != 'osbench 42'",
+	};
+	static const char *filter_bench_gametypes[] = {"ctf", "dm", "tdm", "koth"};
+	static const char *filter_bench_maps[] = {"q3dm6", "q3dm17", "q3tourney2", "q3ctf1", "q3ctf4"};
+
+	static std::vector<std::map<std::string, std::string> > MakeServers(int num_servers) {
+		std::vector<std::map<std::string, std::string> > servers(num_servers);
+		uint32_t rand_state = 1;
+		for (int i = 0; i < num_servers; i++) {
+			std::map<std::string, std::string> &kv = servers[i];
+			std::ostringstream s;
+			rand_state = rand_state * 1103515245 + 12345;
+			int maxplayers = 8 + ((rand_state >> 8) % 4) * 8;
+			rand_state = rand_state * 1103515245 + 12345;
+			int numplayers = (rand_state >> 8) % (maxplayers + 1);
+
+			s << "osbench " << i;
+			kv["hostname"] = s.str();
+			s.str("");
+			s << numplayers;
+			kv["numplayers"] = s.str();
+			s.str("");
+			s << maxplayers;
+			kv["maxplayers"] = s.str();
+			s.str("");
+			s << 27900 + i % 100;
+			kv["hostport"] = s.str();
+			kv["gametype"] = filter_bench_gametypes[(rand_state >> 12) % (sizeof(filter_bench_gametypes) / sizeof(const char *))];
+			kv["mapname"] = filter_bench_maps[(rand_state >> 16) % (sizeof(filter_bench_maps) / sizeof(const char *))];
+			kv["gamever"] = (rand_state >> 20) % 8 ? "1.01" : "1.00";
+			//some servers never set a password key, which binds as an empty string
+			if ((rand_state >> 24) % 16) {
+				kv["password"] = (rand_state >> 28) % 4 ? "0" : "1";
+			}
+		}
+		return servers;
+	}
+
+	//as ServerListCache::BindRow
+	static FilterColumn BindColumn(const std::vector<std::map<std::string, std::string> > &servers, const std::string &name) {
+		FilterColumn column;
+		for (size_t row = 0; row < servers.size(); row++) {
+			FilterValue value;
+			value.type = EToken_String;
+			value.ival = 0;
+			value.sval = "";
+			value.slen = 0;
+			std::map<std::string, std::string>::const_iterator it = servers[row].find(name);
+			if (it != servers[row].end()) {
+				value = CompiledFilter::BindValue(it->second);
+			}
+			SetFilterColumnValue(column, row, value);
+		}
+		return column;
+	}
+
+	static double ElapsedMS(uint64_t start) {
+		return (OS::GetMonotonicTimeUS() - start) / 1000.0;
+	}
+
+	static bool RunFilter(const char *filter, std::vector<std::map<std::string, std::string> > &servers) {
+		int num_servers = servers.size();
+
+		uint64_t start = OS::GetMonotonicTimeUS();
+		int tokenized_matches = 0;
+		for (int i = 0; i < num_servers; i++) {
+			if (evaluate(CToken::filterToTokenList(filter), servers[i])) {
+				tokenized_matches++;
+			}
+		}
+		double tokenized_ms = ElapsedMS(start);
+
+		start = OS::GetMonotonicTimeUS();
+		CompiledFilter compiled(filter);
+		int compiled_matches = 0;
+		for (int i = 0; i < num_servers; i++) {
+			if (compiled.Matches(servers[i])) {
+				compiled_matches++;
+			}
+		}
+		double compiled_ms = ElapsedMS(start);
+
+		//the cache binds each column once and keeps it until the game changes, so it's timed apart from evaluating
+		start = OS::GetMonotonicTimeUS();
+		std::vector<FilterColumn> columns;
+		for (size_t i = 0; i < compiled.GetVariables().size(); i++) {
+			columns.push_back(BindColumn(servers, compiled.GetVariables()[i]));
+		}
+		double bind_ms = ElapsedMS(start);
+		std::vector<const FilterColumn *> column_ptrs;
+		for (size_t i = 0; i < columns.size(); i++) {
+			column_ptrs.push_back(&columns[i]);
+		}
+
+		start = OS::GetMonotonicTimeUS();
+		std::vector<uint32_t> matches;
+		compiled.EvaluateColumns(column_ptrs.empty() ? NULL : &column_ptrs[0], num_servers, matches);
+		double columns_ms = ElapsedMS(start);
+		int column_matches = 0;
+		for (int i = 0; i < num_servers; i++) {
+			if (matches[i / 32] & (1u << (i % 32))) {
+				column_matches++;
+			}
+		}
+
+		bool ok = tokenized_matches == compiled_matches && compiled_matches == column_matches;
+		printf("%s\n", filter);
+		printf("  %8d matches %12.2f ms tokenized %12.2f ms compiled %10.2f ms columns (+%.2f ms binding)%s\n", compiled_matches, tokenized_ms, compiled_ms, columns_ms, bind_ms,
+			ok ? "" : " MISMATCH");
+		return ok;
+	}
+
+	int RunFilterBench(const char *filter, int num_servers) {
+		std::vector<std::map<std::string, std::string> > servers = MakeServers(num_servers);
+		printf("%d servers, each filter run once over all of them\n", num_servers);
+
+		bool ok = RunFilter(filter, servers);
+		for (size_t i = 0; i < sizeof(filter_bench_filters) / sizeof(const char *); i++) {
+			ok = RunFilter(filter_bench_filters[i], servers) && ok;
+		}
+		if (!ok) {
+			fprintf(stderr, "the filter paths selected different servers\n");
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+}
@@ -0,0 +1,14 @@
+#ifndef _BENCH_FILTERBENCH_H
+#define _BENCH_FILTERBENCH_H
+
+#define FILTER_BENCH_DEFAULT_SERVERS 100000
+
+namespace Bench {
+	/*
+		In process, no daemons needed, filters synthetic servers with the filter given by --filter and a few others:
+		tokenized and evaluated per server as filterMatches did before CompiledFilter, compiled once and matched per server
+		as AppendServerEntries does, and over bound columns as ServerListCache does. All three must select the same servers.
+	*/
+	int RunFilterBench(const char *filter, int num_servers);
+}
+#endif //_BENCH_FILTERBENCH_H
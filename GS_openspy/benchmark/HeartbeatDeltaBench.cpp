@@ -0,0 +1,362 @@
+#include "HeartbeatDeltaBench.h"
+#include <OS/OpenSpy.h>
+#include <OS/Redis.h>
+#include <OS/Analytics/Instrument.h>
+#include <qr/server/MMPushDelta.h>
+#include "RedisPushBench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace Bench {
+	static const char *heartbeat_keys[] = {"hostname", "gamever", "mapname", "gametype", "gamemode", "numplayers", "maxplayers", "password", "timelimit", "fraglimit", "teamplay", "hostport"};
+	static const char *heartbeat_player_keys[] = {"player_", "score_", "ping_", "team_", "deaths_", "skill_"};
+	static const char *heartbeat_team_keys[] = {"team_t", "score_t"};
+	static const char *heartbeat_scenarios[] = {"unchanged", "churn", "join/leave"};
+	enum EHeartbeatScenario {
+		EHeartbeatScenario_Unchanged,
+		EHeartbeatScenario_Churn,
+		EHeartbeatScenario_JoinLeave,
+		EHeartbeatScenario_Count
+	};
+
+	typedef struct {
+		std::map<std::string, std::string> m_keys;
+		std::map<std::string, std::vector<std::string> > m_player_keys;
+		std::map<std::string, std::vector<std::string> > m_team_keys;
+	} HeartbeatState;
+
+	typedef struct {
+		int round_trips;
+		int commands;
+	} HeartbeatCost;
+
+	static HeartbeatState BuildHeartbeat(EHeartbeatScenario scenario, int heartbeat) {
+		HeartbeatState state;
+		int num_players = HEARTBEAT_DELTA_PLAYERS;
+		if (scenario == EHeartbeatScenario_JoinLeave && heartbeat % 2 == 1) {
+			num_players = HEARTBEAT_DELTA_LEFT_PLAYERS;
+		}
+
+		for (size_t i = 0; i < sizeof(heartbeat_keys) / sizeof(const char *); i++) {
+			state.m_keys[heartbeat_keys[i]] = "value";
+		}
+		std::ostringstream s;
+		s << num_players;
+		state.m_keys["numplayers"] = s.str();
+
+		for (size_t i = 0; i < sizeof(heartbeat_player_keys) / sizeof(const char *); i++) {
+			std::string name = heartbeat_player_keys[i];
+			bool churns = scenario == EHeartbeatScenario_Churn && (name.compare("ping_") == 0 || name.compare("score_") == 0);
+			std::vector<std::string> &column = state.m_player_keys[name];
+			for (int p = 0; p < num_players; p++) {
+				s.str("");
+				s << name << p;
+				if (churns) {
+					//changes from the last heartbeat only for the players where p % HEARTBEAT_DELTA_CHURN == heartbeat % HEARTBEAT_DELTA_CHURN
+					s << "_" << (heartbeat + HEARTBEAT_DELTA_CHURN - p % HEARTBEAT_DELTA_CHURN) / HEARTBEAT_DELTA_CHURN;
+				}
+				column.push_back(s.str());
+			}
+		}
+		for (size_t i = 0; i < sizeof(heartbeat_team_keys) / sizeof(const char *); i++) {
+			std::vector<std::string> &column = state.m_team_keys[heartbeat_team_keys[i]];
+			for (int t = 0; t < 2; t++) {
+				s.str("");
+				s << t;
+				column.push_back(s.str());
+			}
+		}
+		return state;
+	}
+
+	static void AppendHeartbeatExpires(Redis::Connection *connection, std::string server_key, int server_id, HeartbeatState &state) {
+		Redis::AppendCommand(connection, "EXPIRE IPMAP_10.0.%d.%d-27900 %d", server_id >> 8, server_id & 255, REDIS_PUSH_EXPIRE_TIME);
+		Redis::AppendCommand(connection, "EXPIRE %s %d", server_key.c_str(), REDIS_PUSH_EXPIRE_TIME);
+		Redis::AppendCommand(connection, "EXPIRE %scustkeys %d", server_key.c_str(), REDIS_PUSH_EXPIRE_TIME);
+		int num_slots = MM::GetNumSlots(state.m_player_keys);
+		for (int i = 0; i < num_slots; i++) {
+			Redis::AppendCommand(connection, "EXPIRE %scustkeys_player_%d %d", server_key.c_str(), i, REDIS_PUSH_EXPIRE_TIME);
+		}
+		num_slots = MM::GetNumSlots(state.m_team_keys);
+		for (int i = 0; i < num_slots; i++) {
+			Redis::AppendCommand(connection, "EXPIRE %scustkeys_team_%d %d", server_key.c_str(), i, REDIS_PUSH_EXPIRE_TIME);
+		}
+	}
+
+	//as PushServer does for a new server, a delta from nothing
+	static void PushHeartbeat(Redis::Connection *connection, std::string server_key, int server_id, HeartbeatState &state) {
+		HeartbeatState empty_state;
+		Redis::AppendCommand(connection, "SELECT %d", OS::ERedisDB_QR);
+		Redis::AppendCommand(connection, "SET IPMAP_10.0.%d.%d-27900 %s", server_id >> 8, server_id & 255, server_key.c_str());
+		Redis::AppendCommand(connection, "HINCRBY %s num_beats 1", server_key.c_str());
+		MM::AppendHashDelta(connection, server_key + "custkeys", empty_state.m_keys, state.m_keys);
+		MM::AppendSlotDeltas(connection, server_key + "custkeys_player_", empty_state.m_player_keys, state.m_player_keys);
+		MM::AppendSlotDeltas(connection, server_key + "custkeys_team_", empty_state.m_team_keys, state.m_team_keys);
+		AppendHeartbeatExpires(connection, server_key, server_id, state);
+		Redis::Flush(connection);
+	}
+
+	//MMPushTask::PerformUpdateServerDelta
+	static bool SendDelta(Redis::Connection *connection, std::string server_key, int server_id, HeartbeatState &old_state, HeartbeatState &new_state, HeartbeatCost &cost) {
+		bool changed = false;
+		Redis::AppendCommand(connection, "SELECT %d", OS::ERedisDB_QR);
+		Redis::AppendCommand(connection, "MULTI");
+		changed |= MM::AppendHashDelta(connection, server_key + "custkeys", old_state.m_keys, new_state.m_keys);
+		changed |= MM::AppendSlotDeltas(connection, server_key + "custkeys_player_", old_state.m_player_keys, new_state.m_player_keys);
+		changed |= MM::AppendSlotDeltas(connection, server_key + "custkeys_team_", old_state.m_team_keys, new_state.m_team_keys);
+		AppendHeartbeatExpires(connection, server_key, server_id, new_state);
+		Redis::AppendCommand(connection, "EXEC");
+		if (changed) {
+			Redis::AppendCommand(connection, "PUBLISH osbench.servers '\\update\\%s'", server_key.c_str());
+		}
+		Redis::Response resp = Redis::Flush(connection);
+		cost.round_trips++;
+		cost.commands += resp.values.size();
+		return !resp.values.empty() && resp.values.back().type != Redis::REDIS_RESPONSE_TYPE_ERROR;
+	}
+
+	static int ProbeSlot(Redis::Connection *connection, std::string key, HeartbeatCost &cost) {
+		Redis::Response resp = Redis::Command(connection, 0, "EXISTS %s", key.c_str());
+		cost.round_trips++;
+		cost.commands++;
+		if (resp.values.empty()) {
+			return -1;
+		}
+		Redis::Value v = resp.values.front();
+		if (v.type == Redis::REDIS_RESPONSE_TYPE_INTEGER) {
+			return v.value._int;
+		}
+		else if (v.type == Redis::REDIS_RESPONSE_TYPE_STRING) {
+			return atoi(v.value._str.c_str());
+		}
+		return -1;
+	}
+
+	//the slots' missing columns are HDELed, and slots past the new player count DELed, one round trip each
+	static void ProbeSlots(Redis::Connection *connection, std::string key_prefix, std::map<std::string, std::vector<std::string> > &old_keys, std::map<std::string, std::vector<std::string> > &new_keys, HeartbeatCost &cost) {
+		std::vector<std::string> missing_keys;
+		std::map<std::string, std::vector<std::string> >::iterator it = old_keys.begin();
+		while (it != old_keys.end()) {
+			if (new_keys.find(it->first) == new_keys.end()) {
+				missing_keys.push_back(it->first);
+			}
+			it++;
+		}
+
+		int idx = 0;
+		while (true) {
+			//as the old path did, > and not >=, the first slot past the new count is kept
+			bool force_delete = new_keys.size() > 0 && idx > (int)new_keys.begin()->second.size();
+			std::ostringstream s;
+			s << key_prefix << idx++;
+			if (ProbeSlot(connection, s.str(), cost) <= 0) {
+				break;
+			}
+			if (force_delete) {
+				Redis::Command(connection, 0, "DEL %s", s.str().c_str());
+				cost.round_trips++;
+				cost.commands++;
+				continue;
+			}
+			std::vector<std::string>::iterator name_it = missing_keys.begin();
+			while (name_it != missing_keys.end()) {
+				Redis::Command(connection, 0, "HDEL %s %s", s.str().c_str(), name_it->c_str());
+				cost.round_trips++;
+				cost.commands++;
+				name_it++;
+			}
+		}
+	}
+
+	//the unchanged values are blanked, which the HSETs skip
+	static bool BlankUnchanged(std::map<std::string, std::vector<std::string> > &old_keys, std::map<std::string, std::vector<std::string> > &new_keys, std::map<std::string, std::vector<std::string> > &modified_keys) {
+		bool changed = false;
+		std::map<std::string, std::vector<std::string> >::iterator it = new_keys.begin();
+		while (it != new_keys.end()) {
+			std::vector<std::string> &old_column = old_keys[it->first];
+			std::vector<std::string> &column = modified_keys[it->first];
+			for (size_t i = 0; i < it->second.size(); i++) {
+				if (i < old_column.size() && old_column[i].compare(it->second[i]) == 0) {
+					column.push_back(std::string());
+				}
+				else {
+					column.push_back(it->second[i]);
+					changed = true;
+				}
+			}
+			it++;
+		}
+		return changed;
+	}
+
+	static void AppendSlotSets(Redis::Connection *connection, std::string key_prefix, std::map<std::string, std::vector<std::string> > &keys) {
+		std::map<std::string, std::vector<std::string> >::iterator it = keys.begin();
+		while (it != keys.end()) {
+			for (size_t i = 0; i < it->second.size(); i++) {
+				if (it->second[i].length() > 0) {
+					Redis::AppendCommand(connection, "HSET %s%d %s \"%s\"", key_prefix.c_str(), (int)i, it->first.c_str(), OS::escapeJSON(it->second[i]).c_str());
+				}
+			}
+			it++;
+		}
+	}
+
+	//MMPushTask::PerformDeleteMissingKeysAndUpdateChanged, as it was before the deltas
+	static bool SendProbing(Redis::Connection *connection, std::string server_key, int server_id, HeartbeatState &old_state, HeartbeatState &new_state, HeartbeatCost &cost) {
+		Redis::AppendCommand(connection, "SELECT %d", OS::ERedisDB_QR);
+		std::map<std::string, std::string>::iterator it = old_state.m_keys.begin();
+		while (it != old_state.m_keys.end()) {
+			if (new_state.m_keys.find(it->first) == new_state.m_keys.end()) {
+				Redis::AppendCommand(connection, "HDEL %scustkeys %s", server_key.c_str(), it->first.c_str());
+			}
+			it++;
+		}
+		cost.commands += Redis::Flush(connection).values.size();
+		cost.round_trips++;
+
+		ProbeSlots(connection, server_key + "custkeys_player_", old_state.m_player_keys, new_state.m_player_keys, cost);
+		ProbeSlots(connection, server_key + "custkeys_team_", old_state.m_team_keys, new_state.m_team_keys, cost);
+
+		HeartbeatState modified_state;
+		bool changed = false;
+		it = new_state.m_keys.begin();
+		while (it != new_state.m_keys.end()) {
+			if (old_state.m_keys[it->first].compare(it->second) != 0) {
+				modified_state.m_keys[it->first] = it->second;
+				changed = true;
+			}
+			it++;
+		}
+		changed |= BlankUnchanged(old_state.m_player_keys, new_state.m_player_keys, modified_state.m_player_keys);
+		changed |= BlankUnchanged(old_state.m_team_keys, new_state.m_team_keys, modified_state.m_team_keys);
+
+		//PushServer with the changed keys, one HSET per field, to refresh the expiry
+		Redis::AppendCommand(connection, "SELECT %d", OS::ERedisDB_QR);
+		Redis::AppendCommand(connection, "SET IPMAP_10.0.%d.%d-27900 %s", server_id >> 8, server_id & 255, server_key.c_str());
+		Redis::AppendCommand(connection, "HINCRBY %s num_beats 1", server_key.c_str());
+		it = modified_state.m_keys.begin();
+		while (it != modified_state.m_keys.end()) {
+			Redis::AppendCommand(connection, "HSET %scustkeys %s \"%s\"", server_key.c_str(), it->first.c_str(), OS::escapeJSON(it->second).c_str());
+			it++;
+		}
+		AppendSlotSets(connection, server_key + "custkeys_player_", modified_state.m_player_keys);
+		AppendSlotSets(connection, server_key + "custkeys_team_", modified_state.m_team_keys);
+		AppendHeartbeatExpires(connection, server_key, server_id, modified_state);
+		Redis::Response resp = Redis::Flush(connection);
+		cost.round_trips++;
+		cost.commands += resp.values.size();
+
+		if (changed) {
+			Redis::Command(connection, 0, "PUBLISH osbench.servers '\\update\\%s'", server_key.c_str());
+			cost.round_trips++;
+			cost.commands++;
+		}
+		return !resp.values.empty();
+	}
+
+	//what redis holds for the players must be the last heartbeat's, and no slot past it
+	static bool CheckPlayers(Redis::Connection *connection, std::string server_key, HeartbeatState &state) {
+		int num_slots = MM::GetNumSlots(state.m_player_keys);
+		Redis::AppendCommand(connection, "SELECT %d", OS::ERedisDB_QR);
+		for (int i = 0; i < HEARTBEAT_DELTA_PLAYERS; i++) {
+			Redis::AppendCommand(connection, "HGET %scustkeys_player_%d ping_", server_key.c_str(), i);
+		}
+		Redis::Response resp = Redis::Flush(connection);
+		if (resp.values.size() != HEARTBEAT_DELTA_PLAYERS + 1) {
+			return false;
+		}
+		for (int i = 0; i < HEARTBEAT_DELTA_PLAYERS; i++) {
+			Redis::Value &v = resp.values[i + 1];
+			if (i < num_slots) {
+				if (v.type != Redis::REDIS_RESPONSE_TYPE_STRING || v.value._str.compare(state.m_player_keys["ping_"][i]) != 0) {
+					return false;
+				}
+			}
+			else if (v.type != Redis::REDIS_RESPONSE_TYPE_NULL) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static void DeleteHeartbeatKeys(Redis::Connection *connection, std::string server_key, int server_id) {
+		Redis::AppendCommand(connection, "SELECT %d", OS::ERedisDB_QR);
+		Redis::AppendCommand(connection, "DEL %s %scustkeys", server_key.c_str(), server_key.c_str());
+		for (int i = 0; i < HEARTBEAT_DELTA_PLAYERS + 1; i++) {
+			Redis::AppendCommand(connection, "DEL %scustkeys_player_%d", server_key.c_str(), i);
+		}
+		for (int t = 0; t < 2; t++) {
+			Redis::AppendCommand(connection, "DEL %scustkeys_team_%d", server_key.c_str(), t);
+		}
+		Redis::AppendCommand(connection, "DEL IPMAP_10.0.%d.%d-27900", server_id >> 8, server_id & 255);
+		Redis::Flush(connection);
+	}
+
+	int RunHeartbeatDeltaBench(const char *redis_address, int heartbeats) {
+		struct timeval t;
+		t.tv_usec = 0;
+		t.tv_sec = 5;
+
+		Redis::Connection *connection = Redis::Connect(redis_address, t);
+		if (connection == NULL || Redis::Command(connection, 0, "PING").values.empty()) {
+			fprintf(stderr, "can't reach redis at %s\n", redis_address);
+			if (connection) {
+				Redis::Disconnect(connection);
+			}
+			return EXIT_FAILURE;
+		}
+
+		int server_id = 1;
+		std::ostringstream s;
+		s << HEARTBEAT_DELTA_GAMENAME << ":0:" << server_id << ":";
+		std::string server_key = s.str();
+
+		printf("%d heartbeats of a %d player server to %s\n", heartbeats, HEARTBEAT_DELTA_PLAYERS, redis_address);
+		printf("%-12s %-8s %12s %12s %12s %14s\n", "scenario", "mode", "hb/s", "p99 us", "commands/hb", "round trips/hb");
+
+		int ret = EXIT_SUCCESS;
+		for (int scenario = 0; scenario < EHeartbeatScenario_Count && ret == EXIT_SUCCESS; scenario++) {
+			for (int delta = 0; delta < 2; delta++) {
+				DeleteHeartbeatKeys(connection, server_key, server_id);
+				HeartbeatState old_state = BuildHeartbeat((EHeartbeatScenario)scenario, 0);
+				PushHeartbeat(connection, server_key, server_id, old_state);
+
+				OS::LatencyHistogram histogram("bench_heartbeat_delta", "Latency of one heartbeat's writes");
+				HeartbeatCost cost;
+				cost.round_trips = 0;
+				cost.commands = 0;
+				uint64_t start = OS::GetMonotonicTimeUS();
+				for (int i = 1; i <= heartbeats; i++) {
+					HeartbeatState new_state = BuildHeartbeat((EHeartbeatScenario)scenario, i);
+					uint64_t heartbeat_start = OS::GetMonotonicTimeUS();
+					bool sent = delta ? SendDelta(connection, server_key, server_id, old_state, new_state, cost) : SendProbing(connection, server_key, server_id, old_state, new_state, cost);
+					histogram.Record(OS::GetMonotonicTimeUS() - heartbeat_start);
+					if (!sent) {
+						fprintf(stderr, "redis at %s failed a heartbeat\n", redis_address);
+						ret = EXIT_FAILURE;
+						break;
+					}
+					old_state = new_state;
+				}
+				uint64_t elapsed = OS::GetMonotonicTimeUS() - start;
+				if (ret != EXIT_SUCCESS) {
+					break;
+				}
+				if (delta && !CheckPlayers(connection, server_key, old_state)) {
+					fprintf(stderr, "%s: redis doesn't hold the last heartbeat's players\n", heartbeat_scenarios[scenario]);
+					ret = EXIT_FAILURE;
+				}
+				printf("%-12s %-8s %12.0f %12llu %12.1f %14.1f\n", heartbeat_scenarios[scenario], delta ? "delta" : "probing", elapsed ? heartbeats * 1000000.0 / elapsed : 0,
+					(unsigned long long)histogram.GetPercentile(0.99), (double)cost.commands / heartbeats, (double)cost.round_trips / heartbeats);
+			}
+		}
+
+		DeleteHeartbeatKeys(connection, server_key, server_id);
+		Redis::Disconnect(connection);
+		return ret;
+	}
+}
@@ -0,0 +1,20 @@
+#ifndef _BENCH_HEARTBEATDELTABENCH_H
+#define _BENCH_HEARTBEATDELTABENCH_H
+
+#define HEARTBEAT_DELTA_DEFAULT_HEARTBEATS 2000
+#define HEARTBEAT_DELTA_GAMENAME "osbench_delta" //the server's keys are written under it in the QR db, and deleted afterwards
+#define HEARTBEAT_DELTA_PLAYERS 64
+#define HEARTBEAT_DELTA_LEFT_PLAYERS 48 //player count the join/leave scenario alternates with
+#define HEARTBEAT_DELTA_CHURN 4 //1 in this many players changes ping and score each heartbeat
+
+namespace Bench {
+	/*
+		Against a redis-server, no daemons needed, times a 64 player server's heartbeats written the way
+		MMPushTask did before deltas, HDELs then EXISTS probing every player and team slot one round trip at a time,
+		then the changed fields one HSET each, and the way it does now, MM::AppendHashDelta/AppendSlotDeltas
+		against the last heartbeat in one MULTI, sent with one Flush.
+		Heartbeats are unchanged, change 1 in HEARTBEAT_DELTA_CHURN players' ping and score, or alternate players leaving and joining.
+	*/
+	int RunHeartbeatDeltaBench(const char *redis_address, int heartbeats);
+}
+#endif //_BENCH_HEARTBEATDELTABENCH_H
@@ -0,0 +1,98 @@
+#include "KVParseBench.h"
+#include <OS/OpenSpy.h>
+#include <OS/KVReader.h>
+#include <OS/Analytics/Instrument.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+namespace Bench {
+	typedef struct {
+		const char *name;
+		const char *packet; //as handed to handle_packet, split at \final\ with it removed
+	} KVParsePacket;
+
+	static const KVParsePacket kv_parse_packets[] = {
+		{"gp_login", "\\login\\\\challenge\\Zxq8BnBqrM4uTW3XeRlGfrwoUvKCa4kq\\uniquenick\\bench1\\response\\2c2b4b23a2d1b7c1d5e0f4a3b2c1d0e9\\port\\-15524\\productid\\10469\\gamename\\gmtest\\namespaceid\\1\\sdkrevision\\3\\quiet\\0\\id\\1"},
+		{"gp_status", "\\status\\1\\sesskey\\76214821\\statstring\\Online\\locstring\\gmtest://lobby/1"},
+		{"gp_ka", "\\ka\\"},
+		{"gs_auth", "\\auth\\\\gamename\\gmtest\\response\\0123456789abcdef0123456789abcdef\\port\\0\\id\\1"},
+		{"sm_search", "\\search\\\\sesskey\\0\\profileid\\0\\namespaceid\\1\\partnerid\\0\\nick\\bench1\\uniquenick\\\\email\\bench1@example.com\\gamename\\gmtest"},
+		{"qr1_heartbeat", "\\heartbeat\\27900\\gamename\\gmtest\\statechanged\\1"},
+	};
+
+	//the handlers' first reads, so the cost of looking values up is counted as well
+	static int DispatchPacket(OS::KVReader &data_parser) {
+		//a GP keep alive, \ka\ has no value so it parses to nothing
+		if (data_parser.Size() < 1) {
+			return 1;
+		}
+		switch (data_parser.GetKeyHashByIdx(0)) {
+			case OS::KVHash("login"):
+				if (data_parser.IsKeyByIdx(0, "login"))
+					return data_parser.GetValue("challenge").length() + data_parser.GetValueInt("namespaceid") + data_parser.GetValueInt("id");
+				break;
+			case OS::KVHash("status"):
+				if (data_parser.IsKeyByIdx(0, "status"))
+					return data_parser.GetValueInt("status") + data_parser.GetValue("statstring").length() + data_parser.GetValue("locstring").length();
+				break;
+			case OS::KVHash("auth"):
+				if (data_parser.IsKeyByIdx(0, "auth"))
+					return data_parser.GetValue("gamename").length() + data_parser.GetValue("response").length() + data_parser.GetValueInt("id");
+				break;
+			case OS::KVHash("search"):
+				if (data_parser.IsKeyByIdx(0, "search"))
+					return data_parser.GetValueInt("namespaceid") + data_parser.GetValue("nick").length() + data_parser.GetValue("email").length();
+				break;
+			case OS::KVHash("heartbeat"):
+				if (data_parser.IsKeyByIdx(0, "heartbeat"))
+					return data_parser.GetValueInt("heartbeat") + data_parser.GetValue("gamename").length();
+				break;
+		}
+		return 0;
+	}
+
+	//a full server's heartbeat, enough pairs to spill past the inline ones and dedupe through the key table
+	static std::string BuildPlayersPacket(int num_players) {
+		std::string packet = "\\heartbeat\\27900\\gamename\\gmtest\\hostname\\bench\\numplayers\\" + std::to_string(num_players);
+		for (int i = 0; i < num_players; i++) {
+			std::string idx = std::to_string(i);
+			packet += "\\player_" + idx + "\\bench" + idx + "\\score_" + idx + "\\" + std::to_string(i * 10) + "\\ping_" + idx + "\\50";
+		}
+		return packet;
+	}
+	static bool TimePacket(const char *name, const char *packet, int iterations) {
+		int len = strlen(packet);
+		uint64_t checksum = 0;
+
+		uint64_t start = OS::GetMonotonicTimeUS();
+		for (int j = 0; j < iterations; j++) {
+			OS::KVReader data_parser(packet, len);
+			checksum += DispatchPacket(data_parser);
+		}
+		uint64_t elapsed = OS::GetMonotonicTimeUS() - start;
+		if (checksum == 0) {
+			fprintf(stderr, "%s wasn't dispatched\n", name);
+			return false;
+		}
+
+		double ns = elapsed * 1000.0 / iterations;
+		printf("%-16s %12.1f %12.0f\n", name, ns, ns > 0 ? 1000000000.0 / ns : 0);
+		return true;
+	}
+
+	int RunKVParseBench(int iterations) {
+		printf("%-16s %12s %12s\n", "packet", "ns/packet", "packets/s");
+		for (size_t i = 0; i < sizeof(kv_parse_packets) / sizeof(KVParsePacket); i++) {
+			if (!TimePacket(kv_parse_packets[i].name, kv_parse_packets[i].packet, iterations)) {
+				return EXIT_FAILURE;
+			}
+		}
+		std::string players_packet = BuildPlayersPacket(64);
+		if (!TimePacket("qr1_64_players", players_packet.c_str(), iterations)) {
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+}
@@ -0,0 +1,13 @@
+#ifndef _BENCH_KVPARSEBENCH_H
+#define _BENCH_KVPARSEBENCH_H
+
+#define KV_PARSE_DEFAULT_ITERATIONS 1000000
+
+namespace Bench {
+	/*
+		In process, no daemons needed, times parsing and dispatching captured packets the way the peers' handle_packet does,
+		then reading the values their handlers read.
+	*/
+	int RunKVParseBench(int iterations);
+}
+#endif //_BENCH_KVPARSEBENCH_H
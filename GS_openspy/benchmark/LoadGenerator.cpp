@@ -0,0 +1,173 @@
+#include "LoadGenerator.h"
+#include "BenchSocket.h"
+#include <stdio.h>
+#include <string.h>
+#include <sstream>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+namespace Bench {
+	LoadGenerator::LoadGenerator(const Options &options) : m_options(options) {
+		mp_histogram = NULL;
+		m_running = false;
+		m_measuring = false;
+	}
+	LoadGenerator::~LoadGenerator() {
+		if (mp_histogram) {
+			delete mp_histogram;
+		}
+	}
+	void *LoadGenerator::ClientThread(OS::CThread *thread) {
+		ClientContext *context = (ClientContext *)thread->getParams();
+		LoadGenerator *generator = context->generator;
+		bool ready = false;
+		while (generator->m_running) {
+			if (!ready) {
+				ready = context->client->Setup();
+				if (!ready) {
+					if (generator->m_measuring) {
+						context->errors++;
+					}
+					OS::Sleep(BENCH_SETUP_RETRY_TIME);
+				}
+				continue;
+			}
+			uint64_t start = OS::GetMonotonicTimeUS();
+			bool success = context->client->RunOp();
+			uint64_t latency = OS::GetMonotonicTimeUS() - start;
+
+			//ops finishing after the window closed aren't counted, the same as ops finishing before it opened
+			if (generator->m_measuring) {
+				if (success) {
+					generator->mp_histogram->Record(latency);
+					context->ops++;
+				}
+				else {
+					context->errors++;
+				}
+			}
+			//a failed client reconnects, rather than timing out over and over on a dead session, and backs off
+			//so a daemon refusing connections isn't counted as thousands of errors a second
+			ready = success;
+			if (!success) {
+				OS::Sleep(BENCH_SETUP_RETRY_TIME);
+			}
+		}
+		context->finished = true;
+		return NULL;
+	}
+	Result LoadGenerator::Run(const Scenario *scenario) {
+		Result result;
+		std::vector<ClientContext *> contexts;
+		std::vector<OS::CThread *> threads;
+
+		if (mp_histogram) {
+			delete mp_histogram;
+		}
+		mp_histogram = new OS::LatencyHistogram("bench_op", "Latency of the scenario's operations");
+
+		m_running = true;
+		m_measuring = false;
+		for (int i = 0; i < m_options.num_clients; i++) {
+			ClientContext *context = new ClientContext;
+			context->generator = this;
+			context->client = scenario->factory(m_options, i);
+			context->ops = 0;
+			context->errors = 0;
+			context->finished = false;
+			contexts.push_back(context);
+			threads.push_back(OS::CreateThread(LoadGenerator::ClientThread, context, true));
+		}
+
+		OS::Sleep(m_options.warmup * 1000);
+
+		uint64_t daemon_cpu_start = GetDaemonCPUTimeUS(scenario);
+		uint64_t self_cpu_start = GetSelfCPUTimeUS();
+		uint64_t start = OS::GetMonotonicTimeUS();
+		m_measuring = true;
+
+		OS::Sleep(m_options.duration * 1000);
+
+		m_measuring = false;
+		uint64_t elapsed = OS::GetMonotonicTimeUS() - start;
+		uint64_t daemon_cpu_end = GetDaemonCPUTimeUS(scenario);
+		uint64_t self_cpu = GetSelfCPUTimeUS() - self_cpu_start;
+
+		//let in flight ops finish, so nothing is cancelled holding a half read reply
+		m_running = false;
+		uint64_t deadline = OS::GetMonotonicTimeUS() + (BENCH_RECV_TIMEOUT + BENCH_SETUP_RETRY_TIME) * 1000ULL;
+		for (size_t i = 0; i < contexts.size(); i++) {
+			while (!contexts[i]->finished && OS::GetMonotonicTimeUS() < deadline) {
+				OS::Sleep(BENCH_STOP_POLL_TIME);
+			}
+		}
+
+		result.scenario = scenario->name;
+		result.num_clients = m_options.num_clients;
+		result.ops = 0;
+		result.errors = 0;
+		for (size_t i = 0; i < contexts.size(); i++) {
+			delete threads[i];
+			result.ops += contexts[i]->ops;
+			result.errors += contexts[i]->errors;
+			delete contexts[i]->client;
+			delete contexts[i];
+		}
+
+		result.ops_per_sec = elapsed ? (double)result.ops * 1000000.0 / elapsed : 0.0;
+		result.p50_us = mp_histogram->GetPercentile(0.5);
+		result.p99_us = mp_histogram->GetPercentile(0.99);
+		result.p999_us = mp_histogram->GetPercentile(0.999);
+		if (daemon_cpu_start == BENCH_NO_CPU_TIME || daemon_cpu_end == BENCH_NO_CPU_TIME) {
+			result.daemon_cpu_us_per_op = -1;
+		}
+		else {
+			result.daemon_cpu_us_per_op = result.ops ? (double)(daemon_cpu_end - daemon_cpu_start) / result.ops : 0.0;
+		}
+		result.bench_cpu_us_per_op = result.ops ? (double)self_cpu / result.ops : 0.0;
+		return result;
+	}
+	uint64_t LoadGenerator::GetDaemonCPUTimeUS(const Scenario *scenario) {
+		uint64_t total = 0;
+		bool found = false;
+		std::stringstream services(scenario->services);
+		std::string service;
+		while (std::getline(services, service, ',')) {
+			std::map<std::string, int>::const_iterator it = m_options.daemon_pids.find(service);
+			if (it == m_options.daemon_pids.end()) {
+				continue;
+			}
+			#ifndef _WIN32
+				char path[64], stat[1024];
+				snprintf(path, sizeof(path), "/proc/%d/stat", (*it).second);
+				FILE *fd = fopen(path, "rb");
+				if (!fd) {
+					continue;
+				}
+				size_t len = fread(stat, 1, sizeof(stat) - 1, fd);
+				fclose(fd);
+				stat[len] = 0;
+
+				//the process name can contain spaces, the fields are counted from after it, utime and stime are the 14th and 15th
+				char *p = strrchr(stat, ')');
+				unsigned long long utime, stime;
+				if (!p || sscanf(p + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime) != 2) {
+					continue;
+				}
+				total += (utime + stime) * 1000000ULL / sysconf(_SC_CLK_TCK);
+				found = true;
+			#endif
+		}
+		return found ? total : BENCH_NO_CPU_TIME;
+	}
+	uint64_t LoadGenerator::GetSelfCPUTimeUS() {
+		#ifndef _WIN32
+			struct rusage usage;
+			getrusage(RUSAGE_SELF, &usage);
+			return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ULL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+		#else
+			return 0;
+		#endif
+	}
+}
@@ -0,0 +1,112 @@
+#ifndef _BENCH_LOADGENERATOR_H
+#define _BENCH_LOADGENERATOR_H
+#include <OS/OpenSpy.h>
+#include <OS/Thread.h>
+#include <OS/Analytics/Instrument.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#define BENCH_DEFAULT_HOST "127.0.0.1"
+#define BENCH_DEFAULT_CLIENTS 8
+#define BENCH_DEFAULT_DURATION 10 //seconds measured per scenario
+#define BENCH_DEFAULT_WARMUP 2 //seconds run before measuring, so connections and caches are settled
+#define BENCH_DEFAULT_SEED 1
+#define BENCH_DEFAULT_SERVERS 200 //servers registered for the list scenarios
+#define BENCH_DEFAULT_GAMENAME "gmtest" //from redis_init_dbg.txt
+#define BENCH_DEFAULT_SECRETKEY "HA6zkS"
+#define BENCH_DEFAULT_FILTER "numplayers > 4 and gametype = 'ctf'"
+#define BENCH_SETUP_RETRY_TIME 1000 //ms to wait before setting a client up again after it failed
+#define BENCH_STOP_POLL_TIME 10 //ms, how often a finished run checks its clients have stopped
+#define BENCH_NO_CPU_TIME ((uint64_t)-1)
+
+namespace Bench {
+	typedef struct {
+		std::string host;
+		int num_clients;
+		int duration;
+		int warmup;
+		uint32_t seed;
+
+		int num_servers;
+		std::string gamename;
+		std::string secretkey;
+		std::string filter;
+
+		std::map<std::string, int> daemon_pids; //by service name, for the CPU per op column
+	} Options;
+
+	/*
+		One simulated client, owned and driven by a single generator thread.
+		Setup isn't timed, RunOp is, and is called back to back for as long as the scenario runs.
+	*/
+	class Client {
+	public:
+		Client(const Options &options, int index) { mp_options = &options; m_index = index; m_rand_state = options.seed * 1000003 + index; };
+		virtual ~Client() { };
+		virtual bool Setup() = 0;
+		virtual bool RunOp() = 0;
+	protected:
+		//deterministic per client, so runs with the same seed send the same traffic
+		uint32_t Rand() { m_rand_state = m_rand_state * 1103515245 + 12345; return (m_rand_state >> 8) & 0xFFFFFF; };
+
+		const Options *mp_options;
+		int m_index;
+		uint32_t m_rand_state;
+	};
+
+	typedef Client *(*ClientFactory)(const Options &options, int index);
+
+	typedef struct {
+		const char *name;
+		const char *services; //comma separated, the daemons whose CPU time is charged to the scenario
+		const char *description;
+		ClientFactory factory;
+		bool needs_servers; //runs against the registered server population
+	} Scenario;
+
+	const Scenario *FindScenario(std::string name);
+	const std::vector<Scenario> &GetScenarios();
+
+	typedef struct {
+		std::string scenario;
+		int num_clients;
+		uint64_t ops;
+		uint64_t errors;
+		double ops_per_sec;
+		uint64_t p50_us;
+		uint64_t p99_us;
+		uint64_t p999_us;
+		double daemon_cpu_us_per_op; //-1 when no pid was given for the scenario's services
+		double bench_cpu_us_per_op;
+	} Result;
+
+	/*
+		Closed loop, every client thread starts its next operation as soon as the last one finished,
+		so throughput is bounded by the daemon's latency and the client count sets the concurrency.
+	*/
+	class LoadGenerator {
+	public:
+		LoadGenerator(const Options &options);
+		~LoadGenerator();
+		Result Run(const Scenario *scenario);
+	private:
+		static void *ClientThread(OS::CThread *thread);
+		uint64_t GetDaemonCPUTimeUS(const Scenario *scenario);
+		static uint64_t GetSelfCPUTimeUS();
+
+		typedef struct {
+			LoadGenerator *generator;
+			Client *client;
+			uint64_t ops;
+			uint64_t errors;
+			volatile bool finished;
+		} ClientContext;
+
+		const Options &m_options;
+		OS::LatencyHistogram *mp_histogram;
+		volatile bool m_running;
+		volatile bool m_measuring;
+	};
+}
+#endif //_BENCH_LOADGENERATOR_H
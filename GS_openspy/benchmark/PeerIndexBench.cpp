@@ -0,0 +1,175 @@
+#include "PeerIndexBench.h"
+#include <OS/OpenSpy.h>
+#include <OS/Net/NetPeerIndex.h>
+#include <OS/Analytics/Instrument.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+
+namespace Bench {
+	//stands in for a QR::Peer, which is allocated on its own, so the scan misses the cache the way the drivers' did
+	typedef struct {
+		struct sockaddr_in address;
+		uint64_t heartbeats;
+		size_t population_slot; //in PeerIndexPopulation::m_peers, so deleting it isn't a scan of its own
+		char state[480];
+	} BenchPeer;
+
+	static const int peer_index_counts[] = {1000, 10000, 100000};
+
+	class PeerIndexPopulation {
+	public:
+		PeerIndexPopulation(int num_peers) {
+			m_next_address = 0;
+			m_rand_state = num_peers;
+			for (int i = 0; i < num_peers; i++) {
+				Create();
+			}
+		}
+		~PeerIndexPopulation() {
+			for (size_t i = 0; i < m_peers.size(); i++) {
+				delete m_peers[i];
+			}
+		}
+		//a heartbeat from a registered server, or once every PEER_INDEX_CHURN from a new one
+		struct sockaddr_in NextAddress() {
+			Rand();
+			if ((m_rand_state >> 8) % PEER_INDEX_CHURN == 0) {
+				return MakeAddress(m_next_address);
+			}
+			return m_peers[(m_rand_state >> 8) % m_peers.size()]->address;
+		}
+		BenchPeer *Create() {
+			BenchPeer *peer = new BenchPeer;
+			memset(peer, 0, sizeof(BenchPeer));
+			peer->address = MakeAddress(m_next_address++);
+			peer->population_slot = m_peers.size();
+			m_peers.push_back(peer);
+			m_order.push_back(peer);
+			return peer;
+		}
+		//oldest first
+		const std::deque<BenchPeer *> &GetPeers() { return m_order; };
+		//the oldest peer, as it would time out, the caller removes it from its index before it's freed
+		BenchPeer *Oldest() {
+			return m_order.front();
+		}
+		void DeleteOldest() {
+			BenchPeer *peer = m_order.front();
+			m_order.pop_front();
+			m_peers[peer->population_slot] = m_peers.back();
+			m_peers[peer->population_slot]->population_slot = peer->population_slot;
+			m_peers.pop_back();
+			delete peer;
+		}
+	private:
+		static struct sockaddr_in MakeAddress(uint32_t n) {
+			struct sockaddr_in address;
+			memset(&address, 0, sizeof(address));
+			address.sin_family = AF_INET;
+			address.sin_addr.s_addr = htonl(0x0A000000 | (n >> 4));
+			address.sin_port = htons(27000 + (n & 15));
+			return address;
+		}
+		void Rand() { m_rand_state = m_rand_state * 1103515245 + 12345; };
+
+		std::vector<BenchPeer *> m_peers; //for picking a registered server
+		std::deque<BenchPeer *> m_order;
+		uint32_t m_next_address;
+		uint32_t m_rand_state;
+	};
+
+	//the drivers' find_or_create before the index, a scan of m_connections
+	static BenchPeer *ScanFind(std::vector<BenchPeer *> &connections, const struct sockaddr_in *address) {
+		std::vector<BenchPeer *>::iterator it = connections.begin();
+		while (it != connections.end()) {
+			BenchPeer *peer = *it;
+			if (address->sin_port == peer->address.sin_port && address->sin_addr.s_addr == peer->address.sin_addr.s_addr) {
+				return peer;
+			}
+			it++;
+		}
+		return NULL;
+	}
+	static void ScanRemove(std::vector<BenchPeer *> &connections, BenchPeer *peer) {
+		std::vector<BenchPeer *>::iterator it = connections.begin();
+		while (it != connections.end()) {
+			if (*it == peer) {
+				connections.erase(it);
+				return;
+			}
+			it++;
+		}
+	}
+
+	static double RunScan(int num_peers, int heartbeats, OS::CMutex *mutex) {
+		PeerIndexPopulation population(num_peers);
+		std::vector<BenchPeer *> connections(population.GetPeers().begin(), population.GetPeers().end());
+
+		uint64_t start = OS::GetMonotonicTimeUS();
+		for (int i = 0; i < heartbeats; i++) {
+			struct sockaddr_in address = population.NextAddress();
+			mutex->lock();
+			BenchPeer *peer = ScanFind(connections, &address);
+			if (peer == NULL) {
+				BenchPeer *oldest = population.Oldest();
+				ScanRemove(connections, oldest);
+				population.DeleteOldest();
+				peer = population.Create();
+				connections.push_back(peer);
+			}
+			peer->heartbeats++;
+			mutex->unlock();
+		}
+		uint64_t elapsed = OS::GetMonotonicTimeUS() - start;
+		return elapsed ? heartbeats * 1000000.0 / elapsed : 0;
+	}
+
+	static double RunIndex(int num_peers, int heartbeats, OS::CMutex *mutex) {
+		PeerIndexPopulation population(num_peers);
+		NetPeerIndex<BenchPeer> index;
+		std::deque<BenchPeer *>::const_iterator it = population.GetPeers().begin();
+		while (it != population.GetPeers().end()) {
+			index.Insert(&(*it)->address, *it);
+			it++;
+		}
+
+		uint64_t start = OS::GetMonotonicTimeUS();
+		for (int i = 0; i < heartbeats; i++) {
+			struct sockaddr_in address = population.NextAddress();
+			mutex->lock();
+			BenchPeer *peer = index.Find(&address);
+			if (peer == NULL) {
+				BenchPeer *oldest = population.Oldest();
+				index.Remove(&oldest->address, oldest);
+				population.DeleteOldest();
+				peer = population.Create();
+				index.Insert(&peer->address, peer);
+			}
+			peer->heartbeats++;
+			mutex->unlock();
+		}
+		uint64_t elapsed = OS::GetMonotonicTimeUS() - start;
+		return elapsed ? heartbeats * 1000000.0 / elapsed : 0;
+	}
+
+	int RunPeerIndexBench(int heartbeats) {
+		OS::CMutex *mutex = OS::CreateMutex();
+		printf("%-10s %16s %16s %10s\n", "peers", "scan hb/s", "index hb/s", "speedup");
+		for (size_t i = 0; i < sizeof(peer_index_counts) / sizeof(int); i++) {
+			int num_peers = peer_index_counts[i];
+			//the scan costs O(peers) a heartbeat, so it's given proportionally fewer to finish in about the same time
+			int scan_heartbeats = heartbeats / (num_peers / 1000 > 0 ? num_peers / 1000 : 1) / 10;
+			if (scan_heartbeats < 1000) {
+				scan_heartbeats = 1000;
+			}
+			double scan_rate = RunScan(num_peers, scan_heartbeats, mutex);
+			double index_rate = RunIndex(num_peers, heartbeats, mutex);
+			printf("%-10d %16.0f %16.0f %9.1fx\n", num_peers, scan_rate, index_rate, scan_rate > 0 ? index_rate / scan_rate : 0);
+		}
+		delete mutex;
+		return EXIT_SUCCESS;
+	}
+}
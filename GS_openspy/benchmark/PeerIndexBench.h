@@ -0,0 +1,14 @@
+#ifndef _BENCH_PEERINDEXBENCH_H
+#define _BENCH_PEERINDEXBENCH_H
+
+#define PEER_INDEX_DEFAULT_HEARTBEATS 1000000
+#define PEER_INDEX_CHURN 100 //one heartbeat in this many is from a new server, replacing the oldest one
+
+namespace Bench {
+	/*
+		In process, no daemons needed, times the QR/NN drivers' per datagram peer lookup at 1k, 10k and 100k peers,
+		through NetPeerIndex and through the linear m_connections scan it replaced.
+	*/
+	int RunPeerIndexBench(int heartbeats);
+}
+#endif //_BENCH_PEERINDEXBENCH_H
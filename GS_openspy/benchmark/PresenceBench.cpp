@@ -0,0 +1,128 @@
+#include "PresenceBench.h"
+#include <OS/OpenSpy.h>
+#include <OS/Analytics/Instrument.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <vector>
+
+namespace Bench {
+	//stands in for a GP::Peer, its buddy list keyed the same way, the value would be the buddy's last status
+	typedef struct {
+		int profileid;
+		std::map<int, int> buddies;
+		uint64_t delivered;
+	} PresencePeer;
+
+	//one GP instance
+	typedef struct {
+		std::vector<PresencePeer *> peers;
+		std::map<int, std::vector<PresencePeer *> > watchers; //PresenceRouter's reverse buddy index, its keys are the subscribed channels
+	} PresenceNode;
+
+	static uint32_t PresenceRand(uint32_t &rand_state) {
+		rand_state = rand_state * 1103515245 + 12345;
+		return rand_state >> 8;
+	}
+
+	//each instance has the whole status change decoded and scans all of its peers
+	static uint64_t DeliverBroadcast(std::vector<PresenceNode> &nodes, int profileid, uint64_t &messages) {
+		uint64_t delivered = 0;
+		for (size_t n = 0; n < nodes.size(); n++) {
+			messages++;
+			std::vector<PresencePeer *>::iterator it = nodes[n].peers.begin();
+			while (it != nodes[n].peers.end()) {
+				PresencePeer *peer = *it;
+				if (peer->buddies.find(profileid) != peer->buddies.end()) {
+					peer->delivered++;
+					delivered++;
+				}
+				it++;
+			}
+		}
+		return delivered;
+	}
+
+	//only instances subscribed to the profile's channel receive it
+	static uint64_t DeliverRouted(std::vector<PresenceNode> &nodes, int profileid, uint64_t &messages) {
+		uint64_t delivered = 0;
+		for (size_t n = 0; n < nodes.size(); n++) {
+			std::map<int, std::vector<PresencePeer *> >::iterator it = nodes[n].watchers.find(profileid);
+			if (it == nodes[n].watchers.end()) {
+				continue;
+			}
+			messages++;
+			std::vector<PresencePeer *>::iterator it2 = (*it).second.begin();
+			while (it2 != (*it).second.end()) {
+				(*it2)->delivered++;
+				delivered++;
+				it2++;
+			}
+		}
+		return delivered;
+	}
+
+	int RunPresenceBench(int updates) {
+		uint32_t rand_state = 1;
+		std::vector<PresencePeer> peers(PRESENCE_BENCH_USERS);
+		std::vector<PresenceNode> nodes(PRESENCE_BENCH_NODES);
+		for (int i = 0; i < PRESENCE_BENCH_USERS; i++) {
+			PresencePeer &peer = peers[i];
+			peer.profileid = i;
+			peer.delivered = 0;
+			while (peer.buddies.size() < PRESENCE_BENCH_BUDDIES) {
+				peer.buddies[PresenceRand(rand_state) % PRESENCE_BENCH_USERS] = 0;
+			}
+			PresenceNode &node = nodes[i % PRESENCE_BENCH_NODES];
+			node.peers.push_back(&peer);
+			std::map<int, int>::iterator it = peer.buddies.begin();
+			while (it != peer.buddies.end()) {
+				node.watchers[(*it).first].push_back(&peer);
+				it++;
+			}
+		}
+
+		std::vector<int> profileids(updates);
+		for (int i = 0; i < updates; i++) {
+			profileids[i] = PresenceRand(rand_state) % PRESENCE_BENCH_USERS;
+		}
+
+		printf("%d online users on %d instances, %d buddies each, %d status changes\n", PRESENCE_BENCH_USERS, PRESENCE_BENCH_NODES, PRESENCE_BENCH_BUDDIES, updates);
+		size_t channels = 0;
+		for (size_t n = 0; n < nodes.size(); n++) {
+			channels += nodes[n].watchers.size();
+		}
+		printf("%.0f channels subscribed per instance\n", (double)channels / nodes.size());
+
+		//the scan costs O(users) a change, so it's given proportionally fewer
+		int broadcast_updates = updates / 500 > 0 ? updates / 500 : 1;
+		uint64_t broadcast_messages = 0, broadcast_delivered = 0;
+		uint64_t start = OS::GetMonotonicTimeUS();
+		for (int i = 0; i < broadcast_updates; i++) {
+			broadcast_delivered += DeliverBroadcast(nodes, profileids[i], broadcast_messages);
+		}
+		uint64_t broadcast_time = OS::GetMonotonicTimeUS() - start;
+
+		uint64_t routed_messages = 0, routed_delivered = 0;
+		start = OS::GetMonotonicTimeUS();
+		for (int i = 0; i < updates; i++) {
+			routed_delivered += DeliverRouted(nodes, profileids[i], routed_messages);
+		}
+		uint64_t routed_time = OS::GetMonotonicTimeUS() - start;
+
+		//both deliver the same changes to the same peers, compare over the changes the broadcast ran
+		uint64_t check_messages = 0, check_delivered = 0;
+		for (int i = 0; i < broadcast_updates; i++) {
+			check_delivered += DeliverRouted(nodes, profileids[i], check_messages);
+		}
+
+		printf("%-10s %10s %16s %16s %14s\n", "mode", "changes", "msgs/change", "deliveries", "us/change");
+		printf("%-10s %10d %16.2f %16.2f %14.2f\n", "broadcast", broadcast_updates, (double)broadcast_messages / broadcast_updates, (double)broadcast_delivered / broadcast_updates, (double)broadcast_time / broadcast_updates);
+		printf("%-10s %10d %16.2f %16.2f %14.2f\n", "routed", updates, (double)routed_messages / updates, (double)routed_delivered / updates, (double)routed_time / updates);
+		if (check_delivered != broadcast_delivered) {
+			fprintf(stderr, "routing delivered %llu status changes where broadcasting delivered %llu\n", (unsigned long long)check_delivered, (unsigned long long)broadcast_delivered);
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+}
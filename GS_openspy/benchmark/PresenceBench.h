@@ -0,0 +1,17 @@
+#ifndef _BENCH_PRESENCEBENCH_H
+#define _BENCH_PRESENCEBENCH_H
+
+#define PRESENCE_BENCH_DEFAULT_UPDATES 100000
+#define PRESENCE_BENCH_USERS 100000 //online across every instance
+#define PRESENCE_BENCH_NODES 8 //GP instances, users are spread evenly over them
+#define PRESENCE_BENCH_BUDDIES 50 //per user, picked at random from every online user
+
+namespace Bench {
+	/*
+		In process, no daemons needed, times delivering status changes to every instance's peers:
+		broadcast on presence.buddies with each instance scanning its peers' buddy lists, as GP did before PresenceRouter,
+		and routed to the instances subscribed to the profile's channel, which look its watchers up in their reverse buddy index.
+	*/
+	int RunPresenceBench(int updates);
+}
+#endif //_BENCH_PRESENCEBENCH_H
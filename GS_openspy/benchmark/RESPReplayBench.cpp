@@ -0,0 +1,446 @@
+#include "RESPReplayBench.h"
+#include "RedisPushBench.h"
+#include <OS/OpenSpy.h>
+#include <OS/Redis.h>
+#include <OS/RedisParser.h>
+#include <OS/Analytics/Instrument.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace Bench {
+	typedef struct {
+		std::string name;
+		std::string reply; //raw RESP, exactly one reply
+	} RecordedReply;
+
+	//shaped like MMQuery's server snapshot script: {1, gameid, id, wan_port, wan_ip, custkeys, player keys, team keys} per key
+	static const char *resp_replay_snapshot_script = "local r = {} "
+		"for i, k in ipairs(KEYS) do "
+			"local h = redis.call('HMGET', k, 'gameid', 'id', 'wan_port', 'wan_ip') "
+			"local e = {1, h[1], h[2], h[3], h[4], redis.call('HGETALL', k .. 'custkeys')} "
+			"for t, name in ipairs({'custkeys_player_', 'custkeys_team_'}) do "
+				"local list = {} "
+				"local n = 0 "
+				"while redis.call('EXISTS', k .. name .. n) == 1 do "
+					"list[n + 1] = redis.call('HGETALL', k .. name .. n) "
+					"n = n + 1 "
+				"end "
+				"e[6 + t] = list "
+			"end "
+			"r[i] = e "
+		"end "
+		"return r";
+
+	/*
+		Redis::parse_response as it was before ReplyParser, each nesting level parses a substr copy of the rest of the input.
+		Only used as the reference the recordings are checked and timed against.
+	*/
+	namespace Legacy {
+		void parse_response(std::string resp_str, int &diff, Redis::Response *resp, Redis::ArrayValue *arr_val);
+		std::string read_line(std::string str) {
+			std::string r;
+			for (size_t i = 0; i < str.length(); i++) {
+				if (str[i] == '\r' && i + 1 < str.length()) {
+					if (str[i + 1] == '\n') {
+						return r;
+					}
+				}
+				r += str[i];
+			}
+			return r;
+		}
+		Redis::ArrayValue read_array(std::string str, int &diff, Redis::Response *resp, Redis::ArrayValue *arr_val) {
+			Redis::ArrayValue arr;
+			std::string len_line = read_line(str).substr(1);
+			int num_elements = atoi(len_line.c_str());
+			diff += len_line.length() + ENDLINE_STR_COUNT + 1; // +1 for the operator
+			if (diff > (int)str.length()) {
+				diff = str.length();
+			}
+			str = str.substr(diff);
+			for (int i = 0; i < num_elements; i++) {
+				int tdiff = 0;
+				Legacy::parse_response(str, tdiff, resp, &arr);
+				str = str.substr(tdiff);
+				diff += tdiff;
+			}
+			return arr;
+		}
+		Redis::Value read_scalar(std::string str, int &diff) {
+			Redis::Value v;
+			std::string info_line = read_line(str);
+			int str_len = 0;
+			int line_len = ENDLINE_STR_COUNT + info_line.length();
+			diff += line_len;
+
+			std::string info = str.substr(line_len);
+			switch (info_line[0]) {
+			case '$': //bulk str
+				str_len = atoi(info_line.substr(1).c_str());
+				if (str_len == -1) {
+					v.type = Redis::REDIS_RESPONSE_TYPE_NULL;
+				}
+				else {
+					v.type = Redis::REDIS_RESPONSE_TYPE_STRING;
+					v.value._str = info.substr(0, str_len);
+					diff += str_len + ENDLINE_STR_COUNT;
+				}
+				break;
+			case '+': //simple str
+				v.type = Redis::REDIS_RESPONSE_TYPE_STRING;
+				v.value._str = info_line.substr(1);
+				break;
+			case ':': //int
+				v.type = Redis::REDIS_RESPONSE_TYPE_INTEGER;
+				v.value._int = atoi(info_line.substr(1).c_str());
+				break;
+			case '-': //error
+				v.type = Redis::REDIS_RESPONSE_TYPE_ERROR;
+				v.value._str = info_line.substr(1);
+				break;
+			default:
+				break;
+			}
+			return v;
+		}
+		void parse_response(std::string resp_str, int &diff, Redis::Response *resp, Redis::ArrayValue *arr_val) {
+			std::string str = resp_str;
+			Redis::Value v;
+			int real_diff = diff;
+			diff = 0;
+			do {
+				if (str.length() == 0) break;
+				if (str[0] == '*') {
+					v.arr_value = read_array(str, diff, resp, arr_val);
+					v.type = Redis::REDIS_RESPONSE_TYPE_ARRAY;
+				}
+				else {
+					v = read_scalar(str, diff);
+				}
+				if (arr_val) {
+					arr_val->values.push_back(std::pair<Redis::REDIS_RESPONSE_TYPE, struct Redis::_Value>(v.type, v));
+				}
+				else {
+					resp->values.push_back(v);
+				}
+				if (diff > (int)str.length()) {
+					break;
+				}
+				str = str.substr(diff);
+				real_diff += diff;
+				diff = 0;
+			} while (str.length());
+			diff = real_diff;
+		}
+	}
+
+	//a canonical form of a Value tree, so trees from different parsers can be compared
+	static void SerializeValue(const Redis::Value &value, std::string &out) {
+		std::ostringstream s;
+		switch (value.type) {
+		case Redis::REDIS_RESPONSE_TYPE_STRING:
+			s << "S" << value.value._str.length() << ":";
+			out += s.str();
+			out += value.value._str;
+			break;
+		case Redis::REDIS_RESPONSE_TYPE_ERROR:
+			s << "E" << value.value._str.length() << ":";
+			out += s.str();
+			out += value.value._str;
+			break;
+		case Redis::REDIS_RESPONSE_TYPE_INTEGER:
+			s << "I" << value.value._int;
+			out += s.str();
+			break;
+		case Redis::REDIS_RESPONSE_TYPE_NULL:
+			out += "N";
+			break;
+		case Redis::REDIS_RESPONSE_TYPE_ARRAY:
+			s << "A" << value.arr_value.values.size() << "[";
+			out += s.str();
+			for (size_t i = 0; i < value.arr_value.values.size(); i++) {
+				SerializeValue(value.arr_value.values[i].second, out);
+				out += ",";
+			}
+			out += "]";
+			break;
+		}
+	}
+
+	static bool Record(Redis::Connection *connection, std::vector<RecordedReply> &replies, const char *name, std::string command) {
+		const Redis::ReplyValue *reply = Redis::CommandReply(connection, "%s", command.c_str());
+		if (reply == NULL || reply->type == Redis::REDIS_RESPONSE_TYPE_ERROR) {
+			fprintf(stderr, "recording %s failed\n", name);
+			return false;
+		}
+		RecordedReply recorded;
+		recorded.name = name;
+		recorded.reply.assign(connection->read_buff + connection->parser->GetStart(), connection->parser->GetEnd() - connection->parser->GetStart());
+		replies.push_back(recorded);
+		return true;
+	}
+
+	static bool RecordReplies(Redis::Connection *connection, std::vector<RecordedReply> &replies) {
+		std::ostringstream s;
+		for (int i = 0; i < RESP_REPLAY_SERVERS; i++) {
+			std::vector<std::string> commands = BuildPushCommands(RESP_REPLAY_GAMENAME, i);
+			for (size_t j = 0; j < commands.size(); j++) {
+				Redis::AppendCommand(connection, "%s", commands[j].c_str());
+			}
+			Redis::AppendCommand(connection, "HSET %s:0:%d: gameid 1 id %d wan_port 27900 wan_ip \"10.0.%d.%d\"", RESP_REPLAY_GAMENAME, i, i, i >> 8, i & 255);
+			if (Redis::Flush(connection).values.size() != commands.size() + 1) {
+				fprintf(stderr, "registering servers failed\n");
+				return false;
+			}
+		}
+
+		s << RESP_REPLAY_GAMENAME << ":0:0:";
+		std::string server_key = s.str();
+
+		s.str("");
+		s << "SELECT " << OS::ERedisDB_QR;
+		bool ok = Record(connection, replies, "qr_select", s.str());
+		ok = ok && Record(connection, replies, "qr_hincrby", "HINCRBY " + server_key + " num_beats 1");
+		Redis::Command(connection, 0, "MULTI");
+		for (int i = 0; i < 8; i++) {
+			s.str("");
+			s << "HSET " << server_key << "custkeys_player_" << i << " ping_ \"" << i << "\" score_ \"" << i * 10 << "\"";
+			Redis::Command(connection, 0, "%s", s.str().c_str());
+		}
+		ok = ok && Record(connection, replies, "qr_exec", "EXEC");
+		ok = ok && Record(connection, replies, "sb_hget", "HGET " + server_key + " gameid");
+		ok = ok && Record(connection, replies, "sb_hget_missing", "HGET " + server_key + " deleted");
+		ok = ok && Record(connection, replies, "sb_hscan", "HSCAN " + server_key + "custkeys 0 match *");
+		s.str("");
+		s << "ZSCAN " << RESP_REPLAY_GAMENAME << " 0 COUNT " << RESP_REPLAY_BATCH_SIZE;
+		ok = ok && Record(connection, replies, "sb_zscan", s.str());
+		s.str("");
+		s << "SCAN 0 MATCH " << RESP_REPLAY_GAMENAME << ":* COUNT 100000";
+		ok = ok && Record(connection, replies, "qr_scan", s.str());
+
+		s.str("");
+		s << "EVAL \"" << resp_replay_snapshot_script << "\" " << RESP_REPLAY_BATCH_SIZE;
+		for (int i = 0; i < RESP_REPLAY_BATCH_SIZE; i++) {
+			s << " \"" << RESP_REPLAY_GAMENAME << ":0:" << i << ":\"";
+		}
+		ok = ok && Record(connection, replies, "sb_snapshot", s.str());
+		return ok;
+	}
+
+	static void DeleteReplayKeys(Redis::Connection *connection) {
+		for (int i = 0; i < RESP_REPLAY_SERVERS; i++) {
+			DeletePushKeys(connection, RESP_REPLAY_GAMENAME, i);
+		}
+	}
+
+	//the whole reply in one buffer, as the reference the chunked and legacy parses are compared with
+	static bool ParseWhole(const std::string &data, std::string &serialized) {
+		Redis::ReplyParser parser;
+		if (parser.Parse(data.c_str(), data.length()) != 1 || parser.GetEnd() != (int)data.length()) {
+			return false;
+		}
+		Redis::Value value;
+		Redis::ToValue(parser.GetReply(), value);
+		serialized.clear();
+		SerializeValue(value, serialized);
+		return true;
+	}
+
+	/*
+		Delivers the reply in random sized pieces, moving it to a new buffer each time as ReadReply's realloc can,
+		the parser must ask for more until the last piece and then produce the same tree
+	*/
+	static bool ParseChunked(const std::string &data, uint32_t &rand_state, std::string &serialized) {
+		Redis::ReplyParser parser;
+		char *buff = NULL;
+		int len = 0;
+		int r = 0;
+		while (len < (int)data.length()) {
+			rand_state = rand_state * 1103515245 + 12345;
+			int chunk = 1 + (rand_state >> 8) % (rand_state & 1 ? 8 : 512);
+			if (chunk > (int)data.length() - len) {
+				chunk = data.length() - len;
+			}
+			char *new_buff = (char *)malloc(len + chunk);
+			if (buff) {
+				memcpy(new_buff, buff, len);
+				free(buff);
+			}
+			buff = new_buff;
+			memcpy(buff + len, data.c_str() + len, chunk);
+			len += chunk;
+
+			r = parser.Parse(buff, len);
+			if (r != 0 && len != (int)data.length()) {
+				break;
+			}
+		}
+		bool ok = r == 1 && parser.GetEnd() == (int)data.length();
+		if (ok) {
+			Redis::Value value;
+			Redis::ToValue(parser.GetReply(), value);
+			serialized.clear();
+			SerializeValue(value, serialized);
+		}
+		free(buff);
+		return ok;
+	}
+
+	static bool ParseLegacy(const std::string &data, std::string &serialized) {
+		Redis::Response response;
+		int diff = 0;
+		Legacy::parse_response(data, diff, &response, NULL);
+		if (response.values.size() != 1) {
+			return false;
+		}
+		serialized.clear();
+		SerializeValue(response.values[0], serialized);
+		return true;
+	}
+
+	/*
+		Corrupts a few bytes, favouring the ones RESP gives meaning to, or cuts the reply short.
+		Any result is accepted as long as a complete reply lies within the data
+	*/
+	static bool ParseMutated(const std::string &data, uint32_t &rand_state) {
+		static const char resp_bytes[] = "*$:+-\r\n0123456789";
+		std::string mutated = data;
+		int num_mutations = 1 + (rand_state >> 8) % 4;
+		for (int i = 0; i < num_mutations && !mutated.empty(); i++) {
+			rand_state = rand_state * 1103515245 + 12345;
+			size_t pos = (rand_state >> 8) % mutated.length();
+			switch ((rand_state >> 4) % 4) {
+			case 0:
+				mutated[pos] = resp_bytes[(rand_state >> 16) % (sizeof(resp_bytes) - 1)];
+				break;
+			case 1:
+				mutated[pos] = (char)(rand_state >> 16);
+				break;
+			case 2:
+				mutated.insert(pos, 1, resp_bytes[(rand_state >> 16) % (sizeof(resp_bytes) - 1)]);
+				break;
+			case 3:
+				mutated.resize(pos);
+				break;
+			}
+		}
+		//its own allocation, so reading past the end is caught by the sanitizers
+		char *buff = (char *)malloc(mutated.length() + 1);
+		memcpy(buff, mutated.c_str(), mutated.length());
+		Redis::ReplyParser parser;
+		bool ok = true;
+		if (parser.Parse(buff, mutated.length()) == 1) {
+			ok = parser.GetEnd() <= (int)mutated.length();
+			Redis::Value value;
+			Redis::ToValue(parser.GetReply(), value);
+		}
+		free(buff);
+		return ok;
+	}
+
+	static bool CheckReplies(const std::vector<RecordedReply> &replies, int rounds) {
+		uint32_t rand_state = 1;
+		bool ok = true;
+		printf("%-16s %10s %10s %12s %12s\n", "reply", "bytes", "legacy", "chunked", "mutated");
+		for (size_t i = 0; i < replies.size(); i++) {
+			const RecordedReply &recorded = replies[i];
+			std::string whole, legacy, chunked;
+			if (!ParseWhole(recorded.reply, whole)) {
+				fprintf(stderr, "%s doesn't parse\n", recorded.name.c_str());
+				return false;
+			}
+			bool legacy_matches = ParseLegacy(recorded.reply, legacy) && legacy.compare(whole) == 0;
+			int chunked_failures = 0, mutated_failures = 0;
+			for (int j = 0; j < rounds; j++) {
+				if (!ParseChunked(recorded.reply, rand_state, chunked) || chunked.compare(whole) != 0) {
+					chunked_failures++;
+				}
+				if (!ParseMutated(recorded.reply, rand_state)) {
+					mutated_failures++;
+				}
+			}
+			//the substr parser runs an element's parse on to the end of its input, so it misnests arrays of arrays, the snapshot's differ by design
+			printf("%-16s %10d %10s %5d failed %5d failed\n", recorded.name.c_str(), (int)recorded.reply.length(), legacy_matches ? "matches" : "differs", chunked_failures, mutated_failures);
+			ok = ok && chunked_failures == 0 && mutated_failures == 0;
+		}
+		return ok;
+	}
+
+	static void TimeReplies(const std::vector<RecordedReply> &replies, int iterations) {
+		printf("%-16s %14s %14s %14s\n", "reply", "legacy ns", "parse ns", "parse+tree ns");
+		for (size_t i = 0; i < replies.size(); i++) {
+			const RecordedReply &recorded = replies[i];
+			const char *data = recorded.reply.c_str();
+			int len = recorded.reply.length();
+
+			//the substr parser is quadratic in the reply's size, so it's given proportionally fewer iterations
+			int legacy_iterations = iterations / (1 + len / 1024);
+			if (legacy_iterations < 10) {
+				legacy_iterations = 10;
+			}
+			uint64_t start = OS::GetMonotonicTimeUS();
+			for (int j = 0; j < legacy_iterations; j++) {
+				Redis::Response response;
+				int diff = 0;
+				Legacy::parse_response(recorded.reply, diff, &response, NULL);
+			}
+			double legacy_ns = (OS::GetMonotonicTimeUS() - start) * 1000.0 / legacy_iterations;
+
+			Redis::ReplyParser parser;
+			start = OS::GetMonotonicTimeUS();
+			for (int j = 0; j < iterations; j++) {
+				parser.Parse(data, len);
+				parser.Reset();
+			}
+			double parse_ns = (OS::GetMonotonicTimeUS() - start) * 1000.0 / iterations;
+
+			start = OS::GetMonotonicTimeUS();
+			for (int j = 0; j < iterations; j++) {
+				parser.Parse(data, len);
+				Redis::Value value;
+				Redis::ToValue(parser.GetReply(), value);
+				parser.Reset();
+			}
+			double tree_ns = (OS::GetMonotonicTimeUS() - start) * 1000.0 / iterations;
+
+			printf("%-16s %14.0f %14.0f %14.0f\n", recorded.name.c_str(), legacy_ns, parse_ns, tree_ns);
+		}
+	}
+
+	int RunRESPReplayBench(const char *redis_address, int iterations) {
+		struct timeval t;
+		t.tv_usec = 0;
+		t.tv_sec = 5;
+
+		Redis::Connection *connection = Redis::Connect(redis_address, t);
+		if (connection == NULL || Redis::Command(connection, 0, "PING").values.empty()) {
+			fprintf(stderr, "can't reach redis at %s\n", redis_address);
+			if (connection) {
+				Redis::Disconnect(connection);
+			}
+			return EXIT_FAILURE;
+		}
+
+		std::vector<RecordedReply> replies;
+		bool recorded = RecordReplies(connection, replies);
+		DeleteReplayKeys(connection);
+		Redis::Disconnect(connection);
+		if (!recorded) {
+			return EXIT_FAILURE;
+		}
+
+		int rounds = iterations / 10 > 0 ? iterations / 10 : 1;
+		printf("%d chunked and %d mutated replays of each recorded reply\n", rounds, rounds);
+		if (!CheckReplies(replies, rounds)) {
+			fprintf(stderr, "a recorded reply wasn't parsed correctly\n");
+			return EXIT_FAILURE;
+		}
+		printf("\n");
+		TimeReplies(replies, iterations);
+		return EXIT_SUCCESS;
+	}
+}
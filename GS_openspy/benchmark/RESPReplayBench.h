@@ -0,0 +1,19 @@
+#ifndef _BENCH_RESPREPLAYBENCH_H
+#define _BENCH_RESPREPLAYBENCH_H
+
+#define RESP_REPLAY_DEFAULT_ITERATIONS 10000
+#define RESP_REPLAY_GAMENAME "osbench_resp" //the recorded servers are written under it in the QR db, and deleted afterwards
+#define RESP_REPLAY_SERVERS 200
+#define RESP_REPLAY_BATCH_SIZE 100 //servers per snapshot reply, MM_SERVER_SNAPSHOT_BATCH_SIZE
+
+namespace Bench {
+	/*
+		Against a redis-server, no daemons needed. Registers servers the way QR does, records the raw replies to the
+		commands QR and SB send about them, then replays the recordings through Redis::ReplyParser:
+		fed in random chunks, which must match parsing them whole, compared with the substr parser it replaced,
+		mutated, which must fail or succeed without reading past the data (build with -fsanitize=address to check),
+		and timed against the substr parser.
+	*/
+	int RunRESPReplayBench(const char *redis_address, int iterations);
+}
+#endif //_BENCH_RESPREPLAYBENCH_H
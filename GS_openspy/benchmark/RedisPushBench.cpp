@@ -0,0 +1,149 @@
+#include "RedisPushBench.h"
+#include <OS/OpenSpy.h>
+#include <OS/Redis.h>
+#include <OS/Analytics/Instrument.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace Bench {
+	static const char *redis_push_keys[] = {"hostname", "gamever", "mapname", "gametype", "gamemode", "numplayers", "maxplayers", "password", "timelimit", "fraglimit", "teamplay", "hostport"};
+	static const char *redis_push_player_keys[] = {"player_", "score_", "ping_", "team_", "deaths_", "skill_"};
+	static const char *redis_push_team_keys[] = {"team_t", "score_t"};
+
+	std::vector<std::string> BuildPushCommands(const char *gamename, int server_id) {
+		std::vector<std::string> commands;
+		std::ostringstream s;
+		s << gamename << ":0:" << server_id << ":";
+		std::string server_key = s.str();
+
+		std::ostringstream ipmap;
+		ipmap << "IPMAP_10.0." << (server_id >> 8) << "." << (server_id & 255) << "-27900";
+
+		s.str("");
+		s << "SELECT " << OS::ERedisDB_QR;
+		commands.push_back(s.str());
+		commands.push_back("SET " + ipmap.str() + " " + server_key);
+		s.str("");
+		s << "EXPIRE " << ipmap.str() << " " << REDIS_PUSH_EXPIRE_TIME;
+		commands.push_back(s.str());
+		commands.push_back(std::string("ZINCRBY ") + gamename + " 1 \"" + server_key + "\"");
+		commands.push_back("HINCRBY " + server_key + " num_beats 1");
+		s.str("");
+		s << "EXPIRE " << server_key << " " << REDIS_PUSH_EXPIRE_TIME;
+		commands.push_back(s.str());
+
+		for (size_t i = 0; i < sizeof(redis_push_keys) / sizeof(const char *); i++) {
+			commands.push_back("HSET " + server_key + "custkeys " + redis_push_keys[i] + " \"value\"");
+		}
+		s.str("");
+		s << "EXPIRE " << server_key << "custkeys " << REDIS_PUSH_EXPIRE_TIME;
+		commands.push_back(s.str());
+
+		for (size_t i = 0; i < sizeof(redis_push_player_keys) / sizeof(const char *); i++) {
+			for (int p = 0; p < REDIS_PUSH_PLAYERS; p++) {
+				s.str("");
+				s << "HSET " << server_key << "custkeys_player_" << p << " " << redis_push_player_keys[i] << " \"" << redis_push_player_keys[i] << p << "\"";
+				commands.push_back(s.str());
+			}
+		}
+		for (int p = 0; p < REDIS_PUSH_PLAYERS; p++) {
+			s.str("");
+			s << "EXPIRE " << server_key << "custkeys_player_" << p << " " << REDIS_PUSH_EXPIRE_TIME;
+			commands.push_back(s.str());
+		}
+
+		for (size_t i = 0; i < sizeof(redis_push_team_keys) / sizeof(const char *); i++) {
+			for (int t = 0; t < 2; t++) {
+				s.str("");
+				s << "HSET " << server_key << "custkeys_team_" << t << " " << redis_push_team_keys[i] << " \"" << t << "\"";
+				commands.push_back(s.str());
+			}
+		}
+		for (int t = 0; t < 2; t++) {
+			s.str("");
+			s << "EXPIRE " << server_key << "custkeys_team_" << t << " " << REDIS_PUSH_EXPIRE_TIME;
+			commands.push_back(s.str());
+		}
+		return commands;
+	}
+
+	static bool RunPushes(Redis::Connection *connection, const std::vector<std::string> &commands, int pushes, bool pipelined, OS::LatencyHistogram *histogram) {
+		for (int i = 0; i < pushes; i++) {
+			uint64_t start = OS::GetMonotonicTimeUS();
+			if (pipelined) {
+				for (size_t j = 0; j < commands.size(); j++) {
+					Redis::AppendCommand(connection, "%s", commands[j].c_str());
+				}
+				if (Redis::Flush(connection).values.size() != commands.size()) {
+					return false;
+				}
+			}
+			else {
+				for (size_t j = 0; j < commands.size(); j++) {
+					if (Redis::Command(connection, 0, "%s", commands[j].c_str()).values.empty()) {
+						return false;
+					}
+				}
+			}
+			histogram->Record(OS::GetMonotonicTimeUS() - start);
+		}
+		return true;
+	}
+
+	void DeletePushKeys(Redis::Connection *connection, const char *gamename, int server_id) {
+		std::ostringstream s;
+		s << gamename << ":0:" << server_id << ":";
+		std::string server_key = s.str();
+		Redis::AppendCommand(connection, "SELECT %d", OS::ERedisDB_QR);
+		Redis::AppendCommand(connection, "DEL %s %scustkeys %s", server_key.c_str(), server_key.c_str(), gamename);
+		for (int p = 0; p < REDIS_PUSH_PLAYERS; p++) {
+			Redis::AppendCommand(connection, "DEL %scustkeys_player_%d", server_key.c_str(), p);
+		}
+		for (int t = 0; t < 2; t++) {
+			Redis::AppendCommand(connection, "DEL %scustkeys_team_%d", server_key.c_str(), t);
+		}
+		Redis::AppendCommand(connection, "DEL IPMAP_10.0.%d.%d-27900", server_id >> 8, server_id & 255);
+		Redis::Flush(connection);
+	}
+
+	int RunRedisPushBench(const char *redis_address, int pushes) {
+		struct timeval t;
+		t.tv_usec = 0;
+		t.tv_sec = 5;
+
+		Redis::Connection *connection = Redis::Connect(redis_address, t);
+		if (connection == NULL || Redis::Command(connection, 0, "PING").values.empty()) {
+			fprintf(stderr, "can't reach redis at %s\n", redis_address);
+			if (connection) {
+				Redis::Disconnect(connection);
+			}
+			return EXIT_FAILURE;
+		}
+
+		int server_id = 1;
+		std::vector<std::string> commands = BuildPushCommands(REDIS_PUSH_GAMENAME, server_id);
+		printf("%d pushes of %d commands each to %s\n", pushes, (int)commands.size(), redis_address);
+		printf("%-12s %12s %12s %12s %14s\n", "mode", "pushes/s", "p50 us", "p99 us", "round trips");
+
+		int ret = EXIT_SUCCESS;
+		for (int pipelined = 0; pipelined < 2; pipelined++) {
+			OS::LatencyHistogram histogram("bench_redis_push", "Latency of one server's push");
+			uint64_t start = OS::GetMonotonicTimeUS();
+			if (!RunPushes(connection, commands, pushes, pipelined != 0, &histogram)) {
+				fprintf(stderr, "redis at %s failed a push\n", redis_address);
+				ret = EXIT_FAILURE;
+				break;
+			}
+			uint64_t elapsed = OS::GetMonotonicTimeUS() - start;
+			printf("%-12s %12.0f %12llu %12llu %14d\n", pipelined ? "pipelined" : "sequential", elapsed ? pushes * 1000000.0 / elapsed : 0,
+				(unsigned long long)histogram.GetPercentile(0.5), (unsigned long long)histogram.GetPercentile(0.99), pipelined ? 1 : (int)commands.size());
+		}
+
+		DeletePushKeys(connection, REDIS_PUSH_GAMENAME, server_id);
+		Redis::Disconnect(connection);
+		return ret;
+	}
+}
@@ -0,0 +1,29 @@
+#ifndef _BENCH_REDISPUSHBENCH_H
+#define _BENCH_REDISPUSHBENCH_H
+
+#define BENCH_DEFAULT_REDIS "127.0.0.1:6379"
+#define REDIS_PUSH_DEFAULT_PUSHES 2000
+#define REDIS_PUSH_GAMENAME "osbench_push" //the servers' keys are written under it in the QR db, and deleted afterwards
+#define REDIS_PUSH_PLAYERS 16
+#define REDIS_PUSH_EXPIRE_TIME 1800 //MM_PUSH_EXPIRE_TIME
+
+#include <OS/Redis.h>
+#include <string>
+#include <vector>
+
+namespace Bench {
+	/*
+		The commands PushServer sends for a registered server's heartbeat, in its order:
+		the IPMAP entry, the server hash, then the custkeys, player and team hashes, each field set on its own
+	*/
+	std::vector<std::string> BuildPushCommands(const char *gamename, int server_id);
+	//everything BuildPushCommands' commands write, and the game's server set
+	void DeletePushKeys(Redis::Connection *connection, const char *gamename, int server_id);
+
+	/*
+		Against a redis-server, no daemons needed, times MMPushTask::PushServer's commands for a server sent
+		one round trip at a time, as Redis::Command did before pipelining, and queued and sent with one Flush.
+	*/
+	int RunRedisPushBench(const char *redis_address, int pushes);
+}
+#endif //_BENCH_REDISPUSHBENCH_H
@@ -0,0 +1,125 @@
+#include "Report.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+
+#define REPORT_HEADER "# osbench"
+#define REPORT_COLUMNS "scenario\tclients\tops\terrors\tops_per_sec\tp50_us\tp99_us\tp999_us\tdaemon_cpu_us_per_op\tbench_cpu_us_per_op"
+
+namespace Bench {
+	Report::Report(const Options &options, std::string label) : m_options(options) {
+		m_label = label;
+	}
+	void Report::AddResult(const Result &result) {
+		m_results.push_back(result);
+	}
+	std::string Report::GetKey(const Result &result) {
+		std::ostringstream s;
+		s << result.scenario << "/" << result.num_clients;
+		return s.str();
+	}
+	bool Report::ParseRow(const std::string &line, Result &result) {
+		std::vector<std::string> fields;
+		std::stringstream s(line);
+		std::string field;
+		while (std::getline(s, field, '\t')) {
+			fields.push_back(field);
+		}
+		if (fields.size() < 10) {
+			return false;
+		}
+		result.scenario = fields[0];
+		result.num_clients = atoi(fields[1].c_str());
+		result.ops = strtoull(fields[2].c_str(), NULL, 10);
+		result.errors = strtoull(fields[3].c_str(), NULL, 10);
+		result.ops_per_sec = atof(fields[4].c_str());
+		result.p50_us = strtoull(fields[5].c_str(), NULL, 10);
+		result.p99_us = strtoull(fields[6].c_str(), NULL, 10);
+		result.p999_us = strtoull(fields[7].c_str(), NULL, 10);
+		result.daemon_cpu_us_per_op = atof(fields[8].c_str());
+		result.bench_cpu_us_per_op = atof(fields[9].c_str());
+		return true;
+	}
+	bool Report::LoadBaseline(const char *path) {
+		std::ifstream file(path);
+		std::string line;
+		if (!file.is_open()) {
+			return false;
+		}
+		while (std::getline(file, line)) {
+			Result result;
+			if (line.find(REPORT_HEADER) == 0) {
+				size_t pos = line.find("label=");
+				if (pos != std::string::npos) {
+					m_baseline_label = line.substr(pos + 6, line.find(' ', pos) - pos - 6);
+				}
+				continue;
+			}
+			if (line.empty() || line[0] == '#' || line.find("scenario\t") == 0 || !ParseRow(line, result)) {
+				continue;
+			}
+			m_baseline[GetKey(result)] = result;
+		}
+		return true;
+	}
+	//percent change from the baseline, higher is better for ops/s and worse for every other column
+	static std::string GetChange(double value, double baseline) {
+		char change[32];
+		if (baseline <= 0 || value < 0) {
+			return "";
+		}
+		snprintf(change, sizeof(change), " (%+.1f%%)", (value - baseline) * 100.0 / baseline);
+		return change;
+	}
+	void Report::Print() {
+		printf("%-14s %7s %9s %6s %18s %18s %18s %18s %20s %18s\n", "scenario", "clients", "ops", "errors", "ops/s", "p50 us", "p99 us", "p99.9 us", "daemon cpu us/op", "bench cpu us/op");
+		std::vector<Result>::iterator it = m_results.begin();
+		while (it != m_results.end()) {
+			Result result = *it;
+			Result baseline;
+			std::map<std::string, Result>::iterator baseline_it = m_baseline.find(GetKey(result));
+			bool has_baseline = baseline_it != m_baseline.end();
+			if (has_baseline) {
+				baseline = (*baseline_it).second;
+			}
+			char ops_per_sec[64], p50[64], p99[64], p999[64], daemon_cpu[64], bench_cpu[64];
+			snprintf(ops_per_sec, sizeof(ops_per_sec), "%.1f%s", result.ops_per_sec, has_baseline ? GetChange(result.ops_per_sec, baseline.ops_per_sec).c_str() : "");
+			snprintf(p50, sizeof(p50), "%llu%s", (unsigned long long)result.p50_us, has_baseline ? GetChange(result.p50_us, baseline.p50_us).c_str() : "");
+			snprintf(p99, sizeof(p99), "%llu%s", (unsigned long long)result.p99_us, has_baseline ? GetChange(result.p99_us, baseline.p99_us).c_str() : "");
+			snprintf(p999, sizeof(p999), "%llu%s", (unsigned long long)result.p999_us, has_baseline ? GetChange(result.p999_us, baseline.p999_us).c_str() : "");
+			if (result.daemon_cpu_us_per_op < 0) {
+				snprintf(daemon_cpu, sizeof(daemon_cpu), "-");
+			}
+			else {
+				snprintf(daemon_cpu, sizeof(daemon_cpu), "%.1f%s", result.daemon_cpu_us_per_op, has_baseline ? GetChange(result.daemon_cpu_us_per_op, baseline.daemon_cpu_us_per_op).c_str() : "");
+			}
+			snprintf(bench_cpu, sizeof(bench_cpu), "%.1f%s", result.bench_cpu_us_per_op, has_baseline ? GetChange(result.bench_cpu_us_per_op, baseline.bench_cpu_us_per_op).c_str() : "");
+			printf("%-14s %7d %9llu %6llu %18s %18s %18s %18s %20s %18s\n", result.scenario.c_str(), result.num_clients, (unsigned long long)result.ops, (unsigned long long)result.errors,
+				ops_per_sec, p50, p99, p999, daemon_cpu, bench_cpu);
+			it++;
+		}
+		if (!m_baseline.empty()) {
+			printf("changes are from baseline %s\n", m_baseline_label.empty() ? "(unlabelled)" : m_baseline_label.c_str());
+		}
+	}
+	bool Report::Write(const char *path) {
+		FILE *fd = fopen(path, "w");
+		if (!fd) {
+			return false;
+		}
+		fprintf(fd, "%s label=%s seed=%u duration=%d warmup=%d servers=%d\n", REPORT_HEADER, m_label.c_str(), m_options.seed, m_options.duration, m_options.warmup, m_options.num_servers);
+		fprintf(fd, "%s\n", REPORT_COLUMNS);
+		std::vector<Result>::iterator it = m_results.begin();
+		while (it != m_results.end()) {
+			Result result = *it;
+			fprintf(fd, "%s\t%d\t%llu\t%llu\t%.1f\t%llu\t%llu\t%llu\t%.2f\t%.2f\n", result.scenario.c_str(), result.num_clients,
+				(unsigned long long)result.ops, (unsigned long long)result.errors, result.ops_per_sec,
+				(unsigned long long)result.p50_us, (unsigned long long)result.p99_us, (unsigned long long)result.p999_us,
+				result.daemon_cpu_us_per_op, result.bench_cpu_us_per_op);
+			it++;
+		}
+		fclose(fd);
+		return true;
+	}
+}
@@ -0,0 +1,28 @@
+#ifndef _BENCH_REPORT_H
+#define _BENCH_REPORT_H
+#include "LoadGenerator.h"
+
+namespace Bench {
+	/*
+		Results are written as tab separated rows after a "# osbench" header line, one row per scenario and client count,
+		so a run on one commit can be passed as the baseline of a run on another.
+	*/
+	class Report {
+	public:
+		Report(const Options &options, std::string label);
+		void AddResult(const Result &result);
+		bool LoadBaseline(const char *path);
+		void Print(); //table to stdout, with the change from the baseline when one was loaded
+		bool Write(const char *path);
+	private:
+		std::string GetKey(const Result &result);
+		static bool ParseRow(const std::string &line, Result &result);
+
+		const Options &m_options;
+		std::string m_label;
+		std::vector<Result> m_results;
+		std::map<std::string, Result> m_baseline;
+		std::string m_baseline_label;
+	};
+}
+#endif //_BENCH_REPORT_H
@@ -0,0 +1,38 @@
+#include "LoadGenerator.h"
+#include "clients/QRClient.h"
+#include "clients/SBClient.h"
+#include "clients/GPClient.h"
+#include "clients/ChatClient.h"
+#include "clients/NNClient.h"
+
+namespace Bench {
+	//in the order "all" runs them, a scenario's name and columns are what reports are compared by, so they're never renamed
+	static const Scenario scenario_table[] = {
+		{"qr1_heartbeat", "qr", "v1 heartbeat and the basic/info/rules/players queries answering it", CreateQR1HeartbeatClient, false},
+		{"qr2_heartbeat", "qr", "v2 heartbeat from a registered server, with changed player counts", CreateQR2HeartbeatClient, false},
+		{"sb1_list", "serverbrowsing", "v1 session, validate and compressed list, on a new connection", CreateSB1ListClient, true},
+		{"sb2_list", "serverbrowsing", "v2 filtered list request on a kept open connection", CreateSB2ListClient, true},
+		{"sb2_push", "qr,serverbrowsing", "v2 server registration until it's pushed to a subscribed browser", CreateSB2PushClient, false},
+		{"gp_login", "GP", "GP login and logout, on a new connection", CreateGPLoginClient, false},
+		{"gp_status", "GP", "GP status change until it reaches the buddy", CreateGPStatusClient, false},
+		{"chat_join", "peerchat", "channel join until the names list, and part", CreateChatJoinClient, false},
+		{"chat_privmsg", "peerchat", "channel message until it reaches the other member", CreateChatPrivmsgClient, false},
+		{"nn_pair", "natneg", "natneg init from two clients until both are sent connect", CreateNNPairClient, false},
+	};
+
+	const std::vector<Scenario> &GetScenarios() {
+		static std::vector<Scenario> scenarios(scenario_table, scenario_table + sizeof(scenario_table) / sizeof(Scenario));
+		return scenarios;
+	}
+	const Scenario *FindScenario(std::string name) {
+		const std::vector<Scenario> &scenarios = GetScenarios();
+		std::vector<Scenario>::const_iterator it = scenarios.begin();
+		while (it != scenarios.end()) {
+			if (name.compare((*it).name) == 0) {
+				return &(*it);
+			}
+			it++;
+		}
+		return NULL;
+	}
+}
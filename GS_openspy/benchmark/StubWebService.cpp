@@ -0,0 +1,206 @@
+#include "StubWebService.h"
+#include "clients/GPClient.h"
+#include <jansson.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sstream>
+#ifndef _WIN32
+#include <sys/select.h>
+#endif
+namespace Bench {
+	StubWebService::StubWebService(uint16_t port) {
+		struct sockaddr_in local_addr;
+		int on = 1;
+		m_running = false;
+		mp_thread = NULL;
+
+		if ((m_sd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0) {
+			m_sd = -1;
+			return;
+		}
+		setsockopt(m_sd, SOL_SOCKET, SO_REUSEADDR, (const char *)&on, sizeof(on));
+
+		memset(&local_addr, 0, sizeof(local_addr));
+		local_addr.sin_family = AF_INET;
+		local_addr.sin_port = htons(port);
+		local_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+		if (bind(m_sd, (struct sockaddr *)&local_addr, sizeof(local_addr)) < 0 || listen(m_sd, SOMAXCONN) < 0) {
+			close(m_sd);
+			m_sd = -1;
+			return;
+		}
+
+		m_running = true;
+		mp_thread = OS::CreateThread(StubWebService::ServerThread, this, true);
+	}
+	StubWebService::~StubWebService() {
+		m_running = false;
+		if (mp_thread) {
+			delete mp_thread;
+		}
+		std::map<int, std::string>::iterator it = m_connections.begin();
+		while (it != m_connections.end()) {
+			close((*it).first);
+			it++;
+		}
+		if (m_sd != -1) {
+			close(m_sd);
+		}
+	}
+	void *StubWebService::ServerThread(OS::CThread *thread) {
+		StubWebService *service = (StubWebService *)thread->getParams();
+		while (service->m_running) {
+			fd_set fdset;
+			struct timeval timeout;
+			int max_sd = service->m_sd;
+			timeout.tv_sec = 0;
+			timeout.tv_usec = STUB_WEB_POLL_TIME * 1000;
+			FD_ZERO(&fdset);
+			FD_SET(service->m_sd, &fdset);
+			std::map<int, std::string>::iterator it = service->m_connections.begin();
+			while (it != service->m_connections.end()) {
+				FD_SET((*it).first, &fdset);
+				if ((*it).first > max_sd) {
+					max_sd = (*it).first;
+				}
+				it++;
+			}
+			if (select(max_sd + 1, &fdset, NULL, NULL, &timeout) <= 0) {
+				continue;
+			}
+
+			it = service->m_connections.begin();
+			while (it != service->m_connections.end()) {
+				int sd = (*it).first;
+				if (FD_ISSET(sd, &fdset) && !service->HandleRead(sd)) {
+					close(sd);
+					service->m_connections.erase(it++);
+					continue;
+				}
+				it++;
+			}
+
+			if (FD_ISSET(service->m_sd, &fdset)) {
+				int sd = accept(service->m_sd, NULL, NULL);
+				if (sd >= 0 && sd < FD_SETSIZE) {
+					service->m_connections[sd] = std::string();
+				}
+				else if (sd >= 0) {
+					close(sd);
+				}
+			}
+		}
+		return NULL;
+	}
+	bool StubWebService::HandleRead(int sd) {
+		char buffer[STUB_WEB_MAX_REQUEST];
+		int len = recv(sd, buffer, sizeof(buffer), 0);
+		if (len <= 0) {
+			return false;
+		}
+		std::string &pending = m_connections[sd];
+		pending.append(buffer, len);
+
+		//every complete request in what's been read, curl doesn't pipeline but may send the body separately
+		while (true) {
+			size_t header_end = pending.find("\r\n\r\n");
+			if (header_end == std::string::npos) {
+				return pending.length() < STUB_WEB_MAX_REQUEST;
+			}
+			size_t content_length = 0;
+			size_t pos = pending.find("Content-Length:");
+			if (pos == std::string::npos) {
+				pos = pending.find("content-length:");
+			}
+			if (pos != std::string::npos && pos < header_end) {
+				content_length = strtoul(pending.c_str() + pos + 15, NULL, 10);
+			}
+			if (pending.length() < header_end + 4 + content_length) {
+				return true;
+			}
+
+			//POST /backend/auth HTTP/1.1
+			std::string path;
+			size_t path_start = pending.find(' ');
+			if (path_start != std::string::npos && path_start < header_end) {
+				path = pending.substr(path_start + 1, pending.find(' ', path_start + 1) - path_start - 1);
+			}
+			std::string body = HandleRequest(path, pending.substr(header_end + 4, content_length));
+			pending.erase(0, header_end + 4 + content_length);
+
+			std::ostringstream s;
+			s << "HTTP/1.1 200 OK\r\n";
+			s << "Content-Type: application/json\r\n";
+			s << "Content-Length: " << body.length() << "\r\n\r\n";
+			s << body;
+
+			std::string response = s.str();
+			const char *p = response.c_str();
+			int remaining = response.length();
+			while (remaining > 0) {
+				int sent = send(sd, p, remaining, MSG_NOSIGNAL);
+				if (sent <= 0) {
+					return false;
+				}
+				p += sent;
+				remaining -= sent;
+			}
+		}
+	}
+	//the profile id a request is about, from the top level or its profile object, else from a bench<N> nick
+	static int GetRequestProfileId(json_t *request) {
+		json_t *profile = json_object_get(request, "profile");
+		json_t *j = json_object_get(request, "profileid");
+		if (!j && profile) {
+			j = json_object_get(profile, "id");
+		}
+		if (j && json_is_integer(j) && json_integer_value(j)) {
+			return json_integer_value(j);
+		}
+		if (profile) {
+			j = json_object_get(profile, "nick");
+			if (j && json_is_string(j) && strncmp(json_string_value(j), "bench", 5) == 0) {
+				return GP_BENCH_PROFILEID_BASE + atoi(json_string_value(j) + 5);
+			}
+		}
+		return GP_BENCH_PROFILEID_BASE;
+	}
+	static std::string GetProfileJson(int profileid) {
+		std::ostringstream s;
+		int index = profileid - GP_BENCH_PROFILEID_BASE;
+		s << "{\"id\":" << profileid << ",\"nick\":\"bench" << index << "\",\"uniquenick\":\"bench" << index << "\",\"namespaceid\":1,\"userid\":" << profileid;
+		s << ",\"user\":{\"id\":" << profileid << ",\"email\":\"bench" << index << "@bench" << index << ".openspy\",\"partnercode\":0}}";
+		return s.str();
+	}
+	std::string StubWebService::HandleRequest(const std::string &path, const std::string &body) {
+		std::ostringstream s;
+		json_t *request = json_loads(body.c_str(), 0, NULL);
+		if (!request) {
+			return "{\"success\":false}";
+		}
+		int profileid = GetRequestProfileId(request);
+		if (path.compare("/backend/auth") == 0) {
+			s << "{\"success\":true,\"profile\":" << GetProfileJson(profileid) << ",\"server_response\":\"00000000000000000000000000000000\",\"session_key\":\"1\"}";
+		}
+		else if (path.compare("/backend/userprofile") == 0) {
+			json_t *mode = json_object_get(request, "mode");
+			const char *mode_str = mode && json_is_string(mode) ? json_string_value(mode) : "";
+			if (strcmp(mode_str, "buddies_search") == 0 || strcmp(mode_str, "buddies_reverse_search") == 0) {
+				int partner = GP_BENCH_PROFILEID_BASE + ((profileid - GP_BENCH_PROFILEID_BASE) ^ 1);
+				s << "{\"profiles\":[" << GetProfileJson(partner) << "]}";
+			}
+			else if (strcmp(mode_str, "blocks_search") == 0) {
+				s << "{\"profiles\":[]}";
+			}
+			else {
+				s << "{\"profiles\":[" << GetProfileJson(profileid) << "],\"profile\":" << GetProfileJson(profileid) << "}";
+			}
+		}
+		else {
+			//useraccount, persist, anything else just succeeds
+			s << "{\"success\":true}";
+		}
+		json_decref(request);
+		return s.str();
+	}
+}
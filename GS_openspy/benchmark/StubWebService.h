@@ -0,0 +1,35 @@
+#ifndef _BENCH_STUBWEBSERVICE_H
+#define _BENCH_STUBWEBSERVICE_H
+#include <OS/OpenSpy.h>
+#include <OS/Thread.h>
+#include <string>
+#include <map>
+
+#define STUB_WEB_POLL_TIME 500 //ms, how often the server checks if it's shutting down
+#define STUB_WEB_MAX_REQUEST 65536
+
+namespace Bench {
+	/*
+		Answers the daemons' web service posts (webservices_url) without a database, so the GP scenarios
+		measure the daemon and not the backend. Every login succeeds, bench<N> is profile GP_BENCH_PROFILEID_BASE + N,
+		and each profile's only buddy is N ^ 1, the other half of its gp_status pair.
+
+		Keep-alive HTTP/1.1 on a single thread, the daemons keep their connections to it open.
+	*/
+	class StubWebService {
+	public:
+		StubWebService(uint16_t port);
+		~StubWebService();
+		bool IsListening() { return m_sd != -1; };
+	private:
+		static void *ServerThread(OS::CThread *thread);
+		bool HandleRead(int sd); //false once the connection should be closed
+		std::string HandleRequest(const std::string &path, const std::string &body);
+
+		int m_sd;
+		volatile bool m_running;
+		OS::CThread *mp_thread;
+		std::map<int, std::string> m_connections; //pending request data, by socket
+	};
+}
+#endif //_BENCH_STUBWEBSERVICE_H
@@ -0,0 +1,119 @@
+#include "ChatClient.h"
+#include "../BenchSocket.h"
+#include <sstream>
+
+namespace Bench {
+	/*
+		A registered IRC connection, server pings are answered while waiting for replies.
+	*/
+	class ChatSession {
+	public:
+		ChatSession(const Options &options, std::string nick) {
+			mp_options = &options;
+			m_nick = nick;
+		};
+		bool Connect() {
+			std::ostringstream s;
+			if (!m_socket.ConnectTCP(mp_options->host.c_str(), CHAT_PORT)) {
+				return false;
+			}
+			s << "NICK " << m_nick << "\r\n";
+			s << "USER " << m_nick << " bench bench :" << m_nick << "\r\n";
+			if (!m_socket.Send(s.str())) {
+				return false;
+			}
+			//welcome
+			return WaitFor(" 001 ");
+		};
+		bool Send(const std::string &line) {
+			return m_socket.Send(line + "\r\n");
+		};
+		//reads lines until one containing match
+		bool WaitFor(const char *match) {
+			std::string line;
+			while (m_socket.ReadMessage(line, "\n")) {
+				if (line.find("PING ") == 0) {
+					Send("PONG " + line.substr(5, line.find_last_not_of("\r\n") - 4));
+				}
+				else if (line.find(match) != std::string::npos) {
+					return true;
+				}
+				else if (line.find("ERROR ") == 0) {
+					return false;
+				}
+			}
+			return false;
+		};
+	private:
+		const Options *mp_options;
+		std::string m_nick;
+		Socket m_socket;
+	};
+
+	static std::string GetChatName(const char *prefix, int index) {
+		std::ostringstream s;
+		s << prefix << index;
+		return s.str();
+	}
+
+	/*
+		chat_join: an op is joining a channel of the client's own, timed until the end of its names list, then parting it.
+	*/
+	class ChatJoinClient : public Client {
+	public:
+		ChatJoinClient(const Options &options, int index) : Client(options, index), m_session(options, GetChatName("benchj", index)) {
+			m_channel = GetChatName("#benchjoin_", index);
+		};
+		bool Setup() {
+			return m_session.Connect();
+		};
+		bool RunOp() {
+			if (!m_session.Send("JOIN " + m_channel) || !m_session.WaitFor(" 366 ")) {
+				return false;
+			}
+			return m_session.Send("PART " + m_channel + " :bench") && m_session.WaitFor(" PART ");
+		};
+	private:
+		ChatSession m_session;
+		std::string m_channel;
+	};
+
+	/*
+		chat_privmsg: each client is a pair in a channel, an op is a message from one, timed until it's delivered to the other.
+	*/
+	class ChatPrivmsgClient : public Client {
+	public:
+		ChatPrivmsgClient(const Options &options, int index) : Client(options, index),
+			m_sender(options, GetChatName("benchs", index)), m_receiver(options, GetChatName("benchr", index)) {
+			m_channel = GetChatName("#benchmsg_", index);
+			m_sequence = 0;
+		};
+		bool Setup() {
+			return m_sender.Connect() && m_receiver.Connect() &&
+				m_sender.Send("JOIN " + m_channel) && m_sender.WaitFor(" 366 ") &&
+				m_receiver.Send("JOIN " + m_channel) && m_receiver.WaitFor(" 366 ");
+		};
+		bool RunOp() {
+			std::ostringstream s, match;
+			m_sequence++;
+			s << "PRIVMSG " << m_channel << " :m" << m_sequence;
+			match << ":m" << m_sequence << "\n";
+			if (!m_sender.Send(s.str())) {
+				return false;
+			}
+			return m_receiver.WaitFor(match.str().c_str());
+		};
+	private:
+		ChatSession m_sender;
+		ChatSession m_receiver;
+		std::string m_channel;
+		int m_sequence;
+	};
+
+	Client *CreateChatJoinClient(const Options &options, int index) {
+		return new ChatJoinClient(options, index);
+	}
+	Client *CreateChatPrivmsgClient(const Options &options, int index) {
+		return new ChatPrivmsgClient(options, index);
+	}
+}
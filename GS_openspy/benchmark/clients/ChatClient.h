@@ -0,0 +1,11 @@
+#ifndef _BENCH_CHATCLIENT_H
+#define _BENCH_CHATCLIENT_H
+#include "../LoadGenerator.h"
+
+#define CHAT_PORT 6667
+
+namespace Bench {
+	Client *CreateChatJoinClient(const Options &options, int index);
+	Client *CreateChatPrivmsgClient(const Options &options, int index);
+}
+#endif //_BENCH_CHATCLIENT_H
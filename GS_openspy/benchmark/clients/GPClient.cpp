@@ -0,0 +1,127 @@
+#include "GPClient.h"
+#include "../BenchSocket.h"
+#include <sstream>
+
+#define GP_LOGIN_RESPONSE "00000000000000000000000000000000" //checked by the web service, which the stub doesn't
+#define GP_CLIENT_CHALLENGE "benchbenchbenchbenchbenchbench12"
+
+namespace Bench {
+	/*
+		A GP session as the user bench<nick_index>, the stub web service accepts any login response
+		and gives every even numbered user the next odd numbered one as its only buddy, and the other way around.
+	*/
+	class GPSession {
+	public:
+		GPSession(const Options &options, int nick_index) {
+			mp_options = &options;
+			m_nick_index = nick_index;
+		};
+		bool Login() {
+			std::string message;
+			m_socket.Close();
+			if (!m_socket.ConnectTCP(mp_options->host.c_str(), GP_PORT) || !m_socket.ReadMessage(message, "\\final\\")) {
+				return false;
+			}
+			std::ostringstream s;
+			s << "\\login\\\\challenge\\" << GP_CLIENT_CHALLENGE << "\\user\\bench" << m_nick_index << "@bench" << m_nick_index << ".openspy";
+			s << "\\response\\" << GP_LOGIN_RESPONSE << "\\port\\0\\namespaceid\\1\\sdkrevision\\3\\quiet\\0\\id\\1\\final\\";
+			if (!m_socket.Send(s.str())) {
+				return false;
+			}
+			return WaitFor("\\lc\\2\\");
+		};
+		void Logout() {
+			if (m_socket.IsOpen()) {
+				m_socket.Send("\\logout\\\\sesskey\\1\\final\\");
+				m_socket.Close();
+			}
+		};
+		bool Send(const std::string &message) {
+			return m_socket.Send(message);
+		};
+		//reads messages until one containing match, anything before it is dropped
+		bool WaitFor(const char *match) {
+			std::string message;
+			while (m_socket.ReadMessage(message, "\\final\\")) {
+				if (message.find(match) != std::string::npos) {
+					return true;
+				}
+				//an error, \error\\err\<code>\fatal\1, a fatal one is followed by the server closing the connection
+				if (message.find("\\error\\") == 0 && message.find("\\fatal\\1") != std::string::npos) {
+					return false;
+				}
+			}
+			return false;
+		};
+		//drops whatever was sent to the session without waiting for more
+		void Drain() {
+			m_socket.GetPending().clear();
+			while (m_socket.ReadMore(0));
+			m_socket.GetPending().clear();
+		};
+	private:
+		const Options *mp_options;
+		int m_nick_index;
+		Socket m_socket;
+	};
+
+	/*
+		gp_login: an op is a whole session, connect, login, and logout once it's logged in.
+	*/
+	class GPLoginClient : public Client {
+	public:
+		GPLoginClient(const Options &options, int index) : Client(options, index) { };
+		bool Setup() {
+			return true;
+		};
+		bool RunOp() {
+			GPSession session(*mp_options, m_index);
+			bool success = session.Login();
+			session.Logout();
+			return success;
+		};
+	};
+
+	/*
+		gp_status: each client is a pair of buddies, an op is a status change by one, timed until the other is told of it.
+	*/
+	class GPStatusClient : public Client {
+	public:
+		GPStatusClient(const Options &options, int index) : Client(options, index), m_sender(options, index * 2), m_receiver(options, index * 2 + 1) {
+			m_sequence = 0;
+		};
+		~GPStatusClient() {
+			m_sender.Logout();
+			m_receiver.Logout();
+		};
+		bool Setup() {
+			m_sender.Logout();
+			m_receiver.Logout();
+			//the receiver has to have its buddy list before it's watching the sender's status
+			return m_sender.Login() && m_receiver.Login() && m_receiver.WaitFor("\\bdy\\");
+		};
+		bool RunOp() {
+			std::ostringstream s, match;
+			m_sequence++;
+			s << "\\status\\1\\sesskey\\1\\statstring\\s" << m_sequence << "\\locstring\\bench\\final\\";
+			match << "|ss|s" << m_sequence << "|";
+			if (!m_sender.Send(s.str())) {
+				return false;
+			}
+			bool success = m_receiver.WaitFor(match.str().c_str());
+			m_sender.Drain();
+			return success;
+		};
+	private:
+		GPSession m_sender;
+		GPSession m_receiver;
+		int m_sequence;
+	};
+
+	Client *CreateGPLoginClient(const Options &options, int index) {
+		return new GPLoginClient(options, index);
+	}
+	Client *CreateGPStatusClient(const Options &options, int index) {
+		return new GPStatusClient(options, index);
+	}
+}
@@ -0,0 +1,12 @@
+#ifndef _BENCH_GPCLIENT_H
+#define _BENCH_GPCLIENT_H
+#include "../LoadGenerator.h"
+
+#define GP_PORT 29900
+#define GP_BENCH_PROFILEID_BASE 100000 //the stub web service gives bench<N> the profile id GP_BENCH_PROFILEID_BASE + N
+
+namespace Bench {
+	Client *CreateGPLoginClient(const Options &options, int index);
+	Client *CreateGPStatusClient(const Options &options, int index);
+}
+#endif //_BENCH_GPCLIENT_H
@@ -0,0 +1,100 @@
+#include "NNClient.h"
+#include "../BenchSocket.h"
+#include <string.h>
+
+#define NN_VERSION 3
+#define NN_BASEPACKET_SIZE 12
+#define NN_TYPE_OFFSET 7
+#define NN_INIT_SIZE (NN_BASEPACKET_SIZE + 9)
+#define NN_REPORT_SIZE (NN_BASEPACKET_SIZE + 61)
+#define NN_REPORT_GAMENAME_OFFSET (NN_BASEPACKET_SIZE + 11)
+#define NN_REPORT_GAMENAME_LEN 50
+#define NN_PACKET_INIT 0
+#define NN_PACKET_INITACK 1
+#define NN_PACKET_CONNECT 5
+#define NN_PACKET_CONNECT_ACK 6
+#define NN_PACKET_REPORT 13
+#define NN_PORT_TYPE 1 //the first natneg port, games send the same init for each of them
+
+namespace Bench {
+	static const uint8_t nn_magic[] = { 0xFD, 0xFC, 0x1E, 0x66, 0x6A, 0xB2 };
+
+	/*
+		nn_pair: an op is a negotiation between two new clients sharing a random cookie, init from both,
+		timed until both were sent the other's address, then acked and reported so natneg drops them.
+	*/
+	class NNPairClient : public Client {
+	public:
+		NNPairClient(const Options &options, int index) : Client(options, index) { };
+		bool Setup() {
+			return true;
+		};
+		bool RunOp() {
+			Socket sockets[2];
+			uint32_t cookie = Rand() << 8 | m_index; //unique across the clients, so pairs never cross
+			for (int i = 0; i < 2; i++) {
+				if (!sockets[i].OpenUDP(mp_options->host.c_str(), NN_PORT)) {
+					return false;
+				}
+			}
+			for (int i = 0; i < 2; i++) {
+				if (!Send(sockets[i], NN_PACKET_INIT, cookie, i, NN_INIT_SIZE, mp_options->gamename.c_str())) {
+					return false;
+				}
+			}
+			for (int i = 0; i < 2; i++) {
+				if (!WaitFor(sockets[i], NN_PACKET_CONNECT)) {
+					return false;
+				}
+			}
+			for (int i = 0; i < 2; i++) {
+				Send(sockets[i], NN_PACKET_CONNECT_ACK, cookie, i, NN_INIT_SIZE, NULL);
+				Send(sockets[i], NN_PACKET_REPORT, cookie, i, NN_REPORT_SIZE, NULL);
+			}
+			return true;
+		};
+	private:
+		bool Send(Socket &socket, uint8_t type, uint32_t cookie, int client_index, int size, const char *gamename) {
+			uint8_t packet[NN_REPORT_SIZE + 64];
+			int len = size;
+			memset(&packet, 0, sizeof(packet));
+			memcpy(&packet, &nn_magic, sizeof(nn_magic));
+			packet[6] = NN_VERSION;
+			packet[NN_TYPE_OFFSET] = type;
+			cookie = htonl(cookie);
+			memcpy(&packet[8], &cookie, sizeof(cookie));
+			packet[NN_BASEPACKET_SIZE] = NN_PORT_TYPE;
+			packet[NN_BASEPACKET_SIZE + 1] = client_index;
+			if (type == NN_PACKET_REPORT) {
+				packet[NN_BASEPACKET_SIZE + 2] = 1; //negotiation result, succeeded
+				strncpy((char *)&packet[NN_REPORT_GAMENAME_OFFSET], mp_options->gamename.c_str(), NN_REPORT_GAMENAME_LEN - 1);
+			}
+			if (gamename) {
+				int gamename_len = strlen(gamename) + 1;
+				if (gamename_len > (int)sizeof(packet) - len) {
+					gamename_len = sizeof(packet) - len;
+				}
+				memcpy(&packet[len], gamename, gamename_len);
+				len += gamename_len;
+			}
+			return socket.Send(&packet, len);
+		};
+		//drops the init acks and anything else that isn't the packet type waited for
+		bool WaitFor(Socket &socket, uint8_t type) {
+			uint8_t buffer[BENCH_RECV_BUFFER_SIZE];
+			while (true) {
+				int len = socket.Recv(&buffer, sizeof(buffer));
+				if (len <= 0) {
+					return false;
+				}
+				if (len > NN_TYPE_OFFSET && memcmp(&buffer, &nn_magic, sizeof(nn_magic)) == 0 && buffer[NN_TYPE_OFFSET] == type) {
+					return true;
+				}
+			}
+		};
+	};
+
+	Client *CreateNNPairClient(const Options &options, int index) {
+		return new NNPairClient(options, index);
+	}
+}
@@ -0,0 +1,10 @@
+#ifndef _BENCH_NNCLIENT_H
+#define _BENCH_NNCLIENT_H
+#include "../LoadGenerator.h"
+
+#define NN_PORT 27901
+
+namespace Bench {
+	Client *CreateNNPairClient(const Options &options, int index);
+}
+#endif //_BENCH_NNCLIENT_H
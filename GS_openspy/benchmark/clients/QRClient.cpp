@@ -0,0 +1,268 @@
+#include "QRClient.h"
+#include <OS/legacy/gsmsalg.h>
+#include <string.h>
+#include <sstream>
+
+#define QR2_PACKET_CHALLENGE 0x01
+#define QR2_PACKET_HEARTBEAT 0x03
+#define QR2_PACKET_KEEPALIVE 0x08
+#define QR2_PACKET_CLIENT_REGISTERED 0x0A
+#define QR2_MAGIC_1 0xFE
+#define QR2_MAGIC_2 0xFD
+#define QR2_MAX_PLAYERS 16
+#define QR2_SENT_PLAYERS 4 //player rows sent per heartbeat, whatever numplayers says
+#define QR_SERVER_KEEPALIVE_TIME 60 //seconds, half qr's timeout
+
+namespace Bench {
+	static const char *map_names[] = { "dm_bench1", "dm_bench2", "ctf_bench1", "ctf_bench2", "ctf_bench3" };
+
+	QR2Server::QR2Server(const Options &options, uint32_t seed) {
+		mp_options = &options;
+		m_rand_state = seed;
+		uint32_t key = Rand() | 0x01000000; //never 0, which qr treats as unset
+		memcpy(&m_instance_key, &key, sizeof(m_instance_key));
+		m_num_players = Rand() % (QR2_MAX_PLAYERS + 1);
+		m_ctf = Rand() % 2;
+	}
+	QR2Server::~QR2Server() {
+	}
+	std::string QR2Server::GetHeartbeat(int state_changed) {
+		std::ostringstream s;
+		std::string map = map_names[Rand() % (sizeof(map_names) / sizeof(const char *))];
+		s << "hostname" << '\0' << "bench server " << (m_rand_state & 0xFFFF) << '\0';
+		s << "gamename" << '\0' << mp_options->gamename << '\0';
+		s << "gamever" << '\0' << "1.0" << '\0';
+		s << "hostport" << '\0' << "6500" << '\0';
+		s << "mapname" << '\0' << map << '\0';
+		s << "gametype" << '\0' << (m_ctf ? "ctf" : "dm") << '\0';
+		s << "numplayers" << '\0' << m_num_players << '\0';
+		s << "maxplayers" << '\0' << QR2_MAX_PLAYERS << '\0';
+		s << "statechanged" << '\0' << state_changed << '\0';
+		s << '\0';
+
+		//player section, a big endian row count, the field names, then the rows, a 0 count ends the sections
+		s << (char)0 << (char)QR2_SENT_PLAYERS;
+		s << "player_" << '\0' << "score_" << '\0' << '\0';
+		for (int i = 0; i < QR2_SENT_PLAYERS; i++) {
+			s << "player" << i << '\0' << Rand() % 100 << '\0';
+		}
+		s << (char)0 << (char)0;
+		return s.str();
+	}
+	bool QR2Server::Send(uint8_t type, const std::string &body) {
+		std::string packet;
+		packet += (char)type;
+		packet.append((const char *)&m_instance_key, sizeof(m_instance_key));
+		packet += body;
+		return m_socket.Send(packet);
+	}
+	bool QR2Server::Register() {
+		uint8_t buffer[BENCH_RECV_BUFFER_SIZE];
+		if (!m_socket.OpenUDP(mp_options->host.c_str(), QR_PORT)) {
+			return false;
+		}
+		if (!Send(QR2_PACKET_HEARTBEAT, GetHeartbeat(3))) {
+			return false;
+		}
+		while (true) {
+			int len = m_socket.Recv(buffer, sizeof(buffer) - 1);
+			if (len <= 0) {
+				return false;
+			}
+			buffer[len] = 0;
+			if (len < 3 + QR_INSTANCE_KEY_LEN || buffer[0] != QR2_MAGIC_1 || buffer[1] != QR2_MAGIC_2) {
+				continue;
+			}
+			if (buffer[2] == QR2_PACKET_CHALLENGE) {
+				char response[90];
+				const char *challenge = (const char *)&buffer[3 + QR_INSTANCE_KEY_LEN];
+				gsseckey((unsigned char *)&response, (unsigned char *)challenge, (unsigned char *)mp_options->secretkey.c_str(), 0);
+				if (!Send(QR2_PACKET_CHALLENGE, std::string(response, strlen(response) + 1))) {
+					return false;
+				}
+			}
+			else if (buffer[2] == QR2_PACKET_CLIENT_REGISTERED) {
+				return true;
+			}
+		}
+	}
+	bool QR2Server::Heartbeat() {
+		uint8_t buffer[BENCH_RECV_BUFFER_SIZE];
+		m_num_players = (m_num_players + 1 + Rand() % 3) % (QR2_MAX_PLAYERS + 1);
+		if (!Send(QR2_PACKET_HEARTBEAT, GetHeartbeat(1))) {
+			return false;
+		}
+
+		//heartbeats aren't answered, but a keepalive behind it is, and the peer handles its packets in order
+		if (!Send(QR2_PACKET_KEEPALIVE, std::string((const char *)&m_instance_key, sizeof(m_instance_key)))) {
+			return false;
+		}
+		while (true) {
+			int len = m_socket.Recv(buffer, sizeof(buffer));
+			if (len <= 0) {
+				return false;
+			}
+			if (buffer[0] == QR2_PACKET_KEEPALIVE) {
+				return true;
+			}
+		}
+	}
+	void QR2Server::Delete() {
+		if (m_socket.IsOpen()) {
+			Send(QR2_PACKET_HEARTBEAT, GetHeartbeat(2));
+			m_socket.Close();
+		}
+	}
+
+	ServerPopulation::ServerPopulation(const Options &options) : m_options(options) {
+		mp_thread = NULL;
+		m_running = false;
+	}
+	ServerPopulation::~ServerPopulation() {
+		m_running = false;
+		if (mp_thread) {
+			delete mp_thread;
+		}
+		std::vector<QR2Server *>::iterator it = m_servers.begin();
+		while (it != m_servers.end()) {
+			QR2Server *server = *it;
+			server->Delete();
+			delete server;
+			it++;
+		}
+	}
+	bool ServerPopulation::Register() {
+		for (int i = 0; i < m_options.num_servers; i++) {
+			//seeded apart from the clients' servers, so the same population is listed on every run
+			QR2Server *server = new QR2Server(m_options, m_options.seed * 7919 + i);
+			if (!server->Register()) {
+				delete server;
+				return false;
+			}
+			m_servers.push_back(server);
+		}
+		m_running = true;
+		mp_thread = OS::CreateThread(ServerPopulation::KeepAliveThread, this, true);
+		return true;
+	}
+	void *ServerPopulation::KeepAliveThread(OS::CThread *thread) {
+		ServerPopulation *population = (ServerPopulation *)thread->getParams();
+		uint64_t last_heartbeat = OS::GetMonotonicTimeUS();
+		while (population->m_running) {
+			OS::Sleep(BENCH_STOP_POLL_TIME * 10);
+			if (OS::GetMonotonicTimeUS() - last_heartbeat < QR_SERVER_KEEPALIVE_TIME * 1000000ULL) {
+				continue;
+			}
+			last_heartbeat = OS::GetMonotonicTimeUS();
+			std::vector<QR2Server *>::iterator it = population->m_servers.begin();
+			while (it != population->m_servers.end() && population->m_running) {
+				(*it)->Heartbeat();
+				it++;
+			}
+		}
+		return NULL;
+	}
+
+	/*
+		qr2_heartbeat: each client is one registered server, an op is a heartbeat with changed player counts.
+	*/
+	class QR2HeartbeatClient : public Client {
+	public:
+		QR2HeartbeatClient(const Options &options, int index) : Client(options, index) { mp_server = NULL; };
+		~QR2HeartbeatClient() {
+			if (mp_server) {
+				mp_server->Delete();
+				delete mp_server;
+			}
+		};
+		bool Setup() {
+			if (mp_server) {
+				mp_server->Delete();
+				delete mp_server;
+			}
+			mp_server = new QR2Server(*mp_options, Rand());
+			return mp_server->Register();
+		};
+		bool RunOp() {
+			return mp_server->Heartbeat();
+		};
+	private:
+		QR2Server *mp_server;
+	};
+
+	/*
+		qr1_heartbeat: an op is a v1 heartbeat, and the basic, info, rules and players queries it's answered with.
+	*/
+	class QR1HeartbeatClient : public Client {
+	public:
+		QR1HeartbeatClient(const Options &options, int index) : Client(options, index) { };
+		bool Setup() {
+			return m_socket.OpenUDP(mp_options->host.c_str(), QR_PORT);
+		};
+		bool RunOp() {
+			char buffer[BENCH_RECV_BUFFER_SIZE];
+			std::ostringstream s;
+			int num_players = Rand() % (QR2_MAX_PLAYERS + 1);
+			s << "\\heartbeat\\6500\\gamename\\" << mp_options->gamename << "\\statechanged\\1";
+			if (!m_socket.Send(s.str())) {
+				return false;
+			}
+			while (true) {
+				int len = m_socket.Recv(buffer, sizeof(buffer) - 1);
+				if (len <= 0) {
+					return false;
+				}
+				buffer[len] = 0;
+
+				std::string query = buffer;
+				std::string echo = GetKVValue(query, "echo");
+				echo.erase(0, echo.find_first_not_of(' '));
+				s.str("");
+				if (query.find("\\secure\\") == 0) {
+					char response[90];
+					gsseckey((unsigned char *)&response, (unsigned char *)GetKVValue(query, "secure").c_str(), (unsigned char *)mp_options->secretkey.c_str(), 0);
+					s << "\\validate\\" << response;
+				}
+				else if (query.find("\\basic\\") == 0) {
+					s << "\\gamename\\" << mp_options->gamename << "\\gamever\\1.0\\location\\0";
+				}
+				else if (query.find("\\info\\") == 0) {
+					s << "\\hostname\\bench v1 server " << m_index << "\\hostport\\6500\\mapname\\" << map_names[Rand() % (sizeof(map_names) / sizeof(const char *))];
+					s << "\\gametype\\ctf\\numplayers\\" << num_players << "\\maxplayers\\" << QR2_MAX_PLAYERS;
+				}
+				else if (query.find("\\rules\\") == 0) {
+					s << "\\timelimit\\20\\fraglimit\\50\\teamplay\\1";
+				}
+				else if (query.find("\\players\\") == 0) {
+					for (int i = 0; i < num_players && i < QR2_SENT_PLAYERS; i++) {
+						s << "\\player_" << i << "\\player" << i << "\\score_" << i << "\\" << Rand() % 100;
+					}
+				}
+				else {
+					//an error, qr is dropping the server
+					return false;
+				}
+				if (!echo.empty()) {
+					s << "\\echo\\" << echo;
+				}
+				s << "\\final\\";
+				if (!m_socket.Send(s.str())) {
+					return false;
+				}
+				//the players reply is the last, qr pushes the server once it has it
+				if (query.find("\\players\\") == 0) {
+					return true;
+				}
+			}
+		};
+	private:
+		Socket m_socket;
+	};
+
+	Client *CreateQR1HeartbeatClient(const Options &options, int index) {
+		return new QR1HeartbeatClient(options, index);
+	}
+	Client *CreateQR2HeartbeatClient(const Options &options, int index) {
+		return new QR2HeartbeatClient(options, index);
+	}
+}
@@ -0,0 +1,53 @@
+#ifndef _BENCH_QRCLIENT_H
+#define _BENCH_QRCLIENT_H
+#include "../LoadGenerator.h"
+#include "../BenchSocket.h"
+
+#define QR_PORT 27900
+#define QR_INSTANCE_KEY_LEN 4
+
+namespace Bench {
+	/*
+		A game server registered with qr over the v2 protocol, heartbeat -> challenge -> response -> registered.
+		The server list scenarios register a population of these, sb2_push times how long a registration takes to reach a subscriber.
+	*/
+	class QR2Server {
+	public:
+		QR2Server(const Options &options, uint32_t seed);
+		~QR2Server();
+		bool Register();
+		bool Heartbeat(); //with changed player counts, returns once qr acknowledged it
+		void Delete(); //statechanged 2, the server is removed without waiting for its timeout
+		uint16_t GetPort() { return m_socket.GetLocalPort(); };
+	private:
+		std::string GetHeartbeat(int state_changed);
+		bool Send(uint8_t type, const std::string &body);
+		uint32_t Rand() { m_rand_state = m_rand_state * 1103515245 + 12345; return (m_rand_state >> 8) & 0xFFFFFF; };
+
+		const Options *mp_options;
+		Socket m_socket;
+		uint8_t m_instance_key[QR_INSTANCE_KEY_LEN];
+		uint32_t m_rand_state;
+		int m_num_players;
+		bool m_ctf;
+	};
+
+	//a server browser list needs servers to list, these stay registered until the benchmark exits
+	class ServerPopulation {
+	public:
+		ServerPopulation(const Options &options);
+		~ServerPopulation();
+		bool Register();
+	private:
+		static void *KeepAliveThread(OS::CThread *thread);
+
+		const Options &m_options;
+		std::vector<QR2Server *> m_servers;
+		OS::CThread *mp_thread;
+		volatile bool m_running;
+	};
+
+	Client *CreateQR1HeartbeatClient(const Options &options, int index);
+	Client *CreateQR2HeartbeatClient(const Options &options, int index);
+}
+#endif //_BENCH_QRCLIENT_H
@@ -0,0 +1,234 @@
+#include "SBClient.h"
+#include "QRClient.h"
+#include "../BenchSocket.h"
+#include <OS/legacy/gsmsalg.h>
+#include <OS/legacy/sb_crypt.h>
+#include <string.h>
+#include <sstream>
+
+#define SB_SERVER_LIST_REQUEST 0
+#define SB_PUSH_SERVER_MESSAGE 2
+#define SB_NO_SERVER_LIST 2
+#define SB_PUSH_UPDATES 4
+#define SB_NONSTANDARD_PORT_FLAG 16
+#define SB_LIST_CHALLENGE_LEN 8
+#define SB_LIST_FIELDS "\\hostname\\gametype\\mapname\\numplayers\\maxplayers"
+
+namespace Bench {
+	//the end of a v2 list, a 0 flags byte and a 0xFFFFFFFF address
+	static const char list_terminator[] = { 0, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF };
+
+	/*
+		A v2 connection, requests go out in the clear, everything sent back is encrypted with a key
+		derived from the first request's challenge, the game's secret key and the challenge in the crypt header.
+	*/
+	class SB2Connection {
+	public:
+		SB2Connection(const Options &options, uint32_t seed) {
+			mp_options = &options;
+			m_seed = seed;
+			m_got_crypt_header = false;
+			m_sent_request = false;
+		};
+		bool Connect() {
+			m_got_crypt_header = false;
+			m_sent_request = false;
+			m_plain.clear();
+			return m_socket.ConnectTCP(mp_options->host.c_str(), SB_V2_PORT);
+		};
+		bool SendListRequest(const std::string &filter, uint32_t options) {
+			std::string body;
+			uint8_t challenge[SB_LIST_CHALLENGE_LEN];
+			for (int i = 0; i < SB_LIST_CHALLENGE_LEN; i++) {
+				m_seed = m_seed * 1103515245 + 12345;
+				challenge[i] = 'a' + (m_seed >> 16) % 26;
+			}
+			if (!m_sent_request) {
+				memcpy(&m_challenge, &challenge, sizeof(m_challenge));
+				m_sent_request = true;
+			}
+
+			body += (char)SB_SERVER_LIST_REQUEST;
+			body += (char)1; //protocol version
+			body += (char)3; //encoding version
+			body.append(4, '\0'); //game version
+			body.append(mp_options->gamename.c_str(), mp_options->gamename.length() + 1); //for
+			body.append(mp_options->gamename.c_str(), mp_options->gamename.length() + 1); //from
+			body.append((const char *)&challenge, sizeof(challenge));
+			body.append(filter.c_str(), filter.length() + 1);
+			body.append(SB_LIST_FIELDS, strlen(SB_LIST_FIELDS) + 1);
+			options = htonl(options);
+			body.append((const char *)&options, sizeof(options));
+
+			uint16_t len = htons(body.length() + sizeof(uint16_t));
+			return m_socket.Send(std::string((const char *)&len, sizeof(len)) + body);
+		};
+		//reads and decrypts whatever arrives, false on timeout or disconnect
+		bool ReadMore() {
+			if (!m_socket.ReadMore()) {
+				return false;
+			}
+			std::string &pending = m_socket.GetPending();
+			if (!m_got_crypt_header) {
+				if (pending.length() < 2) {
+					return true;
+				}
+				size_t crypt_len = (uint8_t)pending[0] ^ 0xEC;
+				if (pending.length() < crypt_len + 2) {
+					return true;
+				}
+				size_t serv_len = (uint8_t)pending[crypt_len + 1] ^ 0xEA;
+				size_t header_len = crypt_len + 2 + serv_len;
+				if (pending.length() < header_len) {
+					return true;
+				}
+				const uint8_t *serv_challenge = (const uint8_t *)pending.c_str() + crypt_len + 2;
+				const char *secretkey = mp_options->secretkey.c_str();
+				int secretkey_len = strlen(secretkey);
+				for (size_t i = 0; i < serv_len; i++) {
+					m_challenge[(i * secretkey[i % secretkey_len]) % SB_LIST_CHALLENGE_LEN] ^= (uint8_t)((m_challenge[i % SB_LIST_CHALLENGE_LEN] ^ serv_challenge[i]) & 0xFF);
+				}
+				GOACryptInit(&m_crypt_state, (unsigned char *)&m_challenge, SB_LIST_CHALLENGE_LEN);
+				pending.erase(0, header_len);
+				m_got_crypt_header = true;
+			}
+			if (pending.length()) {
+				GOADecrypt(&m_crypt_state, (unsigned char *)&pending[0], pending.length());
+				m_plain += pending;
+				pending.clear();
+			}
+			return true;
+		};
+		std::string &GetPlain() { return m_plain; };
+	private:
+		const Options *mp_options;
+		Socket m_socket;
+		uint32_t m_seed;
+		uint8_t m_challenge[SB_LIST_CHALLENGE_LEN];
+		bool m_sent_request;
+		bool m_got_crypt_header;
+		GOACryptState m_crypt_state;
+		std::string m_plain;
+	};
+
+	/*
+		sb2_list: an op is a filtered list request on a kept open connection, timed until the list's terminator.
+	*/
+	class SB2ListClient : public Client {
+	public:
+		SB2ListClient(const Options &options, int index) : Client(options, index), m_connection(options, Rand()) { };
+		bool Setup() {
+			return m_connection.Connect();
+		};
+		bool RunOp() {
+			std::string &plain = m_connection.GetPlain();
+			plain.clear();
+			if (!m_connection.SendListRequest(mp_options->filter, 0)) {
+				return false;
+			}
+			//the list is header, field and server entries, no entry can contain the terminator so it isn't parsed
+			while (plain.find(std::string(list_terminator, sizeof(list_terminator))) == std::string::npos) {
+				if (!m_connection.ReadMore()) {
+					return false;
+				}
+			}
+			return true;
+		};
+	private:
+		SB2Connection m_connection;
+	};
+
+	/*
+		sb2_push: each client subscribes to the game's updates, an op registers a new server with qr and
+		is timed until the subscription delivers it, then the server is removed again.
+	*/
+	class SB2PushClient : public Client {
+	public:
+		SB2PushClient(const Options &options, int index) : Client(options, index), m_connection(options, Rand()) { };
+		bool Setup() {
+			if (!m_connection.Connect() || !m_connection.SendListRequest("", SB_NO_SERVER_LIST | SB_PUSH_UPDATES)) {
+				return false;
+			}
+			//the empty list is just the public address and port
+			std::string &plain = m_connection.GetPlain();
+			while (plain.length() < 6) {
+				if (!m_connection.ReadMore()) {
+					return false;
+				}
+			}
+			plain.erase(0, 6);
+			return true;
+		};
+		bool RunOp() {
+			QR2Server server(*mp_options, Rand());
+			if (!server.Register()) {
+				server.Delete();
+				return false;
+			}
+			uint16_t port = server.GetPort();
+			std::string &plain = m_connection.GetPlain();
+			bool found = false;
+			while (!found) {
+				//every message is length prefixed, the other clients' servers and deletes are skipped
+				while (plain.length() >= 2) {
+					uint16_t len = ((uint8_t)plain[0] << 8) | (uint8_t)plain[1];
+					if (len < 3 || plain.length() < len) {
+						break;
+					}
+					if (plain[2] == SB_PUSH_SERVER_MESSAGE && len >= 10 && (plain[3] & SB_NONSTANDARD_PORT_FLAG)) {
+						uint16_t push_port = ((uint8_t)plain[8] << 8) | (uint8_t)plain[9];
+						found = found || push_port == port;
+					}
+					plain.erase(0, len);
+				}
+				if (!found && !m_connection.ReadMore()) {
+					break;
+				}
+			}
+			server.Delete();
+			return found;
+		};
+	private:
+		SB2Connection m_connection;
+	};
+
+	/*
+		sb1_list: an op is a whole v1 session, connect, validate, list, until qr closes it after the list.
+	*/
+	class SB1ListClient : public Client {
+	public:
+		SB1ListClient(const Options &options, int index) : Client(options, index) { };
+		bool Setup() {
+			return true;
+		};
+		bool RunOp() {
+			Socket socket;
+			std::string message;
+			if (!socket.ConnectTCP(mp_options->host.c_str(), SB_V1_PORT) || !socket.ReadMessage(message, "\\final\\")) {
+				return false;
+			}
+			char response[90];
+			gsseckey((unsigned char *)&response, (unsigned char *)GetKVValue(message, "secure").c_str(), (unsigned char *)mp_options->secretkey.c_str(), 0);
+
+			std::ostringstream s;
+			s << "\\gamename\\" << mp_options->gamename << "\\gamever\\1.0\\location\\0\\validate\\" << response << "\\enctype\\0\\final\\";
+			s << "\\list\\cmp\\gamename\\" << mp_options->gamename << "\\final\\";
+			if (!socket.Send(s.str())) {
+				return false;
+			}
+
+			//packed addresses, then \final\, and the connection is closed
+			return socket.ReadMessage(message, "\\final\\");
+		};
+	};
+
+	Client *CreateSB1ListClient(const Options &options, int index) {
+		return new SB1ListClient(options, index);
+	}
+	Client *CreateSB2ListClient(const Options &options, int index) {
+		return new SB2ListClient(options, index);
+	}
+	Client *CreateSB2PushClient(const Options &options, int index) {
+		return new SB2PushClient(options, index);
+	}
+}
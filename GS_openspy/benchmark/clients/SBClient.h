@@ -0,0 +1,13 @@
+#ifndef _BENCH_SBCLIENT_H
+#define _BENCH_SBCLIENT_H
+#include "../LoadGenerator.h"
+
+#define SB_V1_PORT 28900
+#define SB_V2_PORT 28910
+
+namespace Bench {
+	Client *CreateSB1ListClient(const Options &options, int index);
+	Client *CreateSB2ListClient(const Options &options, int index);
+	Client *CreateSB2PushClient(const Options &options, int index);
+}
+#endif //_BENCH_SBCLIENT_H
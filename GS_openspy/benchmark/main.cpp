@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <vector>
+#include <string>
+#include <sstream>
+#include "main.h"
+#include "LoadGenerator.h"
+#include "Report.h"
+#include "StubWebService.h"
+#include "KVParseBench.h"
+#include "PeerIndexBench.h"
+#include "RedisPushBench.h"
+#include "RESPReplayBench.h"
+#include "FilterBench.h"
+#include "PresenceBench.h"
+#include "ChatQueueBench.h"
+#include "HeartbeatDeltaBench.h"
+#include "clients/QRClient.h"
+
+/*
+	osbench [options] <scenario...|all>
+	Drives the daemons with synthetic clients, see run_benchmark.sh for running it against a local stack.
+*/
+volatile bool g_running = true;
+
+void sig_handler(int signo) {
+	g_running = false;
+}
+
+void usage(const char *name) {
+	fprintf(stderr, "usage: %s [options] <scenario...|all>\n", name);
+	fprintf(stderr, "  --host <address>        daemons' address (%s)\n", BENCH_DEFAULT_HOST);
+	fprintf(stderr, "  --clients <n[,n...]>    concurrent clients, each scenario is run once per count (%d)\n", BENCH_DEFAULT_CLIENTS);
+	fprintf(stderr, "  --duration <seconds>    measured time per run (%d)\n", BENCH_DEFAULT_DURATION);
+	fprintf(stderr, "  --warmup <seconds>      unmeasured time before each run (%d)\n", BENCH_DEFAULT_WARMUP);
+	fprintf(stderr, "  --seed <n>              traffic seed, the same seed sends the same traffic (%d)\n", BENCH_DEFAULT_SEED);
+	fprintf(stderr, "  --servers <n>           servers registered for the list scenarios (%d)\n", BENCH_DEFAULT_SERVERS);
+	fprintf(stderr, "  --gamename <name>       (%s)\n", BENCH_DEFAULT_GAMENAME);
+	fprintf(stderr, "  --secretkey <key>       the game's secret key (%s)\n", BENCH_DEFAULT_SECRETKEY);
+	fprintf(stderr, "  --filter <filter>       server list filter (%s)\n", BENCH_DEFAULT_FILTER);
+	fprintf(stderr, "  --pid <service>=<pid>   daemon to charge CPU time to, repeatable (qr, serverbrowsing, GP, peerchat, natneg)\n");
+	fprintf(stderr, "  --output <file>         write the results, for use as a later --baseline\n");
+	fprintf(stderr, "  --baseline <file>       show the change from an earlier run's results\n");
+	fprintf(stderr, "  --label <label>         name for the results, such as the commit\n");
+	fprintf(stderr, "  --stub-web <port>       only run the stub web service, until interrupted\n");
+	fprintf(stderr, "  --kv-parse <iterations> only time the KV packet parser in process, per captured packet (%d)\n", KV_PARSE_DEFAULT_ITERATIONS);
+	fprintf(stderr, "  --peer-index <heartbeats> only time the drivers' peer lookup in process, at 1k, 10k and 100k peers (%d)\n", PEER_INDEX_DEFAULT_HEARTBEATS);
+	fprintf(stderr, "  --redis <address>       redis for the benchmarks run against it directly (%s)\n", BENCH_DEFAULT_REDIS);
+	fprintf(stderr, "  --redis-push <pushes>   only time a server push's redis commands, sent one at a time and pipelined (%d)\n", REDIS_PUSH_DEFAULT_PUSHES);
+	fprintf(stderr, "  --resp-replay <iterations> only record QR and SB replies from redis, and check and time parsing them (%d)\n", RESP_REPLAY_DEFAULT_ITERATIONS);
+	fprintf(stderr, "  --filter-servers <n>    only time the server list filter in process, over n servers (%d)\n", FILTER_BENCH_DEFAULT_SERVERS);
+	fprintf(stderr, "  --presence <changes>    only time GP status change fan-out in process, at %d online users (%d)\n", PRESENCE_BENCH_USERS, PRESENCE_BENCH_DEFAULT_UPDATES);
+	fprintf(stderr, "  --chat-queue <requests> only time how long chat backend requests wait for a worker, in process (%d)\n", CHAT_QUEUE_DEFAULT_REQUESTS);
+	fprintf(stderr, "  --heartbeat-delta <heartbeats> only time a %d player server's heartbeats written to redis by probing and as deltas (%d)\n", HEARTBEAT_DELTA_PLAYERS, HEARTBEAT_DELTA_DEFAULT_HEARTBEATS);
+	fprintf(stderr, "scenarios:\n");
+	const std::vector<Bench::Scenario> &scenarios = Bench::GetScenarios();
+	std::vector<Bench::Scenario>::const_iterator it = scenarios.begin();
+	while (it != scenarios.end()) {
+		fprintf(stderr, "  %-14s %s\n", (*it).name, (*it).description);
+		it++;
+	}
+}
+
+int run_stub_web(int port) {
+	Bench::StubWebService *service = new Bench::StubWebService(port);
+	if (!service->IsListening()) {
+		fprintf(stderr, "can't listen on port %d\n", port);
+		delete service;
+		return EXIT_FAILURE;
+	}
+	printf("stub web service listening on 127.0.0.1:%d\n", port);
+	fflush(stdout);
+	while (g_running) {
+		OS::Sleep(STUB_WEB_POLL_TIME);
+	}
+	delete service;
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+	Bench::Options options;
+	std::vector<int> client_counts;
+	std::vector<const Bench::Scenario *> scenarios;
+	const char *output = NULL, *baseline = NULL;
+	std::string label;
+	int stub_web_port = 0;
+	int kv_parse_iterations = 0;
+	int peer_index_heartbeats = 0;
+	std::string redis_address = BENCH_DEFAULT_REDIS;
+	int redis_pushes = 0;
+	int resp_replay_iterations = 0;
+	int filter_servers = 0;
+	int presence_updates = 0;
+	int chat_queue_requests = 0;
+	int heartbeat_delta_heartbeats = 0;
+
+	#ifndef _WIN32
+		signal(SIGINT, sig_handler);
+		signal(SIGTERM, sig_handler);
+		signal(SIGPIPE, SIG_IGN);
+	#else
+		WSADATA wsdata;
+		WSAStartup(MAKEWORD(1, 0), &wsdata);
+	#endif
+
+	options.host = BENCH_DEFAULT_HOST;
+	options.num_clients = BENCH_DEFAULT_CLIENTS;
+	options.duration = BENCH_DEFAULT_DURATION;
+	options.warmup = BENCH_DEFAULT_WARMUP;
+	options.seed = BENCH_DEFAULT_SEED;
+	options.num_servers = BENCH_DEFAULT_SERVERS;
+	options.gamename = BENCH_DEFAULT_GAMENAME;
+	options.secretkey = BENCH_DEFAULT_SECRETKEY;
+	options.filter = BENCH_DEFAULT_FILTER;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if (arg.find("--") == 0 && arg.compare("--help") != 0 && !has_value) {
+			fprintf(stderr, "%s needs a value\n", arg.c_str());
+			return EXIT_FAILURE;
+		}
+		if (arg.compare("--host") == 0) {
+			options.host = argv[++i];
+		}
+		else if (arg.compare("--clients") == 0) {
+			std::stringstream counts(argv[++i]);
+			std::string count;
+			while (std::getline(counts, count, ',')) {
+				if (atoi(count.c_str()) > 0) {
+					client_counts.push_back(atoi(count.c_str()));
+				}
+			}
+		}
+		else if (arg.compare("--duration") == 0) {
+			options.duration = atoi(argv[++i]);
+		}
+		else if (arg.compare("--warmup") == 0) {
+			options.warmup = atoi(argv[++i]);
+		}
+		else if (arg.compare("--seed") == 0) {
+			options.seed = strtoul(argv[++i], NULL, 10);
+		}
+		else if (arg.compare("--servers") == 0) {
+			options.num_servers = atoi(argv[++i]);
+		}
+		else if (arg.compare("--gamename") == 0) {
+			options.gamename = argv[++i];
+		}
+		else if (arg.compare("--secretkey") == 0) {
+			options.secretkey = argv[++i];
+		}
+		else if (arg.compare("--filter") == 0) {
+			options.filter = argv[++i];
+		}
+		else if (arg.compare("--pid") == 0) {
+			std::string pid = argv[++i];
+			size_t pos = pid.find('=');
+			if (pos == std::string::npos) {
+				fprintf(stderr, "--pid needs <service>=<pid>\n");
+				return EXIT_FAILURE;
+			}
+			options.daemon_pids[pid.substr(0, pos)] = atoi(pid.c_str() + pos + 1);
+		}
+		else if (arg.compare("--output") == 0) {
+			output = argv[++i];
+		}
+		else if (arg.compare("--baseline") == 0) {
+			baseline = argv[++i];
+		}
+		else if (arg.compare("--label") == 0) {
+			label = argv[++i];
+		}
+		else if (arg.compare("--stub-web") == 0) {
+			stub_web_port = atoi(argv[++i]);
+		}
+		else if (arg.compare("--kv-parse") == 0) {
+			kv_parse_iterations = atoi(argv[++i]);
+			if (kv_parse_iterations <= 0) {
+				kv_parse_iterations = KV_PARSE_DEFAULT_ITERATIONS;
+			}
+		}
+		else if (arg.compare("--peer-index") == 0) {
+			peer_index_heartbeats = atoi(argv[++i]);
+			if (peer_index_heartbeats <= 0) {
+				peer_index_heartbeats = PEER_INDEX_DEFAULT_HEARTBEATS;
+			}
+		}
+		else if (arg.compare("--redis") == 0) {
+			redis_address = argv[++i];
+		}
+		else if (arg.compare("--redis-push") == 0) {
+			redis_pushes = atoi(argv[++i]);
+			if (redis_pushes <= 0) {
+				redis_pushes = REDIS_PUSH_DEFAULT_PUSHES;
+			}
+		}
+		else if (arg.compare("--resp-replay") == 0) {
+			resp_replay_iterations = atoi(argv[++i]);
+			if (resp_replay_iterations <= 0) {
+				resp_replay_iterations = RESP_REPLAY_DEFAULT_ITERATIONS;
+			}
+		}
+		else if (arg.compare("--filter-servers") == 0) {
+			filter_servers = atoi(argv[++i]);
+			if (filter_servers <= 0) {
+				filter_servers = FILTER_BENCH_DEFAULT_SERVERS;
+			}
+		}
+		else if (arg.compare("--presence") == 0) {
+			presence_updates = atoi(argv[++i]);
+			if (presence_updates <= 0) {
+				presence_updates = PRESENCE_BENCH_DEFAULT_UPDATES;
+			}
+		}
+		else if (arg.compare("--chat-queue") == 0) {
+			chat_queue_requests = atoi(argv[++i]);
+			if (chat_queue_requests <= 0) {
+				chat_queue_requests = CHAT_QUEUE_DEFAULT_REQUESTS;
+			}
+		}
+		else if (arg.compare("--heartbeat-delta") == 0) {
+			heartbeat_delta_heartbeats = atoi(argv[++i]);
+			if (heartbeat_delta_heartbeats <= 0) {
+				heartbeat_delta_heartbeats = HEARTBEAT_DELTA_DEFAULT_HEARTBEATS;
+			}
+		}
+		else if (arg.compare("all") == 0) {
+			const std::vector<Bench::Scenario> &all = Bench::GetScenarios();
+			for (size_t j = 0; j < all.size(); j++) {
+				scenarios.push_back(&all[j]);
+			}
+		}
+		else if (Bench::FindScenario(arg)) {
+			scenarios.push_back(Bench::FindScenario(arg));
+		}
+		else {
+			usage(argv[0]);
+			return arg.compare("--help") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (stub_web_port) {
+		return run_stub_web(stub_web_port);
+	}
+	if (kv_parse_iterations) {
+		return Bench::RunKVParseBench(kv_parse_iterations);
+	}
+	if (peer_index_heartbeats) {
+		return Bench::RunPeerIndexBench(peer_index_heartbeats);
+	}
+	if (redis_pushes) {
+		return Bench::RunRedisPushBench(redis_address.c_str(), redis_pushes);
+	}
+	if (resp_replay_iterations) {
+		return Bench::RunRESPReplayBench(redis_address.c_str(), resp_replay_iterations);
+	}
+	if (filter_servers) {
+		return Bench::RunFilterBench(options.filter.c_str(), filter_servers);
+	}
+	if (presence_updates) {
+		return Bench::RunPresenceBench(presence_updates);
+	}
+	if (chat_queue_requests) {
+		return Bench::RunChatQueueBench(chat_queue_requests);
+	}
+	if (heartbeat_delta_heartbeats) {
+		return Bench::RunHeartbeatDeltaBench(redis_address.c_str(), heartbeat_delta_heartbeats);
+	}
+	if (scenarios.empty()) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (client_counts.empty()) {
+		client_counts.push_back(BENCH_DEFAULT_CLIENTS);
+	}
+
+	Bench::Report report(options, label);
+	if (baseline && !report.LoadBaseline(baseline)) {
+		fprintf(stderr, "can't read baseline %s\n", baseline);
+		return EXIT_FAILURE;
+	}
+
+	Bench::ServerPopulation *population = NULL;
+	for (size_t i = 0; i < scenarios.size() && g_running; i++) {
+		const Bench::Scenario *scenario = scenarios[i];
+		//registered once, before the first scenario listing them
+		if (scenario->needs_servers && !population) {
+			printf("registering %d servers\n", options.num_servers);
+			fflush(stdout);
+			population = new Bench::ServerPopulation(options);
+			if (!population->Register()) {
+				fprintf(stderr, "can't register servers with qr at %s:%d\n", options.host.c_str(), QR_PORT);
+				delete population;
+				return EXIT_FAILURE;
+			}
+		}
+		for (size_t j = 0; j < client_counts.size() && g_running; j++) {
+			Bench::Options run_options = options;
+			run_options.num_clients = client_counts[j];
+			printf("running %s with %d clients\n", scenario->name, run_options.num_clients);
+			fflush(stdout);
+
+			Bench::LoadGenerator generator(run_options);
+			report.AddResult(generator.Run(scenario));
+		}
+	}
+
+	if (population) {
+		delete population;
+	}
+
+	report.Print();
+	if (output && !report.Write(output)) {
+		fprintf(stderr, "can't write %s\n", output);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,4 @@
+#ifndef _MAIN_H
+#define _MAIN_H
+	#include <OS/OpenSpy.h>
+#endif
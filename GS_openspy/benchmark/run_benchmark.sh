@@ -0,0 +1,77 @@
+#!/usr/bin/env bash
+# Runs osbench against a local stack: a throwaway redis, the stub web service and the daemons built in <bin dir>.
+# usage: run_benchmark.sh <bin dir> [osbench options] <scenario...|all>
+# e.g.   run_benchmark.sh build/bin --clients 1,8,32 --label $(git rev-parse --short HEAD) --output new.tsv --baseline old.tsv all
+set -e
+
+if [ $# -lt 2 ]; then
+	echo "usage: $0 <bin dir> [osbench options] <scenario...|all>"
+	exit 1
+fi
+BIN_DIR=$(cd "$1" && pwd)
+shift
+SOURCE_DIR=$(cd "$(dirname "$0")/.." && pwd)
+REDIS_PORT=${REDIS_PORT:-16379}
+WEB_PORT=${WEB_PORT:-18080}
+RUN_DIR=$(mktemp -d)
+PIDS=()
+
+cleanup() {
+	for pid in "${PIDS[@]}"; do
+		kill "$pid" 2>/dev/null || true
+	done
+	wait 2>/dev/null || true
+	rm -rf "$RUN_DIR"
+}
+trap cleanup EXIT
+
+service_config() {
+	local name=$1 drivers=$2
+	cat <<CFG
+$name {
+	redis_address = "127.0.0.1:$REDIS_PORT";
+	num_async_tasks = 4;
+	webservices_url = "http://127.0.0.1:$WEB_PORT";
+	drivers {
+$drivers
+	}
+}
+CFG
+}
+
+driver() {
+	local name=$1 port=$2 extra=$3
+	printf '\t\t%s {\n\t\t\taddress = "127.0.0.1";\n\t\t\tport = %d;\n%s\t\t}\n' "$name" "$port" "$extra"
+}
+
+{
+	service_config qr "$(driver main 27900)"
+	service_config serverbrowsing "$(driver v1 28900 $'\t\t\tversion = 1;\n')$(echo; driver v2 28910 $'\t\t\tversion = 2;\n')"
+	service_config GP "$(driver main 29900)"
+	service_config natneg "$(driver main 27901)"
+	service_config peerchat "$(driver main 6667)"
+} > "$RUN_DIR/openspy.cfg"
+
+redis-server --port "$REDIS_PORT" --save "" --appendonly no --dir "$RUN_DIR" > "$RUN_DIR/redis.log" 2>&1 &
+PIDS+=($!)
+until redis-cli -p "$REDIS_PORT" ping > /dev/null 2>&1; do
+	sleep 0.1
+done
+redis-cli -p "$REDIS_PORT" < "$SOURCE_DIR/redis_init_dbg.txt" > /dev/null
+
+"$BIN_DIR/osbench" --stub-web "$WEB_PORT" > "$RUN_DIR/stub_web.log" 2>&1 &
+PIDS+=($!)
+
+PID_ARGS=()
+for service in qr serverbrowsing GP natneg peerchat; do
+	if [ ! -x "$BIN_DIR/$service" ]; then
+		echo "no $service in $BIN_DIR, its scenarios will fail"
+		continue
+	fi
+	(cd "$RUN_DIR" && exec "$BIN_DIR/$service" > "$RUN_DIR/$service.log" 2>&1) &
+	PIDS+=($!)
+	PID_ARGS+=(--pid "$service=$!")
+done
+sleep 1
+
+"$BIN_DIR/osbench" --redis "127.0.0.1:$REDIS_PORT" "${PID_ARGS[@]}" "$@"
@@ -0,0 +1,319 @@
+#include "Instrument.h"
+#include <algorithm>
+#include <string.h>
+#include <stdio.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <time.h>
+#endif
+namespace OS {
+	static uint32_t g_next_thread_slot = 0;
+	static INSTRUMENT_THREAD_LOCAL int t_thread_slot = -1;
+
+	uint64_t GetMonotonicTimeUS() {
+		#ifdef _WIN32
+			LARGE_INTEGER frequency, counter;
+			QueryPerformanceFrequency(&frequency);
+			QueryPerformanceCounter(&counter);
+			return (uint64_t)(counter.QuadPart / (frequency.QuadPart / 1000000));
+		#else
+			struct timespec ts;
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+		#endif
+	}
+
+	Instrument::Instrument(const char *name, const char *help, EInstrumentType type, std::string labels) {
+		m_name = name;
+		m_help = help;
+		m_type = type;
+		m_labels = labels;
+		InstrumentRegistry::getSingleton()->AddInstrument(this);
+	}
+	Instrument::~Instrument() {
+		InstrumentRegistry::getSingleton()->RemoveInstrument(this);
+	}
+	int Instrument::GetThreadSlot() {
+		if (t_thread_slot == -1) {
+			t_thread_slot = CMutex::SafeAdd(&g_next_thread_slot, 1) % INSTRUMENT_THREAD_SLOTS;
+		}
+		return t_thread_slot;
+	}
+	std::string Instrument::MakeLabel(const char *name, std::string value) {
+		std::string escaped;
+		for (size_t i = 0; i < value.length(); i++) {
+			if (value[i] == '\\' || value[i] == '"') {
+				escaped += '\\';
+			}
+			else if (value[i] == '\n') {
+				escaped += "\\n";
+				continue;
+			}
+			escaped += value[i];
+		}
+		return std::string(name) + "=\"" + escaped + "\"";
+	}
+	void Instrument::RenderName(std::ostringstream &s, const char *suffix, std::string extra_label) {
+		s << INSTRUMENT_NAME_PREFIX << m_name << suffix;
+		if (!m_labels.empty() || !extra_label.empty()) {
+			s << "{" << m_labels << (!m_labels.empty() && !extra_label.empty() ? "," : "") << extra_label << "}";
+		}
+		s << " ";
+	}
+
+	Counter::Counter(const char *name, const char *help, std::string labels) : Instrument(name, help, EInstrumentType_Counter, labels) {
+		memset(&m_slots, 0, sizeof(m_slots));
+	}
+	uint64_t Counter::GetValue() {
+		uint64_t total = 0;
+		for (int i = 0; i < INSTRUMENT_THREAD_SLOTS; i++) {
+			total += CMutex::SafeAdd64(&m_slots[i].value, 0);
+		}
+		return total;
+	}
+	void Counter::Render(std::ostringstream &s) {
+		RenderName(s, "_total");
+		s << GetValue() << "\n";
+	}
+
+	Gauge::Gauge(const char *name, const char *help, std::string labels) : Instrument(name, help, EInstrumentType_Gauge, labels) {
+		memset(&m_slots, 0, sizeof(m_slots));
+	}
+	int64_t Gauge::GetValue() {
+		uint64_t total = 0;
+		for (int i = 0; i < INSTRUMENT_THREAD_SLOTS; i++) {
+			total += CMutex::SafeAdd64(&m_slots[i].value, 0);
+		}
+		return (int64_t)total;
+	}
+	void Gauge::Render(std::ostringstream &s) {
+		RenderName(s, "");
+		s << GetValue() << "\n";
+	}
+
+	LatencyHistogram::LatencyHistogram(const char *name, const char *help, std::string labels) : Instrument(name, help, EInstrumentType_Histogram, labels) {
+		mp_slots = new HistogramSlot[INSTRUMENT_THREAD_SLOTS];
+		memset(mp_slots, 0, sizeof(HistogramSlot) * INSTRUMENT_THREAD_SLOTS);
+	}
+	LatencyHistogram::~LatencyHistogram() {
+		delete[] mp_slots;
+	}
+	int LatencyHistogram::GetBucket(uint64_t value) {
+		if (value < INSTRUMENT_HISTOGRAM_SUB_COUNT) {
+			return (int)value;
+		}
+		#ifdef _WIN32
+			unsigned long msb;
+			_BitScanReverse64(&msb, value);
+		#else
+			int msb = 63 - __builtin_clzll(value);
+		#endif
+		if ((int)msb >= INSTRUMENT_HISTOGRAM_MAX_BITS) {
+			return INSTRUMENT_HISTOGRAM_BUCKETS - 1;
+		}
+		int shift = msb - INSTRUMENT_HISTOGRAM_SUB_BITS;
+		return (shift + 1) * INSTRUMENT_HISTOGRAM_SUB_COUNT + (int)((value >> shift) & (INSTRUMENT_HISTOGRAM_SUB_COUNT - 1));
+	}
+	uint64_t LatencyHistogram::GetBucketUpperBound(int bucket) {
+		if (bucket < INSTRUMENT_HISTOGRAM_SUB_COUNT) {
+			return bucket + 1;
+		}
+		int shift = bucket / INSTRUMENT_HISTOGRAM_SUB_COUNT - 1;
+		uint64_t sub = bucket % INSTRUMENT_HISTOGRAM_SUB_COUNT;
+		return (INSTRUMENT_HISTOGRAM_SUB_COUNT + sub + 1) << shift;
+	}
+	void LatencyHistogram::Record(uint64_t value_us) {
+		HistogramSlot *slot = &mp_slots[GetThreadSlot()];
+		//shifted down by one so a bucket holds (lower, upper], matching prometheus' inclusive le
+		CMutex::SafeIncr(&slot->counts[GetBucket(value_us > 0 ? value_us - 1 : 0)]);
+		CMutex::SafeAdd64(&slot->sum, value_us);
+	}
+	void LatencyHistogram::GetCounts(uint64_t *buckets, uint64_t &total, uint64_t &sum) {
+		total = 0;
+		sum = 0;
+		memset(buckets, 0, sizeof(uint64_t) * INSTRUMENT_HISTOGRAM_BUCKETS);
+		for (int i = 0; i < INSTRUMENT_THREAD_SLOTS; i++) {
+			HistogramSlot *slot = &mp_slots[i];
+			for (int j = 0; j < INSTRUMENT_HISTOGRAM_BUCKETS; j++) {
+				uint32_t count = CMutex::SafeAdd(&slot->counts[j], 0);
+				buckets[j] += count;
+				total += count;
+			}
+			sum += CMutex::SafeAdd64(&slot->sum, 0);
+		}
+	}
+	uint64_t LatencyHistogram::GetPercentile(double percentile) {
+		uint64_t buckets[INSTRUMENT_HISTOGRAM_BUCKETS], total, sum, count = 0;
+		GetCounts(buckets, total, sum);
+		if (total == 0) {
+			return 0;
+		}
+		for (int i = 0; i < INSTRUMENT_HISTOGRAM_BUCKETS; i++) {
+			count += buckets[i];
+			if (count >= total * percentile) {
+				return GetBucketUpperBound(i);
+			}
+		}
+		return GetBucketUpperBound(INSTRUMENT_HISTOGRAM_BUCKETS - 1);
+	}
+	void LatencyHistogram::Render(std::ostringstream &s) {
+		uint64_t buckets[INSTRUMENT_HISTOGRAM_BUCKETS], total, sum, count = 0;
+		char le[32];
+		GetCounts(buckets, total, sum);
+
+		//powers of two are bucket boundaries, so the coarser export is exact
+		int bucket = 0;
+		for (int i = 0; i <= INSTRUMENT_HISTOGRAM_EXPORT_BITS; i++) {
+			uint64_t bound = 1ULL << i;
+			while (bucket < INSTRUMENT_HISTOGRAM_BUCKETS && GetBucketUpperBound(bucket) <= bound) {
+				count += buckets[bucket++];
+			}
+			snprintf(le, sizeof(le), "%g", bound / 1000000.0);
+			RenderName(s, "_seconds_bucket", MakeLabel("le", le));
+			s << count << "\n";
+		}
+		RenderName(s, "_seconds_bucket", MakeLabel("le", "+Inf"));
+		s << total << "\n";
+		RenderName(s, "_seconds_sum");
+		s << sum / 1000000.0 << "\n";
+		RenderName(s, "_seconds_count");
+		s << total << "\n";
+	}
+
+	InstrumentRegistry *InstrumentRegistry::getSingleton() {
+		//instruments are constructed during static initialization, so this can't be a global
+		static InstrumentRegistry *registry = new InstrumentRegistry();
+		return registry;
+	}
+	InstrumentRegistry::InstrumentRegistry() {
+		mp_mutex = OS::CreateMutex();
+	}
+	void InstrumentRegistry::AddInstrument(Instrument *instrument) {
+		mp_mutex->lock();
+		m_instruments.push_back(instrument);
+		mp_mutex->unlock();
+	}
+	void InstrumentRegistry::RemoveInstrument(Instrument *instrument) {
+		mp_mutex->lock();
+		std::vector<Instrument *>::iterator it = std::find(m_instruments.begin(), m_instruments.end(), instrument);
+		if (it != m_instruments.end()) {
+			m_instruments.erase(it);
+		}
+		mp_mutex->unlock();
+	}
+	void InstrumentRegistry::AddCollector(MetricsCollector *collector) {
+		mp_mutex->lock();
+		m_collectors.push_back(collector);
+		mp_mutex->unlock();
+	}
+	void InstrumentRegistry::RemoveCollectors(const void *object) {
+		mp_mutex->lock();
+		std::vector<MetricsCollector *>::iterator it = m_collectors.begin();
+		while (it != m_collectors.end()) {
+			MetricsCollector *collector = *it;
+			if (collector->GetObject() == object) {
+				delete collector;
+				it = m_collectors.erase(it);
+				continue;
+			}
+			it++;
+		}
+		mp_mutex->unlock();
+	}
+	std::string InstrumentRegistry::SanitizeName(const std::string &name) {
+		std::string ret = name;
+		for (size_t i = 0; i < ret.length(); i++) {
+			char c = ret[i];
+			if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_')) {
+				ret[i] = '_';
+			}
+		}
+		return ret;
+	}
+	void InstrumentRegistry::RenderCollectorValue(std::ostringstream &s, const std::string &prefix, const MetricValue &value) {
+		std::vector<std::pair<MetricType, struct _Value> >::const_iterator it = value.arr_value.values.begin();
+		int index = 0;
+		while (it != value.arr_value.values.end()) {
+			const MetricValue &child = (*it).second;
+			//arrays of unnamed or same named items, ie. one per task, are told apart by position
+			std::string name;
+			if (child.key.empty()) {
+				std::ostringstream ss;
+				ss << prefix << "_" << index;
+				name = ss.str();
+			}
+			else {
+				name = prefix + "_" + SanitizeName(child.key);
+				std::vector<std::pair<MetricType, struct _Value> >::const_iterator it2 = value.arr_value.values.begin();
+				while (it2 != value.arr_value.values.end()) {
+					if (it2 != it && (*it2).second.key == child.key) {
+						std::ostringstream ss;
+						ss << name << "_" << index;
+						name = ss.str();
+						break;
+					}
+					it2++;
+				}
+			}
+			switch (child.type) {
+				case MetricType_Array:
+					RenderCollectorValue(s, name, child);
+					break;
+				case MetricType_Integer:
+					s << name << " " << child.value._int << "\n";
+					break;
+				case MetricType_Float:
+					s << name << " " << child.value._float << "\n";
+					break;
+				default:
+					break;
+			}
+			index++;
+			it++;
+		}
+	}
+	std::string InstrumentRegistry::RenderPrometheus() {
+		std::ostringstream s;
+		static const char *type_names[] = { "counter", "gauge", "histogram" };
+
+		mp_mutex->lock();
+		//a metric's samples have to follow its one HELP and TYPE, so instruments with labels are grouped under the first with their name
+		std::vector<bool> rendered(m_instruments.size(), false);
+		for (size_t i = 0; i < m_instruments.size(); i++) {
+			if (rendered[i]) {
+				continue;
+			}
+			Instrument *instrument = m_instruments[i];
+			std::string name = std::string(INSTRUMENT_NAME_PREFIX) + instrument->GetName();
+			if (instrument->GetType() == EInstrumentType_Counter) {
+				name += "_total";
+			}
+			else if (instrument->GetType() == EInstrumentType_Histogram) {
+				name += "_seconds";
+			}
+			s << "# HELP " << name << " " << instrument->GetHelp() << "\n";
+			s << "# TYPE " << name << " " << type_names[instrument->GetType()] << "\n";
+			for (size_t j = i; j < m_instruments.size(); j++) {
+				if (!rendered[j] && strcmp(m_instruments[j]->GetName(), instrument->GetName()) == 0) {
+					m_instruments[j]->Render(s);
+					rendered[j] = true;
+				}
+			}
+		}
+
+		std::vector<MetricsCollector *>::iterator it2 = m_collectors.begin();
+		while (it2 != m_collectors.end()) {
+			MetricsCollector *collector = *it2;
+			MetricValue value = collector->Collect();
+			std::string prefix = std::string(INSTRUMENT_NAME_PREFIX) + SanitizeName(collector->GetName());
+			if (value.type == MetricType_Array) {
+				RenderCollectorValue(s, prefix, value);
+			}
+			it2++;
+		}
+		mp_mutex->unlock();
+		return s.str();
+	}
+}
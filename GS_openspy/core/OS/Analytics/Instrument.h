@@ -0,0 +1,188 @@
+#ifndef _OS_INSTRUMENT_H
+#define _OS_INSTRUMENT_H
+#include <OS/OpenSpy.h>
+#include <OS/Mutex.h>
+#include "Metric.h"
+#include <string>
+#include <vector>
+#include <sstream>
+
+#define INSTRUMENT_THREAD_SLOTS 32 //threads past this share slots, which stays correct as every update is atomic
+#define INSTRUMENT_NAME_PREFIX "openspy_"
+
+//HDR style, 2^INSTRUMENT_HISTOGRAM_SUB_BITS linear sub-buckets per power of two, so every bucket is within 12.5% of its value
+#define INSTRUMENT_HISTOGRAM_SUB_BITS 3
+#define INSTRUMENT_HISTOGRAM_SUB_COUNT (1 << INSTRUMENT_HISTOGRAM_SUB_BITS)
+#define INSTRUMENT_HISTOGRAM_MAX_BITS 36 //microseconds, ~19 hours, longer samples go in the last bucket
+#define INSTRUMENT_HISTOGRAM_BUCKETS ((INSTRUMENT_HISTOGRAM_MAX_BITS - INSTRUMENT_HISTOGRAM_SUB_BITS + 1) * INSTRUMENT_HISTOGRAM_SUB_COUNT)
+#define INSTRUMENT_HISTOGRAM_EXPORT_BITS 26 //exported as power of two buckets up to ~67 seconds
+
+#ifdef _WIN32
+	#define INSTRUMENT_THREAD_LOCAL __declspec(thread)
+#else
+	#define INSTRUMENT_THREAD_LOCAL __thread
+#endif
+
+namespace OS {
+	enum EInstrumentType {
+		EInstrumentType_Counter,
+		EInstrumentType_Gauge,
+		EInstrumentType_Histogram,
+	};
+
+	/*
+		Updates only touch the calling thread's slot, so the hot path never shares a cache line or takes a lock.
+		Reading sums the slots, and happens on the thread serving the scrape.
+	*/
+	class Instrument {
+	public:
+		/*
+			Instruments sharing a name are one metric told apart by their labels, ie. one per HTTP endpoint,
+			labels is in the prometheus format, ie. endpoint="...", see MakeLabel
+		*/
+		Instrument(const char *name, const char *help, EInstrumentType type, std::string labels = "");
+		virtual ~Instrument();
+
+		const char *GetName() { return m_name; };
+		const char *GetHelp() { return m_help; };
+		EInstrumentType GetType() { return m_type; };
+
+		//appends the instrument's samples in the prometheus text format, the registry writes the HELP and TYPE lines
+		virtual void Render(std::ostringstream &s) = 0;
+
+		static int GetThreadSlot();
+		static std::string MakeLabel(const char *name, std::string value);
+	protected:
+		//name, suffix and the labels, extra_label is added to the instrument's own
+		void RenderName(std::ostringstream &s, const char *suffix, std::string extra_label = "");
+	private:
+		const char *m_name;
+		const char *m_help;
+		EInstrumentType m_type;
+		std::string m_labels;
+	};
+
+	typedef struct {
+		uint64_t value;
+		char pad[64 - sizeof(uint64_t)];
+	} InstrumentSlot;
+
+	class Counter : public Instrument {
+	public:
+		Counter(const char *name, const char *help, std::string labels = "");
+		void Add(uint64_t amount = 1) { CMutex::SafeAdd64(&m_slots[GetThreadSlot()].value, amount); };
+		uint64_t GetValue();
+		void Render(std::ostringstream &s);
+	private:
+		InstrumentSlot m_slots[INSTRUMENT_THREAD_SLOTS];
+	};
+
+	//for values which go up and down, such as open connections, a thread's decrement can land in another thread's slot total
+	class Gauge : public Instrument {
+	public:
+		Gauge(const char *name, const char *help, std::string labels = "");
+		void Add(int64_t amount) { CMutex::SafeAdd64(&m_slots[GetThreadSlot()].value, (uint64_t)amount); };
+		void Incr() { Add(1); };
+		void Decr() { Add(-1); };
+		int64_t GetValue();
+		void Render(std::ostringstream &s);
+	private:
+		InstrumentSlot m_slots[INSTRUMENT_THREAD_SLOTS];
+	};
+
+	typedef struct {
+		uint32_t counts[INSTRUMENT_HISTOGRAM_BUCKETS];
+		uint64_t sum;
+	} HistogramSlot;
+
+	//latencies in microseconds, exported in seconds
+	class LatencyHistogram : public Instrument {
+	public:
+		LatencyHistogram(const char *name, const char *help, std::string labels = "");
+		~LatencyHistogram();
+		void Record(uint64_t value_us);
+
+		//merged counts of every slot, buckets needs INSTRUMENT_HISTOGRAM_BUCKETS entries
+		void GetCounts(uint64_t *buckets, uint64_t &total, uint64_t &sum);
+		//upper bound of the bucket the percentile falls in, 0 if nothing was recorded
+		uint64_t GetPercentile(double percentile);
+		void Render(std::ostringstream &s);
+
+		static int GetBucket(uint64_t value);
+		static uint64_t GetBucketUpperBound(int bucket); //inclusive, as Record shifts values down by one
+	private:
+		HistogramSlot *mp_slots; //INSTRUMENT_THREAD_SLOTS of them, each thread writes only its own
+	};
+
+	uint64_t GetMonotonicTimeUS();
+
+	/*
+		Times a block of code into a histogram, ie. OS::Span span(&g_redis_command_span);
+	*/
+	class Span {
+	public:
+		Span(LatencyHistogram *histogram) { mp_histogram = histogram; m_start = GetMonotonicTimeUS(); };
+		~Span() { mp_histogram->Record(GetMonotonicTimeUS() - m_start); };
+	private:
+		LatencyHistogram *mp_histogram;
+		uint64_t m_start;
+	};
+
+	/*
+		Exports a component's existing MetricValue tree, the integer leaves become gauges named after their path.
+		Only for things which are cheap to collect, it runs on the scraping thread, but takes whatever locks GetMetrics does.
+	*/
+	class MetricsCollector {
+	public:
+		MetricsCollector(std::string name, const void *object) { m_name = name; mp_object = object; };
+		virtual ~MetricsCollector() { };
+		virtual MetricValue Collect() = 0;
+		const std::string &GetName() { return m_name; };
+		const void *GetObject() { return mp_object; };
+	private:
+		std::string m_name;
+		const void *mp_object;
+	};
+	template<typename T>
+	class MetricsCollectorT : public MetricsCollector {
+	public:
+		MetricsCollectorT(std::string name, T *object, MetricValue (T::*method)()) : MetricsCollector(name, object) { mp_typed_object = object; mp_method = method; };
+		MetricValue Collect() { return (mp_typed_object->*mp_method)(); };
+	private:
+		T *mp_typed_object;
+		MetricValue (T::*mp_method)();
+	};
+
+	/*
+		Instruments are usually globals, registering themselves when constructed.
+	*/
+	class InstrumentRegistry {
+	public:
+		static InstrumentRegistry *getSingleton();
+
+		void AddInstrument(Instrument *instrument);
+		void RemoveInstrument(Instrument *instrument);
+
+		template<typename T>
+		void AddCollector(std::string name, T *object, MetricValue (T::*method)()) {
+			AddCollector(new MetricsCollectorT<T>(name, object, method));
+		}
+		template<typename T>
+		void AddCollector(std::string name, T *object) {
+			AddCollector(name, object, &T::GetMetrics);
+		}
+		void AddCollector(MetricsCollector *collector);
+		void RemoveCollectors(const void *object);
+
+		std::string RenderPrometheus();
+	private:
+		InstrumentRegistry();
+		void RenderCollectorValue(std::ostringstream &s, const std::string &prefix, const MetricValue &value);
+		static std::string SanitizeName(const std::string &name);
+
+		std::vector<Instrument *> m_instruments;
+		std::vector<MetricsCollector *> m_collectors;
+		OS::CMutex *mp_mutex;
+	};
+}
+#endif //_OS_INSTRUMENT_H
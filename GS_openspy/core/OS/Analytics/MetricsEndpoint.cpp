@@ -0,0 +1,131 @@
+#include "MetricsEndpoint.h"
+#include <string.h>
+#ifndef _WIN32
+#include <sys/select.h>
+#endif
+namespace OS {
+	MetricsEndpoint *g_metrics_endpoint = NULL;
+
+	MetricsEndpoint::MetricsEndpoint(const char *address, uint16_t port) {
+		struct sockaddr_in local_addr;
+		int on = 1;
+		m_running = false;
+		mp_thread = NULL;
+
+		if ((m_sd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0) {
+			OS::LogText(OS::ELogLevel_Error, "Metrics endpoint: socket error");
+			return;
+		}
+		setsockopt(m_sd, SOL_SOCKET, SO_REUSEADDR, (const char *)&on, sizeof(on));
+
+		memset(&local_addr, 0, sizeof(local_addr));
+		local_addr.sin_family = AF_INET;
+		local_addr.sin_port = htons(port);
+		local_addr.sin_addr.s_addr = inet_addr(address);
+		if (bind(m_sd, (struct sockaddr *)&local_addr, sizeof(local_addr)) < 0 || listen(m_sd, SOMAXCONN) < 0) {
+			OS::LogText(OS::ELogLevel_Error, "Metrics endpoint: can't listen on %s:%d", address, port);
+			close(m_sd);
+			m_sd = -1;
+			return;
+		}
+
+		m_running = true;
+		mp_thread = OS::CreateThread(MetricsEndpoint::ListenerThread, this, true);
+		OS::LogText(OS::ELogLevel_Info, "Metrics endpoint listening on %s:%d", address, port);
+	}
+	MetricsEndpoint::~MetricsEndpoint() {
+		m_running = false;
+		if (mp_thread) {
+			delete mp_thread;
+		}
+		if (m_sd != -1) {
+			close(m_sd);
+		}
+	}
+	void *MetricsEndpoint::ListenerThread(OS::CThread *thread) {
+		MetricsEndpoint *endpoint = (MetricsEndpoint *)thread->getParams();
+		while (endpoint->m_running) {
+			fd_set fdset;
+			struct timeval timeout;
+			timeout.tv_sec = 0;
+			timeout.tv_usec = METRICS_ENDPOINT_POLL_TIME * 1000;
+			FD_ZERO(&fdset);
+			FD_SET(endpoint->m_sd, &fdset);
+			if (select(endpoint->m_sd + 1, &fdset, NULL, NULL, &timeout) <= 0) {
+				continue;
+			}
+
+			int sd = accept(endpoint->m_sd, NULL, NULL);
+			if (sd < 0) {
+				continue;
+			}
+			endpoint->HandleClient(sd);
+			close(sd);
+		}
+		return NULL;
+	}
+	void MetricsEndpoint::HandleClient(int sd) {
+		char request[METRICS_ENDPOINT_MAX_REQUEST + 1];
+		int len = 0;
+
+		#ifdef _WIN32
+			DWORD timeout = METRICS_ENDPOINT_READ_TIMEOUT * 1000;
+		#else
+			struct timeval timeout;
+			timeout.tv_sec = METRICS_ENDPOINT_READ_TIMEOUT;
+			timeout.tv_usec = 0;
+		#endif
+		setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
+
+		//only the request line matters, but the headers are read so the client isn't reset
+		while (len < METRICS_ENDPOINT_MAX_REQUEST) {
+			int r = recv(sd, request + len, METRICS_ENDPOINT_MAX_REQUEST - len, 0);
+			if (r <= 0) {
+				return;
+			}
+			len += r;
+			request[len] = 0;
+			if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) {
+				break;
+			}
+		}
+
+		std::string body, status;
+		if (strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET /metrics?", 13) == 0) {
+			status = "200 OK";
+			body = InstrumentRegistry::getSingleton()->RenderPrometheus();
+		}
+		else {
+			status = "404 Not Found";
+			body = "not found\n";
+		}
+
+		std::ostringstream s;
+		s << "HTTP/1.1 " << status << "\r\n";
+		s << "Content-Type: text/plain; version=0.0.4\r\n";
+		s << "Content-Length: " << body.length() << "\r\n";
+		s << "Connection: close\r\n\r\n";
+		s << body;
+
+		std::string response = s.str();
+		const char *p = response.c_str();
+		int remaining = response.length();
+		while (remaining > 0) {
+			int sent = send(sd, p, remaining, MSG_NOSIGNAL);
+			if (sent <= 0) {
+				break;
+			}
+			p += sent;
+			remaining -= sent;
+		}
+	}
+	void SetupMetricsEndpoint(const char *address, uint16_t port) {
+		g_metrics_endpoint = new MetricsEndpoint(address ? address : METRICS_ENDPOINT_DEFAULT_ADDRESS, port);
+	}
+	void ShutdownMetricsEndpoint() {
+		if (g_metrics_endpoint) {
+			delete g_metrics_endpoint;
+			g_metrics_endpoint = NULL;
+		}
+	}
+}
@@ -0,0 +1,33 @@
+#ifndef _OS_METRICS_ENDPOINT_H
+#define _OS_METRICS_ENDPOINT_H
+#include <OS/OpenSpy.h>
+#include <OS/Thread.h>
+#include "Instrument.h"
+
+#define METRICS_ENDPOINT_DEFAULT_ADDRESS "127.0.0.1"
+#define METRICS_ENDPOINT_POLL_TIME 500 //ms, how often the listener checks if it's shutting down
+#define METRICS_ENDPOINT_READ_TIMEOUT 2 //seconds to wait for a scraper's request
+#define METRICS_ENDPOINT_MAX_REQUEST 4096
+
+namespace OS {
+	/*
+		Serves GET /metrics in the prometheus text format, from its own thread, so a scrape never runs on a network thread.
+		Enabled by setting metrics_port (and optionally metrics_address) in the app's config section.
+	*/
+	class MetricsEndpoint {
+	public:
+		MetricsEndpoint(const char *address, uint16_t port);
+		~MetricsEndpoint();
+	private:
+		static void *ListenerThread(OS::CThread *thread);
+		void HandleClient(int sd);
+
+		int m_sd;
+		bool m_running;
+		OS::CThread *mp_thread;
+	};
+	extern MetricsEndpoint *g_metrics_endpoint;
+	void SetupMetricsEndpoint(const char *address, uint16_t port);
+	void ShutdownMetricsEndpoint();
+}
+#endif //_OS_METRICS_ENDPOINT_H
@@ -1,28 +1,17 @@
 #include <OS/OpenSpy.h>
 #include <OS/Auth.h>
-#include <curl/curl.h>
+#include <OS/HTTP.h>
 #include <jansson.h>
 #include <string>
-#include <OS/Cache/GameCache.h>
 
 namespace OS {
 	OS::TaskPool<AuthTask, AuthRequest> *m_auth_task_pool = NULL;
-	OS::GameCache *m_game_cache;
-	struct curl_data {
-	    std::string buffer;
-	};
-	/* callback for curl fetch */
-	size_t AuthTask::curl_callback (void *contents, size_t size, size_t nmemb, void *userp) {
-		if (!contents) {
-			return 0;
-		}
-		size_t realsize = size * nmemb;                             /* calculate buffer size */
-		curl_data *data = (curl_data *)userp;
-		data->buffer += (const char *)contents;
-		return realsize;
-	}
+	typedef struct {
+		AuthRequest request;
+		AuthData auth_data;
+		AuthTask::AuthResponseHandler handler;
+	} AuthHTTPContext;
 	void AuthTask::PerformAuth_Uniquenick_GPHash(AuthRequest request) {
-		curl_data recv_data;
 		//build json object
 		json_t *send_obj = json_object(), *user_obj = json_object(), *profile_obj = json_object();
 
@@ -47,58 +36,10 @@ namespace OS {
 
 		char *json_data_str = json_dumps(send_obj, 0);
 
-		CURL *curl = curl_easy_init();
-		CURLcode res;
-		Profile profile;
-		User user;
-		user.id = 0;
-		profile.id = 0;
-		bool success = false;
 		OS::AuthData auth_data;
 		auth_data.response_code = LOGIN_RESPONSE_SERVER_ERROR;
 
-		if (curl) {
-			AuthReq_InitCurl(curl, json_data_str, (void *)&recv_data);
-
-			res = curl_easy_perform(curl);
-
-			if (res == CURLE_OK) {
-
-				json_t *json_data = json_loads(recv_data.buffer.c_str(), 0, NULL);
-
-				if (json_data) {
-					json_t *error_obj = json_object_get(json_data, "error");
-					json_t *success_obj = json_object_get(json_data, "success");
-					if (error_obj) {
-						Handle_AuthWebError(auth_data, error_obj);
-					}
-					else if (success_obj == json_true()) {
-						json_t *profile_json = json_object_get(json_data, "profile");
-						if (profile_json) {
-							profile = LoadProfileFromJson(profile_json);
-							json_t *user_json = json_object_get(profile_json, "user");
-							if (user_json) {
-								user = LoadUserFromJson(user_json);
-								success = true;
-							}
-						}
-						json_t *server_response_json = json_object_get(json_data, "server_response");
-						if (server_response_json) {
-							auth_data.hash_proof = json_string_value(server_response_json);
-						}
-						server_response_json = json_object_get(json_data, "session_key");
-						if (server_response_json) {
-							auth_data.session_key = json_string_value(server_response_json);
-						}
-
-					}
-					json_decref(json_data);
-				}
-			}
-			curl_easy_cleanup(curl);
-		}
-
-		request.callback(success, user, profile, auth_data, request.extra, request.operation_id, request.peer);
+		AuthReq_Submit(request, auth_data, json_data_str, AuthResp_Uniquenick_GPHash);
 
 		if (json_data_str)
 			free((void *)json_data_str);
@@ -106,7 +47,6 @@ namespace OS {
 		json_decref(send_obj);
 	}
 	void AuthTask::PerformAuth_NickEMail_GPHash(AuthRequest request) {
-		curl_data recv_data;
 		//build json object
 		json_t *send_obj = json_object(), *user_obj = json_object(), *profile_obj = json_object();
 
@@ -139,68 +79,16 @@ namespace OS {
 
 		char *json_data_str = json_dumps(send_obj, 0);
 		
-		CURL *curl = curl_easy_init();
-		CURLcode res;
-		Profile profile;
-		User user;
-		user.id = 0;
-		profile.id = 0;
-		bool success = false;
 		OS::AuthData auth_data;
 		auth_data.response_code = LOGIN_RESPONSE_SERVER_ERROR;
 
-		if(curl) {
-			AuthReq_InitCurl(curl, json_data_str, (void *)&recv_data);
-
-			res = curl_easy_perform(curl);
-
-			if(res == CURLE_OK) {
-				json_t *json_data = json_loads(recv_data.buffer.c_str(), 0, NULL);
-
-				if(json_data) {
-					json_t *error_obj = json_object_get(json_data, "error");
-					json_t *success_obj = json_object_get(json_data, "success");
-					if (error_obj) {
-						Handle_AuthWebError(auth_data, error_obj);
-					}
-					else if(success_obj == json_true()) {
-						json_t *profile_json = json_object_get(json_data, "profile");
-						if(profile_json) {
-							profile = LoadProfileFromJson(profile_json);
-							json_t *user_json = json_object_get(profile_json, "user");
-							if(user_json) {
-								user = LoadUserFromJson(user_json);
-								success = true;
-							}
-						}
-						json_t *server_response_json = json_object_get(json_data, "server_response");
-						if(server_response_json) {
-							auth_data.hash_proof = json_string_value(server_response_json);
-						}
-						server_response_json = json_object_get(json_data, "session_key");
-						if(server_response_json) {
-							auth_data.session_key = json_string_value(server_response_json);
-						}
-
-					}
-					json_t *reason_json = json_object_get(json_data, "reason");
-					if(reason_json) {
-						auth_data.response_code = (AuthResponseCode)json_integer_value(reason_json);
-					}
-					json_decref(json_data);
-				}
-			}
-			curl_easy_cleanup(curl);
-		}
-
-		request.callback(success, user, profile, auth_data, request.extra, request.operation_id, request.peer);
+		AuthReq_Submit(request, auth_data, json_data_str, AuthResp_NickEMail_GPHash);
 		if(json_data_str)
 			free((void *)json_data_str);
 
 		json_decref(send_obj);
 	}
 	void AuthTask::PerformAuth_PreAuth_Token(AuthRequest request) {
-		curl_data recv_data;
 		//build json object
 		json_t *send_obj = json_object(), *user_obj = json_object(), *profile_obj = json_object();
 
@@ -228,61 +116,15 @@ namespace OS {
 
 		char *json_data = json_dumps(send_obj, 0);
 
-		CURL *curl = curl_easy_init();
-		CURLcode res;
-		Profile profile;
-		User user;
-		user.id = 0;
-		profile.id = 0;
 		OS::AuthData auth_data;
 		auth_data.response_code = LOGIN_RESPONSE_SERVER_ERROR;
-		bool success = false;
-
-		if (curl) {
-			AuthReq_InitCurl(curl, json_data, (void *)&recv_data);
-
-			res = curl_easy_perform(curl);
 
-			if (res == CURLE_OK) {
-
-				json_t *json_data = json_loads(recv_data.buffer.c_str(), 0, NULL);
-
-
-				if (json_data) {
-					json_t *error_obj = json_object_get(json_data, "error");
-					json_t *success_obj = json_object_get(json_data, "success");
-					if (error_obj) {
-						Handle_AuthWebError(auth_data, error_obj);
-					}
-					else if (success_obj == json_true()) {
-						json_t *profile_json = json_object_get(json_data, "profile");
-						if (profile_json) {
-							profile = LoadProfileFromJson(profile_json);
-							json_t *user_json = json_object_get(profile_json, "user");
-							if (user_json) {
-								user = LoadUserFromJson(user_json);
-								success = true;
-							}
-						}
-						json_t *server_response_json = json_object_get(json_data, "session_key");
-						if (server_response_json) {
-							auth_data.session_key = json_string_value(server_response_json);
-						}
-						server_response_json = json_object_get(json_data, "server_response");
-						if (server_response_json) {
-							auth_data.hash_proof = json_string_value(server_response_json);
-						}
-					}
-					json_decref(json_data);
-				}
-			}
-			curl_easy_cleanup(curl);
-		}
-		request.callback(success, user, profile, auth_data, request.extra, request.operation_id, request.peer);
+		AuthReq_Submit(request, auth_data, json_data, AuthResp_PreAuth_Token);
+		if (json_data)
+			free((void *)json_data);
 		json_decref(send_obj);
 	}
 	void AuthTask::PerformAuth_NickEMail(AuthRequest request) {
-		curl_data recv_data;
 		//build json object
 		json_t *send_obj = json_object(), *user_obj = json_object(), *profile_obj = json_object();
 
@@ -310,57 +152,15 @@ namespace OS {
 
 		char *json_data = json_dumps(send_obj, 0);
 
-		CURL *curl = curl_easy_init();
-		CURLcode res;
-		Profile profile;
-		User user;
-		user.id = 0;
-		profile.id = 0;
 		OS::AuthData auth_data;
 		auth_data.response_code = LOGIN_RESPONSE_SERVER_ERROR;
-		bool success = false;
-		if(curl) {
-
-			AuthReq_InitCurl(curl, json_data, (void *)&recv_data);
-
-			res = curl_easy_perform(curl);
-
-			if(res == CURLE_OK) {
 
-				json_t *json_data = json_loads(recv_data.buffer.c_str(), 0, NULL);
-
-
-				if(json_data) {
-					json_t *error_obj = json_object_get(json_data, "error");
-					json_t *success_obj = json_object_get(json_data, "success");
-					if (error_obj) {
-						Handle_AuthWebError(auth_data, error_obj);
-					}
-					else if(success_obj == json_true()) {
-						json_t *profile_json = json_object_get(json_data, "profile");
-						if(profile_json) {
-							profile = LoadProfileFromJson(profile_json);
-							json_t *user_json = json_object_get(profile_json, "user");
-							if(user_json) {
-								user = LoadUserFromJson(user_json);
-								success = true;
-							}
-						}
-						json_t *server_response_json = json_object_get(json_data, "session_key");
-						if(server_response_json) {
-							auth_data.session_key = json_string_value(server_response_json);
-						}
-					}
-					json_decref(json_data);
-				}
-			}
-			curl_easy_cleanup(curl);
-		}
-		request.callback(success, user, profile, auth_data, request.extra, request.operation_id, request.peer);
+		AuthReq_Submit(request, auth_data, json_data, AuthResp_NickEMail);
+		if (json_data)
+			free((void *)json_data);
 		json_decref(send_obj);
 	}
 	void AuthTask::PerformAuth_CreateUser_OrProfile(AuthRequest request) {
-		curl_data recv_data;
 		//build json object
 		json_t *send_obj = json_object(), *user_obj = json_object(), *profile_obj = json_object();
 
@@ -394,60 +194,19 @@ namespace OS {
 
 		char *json_data = json_dumps(send_obj, 0);
 
-		CURL *curl = curl_easy_init();
-		CURLcode res;
-		Profile profile;
-		User user;
-		user.id = 0;
-		profile.id = 0;
 		OS::AuthData auth_data;
 		auth_data.response_code = LOGIN_RESPONSE_SERVER_ERROR;
-		bool success = false;
 
 		if (request.gamename.length() > 0) {
 			auth_data.gamedata = OS::GetGameByName(request.gamename.c_str());
 		}
 
-		if(curl) {
-			AuthReq_InitCurl(curl, json_data, (void *)&recv_data);
-
-			res = curl_easy_perform(curl);
-
-			if (request.gamename.length() > 0) {
-				auth_data.gamedata = OS::GetGameByName(request.gamename.c_str());
-			}
-
-			if(res == CURLE_OK) {
-				json_t *json_data = json_loads(recv_data.buffer.c_str(), 0, NULL);
-				if(json_data) {
-					json_t *error_obj = json_object_get(json_data, "error");
-					json_t *success_obj = json_object_get(json_data, "success");
-					if (error_obj) {
-						Handle_AuthWebError(auth_data, error_obj);
-					}
-					else if (success_obj == json_true()) {
-						json_t *profile_json = json_object_get(json_data, "profile");
-						json_t *user_json = json_object_get(profile_json, "user");
-						user = LoadUserFromJson(user_json);
-						profile = LoadProfileFromJson(profile_json);
-						
-						user_json = json_object_get(json_data, "new_profile"); //new account created or not
-						success = json_boolean_value(success_obj);
-						auth_data.response_code = LOGIN_RESPONSE_SUCCESS;
-					}
-					json_decref(json_data);
-				}
-			}
-			curl_easy_cleanup(curl);
-		}
-		
-		request.callback(success, user, profile, auth_data, request.extra, request.operation_id, request.peer);
+		AuthReq_Submit(request, auth_data, json_data, AuthResp_CreateUser_OrProfile);
 		if(json_data)
 			free(json_data);
 		json_decref(send_obj);
 	}
 	void AuthTask::PerformAuth_MakeAuthTicket(AuthRequest request) {
-		curl_data recv_data;
 		//build json object
 		json_t *send_obj = json_object();
 
@@ -464,56 +223,16 @@ namespace OS {
 
 		char *json_dump = json_dumps(send_obj, 0);
 
-		CURL *curl = curl_easy_init();
-		CURLcode res;
-		Profile profile;
-		User user;
-		user.id = 0;
-		profile.id = 0;
 		OS::AuthData auth_data;
-
 		auth_data.response_code = LOGIN_RESPONSE_SERVER_ERROR;
-		bool success = false;
-
-		if (curl) {
-
-			AuthReq_InitCurl(curl, json_dump, (void *)&recv_data);
-
-			res = curl_easy_perform(curl);
-
-			if (res == CURLE_OK) {
-				json_t *json_data = json_loads(recv_data.buffer.c_str(), 0, NULL);
-				if (json_data) {
-					json_t *error_obj = json_object_get(json_data, "error");
-					json_t *success_obj = json_object_get(json_data, "success");
-					if (error_obj) {
-						Handle_AuthWebError(auth_data, error_obj);
-					}
-					else if (success_obj == json_true()) {
-						success = true;
-						json_t *session_key_json = json_object_get(json_data, "ticket");
-						if (session_key_json) {
-							auth_data.session_key = json_string_value(session_key_json);
-						}
 
-						session_key_json = json_object_get(json_data, "challenge");
-						if (session_key_json) {
-							auth_data.hash_proof = json_string_value(session_key_json);
-						}
-					}
-					json_decref(json_data);
-				}
-			}
-			curl_easy_cleanup(curl);
-		}
-		request.callback(success, OS::User(), OS::Profile(), auth_data, request.extra, request.operation_id, request.peer);
+		AuthReq_Submit(request, auth_data, json_dump, AuthResp_MakeAuthTicket);
 		if (json_dump) {
 			free((void *)json_dump);
 		}
 		json_decref(send_obj);
 	}
 	void AuthTask::PerformAuth_PID_GSStats_SessKey(AuthRequest request) {
-		curl_data recv_data;
 		//build json object
 		json_t *send_obj = json_object();
 
@@ -530,65 +249,16 @@ namespace OS {
 
 		char *json_dump = json_dumps(send_obj, 0);
 
-		CURL *curl = curl_easy_init();
-		CURLcode res;
-		Profile profile;
-		User user;
-		user.id = 0;
-		profile.id = 0;
 		OS::AuthData auth_data;
-		bool success = false;
-
 		auth_data.response_code = LOGIN_RESPONSE_SERVER_ERROR;
 
-
-		if(curl) {
-			AuthReq_InitCurl(curl, json_dump, (void *)&recv_data);
-
-			res = curl_easy_perform(curl);
-
-			if(res == CURLE_OK) {
-				json_t *json_data = json_loads(recv_data.buffer.c_str(), 0, NULL);
-				if(json_data) {
-					json_t *error_obj = json_object_get(json_data, "error");
-					json_t *success_obj = json_object_get(json_data, "success");
-					if (error_obj) {
-						Handle_AuthWebError(auth_data, error_obj);
-					}
-					else if (success_obj == json_true()) {
-						json_t *profile_json = json_object_get(json_data, "profile");
-						if(profile_json) {
-							profile = LoadProfileFromJson(profile_json);
-							json_t *user_json = json_object_get(profile_json, "user");
-							if(user_json) {
-								user = LoadUserFromJson(user_json);
-								success = true;
-							}
-						}
-						json_t *session_key_json = json_object_get(json_data, "session_key");
-						if(session_key_json) {
-							auth_data.session_key = json_string_value(session_key_json);
-						}
-
-					} else {
-					}
-					json_t *reason_json = json_object_get(json_data, "reason");
-					if(reason_json) {
-						auth_data.response_code = (AuthResponseCode)json_integer_value(reason_json);
-					}
-					json_decref(json_data);
-				}
-			}
-			curl_easy_cleanup(curl);
-		}
-		request.callback(success, user, profile, auth_data, request.extra, request.operation_id, request.peer);
+		AuthReq_Submit(request, auth_data, json_dump, AuthResp_PID_GSStats_SessKey);
 		if (json_dump) {
 			free((void *)json_dump);
 		}
 		json_decref(send_obj);
 	}
 	void AuthTask::PerformAuth_EmailPass(AuthRequest request) {
-		curl_data recv_data;
 		//build json object
 		json_t *send_obj = json_object(), *user_obj = json_object();
 
@@ -608,56 +278,16 @@ namespace OS {
 
 		char *json_dump = json_dumps(send_obj, 0);
 
-		CURL *curl = curl_easy_init();
-		CURLcode res;
-		Profile profile;
-		User user;
-		user.id = 0;
-		profile.id = 0;
 		OS::AuthData auth_data;
-
-		bool success = false;
 		auth_data.response_code = LOGIN_RESPONSE_SERVER_ERROR;
 
-
-		if (curl) {
-
-			AuthReq_InitCurl(curl, json_dump, (void *)&recv_data);
-
-			res = curl_easy_perform(curl);
-
-			if (res == CURLE_OK) {
-				json_t *json_data = json_loads(recv_data.buffer.c_str(), 0, NULL);
-				if (json_data) {
-					json_t *error_obj = json_object_get(json_data, "error");
-					json_t *success_obj = json_object_get(json_data, "success");
-					if (error_obj) {
-						Handle_AuthWebError(auth_data, error_obj);
-					}
-					else if (success_obj == json_true()) {
-						json_t *user_json = json_object_get(json_data, "user");
-						if (user_json) {
-							user = LoadUserFromJson(user_json);
-							success = true;
-						}
-						json_t *session_key_json = json_object_get(json_data, "session_key");
-						if (session_key_json) {
-							auth_data.session_key = json_string_value(session_key_json);
-						}
-					}
-					json_decref(json_data);
-				}
-			}
-			curl_easy_cleanup(curl);
-		}
-		request.callback(success, user, OS::Profile(), auth_data, request.extra, request.operation_id, request.peer);
+		AuthReq_Submit(request, auth_data, json_dump, AuthResp_EmailPass);
 		if (json_dump) {
 			free((void *)json_dump);
 		}
 		json_decref(send_obj);
 	}
 	void AuthTask::PerformAuth_Uniquenick_Password(AuthRequest request) {
-		curl_data recv_data;
 		//build json object
 		json_t *send_obj = json_object(), *user_obj = json_object(), *profile_obj = json_object();
 
@@ -684,86 +314,364 @@ namespace OS {
 
 		char *json_dump = json_dumps(send_obj, 0);
 
-		CURL *curl = curl_easy_init();
-		CURLcode res;
+		OS::AuthData auth_data;
+		auth_data.response_code = LOGIN_RESPONSE_SERVER_ERROR;
+
+		AuthReq_Submit(request, auth_data, json_dump, AuthResp_Uniquenick_Password);
+		if (json_dump) {
+			free((void *)json_dump);
+		}
+		json_decref(send_obj);
+	}
+	void AuthTask::AuthResp_Uniquenick_GPHash(AuthRequest &request, AuthData &auth_data, HTTPResponse &response) {
 		Profile profile;
 		User user;
 		user.id = 0;
 		profile.id = 0;
-		OS::AuthData auth_data;
 		bool success = false;
 
-		auth_data.response_code = LOGIN_RESPONSE_SERVER_ERROR;
+		if (response.status_code != 0) {
+			json_t *json_data = json_loads(response.buffer.c_str(), 0, NULL);
 
+			if (json_data) {
+				json_t *error_obj = json_object_get(json_data, "error");
+				json_t *success_obj = json_object_get(json_data, "success");
+				if (error_obj) {
+					Handle_AuthWebError(auth_data, error_obj);
+				}
+				else if (success_obj == json_true()) {
+					json_t *profile_json = json_object_get(json_data, "profile");
+					if (profile_json) {
+						profile = LoadProfileFromJson(profile_json);
+						json_t *user_json = json_object_get(profile_json, "user");
+						if (user_json) {
+							user = LoadUserFromJson(user_json);
+							success = true;
+						}
+					}
+					json_t *server_response_json = json_object_get(json_data, "server_response");
+					if (server_response_json) {
+						auth_data.hash_proof = json_string_value(server_response_json);
+					}
+					server_response_json = json_object_get(json_data, "session_key");
+					if (server_response_json) {
+						auth_data.session_key = json_string_value(server_response_json);
+					}
 
-		if (curl) {
-			AuthReq_InitCurl(curl, json_dump, (void *)&recv_data);
+				}
+				json_decref(json_data);
+			}
+		}
+		request.callback(success, user, profile, auth_data, request.extra, request.operation_id, request.peer);
+	}
+	void AuthTask::AuthResp_NickEMail_GPHash(AuthRequest &request, AuthData &auth_data, HTTPResponse &response) {
+		Profile profile;
+		User user;
+		user.id = 0;
+		profile.id = 0;
+		bool success = false;
 
-			res = curl_easy_perform(curl);
+		if (response.status_code != 0) {
+			json_t *json_data = json_loads(response.buffer.c_str(), 0, NULL);
 
-			if (res == CURLE_OK) {
-				json_t *json_data = json_loads(recv_data.buffer.c_str(), 0, NULL);
-				if (json_data) {
-					json_t *error_obj = json_object_get(json_data, "error");
-					json_t *success_obj = json_object_get(json_data, "success");
-					if (error_obj) {
-						Handle_AuthWebError(auth_data, error_obj);
-					}
-					else if (success_obj == json_true()) {
-						json_t *profile_json = json_object_get(json_data, "profile");
-						if (profile_json) {
-							profile = LoadProfileFromJson(profile_json);
-							json_t *user_json = json_object_get(profile_json, "user");
-							if (user_json) {
-								user = LoadUserFromJson(user_json);
-								success = true;
-							}
+			if(json_data) {
+				json_t *error_obj = json_object_get(json_data, "error");
+				json_t *success_obj = json_object_get(json_data, "success");
+				if (error_obj) {
+					Handle_AuthWebError(auth_data, error_obj);
+				}
+				else if(success_obj == json_true()) {
+					json_t *profile_json = json_object_get(json_data, "profile");
+					if(profile_json) {
+						profile = LoadProfileFromJson(profile_json);
+						json_t *user_json = json_object_get(profile_json, "user");
+						if(user_json) {
+							user = LoadUserFromJson(user_json);
+							success = true;
 						}
-						json_t *session_key_json = json_object_get(json_data, "session_key");
-						if (session_key_json) {
-							auth_data.session_key = json_string_value(session_key_json);
+					}
+					json_t *server_response_json = json_object_get(json_data, "server_response");
+					if(server_response_json) {
+						auth_data.hash_proof = json_string_value(server_response_json);
+					}
+					server_response_json = json_object_get(json_data, "session_key");
+					if(server_response_json) {
+						auth_data.session_key = json_string_value(server_response_json);
+					}
+
+				}
+				json_t *reason_json = json_object_get(json_data, "reason");
+				if(reason_json) {
+					auth_data.response_code = (AuthResponseCode)json_integer_value(reason_json);
+				}
+				json_decref(json_data);
+			}
+		}
+		request.callback(success, user, profile, auth_data, request.extra, request.operation_id, request.peer);
+	}
+	void AuthTask::AuthResp_PreAuth_Token(AuthRequest &request, AuthData &auth_data, HTTPResponse &response) {
+		Profile profile;
+		User user;
+		user.id = 0;
+		profile.id = 0;
+		bool success = false;
+
+		if (response.status_code != 0) {
+			json_t *json_data = json_loads(response.buffer.c_str(), 0, NULL);
+
+
+			if (json_data) {
+				json_t *error_obj = json_object_get(json_data, "error");
+				json_t *success_obj = json_object_get(json_data, "success");
+				if (error_obj) {
+					Handle_AuthWebError(auth_data, error_obj);
+				}
+				else if (success_obj == json_true()) {
+					json_t *profile_json = json_object_get(json_data, "profile");
+					if (profile_json) {
+						profile = LoadProfileFromJson(profile_json);
+						json_t *user_json = json_object_get(profile_json, "user");
+						if (user_json) {
+							user = LoadUserFromJson(user_json);
+							success = true;
 						}
+					}
+					json_t *server_response_json = json_object_get(json_data, "session_key");
+					if (server_response_json) {
+						auth_data.session_key = json_string_value(server_response_json);
+					}
+					server_response_json = json_object_get(json_data, "server_response");
+					if (server_response_json) {
+						auth_data.hash_proof = json_string_value(server_response_json);
+					}
+				}
+				json_decref(json_data);
+			}
+		}
+		request.callback(success, user, profile, auth_data, request.extra, request.operation_id, request.peer);
+	}
+	void AuthTask::AuthResp_NickEMail(AuthRequest &request, AuthData &auth_data, HTTPResponse &response) {
+		Profile profile;
+		User user;
+		user.id = 0;
+		profile.id = 0;
+		bool success = false;
+
+		if (response.status_code != 0) {
+			json_t *json_data = json_loads(response.buffer.c_str(), 0, NULL);
+
 
+			if(json_data) {
+				json_t *error_obj = json_object_get(json_data, "error");
+				json_t *success_obj = json_object_get(json_data, "success");
+				if (error_obj) {
+					Handle_AuthWebError(auth_data, error_obj);
+				}
+				else if(success_obj == json_true()) {
+					json_t *profile_json = json_object_get(json_data, "profile");
+					if(profile_json) {
+						profile = LoadProfileFromJson(profile_json);
+						json_t *user_json = json_object_get(profile_json, "user");
+						if(user_json) {
+							user = LoadUserFromJson(user_json);
+							success = true;
+						}
+					}
+					json_t *server_response_json = json_object_get(json_data, "session_key");
+					if(server_response_json) {
+						auth_data.session_key = json_string_value(server_response_json);
 					}
-					json_decref(json_data);
 				}
+				json_decref(json_data);
 			}
-			curl_easy_cleanup(curl);
 		}
 		request.callback(success, user, profile, auth_data, request.extra, request.operation_id, request.peer);
-		if (json_dump) {
-			free((void *)json_dump);
+	}
+	void AuthTask::AuthResp_CreateUser_OrProfile(AuthRequest &request, AuthData &auth_data, HTTPResponse &response) {
+		Profile profile;
+		User user;
+		user.id = 0;
+		profile.id = 0;
+		bool success = false;
+
+		if (response.status_code != 0) {
+			json_t *json_data = json_loads(response.buffer.c_str(), 0, NULL);
+			if(json_data) {
+				json_t *error_obj = json_object_get(json_data, "error");
+				json_t *success_obj = json_object_get(json_data, "success");
+				if (error_obj) {
+					Handle_AuthWebError(auth_data, error_obj);
+				}
+				else if (success_obj == json_true()) {
+					json_t *profile_json = json_object_get(json_data, "profile");
+					json_t *user_json = json_object_get(profile_json, "user");
+					user = LoadUserFromJson(user_json);
+					profile = LoadProfileFromJson(profile_json);
+					
+					user_json = json_object_get(json_data, "new_profile"); //new account created or not
+					success = json_boolean_value(success_obj);
+					auth_data.response_code = LOGIN_RESPONSE_SUCCESS;
+				}
+				json_decref(json_data);
+			}
 		}
-		json_decref(send_obj);
+		request.callback(success, user, profile, auth_data, request.extra, request.operation_id, request.peer);
 	}
-	void AuthTask::AuthReq_InitCurl(void *curl, char *post_data, void *write_data) {
-		struct curl_slist *chunk = NULL;
-		std::string apiKey = "APIKey: " + std::string(g_webServicesAPIKey);
-		chunk = curl_slist_append(chunk, apiKey.c_str());
-		chunk = curl_slist_append(chunk, "Content-Type: application/json");
-		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, chunk);
+	void AuthTask::AuthResp_MakeAuthTicket(AuthRequest &request, AuthData &auth_data, HTTPResponse &response) {
+		bool success = false;
 
-		curl_easy_setopt(curl, CURLOPT_URL, OPENSPY_AUTH_URL);
-		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, post_data);
+		if (response.status_code != 0) {
+			json_t *json_data = json_loads(response.buffer.c_str(), 0, NULL);
+			if (json_data) {
+				json_t *error_obj = json_object_get(json_data, "error");
+				json_t *success_obj = json_object_get(json_data, "success");
+				if (error_obj) {
+					Handle_AuthWebError(auth_data, error_obj);
+				}
+				else if (success_obj == json_true()) {
+					success = true;
+					json_t *session_key_json = json_object_get(json_data, "ticket");
+					if (session_key_json) {
+						auth_data.session_key = json_string_value(session_key_json);
+					}
 
-		/* set default user agent */
-		curl_easy_setopt(curl, CURLOPT_USERAGENT, "OSCoreAuth");
+					session_key_json = json_object_get(json_data, "challenge");
+					if (session_key_json) {
+						auth_data.hash_proof = json_string_value(session_key_json);
+					}
+				}
+				json_decref(json_data);
+			}
+		}
+		request.callback(success, OS::User(), OS::Profile(), auth_data, request.extra, request.operation_id, request.peer);
+	}
+	void AuthTask::AuthResp_PID_GSStats_SessKey(AuthRequest &request, AuthData &auth_data, HTTPResponse &response) {
+		Profile profile;
+		User user;
+		user.id = 0;
+		profile.id = 0;
+		bool success = false;
 
-		/* set timeout */
-		curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5);
+		if (response.status_code != 0) {
+			json_t *json_data = json_loads(response.buffer.c_str(), 0, NULL);
+			if(json_data) {
+				json_t *error_obj = json_object_get(json_data, "error");
+				json_t *success_obj = json_object_get(json_data, "success");
+				if (error_obj) {
+					Handle_AuthWebError(auth_data, error_obj);
+				}
+				else if (success_obj == json_true()) {
+					json_t *profile_json = json_object_get(json_data, "profile");
+					if(profile_json) {
+						profile = LoadProfileFromJson(profile_json);
+						json_t *user_json = json_object_get(profile_json, "user");
+						if(user_json) {
+							user = LoadUserFromJson(user_json);
+							success = true;
+						}
+					}
+					json_t *session_key_json = json_object_get(json_data, "session_key");
+					if(session_key_json) {
+						auth_data.session_key = json_string_value(session_key_json);
+					}
 
-		/* enable location redirects */
-		curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
+				} else {
+				}
+				json_t *reason_json = json_object_get(json_data, "reason");
+				if(reason_json) {
+					auth_data.response_code = (AuthResponseCode)json_integer_value(reason_json);
+				}
+				json_decref(json_data);
+			}
+		}
+		request.callback(success, user, profile, auth_data, request.extra, request.operation_id, request.peer);
+	}
+	void AuthTask::AuthResp_EmailPass(AuthRequest &request, AuthData &auth_data, HTTPResponse &response) {
+		User user;
+		user.id = 0;
+		bool success = false;
 
-		/* set maximum allowed redirects */
-		curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 1);
+		if (response.status_code != 0) {
+			json_t *json_data = json_loads(response.buffer.c_str(), 0, NULL);
+			if (json_data) {
+				json_t *error_obj = json_object_get(json_data, "error");
+				json_t *success_obj = json_object_get(json_data, "success");
+				if (error_obj) {
+					Handle_AuthWebError(auth_data, error_obj);
+				}
+				else if (success_obj == json_true()) {
+					json_t *user_json = json_object_get(json_data, "user");
+					if (user_json) {
+						user = LoadUserFromJson(user_json);
+						success = true;
+					}
+					json_t *session_key_json = json_object_get(json_data, "session_key");
+					if (session_key_json) {
+						auth_data.session_key = json_string_value(session_key_json);
+					}
+				}
+				json_decref(json_data);
+			}
+		}
+		request.callback(success, user, OS::Profile(), auth_data, request.extra, request.operation_id, request.peer);
+	}
+	void AuthTask::AuthResp_Uniquenick_Password(AuthRequest &request, AuthData &auth_data, HTTPResponse &response) {
+		Profile profile;
+		User user;
+		user.id = 0;
+		profile.id = 0;
+		bool success = false;
 
-		/* Close socket after one use */
-		curl_easy_setopt(curl, CURLOPT_FORBID_REUSE, 1);
+		if (response.status_code != 0) {
+			json_t *json_data = json_loads(response.buffer.c_str(), 0, NULL);
+			if (json_data) {
+				json_t *error_obj = json_object_get(json_data, "error");
+				json_t *success_obj = json_object_get(json_data, "success");
+				if (error_obj) {
+					Handle_AuthWebError(auth_data, error_obj);
+				}
+				else if (success_obj == json_true()) {
+					json_t *profile_json = json_object_get(json_data, "profile");
+					if (profile_json) {
+						profile = LoadProfileFromJson(profile_json);
+						json_t *user_json = json_object_get(profile_json, "user");
+						if (user_json) {
+							user = LoadUserFromJson(user_json);
+							success = true;
+						}
+					}
+					json_t *session_key_json = json_object_get(json_data, "session_key");
+					if (session_key_json) {
+						auth_data.session_key = json_string_value(session_key_json);
+					}
 
-		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_callback);
-		curl_easy_setopt(curl, CURLOPT_WRITEDATA, write_data);
+				}
+				json_decref(json_data);
+			}
+		}
+		request.callback(success, user, profile, auth_data, request.extra, request.operation_id, request.peer);
+	}
+	void AuthTask::AuthReq_Submit(AuthRequest request, AuthData auth_data, const char *post_data, AuthResponseHandler handler) {
+		AuthHTTPContext *context = new AuthHTTPContext;
+		context->request = request;
+		context->auth_data = auth_data;
+		context->handler = handler;
+
+		//the task thread drops its reference as soon as this returns
+		if (request.peer) {
+			request.peer->IncRef();
+		}
 
+		OS::HTTPClient client(OPENSPY_AUTH_URL, "OSCoreAuth");
+		client.PostAsync(post_data ? post_data : "", OnAuthHTTPResponse, context, request.peer);
+	}
+	void AuthTask::OnAuthHTTPResponse(HTTPResponse response, void *extra) {
+		AuthHTTPContext *context = (AuthHTTPContext *)extra;
+		context->handler(context->request, context->auth_data, response);
+		if (context->request.peer) {
+			context->request.peer->DecRef();
+		}
+		delete context;
 	}
 	void AuthTask::Handle_AuthWebError(AuthData &data, json_t *error_obj) {
 		std::string error_class, error_name, param_name;
@@ -1001,11 +909,9 @@ namespace OS {
 	}
 	void *AuthTask::TaskThread(CThread *thread) {
 		AuthTask *task = (AuthTask *)thread->getParams();
-		while (!task->m_request_list.empty() || task->mp_thread_poller->wait()) {
-			task->mp_mutex->lock();
-			while (!task->m_request_list.empty()) {
-				AuthRequest task_params = task->m_request_list.front();
-				task->mp_mutex->unlock();
+		while (task->HasRequests() || task->mp_thread_poller->wait()) {
+			AuthRequest task_params;
+			while (task->PopRequest(task_params)) {
 				switch (task_params.type) {
 				case EAuthType_NickEmail_GPHash:
 					task->PerformAuth_NickEMail_GPHash(task_params);
@@ -1034,27 +940,16 @@ namespace OS {
 					task->PerformAuth_MakeAuthTicket(task_params);
 					break;
 				}
-
-				task->mp_mutex->lock();
 				if(task_params.peer)
 					task_params.peer->DecRef();
-				task->m_request_list.pop();
 			}
-
-			task->mp_mutex->unlock();
 		}
 		return NULL;
 	}
 	void SetupAuthTaskPool(int num_tasks) {
-		OS::DataCacheTimeout gameCacheTimeout;
-		gameCacheTimeout.max_keys = 50;
-		gameCacheTimeout.timeout_time_secs = 7200;
-		m_game_cache = new OS::GameCache(num_tasks + 1, gameCacheTimeout);
-
 		m_auth_task_pool = new OS::TaskPool<AuthTask, AuthRequest>(num_tasks);
 	}
 	void ShutdownAuthTaskPool() {
 		delete m_auth_task_pool;
-		delete m_game_cache;
 	}
 }
\ No newline at end of file
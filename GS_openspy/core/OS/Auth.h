@@ -7,11 +7,12 @@
 #include <OS/User.h>
 #include <OS/Profile.h>
 #include <OS/TaskPool.h>
+#include <OS/HTTP.h>
 
 #include <OS/Net/NetPeer.h>
 
 //#define OPENSPY_WEBSERVICES_URL "http://10.10.10.10"
-#define OPENSPY_AUTH_URL OPENSPY_WEBSERVICES_URL "/backend/auth"
+#define OPENSPY_AUTH_URL OS::GetWebServicesURL("/backend/auth")
 #define OPENSPY_AUTH_KEY "dGhpc2lzdGhla2V5dGhpc2lzdGhla2V5dGhpc2lzdGhla2V5"
 namespace OS {
 	enum AuthResponseCode {
@@ -88,6 +89,8 @@ namespace OS {
 			static void TryAuthEmailPassword(std::string email, int partnercode, std::string password, AuthCallback cb, void *extra, int operation_id, INetPeer *peer = NULL);
 			static void TryMakeAuthTicket(int profileid, AuthCallback cb, void *extra, int operation_id, INetPeer *peer = NULL);
 			static void TryAuthTicket(const char *auth_token, const char *server_challenge, const char *client_challenge, const char *response, AuthCallback cb, int operation_id, INetPeer *peer = NULL);
+
+			typedef void (*AuthResponseHandler)(AuthRequest &request, AuthData &auth_data, HTTPResponse &response);
 		private:
 			static AuthTask *m_task_singleton;
 			static void *TaskThread(CThread *thread);
@@ -101,9 +104,20 @@ namespace OS {
 			void PerformAuth_MakeAuthTicket(AuthRequest request);
 			void PerformAuth_PreAuth_Token(AuthRequest request);
 
-			void Handle_AuthWebError(AuthData &data, json_t *error_obj);
-			void AuthReq_InitCurl(void *curl, char *post_data, void *write_data);
-			static size_t curl_callback (void *contents, size_t size, size_t nmemb, void *userp);
+			//called on the HTTP engine thread once the auth service responds
+			static void AuthResp_NickEMail_GPHash(AuthRequest &request, AuthData &auth_data, HTTPResponse &response);
+			static void AuthResp_NickEMail(AuthRequest &request, AuthData &auth_data, HTTPResponse &response);
+			static void AuthResp_CreateUser_OrProfile(AuthRequest &request, AuthData &auth_data, HTTPResponse &response);
+			static void AuthResp_PID_GSStats_SessKey(AuthRequest &request, AuthData &auth_data, HTTPResponse &response);
+			static void AuthResp_EmailPass(AuthRequest &request, AuthData &auth_data, HTTPResponse &response);
+			static void AuthResp_Uniquenick_GPHash(AuthRequest &request, AuthData &auth_data, HTTPResponse &response);
+			static void AuthResp_Uniquenick_Password(AuthRequest &request, AuthData &auth_data, HTTPResponse &response);
+			static void AuthResp_MakeAuthTicket(AuthRequest &request, AuthData &auth_data, HTTPResponse &response);
+			static void AuthResp_PreAuth_Token(AuthRequest &request, AuthData &auth_data, HTTPResponse &response);
+
+			static void Handle_AuthWebError(AuthData &data, json_t *error_obj);
+			static void AuthReq_Submit(AuthRequest request, AuthData auth_data, const char *post_data, AuthResponseHandler handler);
+			static void OnAuthHTTPResponse(HTTPResponse response, void *extra);
 	};
 	extern OS::TaskPool<AuthTask, AuthRequest> *m_auth_task_pool;
 	void SetupAuthTaskPool(int num_tasks);
@@ -2,14 +2,15 @@
 	This buffer class manages itself to prevent memory leaks, and auto-reallocs when needed, but is not thread safe.
 */
 #include "Buffer.h"
+#include "BufferPool.h"
 #define REALLOC_ADD_SIZE 512
 #define BUFFER_SAFE_SIZE 128 //if this amount of bytes isn't available, realloc
+#define BUFFER_DEFAULT_SIZE 1024 //most packets fit, bigger ones grow by doubling
 namespace OS {
 		BufferCtx::BufferCtx(int alloc_size) : OS::Ref() {
-			_head = malloc(alloc_size);
+			_head = BufferPool::Alloc(alloc_size, this->alloc_size);
 			_cursor = _head;
 			pointer_owner = true;
-			this->alloc_size = alloc_size;
 		}
 		BufferCtx::BufferCtx(void *addr, int len) : OS::Ref() {
 			pointer_owner = false; 
@@ -19,9 +20,16 @@ namespace OS {
 		}
 		BufferCtx::~BufferCtx() {
 			if (pointer_owner) {
-				free((void *)_head);
+				BufferPool::Free(_head, alloc_size);
 			}
 		}
+		void *BufferCtx::operator new(size_t size) {
+			int alloc_size;
+			return BufferPool::Alloc(size, alloc_size);
+		}
+		void BufferCtx::operator delete(void *p, size_t size) {
+			BufferPool::Free(p, BufferPool::GetAllocSize(size));
+		}
 		Buffer::Buffer(void *addr, int len) {
 			mp_ctx = new BufferCtx(addr, len);
 		}
@@ -33,7 +41,7 @@ namespace OS {
 			mp_ctx = cpy.mp_ctx;
 		}
 		Buffer::Buffer() {
-			mp_ctx = new BufferCtx(1024 * 1024);
+			mp_ctx = new BufferCtx(BUFFER_DEFAULT_SIZE);
 		}
 		Buffer::~Buffer() {
 			mp_ctx->DecRef();
@@ -154,11 +162,20 @@ namespace OS {
 			size_t size = (size_t)mp_ctx->_cursor - (size_t)mp_ctx->_head;
 			return size;
 		}
-		void Buffer::realloc_buffer(int new_size) {
+		//grows the buffer so at least len bytes are free, to double its size or more, so filling it copies each byte about once
+		void Buffer::realloc_buffer(int len) {
 			if (!mp_ctx->pointer_owner) return;
-			int offset = remaining();
-			mp_ctx->_head = realloc(mp_ctx->_head, size() + new_size);
-			reset();
-			IncCursor(offset);
+			int used = size();
+			int new_size = mp_ctx->alloc_size * 2;
+			if (new_size < used + len) {
+				new_size = used + len;
+			}
+			int alloc_size;
+			void *head = BufferPool::Alloc(new_size, alloc_size);
+			memcpy(head, mp_ctx->_head, used);
+			BufferPool::Free(mp_ctx->_head, mp_ctx->alloc_size);
+			mp_ctx->_head = head;
+			mp_ctx->_cursor = (char *)head + used;
+			mp_ctx->alloc_size = alloc_size;
 		}
 }
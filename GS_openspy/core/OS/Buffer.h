@@ -10,6 +10,9 @@ namespace OS {
 		BufferCtx(int alloc_size);
 		BufferCtx(void *addr, int len);
 		~BufferCtx();
+		//from the buffer pool, like the data
+		static void *operator new(size_t size);
+		static void operator delete(void *p, size_t size);
 		void *_head;
 		void *_cursor;
 		int alloc_size;
@@ -44,7 +47,7 @@ namespace OS {
 			void reset();
 			int size();
 		private:
-			void realloc_buffer(int new_size);
+			void realloc_buffer(int len);
 			void IncCursor(int len, bool write_operation = false);
 			BufferCtx *mp_ctx;
 	};
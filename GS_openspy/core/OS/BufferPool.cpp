@@ -0,0 +1,123 @@
+#include "BufferPool.h"
+#include <OS/Analytics/Instrument.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+static OS::Counter g_buffer_pool_allocs("buffer_pool_allocs", "Buffer blocks handed out from a thread's cache, counted in batches per thread");
+static OS::Counter g_buffer_pool_system_allocs("buffer_pool_system_allocs", "Buffer blocks which had to come from the system allocator");
+static OS::Counter g_buffer_pool_system_frees("buffer_pool_system_frees", "Buffer blocks given back to the system allocator, as they were too big or their thread's cache was full");
+
+namespace OS {
+	typedef struct _BufferPoolBlock {
+		struct _BufferPoolBlock *next;
+	} BufferPoolBlock;
+
+	typedef struct {
+		BufferPoolBlock *free_blocks[BUFFER_POOL_CLASSES];
+		int num_free[BUFFER_POOL_CLASSES];
+		int num_allocs; //not yet added to g_buffer_pool_allocs
+	} BufferPoolCache;
+
+	static INSTRUMENT_THREAD_LOCAL BufferPoolCache *t_buffer_pool_cache = NULL;
+	static INSTRUMENT_THREAD_LOCAL bool t_buffer_pool_exited = false;
+
+	static int GetClass(int size) {
+		int buffer_class = 0;
+		while (buffer_class < BUFFER_POOL_CLASSES && size > (1 << (BUFFER_POOL_MIN_SHIFT + buffer_class * BUFFER_POOL_CLASS_SHIFT))) {
+			buffer_class++;
+		}
+		return buffer_class;
+	}
+	static int GetClassSize(int buffer_class) {
+		return 1 << (BUFFER_POOL_MIN_SHIFT + buffer_class * BUFFER_POOL_CLASS_SHIFT);
+	}
+	static int GetClassLimit(int buffer_class) {
+		int limit = BUFFER_POOL_CACHE_BYTES / GetClassSize(buffer_class);
+		return limit < BUFFER_POOL_CACHE_COUNT ? limit : BUFFER_POOL_CACHE_COUNT;
+	}
+
+	static void FreeCache(void *param) {
+		BufferPoolCache *cache = (BufferPoolCache *)param;
+		t_buffer_pool_exited = true;
+		t_buffer_pool_cache = NULL;
+		g_buffer_pool_allocs.Add(cache->num_allocs);
+		for (int i = 0; i < BUFFER_POOL_CLASSES; i++) {
+			while (cache->free_blocks[i]) {
+				BufferPoolBlock *block = cache->free_blocks[i];
+				cache->free_blocks[i] = block->next;
+				free(block);
+			}
+		}
+		free(cache);
+	}
+
+	#ifndef _WIN32
+		static pthread_key_t g_buffer_pool_key;
+		static pthread_once_t g_buffer_pool_key_once = PTHREAD_ONCE_INIT;
+		static void CreateCacheKey() {
+			pthread_key_create(&g_buffer_pool_key, FreeCache);
+		}
+	#endif
+
+	//NULL once the thread is exiting, its blocks then go straight back to the system
+	static BufferPoolCache *GetCache() {
+		if (t_buffer_pool_cache || t_buffer_pool_exited) {
+			return t_buffer_pool_cache;
+		}
+		BufferPoolCache *cache = (BufferPoolCache *)calloc(1, sizeof(BufferPoolCache));
+		#ifndef _WIN32
+			//so the cache is freed with the thread, win32 threads leak theirs, which is bounded by the cache limits
+			pthread_once(&g_buffer_pool_key_once, CreateCacheKey);
+			pthread_setspecific(g_buffer_pool_key, cache);
+		#endif
+		t_buffer_pool_cache = cache;
+		return cache;
+	}
+
+	void *BufferPool::Alloc(int size, int &alloc_size) {
+		int buffer_class = GetClass(size);
+		if (buffer_class >= BUFFER_POOL_CLASSES) {
+			g_buffer_pool_system_allocs.Add();
+			alloc_size = size;
+			return malloc(size);
+		}
+
+		alloc_size = GetClassSize(buffer_class);
+		BufferPoolCache *cache = GetCache();
+		if (cache && cache->free_blocks[buffer_class]) {
+			BufferPoolBlock *block = cache->free_blocks[buffer_class];
+			cache->free_blocks[buffer_class] = block->next;
+			cache->num_free[buffer_class]--;
+			//batched, an atomic add per packet costs as much as the free list
+			if (++cache->num_allocs == BUFFER_POOL_COUNT_BATCH) {
+				g_buffer_pool_allocs.Add(cache->num_allocs);
+				cache->num_allocs = 0;
+			}
+			return block;
+		}
+		g_buffer_pool_system_allocs.Add();
+		return malloc(alloc_size);
+	}
+	void BufferPool::Free(void *block, int alloc_size) {
+		if (!block) {
+			return;
+		}
+		int buffer_class = GetClass(alloc_size);
+		BufferPoolCache *cache = buffer_class < BUFFER_POOL_CLASSES ? GetCache() : NULL;
+		if (!cache || cache->num_free[buffer_class] >= GetClassLimit(buffer_class)) {
+			g_buffer_pool_system_frees.Add();
+			free(block);
+			return;
+		}
+		BufferPoolBlock *free_block = (BufferPoolBlock *)block;
+		free_block->next = cache->free_blocks[buffer_class];
+		cache->free_blocks[buffer_class] = free_block;
+		cache->num_free[buffer_class]++;
+	}
+	int BufferPool::GetAllocSize(int size) {
+		int buffer_class = GetClass(size);
+		return buffer_class < BUFFER_POOL_CLASSES ? GetClassSize(buffer_class) : size;
+	}
+}
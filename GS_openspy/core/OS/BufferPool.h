@@ -0,0 +1,27 @@
+#ifndef _OS_BUFFERPOOL_H
+#define _OS_BUFFERPOOL_H
+#include <stdint.h>
+
+#define BUFFER_POOL_MIN_SHIFT 6 //64 bytes, the smallest class, which a BufferCtx fits in
+#define BUFFER_POOL_CLASS_SHIFT 2 //each class is 4x the size of the last
+#define BUFFER_POOL_CLASSES 8 //64 bytes to 1MB, anything larger bypasses the pool
+#define BUFFER_POOL_CACHE_BYTES (4 * 1024 * 1024) //most a thread keeps cached of each class
+#define BUFFER_POOL_CACHE_COUNT 256 //most blocks a thread keeps cached of each class
+#define BUFFER_POOL_COUNT_BATCH 64 //cache hits a thread counts before adding them to the metric
+namespace OS {
+	/*
+		Size classed blocks for OS::Buffer, freed blocks are kept on a free list of the freeing thread,
+		so a thread sending packets in a loop reuses the same few blocks without going to malloc or taking a lock.
+		A block can be freed by any thread, it joins that thread's list. A thread's lists are freed when it exits.
+	*/
+	class BufferPool {
+	public:
+		//size is rounded up to its class, alloc_size is set to the usable size of the returned block
+		static void *Alloc(int size, int &alloc_size);
+		//alloc_size has to be what Alloc set
+		static void Free(void *block, int alloc_size);
+		//what Alloc would round size up to
+		static int GetAllocSize(int size);
+	};
+}
+#endif //_OS_BUFFERPOOL_H
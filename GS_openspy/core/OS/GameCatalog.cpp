@@ -0,0 +1,290 @@
+#include <OS/OpenSpy.h>
+#include <OS/GameCatalog.h>
+#include <OS/Analytics/Instrument.h>
+#include <OS/Thread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+static OS::Counter g_game_catalog_hits("game_catalog_hits", "Game lookups answered from the catalog");
+static OS::Counter g_game_catalog_misses("game_catalog_misses", "Game lookups for a gameid or gamename the catalog doesn't have");
+static OS::Counter g_game_catalog_loads("game_catalog_loads", "Full loads of the game catalog from redis");
+static OS::Counter g_game_catalog_updates("game_catalog_updates", "Single games reloaded from an update message");
+static OS::Gauge g_game_catalog_games("game_catalog_games", "Games in the published catalog");
+
+namespace OS {
+	GameCatalog *g_game_catalog = NULL;
+	const char *game_catalog_channel = "gamemaster.games";
+
+	GameCatalog::GameCatalog() {
+		struct timeval t;
+		t.tv_usec = 0;
+		t.tv_sec = 60;
+
+		mp_mutex = OS::CreateMutex();
+		mp_redis_connection = Redis::Connect(OS::g_redisAddress, t);
+		mp_redis_subscribe_connection = Redis::Connect(OS::g_redisAddress, t);
+
+		Load();
+
+		mp_subscribe_thread = OS::CreateThread(GameCatalog::SubscribeThread, this, true);
+		mp_refresh_thread = OS::CreateThread(GameCatalog::RefreshThread, this, true);
+	}
+	GameCatalog::~GameCatalog() {
+		delete mp_subscribe_thread;
+		delete mp_refresh_thread;
+
+		Redis::Disconnect(mp_redis_subscribe_connection);
+		Redis::Disconnect(mp_redis_connection);
+
+		if (mp_snapshot) {
+			g_game_catalog_games.Add(-(int64_t)mp_snapshot->games.size());
+		}
+		mp_snapshot.reset();
+		delete mp_mutex;
+	}
+	bool GameCatalog::IsLoaded() {
+		return std::atomic_load(&mp_snapshot) != NULL;
+	}
+	//the snapshot is kept alive by the reference taken here, even if a writer replaces it meanwhile
+	bool GameCatalog::LookupGameByID(int gameid, GameData &game) {
+		std::shared_ptr<const GameCatalogSnapshot> snapshot = std::atomic_load(&mp_snapshot);
+		if (snapshot == NULL) {
+			return false;
+		}
+		std::unordered_map<int, size_t>::const_iterator it = snapshot->by_id.find(gameid);
+		if (it == snapshot->by_id.end()) {
+			g_game_catalog_misses.Add();
+			return false;
+		}
+		game = snapshot->games[(*it).second];
+		g_game_catalog_hits.Add();
+		return true;
+	}
+	bool GameCatalog::LookupGameByName(const char *gamename, GameData &game) {
+		std::shared_ptr<const GameCatalogSnapshot> snapshot = std::atomic_load(&mp_snapshot);
+		if (snapshot == NULL) {
+			return false;
+		}
+		std::unordered_map<std::string, size_t>::const_iterator it = snapshot->by_name.find(gamename);
+		if (it == snapshot->by_name.end()) {
+			g_game_catalog_misses.Add();
+			return false;
+		}
+		game = snapshot->games[(*it).second];
+		g_game_catalog_hits.Add();
+		return true;
+	}
+	bool GameCatalog::ParseGame(Redis::Value &hash, GameData &game) {
+		game.gameid = 0;
+		game.queryport = 0;
+		game.gamename[0] = 0;
+		game.description[0] = 0;
+		game.secretkey[0] = 0;
+		game.disabled_services = 0;
+		game.compatibility_flags = 0;
+
+		if (hash.type != Redis::REDIS_RESPONSE_TYPE_ARRAY) {
+			return false;
+		}
+		bool found_id = false;
+		for (size_t i = 0; i + 1 < hash.arr_value.values.size(); i += 2) {
+			std::string &field = hash.arr_value.values[i].second.value._str;
+			std::string value = OS::strip_quotes(hash.arr_value.values[i + 1].second.value._str);
+			if (field.compare("gameid") == 0) {
+				game.gameid = atoi(value.c_str());
+				found_id = true;
+			}
+			else if (field.compare("gamename") == 0) {
+				strncpy(game.gamename, value.c_str(), sizeof(game.gamename) - 1);
+				game.gamename[sizeof(game.gamename) - 1] = 0;
+			}
+			else if (field.compare("secretkey") == 0) {
+				strncpy(game.secretkey, value.c_str(), sizeof(game.secretkey) - 1);
+				game.secretkey[sizeof(game.secretkey) - 1] = 0;
+			}
+			else if (field.compare("description") == 0) {
+				strncpy(game.description, value.c_str(), sizeof(game.description) - 1);
+				game.description[sizeof(game.description) - 1] = 0;
+			}
+			else if (field.compare("queryport") == 0) {
+				game.queryport = atoi(value.c_str());
+			}
+			else if (field.compare("disabled_services") == 0) {
+				game.disabled_services = atoi(value.c_str());
+			}
+			else if (field.compare("compatibility_flags") == 0) {
+				game.compatibility_flags = atoi(value.c_str());
+			}
+		}
+		return found_id && game.gamename[0] != 0;
+	}
+	//where two games share a gameid or gamename, the first one loaded is found, as the first one scanned was before
+	void GameCatalog::BuildIndexes(GameCatalogSnapshot *snapshot) {
+		snapshot->by_id.clear();
+		snapshot->by_name.clear();
+		snapshot->by_id.reserve(snapshot->games.size());
+		snapshot->by_name.reserve(snapshot->games.size());
+		for (size_t i = 0; i < snapshot->games.size(); i++) {
+			snapshot->by_id.insert(std::pair<int, size_t>(snapshot->games[i].gameid, i));
+			snapshot->by_name.insert(std::pair<std::string, size_t>(snapshot->games[i].gamename, i));
+		}
+	}
+	void GameCatalog::Publish(GameCatalogSnapshot *snapshot) {
+		std::shared_ptr<const GameCatalogSnapshot> old_snapshot = std::atomic_load(&mp_snapshot);
+
+		snapshot->version = old_snapshot ? old_snapshot->version + 1 : 1;
+		BuildIndexes(snapshot);
+		std::atomic_store(&mp_snapshot, std::shared_ptr<const GameCatalogSnapshot>(snapshot));
+
+		g_game_catalog_games.Add((int64_t)snapshot->games.size() - (old_snapshot ? (int64_t)old_snapshot->games.size() : 0));
+	}
+	bool GameCatalog::Load() {
+		Redis::Response reply;
+		Redis::Value v, arr;
+		std::vector<std::string> keys;
+		GameCatalogSnapshot *snapshot;
+		int num_games;
+
+		mp_mutex->lock();
+		Redis::Command(mp_redis_connection, 0, "SELECT %d", ERedisDB_Game);
+
+		int cursor = 0;
+		do {
+			reply = Redis::Command(mp_redis_connection, 0, "SCAN %d COUNT %d", cursor, GAME_CATALOG_SCAN_COUNT);
+			if (Redis::CheckError(reply) || reply.values.empty() || reply.values[0].arr_value.values.size() < 2) {
+				goto end_error;
+			}
+			v = reply.values[0].arr_value.values[0].second;
+			if (v.type == Redis::REDIS_RESPONSE_TYPE_STRING) {
+				cursor = atoi(v.value._str.c_str());
+			}
+			else if (v.type == Redis::REDIS_RESPONSE_TYPE_INTEGER) {
+				cursor = v.value._int;
+			}
+			arr = reply.values[0].arr_value.values[1].second;
+			for (size_t i = 0; i < arr.arr_value.values.size(); i++) {
+				keys.push_back(arr.arr_value.values[i].second.value._str);
+			}
+		} while (cursor != 0);
+
+		//SCAN can return a key more than once
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+		//one round trip for every game, instead of one per field of every game
+		for (size_t i = 0; i < keys.size(); i++) {
+			Redis::AppendCommand(mp_redis_connection, "HGETALL %s", keys[i].c_str());
+		}
+		reply = Redis::Flush(mp_redis_connection);
+		if (reply.values.size() != keys.size()) {
+			goto end_error;
+		}
+
+		snapshot = new GameCatalogSnapshot();
+		snapshot->games.reserve(keys.size());
+		for (size_t i = 0; i < reply.values.size(); i++) {
+			GameData game;
+			if (ParseGame(reply.values[i], game)) {
+				snapshot->games.push_back(game);
+			}
+		}
+		num_games = (int)snapshot->games.size();
+		Publish(snapshot);
+		g_game_catalog_loads.Add();
+		mp_mutex->unlock();
+
+		OS::LogText(OS::ELogLevel_Info, "Game catalog loaded %d games", num_games);
+		return true;
+
+	end_error:
+		mp_mutex->unlock();
+		OS::LogText(OS::ELogLevel_Error, "Game catalog load failed");
+		return false;
+	}
+	//key is <gamename>:<gameid>, any game with the same gameid is replaced, so a renamed game doesn't stay under its old name
+	void GameCatalog::ReloadGame(std::string key) {
+		size_t split = key.find_last_of(':');
+		if (split == std::string::npos) {
+			return;
+		}
+		int gameid = atoi(key.substr(split + 1).c_str());
+
+		mp_mutex->lock();
+		std::shared_ptr<const GameCatalogSnapshot> old_snapshot = std::atomic_load(&mp_snapshot);
+		if (old_snapshot == NULL) {
+			mp_mutex->unlock();
+			return;
+		}
+
+		Redis::Command(mp_redis_connection, 0, "SELECT %d", ERedisDB_Game);
+		Redis::Response reply = Redis::Command(mp_redis_connection, 0, "HGETALL %s", key.c_str());
+		if (Redis::CheckError(reply) || reply.values.empty()) {
+			mp_mutex->unlock();
+			return;
+		}
+
+		GameCatalogSnapshot *snapshot = new GameCatalogSnapshot();
+		snapshot->games.reserve(old_snapshot->games.size() + 1);
+		std::vector<GameData>::const_iterator it = old_snapshot->games.begin();
+		while (it != old_snapshot->games.end()) {
+			if ((*it).gameid != gameid) {
+				snapshot->games.push_back(*it);
+			}
+			it++;
+		}
+
+		//an empty hash means the game was deleted
+		GameData game;
+		if (ParseGame(reply.values[0], game)) {
+			snapshot->games.push_back(game);
+		}
+		Publish(snapshot);
+		g_game_catalog_updates.Add();
+		mp_mutex->unlock();
+	}
+	void GameCatalog::onRedisMessage(Redis::Connection *c, Redis::Response reply, void *privdata) {
+		GameCatalog *catalog = (GameCatalog *)privdata;
+		Redis::Value v = reply.values.front();
+
+		if (v.type != Redis::REDIS_RESPONSE_TYPE_ARRAY || v.arr_value.values.size() != 3) {
+			return;
+		}
+		std::string type = v.arr_value.values[0].second.value._str;
+		if (type.compare("subscribe") == 0) {
+			//anything published while unsubscribed was missed, this also covers the gap between the first load and subscribing
+			catalog->Load();
+		}
+		else if (type.compare("message") == 0 && v.arr_value.values[2].first == Redis::REDIS_RESPONSE_TYPE_STRING) {
+			std::map<std::string, std::string> kv_data = OS::KeyStringToMap(v.arr_value.values[2].second.value._str);
+			if (kv_data.find("update") != kv_data.end()) {
+				catalog->ReloadGame(kv_data["update"]);
+			}
+			else if (kv_data.find("reload") != kv_data.end()) {
+				catalog->Load();
+			}
+		}
+	}
+	void *GameCatalog::SubscribeThread(OS::CThread *thread) {
+		GameCatalog *catalog = (GameCatalog *)thread->getParams();
+		Redis::LoopingCommand(catalog->mp_redis_subscribe_connection, 0, GameCatalog::onRedisMessage, catalog, "SUBSCRIBE %s", game_catalog_channel);
+		return NULL;
+	}
+	void *GameCatalog::RefreshThread(OS::CThread *thread) {
+		GameCatalog *catalog = (GameCatalog *)thread->getParams();
+		while (true) {
+			OS::Sleep(GAME_CATALOG_REFRESH_TIME * 1000);
+			catalog->Load();
+		}
+		return NULL;
+	}
+	void SetupGameCatalog() {
+		g_game_catalog = new GameCatalog();
+	}
+	void ShutdownGameCatalog() {
+		if (g_game_catalog) {
+			delete g_game_catalog;
+			g_game_catalog = NULL;
+		}
+	}
+}
@@ -0,0 +1,68 @@
+#ifndef _OS_GAMECATALOG_H
+#define _OS_GAMECATALOG_H
+#include <OS/OpenSpy.h>
+#include <OS/Mutex.h>
+#include <OS/Redis.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <utility>
+
+#define GAME_CATALOG_REFRESH_TIME 600 //seconds between full reloads, for games changed without a message being published
+#define GAME_CATALOG_SCAN_COUNT 1000
+namespace OS {
+	extern const char *game_catalog_channel;
+
+	//never changed once published, an update builds and publishes a new one
+	typedef struct {
+		uint32_t version;
+		std::vector<GameData> games;
+		std::unordered_map<int, size_t> by_id; //index into games
+		std::unordered_map<std::string, size_t> by_name;
+	} GameCatalogSnapshot;
+
+	/*
+		Every game in the game db, loaded at startup so lookups don't touch redis.
+		Lookups read whichever snapshot is published without taking mp_mutex, writers are serialized and swap in a new snapshot.
+		The game editor publishes \update\<gamename>:<gameid> on game_catalog_channel when it writes a game, which reloads only that game,
+		and \reload\1 reloads all of them. Every (re)subscribe and GAME_CATALOG_REFRESH_TIME also reloads all of them,
+		so updates sent while the subscriber was disconnected, or games changed by hand, are picked up.
+		A lookup holds a reference to the snapshot it read, so a replaced snapshot is freed when the last lookup using it is done.
+	*/
+	class GameCatalog {
+	public:
+		GameCatalog();
+		~GameCatalog();
+
+		//false until a load succeeded, lookups should go to redis until then
+		bool IsLoaded();
+		bool LookupGameByID(int gameid, GameData &game);
+		bool LookupGameByName(const char *gamename, GameData &game);
+
+		bool Load();
+		void ReloadGame(std::string key);
+	private:
+		static void *SubscribeThread(OS::CThread *thread);
+		static void *RefreshThread(OS::CThread *thread);
+		static void onRedisMessage(Redis::Connection *c, Redis::Response reply, void *privdata);
+		static bool ParseGame(Redis::Value &hash, GameData &game);
+		static void BuildIndexes(GameCatalogSnapshot *snapshot);
+
+		//takes ownership of the snapshot, must hold mp_mutex
+		void Publish(GameCatalogSnapshot *snapshot);
+
+		std::shared_ptr<const GameCatalogSnapshot> mp_snapshot; //only read and written with std::atomic_load/atomic_store
+		OS::CMutex *mp_mutex; //held by writers and while using mp_redis_connection
+
+		Redis::Connection *mp_redis_connection;
+		Redis::Connection *mp_redis_subscribe_connection;
+		OS::CThread *mp_subscribe_thread;
+		OS::CThread *mp_refresh_thread;
+	};
+	extern GameCatalog *g_game_catalog;
+	void SetupGameCatalog();
+	void ShutdownGameCatalog();
+}
+#endif //_OS_GAMECATALOG_H
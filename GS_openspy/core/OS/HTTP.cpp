@@ -1,75 +1,413 @@
 #include <OS/HTTP.h>
+#include <OS/Analytics/Instrument.h>
+#include <algorithm>
+#include <sstream>
 
 namespace OS {
-	struct curl_data {
-	    std::string buffer;
-	};
+	HTTPEngine *g_http_engine = NULL;
+
+	HTTPClient::~HTTPClient() {
+
+	}
+	HTTPClient::HTTPClient(std::string url, std::string user_agent) {
+		m_url = url;
+		m_user_agent = user_agent;
+	}
+	HTTPResponse HTTPClient::Post(std::string send) {
+		return g_http_engine->Perform(m_url, m_user_agent, send);
+	}
+	void HTTPClient::PostAsync(std::string send, HTTPCallback callback, void *extra, const void *order_key) {
+		g_http_engine->Submit(m_url, m_user_agent, send, callback, extra, order_key);
+	}
+
 	/* callback for curl fetch */
-	size_t HTTPClient::curl_callback (void *contents, size_t size, size_t nmemb, void *userp) {
+	size_t HTTPEngine::curl_callback (void *contents, size_t size, size_t nmemb, void *userp) {
 		if(!contents) {
 			return 0;
 		}
-	    size_t realsize = size * nmemb;                             /* calculate buffer size */
-	    curl_data *data = (curl_data *)userp;
-		const char *p = (const char *)contents;
-		data->buffer += (p);
-
-	    return realsize;
+		size_t realsize = size * nmemb;                             /* calculate buffer size */
+		HTTPResponse *response = (HTTPResponse *)userp;
+		response->buffer.append((const char *)contents, realsize);
+		return realsize;
 	}
-	HTTPClient::~HTTPClient() {
+	HTTPEngine::HTTPEngine() {
+		mp_multi = curl_multi_init();
+		curl_multi_setopt(mp_multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)HTTP_MAX_HOST_CONNECTIONS);
+		curl_multi_setopt(mp_multi, CURLMOPT_MAXCONNECTS, (long)HTTP_MAX_HOST_CONNECTIONS * 4); //room for a few backend hosts
+		#ifdef CURLPIPE_MULTIPLEX
+		curl_multi_setopt(mp_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+		#endif
 
+		mp_headers = NULL;
+		if(g_webServicesAPIKey) {
+			std::string apiKey = "APIKey: " + std::string(g_webServicesAPIKey);
+			mp_headers = curl_slist_append(mp_headers, apiKey.c_str());
+		}
+		mp_headers = curl_slist_append(mp_headers, "Content-Type: application/json");
+
+		m_running = true;
+		mp_mutex = OS::CreateMutex();
+		mp_thread = OS::CreateThread(HTTPEngine::EngineThread, this, true);
 	}
-	HTTPClient::HTTPClient(std::string url) {
-		m_url = url;
+	HTTPEngine::~HTTPEngine() {
+		mp_mutex->lock();
+		m_running = false;
+		mp_mutex->unlock();
+		Wakeup();
+		delete mp_thread;
+
+		//fail whatever is left, so the callbacks can release what they hold
+		std::vector<HTTPRequest *> failed;
+		std::vector<HTTPRequest *>::iterator it = m_in_flight.begin();
+		while (it != m_in_flight.end()) {
+			HTTPRequest *request = *it;
+			curl_multi_remove_handle(mp_multi, request->curl);
+			curl_easy_cleanup(request->curl);
+			failed.push_back(request);
+			it++;
+		}
+		m_in_flight.clear();
+		failed.insert(failed.end(), m_queue.begin(), m_queue.end());
+		m_queue.clear();
+		std::map<const void *, std::deque<HTTPRequest *> >::iterator it2 = m_ordered.begin();
+		while (it2 != m_ordered.end()) {
+			failed.insert(failed.end(), (*it2).second.begin(), (*it2).second.end());
+			it2++;
+		}
+		m_ordered.clear();
+
+		it = failed.begin();
+		while (it != failed.end()) {
+			HTTPRequest *request = *it;
+			request->response.status_code = 0;
+			request->response.buffer.clear();
+			if (request->callback) {
+				request->callback(request->response, request->extra);
+			}
+			delete request;
+			it++;
+		}
+
+		std::map<std::string, HTTPEndpoint *>::iterator it3 = m_endpoints.begin();
+		while (it3 != m_endpoints.end()) {
+			HTTPEndpoint *endpoint = (*it3).second;
+			std::vector<CURL *>::iterator it4 = endpoint->idle_handles.begin();
+			while (it4 != endpoint->idle_handles.end()) {
+				curl_easy_cleanup(*it4);
+				it4++;
+			}
+			it4 = endpoint->idle_sync_handles.begin();
+			while (it4 != endpoint->idle_sync_handles.end()) {
+				curl_easy_cleanup(*it4);
+				it4++;
+			}
+			delete endpoint->requests;
+			delete endpoint->errors;
+			delete endpoint->in_flight;
+			delete endpoint->latency;
+			delete endpoint;
+			it3++;
+		}
+
+		curl_multi_cleanup(mp_multi);
+		curl_slist_free_all(mp_headers);
+		delete mp_mutex;
 	}
-	HTTPResponse HTTPClient::Post(std::string send) {
-		curl_data data;
-		HTTPResponse resp;
+	HTTPResponse HTTPEngine::Perform(std::string url, std::string user_agent, std::string send) {
+		HTTPResponse response;
+		response.status_code = 0;
 
-		CURL *curl = curl_easy_init();
-		CURLcode res;
+		mp_mutex->lock();
+		HTTPEndpoint *endpoint = GetEndpoint(url);
+		CURL *curl = TakeHandle(endpoint->idle_sync_handles);
+		mp_mutex->unlock();
 
+		struct timeval start_time;
+		gettimeofday(&start_time, NULL);
 		if(curl) {
-			curl_easy_setopt(curl, CURLOPT_URL, m_url.c_str());
-			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, send.c_str());
+			SetupHandle(curl, url, user_agent, send, &response);
+			if (curl_easy_perform(curl) == CURLE_OK) {
+				long http_code = 0;
+				curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+				response.status_code = http_code;
+			}
+		}
 
-			/* set default user agent */
-			curl_easy_setopt(curl, CURLOPT_USERAGENT, "OS/HTTP");
+		mp_mutex->lock();
+		RecordCompletion(endpoint, start_time, response.status_code);
+		if(curl) {
+			ReturnHandle(endpoint->idle_sync_handles, curl);
+		}
+		mp_mutex->unlock();
+		return response;
+	}
+	void HTTPEngine::Submit(std::string url, std::string user_agent, std::string send, HTTPCallback callback, void *extra, const void *order_key) {
+		HTTPRequest *request = new HTTPRequest;
+		request->curl = NULL;
+		request->send = send;
+		request->user_agent = user_agent;
+		request->response.status_code = 0;
+		request->callback = callback;
+		request->extra = extra;
+		request->order_key = order_key;
+
+		mp_mutex->lock();
+		if(!m_running) {
+			mp_mutex->unlock();
+			if (callback) {
+				callback(request->response, extra);
+			}
+			delete request;
+			return;
+		}
+		request->endpoint = GetEndpoint(url);
+		if(order_key) {
+			std::map<const void *, std::deque<HTTPRequest *> >::iterator it = m_ordered.find(order_key);
+			if(it != m_ordered.end()) {
+				//goes out once the ones ahead of it are done
+				(*it).second.push_back(request);
+				mp_mutex->unlock();
+				return;
+			}
+			m_ordered[order_key];
+		}
+		m_queue.push_back(request);
+		mp_mutex->unlock();
+		Wakeup();
+	}
+	void *HTTPEngine::EngineThread(CThread *thread) {
+		HTTPEngine *engine = (HTTPEngine *)thread->getParams();
+		int running_handles;
+		for(;;) {
+			engine->mp_mutex->lock();
+			bool running = engine->m_running;
+			engine->mp_mutex->unlock();
+			if(!running) {
+				break;
+			}
 
-			/* set timeout */
-			curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5);
+			engine->StartQueued();
+			curl_multi_perform(engine->mp_multi, &running_handles);
+			engine->ProcessCompleted();
 
-			/* enable location redirects */
-			curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
+			#if LIBCURL_VERSION_NUM >= 0x074400
+			curl_multi_poll(engine->mp_multi, NULL, 0, HTTP_POLL_TIME, NULL);
+			#else
+			curl_multi_wait(engine->mp_multi, NULL, 0, HTTP_WAIT_TIME, NULL);
+			#endif
+		}
+		return NULL;
+	}
+	void HTTPEngine::StartQueued() {
+		std::vector<HTTPRequest *> failed;
 
-			/* set maximum allowed redirects */
-			curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 1);
+		mp_mutex->lock();
+		while(!m_queue.empty() && m_in_flight.size() < HTTP_MAX_IN_FLIGHT) {
+			HTTPRequest *request = m_queue.front();
+			m_queue.pop_front();
 
-			/* Close socket after one use */
-			curl_easy_setopt(curl, CURLOPT_FORBID_REUSE, 1);
+			gettimeofday(&request->start_time, NULL);
+			request->curl = TakeHandle(request->endpoint->idle_handles);
+			if(request->curl) {
+				SetupHandle(request->curl, request->endpoint->url, request->user_agent, request->send, &request->response);
+				curl_easy_setopt(request->curl, CURLOPT_PRIVATE, (void *)request);
+				if(curl_multi_add_handle(mp_multi, request->curl) == CURLM_OK) {
+					request->endpoint->in_flight->Incr();
+					m_in_flight.push_back(request);
+					continue;
+				}
+				ReturnHandle(request->endpoint->idle_handles, request->curl);
+				request->curl = NULL;
+			}
+			RecordCompletion(request->endpoint, request->start_time, 0);
+			ReleaseOrderKey(request->order_key);
+			failed.push_back(request);
+		}
+		mp_mutex->unlock();
 
-			curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_callback);
-			curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) &data);
+		std::vector<HTTPRequest *>::iterator it = failed.begin();
+		while (it != failed.end()) {
+			HTTPRequest *request = *it;
+			if (request->callback) {
+				request->callback(request->response, request->extra);
+			}
+			delete request;
+			it++;
+		}
+	}
+	void HTTPEngine::ProcessCompleted() {
+		std::vector<HTTPRequest *> completed;
+		CURLMsg *msg;
+		int msgs_left;
+		while((msg = curl_multi_info_read(mp_multi, &msgs_left))) {
+			if(msg->msg != CURLMSG_DONE) {
+				continue;
+			}
+			HTTPRequest *request = NULL;
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&request);
+			if(msg->data.result == CURLE_OK) {
+				long http_code = 0;
+				curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &http_code);
+				request->response.status_code = http_code;
+			}
+			completed.push_back(request);
+		}
+		if(completed.empty()) {
+			return;
+		}
 
-			struct curl_slist *chunk = NULL;
-			std::string apiKey = "APIKey: " + std::string(g_webServicesAPIKey);
-			chunk = curl_slist_append(chunk, apiKey.c_str());
-			chunk = curl_slist_append(chunk, "Content-Type: application/json");
-			curl_easy_setopt(curl, CURLOPT_HTTPHEADER, chunk);
+		mp_mutex->lock();
+		std::vector<HTTPRequest *>::iterator it = completed.begin();
+		while (it != completed.end()) {
+			HTTPRequest *request = *it;
+			curl_multi_remove_handle(mp_multi, request->curl);
+			ReturnHandle(request->endpoint->idle_handles, request->curl);
+			request->curl = NULL;
 
-			res = curl_easy_perform(curl);
+			std::vector<HTTPRequest *>::iterator it2 = std::find(m_in_flight.begin(), m_in_flight.end(), request);
+			if(it2 != m_in_flight.end()) {
+				m_in_flight.erase(it2);
+			}
+			request->endpoint->in_flight->Decr();
+			RecordCompletion(request->endpoint, request->start_time, request->response.status_code);
+			ReleaseOrderKey(request->order_key);
+			it++;
+		}
+		bool more_queued = !m_queue.empty();
+		mp_mutex->unlock();
 
-			if(res == CURLE_OK) {
-				long http_code;
-				curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
+		if(more_queued) {
+			//there's room on the wire again, don't sleep through it
+			Wakeup();
+		}
 
-				resp.status_code = http_code;
-				resp.buffer = data.buffer;
-				
+		it = completed.begin();
+		while (it != completed.end()) {
+			HTTPRequest *request = *it;
+			if (request->callback) {
+				request->callback(request->response, request->extra);
 			}
+			delete request;
+			it++;
+		}
+	}
+	void HTTPEngine::ReleaseOrderKey(const void *order_key) {
+		if(order_key == NULL) {
+			return;
+		}
+		std::map<const void *, std::deque<HTTPRequest *> >::iterator it = m_ordered.find(order_key);
+		if(it == m_ordered.end()) {
+			return;
+		}
+		if((*it).second.empty()) {
+			m_ordered.erase(it);
+			return;
+		}
+		m_queue.push_back((*it).second.front());
+		(*it).second.pop_front();
+	}
+	void HTTPEngine::Wakeup() {
+		#if LIBCURL_VERSION_NUM >= 0x074400
+		curl_multi_wakeup(mp_multi);
+		#endif
+	}
+	HTTPEndpoint *HTTPEngine::GetEndpoint(std::string url) {
+		std::map<std::string, HTTPEndpoint *>::iterator it = m_endpoints.find(url);
+		if(it != m_endpoints.end()) {
+			return (*it).second;
+		}
+		HTTPEndpoint *endpoint = new HTTPEndpoint;
+		endpoint->url = url;
+		std::string label = OS::Instrument::MakeLabel("endpoint", url);
+		endpoint->requests = new OS::Counter("http_requests", "Requests posted to a web service backend", label);
+		endpoint->errors = new OS::Counter("http_errors", "Requests which got no response or a 5xx", label);
+		endpoint->in_flight = new OS::Gauge("http_in_flight", "Async requests on the wire", label);
+		endpoint->latency = new OS::LatencyHistogram("http_request", "Time from a request going on the wire until its response", label);
+		m_endpoints[url] = endpoint;
+		return endpoint;
+	}
+	void HTTPEngine::SetupHandle(CURL *curl, std::string &url, std::string &user_agent, std::string &send, HTTPResponse *response) {
+		curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, send.c_str());
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)send.length());
+
+		curl_easy_setopt(curl, CURLOPT_USERAGENT, user_agent.c_str());
+		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, mp_headers);
+
+		/* set timeout */
+		curl_easy_setopt(curl, CURLOPT_TIMEOUT, (long)HTTP_TIMEOUT);
+
+		/* no SIGALRM based timeouts, posts are made from several threads */
+		curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+
+		/* enable location redirects */
+		curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+
+		/* set maximum allowed redirects */
+		curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 1L);
+
+		/* keep idle pooled connections from being silently dropped */
+		curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_callback);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)response);
+	}
+	CURL *HTTPEngine::TakeHandle(std::vector<CURL *> &handles) {
+		if(handles.empty()) {
+			return curl_easy_init();
+		}
+		CURL *curl = handles.back();
+		handles.pop_back();
+		return curl;
+	}
+	void HTTPEngine::ReturnHandle(std::vector<CURL *> &handles, CURL *curl) {
+		if(handles.size() < HTTP_MAX_IDLE_HANDLES) {
+			handles.push_back(curl);
+		}
+		else {
 			curl_easy_cleanup(curl);
 		}
+	}
+	void HTTPEngine::RecordCompletion(HTTPEndpoint *endpoint, struct timeval start_time, int status_code) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		long long elapsed_us = (now.tv_sec - start_time.tv_sec) * 1000000LL + (now.tv_usec - start_time.tv_usec);
+
+		endpoint->latency->Record(elapsed_us > 0 ? elapsed_us : 0);
+		endpoint->requests->Add();
+		if(status_code == 0 || status_code >= 500) {
+			endpoint->errors->Add();
+		}
+	}
+	//the per endpoint stats are instruments of their own, labelled with the url
+	OS::MetricValue HTTPEngine::GetMetrics() {
+		OS::MetricValue arr_value, value;
+		value.type = OS::MetricType_Integer;
+
+		mp_mutex->lock();
+		size_t num_waiting = m_queue.size();
+		std::map<const void *, std::deque<HTTPRequest *> >::iterator it = m_ordered.begin();
+		while (it != m_ordered.end()) {
+			num_waiting += (*it).second.size();
+			it++;
+		}
+		mp_mutex->unlock();
+
+		value.value._int = num_waiting;
+		value.key = "queued";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
 
-		return resp;
+		arr_value.key = "http";
+		arr_value.type = OS::MetricType_Array;
+		return arr_value;
+	}
+	void SetupHTTPEngine() {
+		g_http_engine = new HTTPEngine();
+		OS::InstrumentRegistry::getSingleton()->AddCollector("http", g_http_engine);
+	}
+	void ShutdownHTTPEngine() {
+		OS::InstrumentRegistry::getSingleton()->RemoveCollectors(g_http_engine);
+		delete g_http_engine;
+		g_http_engine = NULL;
 	}
-}
\ No newline at end of file
+}
@@ -1,22 +1,120 @@
 #ifndef _OS_HTTP_H
 #define _OS_HTTP_H
 #include <OS/OpenSpy.h>
+#include <OS/Mutex.h>
+#include <OS/Thread.h>
+#include <OS/Analytics/Metric.h>
 #include <curl/curl.h>
+#include <deque>
+#include <map>
+#include <vector>
+#ifdef _WIN32
+#include <time.h>
+#else
+#include <sys/time.h>
+#endif
+
+#define HTTP_TIMEOUT 5 //seconds
+#define HTTP_MAX_IN_FLIGHT 64 //async requests on the wire at once, the rest wait in the engine queue
+#define HTTP_MAX_HOST_CONNECTIONS 16 //keep-alive connections kept open per backend host
+#define HTTP_MAX_IDLE_HANDLES 16 //easy handles kept around per endpoint, and per kind (sync/async)
+#define HTTP_POLL_TIME 1000 //ms, how long the engine sleeps with nothing to do, new requests wake it
+#define HTTP_WAIT_TIME 10 //ms, same but for libcurl builds without curl_multi_wakeup
 namespace OS {
+	class Counter;
+	class Gauge;
+	class LatencyHistogram;
+
 	typedef struct {
-		int status_code;
+		int status_code; //0 if no response was received
 		std::string buffer;
 	} HTTPResponse;
+
+	/*
+		Called on the HTTP engine thread, must not block for long as it holds up every other completion
+	*/
+	typedef void (*HTTPCallback)(HTTPResponse response, void *extra);
+
 	class HTTPClient {
 	public:
-		HTTPClient(std::string url);
+		HTTPClient(std::string url, std::string user_agent = "OS/HTTP");
 		~HTTPClient();
 		//(GP_PERSIST_BACKEND_URL, GP_PERSIST_BACKEND_CRYPTKEY, send_json)
 		HTTPResponse Post(std::string send); //synchronous HTTP post
+		/*
+			Queues the post and returns, callback (if any) is called once it has completed or failed.
+			Posts sharing an order_key (usually the peer) are sent one at a time, in the order they were made.
+		*/
+		void PostAsync(std::string send, HTTPCallback callback, void *extra, const void *order_key = NULL);
 
 	private:
-		static size_t curl_callback (void *contents, size_t size, size_t nmemb, void *userp);
 		std::string m_url;
+		std::string m_user_agent;
+	};
+
+	typedef struct {
+		std::string url;
+		std::vector<CURL *> idle_handles; //used with the multi handle, connections live in its cache
+		std::vector<CURL *> idle_sync_handles; //each keeps its own keep-alive connection between posts
+		//labelled with the url, so each backend is one series of the http_ metrics
+		OS::Counter *requests;
+		OS::Counter *errors;
+		OS::Gauge *in_flight;
+		OS::LatencyHistogram *latency;
+	} HTTPEndpoint;
+
+	typedef struct {
+		HTTPEndpoint *endpoint;
+		CURL *curl;
+		std::string send;
+		std::string user_agent;
+		HTTPResponse response;
+		HTTPCallback callback;
+		void *extra;
+		const void *order_key;
+		struct timeval start_time;
+	} HTTPRequest;
+
+	/*
+		Shared curl multi driver for the web service backends.
+		Async posts are run by a single engine thread, connections to each backend are kept alive and reused between requests,
+		and on HTTP/2 backends concurrent requests are multiplexed over them.
+		Synchronous posts run on the calling thread using a pooled handle, so they also keep their connection.
+	*/
+	class HTTPEngine {
+	public:
+		HTTPEngine();
+		~HTTPEngine();
+		HTTPResponse Perform(std::string url, std::string user_agent, std::string send);
+		void Submit(std::string url, std::string user_agent, std::string send, HTTPCallback callback, void *extra, const void *order_key);
+		OS::MetricValue GetMetrics();
+	private:
+		static void *EngineThread(CThread *thread);
+		static size_t curl_callback(void *contents, size_t size, size_t nmemb, void *userp);
+		HTTPEndpoint *GetEndpoint(std::string url);
+		void SetupHandle(CURL *curl, std::string &url, std::string &user_agent, std::string &send, HTTPResponse *response);
+		CURL *TakeHandle(std::vector<CURL *> &handles);
+		void ReturnHandle(std::vector<CURL *> &handles, CURL *curl);
+		void RecordCompletion(HTTPEndpoint *endpoint, struct timeval start_time, int status_code);
+		void StartQueued();
+		void ProcessCompleted();
+		void ReleaseOrderKey(const void *order_key);
+		void Wakeup();
+
+		CURLM *mp_multi;
+		struct curl_slist *mp_headers;
+
+		std::map<std::string, HTTPEndpoint *> m_endpoints;
+		std::deque<HTTPRequest *> m_queue; //ready to go on the wire once there's room
+		std::map<const void *, std::deque<HTTPRequest *> > m_ordered; //keys with a request in progress, and what's waiting behind it
+		std::vector<HTTPRequest *> m_in_flight;
+
+		bool m_running;
+		OS::CMutex *mp_mutex;
+		OS::CThread *mp_thread;
 	};
+	extern HTTPEngine *g_http_engine;
+	void SetupHTTPEngine();
+	void ShutdownHTTPEngine();
 }
-#endif //_OS_HTTP_H
\ No newline at end of file
+#endif //_OS_HTTP_H
@@ -1,114 +1,223 @@
 #include "KVReader.h"
 #include <string>
-#include <sstream>
-#include <algorithm>
-#include <math.h>
+#include <string.h>
+#include <stdlib.h>
 namespace OS {
 	KVReader::KVReader() {
-
+		m_num_pairs = 0;
 	}
 	KVReader::KVReader(std::string kv_pair, char delim, char line_delim) {
-		std::string token, key, value, line;
-		int i = 0;
+		m_data.swap(kv_pair);
+		Parse(delim, line_delim);
+	}
+	KVReader::KVReader(const char *data, int len, char delim, char line_delim) {
+		m_data.assign(data, len);
+		Parse(delim, line_delim);
+	}
+	KVReader::~KVReader() {
 
-	    std::stringstream ss, line_ss;
-	    if(kv_pair[0] == delim) {
-	    	kv_pair = kv_pair.substr(1,kv_pair.length()-1);
-		}
-	    ss.str(kv_pair);
+	}
+	void KVReader::Parse(char delim, char line_delim) {
+		int len = m_data.length();
+		m_num_pairs = 0;
 
-		while (line_delim == 0 || std::getline(ss, line, line_delim)) {
-			if (line_delim == 0) {
-				line_ss = std::stringstream(ss.str());
-			}
-			else {
-				line_ss = std::stringstream(line);
+		//so the last token has somewhere to be terminated
+		m_data.push_back('\0');
+
+		int pos = 0;
+		if (len > 0 && m_data[0] == delim) {
+			pos = 1;
+		}
+		if (line_delim == 0) {
+			ParseLine(pos, len, delim);
+			return;
+		}
+		while (pos < len) {
+			const char *line_end = (const char *)memchr(&m_data[pos], line_delim, len - pos);
+			int end = line_end ? line_end - m_data.c_str() : len;
+			ParseLine(pos, end, delim);
+			pos = end + 1;
+		}
+	}
+	//like splitting with std::getline, a delimiter at the end doesn't start another token, and a key without a value is dropped
+	void KVReader::ParseLine(int start, int end, char delim) {
+		int key_offset = 0, key_len = 0;
+		uint32_t key_hash = 0;
+		int i = 0;
+		int pos = start;
+		while (pos < end) {
+			const char *token_end = (const char *)memchr(&m_data[pos], delim, end - pos);
+			int next = token_end ? token_end - m_data.c_str() : end;
+			int token_len = FinishToken(pos, next);
+			if (i % 2 == 0) {
+				key_offset = pos;
+				key_len = token_len;
+				key_hash = Hash(&m_data[key_offset], key_len);
 			}
-			i = 0;
-			while (std::getline(line_ss, token, delim)) {
-				if (i % 2 == 0) {
-					key = OS::strip_whitespace(token);
+			else if (FindKey(&m_data[key_offset], key_len, key_hash) == -1) {
+				KVReaderPair pair;
+				pair.key_hash = key_hash;
+				pair.key_offset = key_offset;
+				pair.key_len = key_len;
+				pair.value_offset = pos;
+				pair.value_len = token_len;
+				if (m_num_pairs < KV_READER_INLINE_PAIRS) {
+					m_inline_pairs[m_num_pairs] = pair;
 				}
 				else {
-					value = OS::strip_whitespace(token);
-					if (!HasKey(key)) {
-						m_kv_map.push_back(std::pair<std::string, std::string>(key, value));
+					m_extra_pairs.push_back(pair);
+				}
+				m_num_pairs++;
+				if (!m_key_slots.empty()) {
+					if (m_num_pairs * 2 > (int)m_key_slots.size()) {
+						RehashKeys(m_key_slots.size() * 2);
 					}
+					else {
+						InsertKeySlot(m_num_pairs - 1);
+					}
+				}
+				else if (m_num_pairs == KV_READER_INLINE_PAIRS) {
+					RehashKeys(KV_READER_MIN_KEY_SLOTS);
 				}
-				i++;
 			}
-			if (line_delim == 0) {
-				break;
+			i++;
+			pos = next + 1;
+		}
+	}
+	//drops whitespace other than spaces, as OS::strip_whitespace does in the C locale, and terminates the token over its delimiter
+	int KVReader::FinishToken(int start, int end) {
+		char *token = &m_data[start];
+		int len = end - start;
+		int out = 0;
+		for (int i = 0; i < len; i++) {
+			if ((uint8_t)(token[i] - '\t') <= '\r' - '\t') {
+				continue;
 			}
+			token[out++] = token[i];
 		}
+		token[out] = 0;
+		return out;
 	}
-	KVReader::~KVReader() {
-
+	uint32_t KVReader::Hash(const char *str, int len) {
+		uint32_t hash = 2166136261U;
+		for (int i = 0; i < len; i++) {
+			hash ^= (uint8_t)str[i];
+			hash *= 16777619U;
+		}
+		return hash;
+	}
+	const KVReaderPair *KVReader::GetPair(int n) const {
+		if (n < 0 || n >= m_num_pairs) {
+			return NULL;
+		}
+		if (n < KV_READER_INLINE_PAIRS) {
+			return &m_inline_pairs[n];
+		}
+		return &m_extra_pairs[n - KV_READER_INLINE_PAIRS];
+	}
+	void KVReader::InsertKeySlot(int n) {
+		size_t mask = m_key_slots.size() - 1;
+		size_t slot = GetPair(n)->key_hash & mask;
+		while (m_key_slots[slot] != 0) {
+			slot = (slot + 1) & mask;
+		}
+		m_key_slots[slot] = n + 1;
+	}
+	void KVReader::RehashKeys(int num_slots) {
+		m_key_slots.assign(num_slots, 0);
+		for (int i = 0; i < m_num_pairs; i++) {
+			InsertKeySlot(i);
+		}
+	}
+	int KVReader::FindKey(const char *key, int len, uint32_t hash) {
+		if (!m_key_slots.empty()) {
+			size_t mask = m_key_slots.size() - 1;
+			size_t slot = hash & mask;
+			while (m_key_slots[slot] != 0) {
+				int n = m_key_slots[slot] - 1;
+				const KVReaderPair *pair = GetPair(n);
+				if (pair->key_hash == hash && pair->key_len == len && memcmp(&m_data[pair->key_offset], key, len) == 0) {
+					return n;
+				}
+				slot = (slot + 1) & mask;
+			}
+			return -1;
+		}
+		for (int i = 0; i < m_num_pairs; i++) {
+			const KVReaderPair *pair = GetPair(i);
+			if (pair->key_hash == hash && pair->key_len == len && memcmp(&m_data[pair->key_offset], key, len) == 0) {
+				return i;
+			}
+		}
+		return -1;
+	}
+	int KVReader::FindKey(const char *key) {
+		int len = strlen(key);
+		return FindKey(key, len, Hash(key, len));
 	}
 	std::string KVReader::GetKeyByIdx(int n) {
-		return GetPairByIdx(n).first;
-
+		const KVReaderPair *pair = GetPair(n);
+		if (pair == NULL) {
+			return "";
+		}
+		return std::string(&m_data[pair->key_offset], pair->key_len);
 	}
 	std::string KVReader::GetValueByIdx(int n) {
-		return GetPairByIdx(n).second;
+		const KVReaderPair *pair = GetPair(n);
+		if (pair == NULL) {
+			return "";
+		}
+		return std::string(&m_data[pair->value_offset], pair->value_len);
 	}
 	int 		KVReader::GetValueIntByIdx(int n) {
-		return atoi(GetValueByIdx(n).c_str());
+		const KVReaderPair *pair = GetPair(n);
+		if (pair == NULL) {
+			return 0;
+		}
+		return atoi(&m_data[pair->value_offset]);
+	}
+	uint32_t	KVReader::GetKeyHashByIdx(int n) {
+		const KVReaderPair *pair = GetPair(n);
+		if (pair == NULL) {
+			return 0;
+		}
+		return pair->key_hash;
+	}
+	bool		KVReader::IsKeyByIdx(int n, const char *key) {
+		const KVReaderPair *pair = GetPair(n);
+		if (pair == NULL) {
+			return false;
+		}
+		return (int)strlen(key) == pair->key_len && memcmp(&m_data[pair->key_offset], key, pair->key_len) == 0;
 	}
 	std::pair<std::string, std::string> KVReader::GetPairByIdx(int n) {
-		n = GetIndex(n);
-		if(m_kv_map.size() < (unsigned int)n)
-			return std::pair<std::string, std::string>("", "");
-		std::vector<std::pair<std::string, std::string>>::const_iterator it = m_kv_map.begin();
-		std::advance(it, n);
-
-		return *it;
+		return std::pair<std::string, std::string>(GetKeyByIdx(n), GetValueByIdx(n));
 	}
-	std::string KVReader::GetValue(std::string key) {
-		std::vector<std::pair<std::string, std::string>>::const_iterator it = FindKey(key);
-		if(it == m_kv_map.end()) {
+	std::string KVReader::GetValue(const char *key) {
+		int n = FindKey(key);
+		if (n == -1) {
 			return "";
 		}
-
-		return (*it).second;
+		return GetValueByIdx(n);
 	}
-	int	KVReader::GetValueInt(std::string key) {
-		std::vector<std::pair<std::string, std::string>>::const_iterator it = FindKey(key);
-		if(it == m_kv_map.end()) {
+	int	KVReader::GetValueInt(const char *key) {
+		int n = FindKey(key);
+		if (n == -1) {
 			return 0;
 		}
-
-		return atoi((*it).second.c_str());
+		return GetValueIntByIdx(n);
 	}
 	std::pair<std::vector<std::pair< std::string, std::string> >::const_iterator, std::vector<std::pair< std::string, std::string> >::const_iterator> KVReader::GetHead() const {
-		return std::pair<std::vector<std::pair< std::string, std::string> >::const_iterator, std::vector<std::pair< std::string, std::string> >::const_iterator>(m_kv_map.begin(),m_kv_map.end());
-	}
-	int KVReader::GetIndex(int n) {
-		return n;//abs((int)(n - m_kv_map.size())) - 1;
-	}
-	bool KVReader::HasKey(std::string name) {
-		return FindKey(name) != m_kv_map.cend();
-	}
-	std::vector<std::pair<std::string, std::string>>::const_iterator KVReader::FindKey(std::string key) {
-		std::vector<std::pair<std::string, std::string>>::const_iterator it = m_kv_map.cbegin();
-		while (it != m_kv_map.cend()) {
-			std::pair<std::string, std::string> p = *it;
-			if (p.first.compare(key) == 0) {
-				return it;
+		if (m_kv_map.size() != (size_t)m_num_pairs) {
+			m_kv_map.clear();
+			for (int i = 0; i < m_num_pairs; i++) {
+				const KVReaderPair *pair = GetPair(i);
+				m_kv_map.push_back(std::pair<std::string, std::string>(std::string(&m_data[pair->key_offset], pair->key_len), std::string(&m_data[pair->value_offset], pair->value_len)));
 			}
-			it++;
 		}
-		return m_kv_map.cend();
+		return std::pair<std::vector<std::pair< std::string, std::string> >::const_iterator, std::vector<std::pair< std::string, std::string> >::const_iterator>(m_kv_map.begin(),m_kv_map.end());
 	}
-	std::vector<std::pair<std::string, std::string>>::const_iterator KVReader::FindValue(std::string key) {
-		std::vector<std::pair<std::string, std::string>>::const_iterator it = m_kv_map.cbegin();
-		while (it != m_kv_map.cend()) {
-			std::pair<std::string, std::string> p = *it;
-			if (p.second.compare(key) == 0) {
-				return it;
-			}
-			it++;
-		}
-		return m_kv_map.cend();
+	bool KVReader::HasKey(const char *name) {
+		return FindKey(name) != -1;
 	}
-}
\ No newline at end of file
+}
@@ -5,6 +5,9 @@
 #include <unordered_map>
 #include <vector>
 #include <iterator>
+
+#define KV_READER_INLINE_PAIRS 16 //pairs indexed without allocating, packets with more spill into a vector
+#define KV_READER_MIN_KEY_SLOTS 64 //size of the key table built once a packet spills, a power of two kept under half full
 /*
 	This is not thread safe!!
 
@@ -12,25 +15,68 @@
 		GetHead
 */
 namespace OS {
+	/*
+		FNV-1a, usable as a case label, so a switch on GetKeyHashByIdx is a perfect hash over the commands it handles,
+		two commands which collide fail to compile as duplicate case values.
+		An unknown command can still collide with a handled one, which IsKeyByIdx rules out.
+	*/
+	constexpr uint32_t KVHash(const char *str, uint32_t hash = 2166136261U) {
+		return *str ? KVHash(str + 1, (hash ^ (uint8_t)*str) * 16777619U) : hash;
+	}
+
+	typedef struct {
+		uint32_t key_hash;
+		int key_offset; //into m_data, every token is NUL terminated in place
+		int key_len;
+		int value_offset;
+		int value_len;
+	} KVReaderPair;
+
+	/*
+		Tokenizes a copy of the packet in place, so keys and values are never copied again unless asked for as a std::string.
+		Offsets rather than pointers are kept, so a copied reader, such as one stored in a backend request, stays valid.
+	*/
 	class KVReader {
 	public:
 		KVReader();
 		KVReader(std::string kv_pair, char delim = '\\', char line_delim=0);
+		//a char * and delimiters without a len would bind here with the delimiter as the len, those go through std::string(data)
+		KVReader(const char *data, int len, char delim = '\\', char line_delim = 0);
 		~KVReader();
 		std::string GetKeyByIdx(int n);
 		std::string GetValueByIdx(int n);
 		int 		GetValueIntByIdx(int n);
+		uint32_t	GetKeyHashByIdx(int n);
+		bool		IsKeyByIdx(int n, const char *key);
 		std::pair<std::string, std::string> GetPairByIdx(int n);
-		std::string 						GetValue(std::string key);
-		int 								GetValueInt(std::string key);
+		std::string 						GetValue(const char *key);
+		std::string 						GetValue(const std::string &key) { return GetValue(key.c_str()); };
+		int 								GetValueInt(const char *key);
+		int 								GetValueInt(const std::string &key) { return GetValueInt(key.c_str()); };
 		std::pair<std::vector<std::pair< std::string, std::string> >::const_iterator, std::vector<std::pair< std::string, std::string> >::const_iterator> GetHead() const;
-		bool HasKey(std::string name);
-		int	Size() { return m_kv_map.size(); };
+		bool HasKey(const char *name);
+		bool HasKey(const std::string &name) { return HasKey(name.c_str()); };
+		int	Size() { return m_num_pairs; };
+
+		static uint32_t Hash(const char *str, int len);
 	private:
-		int GetIndex(int n); //map internal index to external index
-		std::vector<std::pair<std::string, std::string>>::const_iterator FindKey(std::string key);
-		std::vector<std::pair<std::string, std::string>>::const_iterator FindValue(std::string key);
-		std::vector< std::pair<std::string, std::string> > m_kv_map;
+		void Parse(char delim, char line_delim);
+		void ParseLine(int start, int end, char delim);
+		int FinishToken(int start, int end); //returns the token's length once stripped
+		int FindKey(const char *key);
+		int FindKey(const char *key, int len, uint32_t hash);
+		void InsertKeySlot(int n);
+		void RehashKeys(int num_slots);
+		const KVReaderPair *GetPair(int n) const;
+
+		std::string m_data;
+		KVReaderPair m_inline_pairs[KV_READER_INLINE_PAIRS];
+		std::vector<KVReaderPair> m_extra_pairs;
+		int m_num_pairs;
+		//open addressed on key_hash, pair index + 1 or 0 if free. empty until the inline pairs are full, small packets scan them
+		std::vector<int> m_key_slots;
+
+		mutable std::vector< std::pair<std::string, std::string> > m_kv_map; //only built by GetHead
 	};
 }
-#endif //_OS_KVREADER_H
\ No newline at end of file
+#endif //_OS_KVREADER_H
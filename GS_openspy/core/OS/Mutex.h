@@ -23,6 +23,37 @@ namespace OS {
 					__sync_fetch_and_sub(val, 1);
 				#endif
 			}
+			//returns the value before the add, SafeAdd(val, 0) is a read with a full barrier
+			static uint32_t SafeAdd(uint32_t *val, uint32_t amount) {
+				#ifdef _WIN32
+					return InterlockedExchangeAdd((volatile LONG *)val, amount);
+				#else
+					return __sync_fetch_and_add(val, amount);
+				#endif
+			}
+			static uint64_t SafeAdd64(uint64_t *val, uint64_t amount) {
+				#ifdef _WIN32
+					return InterlockedExchangeAdd64((volatile LONG64 *)val, amount);
+				#else
+					return __sync_fetch_and_add(val, amount);
+				#endif
+			}
+			static bool SafeCompareAndSwap(uint32_t *val, uint32_t expected, uint32_t desired) {
+				#ifdef _WIN32
+					return (uint32_t)InterlockedCompareExchange((volatile LONG *)val, desired, expected) == expected;
+				#else
+					return __sync_bool_compare_and_swap(val, expected, desired);
+				#endif
+			}
+			//stores desired with a full barrier before it, so what it points to is visible first, returns the previous value
+			static void *SafeExchangePointer(void **val, void *desired) {
+				#ifdef _WIN32
+					return InterlockedExchangePointer(val, desired);
+				#else
+					__sync_synchronize();
+					return __sync_lock_test_and_set(val, desired);
+				#endif
+			}
 	};
 }
 #endif //_OS_MUTEX_H
\ No newline at end of file
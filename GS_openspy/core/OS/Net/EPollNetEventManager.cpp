@@ -6,12 +6,16 @@
 	#include "NetPeer.h"
 	#include <algorithm>
 
-	EPollNetEventManager::EPollNetEventManager() {
+	EPollNetEventManager::EPollNetEventManager(int reactor_index) {
 		m_exit_flag = false;
 
 		m_epollfd = epoll_create(MAX_EPOLL_EVENTS);
 
-		m_added_drivers = false;
+		m_reactor_index = reactor_index;
+		m_num_peers = 0;
+		m_num_queued = 0;
+		m_next_id = 0;
+		mp_mutex = OS::CreateMutex();
 	}
 	EPollNetEventManager::~EPollNetEventManager() {
 		m_exit_flag = true;
@@ -21,30 +25,67 @@
 			free((void *)data);
 			it++;
 		}
+		std::vector<EPollDataInfo *>::iterator it2 = m_free_list.begin();
+		while(it2 != m_free_list.end()) {
+			free((void *)*it2);
+			it2++;
+		}
 		close(m_epollfd);
+		delete mp_mutex;
+	}
+	void EPollNetEventManager::SetSiblings(std::vector<EPollNetEventManager *> siblings) {
+		m_siblings = siblings;
 	}
 	void EPollNetEventManager::run() {
-		if(!m_added_drivers) {
-			setupDrivers();
-		}
-		int nr_events = epoll_wait (m_epollfd, (epoll_event *)&m_events, MAX_EPOLL_EVENTS, EPOLL_TIMEOUT);
-		for(int i=0;i<nr_events;i++) {
-			EPollDataInfo *data = (EPollDataInfo *)m_events[i].data.ptr;
-			if(data->is_peer) {
-				INetPeer *peer = (INetPeer *)data->ptr;
-				std::map<void *, EPollDataInfo *>::iterator it = m_datainfo_map.find(peer);
-				if(it != m_datainfo_map.end()) {
-					peer->think(true);
+		freeOrphans();
+
+		//don't sleep in epoll while a sibling has work we could steal
+		int timeout = EPOLL_TIMEOUT;
+		std::vector<EPollNetEventManager *>::iterator s_it = m_siblings.begin();
+		while(s_it != m_siblings.end()) {
+			if(*s_it != this && (*s_it)->hasQueuedWork()) {
+				timeout = 0;
+				break;
+			}
+			s_it++;
+		}
+
+		int nr_events = epoll_wait (m_epollfd, (epoll_event *)&m_events, MAX_EPOLL_EVENTS, timeout);
+		if(nr_events > 0) {
+			mp_mutex->lock();
+			for(int i=0;i<nr_events;i++) {
+				EPollDataInfo *data = (EPollDataInfo *)m_events[i].data.ptr;
+				if(data->is_peer && !data->orphaned) {
+					EPollWorkItem item;
+					item.owner = this;
+					item.peer = (INetPeer *)data->ptr;
+					item.id = data->id;
+					item.events = m_events[i].events;
+					m_run_queue.push_back(item);
+					OS::CMutex::SafeIncr(&m_num_queued);
+				}
+			}
+			mp_mutex->unlock();
+
+			for(int i=0;i<nr_events;i++) {
+				EPollDataInfo *data = (EPollDataInfo *)m_events[i].data.ptr;
+				if(!data->is_peer) {
+					INetDriver *driver = (INetDriver *)data->ptr;
+					driver->think(true);
+					OS::CMutex::SafeAdd64(&m_num_events, 1);
 				}
-			} else {
-				INetDriver *driver = (INetDriver *)data->ptr;
-				driver->think(true);
 			}
 		}
 
+		EPollWorkItem item;
+		int num_dispatched = 0;
+		while(num_dispatched < EPOLL_MAX_DISPATCH_PER_RUN && (popWork(item) || stealWork(item))) {
+			dispatch(item);
+			num_dispatched++;
+		}
 
 		//force TCP accept, incase of high connection load, will not block due to non-blocking sockets
-		if(nr_events == 0) {
+		if(nr_events == 0 && m_reactor_index == 0) {
 			std::vector<INetDriver *>::iterator it = m_net_drivers.begin();
 			while(it != m_net_drivers.end()) {
 				INetDriver *driver = *it;
@@ -53,55 +94,182 @@
 			}
 		}
 	}
+	void EPollNetEventManager::freeOrphans() {
+		mp_mutex->lock();
+		std::vector<EPollDataInfo *>::iterator it = m_free_list.begin();
+		while(it != m_free_list.end()) {
+			EPollDataInfo *data = *it;
+			if(!data->busy) {
+				free((void *)data);
+				it = m_free_list.erase(it);
+				continue;
+			}
+			it++;
+		}
+		mp_mutex->unlock();
+	}
+	//read by siblings without taking mp_mutex, so it's a hint which popWork/stealWork recheck under the lock
+	bool EPollNetEventManager::hasQueuedWork() {
+		return OS::CMutex::SafeAdd(&m_num_queued, 0) != 0;
+	}
+	bool EPollNetEventManager::popWork(EPollWorkItem &item) {
+		bool ret = false;
+		mp_mutex->lock();
+		if(!m_run_queue.empty()) {
+			item = m_run_queue.front();
+			m_run_queue.pop_front();
+			OS::CMutex::SafeDecr(&m_num_queued);
+			ret = true;
+		}
+		mp_mutex->unlock();
+		return ret;
+	}
+	bool EPollNetEventManager::stealWork(EPollWorkItem &item) {
+		std::vector<EPollNetEventManager *>::iterator it = m_siblings.begin();
+		while(it != m_siblings.end()) {
+			EPollNetEventManager *victim = *it;
+			if(victim != this && victim->hasQueuedWork()) {
+				bool stolen = false;
+				victim->mp_mutex->lock();
+				if(!victim->m_run_queue.empty()) {
+					item = victim->m_run_queue.back();
+					victim->m_run_queue.pop_back();
+					OS::CMutex::SafeDecr(&victim->m_num_queued);
+					stolen = true;
+				}
+				victim->mp_mutex->unlock();
+				if(stolen) {
+					OS::CMutex::SafeAdd64(&m_num_stolen, 1);
+					return true;
+				}
+			}
+			it++;
+		}
+		return false;
+	}
+	void EPollNetEventManager::dispatch(EPollWorkItem item) {
+		EPollNetEventManager *owner = item.owner;
+
+		owner->mp_mutex->lock();
+		std::map<void *, EPollDataInfo *>::iterator it = owner->m_datainfo_map.find(item.peer);
+		if(it == owner->m_datainfo_map.end() || it->second->id != item.id) {
+			//unregistered since it was queued
+			owner->mp_mutex->unlock();
+			return;
+		}
+		EPollDataInfo *data = it->second;
+		if(data->busy) {
+			//already thinking on another reactor, it will rerun once finished
+			data->pending_events |= item.events;
+			owner->mp_mutex->unlock();
+			return;
+		}
+		data->busy = true;
+		item.peer->IncRef();
+		owner->mp_mutex->unlock();
+
+		uint32_t events = item.events;
+		bool again;
+		do {
+			bool read_deferred = handleEvents(data, item.peer, events);
+
+			owner->mp_mutex->lock();
+			data->read_deferred = read_deferred;
+			events = data->pending_events;
+			again = events != 0 && !data->orphaned;
+			data->pending_events = 0;
+			if(!again) {
+				data->busy = false;
+			}
+			owner->mp_mutex->unlock();
+		} while(again);
+
+		item.peer->DecRef();
+	}
+	/*
+		Only the reactor thread which marked the peer busy calls this, returns if a read is still being put off
+	*/
+	bool EPollNetEventManager::handleEvents(EPollDataInfo *data, INetPeer *peer, uint32_t events) {
+		bool read_deferred = data->read_deferred;
+		if(events & EPOLLOUT) {
+			peer->FlushSendQueue();
+		}
+		//anything other than EPOLLOUT, including errors and hangups, goes through the peer's read
+		if(events & ~EPOLLOUT) {
+			read_deferred = true;
+		}
+		if(read_deferred && !peer->IsSendBlocked()) {
+			peer->think(true);
+			OS::CMutex::SafeAdd64(&m_num_events, 1);
+			read_deferred = false;
+			if(peer->ShouldDelete()) {
+				//let the driver reap it now rather than at its next scheduled think
+				peer->ScheduleThink(0);
+			}
+		}
+		return read_deferred;
+	}
+	void EPollNetEventManager::addNetworkDriver(INetDriver *driver) {
+		INetEventManager::addNetworkDriver(driver);
+
+		EPollDataInfo *data_info = (EPollDataInfo *)malloc(sizeof(EPollDataInfo));
+		memset(data_info, 0, sizeof(EPollDataInfo));
+
+		data_info->ptr = driver;
+		data_info->is_peer = false;
+
+		struct epoll_event ev;
+		ev.events = EPOLLIN | EPOLLET | EPOLLEXCLUSIVE;
+		ev.data.ptr = data_info;
+
+		mp_mutex->lock();
+		m_datainfo_map[driver] = data_info;
+		mp_mutex->unlock();
+
+		if(epoll_ctl(m_epollfd, EPOLL_CTL_ADD, driver->getListenerSocket(), &ev) != 0) {
+			//kernel without EPOLLEXCLUSIVE, every reactor will be woken for the listener
+			ev.events = EPOLLIN | EPOLLET;
+			epoll_ctl(m_epollfd, EPOLL_CTL_ADD, driver->getListenerSocket(), &ev);
+		}
+	}
 	void EPollNetEventManager::RegisterSocket(INetPeer *peer) {
 		if(peer->GetDriver()->getListenerSocket() != peer->GetSocket()) {
 			EPollDataInfo *data_info = (EPollDataInfo *)malloc(sizeof(EPollDataInfo));
+			memset(data_info, 0, sizeof(EPollDataInfo));
 
 			struct epoll_event ev;
-			ev.events = EPOLLIN | EPOLLET;
+			ev.events = EPOLLIN | EPOLLOUT | EPOLLET; //edge triggered EPOLLOUT only fires once a full socket has room again
 			ev.data.ptr = data_info;
 
 			data_info->ptr = peer;
 			data_info->is_peer = true;
 
+			mp_mutex->lock();
+			data_info->id = ++m_next_id;
 			m_datainfo_map[peer] = data_info;
+			OS::CMutex::SafeIncr(&m_num_peers);
+			mp_mutex->unlock();
 
 			epoll_ctl(m_epollfd, EPOLL_CTL_ADD, peer->GetSocket(), &ev);
 		}
 	}
 	void EPollNetEventManager::UnregisterSocket(INetPeer *peer) {
 		if(peer->GetDriver()->getListenerSocket() != peer->GetSocket()) {
+			mp_mutex->lock();
 			std::map<void *, EPollDataInfo *>::iterator it = m_datainfo_map.find(peer);
 			if(it != m_datainfo_map.end()) {
+				EPollDataInfo *data = it->second;
 				struct epoll_event ev;
 				ev.events = EPOLLIN | EPOLLET;
-				ev.data.ptr = peer;
+				ev.data.ptr = data;
 				epoll_ctl(m_epollfd, EPOLL_CTL_DEL, peer->GetSocket(), &ev);
-				free((void *)m_datainfo_map[peer]);
-				m_datainfo_map.erase(it, m_datainfo_map.end());
+				//events for it may still be in a batch returned by epoll_wait, free on the next run
+				data->orphaned = true;
+				m_free_list.push_back(data);
+				m_datainfo_map.erase(it);
+				OS::CMutex::SafeDecr(&m_num_peers);
 			}
+			mp_mutex->unlock();
 		}
 	}
-
-	void EPollNetEventManager::setupDrivers() {
-		std::vector<INetDriver *>::iterator it = m_net_drivers.begin();
-		while(it != m_net_drivers.end()) {
-			INetDriver *driver = *it;
-
-			EPollDataInfo *data_info = (EPollDataInfo *)malloc(sizeof(EPollDataInfo));
-
-			data_info->ptr = driver;
-			data_info->is_peer = false;
-
-			struct epoll_event ev;
-			ev.events = EPOLLIN | EPOLLET;
-			ev.data.ptr = data_info;
-
-			m_datainfo_map[driver] = data_info;
-
-			epoll_ctl(m_epollfd, EPOLL_CTL_ADD, driver->getListenerSocket(), &ev);
-			it++;
-		}
-		m_added_drivers = true;
-	}
 #endif
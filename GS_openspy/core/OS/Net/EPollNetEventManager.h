@@ -6,30 +6,71 @@
 		#include "NetEventManager.h"
 		#include <vector>
 		#include <map>
+		#include <deque>
 		#define MAX_EPOLL_EVENTS 4096
 		#define EPOLL_TIMEOUT 200
+		#define EPOLL_MAX_DISPATCH_PER_RUN 4096 //return to epoll_wait after this many dispatched peers
+		#ifndef EPOLLEXCLUSIVE
+			#define EPOLLEXCLUSIVE (1u << 28)
+		#endif
 
 		typedef struct {
 			bool is_peer;
 			void *ptr;
+			uint32_t id;
+			bool busy; //peer is currently thinking on some reactor
+			uint32_t pending_events; //readiness events which arrived while busy
+			bool read_deferred; //readable while its send queue was blocked, read once it drains
+			bool orphaned; //unregistered, freed by the reactor once no longer referenced
 		} EPollDataInfo;
+
+		class EPollNetEventManager;
+		typedef struct {
+			EPollNetEventManager *owner;
+			INetPeer *peer;
+			uint32_t id;
+			uint32_t events;
+		} EPollWorkItem;
+
+		/*
+			One reactor per thread, each with its own epoll set and peer set.
+			Listener sockets are shared between reactors with EPOLLEXCLUSIVE so only one is woken per connection.
+			Ready peers go onto the reactor's run queue, idle reactors steal from the back of their siblings' queues.
+			Peers are also watched for EPOLLOUT, which flushes their send queue. Reads from a peer whose send queue is blocked
+			are put off until the flush brings it back under its low watermark.
+		*/
 		class EPollNetEventManager : public INetEventManager {
 		public:
-			EPollNetEventManager();
+			EPollNetEventManager(int reactor_index = 0);
 			~EPollNetEventManager();
 
+			void addNetworkDriver(INetDriver *driver);
 			void RegisterSocket(INetPeer *peer);
 			void UnregisterSocket(INetPeer *peer);
 			void run();
+
+			void SetSiblings(std::vector<EPollNetEventManager *> siblings);
+			int GetNumPeers() { return OS::CMutex::SafeAdd(&m_num_peers, 0); }; //called by INetServer::RegisterSocket from any reactor
 		private:
+			bool popWork(EPollWorkItem &item);
+			bool stealWork(EPollWorkItem &item);
+			bool hasQueuedWork();
+			void dispatch(EPollWorkItem item);
+			bool handleEvents(EPollDataInfo *data, INetPeer *peer, uint32_t events);
+			void freeOrphans();
+
 			int m_epollfd;
+			int m_reactor_index;
+			uint32_t m_num_peers;
+			uint32_t m_num_queued; //m_run_queue's size, so siblings can check it without mp_mutex
+			uint32_t m_next_id;
 			struct epoll_event m_events[MAX_EPOLL_EVENTS];
-			
-			void setupDrivers();
-			
-			bool m_added_drivers;
-			
+
 			std::map<void *, EPollDataInfo *> m_datainfo_map;
+			std::vector<EPollDataInfo *> m_free_list;
+			std::deque<EPollWorkItem> m_run_queue;
+			std::vector<EPollNetEventManager *> m_siblings;
+			OS::CMutex *mp_mutex;
 		};
 	#endif
 #endif //_EPOLLNETEVENTMGR_H
@@ -16,7 +16,10 @@ public:
 	virtual const std::vector<int> getSockets() = 0;
 	INetServer *getServer() { return m_server; }
 	virtual const std::vector<INetPeer *> getPeers(bool inc_ref = false) = 0;
-	virtual OS::MetricInstance GetMetrics() = 0;
+	/*
+		A peer's scheduled think is due, fired from the server's timer wheel
+	*/
+	virtual void OnPeerThink(INetPeer *peer) { };
 protected:
 	INetServer *m_server;
 
@@ -1,7 +1,13 @@
 #include "NetEventManager.h"
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
 INetEventManager::INetEventManager() {
 	m_exit_flag = false;
-
+	m_num_events = 0;
+	m_num_stolen = 0;
+	m_last_metrics_events = 0;
+	gettimeofday(&m_last_metrics_time, NULL);
 }
 INetEventManager::~INetEventManager() {
 	m_exit_flag = true;
@@ -11,4 +17,32 @@ void INetEventManager::addNetworkDriver(INetDriver *driver) {
 }
 void INetEventManager::flagExit() {
 	m_exit_flag = true;
-}
\ No newline at end of file
+}
+OS::MetricValue INetEventManager::GetMetrics() {
+	OS::MetricValue arr_value, value;
+	struct timeval current_time;
+	gettimeofday(&current_time, NULL);
+
+	uint64_t num_events = OS::CMutex::SafeAdd64(&m_num_events, 0);
+	long long elapsed_ms = ((current_time.tv_sec - m_last_metrics_time.tv_sec) * 1000) + ((current_time.tv_usec - m_last_metrics_time.tv_usec) / 1000);
+
+	value.type = OS::MetricType_Integer;
+	value.value._int = num_events;
+	value.key = "events";
+	arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+	value.value._int = OS::CMutex::SafeAdd64(&m_num_stolen, 0);
+	value.key = "stolen";
+	arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+	value.type = OS::MetricType_Float;
+	value.value._float = elapsed_ms > 0 ? (float)((num_events - m_last_metrics_events) * 1000.0 / elapsed_ms) : 0.0f;
+	value.key = "events_per_sec";
+	arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Float, value));
+
+	m_last_metrics_events = num_events;
+	m_last_metrics_time = current_time;
+
+	arr_value.type = OS::MetricType_Array;
+	return arr_value;
+}
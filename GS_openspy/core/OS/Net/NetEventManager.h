@@ -7,13 +7,23 @@ class INetEventManager {
 		INetEventManager();
 		virtual ~INetEventManager();
 		virtual void run() = 0;
-		void addNetworkDriver(INetDriver *driver);
+		virtual void addNetworkDriver(INetDriver *driver);
 		void flagExit();
+		bool ShouldExit() { return m_exit_flag; };
 
 		virtual void RegisterSocket(INetPeer *peer) = 0;
 		virtual void UnregisterSocket(INetPeer *peer) = 0;
+
+		OS::MetricValue GetMetrics();
 	protected:
 		bool m_exit_flag;
 		std::vector<INetDriver *> m_net_drivers;
+
+		//dispatch counters, bumped from every reactor thread and read by the metrics thread, only touched with SafeAdd64
+		uint64_t m_num_events;
+		uint64_t m_num_stolen;
+	private:
+		uint64_t m_last_metrics_events;
+		struct timeval m_last_metrics_time;
 };
-#endif //_NETEVENTMGR_H
\ No newline at end of file
+#endif //_NETEVENTMGR_H
@@ -1,3 +1,56 @@
 #include <OS/OpenSpy.h>
 #include "NetDriver.h"
-#include "NetPeer.h"
\ No newline at end of file
+#include "NetPeer.h"
+#include "NetServer.h"
+#include <OS/Analytics/Instrument.h>
+
+static OS::Gauge g_net_peers("net_peers", "Peers alive across every driver in the process, including ones waiting to be reaped");
+
+INetPeer::INetPeer(INetDriver *driver, struct sockaddr_in *address_info, int sd) : OS::Ref() {
+	mp_driver = driver;
+	m_address_info = *address_info;
+	m_sd = sd;
+	m_connection_slot = -1;
+	OS::TimerWheel::InitEntry(&m_think_timer, INetPeer::OnThinkTimer, this);
+	g_net_peers.Incr();
+}
+INetPeer::~INetPeer() {
+	g_net_peers.Decr();
+	//drivers cancel before dropping their reference, this only matters for peers deleted on shutdown
+	mp_driver->getServer()->GetTimerWheel()->Cancel(&m_think_timer);
+	if (m_sd != mp_driver->getListenerSocket()) {
+		close(m_sd);
+	}
+}
+void INetPeer::ScheduleThink(int delay_ms) {
+	if (delay_ms > NET_PEER_MAX_THINK_DELAY) {
+		delay_ms = NET_PEER_MAX_THINK_DELAY;
+	}
+	//take the reference first, the timer could fire on another thread before Schedule returns
+	IncRef();
+	if (mp_driver->getServer()->GetTimerWheel()->Schedule(&m_think_timer, delay_ms, true)) {
+		DecRef();
+	}
+}
+void INetPeer::CancelThink() {
+	if (mp_driver->getServer()->GetTimerWheel()->Cancel(&m_think_timer)) {
+		DecRef();
+	}
+}
+void INetPeer::OnThinkTimer(void *extra) {
+	INetPeer *peer = (INetPeer *)extra;
+	peer->GetDriver()->OnPeerThink(peer);
+	peer->DecRef();
+}
+int INetPeer::GetDelayUntil(const struct timeval &since, int seconds) {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	long long delay = (since.tv_sec + seconds + 1 - now.tv_sec) * 1000LL - now.tv_usec / 1000;
+	if (delay < 0) {
+		return 0;
+	}
+	if (delay > NET_PEER_MAX_THINK_DELAY) {
+		return NET_PEER_MAX_THINK_DELAY;
+	}
+	return delay;
+}
@@ -3,21 +3,53 @@
 #include <OS/Ref.h>
 #include <OS/Analytics/Metric.h>
 #include "NetDriver.h"
+#include "NetSendQueue.h"
+#include <OS/Timer/TimerWheel.h>
+
+#define NET_PEER_MAX_THINK_DELAY 10000 //longest a peer goes between thinks, bounds how long a peer flagged for deletion outside of think lingers
+
 class INetPeer : public OS::Ref {
 	public:
-		INetPeer(INetDriver *driver, struct sockaddr_in *address_info, int sd) : OS::Ref() { mp_driver = driver; m_address_info = *address_info; m_sd = sd; };
-		virtual ~INetPeer() { if (m_sd != mp_driver->getListenerSocket()) { close(m_sd); } }
+		INetPeer(INetDriver *driver, struct sockaddr_in *address_info, int sd);
+		virtual ~INetPeer();
 
 		virtual void think(bool packet_waiting) = 0;
 		const struct sockaddr_in *getAddress() { return &m_address_info; }
 
 		int GetSocket() { return m_sd; };
-		bool ShouldDelete() { return m_delete_flag; };
+		virtual bool ShouldDelete() { return m_delete_flag; };
 		bool IsTimeout() { return m_timeout_flag; }
 		INetDriver *GetDriver() { return mp_driver; };
 
-		virtual OS::MetricInstance GetMetrics() = 0;
+		/*
+			Never blocks, anything the socket won't take yet is queued and written once it's writable.
+			Returns false if the peer should be dropped.
+		*/
+		bool SendData(const void *data, int len) { return m_send_queue.Send(m_sd, data, len); };
+		//called by the event manager when the socket is writable
+		bool FlushSendQueue() { return m_send_queue.Flush(m_sd); };
+		bool HasPendingSend() { return m_send_queue.HasPending(); };
+		//the client isn't reading fast enough, the event manager stops reading from it until it catches up
+		bool IsSendBlocked() { return m_send_queue.IsBlocked(); };
+		int GetSendQueueSize() { return m_send_queue.GetQueuedBytes(); };
+
+		/*
+			Has the driver's OnPeerThink run in delay_ms, unless it's already due sooner.
+			The peer holds a reference to itself while scheduled.
+		*/
+		void ScheduleThink(int delay_ms);
+		void CancelThink();
+		//milliseconds until think(false) next has something to do, such as a ping, timeout or retry
+		virtual int GetThinkDelay() { return NET_PEER_MAX_THINK_DELAY; };
+
+		//position in the driver's connection list, -1 while not in one
+		int GetConnectionSlot() { return m_connection_slot; };
+		void SetConnectionSlot(int slot) { m_connection_slot = slot; };
+
 	protected:
+		//milliseconds until more than the given seconds have passed since a time, the same test think does on tv_sec
+		static int GetDelayUntil(const struct timeval &since, int seconds);
+
 		int m_sd;
 		INetDriver *mp_driver;
 		struct sockaddr_in m_address_info;
@@ -27,7 +59,13 @@ class INetPeer : public OS::Ref {
 		bool m_timeout_flag;
 
 		OS::CMutex *mp_mutex;
+
+		NetSendQueue m_send_queue;
 	private:
+		static void OnThinkTimer(void *extra);
+
+		OS::TimerWheelEntry m_think_timer;
+		int m_connection_slot;
 
 	};
 #endif
\ No newline at end of file
@@ -0,0 +1,169 @@
+#ifndef _NETPEERINDEX_H
+#define _NETPEERINDEX_H
+#include <OS/OpenSpy.h>
+#include <vector>
+/*
+	Open addressing (linear probing) hash index of peers keyed on ip:port.
+	Not thread safe, the owning driver guards it with its own mutex.
+	Deletion uses backward shifting so lookups never have to skip tombstones.
+*/
+#define NETPEERINDEX_MIN_CAPACITY 64
+template<typename T>
+class NetPeerIndex {
+public:
+	NetPeerIndex(size_t initial_capacity = NETPEERINDEX_MIN_CAPACITY) {
+		m_capacity = NETPEERINDEX_MIN_CAPACITY;
+		while (m_capacity < initial_capacity) {
+			m_capacity <<= 1;
+		}
+		m_size = 0;
+		mp_slots = (Slot *)calloc(m_capacity, sizeof(Slot));
+	}
+	~NetPeerIndex() {
+		free((void *)mp_slots);
+	}
+	T *Find(uint32_t ip, uint16_t port) {
+		uint64_t key = MakeKey(ip, port);
+		size_t mask = m_capacity - 1;
+		size_t idx = Hash(key) & mask;
+		while (mp_slots[idx].value != NULL) {
+			if (mp_slots[idx].key == key) {
+				return mp_slots[idx].value;
+			}
+			idx = (idx + 1) & mask;
+		}
+		return NULL;
+	}
+	T *Find(const struct sockaddr_in *address) {
+		return Find(address->sin_addr.s_addr, address->sin_port);
+	}
+	void Insert(uint32_t ip, uint16_t port, T *value) {
+		if ((m_size + 1) * 4 > m_capacity * 3) {
+			Resize(m_capacity << 1);
+		}
+		if (InsertSlot(MakeKey(ip, port), value)) {
+			m_size++;
+		}
+	}
+	void Insert(const struct sockaddr_in *address, T *value) {
+		Insert(address->sin_addr.s_addr, address->sin_port, value);
+	}
+	/*
+		Only removes the entry if it still points at value, so a stale delete can't drop a newer peer on the same address
+	*/
+	bool Remove(uint32_t ip, uint16_t port, T *value) {
+		uint64_t key = MakeKey(ip, port);
+		size_t mask = m_capacity - 1;
+		size_t idx = Hash(key) & mask;
+		while (mp_slots[idx].value != NULL) {
+			if (mp_slots[idx].key == key) {
+				if (mp_slots[idx].value != value) {
+					return false;
+				}
+				EraseSlot(idx);
+				m_size--;
+				return true;
+			}
+			idx = (idx + 1) & mask;
+		}
+		return false;
+	}
+	bool Remove(const struct sockaddr_in *address, T *value) {
+		return Remove(address->sin_addr.s_addr, address->sin_port, value);
+	}
+	void Clear() {
+		memset(mp_slots, 0, m_capacity * sizeof(Slot));
+		m_size = 0;
+	}
+	size_t GetSize() {
+		return m_size;
+	}
+private:
+	typedef struct {
+		uint64_t key;
+		T *value;
+	} Slot;
+
+	static uint64_t MakeKey(uint32_t ip, uint16_t port) {
+		return ((uint64_t)ip << 16) | port;
+	}
+	static size_t Hash(uint64_t key) {
+		//murmur3 finalizer
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdULL;
+		key ^= key >> 33;
+		key *= 0xc4ceb9fe1a85ec53ULL;
+		key ^= key >> 33;
+		return (size_t)key;
+	}
+	//returns true if a new slot was used, false if an existing key was replaced
+	bool InsertSlot(uint64_t key, T *value) {
+		size_t mask = m_capacity - 1;
+		size_t idx = Hash(key) & mask;
+		while (mp_slots[idx].value != NULL) {
+			if (mp_slots[idx].key == key) {
+				mp_slots[idx].value = value;
+				return false;
+			}
+			idx = (idx + 1) & mask;
+		}
+		mp_slots[idx].key = key;
+		mp_slots[idx].value = value;
+		return true;
+	}
+	void EraseSlot(size_t idx) {
+		size_t mask = m_capacity - 1;
+		size_t next = (idx + 1) & mask;
+		while (mp_slots[next].value != NULL) {
+			size_t home = Hash(mp_slots[next].key) & mask;
+			//move the entry back if its home slot is not within (idx, next]
+			if (((next - home) & mask) >= ((next - idx) & mask)) {
+				mp_slots[idx] = mp_slots[next];
+				idx = next;
+			}
+			next = (next + 1) & mask;
+		}
+		mp_slots[idx].key = 0;
+		mp_slots[idx].value = NULL;
+	}
+	void Resize(size_t new_capacity) {
+		Slot *old_slots = mp_slots;
+		size_t old_capacity = m_capacity;
+		m_capacity = new_capacity;
+		mp_slots = (Slot *)calloc(m_capacity, sizeof(Slot));
+		for (size_t i = 0; i < old_capacity; i++) {
+			if (old_slots[i].value != NULL) {
+				InsertSlot(old_slots[i].key, old_slots[i].value);
+			}
+		}
+		free((void *)old_slots);
+	}
+
+	Slot *mp_slots;
+	size_t m_capacity;
+	size_t m_size;
+};
+
+/*
+	Adds and removes peers from a driver's connection list, keeping each peer's slot up to date so
+	removal moves the last peer into the gap instead of searching. The list's order isn't kept.
+*/
+template<typename T>
+void NetPeerListAdd(std::vector<T *> &list, T *peer) {
+	peer->SetConnectionSlot((int)list.size());
+	list.push_back(peer);
+}
+template<typename T>
+bool NetPeerListRemove(std::vector<T *> &list, T *peer) {
+	int slot = peer->GetConnectionSlot();
+	if (slot < 0 || (size_t)slot >= list.size() || list[slot] != peer) {
+		return false;
+	}
+	T *last = list.back();
+	list[slot] = last;
+	last->SetConnectionSlot(slot);
+	list.pop_back();
+	peer->SetConnectionSlot(-1);
+	return true;
+}
+#endif //_NETPEERINDEX_H
@@ -0,0 +1,210 @@
+#include "NetSendQueue.h"
+#ifndef _WIN32
+#include <sys/uio.h>
+#include <errno.h>
+#endif
+
+uint32_t NetSendQueue::m_total_queued_bytes = 0;
+uint32_t NetSendQueue::m_num_blocked = 0;
+uint32_t NetSendQueue::m_num_stalls = 0;
+uint32_t NetSendQueue::m_num_dropped = 0;
+
+static bool sendWouldBlock() {
+	#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+	#else
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+	#endif
+}
+
+NetSendQueue::NetSendQueue() {
+	m_queued_bytes = 0;
+	m_high_watermark = NET_SEND_DEFAULT_HIGH_WATERMARK;
+	m_low_watermark = NET_SEND_DEFAULT_LOW_WATERMARK;
+	m_blocked = false;
+	m_failed = false;
+	mp_mutex = OS::CreateMutex();
+}
+NetSendQueue::~NetSendQueue() {
+	Consume(m_queued_bytes);
+	if (m_blocked) {
+		OS::CMutex::SafeDecr(&m_num_blocked);
+	}
+	delete mp_mutex;
+}
+bool NetSendQueue::Send(int sd, const void *data, int len) {
+	mp_mutex->lock();
+	if (m_failed) {
+		mp_mutex->unlock();
+		return false;
+	}
+	int sent = 0;
+	if (m_chunks.empty()) {
+		sent = send(sd, (const char *)data, len, MSG_NOSIGNAL);
+		if (sent < 0) {
+			if (!sendWouldBlock()) {
+				Fail(sd);
+				mp_mutex->unlock();
+				return false;
+			}
+			sent = 0;
+		}
+		if (sent < len) {
+			OS::CMutex::SafeIncr(&m_num_stalls);
+		}
+	}
+	if (sent < len) {
+		if (m_queued_bytes + (len - sent) > NET_SEND_MAX_QUEUED_BYTES) {
+			OS::CMutex::SafeIncr(&m_num_dropped);
+			Fail(sd);
+			mp_mutex->unlock();
+			return false;
+		}
+		Append((const char *)data + sent, len - sent);
+		UpdateBlocked();
+	}
+	mp_mutex->unlock();
+	return true;
+}
+bool NetSendQueue::Flush(int sd) {
+	mp_mutex->lock();
+	if (m_failed) {
+		mp_mutex->unlock();
+		return false;
+	}
+	while (!m_chunks.empty()) {
+		int written;
+		#ifdef _WIN32
+		Chunk &chunk = m_chunks.front();
+		written = send(sd, chunk.data + chunk.offset, chunk.len - chunk.offset, MSG_NOSIGNAL);
+		#else
+		struct iovec iov[NET_SEND_MAX_IOV];
+		int num_iov = 0;
+		std::deque<Chunk>::iterator it = m_chunks.begin();
+		while (it != m_chunks.end() && num_iov < NET_SEND_MAX_IOV) {
+			iov[num_iov].iov_base = (*it).data + (*it).offset;
+			iov[num_iov].iov_len = (*it).len - (*it).offset;
+			num_iov++;
+			it++;
+		}
+		written = writev(sd, iov, num_iov);
+		#endif
+		if (written < 0) {
+			if (sendWouldBlock()) {
+				break;
+			}
+			Fail(sd);
+			mp_mutex->unlock();
+			return false;
+		}
+		Consume(written);
+		if (written == 0) {
+			break;
+		}
+	}
+	UpdateBlocked();
+	mp_mutex->unlock();
+	return true;
+}
+void NetSendQueue::Append(const char *data, int len) {
+	//top up the last chunk before starting new ones
+	while (len > 0) {
+		if (m_chunks.empty() || m_chunks.back().len == NET_SEND_CHUNK_SIZE) {
+			Chunk chunk;
+			chunk.data = (char *)malloc(NET_SEND_CHUNK_SIZE);
+			chunk.len = 0;
+			chunk.offset = 0;
+			m_chunks.push_back(chunk);
+		}
+		Chunk &chunk = m_chunks.back();
+		int copy_len = NET_SEND_CHUNK_SIZE - chunk.len;
+		if (copy_len > len) {
+			copy_len = len;
+		}
+		memcpy(chunk.data + chunk.len, data, copy_len);
+		chunk.len += copy_len;
+		data += copy_len;
+		len -= copy_len;
+		m_queued_bytes += copy_len;
+		OS::CMutex::SafeAdd(&m_total_queued_bytes, copy_len);
+	}
+}
+void NetSendQueue::Consume(int len) {
+	while (len > 0 && !m_chunks.empty()) {
+		Chunk &chunk = m_chunks.front();
+		int chunk_len = chunk.len - chunk.offset;
+		if (chunk_len > len) {
+			chunk_len = len;
+		}
+		chunk.offset += chunk_len;
+		len -= chunk_len;
+		m_queued_bytes -= chunk_len;
+		OS::CMutex::SafeAdd(&m_total_queued_bytes, (uint32_t)-chunk_len);
+		if (chunk.offset == chunk.len) {
+			free((void *)chunk.data);
+			m_chunks.pop_front();
+		}
+	}
+}
+void NetSendQueue::UpdateBlocked() {
+	if (!m_blocked && m_queued_bytes > m_high_watermark) {
+		m_blocked = true;
+		OS::CMutex::SafeIncr(&m_num_blocked);
+	}
+	else if (m_blocked && m_queued_bytes < m_low_watermark) {
+		m_blocked = false;
+		OS::CMutex::SafeDecr(&m_num_blocked);
+	}
+}
+void NetSendQueue::Fail(int sd) {
+	m_failed = true;
+	Consume(m_queued_bytes);
+	#ifdef _WIN32
+	shutdown(sd, SD_BOTH);
+	#else
+	shutdown(sd, SHUT_RDWR);
+	#endif
+}
+bool NetSendQueue::HasPending() {
+	mp_mutex->lock();
+	bool ret = !m_chunks.empty();
+	mp_mutex->unlock();
+	return ret;
+}
+int NetSendQueue::GetQueuedBytes() {
+	return m_queued_bytes;
+}
+bool NetSendQueue::IsBlocked() {
+	return m_blocked;
+}
+void NetSendQueue::SetWatermarks(int high, int low) {
+	mp_mutex->lock();
+	m_high_watermark = high;
+	m_low_watermark = low;
+	UpdateBlocked();
+	mp_mutex->unlock();
+}
+OS::MetricValue NetSendQueue::GetMetrics() {
+	OS::MetricValue arr_value, value;
+	value.type = OS::MetricType_Integer;
+
+	value.value._int = OS::CMutex::SafeAdd(&m_total_queued_bytes, 0);
+	value.key = "queued_bytes";
+	arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+	value.value._int = OS::CMutex::SafeAdd(&m_num_blocked, 0);
+	value.key = "blocked_peers";
+	arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+	value.value._int = OS::CMutex::SafeAdd(&m_num_stalls, 0);
+	value.key = "stalls";
+	arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+	value.value._int = OS::CMutex::SafeAdd(&m_num_dropped, 0);
+	value.key = "dropped_peers";
+	arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+	arr_value.key = "send_queue";
+	arr_value.type = OS::MetricType_Array;
+	return arr_value;
+}
@@ -0,0 +1,67 @@
+#ifndef _NETSENDQUEUE_H
+#define _NETSENDQUEUE_H
+#include <OS/OpenSpy.h>
+#include <OS/Analytics/Metric.h>
+#include <deque>
+
+#define NET_SEND_CHUNK_SIZE 16384
+#define NET_SEND_MAX_IOV 64 //chunks handed to each writev
+#define NET_SEND_DEFAULT_HIGH_WATERMARK 262144 //reads from the peer are held back once this much is queued
+#define NET_SEND_DEFAULT_LOW_WATERMARK 65536 //and resume once the queue drains below this
+#define NET_SEND_MAX_QUEUED_BYTES 8388608 //peers which fall this far behind are dropped
+
+/*
+	Outbound data of a TCP peer.
+	While nothing is queued, data is written straight to the socket. Whatever the kernel won't take is copied into a chain of chunks,
+	and written with writev once the event manager sees the socket is writable again, so a slow client never blocks the sending thread.
+
+	A failed socket is shut down, so the peer's next read sees the disconnect and it's cleaned up the usual way.
+*/
+class NetSendQueue {
+public:
+	NetSendQueue();
+	~NetSendQueue();
+
+	/*
+		Returns false if the socket has failed, or the queue has grown past NET_SEND_MAX_QUEUED_BYTES
+	*/
+	bool Send(int sd, const void *data, int len);
+	//writes as much of the queue as the socket will take, returns false if the socket has failed
+	bool Flush(int sd);
+
+	bool HasPending();
+	int GetQueuedBytes();
+	/*
+		Set once the queue passes the high watermark, and cleared once it falls below the low watermark
+	*/
+	bool IsBlocked();
+	void SetWatermarks(int high, int low);
+
+	//totals across every queue
+	static OS::MetricValue GetMetrics();
+private:
+	typedef struct {
+		char *data;
+		int len;
+		int offset; //already written
+	} Chunk;
+
+	void Append(const char *data, int len);
+	void Consume(int len);
+	void UpdateBlocked();
+	void Fail(int sd);
+
+	std::deque<Chunk> m_chunks;
+	int m_queued_bytes;
+	int m_high_watermark;
+	int m_low_watermark;
+	bool m_blocked;
+	bool m_failed;
+	OS::CMutex *mp_mutex;
+
+	static uint32_t m_total_queued_bytes;
+	static uint32_t m_num_blocked;
+	static uint32_t m_num_stalls; //sends which found the socket full
+	static uint32_t m_num_dropped;
+};
+#endif //_NETSENDQUEUE_H
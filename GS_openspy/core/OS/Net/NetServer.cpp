@@ -1,37 +1,176 @@
 #include "NetServer.h"
+#include "NetSendQueue.h"
+#include <OS/Analytics/Instrument.h>
 #if EVTMGR_USE_SELECT
 	#include "SelectNetEventManager.h"
 #elif EVTMGR_USE_EPOLL
 	#include "EPollNetEventManager.h"
 #endif
 
+#define DEFAULT_NUM_REACTORS 1
+#define MAX_NUM_REACTORS 64
 
 INetServer::INetServer() {
+	int num_reactors = 0;
+	if (OS::g_config && OS::g_appName) {
+		configVar *config_struct = OS::g_config->getRootArray(OS::g_appName);
+		if (config_struct) {
+			num_reactors = OS::g_config->getArrayInt(config_struct, "num_reactors");
+		}
+	}
+	if (num_reactors <= 0) {
+		num_reactors = DEFAULT_NUM_REACTORS;
+	}
+	else if (num_reactors > MAX_NUM_REACTORS) {
+		num_reactors = MAX_NUM_REACTORS;
+	}
+
 	#ifdef EVTMGR_USE_SELECT
-	mp_net_event_mgr = new SelectNetEventManager();
+	m_event_managers.push_back(new SelectNetEventManager());
 	#elif EVTMGR_USE_EPOLL
-	mp_net_event_mgr = new EPollNetEventManager();
+	std::vector<EPollNetEventManager *> reactors;
+	for (int i = 0; i < num_reactors; i++) {
+		reactors.push_back(new EPollNetEventManager(i));
+	}
+	std::vector<EPollNetEventManager *>::iterator it = reactors.begin();
+	while (it != reactors.end()) {
+		(*it)->SetSiblings(reactors);
+		m_event_managers.push_back(*it);
+		it++;
+	}
 	#endif
+	mp_net_event_mgr = m_event_managers.front();
+	mp_timer_wheel = new OS::TimerWheel();
+	m_reactors_started = false;
+	m_next_reactor = 0;
+
+	//the reactor totals are counters the reactors already keep, so they are cheap to scrape
+	OS::InstrumentRegistry::getSingleton()->AddCollector("net", this, &INetServer::GetEventManagerMetrics);
 }
 INetServer::~INetServer() {
-	delete mp_net_event_mgr;
+	OS::InstrumentRegistry::getSingleton()->RemoveCollectors(this);
+	flagExit();
+	std::vector<OS::CThread *>::iterator it = m_reactor_threads.begin();
+	while (it != m_reactor_threads.end()) {
+		delete *it;
+		it++;
+	}
+	std::vector<INetEventManager *>::iterator it2 = m_event_managers.begin();
+	while (it2 != m_event_managers.end()) {
+		delete *it2;
+		it2++;
+	}
+	delete mp_timer_wheel;
 }
 void INetServer::addNetworkDriver(INetDriver *driver) {
 	m_net_drivers.push_back(driver);
-	mp_net_event_mgr->addNetworkDriver(driver);
+	std::vector<INetEventManager *>::iterator it = m_event_managers.begin();
+	while (it != m_event_managers.end()) {
+		(*it)->addNetworkDriver(driver);
+		it++;
+	}
 }
 void INetServer::tick() {
 	NetworkTick();
 }
 void INetServer::NetworkTick() {
+	if (!m_reactors_started) {
+		StartReactorThreads();
+	}
 	mp_net_event_mgr->run();
+	mp_timer_wheel->Advance();
+}
+void INetServer::StartReactorThreads() {
+	m_reactors_started = true;
+	std::vector<INetEventManager *>::iterator it = m_event_managers.begin();
+	while (it != m_event_managers.end()) {
+		INetEventManager *mgr = *it;
+		if (mgr != mp_net_event_mgr) {
+			m_reactor_threads.push_back(OS::CreateThread(INetServer::ReactorThread, mgr, true));
+		}
+		it++;
+	}
+}
+void *INetServer::ReactorThread(OS::CThread *thread) {
+	INetEventManager *mgr = (INetEventManager *)thread->getParams();
+	while (!mgr->ShouldExit()) {
+		mgr->run();
+	}
+	return NULL;
 }
 void INetServer::flagExit() {
-	mp_net_event_mgr->flagExit();	
+	std::vector<INetEventManager *>::iterator it = m_event_managers.begin();
+	while (it != m_event_managers.end()) {
+		(*it)->flagExit();
+		it++;
+	}
 }
 void INetServer::RegisterSocket(INetPeer *peer) {
+	#if EVTMGR_USE_EPOLL
+	//place the peer on the reactor with the fewest peers, round robin on ties
+	EPollNetEventManager *best = NULL;
+	int num_reactors = m_event_managers.size();
+	int start = OS::CMutex::SafeAdd(&m_next_reactor, 1) % num_reactors; //RegisterSocket is called from every reactor thread
+	for (int i = 0; i < num_reactors; i++) {
+		EPollNetEventManager *reactor = (EPollNetEventManager *)m_event_managers[(start + i) % num_reactors];
+		if (best == NULL || reactor->GetNumPeers() < best->GetNumPeers()) {
+			best = reactor;
+		}
+	}
+	best->RegisterSocket(peer);
+	#else
 	mp_net_event_mgr->RegisterSocket(peer);
+	#endif
 }
 void INetServer::UnregisterSocket(INetPeer *peer) {
-	mp_net_event_mgr->UnregisterSocket(peer);
-}
\ No newline at end of file
+	//only the owning reactor knows about the peer, the rest ignore it
+	std::vector<INetEventManager *>::iterator it = m_event_managers.begin();
+	while (it != m_event_managers.end()) {
+		(*it)->UnregisterSocket(peer);
+		it++;
+	}
+}
+OS::MetricValue INetServer::GetEventManagerMetrics() {
+	OS::MetricValue reactors, value, reactor_value;
+	long long total_events = 0;
+	float total_events_per_sec = 0.0f;
+	int idx = 0;
+	std::vector<INetEventManager *>::iterator it = m_event_managers.begin();
+	while (it != m_event_managers.end()) {
+		reactor_value = (*it)->GetMetrics();
+
+		std::vector<std::pair<OS::MetricType, struct OS::_Value> >::iterator it2 = reactor_value.arr_value.values.begin();
+		while (it2 != reactor_value.arr_value.values.end()) {
+			if ((*it2).second.key.compare("events") == 0) {
+				total_events += (*it2).second.value._int;
+			}
+			else if ((*it2).second.key.compare("events_per_sec") == 0) {
+				total_events_per_sec += (*it2).second.value._float;
+			}
+			it2++;
+		}
+
+		char key[16];
+		snprintf(key, sizeof(key), "%d", idx++);
+		reactor_value.key = key;
+		reactors.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, reactor_value));
+		it++;
+	}
+
+	value.type = OS::MetricType_Integer;
+	value.value._int = total_events;
+	value.key = "total_events";
+	reactors.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+	value.type = OS::MetricType_Float;
+	value.value._float = total_events_per_sec;
+	value.key = "total_events_per_sec";
+	reactors.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Float, value));
+
+	reactors.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, NetSendQueue::GetMetrics()));
+	reactors.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, mp_timer_wheel->GetMetrics()));
+
+	reactors.type = OS::MetricType_Array;
+	reactors.key = "reactors";
+	return reactors;
+}
@@ -5,6 +5,7 @@
 #include <OS/Analytics/Metric.h>
 #include "NetDriver.h"
 #include "NetEventManager.h"
+#include <OS/Timer/TimerWheel.h>
 class INetServer {
 public:
 	INetServer();
@@ -21,11 +22,24 @@ public:
 	void RegisterSocket(INetPeer *peer);
 	void UnregisterSocket(INetPeer *peer);
 
-	virtual OS::MetricInstance GetMetrics() = 0;
+	//peer and driver timers, advanced by NetworkTick
+	OS::TimerWheel *GetTimerWheel() { return mp_timer_wheel; };
+
 protected:
-	void NetworkTick(); //fires the INetEventMgr
+	void NetworkTick(); //fires the INetEventMgr, reactor 0 runs on the calling thread
+	OS::MetricValue GetEventManagerMetrics();
 //private:
 	INetEventManager *mp_net_event_mgr;
 	std::vector<INetDriver *> m_net_drivers;
+
+	std::vector<INetEventManager *> m_event_managers;
+
+	OS::TimerWheel *mp_timer_wheel;
+private:
+	static void *ReactorThread(OS::CThread *thread);
+	void StartReactorThreads();
+	std::vector<OS::CThread *> m_reactor_threads;
+	bool m_reactors_started;
+	uint32_t m_next_reactor;
 };
-#endif //_IGAMESERVER_H
\ No newline at end of file
+#endif //_IGAMESERVER_H
@@ -19,11 +19,25 @@ void SelectNetEventManager::run() {
 	struct timeval timeout;
 
 	memset(&timeout, 0, sizeof(struct timeval));
-	timeout.tv_sec = SELECT_TIMEOUT;
+	timeout.tv_usec = SELECT_TIMEOUT_MS * 1000;
 
 	int hsock = setup_fdset();
 
-	if (select(hsock, &m_fdset, NULL, NULL, &timeout) < 0) {
+	//only peers with something queued are watched for writes, so this isn't cached
+	fd_set write_fdset;
+	FD_ZERO(&write_fdset);
+	mp_mutex->lock();
+	std::vector<INetPeer *>::iterator w_it = m_peers.begin();
+	while (w_it != m_peers.end()) {
+		INetPeer *peer = *w_it;
+		if (peer->GetSocket() != peer->GetDriver()->getListenerSocket() && peer->HasPendingSend()) {
+			FD_SET(peer->GetSocket(), &write_fdset);
+		}
+		w_it++;
+	}
+	mp_mutex->unlock();
+
+	if (select(hsock, &m_fdset, &write_fdset, NULL, &timeout) < 0) {
 		//return;
 	}
 	if (m_exit_flag) {
@@ -34,8 +48,10 @@ void SelectNetEventManager::run() {
 	std::vector<INetDriver *>::iterator it = m_net_drivers.begin();
 	while (it != m_net_drivers.end()) {
 		INetDriver *driver = *it;
-		if (FD_ISSET(driver->getListenerSocket(), &m_fdset))
+		if (FD_ISSET(driver->getListenerSocket(), &m_fdset)) {
 			driver->think(true);
+			OS::CMutex::SafeAdd64(&m_num_events, 1);
+		}
 		it++;
 	}
 
@@ -43,8 +59,19 @@ void SelectNetEventManager::run() {
 	while (it2 != m_peers.end()) {
 		INetPeer *peer = *it2;
 		int sd = peer->GetSocket();
-		if (sd != peer->GetDriver()->getListenerSocket() && FD_ISSET(sd, &m_fdset))
-			peer->think(true);
+		if (sd != peer->GetDriver()->getListenerSocket()) {
+			if (FD_ISSET(sd, &write_fdset)) {
+				peer->FlushSendQueue();
+			}
+			//select keeps reporting the socket as readable, so a blocked peer is simply read once it catches up
+			if (FD_ISSET(sd, &m_fdset) && !peer->IsSendBlocked()) {
+				peer->think(true);
+				OS::CMutex::SafeAdd64(&m_num_events, 1);
+				if (peer->ShouldDelete()) {
+					peer->ScheduleThink(0);
+				}
+			}
+		}
 		it2++;
 	}
 	mp_mutex->unlock();
@@ -5,7 +5,7 @@
 		#include "NetEventManager.h"
 		#include <vector>
 
-		#define SELECT_TIMEOUT 5
+		#define SELECT_TIMEOUT_MS 200 //the server's timers are advanced between selects, so this bounds how late they fire
 
 		class SelectNetEventManager : public INetEventManager {
 		public:
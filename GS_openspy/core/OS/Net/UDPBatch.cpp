@@ -0,0 +1,151 @@
+#include "UDPBatch.h"
+#include <OS/Analytics/Instrument.h>
+#include <errno.h>
+
+static OS::Counter g_udp_datagrams_in("udp_datagrams_in", "Datagrams read by every UDP driver");
+static OS::Counter g_udp_datagrams_out("udp_datagrams_out", "Datagrams sent by every UDP driver");
+static OS::Counter g_udp_recv_calls("udp_syscalls", "recv and send calls made by every UDP driver", OS::Instrument::MakeLabel("call", "recv"));
+static OS::Counter g_udp_send_calls("udp_syscalls", "recv and send calls made by every UDP driver", OS::Instrument::MakeLabel("call", "send"));
+
+//the batch the calling thread is draining, if any. a reactor thread only drains one socket at a time
+static INSTRUMENT_THREAD_LOCAL UDPBatch *tl_current_batch = NULL;
+
+UDPBatch::UDPBatch(int sd, int datagram_size) {
+	m_sd = sd;
+	m_datagram_size = datagram_size;
+	m_in_batch = false;
+	m_num_queued = 0;
+
+	mp_recv_buffers = (char *)malloc((m_datagram_size + 1) * UDP_BATCH_SIZE);
+	mp_send_buffers = (char *)malloc(m_datagram_size * UDP_BATCH_SIZE);
+
+	for (int i = 0; i < UDP_BATCH_SIZE; i++) {
+		memset(&m_recv_datagrams[i], 0, sizeof(UDPDatagram));
+		m_recv_datagrams[i].buffer = mp_recv_buffers + ((m_datagram_size + 1) * i);
+
+		memset(&m_send_datagrams[i], 0, sizeof(UDPDatagram));
+		m_send_datagrams[i].buffer = mp_send_buffers + (m_datagram_size * i);
+
+		#if UDPBATCH_USE_MMSG
+		m_recv_iovecs[i].iov_base = m_recv_datagrams[i].buffer;
+		m_recv_iovecs[i].iov_len = m_datagram_size;
+		memset(&m_recv_msgs[i], 0, sizeof(struct mmsghdr));
+		m_recv_msgs[i].msg_hdr.msg_iov = &m_recv_iovecs[i];
+		m_recv_msgs[i].msg_hdr.msg_iovlen = 1;
+		m_recv_msgs[i].msg_hdr.msg_name = &m_recv_datagrams[i].address;
+
+		m_send_iovecs[i].iov_base = m_send_datagrams[i].buffer;
+		memset(&m_send_msgs[i], 0, sizeof(struct mmsghdr));
+		m_send_msgs[i].msg_hdr.msg_iov = &m_send_iovecs[i];
+		m_send_msgs[i].msg_hdr.msg_iovlen = 1;
+		m_send_msgs[i].msg_hdr.msg_name = &m_send_datagrams[i].address;
+		m_send_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+		#endif
+	}
+}
+UDPBatch::~UDPBatch() {
+	free((void *)mp_recv_buffers);
+	free((void *)mp_send_buffers);
+}
+int UDPBatch::Receive() {
+	int count = 0;
+	#if UDPBATCH_USE_MMSG
+	for (int i = 0; i < UDP_BATCH_SIZE; i++) {
+		m_recv_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+		m_recv_msgs[i].msg_hdr.msg_flags = 0;
+	}
+	count = recvmmsg(m_sd, (struct mmsghdr *)&m_recv_msgs, UDP_BATCH_SIZE, MSG_DONTWAIT, NULL);
+	g_udp_recv_calls.Add();
+	if (count < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			return 0;
+		}
+		return -1;
+	}
+	for (int i = 0; i < count; i++) {
+		m_recv_datagrams[i].len = m_recv_msgs[i].msg_len;
+		m_recv_datagrams[i].buffer[m_recv_datagrams[i].len] = 0;
+	}
+	#else
+	while (count < UDP_BATCH_SIZE) {
+		UDPDatagram *datagram = &m_recv_datagrams[count];
+		socklen_t slen = sizeof(struct sockaddr_in);
+		int len = recvfrom(m_sd, datagram->buffer, m_datagram_size, 0, (struct sockaddr *)&datagram->address, &slen);
+		g_udp_recv_calls.Add();
+		if (len < 0) {
+			break;
+		}
+		datagram->len = len;
+		datagram->buffer[len] = 0;
+		count++;
+	}
+	#endif
+	g_udp_datagrams_in.Add(count);
+	return count;
+}
+void UDPBatch::BeginBatch() {
+	m_in_batch = true;
+	tl_current_batch = this;
+}
+void UDPBatch::EndBatch() {
+	Flush();
+	m_in_batch = false;
+	tl_current_batch = NULL;
+}
+int UDPBatch::SendFromThread(int sd, const struct sockaddr_in *address, const void *data, int len) {
+	UDPBatch *batch = tl_current_batch;
+	if (batch && batch->m_sd == sd) {
+		return batch->Send(address, data, len);
+	}
+	g_udp_datagrams_out.Add();
+	g_udp_send_calls.Add();
+	return sendto(sd, (const char *)data, len, 0, (struct sockaddr *)address, sizeof(struct sockaddr_in));
+}
+int UDPBatch::Send(const struct sockaddr_in *address, const void *data, int len) {
+	if (!m_in_batch || len > m_datagram_size) {
+		g_udp_datagrams_out.Add();
+		g_udp_send_calls.Add();
+		return sendto(m_sd, (const char *)data, len, 0, (struct sockaddr *)address, sizeof(struct sockaddr_in));
+	}
+	if (m_num_queued == UDP_BATCH_SIZE) {
+		Flush();
+	}
+	UDPDatagram *datagram = &m_send_datagrams[m_num_queued++];
+	datagram->address = *address;
+	datagram->len = len;
+	memcpy(datagram->buffer, data, len);
+	return len;
+}
+int UDPBatch::Flush() {
+	int sent = 0;
+	int send_calls = 0;
+	#if UDPBATCH_USE_MMSG
+	for (int i = 0; i < m_num_queued; i++) {
+		m_send_iovecs[i].iov_len = m_send_datagrams[i].len;
+	}
+	while (sent < m_num_queued) {
+		send_calls++;
+		int c = sendmmsg(m_sd, &m_send_msgs[sent], m_num_queued - sent, 0);
+		if (c <= 0) {
+			if (c < 0 && errno == EINTR) {
+				continue;
+			}
+			//socket buffer full, the rest is dropped just as a failed sendto would be
+			break;
+		}
+		sent += c;
+	}
+	#else
+	for (int i = 0; i < m_num_queued; i++) {
+		send_calls++;
+		UDPDatagram *datagram = &m_send_datagrams[i];
+		if (sendto(m_sd, datagram->buffer, datagram->len, 0, (struct sockaddr *)&datagram->address, sizeof(struct sockaddr_in)) >= 0) {
+			sent++;
+		}
+	}
+	#endif
+	g_udp_datagrams_out.Add(sent);
+	g_udp_send_calls.Add(send_calls);
+	m_num_queued = 0;
+	return sent;
+}
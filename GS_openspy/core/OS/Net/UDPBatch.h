@@ -0,0 +1,68 @@
+#ifndef _UDPBATCH_H
+#define _UDPBATCH_H
+#include <OS/OpenSpy.h>
+#include <OS/Analytics/Metric.h>
+#if defined(__linux__)
+	#define UDPBATCH_USE_MMSG 1
+#endif
+
+#define UDP_BATCH_SIZE 64
+#define UDP_BATCH_DATAGRAM_SIZE 1500
+
+typedef struct {
+	struct sockaddr_in address;
+	char *buffer;
+	int len;
+} UDPDatagram;
+
+/*
+	Drains a UDP socket with recvmmsg into a preallocated ring of buffers, and coalesces
+	replies into sendmmsg calls. Each buffer has one spare byte so packets can be NUL terminated in place.
+
+	Not thread safe, each reactor thread draining a socket uses its own batch.
+	Sends made outside of a batch go out immediately.
+*/
+class UDPBatch {
+public:
+	UDPBatch(int sd, int datagram_size = UDP_BATCH_DATAGRAM_SIZE);
+	~UDPBatch();
+
+	/*
+		Reads up to UDP_BATCH_SIZE datagrams, returns how many were read (0 when the socket is drained), or -1 on error
+	*/
+	int Receive();
+	UDPDatagram *GetDatagram(int idx) { return &m_recv_datagrams[idx]; };
+
+	void BeginBatch();
+	void EndBatch();
+	bool InBatch() { return m_in_batch; };
+
+	int Send(const struct sockaddr_in *address, const void *data, int len);
+	int Flush();
+
+	/*
+		Queues on the batch the calling thread is draining sd with, so replies made while handling a packet are coalesced.
+		Any other thread, such as a timer or backend task, sends immediately.
+	*/
+	static int SendFromThread(int sd, const struct sockaddr_in *address, const void *data, int len);
+private:
+	int m_sd;
+	int m_datagram_size;
+	bool m_in_batch;
+
+	char *mp_recv_buffers;
+	UDPDatagram m_recv_datagrams[UDP_BATCH_SIZE];
+
+	char *mp_send_buffers;
+	UDPDatagram m_send_datagrams[UDP_BATCH_SIZE];
+	int m_num_queued;
+
+	#if UDPBATCH_USE_MMSG
+	struct mmsghdr m_recv_msgs[UDP_BATCH_SIZE];
+	struct iovec m_recv_iovecs[UDP_BATCH_SIZE];
+	struct mmsghdr m_send_msgs[UDP_BATCH_SIZE];
+	struct iovec m_send_iovecs[UDP_BATCH_SIZE];
+	#endif
+
+};
+#endif //_UDPBATCH_H
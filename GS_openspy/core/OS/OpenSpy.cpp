@@ -18,6 +18,10 @@
 #include <OS/Auth.h>
 #include <OS/Search/User.h>
 #include <OS/Search/Profile.h>
+#include <OS/Search/ProfileCache.h>
+#include <OS/GameCatalog.h>
+#include <OS/HTTP.h>
+#include <OS/Analytics/MetricsEndpoint.h>
 
 namespace OS {
 	Logger *g_logger = NULL;
@@ -43,6 +47,9 @@ namespace OS {
 
 		const char *apikey = OS::g_config->getArrayString(config_struct, "webservices_apikey");
 
+		const char *metrics_address = OS::g_config->getArrayString(config_struct, "metrics_address");
+		int metrics_port = OS::g_config->getArrayInt(config_struct, "metrics_port");
+
 		g_appName = appName;
 		g_hostName = hostname;
 		g_webServicesURL = webservices_url;
@@ -50,6 +57,7 @@ namespace OS {
 		g_webServicesAPIKey = apikey;
 
 		curl_global_init(CURL_GLOBAL_SSL);
+		OS::SetupHTTPEngine();
 
 		redis_timeout.tv_usec = 0;
 		redis_timeout.tv_sec = 30;
@@ -63,16 +71,26 @@ namespace OS {
 		#endif
 
 		mp_redis_internal_connection_mutex = OS::CreateMutex();
+		OS::SetupProfileCache();
+		OS::SetupGameCatalog();
 		OS::SetupAuthTaskPool(num_async);
 		OS::SetupUserSearchTaskPool(num_async);
 		OS::SetupProfileTaskPool(num_async);
+
+		if (metrics_port > 0) {
+			OS::SetupMetricsEndpoint(metrics_address, metrics_port);
+		}
 		
 		OS::LogText(OS::ELogLevel_Info, "%s Init (num async: %d, hostname: %s, redis addr: %s, webservices: %s)\n", appName, num_async, hostname, redis_address, webservices_url);
 	}
 	void Shutdown() {
+		OS::ShutdownMetricsEndpoint();
 		OS::ShutdownAuthTaskPool();
 		OS::ShutdownUserSearchTaskPool();
 		OS::ShutdownProfileTaskPool();
+		OS::ShutdownHTTPEngine();
+		OS::ShutdownProfileCache();
+		OS::ShutdownGameCatalog();
 
 		Redis::Disconnect(redis_internal_connection);
 
@@ -196,6 +214,10 @@ namespace OS {
 		ret.gameid = 0;
 		ret.gamename[0] = 0;
 		ret.secretkey[0] = 0;
+		if (g_game_catalog && g_game_catalog->IsLoaded()) {
+			g_game_catalog->LookupGameByName(from_gamename, ret);
+			return ret;
+		}
 		bool must_unlock = false;
 		if(redis_ctx == NULL) {
 			must_unlock = true;
@@ -234,6 +256,13 @@ namespace OS {
 		Redis::Value v, arr;
 
 		OS::GameData ret;
+		ret.gameid = 0;
+		ret.gamename[0] = 0;
+		ret.secretkey[0] = 0;
+		if (g_game_catalog && g_game_catalog->IsLoaded()) {
+			g_game_catalog->LookupGameByID(gameid, ret);
+			return ret;
+		}
 		bool must_unlock = false;
 		if (redis_ctx == NULL) {
 			must_unlock = true;
@@ -549,6 +578,10 @@ namespace OS {
 		va_end(args);
 	}
 
+	std::string GetWebServicesURL(const char *path) {
+		std::string url = g_webServicesURL ? g_webServicesURL : OPENSPY_WEBSERVICES_URL;
+		return url + path;
+	}
 	std::string FindBestMatch(std::vector<std::string> matches, std::string name) {
 		std::vector<std::string>::iterator it = matches.begin();
 		int best_score = 0, match_result;
@@ -55,7 +55,7 @@ int gettimeofday(struct timeval *tp, struct timezone *tzp);
 #include <OS/Logger.h>
 #include <OS/config.h>
 
-#define OPENSPY_WEBSERVICES_URL "http://os-auth.us-east-1.elasticbeanstalk.com"
+#define OPENSPY_WEBSERVICES_URL "http://os-auth.us-east-1.elasticbeanstalk.com" //used when webservices_url isn't set
 
 class Config;
 namespace OS {
@@ -115,6 +115,7 @@ namespace OS {
 		std::map<std::string, uint8_t> push_keys; //SB push keys + type(hostname/KEYTYPE_STRING)
 	} GameData;
 
+	//answered from the game catalog once it has loaded, redis_ctx is only used before then
 	GameData GetGameByName(const char *from_gamename, Redis::Connection *redis_ctx = NULL);
 	GameData GetGameByID(int gameid, Redis::Connection *redis_ctx = NULL);
 	enum ERedisDB {
@@ -171,6 +172,9 @@ namespace OS {
 
 	std::string FindBestMatch(std::vector<std::string> matches, std::string name);
 
+	//the webservices_url config value, or OPENSPY_WEBSERVICES_URL, followed by path
+	std::string GetWebServicesURL(const char *path);
+
 	bool wouldBlock();
 
 }
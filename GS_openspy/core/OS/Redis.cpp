@@ -16,11 +16,16 @@ typedef int socklen_t;
 #endif
 #include <stdarg.h>
 #include "Redis.h"
+#include "RedisParser.h"
 
 #include <OS/OpenSpy.h>
+#include <OS/Analytics/Instrument.h>
 #define REDIS_BUFFSZ 1000000
 #define RECONNECT_SLEEP_TIME 2000
 namespace Redis {
+	//one sample per round trip, a pipelined flush counts once however many commands it carries
+	OS::LatencyHistogram g_redis_command_span("redis_command", "Redis round trips, from sending the commands to reading the last reply");
+
 	uint32_t resolv(const char *host) {
 		struct  hostent *hp;
 		uint32_t    host_ip;
@@ -49,8 +54,7 @@ namespace Redis {
 
 	Connection *Connect(const char *constr, struct timeval tv) {
 
-		Connection *ret = (Connection *)malloc(sizeof(Connection));
-		memset(ret, 0, sizeof(Connection));
+		Connection *ret = new Connection();
 		char address[64];
 		uint16_t port;
 		get_server_address_port(constr, address, port);
@@ -61,6 +65,10 @@ namespace Redis {
 
 		ret->read_buff_alloc_sz = REDIS_BUFFSZ;
 		ret->read_buff = (char *)malloc(REDIS_BUFFSZ);
+		ret->read_buff_len = 0;
+		ret->read_buff_pos = 0;
+		ret->parser = new ReplyParser();
+		ret->write_mutex = OS::CreateMutex();
 
 		performAddressConnect(ret, address, port);
 
@@ -72,6 +80,10 @@ namespace Redis {
 		get_server_address_port(connection->connect_address.c_str(), address, port);
 
 		close(connection->sd);
+		//partial replies from the old socket are useless now
+		connection->read_buff_len = 0;
+		connection->read_buff_pos = 0;
+		connection->parser->Reset();
 		OS::Sleep(RECONNECT_SLEEP_TIME);
 		performAddressConnect(connection, address, port);
 		connection->reconnect_recursion_depth = 0;
@@ -97,258 +109,272 @@ namespace Redis {
 			performAddressConnect(connection, address, port);
 		}
 	}
-	std::string read_line(std::string str) {
-		std::string r;
-		for (int i = 0; i < str.length(); i++) {
-			if (str[i] == '\r' && i + 1 < str.length()) {
-				if (str[i + 1] == '\n') {
-					return r;
-				}
+	void parse_response(std::string resp_str, int &diff, Redis::Response *resp, Redis::ArrayValue *arr_val) {
+		ReplyParser parser;
+		const char *buff = resp_str.c_str();
+		int len = resp_str.length();
+		while (parser.GetEnd() < len && parser.Parse(buff, len) == 1) {
+			Redis::Value v;
+			ToValue(parser.GetReply(), v);
+			if (arr_val) {
+				arr_val->values.push_back(std::pair<Redis::REDIS_RESPONSE_TYPE, struct Redis::_Value>(v.type, v));
+			}
+			else {
+				resp->values.push_back(v);
 			}
-			r += str[i];
+			parser.Next();
 		}
-
-		return r;
+		diff += parser.GetStart();
 	}
-	Redis::ArrayValue read_array(std::string str, int &diff, Redis::Response *resp, Redis::ArrayValue *arr_val) {
-		Redis::ArrayValue arr;
-		std::string len_line = Redis::read_line(str).substr(1);
-		int num_elements = atoi(len_line.c_str());
-		diff += len_line.length() + ENDLINE_STR_COUNT + 1; // +1 for the operator
-		if (diff > str.length()) {
-			diff = str.length();
-		}
-		str = str.substr(diff);
-		for (int i = 0; i < num_elements; i++) {
-			int tdiff = 0;
-			parse_response(str, tdiff, resp, &arr);
-			str = str.substr(tdiff);
-			diff += tdiff;
+	/*
+		Reads the next reply, releasing the previous one. Data belonging to later replies stays in read_buff.
+		Returns 1 with the reply in out, or <= 0 on error
+	*/
+	int ReadReply(Connection *conn, ReplyValue **out) {
+		ReplyParser *parser = conn->parser;
+		if (parser->HasReply()) {
+			parser->Next();
+			conn->read_buff_pos = parser->GetStart();
+			if (conn->read_buff_pos == conn->read_buff_len) {
+				conn->read_buff_pos = 0;
+				conn->read_buff_len = 0;
+				parser->Reset();
+			}
 		}
-		return arr;
-	}
-	Redis::Value read_scalar(std::string str, int &diff, Redis::Response *resp, Redis::ArrayValue *arr_val) {
-		Redis::Value v;
-		std::string info_line = Redis::read_line(str);
-		int str_len = 0;
-		int line_len = ENDLINE_STR_COUNT + info_line.length();
-		//printf("Info Line: %s\n", info_line.c_str());
-		diff += line_len;
-
-		std::string info = str.substr(line_len);
-		std::string data_str;
-		switch (info_line[0]) {
-		case '$': //bulk str
-			str_len = atoi(info_line.substr(1).c_str());
-			if (str_len == -1) {
-				v.type = Redis::REDIS_RESPONSE_TYPE_NULL;
+		while (true) {
+			int r = parser->Parse(conn->read_buff, conn->read_buff_len);
+			if (r > 0) {
+				*out = parser->GetReply();
+				return 1;
 			}
-			else {
-				v.type = Redis::REDIS_RESPONSE_TYPE_STRING;
-				data_str = info.substr(0, str_len);
-				diff += str_len + ENDLINE_STR_COUNT;
-				v.value._str = data_str;
+			if (r < 0) {
+				OS::LogText(OS::ELogLevel_Critical, "redis protocol error");
+				return -1;
 			}
-			break;
-		case '+': //simple str
-			v.type = Redis::REDIS_RESPONSE_TYPE_STRING;
-			data_str = info_line.substr(1);
-			//diff += info_line.length() + ENDLINE_STR_COUNT;
-			v.value._str = data_str;
-			break;
-		case ':': //int
-			v.type = Redis::REDIS_RESPONSE_TYPE_INTEGER;
-			info = info_line.substr(1);
-			v.value._int = atoi(info.c_str());
-			break;
-		case '-': //error
-			v.type = Redis::REDIS_RESPONSE_TYPE_ERROR;
-			data_str = info_line.substr(1);
-			//diff += info_line.length() + ENDLINE_STR_COUNT;
-			v.value._str = data_str;
-			break;
-		default:
-			break;
 
-		}
-
-		return v;
-	}
-	void parse_response(std::string resp_str, int &diff, Redis::Response *resp, Redis::ArrayValue *arr_val) {
-		std::string str = resp_str;
-		Redis::ArrayValue av;
-		Redis::Value v;
-		int real_diff = diff;
-		diff = 0;
-		do {
-			if (str.length() == 0) break;
-			switch (str[0]) {
-			case '*':
-				av = read_array(str, diff, resp, arr_val);
-				v.arr_value = av;
-				v.type = Redis::REDIS_RESPONSE_TYPE_ARRAY;
-				break;
-			default:
-				v = read_scalar(str, diff, resp, arr_val);
-				break;
+			//reply incomplete, move the partial data to the front and read more
+			if (conn->read_buff_pos > 0) {
+				memmove(conn->read_buff, conn->read_buff + conn->read_buff_pos, conn->read_buff_len - conn->read_buff_pos);
+				conn->read_buff_len -= conn->read_buff_pos;
+				parser->Rebase(conn->read_buff_pos);
+				conn->read_buff_pos = 0;
 			}
-			if (arr_val) {
-				arr_val->values.push_back(std::pair<Redis::REDIS_RESPONSE_TYPE, struct Redis::_Value>(v.type, v));
+			if (conn->read_buff_len + 1 >= conn->read_buff_alloc_sz) {
+				conn->read_buff_alloc_sz *= 2;
+				conn->read_buff = (char *)realloc(conn->read_buff, conn->read_buff_alloc_sz);
 			}
-			else {
-				resp->values.push_back(v);
+			int len = recv(conn->sd, &conn->read_buff[conn->read_buff_len], conn->read_buff_alloc_sz - conn->read_buff_len - 1, 0);
+			if (len <= 0) {
+				return len;
 			}
-			if (diff > str.length()) {
-				break;
+			conn->read_buff_len += len;
+		}
+	}
+	/*
+		Reads count replies into resp
+	*/
+	int ReadReplies(Connection *conn, int count, Response *resp) {
+		ReplyValue *reply;
+		int num_read = 0;
+		while (num_read < count) {
+			int r = ReadReply(conn, &reply);
+			if (r <= 0) {
+				return r;
 			}
-			str = str.substr(diff);
-			real_diff += diff;
-			diff = 0;
-
-		} while (str.length());
-		diff = real_diff;
-
+			resp->values.push_back(Redis::Value());
+			ToValue(reply, resp->values.back());
+			num_read++;
+		}
+		return num_read;
 	}
-	int Recv(Connection *conn) {
-		enum EReadState {
-			READ_STATE_READ_OPERATOR,
-			READ_STATE_READ_TO_NEWLINE,
-		};
-		struct {
-			bool has_read_operator;
-			int num_read_lines;
-
-			bool recv_loop;
-
-			EReadState state;
-			char last_operator;
+	bool SendAll(Connection *conn, const char *buff, int len) {
+		while (len > 0) {
+			int r = send(conn->sd, buff, len, 0);
+			if (r <= 0) {
+				return false;
+			}
+			buff += r;
+			len -= r;
+		}
+		return true;
+	}
+	void append_command(Connection *conn, FlushCallback callback, void *extra, const char *fmt, va_list args) {
+		va_list args_copy;
+		va_copy(args_copy, args);
+		int len = vsnprintf(NULL, 0, fmt, args_copy);
+		va_end(args_copy);
+		if (len < 0) {
+			return;
+		}
+		size_t offset = conn->write_buff.length();
+		conn->write_buff.resize(offset + len + 1);
+		vsnprintf(&conn->write_buff[offset], len + 1, fmt, args);
+		conn->write_buff.resize(offset + len);
+		conn->write_buff += "\r\n";
 
-			int read_array_count_start_idx;
-			int read_string_length;
-			int read_string_start;
-		} sReadLineData;
+		PendingCommand cmd;
+		cmd.callback = callback;
+		cmd.extra = extra;
+		conn->pending_commands.push_back(cmd);
+	}
+	void AppendCommand(Connection *conn, const char *fmt, ...) {
+		va_list args;
+		va_start(args, fmt);
+		append_command(conn, NULL, NULL, fmt, args);
+		va_end(args);
+	}
+	void AppendCommandOnFlush(Connection *conn, FlushCallback callback, void *extra, const char *fmt, ...) {
+		va_list args;
+		va_start(args, fmt);
+		append_command(conn, callback, extra, fmt, args);
+		va_end(args);
+	}
+	int GetNumPendingCommands(Connection *conn) {
+		return conn->pending_commands.size();
+	}
+	Response Flush(Connection *conn, time_t sleepMS) {
+		Response resp;
+		int count = conn->pending_commands.size();
+		if (count == 0) {
+			return resp;
+		}
 
-		sReadLineData.has_read_operator = false;
-		sReadLineData.num_read_lines = 1;
-		sReadLineData.state = READ_STATE_READ_OPERATOR;
-		sReadLineData.recv_loop = true;
-		int total_len = 0, len;
-		while(sReadLineData.recv_loop) {
-			len = recv(conn->sd, &conn->read_buff[total_len], conn->read_buff_alloc_sz-total_len, 0); //TODO: check if exeeds max len.. currently set to 1 MB so shouldn't...
-			if (len <= 0) { return len; }
-			while (len--) {
-				switch (sReadLineData.state) {
-				case READ_STATE_READ_OPERATOR:
-					sReadLineData.read_string_start = 0;
-					sReadLineData.state = READ_STATE_READ_TO_NEWLINE;
-					sReadLineData.last_operator = conn->read_buff[total_len];
-					switch (conn->read_buff[total_len]) {
-					case '$':
-						sReadLineData.num_read_lines++; //read string content
-														//intentional fall-through
-					case '*':
-						sReadLineData.read_array_count_start_idx = total_len;
-					}
+		bool success = false;
+		uint64_t start = OS::GetMonotonicTimeUS();
+		while (true) {
+			if (SendAll(conn, conn->write_buff.c_str(), conn->write_buff.length())) {
+				if (sleepMS != 0)
+					OS::Sleep(sleepMS);
+				int len = ReadReplies(conn, count, &resp);
+				if (len == count) {
+					success = true;
 					break;
-				case READ_STATE_READ_TO_NEWLINE:
-					if (conn->read_buff[total_len] == '\n') {
-						if (sReadLineData.read_string_start == 0 || total_len - sReadLineData.read_string_start >= sReadLineData.read_string_length) {
-							sReadLineData.state = READ_STATE_READ_OPERATOR;
-							switch (sReadLineData.last_operator) {
-							case '$':
-								if (atoi(&conn->read_buff[sReadLineData.read_array_count_start_idx + 1]) == -1) {
-									sReadLineData.num_read_lines--;
-								}
-								else {
-									sReadLineData.read_string_start = total_len;
-									sReadLineData.read_string_length = atoi(&conn->read_buff[sReadLineData.read_array_count_start_idx + 1]);
-									sReadLineData.state = READ_STATE_READ_TO_NEWLINE;
-									sReadLineData.last_operator = 0;
-								}
-								break;
-							case '*':
-								sReadLineData.num_read_lines += atoi(&conn->read_buff[sReadLineData.read_array_count_start_idx + 1]);
-								break;
-							}
-							sReadLineData.num_read_lines--;
-						}
-					}
 				}
-				total_len++;
+				OS::LogText(OS::ELogLevel_Critical, "redis recv error: %d", len);
+			}
+			resp.values.clear();
+			Reconnect(conn);
+			if (conn->command_recursion_depth++ >= REDIS_MAX_RECONNECT_RECURSION_DEPTH) {
+				break;
 			}
-			sReadLineData.recv_loop = sReadLineData.num_read_lines > 0;
 		}
-		conn->read_buff[total_len] = 0;
-		return total_len;
+		g_redis_command_span.Record(OS::GetMonotonicTimeUS() - start);
+		conn->command_recursion_depth = 0;
+
+		std::vector<PendingCommand> pending_commands;
+		pending_commands.swap(conn->pending_commands);
+		conn->write_buff.clear();
+
+		Redis::Value error;
+		error.type = Redis::REDIS_RESPONSE_TYPE_ERROR;
+		error.value._str = "connection error";
+		for (int i = 0; i < count; i++) {
+			if (pending_commands[i].callback) {
+				pending_commands[i].callback(conn, success ? resp.values[i] : error, pending_commands[i].extra);
+			}
+		}
+		return resp;
 	}
 	Response Command(Connection *conn, time_t sleepMS, const char *fmt, ...) {
 		Response resp;
 		va_list args;
 		va_start(args, fmt);
+		append_command(conn, NULL, NULL, fmt, args);
+		va_end(args);
 
-		vsprintf(conn->read_buff, fmt, args);
+		//anything already queued is flushed along with it, only this command's reply is returned
+		size_t count = conn->pending_commands.size();
+		Response all = Flush(conn, sleepMS);
+		if (all.values.size() == count) {
+			resp.values.push_back(all.values.back());
+		}
+		return resp;
+	}
+	const ReplyValue *CommandReply(Connection *conn, const char *fmt, ...) {
+		if (!conn->pending_commands.empty()) {
+			Flush(conn);
+		}
 
-		std::string cmd = conn->read_buff + std::string("\r\n");
-		send(conn->sd, cmd.c_str(), cmd.length(), 0);
+		va_list args;
+		va_start(args, fmt);
+		append_command(conn, NULL, NULL, fmt, args);
 		va_end(args);
 
-		if (sleepMS != 0)
-			OS::Sleep(sleepMS);
-		int len = Recv(conn);
-		if (len <= 0) {
-			OS::LogText(OS::ELogLevel_Critical, "redis recv error: %d", len);
-			Reconnect(conn);
-			if (conn->command_recursion_depth < REDIS_MAX_RECONNECT_RECURSION_DEPTH) {
-				conn->command_recursion_depth++;
-				resp = Command(conn, sleepMS, "%s", cmd.c_str());
-				conn->command_recursion_depth = 0;
-				return resp;
+		ReplyValue *reply = NULL;
+		OS::Span span(&g_redis_command_span);
+		while (true) {
+			if (SendAll(conn, conn->write_buff.c_str(), conn->write_buff.length())) {
+				int len = ReadReply(conn, &reply);
+				if (len == 1) {
+					break;
+				}
+				reply = NULL;
+				OS::LogText(OS::ELogLevel_Critical, "redis recv error: %d", len);
 			}
-			else {
-				conn->command_recursion_depth = 0;
+			Reconnect(conn);
+			if (conn->command_recursion_depth++ >= REDIS_MAX_RECONNECT_RECURSION_DEPTH) {
+				break;
 			}
-			return resp;
-		}
-		else {
-			conn->command_recursion_depth = 0;
 		}
-
-		int diff = 0;
-		parse_response(conn->read_buff, diff, &resp, NULL);
-		return resp;
+		conn->command_recursion_depth = 0;
+		conn->pending_commands.clear();
+		conn->write_buff.clear();
+		return reply;
 	}
 	void LoopingCommand(Connection *conn, time_t sleepMS, void(*mpFunc)(Connection *, Response, void *), void *extra, const char *fmt, ...) {
-		//TODO: handle sleep/big msgs
-		int diff = 0;
 		Response resp;
 		va_list args;
 		va_start(args, fmt);
-
-		vsprintf(conn->read_buff, fmt, args);
-
-		std::string cmd = conn->read_buff + std::string("\r\n");
-		send(conn->sd, cmd.c_str(), cmd.length(), 0);
+		std::string cmd;
+		cmd.resize(vsnprintf(NULL, 0, fmt, args));
 		va_end(args);
+		va_start(args, fmt);
+		vsnprintf(&cmd[0], cmd.length() + 1, fmt, args);
+		va_end(args);
+		cmd += "\r\n";
+
+		SendAll(conn, cmd.c_str(), cmd.length());
 
 		if (sleepMS != 0) {
 			OS::Sleep(sleepMS);
 		}
 
 		while (true) {
-			if (Recv(conn) <= 0) {
+			//one callback per message, even when several arrive in the same read
+			if (ReadReplies(conn, 1, &resp) <= 0) {
 				OS::Sleep(5000); //Sleep even longer due to async... more likely to be in a CPU consuming loop
+				conn->write_mutex->lock();
 				Reconnect(conn);
+				SendAll(conn, cmd.c_str(), cmd.length());
+				conn->write_mutex->unlock();
+				resp.values.clear();
 				continue;
 			}
-			parse_response(conn->read_buff, diff, &resp, NULL);
 			mpFunc(conn, resp, extra);
-			diff = 0;
 			resp.values.clear();
 		}
 	}
+	bool SendCommand(Connection *conn, const char *fmt, ...) {
+		va_list args;
+		va_start(args, fmt);
+		std::string cmd;
+		cmd.resize(vsnprintf(NULL, 0, fmt, args));
+		va_end(args);
+		va_start(args, fmt);
+		vsnprintf(&cmd[0], cmd.length() + 1, fmt, args);
+		va_end(args);
+		cmd += "\r\n";
+
+		conn->write_mutex->lock();
+		bool ret = SendAll(conn, cmd.c_str(), cmd.length());
+		conn->write_mutex->unlock();
+		return ret;
+	}
 	void Disconnect(Connection *connection) {
 
 		free(connection->read_buff);
+		delete connection->parser;
+		delete connection->write_mutex;
 		close(connection->sd);
 	}
 	bool CheckError(Response r) {
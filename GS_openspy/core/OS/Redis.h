@@ -7,6 +7,9 @@
 
 #define REDIS_MAX_RECONNECT_RECURSION_DEPTH 5
 
+namespace OS {
+	class CMutex;
+}
 namespace Redis {
 
 	enum REDIS_RESPONSE_TYPE {
@@ -34,14 +37,44 @@ namespace Redis {
 		REDIS_RESPONSE_TYPE type;
 	} Value;
 
+	/*
+		Reply node allocated from the parser's arena, strings point into the connection's read buffer and are not NUL terminated
+	*/
+	typedef struct _ReplyValue {
+		REDIS_RESPONSE_TYPE type;
+		int len; //string length, or number of elements
+		int offset; //string position relative to the start of the reply, used while parsing
+		int _int;
+		const char *str;
+		struct _ReplyValue *elements;
+	} ReplyValue;
+
+	class ReplyParser;
+
+	typedef struct _Connection Connection;
+
+	//called by Flush on the flushing thread before it returns, value is an error reply if the connection failed
+	typedef void (*FlushCallback)(Connection *conn, Value value, void *extra);
+
 	typedef struct {
+		FlushCallback callback;
+		void *extra;
+	} PendingCommand;
+
+	struct _Connection {
 		int sd;
 		char *read_buff;
 		int read_buff_alloc_sz;
+		int read_buff_len; //bytes received into read_buff
+		int read_buff_pos; //start of the first reply not yet handed out
+		ReplyParser *parser;
+		std::string write_buff; //pipelined commands waiting to be flushed
+		std::vector<PendingCommand> pending_commands; //one per command in write_buff
 		int command_recursion_depth;
 		int reconnect_recursion_depth;
 		std::string connect_address;
-	} Connection;
+		OS::CMutex *write_mutex; //held by SendCommand, and by LoopingCommand while it reconnects
+	};
 
 	typedef struct {
 		std::vector<struct _Value> values; //vector because can be multiple command responses
@@ -53,7 +86,32 @@ namespace Redis {
 
 	Connection *Connect(const char *hostname, struct timeval tv);
 	Response Command(Connection *conn, time_t sleepMS, const char *fmt, ...);
+
+	/*
+		Pipelining: commands are queued locally and sent with a single write on Flush,
+		which then reads every reply back in order.
+		Flush returns one value per queued command (or no values if the connection failed).
+
+		AppendCommandOnFlush is still batched-synchronous, there's no event loop driving completions:
+		the callback runs inside the blocking Flush, after every reply has been read, in the order the commands were queued.
+		It only saves the caller from matching replies to commands by index.
+	*/
+	void AppendCommand(Connection *conn, const char *fmt, ...);
+	void AppendCommandOnFlush(Connection *conn, FlushCallback callback, void *extra, const char *fmt, ...);
+	Response Flush(Connection *conn, time_t sleepMS = 0);
+	int GetNumPendingCommands(Connection *conn);
+
+	/*
+		Like Command, but returns the reply without copying it into a Value tree.
+		The reply is only valid until the next command on this connection, NULL if the connection failed
+	*/
+	const ReplyValue *CommandReply(Connection *conn, const char *fmt, ...);
 	void LoopingCommand(Connection *conn, time_t sleepMS, void(*mpFunc)(Connection *, Response, void *), void *extra, const char *fmt, ...); //for SUBSCRIBE/DEBUGGER, etc
+	/*
+		Sends a command to a connection another thread is running a LoopingCommand on, without waiting for the reply, which goes to the loop's callback.
+		Used to change a subscriber's channels. Anything sent is lost if the loop reconnects, the original command is the only one it resends.
+	*/
+	bool SendCommand(Connection *conn, const char *fmt, ...);
 	void Disconnect(Connection *connection);
 	void parse_response(std::string resp_str, int &diff, Redis::Response *resp, Redis::ArrayValue *arr_val);
 	bool CheckError(Response r);
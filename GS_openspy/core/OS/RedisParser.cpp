@@ -0,0 +1,208 @@
+#include <stdlib.h>
+#include <string.h>
+#include "RedisParser.h"
+
+namespace Redis {
+	ReplyArena::ReplyArena() {
+		m_chunk_idx = 0;
+		m_chunk_used = 0;
+		m_chunks.push_back((char *)malloc(REDIS_ARENA_CHUNK_SIZE));
+		m_chunk_sizes.push_back(REDIS_ARENA_CHUNK_SIZE);
+	}
+	ReplyArena::~ReplyArena() {
+		std::vector<char *>::iterator it = m_chunks.begin();
+		while (it != m_chunks.end()) {
+			free((void *)*it);
+			it++;
+		}
+	}
+	void *ReplyArena::Alloc(int size) {
+		size = (size + 7) & ~7;
+		if (m_chunk_used + size > m_chunk_sizes[m_chunk_idx]) {
+			int chunk_size = size > REDIS_ARENA_CHUNK_SIZE ? size : REDIS_ARENA_CHUNK_SIZE;
+			m_chunks.push_back((char *)malloc(chunk_size));
+			m_chunk_sizes.push_back(chunk_size);
+			m_chunk_idx = m_chunks.size() - 1;
+			m_chunk_used = 0;
+		}
+		void *ret = m_chunks[m_chunk_idx] + m_chunk_used;
+		m_chunk_used += size;
+		return ret;
+	}
+	void ReplyArena::Reset() {
+		//don't hang on to the memory of an occasional huge reply
+		for (size_t i = 1; i < m_chunks.size(); i++) {
+			free((void *)m_chunks[i]);
+		}
+		m_chunks.resize(1);
+		m_chunk_sizes.resize(1);
+		m_chunk_idx = 0;
+		m_chunk_used = 0;
+	}
+
+	ReplyParser::ReplyParser() {
+		mp_root = NULL;
+		m_start = 0;
+		m_pos = 0;
+		Reset();
+	}
+	ReplyParser::~ReplyParser() {
+
+	}
+	int ReplyParser::Parse(const char *buff, int len) {
+		if (m_complete) {
+			return 1;
+		}
+		while (true) {
+			ReplyValue *target;
+			if (m_depth == 0) {
+				if (mp_root == NULL) {
+					mp_root = (ReplyValue *)m_arena.Alloc(sizeof(ReplyValue));
+				}
+				target = mp_root;
+			}
+			else {
+				Frame *frame = &m_stack[m_depth - 1];
+				target = &frame->arr->elements[frame->next];
+			}
+
+			//find the end of the header line
+			const char *p = buff + m_pos, *end = buff + len;
+			const char *line_end = NULL;
+			while (p < end) {
+				p = (const char *)memchr(p, '\r', end - p);
+				if (p == NULL || p + 1 >= end) {
+					break;
+				}
+				if (p[1] == '\n') {
+					line_end = p;
+					break;
+				}
+				p++;
+			}
+			if (line_end == NULL) {
+				return 0;
+			}
+
+			const char *line = buff + m_pos;
+			int line_len = line_end - line;
+			int used = line_len + ENDLINE_STR_COUNT;
+			int count;
+			memset(target, 0, sizeof(ReplyValue));
+			switch (line[0]) {
+			case '+': //simple str
+			case '-': //error
+				target->type = line[0] == '+' ? Redis::REDIS_RESPONSE_TYPE_STRING : Redis::REDIS_RESPONSE_TYPE_ERROR;
+				target->offset = m_pos + 1 - m_start;
+				target->len = line_len - 1;
+				break;
+			case ':': //int
+				target->type = Redis::REDIS_RESPONSE_TYPE_INTEGER;
+				target->_int = atoi(line + 1);
+				break;
+			case '$': //bulk str
+				count = atoi(line + 1);
+				if (count < 0) {
+					target->type = Redis::REDIS_RESPONSE_TYPE_NULL;
+					break;
+				}
+				//only consume the header once the whole string is here
+				if (m_pos + used + count + ENDLINE_STR_COUNT > len) {
+					return 0;
+				}
+				target->type = Redis::REDIS_RESPONSE_TYPE_STRING;
+				target->offset = m_pos + used - m_start;
+				target->len = count;
+				used += count + ENDLINE_STR_COUNT;
+				break;
+			case '*':
+				count = atoi(line + 1);
+				target->type = Redis::REDIS_RESPONSE_TYPE_ARRAY;
+				if (count > 0) {
+					if (m_depth == REDIS_PARSER_MAX_DEPTH) {
+						return -1;
+					}
+					target->len = count;
+					target->elements = (ReplyValue *)m_arena.Alloc(sizeof(ReplyValue) * count);
+					m_pos += used;
+					m_stack[m_depth].arr = target;
+					m_stack[m_depth].next = 0;
+					m_depth++;
+					continue;
+				}
+				break;
+			default:
+				return -1;
+			}
+			m_pos += used;
+
+			//element finished, pop every array it completed
+			while (m_depth > 0) {
+				Frame *frame = &m_stack[m_depth - 1];
+				if (++frame->next < frame->arr->len) {
+					break;
+				}
+				m_depth--;
+			}
+			if (m_depth == 0) {
+				Fixup(mp_root, buff + m_start);
+				m_complete = true;
+				return 1;
+			}
+		}
+	}
+	void ReplyParser::Fixup(ReplyValue *value, const char *base) {
+		switch (value->type) {
+		case Redis::REDIS_RESPONSE_TYPE_STRING:
+		case Redis::REDIS_RESPONSE_TYPE_ERROR:
+			value->str = base + value->offset;
+			break;
+		case Redis::REDIS_RESPONSE_TYPE_ARRAY:
+			for (int i = 0; i < value->len; i++) {
+				Fixup(&value->elements[i], base);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	void ReplyParser::Next() {
+		m_start = m_pos;
+		m_depth = 0;
+		m_complete = false;
+		mp_root = NULL;
+		m_arena.Reset();
+	}
+	void ReplyParser::Rebase(int shift) {
+		m_start -= shift;
+		m_pos -= shift;
+	}
+	void ReplyParser::Reset() {
+		m_pos = 0;
+		Next();
+	}
+
+	void ToValue(const ReplyValue *in, Value &out) {
+		out.type = in->type;
+		switch (in->type) {
+		case Redis::REDIS_RESPONSE_TYPE_STRING:
+		case Redis::REDIS_RESPONSE_TYPE_ERROR:
+			out.value._str.assign(in->str, in->len);
+			break;
+		case Redis::REDIS_RESPONSE_TYPE_INTEGER:
+			out.value._int = in->_int;
+			break;
+		case Redis::REDIS_RESPONSE_TYPE_ARRAY:
+			out.arr_value.values.reserve(in->len);
+			for (int i = 0; i < in->len; i++) {
+				out.arr_value.values.push_back(std::pair<Redis::REDIS_RESPONSE_TYPE, struct Redis::_Value>());
+				std::pair<Redis::REDIS_RESPONSE_TYPE, struct Redis::_Value> &child = out.arr_value.values.back();
+				ToValue(&in->elements[i], child.second);
+				child.first = child.second.type;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
@@ -0,0 +1,73 @@
+#ifndef _OS_REDISPARSER_H
+#define _OS_REDISPARSER_H
+#include "Redis.h"
+
+#define REDIS_ARENA_CHUNK_SIZE 65536
+#define REDIS_PARSER_MAX_DEPTH 32
+
+namespace Redis {
+	/*
+		Bump allocator for the ReplyValue nodes of a single reply.
+		Chunks never move, so nodes stay valid until Reset.
+	*/
+	class ReplyArena {
+	public:
+		ReplyArena();
+		~ReplyArena();
+		void *Alloc(int size);
+		//keeps the first chunk around for the next reply
+		void Reset();
+	private:
+		std::vector<char *> m_chunks;
+		std::vector<int> m_chunk_sizes;
+		int m_chunk_idx;
+		int m_chunk_used;
+	};
+
+	/*
+		Streaming RESP2 parser working on Connection::read_buff in place.
+		Parse can be called again after more data arrives, it continues from the last complete element
+		instead of starting over. String values are slices of the read buffer, so a reply
+		is only valid until the buffer is next modified.
+	*/
+	class ReplyParser {
+	public:
+		ReplyParser();
+		~ReplyParser();
+
+		/*
+			Continues parsing buff from the current position up to len.
+			Returns 1 once a complete reply is available from GetReply, 0 if more data is needed, or -1 on a malformed reply
+		*/
+		int Parse(const char *buff, int len);
+		bool HasReply() { return m_complete; };
+		ReplyValue *GetReply() { return mp_root; };
+		int GetStart() { return m_start; };
+		int GetEnd() { return m_pos; };
+
+		//drops the completed reply, the next one starts where it ended
+		void Next();
+		//the unparsed data was moved shift bytes towards the start of the buffer
+		void Rebase(int shift);
+		void Reset();
+	private:
+		typedef struct {
+			ReplyValue *arr;
+			int next;
+		} Frame;
+
+		void Fixup(ReplyValue *value, const char *base);
+
+		ReplyArena m_arena;
+		ReplyValue *mp_root;
+		Frame m_stack[REDIS_PARSER_MAX_DEPTH];
+		int m_depth;
+		int m_start;
+		int m_pos;
+		bool m_complete;
+	};
+
+	//copies a reply into the Value tree used by Command/Flush
+	void ToValue(const ReplyValue *in, Value &out);
+}
+#endif //_OS_REDISPARSER_H
@@ -1,31 +1,40 @@
 #include <OS/OpenSpy.h>
 #include <OS/Search/Profile.h>
+#include <OS/Search/ProfileCache.h>
 
-#include <curl/curl.h>
+#include <OS/HTTP.h>
 #include <jansson.h>
 
 #include <ctype.h>
 
 namespace OS {
 	OS::TaskPool<ProfileSearchTask, ProfileSearchRequest> *m_profile_search_task_pool = NULL;
-	struct curl_data {
-		std::string buffer;
-	};
-	/* callback for curl fetch */
-	size_t ProfileSearchTask::curl_callback(void *contents, size_t size, size_t nmemb, void *userp) {
-		if (!contents) {
-			return 0;
-		}
-		size_t realsize = size * nmemb;                             /* calculate buffer size */
-		curl_data *data = (curl_data *)userp;
-		data->buffer += (const char *)contents;
-		return realsize;
-	}
+	typedef struct {
+		ProfileSearchRequest request;
+		uint32_t cache_epoch;
+	} ProfileSearchContext;
 	void ProfileSearchTask::PerformSearch(ProfileSearchRequest request) {
-		curl_data recv_data;
-		recv_data.buffer = "";
-		std::vector<OS::Profile> results;
-		std::map<int, OS::User> users_map;
+		std::vector<OS::Profile> cached_results;
+		std::map<int, OS::User> cached_users;
+		if (g_profile_cache->LookupSearch(request, cached_results, cached_users)) {
+			request.callback(EProfileResponseType_Success, cached_results, cached_users, request.extra, request.peer);
+			return;
+		}
+
+		switch (request.type) {
+		case EProfileSearch_CreateProfile:
+		case EProfileSearch_UpdateProfile:
+		case EProfileSearch_DeleteProfile:
+			g_profile_cache->InvalidateProfile(request.profile_search_details, request.user_search_details.id, false);
+			break;
+		default:
+			break;
+		}
+
+		ProfileSearchContext *context = new ProfileSearchContext;
+		context->request = request;
+		context->cache_epoch = g_profile_cache->GetEpoch();
+
 		//build json object
 		json_t *send_obj = json_object();
 
@@ -167,57 +176,82 @@ namespace OS {
 
 		char *json_data = json_dumps(send_obj, 0);
 
-		CURL *curl = curl_easy_init();
-		CURLcode res;
+		//the task thread drops its reference as soon as this returns
+		if (request.peer) {
+			request.peer->IncRef();
+		}
+
+		OS::HTTPClient client(OPENSPY_PROFILEMGR_URL, "OSGPBackendRedisTask");
+		client.PostAsync(json_data ? json_data : "", OnSearchResponse, context, request.peer);
+
+		if (json_data) {
+			free((void *)json_data);
+		}
+		if (send_obj)
+			json_decref(send_obj);
+	}
+	void ProfileSearchTask::OnSearchResponse(HTTPResponse response, void *extra) {
+		ProfileSearchContext *context = (ProfileSearchContext *)extra;
+		ProfileSearchRequest *request = &context->request;
+		std::vector<OS::Profile> results;
+		std::map<int, OS::User> users_map;
 		EProfileResponseType error = EProfileResponseType_GenericError;
-		if (curl) {
-
-			ProfileReq_InitCurl(curl, json_data, (void *)&recv_data);
-			res = curl_easy_perform(curl);
-			if (res == CURLE_OK) {
-				json_t *json_data = NULL;
-				
-				json_data = json_loads(recv_data.buffer.c_str(), 0, NULL);
-
-				if (json_data) {
-					error = EProfileResponseType_Success;
-					json_t *profiles_obj = json_object_get(json_data, "profiles");
-					if (profiles_obj) {
-						int num_profiles = json_array_size(profiles_obj);
-						for (int i = 0; i < num_profiles; i++) {
-							json_t *profile_obj = json_array_get(profiles_obj, i);
-							OS::Profile profile = OS::LoadProfileFromJson(profile_obj);
-							if (users_map.find(profile.userid) == users_map.end()) {
-								json_t *user_obj = json_object_get(profile_obj, "user");
-								users_map[profile.userid] = OS::LoadUserFromJson(user_obj);
-							}
-							results.push_back(profile);
-						}
-					}
-					else {
-						//check for single profile
-						profiles_obj = json_object_get(json_data, "profile");
-						if (profiles_obj) {
-							OS::Profile profile = OS::LoadProfileFromJson(profiles_obj);
-							results.push_back(profile);
+		bool cacheable = false;
+
+		if (response.status_code != 0) {
+			json_t *json_data = json_loads(response.buffer.c_str(), 0, NULL);
+
+			if (json_data) {
+				error = EProfileResponseType_Success;
+				cacheable = response.status_code == 200 && json_object_get(json_data, "error") == NULL;
+				json_t *profiles_obj = json_object_get(json_data, "profiles");
+				if (profiles_obj) {
+					int num_profiles = json_array_size(profiles_obj);
+					for (int i = 0; i < num_profiles; i++) {
+						json_t *profile_obj = json_array_get(profiles_obj, i);
+						OS::Profile profile = OS::LoadProfileFromJson(profile_obj);
+						if (users_map.find(profile.userid) == users_map.end()) {
+							json_t *user_obj = json_object_get(profile_obj, "user");
+							users_map[profile.userid] = OS::LoadUserFromJson(user_obj);
 						}
+						results.push_back(profile);
 					}
-					json_decref(json_data);
 				}
 				else {
-					error = EProfileResponseType_GenericError;
+					//check for single profile
+					profiles_obj = json_object_get(json_data, "profile");
+					if (profiles_obj) {
+						OS::Profile profile = OS::LoadProfileFromJson(profiles_obj);
+						results.push_back(profile);
+					}
 				}
+				json_decref(json_data);
 			}
 		}
 
-		if (json_data) {
-			free((void *)json_data);
+		switch (request->type) {
+		case EProfileSearch_CreateProfile:
+		case EProfileSearch_UpdateProfile:
+		case EProfileSearch_DeleteProfile:
+			//again once it's done, so lookups sent while it was in progress aren't cached
+			if (results.size()) {
+				g_profile_cache->InvalidateProfile(results.front(), request->user_search_details.id, false);
+			}
+			g_profile_cache->InvalidateProfile(request->profile_search_details, request->user_search_details.id, request->type == EProfileSearch_DeleteProfile && cacheable);
+			break;
+		default:
+			if (cacheable) {
+				g_profile_cache->AddSearchResults(*request, context->cache_epoch, results, users_map);
+			}
+			break;
 		}
-		if (send_obj)
-			json_decref(send_obj);
 
+		request->callback(error, results, users_map, request->extra, request->peer);
 
-		request.callback(error, results, users_map, request.extra, request.peer);
+		if (request->peer) {
+			request->peer->DecRef();
+		}
+		delete context;
 	}
 
 	EProfileResponseType ProfileSearchTask::Handle_ProfileWebError(ProfileSearchRequest req, json_t *error_obj) {
@@ -260,20 +294,14 @@ namespace OS {
 	void *ProfileSearchTask::TaskThread(CThread *thread) {
 		ProfileSearchTask *task = (ProfileSearchTask *)thread->getParams();
 		
-		while (!task->m_request_list.empty() || task->mp_thread_poller->wait()) {
-			task->mp_mutex->lock();
-			while (!task->m_request_list.empty()) {
-				ProfileSearchRequest task_params = task->m_request_list.front();
-				task->mp_mutex->unlock();
+		while (task->HasRequests() || task->mp_thread_poller->wait()) {
+			ProfileSearchRequest task_params;
+			while (task->PopRequest(task_params)) {
 				PerformSearch(task_params);
 
 				if (task_params.peer)
 					task_params.peer->DecRef();
-
-				task->mp_mutex->lock();
-				task->m_request_list.pop();
 			}
-			task->mp_mutex->unlock();
 		}
 		return NULL;
 	}
@@ -295,29 +323,4 @@ namespace OS {
 	void ShutdownProfileTaskPool() {
 		delete m_profile_search_task_pool;
 	}
-	void ProfileSearchTask::ProfileReq_InitCurl(void *curl, char *post_data, void *write_data) {
-		struct curl_slist *chunk = NULL;
-		std::string apiKey = "APIKey: " + std::string(OS::g_webServicesAPIKey);
-		chunk = curl_slist_append(chunk, apiKey.c_str());
-		chunk = curl_slist_append(chunk, "Content-Type: application/json");
-		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, chunk);
-
-		curl_easy_setopt(curl, CURLOPT_URL, OPENSPY_PROFILEMGR_URL);
-		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, post_data);
-
-		/* set default user agent */
-		curl_easy_setopt(curl, CURLOPT_USERAGENT, "OSGPBackendRedisTask");
-
-		/* set timeout */
-		curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5);
-
-		/* enable location redirects */
-		curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-
-		/* set maximum allowed redirects */
-		curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 1);
-
-		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_callback);
-		curl_easy_setopt(curl, CURLOPT_WRITEDATA, write_data);
-	}
 }
\ No newline at end of file
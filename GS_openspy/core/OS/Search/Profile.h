@@ -7,17 +7,18 @@
 #include <OS/Profile.h>
 #include <OS/TaskPool.h>
 #include <OS/Net/NetPeer.h>
+#include <OS/HTTP.h>
 #include <string>
 #include <vector>
 #include <map>
 //#define OPENSPY_WEBSERVICES_URL "http://10.10.10.10"
-#define OPENSPY_PROFILEMGR_URL OPENSPY_WEBSERVICES_URL "/backend/userprofile"
+#define OPENSPY_PROFILEMGR_URL OS::GetWebServicesURL("/backend/userprofile")
 #define OPENSPY_PROFILEMGR_KEY "dGhpc2lzdGhla2V5dGhpc2lzdGhla2V5dGhpc2lzdGhla2V5"
 
 namespace OS {
 
 	/*
-		Called within the search task thread
+		Called on the HTTP engine thread, or on the task thread when the request was answered from the profile cache
 	*/
 	enum EProfileResponseType {
 		EProfileResponseType_Success,
@@ -63,8 +64,7 @@ namespace OS {
 			static EProfileResponseType Handle_ProfileWebError(ProfileSearchRequest req, json_t *error_obj);
 			static void PerformSearch(ProfileSearchRequest request);
 			static void *TaskThread(CThread *thread);
-			static size_t curl_callback (void *contents, size_t size, size_t nmemb, void *userp);
-			static void ProfileReq_InitCurl(void *curl, char *post_data, void *write_data);
+			static void OnSearchResponse(HTTPResponse response, void *extra);
 	};
 	extern OS::TaskPool<ProfileSearchTask, ProfileSearchRequest> *m_profile_search_task_pool;
 	OS::TaskPool<ProfileSearchTask, ProfileSearchRequest> *GetProfileTaskPool();
@@ -0,0 +1,683 @@
+#include <OS/OpenSpy.h>
+#include <OS/Search/ProfileCache.h>
+#include <OS/Analytics/Instrument.h>
+#include <OS/KVReader.h>
+#include <limits.h>
+
+namespace OS {
+	ProfileCache *g_profile_cache = NULL;
+	const char *profile_cache_channel = "profile_cache.invalidate";
+	const char *profile_cache_buddies_channel = "presence.buddies"; //published by GP on buddy graph changes
+
+	//on a hit the entry is copied out, expired entries are removed as they're found
+	template<typename K, typename V>
+	static bool FindEntry(std::map<K, V> &entries, const K &key, V &out, time_t now, uint32_t *expirations) {
+		typename std::map<K, V>::iterator it = entries.find(key);
+		if (it == entries.end()) {
+			return false;
+		}
+		if ((*it).second.expire_time <= now) {
+			entries.erase(it);
+			OS::CMutex::SafeIncr(expirations);
+			return false;
+		}
+		out = (*it).second;
+		return true;
+	}
+
+	//when full, expired entries are swept first, and if that isn't enough the entry after the new key makes room
+	template<typename K, typename V>
+	static void InsertEntry(std::map<K, V> &entries, const K &key, V &entry, time_t now, uint32_t *evictions, uint32_t *expirations) {
+		if (entries.size() >= PROFILE_CACHE_MAX_ENTRIES && entries.find(key) == entries.end()) {
+			typename std::map<K, V>::iterator it = entries.begin();
+			while (it != entries.end()) {
+				if ((*it).second.expire_time <= now) {
+					entries.erase(it++);
+					OS::CMutex::SafeIncr(expirations);
+					continue;
+				}
+				it++;
+			}
+			if (entries.size() >= PROFILE_CACHE_MAX_ENTRIES) {
+				it = entries.upper_bound(key);
+				if (it == entries.end()) {
+					it = entries.begin();
+				}
+				entries.erase(it);
+				OS::CMutex::SafeIncr(evictions);
+			}
+		}
+		entries[key] = entry;
+	}
+
+	//removes every entry whose key starts with first, whatever its second half, lowest is the smallest second half there can be
+	template<typename K, typename S, typename V>
+	static void EraseKeyRange(std::map<std::pair<K, S>, V> &entries, const K &first, const S &lowest) {
+		typename std::map<std::pair<K, S>, V>::iterator it = entries.lower_bound(std::pair<K, S>(first, lowest));
+		while (it != entries.end() && (*it).first.first == first) {
+			entries.erase(it++);
+		}
+	}
+	static const ProfileSearchScope lowest_scope(INT_MIN, std::pair<int, int>(INT_MIN, INT_MIN));
+
+	ProfileCache::ProfileCache() {
+		for (int i = 0; i < PROFILE_CACHE_SHARDS; i++) {
+			m_shards[i].mutex = OS::CreateMutex();
+		}
+		for (int i = 0; i < EProfileCacheKind_Count; i++) {
+			m_hits[i] = 0;
+			m_negative_hits[i] = 0;
+			m_misses[i] = 0;
+		}
+		m_epoch = 0;
+		m_evictions = 0;
+		m_expirations = 0;
+
+		struct timeval t;
+		t.tv_usec = 0;
+		t.tv_sec = 60;
+
+		mp_redis_mutex = OS::CreateMutex();
+		mp_redis_connection = Redis::Connect(OS::g_redisAddress, t);
+		mp_redis_subscribe_connection = Redis::Connect(OS::g_redisAddress, t);
+		mp_subscribe_thread = OS::CreateThread(ProfileCache::SubscribeThread, this, true);
+	}
+	ProfileCache::~ProfileCache() {
+		delete mp_subscribe_thread;
+
+		Redis::Disconnect(mp_redis_subscribe_connection);
+		Redis::Disconnect(mp_redis_connection);
+		delete mp_redis_mutex;
+
+		for (int i = 0; i < PROFILE_CACHE_SHARDS; i++) {
+			delete m_shards[i].mutex;
+		}
+	}
+	uint32_t ProfileCache::GetEpoch() {
+		return OS::CMutex::SafeAdd(&m_epoch, 0);
+	}
+	ProfileCacheShard *ProfileCache::GetShard(int key) {
+		return &m_shards[(unsigned int)key % PROFILE_CACHE_SHARDS];
+	}
+	ProfileCacheShard *ProfileCache::GetShard(int key, std::string str) {
+		//FNV-1a
+		uint32_t hash = 2166136261U ^ (uint32_t)key;
+		for (size_t i = 0; i < str.length(); i++) {
+			hash ^= (uint8_t)str[i];
+			hash *= 16777619U;
+		}
+		return &m_shards[hash % PROFILE_CACHE_SHARDS];
+	}
+	EProfileCacheKind ProfileCache::GetSearchKind(ProfileSearchRequest &request) {
+		OS::Profile &profile = request.profile_search_details;
+		OS::User &user = request.user_search_details;
+
+		if (request.type == EProfileSearch_Buddies || request.type == EProfileSearch_Blocks) {
+			return profile.id != 0 ? EProfileCacheKind_List : EProfileCacheKind_Count;
+		}
+		if (request.type != EProfileSearch_Profiles) {
+			return EProfileCacheKind_Count;
+		}
+
+		//anything the web service would also filter on, which isn't part of the scope, makes it a real search
+		if (profile.nick.length() || profile.firstname.length() || profile.lastname.length() || profile.icquin || user.email.length() || request.target_profileids.size() || request.namespaceids.size() > 1) {
+			return EProfileCacheKind_Count;
+		}
+		if (profile.zipcode || profile.sex != -1 || profile.pic || profile.ooc || profile.ind || profile.mar || profile.chc || profile.i1 || profile.birthday.GetYear() != 0 || profile.lon || profile.lat) {
+			return EProfileCacheKind_Count;
+		}
+
+		if (profile.id != 0) {
+			return (profile.uniquenick.length() || user.id != 0) ? EProfileCacheKind_Count : EProfileCacheKind_Profile;
+		}
+		if (profile.uniquenick.length()) {
+			return user.id != 0 ? EProfileCacheKind_Count : EProfileCacheKind_Uniquenick;
+		}
+		if (user.id != 0) {
+			return EProfileCacheKind_UserProfiles;
+		}
+		return EProfileCacheKind_Count;
+	}
+	ProfileSearchScope ProfileCache::GetSearchScope(ProfileSearchRequest &request) {
+		int namespaceid = request.namespaceids.size() ? request.namespaceids.front() : -1;
+		return ProfileSearchScope(namespaceid, std::pair<int, int>(request.profile_search_details.namespaceid, request.user_search_details.partnercode));
+	}
+	bool ProfileCache::ResolveProfiles(std::vector<int> &profileids, std::vector<OS::Profile> &results, std::map<int, OS::User> &users) {
+		time_t now = time(NULL);
+		ProfileCacheEntry profile_entry;
+		UserCacheEntry user_entry;
+		std::vector<int>::iterator it = profileids.begin();
+		while (it != profileids.end()) {
+			ProfileCacheShard *shard = GetShard(*it);
+			shard->mutex->lock();
+			bool found = FindEntry(shard->profiles, *it, profile_entry, now, &m_expirations);
+			shard->mutex->unlock();
+			if (!found || !profile_entry.found) {
+				return false;
+			}
+
+			if (users.find(profile_entry.profile.userid) == users.end()) {
+				shard = GetShard(profile_entry.profile.userid);
+				shard->mutex->lock();
+				found = FindEntry(shard->users, profile_entry.profile.userid, user_entry, now, &m_expirations);
+				shard->mutex->unlock();
+				if (!found) {
+					return false;
+				}
+				users[profile_entry.profile.userid] = user_entry.user;
+			}
+			results.push_back(profile_entry.profile);
+			it++;
+		}
+		return true;
+	}
+	void ProfileCache::RecordLookup(EProfileCacheKind kind, bool hit, bool negative) {
+		if (!hit) {
+			OS::CMutex::SafeIncr(&m_misses[kind]);
+		}
+		else if (negative) {
+			OS::CMutex::SafeIncr(&m_negative_hits[kind]);
+		}
+		else {
+			OS::CMutex::SafeIncr(&m_hits[kind]);
+		}
+	}
+	bool ProfileCache::LookupSearch(ProfileSearchRequest &request, std::vector<OS::Profile> &results, std::map<int, OS::User> &users) {
+		EProfileCacheKind kind = GetSearchKind(request);
+		ProfileSearchScope scope = GetSearchScope(request);
+		time_t now = time(NULL);
+		bool found = false;
+		ProfileCacheShard *shard;
+		ProfileIndexCacheEntry index_entry;
+
+		switch (kind) {
+			case EProfileCacheKind_Profile: {
+				//a deleted profile isn't found whatever the scope
+				ProfileCacheEntry entry;
+				shard = GetShard(request.profile_search_details.id);
+				shard->mutex->lock();
+				found = FindEntry(shard->profiles, request.profile_search_details.id, entry, now, &m_expirations) && !entry.found;
+				if (!found) {
+					found = FindEntry(shard->profile_searches, std::pair<int, ProfileSearchScope>(request.profile_search_details.id, scope), index_entry, now, &m_expirations);
+				}
+				shard->mutex->unlock();
+				if (found && index_entry.profileids.empty()) {
+					RecordLookup(kind, true, true);
+					return true;
+				}
+				if (found) {
+					found = ResolveProfiles(index_entry.profileids, results, users);
+				}
+				break;
+			}
+			case EProfileCacheKind_Uniquenick: {
+				std::pair<std::string, ProfileSearchScope> key(request.profile_search_details.uniquenick, scope);
+				shard = GetShard(0, key.first);
+				shard->mutex->lock();
+				found = FindEntry(shard->uniquenicks, key, index_entry, now, &m_expirations);
+				shard->mutex->unlock();
+				if (found && index_entry.profileids.empty()) {
+					RecordLookup(kind, true, true);
+					return true;
+				}
+				if (found) {
+					found = ResolveProfiles(index_entry.profileids, results, users);
+				}
+				std::vector<OS::Profile>::iterator it = results.begin();
+				while (found && it != results.end()) {
+					if ((*it).uniquenick.compare(key.first) != 0) {
+						found = false;
+					}
+					it++;
+				}
+				break;
+			}
+			case EProfileCacheKind_UserProfiles: {
+				std::pair<int, ProfileSearchScope> key(request.user_search_details.id, scope);
+				shard = GetShard(key.first);
+				shard->mutex->lock();
+				found = FindEntry(shard->user_profiles, key, index_entry, now, &m_expirations);
+				shard->mutex->unlock();
+				if (found) {
+					found = ResolveProfiles(index_entry.profileids, results, users);
+				}
+				std::vector<OS::Profile>::iterator it = results.begin();
+				while (found && it != results.end()) {
+					if ((*it).userid != key.first) {
+						found = false;
+					}
+					it++;
+				}
+				break;
+			}
+			case EProfileCacheKind_List: {
+				ProfileListCacheEntry entry;
+				std::pair<int, std::pair<int, ProfileSearchScope> > key(request.profile_search_details.id, std::pair<int, ProfileSearchScope>(request.type, scope));
+				shard = GetShard(key.first);
+				shard->mutex->lock();
+				found = FindEntry(shard->lists, key, entry, now, &m_expirations);
+				shard->mutex->unlock();
+				if (found) {
+					results = entry.profiles;
+					users = entry.users;
+				}
+				break;
+			}
+			default:
+				return false;
+		}
+
+		if (!found) {
+			results.clear();
+			users.clear();
+		}
+		RecordLookup(kind, found, false);
+		return found;
+	}
+	void ProfileCache::AddProfile(OS::Profile &profile, std::map<int, OS::User> &users, time_t now) {
+		if (profile.id == 0 || profile.deleted) {
+			return;
+		}
+
+		ProfileCacheEntry entry;
+		entry.profile = profile;
+		entry.found = true;
+		entry.expire_time = now + PROFILE_CACHE_TTL;
+		ProfileCacheShard *shard = GetShard(profile.id);
+		shard->mutex->lock();
+		InsertEntry(shard->profiles, profile.id, entry, now, &m_evictions, &m_expirations);
+		shard->mutex->unlock();
+
+		std::map<int, OS::User>::iterator it = users.find(profile.userid);
+		if (it != users.end()) {
+			UserCacheEntry user_entry;
+			user_entry.user = (*it).second;
+			user_entry.expire_time = now + PROFILE_CACHE_TTL;
+			shard = GetShard(profile.userid);
+			shard->mutex->lock();
+			InsertEntry(shard->users, profile.userid, user_entry, now, &m_evictions, &m_expirations);
+			shard->mutex->unlock();
+		}
+	}
+	void ProfileCache::AddSearchResults(ProfileSearchRequest &request, uint32_t epoch, std::vector<OS::Profile> &results, std::map<int, OS::User> &users) {
+		EProfileCacheKind kind = GetSearchKind(request);
+		ProfileSearchScope scope = GetSearchScope(request);
+		time_t now = time(NULL);
+		ProfileCacheShard *shard;
+		ProfileIndexCacheEntry index_entry;
+
+		if (kind == EProfileCacheKind_Count || GetEpoch() != epoch) {
+			return;
+		}
+
+		std::vector<OS::Profile>::iterator it = results.begin();
+		while (it != results.end()) {
+			AddProfile(*it, users, now);
+			if (!(*it).deleted) {
+				index_entry.profileids.push_back((*it).id);
+			}
+			it++;
+		}
+		index_entry.expire_time = now + (index_entry.profileids.empty() ? PROFILE_CACHE_NEGATIVE_TTL : PROFILE_CACHE_TTL);
+
+		switch (kind) {
+			case EProfileCacheKind_Profile: {
+				//an empty result only means nothing matched in this scope, so it's kept with the scope rather than as a deleted profile
+				std::pair<int, ProfileSearchScope> key(request.profile_search_details.id, scope);
+				shard = GetShard(key.first);
+				shard->mutex->lock();
+				InsertEntry(shard->profile_searches, key, index_entry, now, &m_evictions, &m_expirations);
+				shard->mutex->unlock();
+				break;
+			}
+			case EProfileCacheKind_Uniquenick: {
+				std::pair<std::string, ProfileSearchScope> key(request.profile_search_details.uniquenick, scope);
+				shard = GetShard(0, key.first);
+				shard->mutex->lock();
+				InsertEntry(shard->uniquenicks, key, index_entry, now, &m_evictions, &m_expirations);
+				shard->mutex->unlock();
+				break;
+			}
+			case EProfileCacheKind_UserProfiles: {
+				std::pair<int, ProfileSearchScope> key(request.user_search_details.id, scope);
+				shard = GetShard(key.first);
+				shard->mutex->lock();
+				InsertEntry(shard->user_profiles, key, index_entry, now, &m_evictions, &m_expirations);
+				shard->mutex->unlock();
+				break;
+			}
+			case EProfileCacheKind_List: {
+				ProfileListCacheEntry entry;
+				std::pair<int, std::pair<int, ProfileSearchScope> > key(request.profile_search_details.id, std::pair<int, ProfileSearchScope>(request.type, scope));
+				entry.profiles = results;
+				entry.users = users;
+				entry.expire_time = now + PROFILE_CACHE_LIST_TTL;
+				shard = GetShard(key.first);
+				shard->mutex->lock();
+				InsertEntry(shard->lists, key, entry, now, &m_evictions, &m_expirations);
+				shard->mutex->unlock();
+				break;
+			}
+			default:
+				break;
+		}
+	}
+	bool ProfileCache::LookupUser(UserSearchRequest &request, std::vector<OS::User> &results) {
+		//the web service only looks users up by email
+		if (request.type != EUserRequestType_Search || request.search_params.email.length() == 0) {
+			return false;
+		}
+
+		time_t now = time(NULL);
+		std::pair<int, std::string> key(request.search_params.partnercode, request.search_params.email);
+		UserIndexCacheEntry index_entry;
+		UserCacheEntry entry;
+		ProfileCacheShard *shard = GetShard(key.first, key.second);
+		shard->mutex->lock();
+		bool found = FindEntry(shard->emails, key, index_entry, now, &m_expirations);
+		shard->mutex->unlock();
+		if (found && index_entry.userid == 0) {
+			RecordLookup(EProfileCacheKind_User, true, true);
+			return true;
+		}
+		if (found) {
+			shard = GetShard(index_entry.userid);
+			shard->mutex->lock();
+			found = FindEntry(shard->users, index_entry.userid, entry, now, &m_expirations);
+			shard->mutex->unlock();
+		}
+		if (found && (entry.user.email.compare(key.second) != 0 || entry.user.partnercode != key.first)) {
+			found = false;
+		}
+		if (found) {
+			results.push_back(entry.user);
+		}
+		RecordLookup(EProfileCacheKind_User, found, false);
+		return found;
+	}
+	void ProfileCache::AddUserResults(UserSearchRequest &request, uint32_t epoch, std::vector<OS::User> &results) {
+		if (request.type != EUserRequestType_Search || request.search_params.email.length() == 0 || GetEpoch() != epoch) {
+			return;
+		}
+
+		time_t now = time(NULL);
+		std::pair<int, std::string> key(request.search_params.partnercode, request.search_params.email);
+		UserIndexCacheEntry index_entry;
+		ProfileCacheShard *shard;
+		index_entry.userid = 0;
+		index_entry.expire_time = now + PROFILE_CACHE_NEGATIVE_TTL;
+		if (results.size()) {
+			UserCacheEntry entry;
+			entry.user = results.front();
+			entry.expire_time = now + PROFILE_CACHE_TTL;
+			shard = GetShard(entry.user.id);
+			shard->mutex->lock();
+			InsertEntry(shard->users, entry.user.id, entry, now, &m_evictions, &m_expirations);
+			shard->mutex->unlock();
+
+			index_entry.userid = entry.user.id;
+			index_entry.expire_time = entry.expire_time;
+		}
+
+		shard = GetShard(key.first, key.second);
+		shard->mutex->lock();
+		InsertEntry(shard->emails, key, index_entry, now, &m_evictions, &m_expirations);
+		shard->mutex->unlock();
+	}
+	void ProfileCache::InvalidateUniquenick(std::string uniquenick) {
+		ProfileCacheShard *shard = GetShard(0, uniquenick);
+		shard->mutex->lock();
+		EraseKeyRange(shard->uniquenicks, uniquenick, lowest_scope);
+		shard->mutex->unlock();
+	}
+	void ProfileCache::InvalidateProfileSearches(int profileid) {
+		ProfileCacheShard *shard = GetShard(profileid);
+		shard->mutex->lock();
+		EraseKeyRange(shard->profile_searches, profileid, lowest_scope);
+		shard->mutex->unlock();
+	}
+	void ProfileCache::InvalidateUserProfiles(int userid) {
+		ProfileCacheShard *shard = GetShard(userid);
+		shard->mutex->lock();
+		EraseKeyRange(shard->user_profiles, userid, lowest_scope);
+		shard->mutex->unlock();
+	}
+	/*
+		Strings which can't be quoted in an inline PUBLISH are left out, the other process then only drops what it finds by id.
+		A number always ends the message, a backslash right before the closing quote would escape it.
+	*/
+	static std::string PublishableString(const std::string &str) {
+		if (str.find_first_of("\\'\r\n") != std::string::npos) {
+			return "";
+		}
+		return str;
+	}
+	void ProfileCache::InvalidateProfile(OS::Profile &profile, int userid, bool deleted) {
+		DropProfile(profile, userid, deleted);
+
+		mp_redis_mutex->lock();
+		Redis::Command(mp_redis_connection, 0, "PUBLISH %s '\\type\\profile\\uniquenick\\%s\\profileid\\%d\\profile_userid\\%d\\userid\\%d\\deleted\\%d'",
+			profile_cache_channel, PublishableString(profile.uniquenick).c_str(), profile.id, profile.userid, userid, deleted);
+		mp_redis_mutex->unlock();
+	}
+	void ProfileCache::InvalidateUser(OS::User &user) {
+		DropUser(user);
+
+		mp_redis_mutex->lock();
+		Redis::Command(mp_redis_connection, 0, "PUBLISH %s '\\type\\user\\email\\%s\\userid\\%d\\partnercode\\%d'",
+			profile_cache_channel, PublishableString(user.email).c_str(), user.id, user.partnercode);
+		mp_redis_mutex->unlock();
+	}
+	void ProfileCache::DropProfile(OS::Profile &profile, int userid, bool deleted) {
+		OS::CMutex::SafeIncr(&m_epoch);
+
+		time_t now = time(NULL);
+		ProfileCacheEntry entry;
+		bool found = false;
+		if (profile.id != 0) {
+			ProfileCacheShard *shard = GetShard(profile.id);
+			shard->mutex->lock();
+			found = FindEntry(shard->profiles, profile.id, entry, now, &m_expirations) && entry.found;
+			if (deleted) {
+				ProfileCacheEntry negative_entry;
+				negative_entry.found = false;
+				negative_entry.expire_time = now + PROFILE_CACHE_NEGATIVE_TTL;
+				InsertEntry(shard->profiles, profile.id, negative_entry, now, &m_evictions, &m_expirations);
+			}
+			else {
+				shard->profiles.erase(profile.id);
+			}
+			shard->mutex->unlock();
+			InvalidateProfileSearches(profile.id);
+		}
+
+		if (found) {
+			InvalidateUniquenick(entry.profile.uniquenick);
+			InvalidateUserProfiles(entry.profile.userid);
+		}
+		if (profile.uniquenick.length()) {
+			InvalidateUniquenick(profile.uniquenick);
+		}
+		if (profile.userid != 0) {
+			InvalidateUserProfiles(profile.userid);
+		}
+		if (userid != 0 && userid != profile.userid) {
+			InvalidateUserProfiles(userid);
+		}
+	}
+	void ProfileCache::DropUser(OS::User &user) {
+		OS::CMutex::SafeIncr(&m_epoch);
+
+		time_t now = time(NULL);
+		UserCacheEntry entry;
+		ProfileCacheShard *shard = GetShard(user.id);
+		shard->mutex->lock();
+		bool found = FindEntry(shard->users, user.id, entry, now, &m_expirations);
+		shard->users.erase(user.id);
+		shard->mutex->unlock();
+
+		std::pair<int, std::string> key;
+		if (found) {
+			key = std::pair<int, std::string>(entry.user.partnercode, entry.user.email);
+			shard = GetShard(key.first, key.second);
+			shard->mutex->lock();
+			shard->emails.erase(key);
+			shard->mutex->unlock();
+		}
+		if (user.email.length()) {
+			key = std::pair<int, std::string>(user.partnercode, user.email);
+			shard = GetShard(key.first, key.second);
+			shard->mutex->lock();
+			shard->emails.erase(key);
+			shard->mutex->unlock();
+		}
+	}
+	void ProfileCache::DropLists(int profileid) {
+		OS::CMutex::SafeIncr(&m_epoch);
+
+		ProfileCacheShard *shard = GetShard(profileid);
+		shard->mutex->lock();
+		EraseKeyRange(shard->lists, profileid, std::pair<int, ProfileSearchScope>(INT_MIN, lowest_scope));
+		shard->mutex->unlock();
+	}
+	void ProfileCache::DropAll() {
+		OS::CMutex::SafeIncr(&m_epoch);
+
+		for (int i = 0; i < PROFILE_CACHE_SHARDS; i++) {
+			ProfileCacheShard *shard = &m_shards[i];
+			shard->mutex->lock();
+			shard->profiles.clear();
+			shard->users.clear();
+			shard->profile_searches.clear();
+			shard->uniquenicks.clear();
+			shard->user_profiles.clear();
+			shard->emails.clear();
+			shard->lists.clear();
+			shard->mutex->unlock();
+		}
+	}
+	void ProfileCache::onRedisMessage(Redis::Connection *c, Redis::Response reply, void *privdata) {
+		ProfileCache *cache = (ProfileCache *)privdata;
+		Redis::Value v = reply.values.front();
+
+		if (v.type != Redis::REDIS_RESPONSE_TYPE_ARRAY || v.arr_value.values.size() != 3) {
+			return;
+		}
+		std::string type = v.arr_value.values[0].second.value._str;
+		if (type.compare("subscribe") == 0) {
+			//anything published while unsubscribed was missed
+			cache->DropAll();
+			return;
+		}
+		if (type.compare("message") != 0 || v.arr_value.values[2].first != Redis::REDIS_RESPONSE_TYPE_STRING) {
+			return;
+		}
+
+		//our own invalidations come back here too, dropping them again is harmless
+		OS::KVReader reader = v.arr_value.values[2].second.value._str;
+		std::string msg_type = reader.GetValue("type");
+		if (v.arr_value.values[1].second.value._str.compare(profile_cache_channel) == 0) {
+			if (msg_type.compare("profile") == 0) {
+				OS::Profile profile;
+				profile.id = reader.GetValueInt("profileid");
+				profile.userid = reader.GetValueInt("profile_userid");
+				profile.uniquenick = reader.GetValue("uniquenick");
+				cache->DropProfile(profile, reader.GetValueInt("userid"), reader.GetValueInt("deleted") != 0);
+			}
+			else if (msg_type.compare("user") == 0) {
+				OS::User user;
+				user.id = reader.GetValueInt("userid");
+				user.partnercode = reader.GetValueInt("partnercode");
+				user.email = reader.GetValue("email");
+				cache->DropUser(user);
+			}
+		}
+		else if (msg_type.compare("authorize_add") == 0 || msg_type.compare("del_buddy") == 0 || msg_type.compare("block_buddy") == 0 || msg_type.compare("del_block_buddy") == 0) {
+			cache->DropLists(reader.GetValueInt("to_profileid"));
+			cache->DropLists(reader.GetValueInt("from_profileid"));
+		}
+	}
+	void *ProfileCache::SubscribeThread(OS::CThread *thread) {
+		ProfileCache *cache = (ProfileCache *)thread->getParams();
+		Redis::LoopingCommand(cache->mp_redis_subscribe_connection, 0, ProfileCache::onRedisMessage, cache, "SUBSCRIBE %s %s", profile_cache_channel, profile_cache_buddies_channel);
+		return NULL;
+	}
+	OS::MetricValue ProfileCache::GetMetrics() {
+		static const char *kind_names[EProfileCacheKind_Count] = { "profiles", "uniquenicks", "user_profiles", "lists", "users" };
+		OS::MetricValue arr_value, kind_value, value;
+		uint32_t total_hits = 0, total_lookups = 0;
+		value.type = OS::MetricType_Integer;
+
+		for (int i = 0; i < EProfileCacheKind_Count; i++) {
+			uint32_t hits = OS::CMutex::SafeAdd(&m_hits[i], 0);
+			uint32_t negative_hits = OS::CMutex::SafeAdd(&m_negative_hits[i], 0);
+			uint32_t misses = OS::CMutex::SafeAdd(&m_misses[i], 0);
+			total_hits += hits + negative_hits;
+			total_lookups += hits + negative_hits + misses;
+
+			kind_value.arr_value.values.clear();
+			value.value._int = hits;
+			value.key = "hits";
+			kind_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+			value.value._int = negative_hits;
+			value.key = "negative_hits";
+			kind_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+			value.value._int = misses;
+			value.key = "misses";
+			kind_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+			kind_value.key = kind_names[i];
+			kind_value.type = OS::MetricType_Array;
+			arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, kind_value));
+		}
+
+		size_t num_profiles = 0, num_users = 0, num_lists = 0;
+		for (int i = 0; i < PROFILE_CACHE_SHARDS; i++) {
+			m_shards[i].mutex->lock();
+			num_profiles += m_shards[i].profiles.size();
+			num_users += m_shards[i].users.size();
+			num_lists += m_shards[i].lists.size();
+			m_shards[i].mutex->unlock();
+		}
+
+		value.value._int = num_profiles;
+		value.key = "num_profiles";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = num_users;
+		value.key = "num_users";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = num_lists;
+		value.key = "num_lists";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = OS::CMutex::SafeAdd(&m_evictions, 0);
+		value.key = "evictions";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = OS::CMutex::SafeAdd(&m_expirations, 0);
+		value.key = "expirations";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.type = OS::MetricType_Float;
+		value.value._float = total_lookups ? (float)total_hits / (float)total_lookups : 0.0f;
+		value.key = "hit_ratio";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Float, value));
+
+		arr_value.key = "profile_cache";
+		arr_value.type = OS::MetricType_Array;
+		return arr_value;
+	}
+	void SetupProfileCache() {
+		g_profile_cache = new ProfileCache();
+		OS::InstrumentRegistry::getSingleton()->AddCollector("profile_cache", g_profile_cache);
+	}
+	void ShutdownProfileCache() {
+		OS::InstrumentRegistry::getSingleton()->RemoveCollectors(g_profile_cache);
+		delete g_profile_cache;
+		g_profile_cache = NULL;
+	}
+}
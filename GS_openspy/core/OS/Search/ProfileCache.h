@@ -0,0 +1,145 @@
+#ifndef _SEARCH_PROFILECACHE_H
+#define _SEARCH_PROFILECACHE_H
+#include <OS/OpenSpy.h>
+#include <OS/Mutex.h>
+#include <OS/User.h>
+#include <OS/Profile.h>
+#include <OS/Search/Profile.h>
+#include <OS/Search/User.h>
+#include <OS/Analytics/Metric.h>
+#include <OS/Redis.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+
+#define PROFILE_CACHE_SHARDS 16
+#define PROFILE_CACHE_MAX_ENTRIES 4096 //per shard, per map
+#define PROFILE_CACHE_TTL 300 //seconds, profiles, users and the lookups which resolve to them
+#define PROFILE_CACHE_NEGATIVE_TTL 30 //seconds, lookups which found nothing
+#define PROFILE_CACHE_LIST_TTL 60 //seconds, buddy and block lists
+namespace OS {
+	extern const char *profile_cache_channel;
+	extern const char *profile_cache_buddies_channel;
+
+	enum EProfileCacheKind {
+		EProfileCacheKind_Profile, //by (profileid, scope)
+		EProfileCacheKind_Uniquenick, //by (uniquenick, scope)
+		EProfileCacheKind_UserProfiles, //by (userid, scope), ie. FESL sub-accounts
+		EProfileCacheKind_List, //buddy and block lists, by profileid
+		EProfileCacheKind_User, //by (partnercode, email)
+		EProfileCacheKind_Count
+	};
+
+	/*
+		Everything besides the looked up key which Profile.cpp sends and the web service narrows a search by:
+		(namespaceids' only entry or -1, (profile_search_details.namespaceid, user_search_details.partnercode))
+	*/
+	typedef std::pair<int, std::pair<int, int> > ProfileSearchScope;
+
+	typedef struct {
+		OS::Profile profile;
+		bool found; //false for a negative entry, only stored for deleted profiles
+		time_t expire_time;
+	} ProfileCacheEntry;
+
+	typedef struct {
+		OS::User user;
+		time_t expire_time;
+	} UserCacheEntry;
+
+	//resolved through the profile entries, so an invalidated or deleted profile turns these into misses
+	typedef struct {
+		std::vector<int> profileids; //empty for a negative entry
+		time_t expire_time;
+	} ProfileIndexCacheEntry;
+
+	typedef struct {
+		int userid; //0 for a negative entry
+		time_t expire_time;
+	} UserIndexCacheEntry;
+
+	//kept whole, buddy and block lists can hold deleted profiles which profile searches skip
+	typedef struct {
+		std::vector<OS::Profile> profiles;
+		std::map<int, OS::User> users;
+		time_t expire_time;
+	} ProfileListCacheEntry;
+
+	typedef struct {
+		OS::CMutex *mutex;
+		std::map<int, ProfileCacheEntry> profiles;
+		std::map<int, UserCacheEntry> users;
+		std::map<std::pair<int, ProfileSearchScope>, ProfileIndexCacheEntry> profile_searches;
+		std::map<std::pair<std::string, ProfileSearchScope>, ProfileIndexCacheEntry> uniquenicks; //sharded on the uniquenick alone, so every scope of one is in the same shard
+		std::map<std::pair<int, ProfileSearchScope>, ProfileIndexCacheEntry> user_profiles;
+		std::map<std::pair<int, std::string>, UserIndexCacheEntry> emails;
+		std::map<std::pair<int, std::pair<int, ProfileSearchScope> >, ProfileListCacheEntry> lists; //(profileid, (EProfileSearchType, scope))
+	} ProfileCacheShard;
+
+	/*
+		Read-through cache in front of the profile and user search tasks.
+		Only searches which are plain key lookups are answered from it, everything else goes to the web service as before.
+		A lookup is keyed on its ProfileSearchScope as well, searches with any other filter set aren't cached.
+		Update, create and delete requests invalidate what they touch, and publish it on profile_cache_channel so every other
+		process with a cache (GP, SM, FESL...) drops it as well. Buddy graph changes are taken from the GP presence channel,
+		which every cache subscribes to, not just GP's. Anything changed by something which publishes neither, such as the
+		web service itself, is picked up once its TTL runs out.
+	*/
+	class ProfileCache {
+	public:
+		ProfileCache();
+		~ProfileCache();
+
+		//read before sending a search, responses are only cached if nothing was invalidated in the meantime
+		uint32_t GetEpoch();
+
+		//returns true if the request was answered from the cache
+		bool LookupSearch(ProfileSearchRequest &request, std::vector<OS::Profile> &results, std::map<int, OS::User> &users);
+		void AddSearchResults(ProfileSearchRequest &request, uint32_t epoch, std::vector<OS::Profile> &results, std::map<int, OS::User> &users);
+		bool LookupUser(UserSearchRequest &request, std::vector<OS::User> &results);
+		void AddUserResults(UserSearchRequest &request, uint32_t epoch, std::vector<OS::User> &results);
+
+		//drop what's cached here, and have every other process drop it
+		void InvalidateProfile(OS::Profile &profile, int userid, bool deleted);
+		void InvalidateUser(OS::User &user);
+
+		OS::MetricValue GetMetrics();
+	private:
+		static void *SubscribeThread(OS::CThread *thread);
+		static void onRedisMessage(Redis::Connection *c, Redis::Response reply, void *privdata);
+		void DropProfile(OS::Profile &profile, int userid, bool deleted);
+		void DropUser(OS::User &user);
+		void DropLists(int profileid);
+		void DropAll();
+		ProfileCacheShard *GetShard(int key);
+		ProfileCacheShard *GetShard(int key, std::string str);
+		EProfileCacheKind GetSearchKind(ProfileSearchRequest &request);
+		static ProfileSearchScope GetSearchScope(ProfileSearchRequest &request);
+		bool ResolveProfiles(std::vector<int> &profileids, std::vector<OS::Profile> &results, std::map<int, OS::User> &users);
+		void AddProfile(OS::Profile &profile, std::map<int, OS::User> &users, time_t now);
+		void InvalidateUniquenick(std::string uniquenick);
+		void InvalidateProfileSearches(int profileid);
+		void InvalidateUserProfiles(int userid);
+		void RecordLookup(EProfileCacheKind kind, bool hit, bool negative);
+
+		ProfileCacheShard m_shards[PROFILE_CACHE_SHARDS];
+		uint32_t m_epoch;
+
+		uint32_t m_hits[EProfileCacheKind_Count];
+		uint32_t m_negative_hits[EProfileCacheKind_Count];
+		uint32_t m_misses[EProfileCacheKind_Count];
+		uint32_t m_evictions; //dropped to make room
+		uint32_t m_expirations; //dropped once their TTL ran out
+
+		OS::CMutex *mp_redis_mutex; //held while publishing on mp_redis_connection
+		Redis::Connection *mp_redis_connection;
+		Redis::Connection *mp_redis_subscribe_connection;
+		OS::CThread *mp_subscribe_thread;
+	};
+	extern ProfileCache *g_profile_cache;
+	void SetupProfileCache();
+	void ShutdownProfileCache();
+}
+#endif //_SEARCH_PROFILECACHE_H
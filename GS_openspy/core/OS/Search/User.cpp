@@ -1,28 +1,32 @@
 #include <OS/OpenSpy.h>
 #include <OS/Search/User.h>
+#include <OS/Search/ProfileCache.h>
 
-#include <curl/curl.h>
+#include <OS/HTTP.h>
 #include <jansson.h>
 
 namespace OS {
 	OS::TaskPool<UserSearchTask, UserSearchRequest> *m_user_search_task_pool = NULL;
-	struct curl_data {
-		std::string buffer;
-	};
-	/* callback for curl fetch */
-	size_t UserSearchTask::curl_callback (void *contents, size_t size, size_t nmemb, void *userp) {
-		if (!contents) {
-			return 0;
-		}
-		size_t realsize = size * nmemb;                             /* calculate buffer size */
-		curl_data *data = (curl_data *)userp;
-		data->buffer += (const char *)contents;
-		return realsize;
-	}
+	typedef struct {
+		UserSearchRequest request;
+		uint32_t cache_epoch;
+	} UserSearchContext;
 	void UserSearchTask::PerformRequest(UserSearchRequest request) {
-		curl_data recv_data;
-		json_t *root = NULL;
-		std::vector<OS::User> results;
+		std::vector<OS::User> cached_results;
+		if (g_profile_cache->LookupUser(request, cached_results)) {
+			if(request.callback != NULL)
+				request.callback(EUserResponseType_Success, cached_results, request.extra, request.peer);
+			return;
+		}
+
+		if(request.type == EUserRequestType_Update) {
+			g_profile_cache->InvalidateUser(request.search_params);
+		}
+
+		UserSearchContext *context = new UserSearchContext;
+		context->request = request;
+		context->cache_epoch = g_profile_cache->GetEpoch();
+
 		//build json object
 		json_t *send_obj = json_object();
 
@@ -66,69 +70,61 @@ namespace OS {
 
 		char *json_data = json_dumps(send_obj, 0);
 
-		CURL *curl = curl_easy_init();
-		CURLcode res;
-		EUserResponseType resp_type = EUserResponseType_Success;
-
-		if(curl) {
-			curl_easy_setopt(curl, CURLOPT_URL, OPENSPY_USERMGR_URL);
-			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_data);
-
-			/* set default user agent */
-			curl_easy_setopt(curl, CURLOPT_USERAGENT, "OSSearchUser");
-
-			/* set timeout */
-			curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5);
-
-			/* enable location redirects */
-			curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-
-			/* set maximum allowed redirects */
-			curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 1);
-
-			/* Close socket after one use */
-			curl_easy_setopt(curl, CURLOPT_FORBID_REUSE, 1);
-
-			curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_callback);
-			curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) &recv_data);
-
-			res = curl_easy_perform(curl);
-
-			if(res == CURLE_OK) {
-				root = json_loads(recv_data.buffer.c_str(), 0, NULL);
-				json_t *user_obj = json_object_get(root, "user");
-				if(user_obj) {
-					OS::User user = OS::LoadUserFromJson(user_obj);
-					results.push_back(user);
-				}
-				resp_type = EUserResponseType_Success;
-			} else {
-				resp_type = EUserResponseType_GenericError;
-			}
-		}
-		
-		if(root) {
-			json_decref(root);
+		//the task thread drops its reference as soon as this returns
+		if (request.peer) {
+			request.peer->IncRef();
 		}
 
+		OS::HTTPClient client(OPENSPY_USERMGR_URL, "OSSearchUser");
+		client.PostAsync(json_data ? json_data : "", OnSearchResponse, context, request.peer);
+
 		if(json_data)
 			free((void *)json_data);
 
 		if(send_obj)
 			json_decref(send_obj);
+	}
+	void UserSearchTask::OnSearchResponse(HTTPResponse response, void *extra) {
+		UserSearchContext *context = (UserSearchContext *)extra;
+		UserSearchRequest *request = &context->request;
+		std::vector<OS::User> results;
+		EUserResponseType resp_type = EUserResponseType_GenericError;
+
+		if(response.status_code != 0) {
+			json_t *root = json_loads(response.buffer.c_str(), 0, NULL);
+			json_t *user_obj = json_object_get(root, "user");
+			if(user_obj) {
+				OS::User user = OS::LoadUserFromJson(user_obj);
+				results.push_back(user);
+			}
+			if(root && response.status_code == 200 && json_object_get(root, "error") == NULL) {
+				g_profile_cache->AddUserResults(*request, context->cache_epoch, results);
+			}
+			if(root) {
+				json_decref(root);
+			}
+			resp_type = EUserResponseType_Success;
+		}
 
+		if(request->type == EUserRequestType_Update) {
+			//again once it's done, so lookups sent while it was in progress aren't cached
+			g_profile_cache->InvalidateUser(request->search_params);
+		}
+
+		if(request->callback != NULL)
+			request->callback(resp_type, results, request->extra, request->peer);
 
-		if(request.callback != NULL)
-			request.callback(resp_type, results, request.extra, request.peer);
+		if(request->peer) {
+			request->peer->DecRef();
+		}
+		delete context;
 	}
 
 	void *UserSearchTask::TaskThread(CThread *thread) {
 		UserSearchTask *task = (UserSearchTask *)thread->getParams();
-		while (!task->m_request_list.empty() || task->mp_thread_poller->wait()) {
-			task->mp_mutex->lock();
-			while (!task->m_request_list.empty()) {
-				UserSearchRequest task_params = task->m_request_list.front();
-				task->mp_mutex->unlock();
+		while (task->HasRequests() || task->mp_thread_poller->wait()) {
+			UserSearchRequest task_params;
+			while (task->PopRequest(task_params)) {
 				switch(task_params.type) {
 					case EUserRequestType_Update:
 					case EUserRequestType_Search:
@@ -137,11 +133,7 @@ namespace OS {
 				}
 				if (task_params.peer)
 					task_params.peer->DecRef();
-
-				task->mp_mutex->lock();
-				task->m_request_list.pop();
 			}
-			task->mp_mutex->unlock();
 		}
 		return NULL;
 	}
@@ -6,14 +6,15 @@
 #include <OS/User.h>
 #include <OS/TaskPool.h>
 #include <OS/Net/NetPeer.h>
+#include <OS/HTTP.h>
 #include <string>
 #include <vector>
 #include <map>
-#define OPENSPY_USERMGR_URL OPENSPY_WEBSERVICES_URL "/backend/useraccount"
+#define OPENSPY_USERMGR_URL OS::GetWebServicesURL("/backend/useraccount")
 #define OPENSPY_USERMGR_KEY "dGhpc2lzdGhla2V5dGhpc2lzdGhla2V5dGhpc2lzdGhla2V5"
 namespace OS {
 	/*
-		Called within the search task thread
+		Called on the HTTP engine thread, or on the task thread when the request was answered from the profile cache
 	*/
 	enum EUserResponseType {
 		EUserResponseType_Success,
@@ -45,7 +46,7 @@ namespace OS {
 		private:
 			static void PerformRequest(UserSearchRequest request);
 			static void *TaskThread(CThread *thread);
-			static size_t curl_callback (void *contents, size_t size, size_t nmemb, void *userp);
+			static void OnSearchResponse(HTTPResponse response, void *extra);
 	};
 	extern OS::TaskPool<UserSearchTask, UserSearchRequest> *m_user_search_task_pool;
 	void SetupUserSearchTaskPool(int num_tasks);
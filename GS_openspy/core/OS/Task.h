@@ -1,32 +1,218 @@
 #ifndef _OS_TASK_H
 #define _OS_TASK_H
 #include <queue>
+#include <vector>
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
 namespace OS {
 	#define TASK_SLEEP_TIME 200
+	#define TASK_RING_SIZE 1024 //must be a power of 2, requests beyond this wait in a locked overflow queue
+	#define TASK_DEPTH_BUCKETS 12 //bucket N counts requests queued behind fewer than 2^N others
+	#define TASK_WAIT_BUCKETS 24 //bucket N counts requests which waited less than 2^N microseconds
+
+	/*
+		Bounded ring of requests which any number of threads can push to and pop from without locking.
+		Each slot has a sequence number saying whether it's waiting for a producer or a consumer for the current lap,
+		so once a thread claims a position the slot is its alone until it bumps the sequence.
+	*/
+	template<typename T>
+	class TaskRing {
+	public:
+		TaskRing(uint32_t size) : m_slots(size) {
+			m_mask = size - 1;
+			for(uint32_t i=0;i<size;i++) {
+				m_slots[i].sequence = i;
+			}
+			m_enqueue_pos = 0;
+			m_dequeue_pos = 0;
+		}
+		//returns false if full
+		bool Push(const T &data, uint64_t queued_at) {
+			Slot *slot;
+			uint32_t pos = CMutex::SafeAdd(&m_enqueue_pos, 0);
+			for(;;) {
+				slot = &m_slots[pos & m_mask];
+				int32_t diff = (int32_t)(CMutex::SafeAdd(&slot->sequence, 0) - pos);
+				if(diff == 0) {
+					if(CMutex::SafeCompareAndSwap(&m_enqueue_pos, pos, pos + 1)) {
+						break;
+					}
+				} else if(diff < 0) {
+					return false;
+				}
+				pos = CMutex::SafeAdd(&m_enqueue_pos, 0);
+			}
+			slot->data = data;
+			slot->queued_at = queued_at;
+			CMutex::SafeIncr(&slot->sequence); //pos + 1, ready for a consumer
+			return true;
+		}
+		//returns false if empty
+		bool Pop(T &data, uint64_t &queued_at) {
+			Slot *slot;
+			uint32_t pos = CMutex::SafeAdd(&m_dequeue_pos, 0);
+			for(;;) {
+				slot = &m_slots[pos & m_mask];
+				int32_t diff = (int32_t)(CMutex::SafeAdd(&slot->sequence, 0) - (pos + 1));
+				if(diff == 0) {
+					if(CMutex::SafeCompareAndSwap(&m_dequeue_pos, pos, pos + 1)) {
+						break;
+					}
+				} else if(diff < 0) {
+					return false;
+				}
+				pos = CMutex::SafeAdd(&m_dequeue_pos, 0);
+			}
+			data = slot->data;
+			queued_at = slot->queued_at;
+			slot->data = T(); //don't hold on to whatever the request owns until the slot comes around again
+			CMutex::SafeAdd(&slot->sequence, m_mask); //pos + size, free for the producer on the next lap
+			return true;
+		}
+	private:
+		struct Slot {
+			uint32_t sequence;
+			T data;
+			uint64_t queued_at;
+		};
+		std::vector<Slot> m_slots;
+		uint32_t m_mask;
+		uint32_t m_enqueue_pos;
+		uint32_t m_dequeue_pos;
+	};
+
 	template<typename T>
 	class Task {
 	public:
-		Task() {
+		Task() : m_ring(TASK_RING_SIZE) {
 			mp_thread_poller = OS::CreateThreadPoller();
+			mp_overflow_mutex = OS::CreateMutex();
+			mp_siblings = NULL;
+			m_num_queued = 0;
+			m_num_overflow = 0;
+			m_num_stolen = 0;
+			m_busy = 0;
+			memset(&m_depth_histogram, 0, sizeof(m_depth_histogram));
+			memset(&m_wait_histogram, 0, sizeof(m_wait_histogram));
 		}
 		~Task() {
-
+			delete mp_overflow_mutex;
 		}
 		void AddRequest(T data) {
-			mp_mutex->lock();
-			m_request_list.push(data);
-			mp_mutex->unlock();
-			
+			struct timeval now;
+			gettimeofday(&now, NULL);
+			uint64_t queued_at = (uint64_t)now.tv_sec * 1000000 + now.tv_usec;
+
+			uint32_t depth = CMutex::SafeAdd(&m_num_queued, 1);
+			CMutex::SafeIncr(&m_depth_histogram[GetBucket(depth, TASK_DEPTH_BUCKETS)]);
+
+			//once anything has overflowed, keep going there until it's drained so requests stay in order
+			if(CMutex::SafeAdd(&m_num_overflow, 0) != 0 || !m_ring.Push(data, queued_at)) {
+				mp_overflow_mutex->lock();
+				m_overflow_list.push(std::pair<T, uint64_t>(data, queued_at));
+				CMutex::SafeIncr(&m_num_overflow);
+				mp_overflow_mutex->unlock();
+			}
 			mp_thread_poller->signal();
 		}
+		//queued requests, plus the one being run
 		int GetListSize() {
-			return m_request_list.size();
+			return CMutex::SafeAdd(&m_num_queued, 0) + CMutex::SafeAdd(&m_busy, 0);
 		}
+		bool HasRequests() {
+			return CMutex::SafeAdd(&m_num_queued, 0) != 0;
+		}
+		/*
+			Called by the task thread for its next request, takes one from a sibling if its own queue is empty.
+			The task counts as busy until this next returns false.
+		*/
+		bool PopRequest(T &data) {
+			bool ret = TakeRequest(data) || StealRequest(data);
+			m_busy = ret ? 1 : 0;
+			return ret;
+		}
+		//tasks which are allowed to run each other's requests, set by the pool
+		void SetSiblings(std::vector<Task<T> *> *siblings) {
+			mp_siblings = siblings;
+		}
+
+		uint32_t GetNumStolen() { return CMutex::SafeAdd(&m_num_stolen, 0); };
+		const uint32_t *GetDepthHistogram() { return m_depth_histogram; };
+		const uint32_t *GetWaitHistogram() { return m_wait_histogram; };
 	protected:
+		static int GetBucket(uint64_t value, int num_buckets) {
+			int bucket = 0;
+			while(value > 0 && bucket < num_buckets - 1) {
+				value >>= 1;
+				bucket++;
+			}
+			return bucket;
+		}
+
 		CThreadPoller *mp_thread_poller;
 		CThread	*mp_thread;
 		CMutex *mp_mutex;
-		std::queue<T> m_request_list;
+	private:
+		bool TakeRequest(T &data) {
+			uint64_t queued_at;
+			if(!m_ring.Pop(data, queued_at)) {
+				if(CMutex::SafeAdd(&m_num_overflow, 0) == 0) {
+					return false;
+				}
+				mp_overflow_mutex->lock();
+				if(m_overflow_list.empty()) {
+					mp_overflow_mutex->unlock();
+					return false;
+				}
+				data = m_overflow_list.front().first;
+				queued_at = m_overflow_list.front().second;
+				m_overflow_list.pop();
+				CMutex::SafeDecr(&m_num_overflow);
+				mp_overflow_mutex->unlock();
+			}
+			CMutex::SafeDecr(&m_num_queued);
+
+			struct timeval now;
+			gettimeofday(&now, NULL);
+			uint64_t now_us = (uint64_t)now.tv_sec * 1000000 + now.tv_usec;
+			CMutex::SafeIncr(&m_wait_histogram[GetBucket(now_us > queued_at ? now_us - queued_at : 0, TASK_WAIT_BUCKETS)]);
+			return true;
+		}
+		bool StealRequest(T &data) {
+			if(mp_siblings == NULL) {
+				return false;
+			}
+			Task<T> *busiest = NULL;
+			uint32_t most_queued = 0;
+			typename std::vector<Task<T> *>::iterator it = mp_siblings->begin();
+			while(it != mp_siblings->end()) {
+				Task<T> *task = *it;
+				uint32_t queued = CMutex::SafeAdd(&task->m_num_queued, 0);
+				if(task != this && queued > most_queued) {
+					most_queued = queued;
+					busiest = task;
+				}
+				it++;
+			}
+			if(busiest && busiest->TakeRequest(data)) {
+				CMutex::SafeIncr(&m_num_stolen);
+				return true;
+			}
+			return false;
+		}
+
+		TaskRing<T> m_ring;
+		std::queue<std::pair<T, uint64_t> > m_overflow_list;
+		CMutex *mp_overflow_mutex;
+		std::vector<Task<T> *> *mp_siblings;
+
+		uint32_t m_num_queued;
+		uint32_t m_num_overflow;
+		uint32_t m_num_stolen;
+		uint32_t m_busy;
+		uint32_t m_depth_histogram[TASK_DEPTH_BUCKETS];
+		uint32_t m_wait_histogram[TASK_WAIT_BUCKETS];
 	};
 }
-#endif //_OS_TASK_H
\ No newline at end of file
+#endif //_OS_TASK_H
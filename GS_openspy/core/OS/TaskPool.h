@@ -1,15 +1,30 @@
 #ifndef _OS_TASKPOOL_H
 #define _OS_TASKPOOL_H
 #include "Task.h"
+#include "Analytics/Metric.h"
 #include <limits.h>
+#include <sstream>
 namespace OS {
+	enum ETaskDispatchPolicy {
+		ETaskDispatch_LeastLoaded, //requests go to the least loaded task, idle tasks take queued requests from busy ones
+		ETaskDispatch_Affinity, //requests with the same affinity key always run on the same task, in the order they were added
+	};
 	template<typename T, typename R>
 	class TaskPool {
 	public:
-		TaskPool(int num_threads) {
+		TaskPool(int num_threads, ETaskDispatchPolicy policy = ETaskDispatch_LeastLoaded) {
+			m_policy = policy;
 			for(int i=0;i<num_threads;i++) {
 				T *task = new T(i);
 				m_tasks.push_back(task);
+				m_queues.push_back(task);
+			}
+			if(m_policy == ETaskDispatch_LeastLoaded) {
+				typename std::vector< Task<R>* >::iterator it = m_queues.begin();
+				while (it != m_queues.end()) {
+					(*it)->SetSiblings(&m_queues);
+					it++;
+				}
 			}
 		}
 		~TaskPool() {
@@ -19,7 +34,16 @@ namespace OS {
 				it++;
 			}
 		}
-		void AddRequest(R data) {
+		/*
+			affinity_key is usually the peer the request is for, it's ignored unless the pool uses ETaskDispatch_Affinity
+		*/
+		void AddRequest(R data, const void *affinity_key = NULL) {
+			if(m_policy == ETaskDispatch_Affinity && affinity_key != NULL) {
+				//drop the alignment bits, then spread the rest
+				uint32_t hash = (uint32_t)(((size_t)affinity_key) >> 4) * 2654435761U;
+				m_tasks[hash % m_tasks.size()]->AddRequest(data);
+				return;
+			}
 			T *lowest = NULL, *task;
 			typename std::vector< T* >::iterator it = m_tasks.begin();
 			unsigned int lowest_count = UINT_MAX, size;
@@ -31,14 +55,72 @@ namespace OS {
 					lowest = task;
 				}
 				it++;
-			}			
+			}
 			lowest->AddRequest(data);
 		}
+		//for affinity keys which aren't pointers, ie. a channel id, 0 is the same as no key
+		void AddRequestByKey(R data, uint32_t key) {
+			if(m_policy == ETaskDispatch_Affinity && key != 0) {
+				m_tasks[(key * 2654435761U) % m_tasks.size()]->AddRequest(data);
+				return;
+			}
+			AddRequest(data);
+		}
 		const std::vector< T* > getTasks() {
 			return m_tasks;
 		}
+		OS::MetricValue GetMetrics() {
+			OS::MetricValue arr_value, task_value, hist_value, value;
+			value.type = OS::MetricType_Integer;
+			for(size_t i=0;i<m_tasks.size();i++) {
+				T *task = m_tasks[i];
+				task_value.arr_value.values.clear();
+
+				value.value._int = task->GetListSize();
+				value.key = "queued";
+				task_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+				value.value._int = task->GetNumStolen();
+				value.key = "stolen";
+				task_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+				task_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, HistogramToMetric("queue_depth", task->GetDepthHistogram(), TASK_DEPTH_BUCKETS)));
+				task_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, HistogramToMetric("queue_wait_us", task->GetWaitHistogram(), TASK_WAIT_BUCKETS)));
+
+				std::ostringstream s;
+				s << "task_" << i;
+				task_value.key = s.str();
+				task_value.type = OS::MetricType_Array;
+				arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, task_value));
+			}
+			arr_value.key = "task_pool";
+			arr_value.type = OS::MetricType_Array;
+			return arr_value;
+		}
 	protected:
+		//keyed on the bucket's exclusive upper bound
+		static OS::MetricValue HistogramToMetric(std::string key, const uint32_t *buckets, int num_buckets) {
+			OS::MetricValue arr_value, value;
+			value.type = OS::MetricType_Integer;
+			for(int i=0;i<num_buckets;i++) {
+				std::ostringstream s;
+				if(i == num_buckets - 1) {
+					s << "inf";
+				} else {
+					s << (1 << i);
+				}
+				value.key = s.str();
+				value.value._int = buckets[i];
+				arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+			}
+			arr_value.key = key;
+			arr_value.type = OS::MetricType_Array;
+			return arr_value;
+		}
+
 		std::vector< T* > m_tasks;
+		std::vector< Task<R>* > m_queues;
+		ETaskDispatchPolicy m_policy;
 	};
 }
-#endif //_OS_TASK_H
\ No newline at end of file
+#endif //_OS_TASK_H
@@ -0,0 +1,193 @@
+#include "TimerWheel.h"
+namespace OS {
+	TimerWheel::TimerWheel() {
+		memset(&m_slots, 0, sizeof(m_slots));
+		gettimeofday(&m_start_time, NULL);
+		m_next_tick = 0;
+		m_num_pending = 0;
+		m_num_fired = 0;
+		m_num_cancelled = 0;
+		m_num_cascaded = 0;
+		mp_mutex = OS::CreateMutex();
+	}
+	TimerWheel::~TimerWheel() {
+		delete mp_mutex;
+	}
+	void TimerWheel::InitEntry(TimerWheelEntry *entry, TimerCallback callback, void *extra) {
+		entry->callback = callback;
+		entry->extra = extra;
+		entry->expires = 0;
+		entry->prev = NULL;
+		entry->next = NULL;
+		entry->list = NULL;
+	}
+	uint64_t TimerWheel::GetElapsedMS() {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		long long elapsed_ms = (now.tv_sec - m_start_time.tv_sec) * 1000LL + (now.tv_usec - m_start_time.tv_usec) / 1000;
+		if (elapsed_ms < 0) {
+			return 0;
+		}
+		return elapsed_ms;
+	}
+	bool TimerWheel::Schedule(TimerWheelEntry *entry, int delay_ms, bool keep_earlier) {
+		if (delay_ms < 0) {
+			delay_ms = 0;
+		}
+		mp_mutex->lock();
+		//rounded up, so a timer never fires before its delay is up
+		uint64_t expires = (GetElapsedMS() + delay_ms + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+		bool was_pending = entry->list != NULL;
+		if (was_pending) {
+			if (keep_earlier && entry->expires <= expires) {
+				mp_mutex->unlock();
+				return true;
+			}
+			Unlink(entry);
+		}
+		else {
+			m_num_pending++;
+		}
+		entry->expires = expires;
+		Link(entry);
+		mp_mutex->unlock();
+		return was_pending;
+	}
+	bool TimerWheel::Cancel(TimerWheelEntry *entry) {
+		mp_mutex->lock();
+		if (entry->list == NULL) {
+			mp_mutex->unlock();
+			return false;
+		}
+		Unlink(entry);
+		m_num_pending--;
+		m_num_cancelled++;
+		mp_mutex->unlock();
+		return true;
+	}
+	bool TimerWheel::IsPending(TimerWheelEntry *entry) {
+		mp_mutex->lock();
+		bool ret = entry->list != NULL;
+		mp_mutex->unlock();
+		return ret;
+	}
+	void TimerWheel::Link(TimerWheelEntry *entry) {
+		uint64_t expires = entry->expires;
+		if (expires < m_next_tick) {
+			//already due, goes out on the next advance
+			expires = m_next_tick;
+		}
+		else if (expires - m_next_tick > TIMER_WHEEL_MAX_TICKS) {
+			expires = m_next_tick + TIMER_WHEEL_MAX_TICKS;
+		}
+		entry->expires = expires;
+
+		uint64_t delta = expires - m_next_tick;
+		int level = 0;
+		while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ULL << (TIMER_WHEEL_SLOT_BITS * (level + 1)))) {
+			level++;
+		}
+		int slot = (expires >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK;
+
+		TimerWheelEntry **list = &m_slots[level][slot];
+		entry->prev = NULL;
+		entry->next = *list;
+		if (*list) {
+			(*list)->prev = entry;
+		}
+		*list = entry;
+		entry->list = list;
+	}
+	void TimerWheel::Unlink(TimerWheelEntry *entry) {
+		if (entry->prev) {
+			entry->prev->next = entry->next;
+		}
+		else {
+			*entry->list = entry->next;
+		}
+		if (entry->next) {
+			entry->next->prev = entry->prev;
+		}
+		entry->prev = NULL;
+		entry->next = NULL;
+		entry->list = NULL;
+	}
+	void TimerWheel::Cascade(int level, int slot) {
+		//everything in the slot is now within reach of the level below
+		TimerWheelEntry *entry = m_slots[level][slot];
+		m_slots[level][slot] = NULL;
+		while (entry) {
+			TimerWheelEntry *next = entry->next;
+			Link(entry);
+			m_num_cascaded++;
+			entry = next;
+		}
+	}
+	void TimerWheel::Advance() {
+		std::vector<std::pair<TimerCallback, void *> > due;
+
+		mp_mutex->lock();
+		uint64_t now = GetElapsedMS() / TIMER_WHEEL_TICK_MS;
+		while (m_next_tick <= now) {
+			int index = m_next_tick & TIMER_WHEEL_SLOT_MASK;
+			if (index == 0) {
+				for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+					int slot = (m_next_tick >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK;
+					Cascade(level, slot);
+					if (slot != 0) {
+						break;
+					}
+				}
+			}
+
+			TimerWheelEntry *entry = m_slots[0][index];
+			m_slots[0][index] = NULL;
+			while (entry) {
+				TimerWheelEntry *next = entry->next;
+				entry->prev = NULL;
+				entry->next = NULL;
+				entry->list = NULL;
+				due.push_back(std::pair<TimerCallback, void *>(entry->callback, entry->extra));
+				m_num_pending--;
+				m_num_fired++;
+				entry = next;
+			}
+			m_next_tick++;
+		}
+		mp_mutex->unlock();
+
+		//the entries may be rescheduled or freed from here on, only the copies are used
+		std::vector<std::pair<TimerCallback, void *> >::iterator it = due.begin();
+		while (it != due.end()) {
+			(*it).first((*it).second);
+			it++;
+		}
+	}
+	OS::MetricValue TimerWheel::GetMetrics() {
+		OS::MetricValue arr_value, value;
+		mp_mutex->lock();
+
+		value.type = OS::MetricType_Integer;
+		value.value._int = m_num_pending;
+		value.key = "pending";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = m_num_fired;
+		value.key = "fired";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = m_num_cancelled;
+		value.key = "cancelled";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = m_num_cascaded;
+		value.key = "cascaded";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		mp_mutex->unlock();
+
+		arr_value.key = "timer_wheel";
+		arr_value.type = OS::MetricType_Array;
+		return arr_value;
+	}
+}
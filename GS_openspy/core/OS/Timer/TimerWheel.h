@@ -0,0 +1,79 @@
+#ifndef _TIMERWHEEL_H
+#define _TIMERWHEEL_H
+#include <OS/OpenSpy.h>
+#include <OS/Mutex.h>
+#include <OS/Analytics/Metric.h>
+#ifdef _WIN32
+#include <time.h>
+#else
+#include <sys/time.h>
+#endif
+
+#define TIMER_WHEEL_TICK_MS 10
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_MAX_TICKS ((1ULL << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS)) - 1) //~46 hours, longer delays are clamped
+
+namespace OS {
+	typedef void (*TimerCallback)(void *extra);
+
+	/*
+		Owned by whoever schedules it, and must stay alive until it has fired or been cancelled
+	*/
+	typedef struct _TimerWheelEntry {
+		TimerCallback callback;
+		void *extra;
+		uint64_t expires; //in ticks
+		struct _TimerWheelEntry *prev, *next;
+		struct _TimerWheelEntry **list; //slot it's linked into, NULL when not pending
+	} TimerWheelEntry;
+
+	/*
+		Hierarchical timer wheel, TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SLOTS slots each.
+		Scheduling and cancelling are O(1), timers further out than the first level are cascaded down as the wheel turns.
+		Advance is called from the event loop, so expiry is only as precise as its timeout.
+		Callbacks run on the advancing thread without the wheel locked, and may reschedule their own entry.
+	*/
+	class TimerWheel {
+	public:
+		TimerWheel();
+		~TimerWheel();
+
+		static void InitEntry(TimerWheelEntry *entry, TimerCallback callback, void *extra);
+
+		/*
+			(Re)schedules the entry delay_ms from now. With keep_earlier, an entry which is already pending sooner is left alone.
+			Returns true if the entry was already pending.
+		*/
+		bool Schedule(TimerWheelEntry *entry, int delay_ms, bool keep_earlier = false);
+		/*
+			Returns false if the entry wasn't pending, it may have just fired and its callback could still be running
+		*/
+		bool Cancel(TimerWheelEntry *entry);
+		bool IsPending(TimerWheelEntry *entry);
+
+		//fires everything which is due
+		void Advance();
+
+		OS::MetricValue GetMetrics();
+	private:
+		uint64_t GetElapsedMS();
+		void Link(TimerWheelEntry *entry);
+		void Unlink(TimerWheelEntry *entry);
+		void Cascade(int level, int slot);
+
+		TimerWheelEntry *m_slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+		uint64_t m_next_tick; //the next tick Advance has to process
+		struct timeval m_start_time;
+
+		int m_num_pending;
+		uint32_t m_num_fired;
+		uint32_t m_num_cancelled;
+		uint32_t m_num_cascaded;
+
+		OS::CMutex *mp_mutex;
+	};
+}
+#endif //_TIMERWHEEL_H
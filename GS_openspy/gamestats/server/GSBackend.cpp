@@ -1,7 +1,6 @@
 #include <stdio.h>
 #include <algorithm>
 #include <OS/OpenSpy.h>
-#include <OS/Cache/GameCache.h>
 #include "GSBackend.h"
 #include "GSDriver.h"
 #include "GSServer.h"
@@ -12,6 +11,7 @@
 #include <OS/OpenSpy.h>
 #include <OS/Thread.h>
 #include <OS/HTTP.h>
+#include <OS/Analytics/Instrument.h>
 
 #include <OS/legacy/helpers.h>
 
@@ -25,7 +25,7 @@
 #define BUDDY_ADDREQ_EXPIRETIME 604800
 #define GP_STATUS_EXPIRE_TIME 3600
 
-#define GP_PERSIST_BACKEND_URL  OPENSPY_WEBSERVICES_URL "/backend/persist"
+#define GP_PERSIST_BACKEND_URL OS::GetWebServicesURL("/backend/persist")
 #define GP_PERSIST_BACKEND_CRYPTKEY "dGhpc2lzdGhla2V5dGhpc2lzdGhla2V5dGhpc2lzdGhla2V5"
 
 namespace GSBackend {
@@ -35,7 +35,6 @@ namespace GSBackend {
 	};
 
 	OS::TaskPool<PersistBackendTask, PersistBackendRequest> *m_task_pool = NULL;
-	OS::GameCache *m_game_cache = NULL;
 	/* callback for curl fetch */
 	size_t curl_callback (void *contents, size_t size, size_t nmemb, void *userp) {
 		if(!contents) {
@@ -73,7 +72,7 @@ namespace GSBackend {
 		req.type = EPersistRequestType_NewGame;
 		req.callback = cb;
 		peer->IncRef();
-		m_task_pool->AddRequest(req);
+		m_task_pool->AddRequest(req, peer);
 	}
 	void PersistBackendTask::SubmitUpdateGameSession(std::map<std::string, std::string> kvMap, GS::Peer *peer, void* extra, std::string game_instance_identifier, PersistBackendCallback cb) {
 		PersistBackendRequest req;
@@ -86,7 +85,7 @@ namespace GSBackend {
 		req.kvMap = kvMap;
 
 		peer->IncRef();
-		m_task_pool->AddRequest(req);
+		m_task_pool->AddRequest(req, peer);
 	}
 	void PersistBackendTask::PerformNewGameSession(PersistBackendRequest req) {
 		json_t *send_json = json_object();
@@ -174,7 +173,7 @@ namespace GSBackend {
 		req.profileid = profileid;
 		req.kv_set_data = kv_set_data;
 		peer->IncRef();
-		m_task_pool->AddRequest(req);
+		m_task_pool->AddRequest(req, peer);
 	}
 	void PersistBackendTask::SubmitGetPersistData(int profileid, GS::Peer *peer, void *extra, PersistBackendCallback cb, persisttype_t type, int index, std::vector<std::string> keyList, int modified_since) {
 		PersistBackendRequest req;
@@ -188,7 +187,7 @@ namespace GSBackend {
 		req.keyList = keyList;
 		req.modified_since = modified_since;
 		peer->IncRef();
-		m_task_pool->AddRequest(req);
+		m_task_pool->AddRequest(req, peer);
 	}
 	void PersistBackendTask::PerformSetPersistData(PersistBackendRequest req) {
 		json_t *send_json = json_object();
@@ -326,29 +325,21 @@ namespace GSBackend {
 		req.callback = cb;
 		req.game_instance_identifier = gamename;
 		peer->IncRef();
-		m_task_pool->AddRequest(req);
+		m_task_pool->AddRequest(req, peer);
 	}
 	void PersistBackendTask::PerformGetGameInfoByGameName(PersistBackendRequest request) {
 		OS::GameData game;
-		OS::GameCacheKey key;
 		PersistBackendResponse resp_data;
-		if (!m_game_cache->LookupGameByName(request.game_instance_identifier, game)) {
-			game = OS::GetGameByName(request.game_instance_identifier.c_str(), this->mp_redis_connection);
-			key.gamename = request.game_instance_identifier;
-			key.id = game.gameid;
-			m_game_cache->AddItem(m_thread_index, key, game);
-		}
+		game = OS::GetGameByName(request.game_instance_identifier.c_str(), this->mp_redis_connection);
 		resp_data.gameData = game;
 		request.callback(game.secretkey[0] != 0, resp_data, request.mp_peer, request.mp_extra);
 	}
 
 	void *PersistBackendTask::TaskThread(OS::CThread *thread) {
 		PersistBackendTask *task = (PersistBackendTask *)thread->getParams();
-		while (!task->m_request_list.empty() || task->mp_thread_poller->wait()) {
-			task->mp_mutex->lock();
-			while (!task->m_request_list.empty()) {
-				PersistBackendRequest task_params = task->m_request_list.front();
-				task->mp_mutex->unlock();
+		while (task->HasRequests() || task->mp_thread_poller->wait()) {
+			PersistBackendRequest task_params;
+			while (task->PopRequest(task_params)) {
 
 				switch (task_params.type) {
 					case EPersistRequestType_NewGame:
@@ -367,12 +358,8 @@ namespace GSBackend {
 						task->PerformGetGameInfoByGameName(task_params);
 						break;
 				}
-
-				task->mp_mutex->lock();
 				task_params.mp_peer->DecRef();
-				task->m_request_list.pop();
 			}
-			task->mp_mutex->unlock();
 		}
 		return NULL;
 	}
@@ -390,15 +377,13 @@ namespace GSBackend {
 	void SetupTaskPool(GS::Server *server) {
 		OS::Sleep(200);
 
-		OS::DataCacheTimeout gameCacheTimeout;
-		gameCacheTimeout.max_keys = 50;
-		gameCacheTimeout.timeout_time_secs = 7200;
-		m_game_cache = new OS::GameCache(NUM_STATS_THREADS + 1, gameCacheTimeout);
-
-		m_task_pool = new OS::TaskPool<PersistBackendTask, PersistBackendRequest>(NUM_STATS_THREADS);
+		m_task_pool = new OS::TaskPool<PersistBackendTask, PersistBackendRequest>(NUM_STATS_THREADS, OS::ETaskDispatch_Affinity);
 		server->SetTaskPool(m_task_pool);
+
+		OS::InstrumentRegistry::getSingleton()->AddCollector("gs_backend", m_task_pool);
 	}
 	void ShutdownTaskPool() {
+		OS::InstrumentRegistry::getSingleton()->RemoveCollectors(m_task_pool);
 
 	}
 
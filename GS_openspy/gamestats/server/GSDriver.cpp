@@ -40,10 +40,11 @@ namespace GS {
 		makeNonBlocking(m_sd);
 
 		mp_mutex = OS::CreateMutex();
-		mp_thread = OS::CreateThread(Driver::TaskThread, this, true);
+		OS::TimerWheel::InitEntry(&m_reap_timer, Driver::OnReapTimer, this);
 
 	}
 	Driver::~Driver() {
+		m_server->GetTimerWheel()->Cancel(&m_reap_timer);
 		std::vector<Peer *>::iterator it = m_connections.begin();
 		while (it != m_connections.end()) {
 			Peer *peer = *it;
@@ -51,44 +52,53 @@ namespace GS {
 			it++;
 		}
 		delete mp_mutex;
-		delete mp_thread;
-	}
-	void *Driver::TaskThread(OS::CThread *thread) {
-		Driver *driver = (Driver *)thread->getParams();
-		for (;;) {
-			driver->mp_mutex->lock();
-			std::vector<Peer *>::iterator it = driver->m_connections.begin();
-			while (it != driver->m_connections.end()) {
-				Peer *peer = *it;
-				if (peer->ShouldDelete() && std::find(driver->m_peers_to_delete.begin(), driver->m_peers_to_delete.end(), peer) == driver->m_peers_to_delete.end()) {
-					//marked for delection, dec reference and delete when zero
-					it = driver->m_connections.erase(it);
-					peer->DecRef();
-
-					driver->m_server->UnregisterSocket(peer);
-
-					driver->m_stats_queue.push(peer->GetPeerStats());
-					driver->m_peers_to_delete.push_back(peer);
-					continue;
-				}
-				it++;
-			}
-
-			it = driver->m_peers_to_delete.begin();
-			while (it != driver->m_peers_to_delete.end()) {
-				GS::Peer *p = *it;
-				if (p->GetRefCount() == 0) {
-					delete p;
-					it = driver->m_peers_to_delete.erase(it);
-					continue;
-				}
-				it++;
+	}
+	void Driver::OnPeerThink(INetPeer *inet_peer) {
+		Peer *peer = (Peer *)inet_peer;
+		mp_mutex->lock();
+		if (!peer->ShouldDelete()) {
+			peer->think(false);
+		}
+		if (peer->ShouldDelete()) {
+			DeletePeer(peer);
+		}
+		else {
+			peer->ScheduleThink(peer->GetThinkDelay());
+		}
+		mp_mutex->unlock();
+	}
+	void Driver::DeletePeer(Peer *peer) {
+		std::vector<Peer *>::iterator it = std::find(m_connections.begin(), m_connections.end(), peer);
+		if (it == m_connections.end()) {
+			return;
+		}
+		//marked for delection, dec reference and delete when zero
+		m_connections.erase(it);
+		peer->CancelThink();
+		peer->DecRef();
+
+		m_server->UnregisterSocket(peer);
+
+		m_peers_to_delete.push_back(peer);
+		m_server->GetTimerWheel()->Schedule(&m_reap_timer, DRIVER_REAP_TIME, true);
+	}
+	void Driver::OnReapTimer(void *extra) {
+		Driver *driver = (Driver *)extra;
+		driver->mp_mutex->lock();
+		std::vector<Peer *>::iterator it = driver->m_peers_to_delete.begin();
+		while (it != driver->m_peers_to_delete.end()) {
+			GS::Peer *p = *it;
+			if (p->GetRefCount() == 0) {
+				delete p;
+				it = driver->m_peers_to_delete.erase(it);
+				continue;
 			}
-
-			driver->TickConnections();
-			driver->mp_mutex->unlock();
-			OS::Sleep(DRIVER_THREAD_TIME);
+			it++;
+		}
+		if (!driver->m_peers_to_delete.empty()) {
+			driver->m_server->GetTimerWheel()->Schedule(&driver->m_reap_timer, DRIVER_REAP_TIME, true);
 		}
+		driver->mp_mutex->unlock();
 	}
 	void Driver::think(bool listen_waiting) {
 		mp_mutex->lock();
@@ -102,8 +112,8 @@ namespace GS {
 			makeNonBlocking(sda);
 			m_connections.push_back(peer);
 			m_server->RegisterSocket(peer);
+			peer->ScheduleThink(peer->GetThinkDelay());
 		}
-		TickConnections();
 		mp_mutex->unlock();
 	}
 	Peer *Driver::find_client(struct sockaddr_in *address) {
@@ -163,14 +173,6 @@ namespace GS {
 	}
 
 
-	void Driver::TickConnections() {
-		std::vector<Peer *>::iterator it = m_connections.begin();
-		while (it != m_connections.end()) {
-			Peer *p = *it;
-			p->think(false);
-			it++;
-		}
-	}
 	Peer *Driver::FindPeerByProfileID(int profileid) {
 		std::vector<Peer *>::iterator it = m_connections.begin();
 		while (it != m_connections.end()) {
@@ -205,41 +207,4 @@ namespace GS {
 		}
 		return sockets;
 	}
-	OS::MetricInstance Driver::GetMetrics() {
-		OS::MetricInstance peer_metric;
-		OS::MetricValue arr_value2, value, peers;
-
-		mp_mutex->lock();
-
-		std::vector<Peer *>::iterator it = m_connections.begin();
-		while (it != m_connections.end()) {
-			INetPeer * peer = (INetPeer *)*it;
-			OS::Address address = *peer->getAddress();
-			value = peer->GetMetrics().value;
-
-			value.key = address.ToString(false);
-
-			peers.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, value));
-			it++;
-		}
-
-		while (!m_stats_queue.empty()) {
-			PeerStats stats = m_stats_queue.front();
-			m_stats_queue.pop();
-			peers.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, Peer::GetMetricItemFromStats(stats)));
-		}
-
-		peers.key = "peers";
-		arr_value2.type = OS::MetricType_Array;
-		peers.type = OS::MetricType_Array;
-		arr_value2.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, peers));
-
-
-		peer_metric.key = OS::Address(m_local_addr).ToString(false);
-		arr_value2.key = peer_metric.key;
-		peer_metric.value = arr_value2;
-
-		mp_mutex->unlock();
-		return peer_metric;
-	}
 }
@@ -17,7 +17,7 @@
 #include <OS/GPShared.h>
 
 #define GP_PING_TIME (600)
-#define DRIVER_THREAD_TIME 1000
+#define DRIVER_REAP_TIME 100 //how often deleted peers which are still referenced are checked on
 
 namespace GS {
 	class Peer;
@@ -43,11 +43,12 @@ namespace GS {
 
 		const std::vector<int> getSockets();
 		const std::vector<INetPeer *> getPeers(bool inc_ref = false);
-		OS::MetricInstance GetMetrics();
+
+		void OnPeerThink(INetPeer *peer);
 	private:
-		void TickConnections();
+		static void OnReapTimer(void *extra);
+		void DeletePeer(Peer *peer);
 
-		std::queue<PeerStats> m_stats_queue; //pending stats to be sent(deleted clients)
 
 		int m_sd;
 
@@ -57,10 +58,9 @@ namespace GS {
 
 		struct timeval m_server_start;
 
-		static void *TaskThread(OS::CThread *thread);
 		std::vector<GS::Peer *> m_peers_to_delete;
+		OS::TimerWheelEntry m_reap_timer;
 		OS::CMutex *mp_mutex;
-		OS::CThread *mp_thread;
 
 	};
 }
@@ -30,6 +30,7 @@ namespace GS {
 		m_timeout_flag = false;
 		mp_mutex = OS::CreateMutex();
 		gettimeofday(&m_last_ping, NULL);
+		gettimeofday(&m_last_recv, NULL);
 
 		m_user.id = 0;
 		m_profile.id = 0;
@@ -107,12 +108,15 @@ namespace GS {
 			m_delete_flag = true;
 		}
 	}
+	int Peer::GetThinkDelay() {
+		int delay = GetDelayUntil(m_last_ping, GP_PING_TIME);
+		int timeout_delay = GetDelayUntil(m_last_recv, GP_PING_TIME*2);
+		return delay < timeout_delay ? delay : timeout_delay;
+	}
 	void Peer::handle_packet(char *data, int len) {
 		printf("GStats Handle(%d): %s\n", len,data);
 
-		OS::KVReader data_parser = OS::KVReader(std::string(data));
-		std::string command;
-		memset(&command,0,sizeof(command));
+		OS::KVReader data_parser(data, len);
 		if(data_parser.Size() == 0) {
 			m_delete_flag = true;
 			return;
@@ -120,31 +124,41 @@ namespace GS {
 		if(len > 0)
 			gettimeofday(&m_last_recv, NULL);
 
-		command = data_parser.GetKeyByIdx(0);
-		if(command.compare("auth") == 0) {
-			handle_auth(data_parser);
-		} else if(command.compare("authp") == 0) {
-			handle_authp(data_parser);
-		} else if(command.compare("ka") == 0) { //keep alive
-
-		} else if(command.compare("newgame") == 0) {
-			handle_newgame(data_parser);
-		} else if(command.compare("updgame") == 0) {
-			handle_updgame(data_parser);
-		} else if(command.compare("getpid") == 0) {
-			handle_getpid(data_parser);
-		} else if (command.compare("getpd") == 0) {
-			handle_getpd(data_parser);
-		}
-
-		if(m_user.id != 0) {
-			if(command.compare("setpd") == 0) {
-				handle_setpd(data_parser);
-			}
+		switch(data_parser.GetKeyHashByIdx(0)) {
+			case OS::KVHash("auth"):
+				if(data_parser.IsKeyByIdx(0, "auth"))
+					handle_auth(data_parser);
+				break;
+			case OS::KVHash("authp"):
+				if(data_parser.IsKeyByIdx(0, "authp"))
+					handle_authp(data_parser);
+				break;
+			case OS::KVHash("ka"): //keep alive
+				break;
+			case OS::KVHash("newgame"):
+				if(data_parser.IsKeyByIdx(0, "newgame"))
+					handle_newgame(data_parser);
+				break;
+			case OS::KVHash("updgame"):
+				if(data_parser.IsKeyByIdx(0, "updgame"))
+					handle_updgame(data_parser);
+				break;
+			case OS::KVHash("getpid"):
+				if(data_parser.IsKeyByIdx(0, "getpid"))
+					handle_getpid(data_parser);
+				break;
+			case OS::KVHash("getpd"):
+				if(data_parser.IsKeyByIdx(0, "getpd"))
+					handle_getpd(data_parser);
+				break;
+			case OS::KVHash("setpd"):
+				if(m_user.id != 0 && data_parser.IsKeyByIdx(0, "setpd"))
+					handle_setpd(data_parser);
+				break;
 		}
 	}
 
-	void Peer::handle_getpid(OS::KVReader data_parser) {
+	void Peer::handle_getpid(OS::KVReader &data_parser) {
 		/*
 				Send error response until implemented
 		*/
@@ -208,7 +222,7 @@ namespace GS {
 			free((void *)data);
 		free((void *)persist_request_data);
 	}
-	void Peer::handle_getpd(OS::KVReader data_parser) {
+	void Peer::handle_getpd(OS::KVReader &data_parser) {
 		int operation_id = data_parser.GetValueInt("lid");
 		int pid = data_parser.GetValueInt("pid");
 		int data_index = data_parser.GetValueInt("dindex");
@@ -270,7 +284,7 @@ namespace GS {
 		free((void *)persist_request_data);
 	}
 
-	void Peer::handle_setpd(OS::KVReader data_parser) {
+	void Peer::handle_setpd(OS::KVReader &data_parser) {
 		int operation_id = data_parser.GetValueInt("lid");
 		int pid = data_parser.GetValueInt("pid");
 		int data_index = data_parser.GetValueInt("dindex");
@@ -328,7 +342,7 @@ namespace GS {
 		free((void *)b64_str);
 	}
 
-	void Peer::handle_auth(OS::KVReader data_parser) {
+	void Peer::handle_auth(OS::KVReader &data_parser) {
 		std::string gamename;
 		std::string response;
 		int local_id = data_parser.GetValueInt("id");
@@ -375,7 +389,7 @@ namespace GS {
 		peer->m_current_game_identifier = response_data.game_instance_identifier;
 
 	}
-	void Peer::handle_newgame(OS::KVReader data_parser) {
+	void Peer::handle_newgame(OS::KVReader &data_parser) {
 		GSBackend::PersistBackendTask::SubmitNewGameSession(this, NULL, newGameCreateCallback);
 	}
 	void Peer::updateGameCreateCallback(bool success, GSBackend::PersistBackendResponse response_data, GS::Peer *peer, void* extra) {
@@ -383,7 +397,7 @@ namespace GS {
 			free((void *)extra);
 		}
 	}
-	void Peer::handle_updgame(OS::KVReader data_parser) {
+	void Peer::handle_updgame(OS::KVReader &data_parser) {
 		//\updgame\\sesskey\%d\done\%d\gamedata\%s
 		std::map<std::string,std::string> game_data;
 		std::string gamedata = data_parser.GetValue("gamedata");
@@ -406,7 +420,7 @@ namespace GS {
 	void Peer::perform_preauth_auth(std::string auth_token, const char *response, int operation_id) {
 		//OS::AuthTask::TryAuthPID_GStatsSessKey(profileid, m_session_key, response, m_nick_email_auth_cb, this, operation_id);
 	}
-	void Peer::handle_authp(OS::KVReader data_parser) {
+	void Peer::handle_authp(OS::KVReader &data_parser) {
 		// TODO: CD KEY AUTH
 		int pid = data_parser.GetValueInt("pid");
 
@@ -502,9 +516,7 @@ namespace GS {
 		}
 
 		gamespy3dxor((char *)buffer.GetHead(), buffer.size());
-		int c = send(m_sd, (const char *)buffer.GetHead(), buffer.size(), MSG_NOSIGNAL);
-
-		if(c < 0) {
+		if(!SendData(buffer.GetHead(), buffer.size())) {
 			m_delete_flag = true;
 		}
 	}
@@ -593,53 +605,6 @@ namespace GS {
 		return m_profile.id;
 	}
 
-	OS::MetricValue Peer::GetMetricItemFromStats(PeerStats stats) {
-		OS::MetricValue arr_value, value;
-		value.value._str = stats.m_address.ToString(false);
-		value.key = "ip";
-		value.type = OS::MetricType_String;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.disconnected;
-		value.key = "disconnected";
-		value.type = OS::MetricType_Integer;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.type = OS::MetricType_Integer;
-		value.value._int = stats.bytes_in;
-		value.key = "bytes_in";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.bytes_out;
-		value.key = "bytes_out";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.packets_in;
-		value.key = "packets_in";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.packets_out;
-		value.key = "packets_out";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.total_requests;
-		value.key = "pending_requests";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-		arr_value.type = OS::MetricType_Array;
-
-		value.type = OS::MetricType_String;
-		value.key = "gamename";
-		value.value._str = stats.from_game.gamename;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.type = OS::MetricType_Integer;
-		value.key = "version";
-		value.value._int = stats.version;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		arr_value.key = stats.m_address.ToString(false);
-		return arr_value;
-	}
 	void Peer::ResetMetrics() {
 		m_peer_stats.bytes_in = 0;
 		m_peer_stats.bytes_out = 0;
@@ -647,14 +612,4 @@ namespace GS {
 		m_peer_stats.packets_out = 0;
 		m_peer_stats.total_requests = 0;
 	}
-	OS::MetricInstance Peer::GetMetrics() {
-		OS::MetricInstance peer_metric;
-
-		peer_metric.value = GetMetricItemFromStats(m_peer_stats);
-		peer_metric.key = "peer";
-
-		ResetMetrics();
-
-		return peer_metric;
-	}
 }
@@ -49,6 +49,7 @@ namespace GS {
 		~Peer();
 		
 		void think(bool packet_waiting);
+		int GetThinkDelay();
 		void handle_packet(char *data, int len);
 		const struct sockaddr_in *getAddress() { return &m_address_info; }
 
@@ -66,9 +67,6 @@ namespace GS {
 		void SendPacket(std::string str, bool attach_final = true);
 		void SendPacket(OS::Buffer &buffer, bool attach_final = true);
 
-		static OS::MetricValue GetMetricItemFromStats(PeerStats stats);
-		OS::MetricInstance GetMetrics();
-		PeerStats GetPeerStats() { if (m_delete_flag) m_peer_stats.disconnected = true; return m_peer_stats; };
 
 		void ResetMetrics();
 
@@ -76,21 +74,21 @@ namespace GS {
 	private:
 		//packet handlers
 		static void newGameCreateCallback(bool success, GSBackend::PersistBackendResponse response_data, GS::Peer *peer, void* extra);
-		void handle_newgame(OS::KVReader data_parser);
+		void handle_newgame(OS::KVReader &data_parser);
 
 		static void updateGameCreateCallback(bool success, GSBackend::PersistBackendResponse response_data, GS::Peer *peer, void* extra);
-		void handle_updgame(OS::KVReader data_parser);
+		void handle_updgame(OS::KVReader &data_parser);
 
 		static void onGetGameDataCallback(bool success, GSBackend::PersistBackendResponse response_data, GS::Peer *peer, void* extra);
-		void handle_authp(OS::KVReader data_parser);
-		void handle_auth(OS::KVReader data_parser);
-		void handle_getpid(OS::KVReader data_parser);
+		void handle_authp(OS::KVReader &data_parser);
+		void handle_auth(OS::KVReader &data_parser);
+		void handle_getpid(OS::KVReader &data_parser);
 
 		static void getPersistDataCallback(bool success, GSBackend::PersistBackendResponse response_data, GS::Peer *peer, void* extra);
-		void handle_getpd(OS::KVReader data_parser);
+		void handle_getpd(OS::KVReader &data_parser);
 
 		static void setPersistDataCallback(bool success, GSBackend::PersistBackendResponse response_data, GS::Peer *peer, void* extra);
-		void handle_setpd(OS::KVReader data_parser);
+		void handle_setpd(OS::KVReader &data_parser);
 
 		//login
 		void perform_preauth_auth(std::string auth_token, const char *response, int operation_id);
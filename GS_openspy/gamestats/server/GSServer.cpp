@@ -3,10 +3,10 @@
 #include "GSPeer.h"
 #include "GSServer.h"
 #include "GSDriver.h"
+#include <OS/HTTP.h>
 
 namespace GS {
 	Server::Server() : INetServer(){
-		gettimeofday(&m_last_analytics_submit_time, NULL);
 	}
 	void Server::init() {
 		GSBackend::SetupTaskPool(this);
@@ -31,25 +31,4 @@ namespace GS {
 			it++;
 		}
 	}
-	OS::MetricInstance Server::GetMetrics() {
-		OS::MetricInstance peer_metric;
-		OS::MetricValue value, arr_value, arr_value2, container_val;
-
-		std::vector<INetDriver *>::iterator it2 = m_net_drivers.begin();
-		int idx = 0;
-		while (it2 != m_net_drivers.end()) {
-			GS::Driver *driver = (GS::Driver *)*it2;
-			arr_value2 = driver->GetMetrics().value;
-			it2++;
-			arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, arr_value2));
-		}
-
-		arr_value.type = OS::MetricType_Array;
-		arr_value.key = std::string(OS::g_hostName) + std::string(":") + std::string(OS::g_appName);
-
-		container_val.type = OS::MetricType_Array;
-		container_val.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, arr_value));
-		peer_metric.value = container_val;
-		return peer_metric;
-	}
 }
\ No newline at end of file
@@ -12,9 +12,6 @@ namespace GS {
 		void tick();
 		void shutdown();
 		void SetTaskPool(OS::TaskPool<GSBackend::PersistBackendTask, GSBackend::PersistBackendRequest> *pool);
-		OS::MetricInstance GetMetrics();
-	private:
-		struct timeval m_last_analytics_submit_time;
 	};
 }
 #endif //_GPSERVER_H
\ No newline at end of file
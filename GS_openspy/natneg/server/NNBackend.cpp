@@ -4,56 +4,59 @@
 
 #include <OS/TaskPool.h>
 #include <OS/Redis.h>
+#include <OS/Analytics/Instrument.h>
 
 #include <sstream>
-#define NATNEG_COOKIE_TIME 30 
 namespace NN {
 	OS::TaskPool<NNQueryTask, NNBackendRequest> *m_task_pool = NULL;
+	CookieTable *m_cookie_table = NULL;
 	Redis::Connection *mp_redis_async_retrival_connection;
 	OS::CThread *mp_async_thread;
 	Redis::Connection *mp_redis_async_connection;
 	NNQueryTask *mp_async_lookup_task = NULL;
 
 	const char *nn_channel = "natneg.backend";
+	const char *mp_node_pk_name = "NNNODEID";
+	std::string m_node_channel; //nn_channel.<node id>, cookies for clients on this node are sent here
 
 	void *NNQueryTask::TaskThread(OS::CThread *thread) {
 		NNQueryTask *task = (NNQueryTask *)thread->getParams();
-		while(!task->m_request_list.empty() || task->mp_thread_poller->wait()) {
-			task->mp_mutex->lock();
+		while(task->HasRequests() || task->mp_thread_poller->wait()) {
 			task->m_thread_awake = true;
-			while (!task->m_request_list.empty()) {
-				NNBackendRequest task_params = task->m_request_list.front();
-				task->mp_mutex->unlock();
+			NNBackendRequest task_params;
+			while (task->PopRequest(task_params)) {
 				task->mp_timer->start();
 				switch (task_params.type) {
 					case ENNQueryRequestType_SubmitClient:
 						task->PerformSubmit(task_params);
+						task_params.peer->RemovePendingRequest();
 						break;
 					case ENNQueryRequestType_PerformERTTest:
 						task->PerformERTTest(task_params);
 						break;
+					case ENNQueryRequestType_DeliverPartner:
+						task->PerformDeliverPartner(task_params);
+						break;
 				}
 				task->mp_timer->stop();
 				if (task_params.peer) {
 					OS::LogText(OS::ELogLevel_Info, "[%s] Thread type %d - time: %f", OS::Address(task_params.peer->getAddress()).ToString().c_str(), task_params.type, task->mp_timer->time_elapsed() / 1000000.0);
 				}
 				task_params.peer->DecRef();
-				task->mp_mutex->lock();
-				task->m_request_list.pop();
 			}
 			task->m_thread_awake = false;
-			task->mp_mutex->unlock();
 		}
 		return NULL;
 	}
 
 	void onRedisMessage(Redis::Connection *c, Redis::Response reply, void *privdata) {
 		Redis::Value v = reply.values.front();
-		NN::Server *server = (NN::Server *)privdata;
+		CookieTable *cookie_table = (CookieTable *)privdata;
 
 		if (v.type == Redis::REDIS_RESPONSE_TYPE_ARRAY) {
 			if (v.arr_value.values.size() == 3 && v.arr_value.values[2].first == Redis::REDIS_RESPONSE_TYPE_STRING) {
-				if (strcmp(v.arr_value.values[1].second.value._str.c_str(), nn_channel) == 0) {
+				//nodes from before the cookie table publish every cookie on nn_channel
+				if (v.arr_value.values[1].second.value._str.compare(m_node_channel) == 0 || v.arr_value.values[1].second.value._str.compare(nn_channel) == 0) {
 					std::map<std::string, std::string> kv_data = OS::KeyStringToMap(v.arr_value.values[2].second.value._str.c_str());
 					if(kv_data.find("natneg_init") != kv_data.end()) {
 						//if (kv_data["type"].compare("") == 0) {
@@ -61,7 +64,7 @@ namespace NN {
 						int client_idx = atoi(kv_data["index"].c_str());
 						OS::Address addr(kv_data["ipstr"].c_str());
 						OS::Address private_addr(kv_data["privateip"].c_str());
-						server->OnGotCookie(cookie, client_idx, addr, private_addr);
+						cookie_table->DeliverRemote(cookie, client_idx, addr, private_addr);
 					}
 				end_exit:
 					return;
@@ -114,43 +117,64 @@ namespace NN {
 		Redis::Command(mp_redis_connection, 0, "SELECT %d", OS::ERedisDB_NatNeg);
 		Redis::Command(mp_redis_connection, 0, "PUBLISH %s '\\natneg_erttest\\%s\\type\\%d'", nn_channel, address.ToString().c_str(),task_params.extra);
 	}
+	/*
+		Only reached when the partner didn't turn up on this node.
+		The cookie is stored before the partner's is read, so of two clients submitting at once at least one sees the other,
+		and tells the partner's node directly.
+		The client's field keeps the \ip\privateip format that nodes from before the cookie table read, the node goes in its own node_<index> field.
+		A partner stored by one of those nodes has no node, it's told on nn_channel, which they all scan.
+	*/
 	void NNQueryTask::PerformSubmit(NNBackendRequest task_params) {
-		Redis::Command(mp_redis_connection, 0, "SELECT %d", OS::ERedisDB_NatNeg);
-
 		OS::Address address = task_params.peer->getAddress();
+		OS::Address private_address = task_params.peer->getPrivateAddress();
+		NNCookieType cookie = task_params.peer->GetCookie();
 		int client_index = task_params.peer->GetClientIndex();
 		int search_index = client_index == 1 ? 0 : 1;
 
 		std::string nn_key;
 		std::ostringstream nn_key_ss;
-		nn_key_ss << "nn_cookie_" << task_params.peer->GetCookie();
+		nn_key_ss << "nn_cookie_" << cookie;
 		nn_key = nn_key_ss.str();
 
-		//Check for existing natneg cookies, and send if already sent by client
-		Redis::Response reply = Redis::Command(mp_redis_connection, 0, "EXISTS %s", nn_key.c_str());
-		if (!(reply.values.size() == 0 || reply.values.front().type == Redis::REDIS_RESPONSE_TYPE_ERROR)) { 
-			std::string connect_address;
-			reply = Redis::Command(mp_redis_connection, 0, "HGET %s %d", nn_key.c_str(), search_index);
-			if (reply.values.size() > 0 && reply.values.front().type != Redis::REDIS_RESPONSE_TYPE_ERROR) {
-				Redis::Value v = reply.values.front();
-				std::vector<std::string> ip_list = OS::KeyStringToVector(v.value._str);
-				if (ip_list.size() == 2) {
-					OS::Address peer_address(ip_list.at(0).c_str()), private_peer_address(ip_list.at(1).c_str());
-					task_params.peer->OnGotPeerAddress(peer_address, private_peer_address);
-				}
-			}
-			//Redis::Command(mp_redis_connection, 0, "HDEL %s %d", nn_key.c_str(), search_index); //delete cookie to prevent re-sends when invalid
+		Redis::AppendCommand(mp_redis_connection, "SELECT %d", OS::ERedisDB_NatNeg);
+		Redis::AppendCommand(mp_redis_connection, "HSET %s %d '\\%s\\%s'", nn_key.c_str(), client_index, address.ToString().c_str(), private_address.ToString().c_str());
+		Redis::AppendCommand(mp_redis_connection, "HSET %s node_%d %d", nn_key.c_str(), client_index, m_cookie_table->GetNodeID());
+		Redis::AppendCommand(mp_redis_connection, "EXPIRE %s %d", nn_key.c_str(), NATNEG_COOKIE_TIME);
+		Redis::AppendCommand(mp_redis_connection, "HGET %s %d", nn_key.c_str(), search_index);
+		Redis::AppendCommand(mp_redis_connection, "HGET %s node_%d", nn_key.c_str(), search_index);
+		Redis::Response reply = Redis::Flush(mp_redis_connection);
+		if (reply.values.size() != 6 || reply.values[4].type != Redis::REDIS_RESPONSE_TYPE_STRING) {
+			return;
+		}
+
+		//ip, private ip, then the node from nodes which wrote it into the same field
+		std::vector<std::string> ip_list = OS::KeyStringToVector(reply.values[4].value._str);
+		if (ip_list.size() != 2 && ip_list.size() != 3) {
+			return;
 		}
-			
-
-		Redis::Command(mp_redis_connection, 0, "HSET %s %d '\\%s\\%s'", nn_key.c_str(), client_index, address.ToString().c_str(), task_params.peer->getPrivateAddress().ToString().c_str());
-		Redis::Command(mp_redis_connection, 0, "EXPIRE %s %d", nn_key.c_str(), NATNEG_COOKIE_TIME);
-		switch (task_params.type) {
-			case NN::ENNQueryRequestType_SubmitClient:
-				Redis::Command(mp_redis_connection, 0, "PUBLISH %s '\\natneg_init\\%d\\index\\%d\\ipstr\\%s\\gamename\\%s\\privateip\\%s'", nn_channel, task_params.peer->GetCookie(), task_params.peer->GetClientIndex(), address.ToString().c_str(), task_params.peer->getGamename().c_str(), task_params.peer->getPrivateAddress().ToString().c_str());
-				break;
+		std::string node;
+		if (reply.values[5].type == Redis::REDIS_RESPONSE_TYPE_STRING) {
+			node = reply.values[5].value._str;
+		} else if (reply.values[5].type == Redis::REDIS_RESPONSE_TYPE_INTEGER) {
+			std::ostringstream s;
+			s << reply.values[5].value._int;
+			node = s.str();
+		} else if (ip_list.size() == 3) {
+			node = ip_list.at(2);
 		}
+		OS::Address peer_address(ip_list.at(0).c_str()), private_peer_address(ip_list.at(1).c_str());
+		m_cookie_table->DeliverRemote(cookie, search_index, peer_address, private_peer_address);
 
+		std::string channel = nn_channel;
+		if (!node.empty()) {
+			channel += "." + node;
+		}
+		Redis::Command(mp_redis_connection, 0, "PUBLISH %s '\\natneg_init\\%d\\index\\%d\\ipstr\\%s\\gamename\\%s\\privateip\\%s'", channel.c_str(), cookie, client_index, address.ToString().c_str(), task_params.peer->getGamename().c_str(), private_address.ToString().c_str());
+	}
+	void NNQueryTask::PerformDeliverPartner(NNBackendRequest task_params) {
+		task_params.peer->Lock();
+		task_params.peer->OnGotPeerAddress(task_params.address, task_params.private_address);
+		task_params.peer->Unlock();
 	}
 
 	void *setup_redis_async(OS::CThread *thread) {
@@ -159,7 +183,7 @@ namespace NN {
 		t.tv_sec = 1;
 		mp_redis_async_connection = Redis::Connect(OS::g_redisAddress, t);
 		mp_async_lookup_task = new NNQueryTask(NUM_NN_QUERY_THREADS+1);
-		Redis::LoopingCommand(mp_redis_async_connection, 0, onRedisMessage, thread->getParams(), "SUBSCRIBE %s", nn_channel);
+		Redis::LoopingCommand(mp_redis_async_connection, 0, onRedisMessage, thread->getParams(), "SUBSCRIBE %s %s", m_node_channel.c_str(), nn_channel);
 		return NULL;
 	}
 	void SetupTaskPool(NN::Server* server) {
@@ -169,12 +193,28 @@ namespace NN {
 		t.tv_sec = 60;
 
 		mp_redis_async_retrival_connection = Redis::Connect(OS::g_redisAddress, t);
-		mp_async_thread = OS::CreateThread(setup_redis_async, server, true);
+
+		m_cookie_table = new CookieTable(server);
+		Redis::Command(mp_redis_async_retrival_connection, 0, "SELECT %d", OS::ERedisDB_NatNeg);
+		Redis::Response reply = Redis::Command(mp_redis_async_retrival_connection, 0, "INCR %s", mp_node_pk_name);
+		if (reply.values.size() > 0 && reply.values.front().type == Redis::REDIS_RESPONSE_TYPE_INTEGER) {
+			m_cookie_table->SetNodeID(reply.values.front().value._int);
+		}
+		std::ostringstream s;
+		s << nn_channel << "." << m_cookie_table->GetNodeID();
+		m_node_channel = s.str();
+
+		mp_async_thread = OS::CreateThread(setup_redis_async, m_cookie_table, true);
 
 		m_task_pool = new OS::TaskPool<NNQueryTask, NNBackendRequest>(NUM_NN_QUERY_THREADS);
 		server->SetTaskPool(m_task_pool);
+
+		OS::InstrumentRegistry::getSingleton()->AddCollector("nn_backend", m_task_pool);
+		OS::InstrumentRegistry::getSingleton()->AddCollector("nn_cookie_table", m_cookie_table);
 	}
 	void Shutdown() {
+		OS::InstrumentRegistry::getSingleton()->RemoveCollectors(m_task_pool);
+		OS::InstrumentRegistry::getSingleton()->RemoveCollectors(m_cookie_table);
 	}
 
 }
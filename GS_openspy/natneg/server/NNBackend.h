@@ -4,6 +4,7 @@
 #include "NNServer.h"
 #include "NNDriver.h"
 #include "NNPeer.h"
+#include "NNCookieTable.h"
 
 #include <OS/OpenSpy.h>
 #include <OS/Task.h>
@@ -24,11 +25,13 @@ namespace NN {
 	enum ENNQueryRequestType {
 		ENNQueryRequestType_SubmitClient,
 		ENNQueryRequestType_PerformERTTest,
+		ENNQueryRequestType_DeliverPartner,
 	};
 	typedef struct _NNBackendRequest {
 		ENNQueryRequestType type;
 		void *extra;
 		NN::Peer *peer;
+		OS::Address address, private_address; //for ENNQueryRequestType_DeliverPartner
 	} NNBackendRequest;
 
 	class NNQueryTask : public OS::Task<NNBackendRequest> {
@@ -46,6 +49,7 @@ namespace NN {
 
 			void PerformSubmit(NNBackendRequest request);
 			void PerformERTTest(NNBackendRequest request);
+			void PerformDeliverPartner(NNBackendRequest request);
 			std::vector<NN::Driver *> m_drivers;
 			Redis::Connection *mp_redis_connection;
 			time_t m_redis_timeout;
@@ -55,6 +59,7 @@ namespace NN {
 	};
 	#define NUM_NN_QUERY_THREADS 8
 	extern OS::TaskPool<NNQueryTask, NNBackendRequest> *m_task_pool;
+	extern CookieTable *m_cookie_table;
 	void SetupTaskPool(NN::Server *server);
 	void *setup_redis_async(OS::CThread *thread);
 }
@@ -0,0 +1,248 @@
+#include "NNCookieTable.h"
+#include "NNBackend.h"
+#include "NNServer.h"
+#include "NNPeer.h"
+#include <algorithm>
+
+namespace NN {
+	CookieTable::CookieTable(NN::Server *server) {
+		mp_server = server;
+		m_node_id = 0;
+		m_num_submitted = 0;
+		m_num_local_matches = 0;
+		m_num_remote_submits = 0;
+		m_num_remote_matches = 0;
+		mp_mutex = OS::CreateMutex();
+	}
+	CookieTable::~CookieTable() {
+		std::map<CookieKey, CookieEntry *>::iterator it = m_entries.begin();
+		while (it != m_entries.end()) {
+			CookieEntry *entry = (*it).second;
+			mp_server->GetTimerWheel()->Cancel(&entry->timer);
+			std::vector<Peer *>::iterator it2 = entry->peers.begin();
+			while (it2 != entry->peers.end()) {
+				(*it2)->DecRef();
+				it2++;
+			}
+			delete entry;
+			it++;
+		}
+		delete mp_mutex;
+	}
+	void CookieTable::Submit(Peer *peer) {
+		std::vector<CookieDelivery> deliveries;
+		CookieKey key(peer->GetCookie(), peer->GetClientIndex());
+		CookieKey partner_key(peer->GetCookie(), peer->GetClientIndex() == 1 ? 0 : 1);
+		bool submit_remote = false;
+
+		OS::CMutex::SafeIncr(&m_num_submitted);
+
+		mp_mutex->lock();
+		CookieEntry *entry;
+		std::map<CookieKey, CookieEntry *>::iterator it = m_entries.find(key);
+		if (it == m_entries.end()) {
+			entry = new CookieEntry;
+			entry->table = this;
+			entry->key = key;
+			entry->has_partner = false;
+			entry->remote_submitted = false;
+			entry->expiring = false;
+			OS::TimerWheel::InitEntry(&entry->timer, CookieTable::OnEntryTimer, entry);
+			m_entries[key] = entry;
+		}
+		else {
+			entry = (*it).second;
+		}
+
+		//each port the client sends from is its own peer, they all get the partner
+		if (std::find(entry->peers.begin(), entry->peers.end(), peer) == entry->peers.end()) {
+			peer->IncRef();
+			entry->peers.push_back(peer);
+		}
+		entry->address = peer->getAddress();
+		entry->private_address = peer->getPrivateAddress();
+
+		it = m_entries.find(partner_key);
+		if (it != m_entries.end()) {
+			CookieEntry *partner = (*it).second;
+			if (!entry->has_partner) {
+				OS::CMutex::SafeIncr(&m_num_local_matches);
+			}
+			entry->has_partner = true;
+			entry->partner_address = partner->address;
+			entry->partner_private_address = partner->private_address;
+
+			partner->has_partner = true;
+			partner->partner_address = entry->address;
+			partner->partner_private_address = entry->private_address;
+			AddDeliveries(partner, deliveries);
+		}
+		if (entry->has_partner) {
+			AddDelivery(peer, entry->partner_address, entry->partner_private_address, deliveries);
+		}
+		else if (entry->remote_submitted) {
+			//the partner is on another node, which needs this client's latest address
+			submit_remote = true;
+		}
+
+		if (!entry->expiring && !mp_server->GetTimerWheel()->IsPending(&entry->timer)) {
+			if (entry->has_partner) {
+				entry->expiring = true;
+				mp_server->GetTimerWheel()->Schedule(&entry->timer, NATNEG_COOKIE_TIME * 1000);
+			}
+			else {
+				mp_server->GetTimerWheel()->Schedule(&entry->timer, NN_COOKIE_REMOTE_DELAY);
+			}
+		}
+		mp_mutex->unlock();
+
+		if (submit_remote) {
+			SubmitRemote(peer);
+		}
+		Deliver(peer, deliveries);
+	}
+	void CookieTable::RemovePeer(Peer *peer) {
+		CookieKey key(peer->GetCookie(), peer->GetClientIndex());
+		mp_mutex->lock();
+		std::map<CookieKey, CookieEntry *>::iterator it = m_entries.find(key);
+		if (it != m_entries.end()) {
+			//the entry stays until its timer, the address can still be matched
+			CookieEntry *entry = (*it).second;
+			std::vector<Peer *>::iterator it2 = std::find(entry->peers.begin(), entry->peers.end(), peer);
+			if (it2 != entry->peers.end()) {
+				entry->peers.erase(it2);
+				peer->DecRef();
+			}
+		}
+		mp_mutex->unlock();
+	}
+	void CookieTable::DeliverRemote(NNCookieType cookie, int client_idx, OS::Address address, OS::Address private_address) {
+		std::vector<CookieDelivery> deliveries;
+		CookieKey key(cookie, client_idx == 1 ? 0 : 1);
+
+		mp_mutex->lock();
+		std::map<CookieKey, CookieEntry *>::iterator it = m_entries.find(key);
+		if (it != m_entries.end()) {
+			CookieEntry *entry = (*it).second;
+			if (!entry->has_partner) {
+				OS::CMutex::SafeIncr(&m_num_remote_matches);
+			}
+			entry->has_partner = true;
+			entry->partner_address = address;
+			entry->partner_private_address = private_address;
+			AddDeliveries(entry, deliveries);
+		}
+		mp_mutex->unlock();
+
+		Deliver(NULL, deliveries);
+	}
+	void CookieTable::OnEntryTimer(void *extra) {
+		CookieEntry *entry = (CookieEntry *)extra;
+		CookieTable *table = entry->table;
+		Peer *submit_peer = NULL;
+
+		table->mp_mutex->lock();
+		if (entry->expiring) {
+			std::vector<Peer *>::iterator it = entry->peers.begin();
+			while (it != entry->peers.end()) {
+				(*it)->DecRef();
+				it++;
+			}
+			table->m_entries.erase(entry->key);
+			delete entry;
+			table->mp_mutex->unlock();
+			return;
+		}
+
+		//the partner didn't show up here in time, it may be on another node
+		if (!entry->has_partner && !entry->peers.empty()) {
+			entry->remote_submitted = true;
+			submit_peer = entry->peers.back();
+			submit_peer->IncRef();
+		}
+		entry->expiring = true;
+		table->mp_server->GetTimerWheel()->Schedule(&entry->timer, NATNEG_COOKIE_TIME * 1000 - NN_COOKIE_REMOTE_DELAY);
+		table->mp_mutex->unlock();
+
+		if (submit_peer) {
+			table->SubmitRemote(submit_peer);
+			submit_peer->DecRef();
+		}
+	}
+	void CookieTable::SubmitRemote(Peer *peer) {
+		NNBackendRequest req;
+		req.type = NN::ENNQueryRequestType_SubmitClient;
+		peer->IncRef();
+		peer->AddPendingRequest();
+		req.peer = peer;
+		NN::m_task_pool->AddRequest(req);
+		OS::CMutex::SafeIncr(&m_num_remote_submits);
+	}
+	void CookieTable::AddDelivery(Peer *peer, OS::Address address, OS::Address private_address, std::vector<CookieDelivery> &deliveries) {
+		CookieDelivery delivery;
+		peer->IncRef();
+		delivery.peer = peer;
+		delivery.address = address;
+		delivery.private_address = private_address;
+		deliveries.push_back(delivery);
+	}
+	void CookieTable::AddDeliveries(CookieEntry *entry, std::vector<CookieDelivery> &deliveries) {
+		std::vector<Peer *>::iterator it = entry->peers.begin();
+		while (it != entry->peers.end()) {
+			AddDelivery(*it, entry->partner_address, entry->partner_private_address, deliveries);
+			it++;
+		}
+	}
+	void CookieTable::Deliver(Peer *from_peer, std::vector<CookieDelivery> &deliveries) {
+		std::vector<CookieDelivery>::iterator it = deliveries.begin();
+		while (it != deliveries.end()) {
+			CookieDelivery delivery = *it;
+			if (from_peer && from_peer != delivery.peer) {
+				//the caller holds from_peer's lock, taking another peer's here could deadlock against that peer delivering back, so it's handed to the backend threads
+				NNBackendRequest req;
+				req.type = NN::ENNQueryRequestType_DeliverPartner;
+				req.peer = delivery.peer;
+				req.address = delivery.address;
+				req.private_address = delivery.private_address;
+				NN::m_task_pool->AddRequest(req);
+			}
+			else {
+				delivery.peer->Lock();
+				delivery.peer->OnGotPeerAddress(delivery.address, delivery.private_address);
+				delivery.peer->Unlock();
+				delivery.peer->DecRef();
+			}
+			it++;
+		}
+	}
+	OS::MetricValue CookieTable::GetMetrics() {
+		OS::MetricValue arr_value, value;
+		value.type = OS::MetricType_Integer;
+
+		mp_mutex->lock();
+		value.value._int = m_entries.size();
+		value.key = "cookies";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+		mp_mutex->unlock();
+
+		value.value._int = OS::CMutex::SafeAdd(&m_num_submitted, 0);
+		value.key = "submitted";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = OS::CMutex::SafeAdd(&m_num_local_matches, 0);
+		value.key = "local_matches";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = OS::CMutex::SafeAdd(&m_num_remote_submits, 0);
+		value.key = "remote_submits";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = OS::CMutex::SafeAdd(&m_num_remote_matches, 0);
+		value.key = "remote_matches";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		arr_value.key = "cookie_table";
+		arr_value.type = OS::MetricType_Array;
+		return arr_value;
+	}
+}
@@ -0,0 +1,83 @@
+#ifndef _NN_COOKIE_TABLE_H
+#define _NN_COOKIE_TABLE_H
+#include <OS/OpenSpy.h>
+#include <OS/Mutex.h>
+#include <OS/Timer/TimerWheel.h>
+#include <OS/Analytics/Metric.h>
+#include <map>
+#include <vector>
+
+#include "structs.h"
+
+#define NATNEG_COOKIE_TIME 30 //seconds a client's cookie can be matched for
+#define NN_COOKIE_REMOTE_DELAY 50 //ms to wait for the partner to show up locally before the cookie is sent to redis
+
+namespace NN {
+	class Server;
+	class Peer;
+	class CookieTable;
+
+	typedef std::pair<NNCookieType, int> CookieKey; //cookie, client index
+
+	typedef struct {
+		CookieTable *table;
+		CookieKey key;
+		std::vector<Peer *> peers; //every local peer of the client, each holds a reference
+		OS::Address address, private_address; //of the latest to submit
+
+		bool has_partner;
+		OS::Address partner_address, partner_private_address;
+
+		bool remote_submitted;
+		bool expiring;
+		OS::TimerWheelEntry timer; //first the remote delay, then the expiry
+	} CookieEntry;
+
+	typedef struct {
+		Peer *peer; //holds a reference
+		OS::Address address, private_address;
+	} CookieDelivery;
+
+	/*
+		Matches the two clients of a natneg session on this node, without going through redis.
+		A client which doesn't find its partner locally is only sent to redis after NN_COOKIE_REMOTE_DELAY,
+		most partners arrive at the same node within that, so their cookies never leave the process.
+		Entries are only deleted by their own timer, so a partner can still be matched to a peer which has gone.
+	*/
+	class CookieTable {
+	public:
+		CookieTable(NN::Server *server);
+		~CookieTable();
+
+		//adds the peer's cookie, and connects it to its partner if that's already here
+		void Submit(Peer *peer);
+		void RemovePeer(Peer *peer);
+
+		//address of the partner with client_idx, from another node or from redis
+		void DeliverRemote(NNCookieType cookie, int client_idx, OS::Address address, OS::Address private_address);
+
+		void SetNodeID(int node_id) { m_node_id = node_id; };
+		int GetNodeID() { return m_node_id; };
+
+		OS::MetricValue GetMetrics();
+	private:
+		static void OnEntryTimer(void *extra);
+		void SubmitRemote(Peer *peer);
+		static void AddDelivery(Peer *peer, OS::Address address, OS::Address private_address, std::vector<CookieDelivery> &deliveries);
+		static void AddDeliveries(CookieEntry *entry, std::vector<CookieDelivery> &deliveries);
+		//partners are told outside of mp_mutex, as it's taken with a driver's lock held
+		static void Deliver(Peer *from_peer, std::vector<CookieDelivery> &deliveries);
+
+		NN::Server *mp_server;
+		std::map<CookieKey, CookieEntry *> m_entries;
+		int m_node_id;
+
+		uint32_t m_num_submitted;
+		uint32_t m_num_local_matches;
+		uint32_t m_num_remote_submits;
+		uint32_t m_num_remote_matches;
+
+		OS::CMutex *mp_mutex;
+	};
+}
+#endif //_NN_COOKIE_TABLE_H
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <algorithm>
 #include "NNServer.h"
+#include <OS/Net/NetServer.h>
 #include <OS/legacy/buffwriter.h>
 
 #include "NNPeer.h"
@@ -30,10 +31,13 @@ namespace NN {
 
 		gettimeofday(&m_server_start, NULL);
 
+
+		OS::TimerWheel::InitEntry(&m_reap_timer, Driver::OnReapTimer, this);
+
 		mp_mutex = OS::CreateMutex();
-		mp_thread = OS::CreateThread(Driver::TaskThread, this, true);
 	}
 	Driver::~Driver() {
+		m_server->GetTimerWheel()->Cancel(&m_reap_timer);
 		std::vector<Peer *>::iterator it = m_connections.begin();
 		while (it != m_connections.end()) {
 			Peer *peer = *it;
@@ -41,125 +45,146 @@ namespace NN {
 			delete peer;
 			it++;
 		}
-		delete mp_thread;
+		std::vector<UDPBatch *>::iterator it2 = m_batches.begin();
+		while (it2 != m_batches.end()) {
+			delete *it2;
+			it2++;
+		}
 		delete mp_mutex;
 	}
-	void *Driver::TaskThread(OS::CThread *thread) {
-		Driver *driver = (Driver *)thread->getParams();
-		for (;;) {
-			driver->mp_mutex->lock();
-			driver->TickConnections();
-			std::vector<Peer *>::iterator it = driver->m_connections.begin();
-			while (it != driver->m_connections.end()) {
-				Peer *peer = *it;
-				if (peer->ShouldDelete() && std::find(driver->m_peers_to_delete.begin(), driver->m_peers_to_delete.end(), peer) == driver->m_peers_to_delete.end()) {
-					//marked for delection, dec reference and delete when zero
-					it = driver->m_connections.erase(it);
-					peer->DecRef();
-					driver->m_peers_to_delete.push_back(peer);
-
-					driver->m_stats_queue.push(peer->GetPeerStats());
-
-					driver->m_server->UnregisterSocket(peer);
-					continue;
-				}
-				it++;
-			}
+	void Driver::OnPeerThink(INetPeer *inet_peer) {
+		Peer *peer = (Peer *)inet_peer;
+		peer->Lock();
+		if (!peer->ShouldDelete()) {
+			peer->think(false);
+		}
+		bool should_delete = peer->ShouldDelete();
+		if (!should_delete) {
+			peer->ScheduleThink(peer->GetThinkDelay());
+		}
+		peer->Unlock();
 
-			it = driver->m_peers_to_delete.begin();
-			while (it != driver->m_peers_to_delete.end()) {
-				NN::Peer *p = *it;
-				if (p->GetRefCount() == 0) {
-					delete p;
-					it = driver->m_peers_to_delete.erase(it);
-					continue;
-				}
-				it++;
+		if (should_delete) {
+			mp_mutex->lock();
+			DeletePeer(peer);
+			mp_mutex->unlock();
+		}
+	}
+	void Driver::DeletePeer(Peer *peer) {
+		if (!NetPeerListRemove(m_connections, peer)) {
+			return;
+		}
+		//marked for delection, dec reference and delete when zero
+		OS::Address address = peer->getAddress();
+		m_peer_index.Remove(address.ip, address.port, peer);
+		peer->CancelThink();
+		NN::m_cookie_table->RemovePeer(peer);
+		peer->DecRef();
+		m_peers_to_delete.push_back(peer);
+
+		m_server->UnregisterSocket(peer);
+		m_server->GetTimerWheel()->Schedule(&m_reap_timer, DRIVER_REAP_TIME, true);
+	}
+	void Driver::OnReapTimer(void *extra) {
+		Driver *driver = (Driver *)extra;
+		driver->mp_mutex->lock();
+		std::vector<Peer *>::iterator it = driver->m_peers_to_delete.begin();
+		while (it != driver->m_peers_to_delete.end()) {
+			NN::Peer *p = *it;
+			if (p->GetRefCount() == 0) {
+				delete p;
+				it = driver->m_peers_to_delete.erase(it);
+				continue;
 			}
-			driver->mp_mutex->unlock();
-			OS::Sleep(DRIVER_THREAD_TIME);
+			it++;
 		}
+		if (!driver->m_peers_to_delete.empty()) {
+			driver->m_server->GetTimerWheel()->Schedule(&driver->m_reap_timer, DRIVER_REAP_TIME, true);
+		}
+		driver->mp_mutex->unlock();
 	}
 	void Driver::think(bool listener_waiting) {
 		if (listener_waiting) {
-			char recvbuf[MAX_DATA_SIZE + 1];
-
-			struct sockaddr_in si_other;
-			socklen_t slen = sizeof(struct sockaddr_in);
-
-			int len = recvfrom(m_sd, (char *)&recvbuf, sizeof(recvbuf), 0, (struct sockaddr *)&si_other, &slen);
-
-			Peer *peer = NULL;
-			if (len > 0) {
-				peer = find_or_create(&si_other);
-			}
-			else {
-				peer = find_client(&si_other);
-			}
-			if (peer) {
-				if (len > 0) {
-					recvbuf[len] = 0;
-					peer->handle_packet((char *)&recvbuf, len);
+			/*
+				edge triggered, keep reading until the socket is drained. replies are coalesced until EndBatch
+				the driver lock is only held to look the peer up, packets for different peers are handled in parallel
+			*/
+			UDPBatch *batch = AcquireBatch();
+			batch->BeginBatch();
+			int count;
+			while ((count = batch->Receive()) > 0) {
+				for (int i = 0; i < count; i++) {
+					UDPDatagram *datagram = batch->GetDatagram(i);
+					if (datagram->len <= 0) {
+						continue;
+					}
+					Peer *peer = find_or_create(&datagram->address);
+					if (peer) {
+						peer->Lock();
+						peer->handle_packet(datagram->buffer, datagram->len);
+						//most packets move a deadline, eg the natify wait or a connect retry
+						peer->ScheduleThink(peer->ShouldDelete() ? 0 : peer->GetThinkDelay());
+						peer->Unlock();
+						peer->DecRef();
+					}
 				}
-				else if (len < 0) {
-					peer->SetDelete(true);
+				if (count < UDP_BATCH_SIZE) {
+					break;
 				}
 			}
+			batch->EndBatch();
+			ReleaseBatch(batch);
+		}
+	}
+	UDPBatch *Driver::AcquireBatch() {
+		UDPBatch *batch = NULL;
+		mp_mutex->lock();
+		if (!m_batches.empty()) {
+			batch = m_batches.back();
+			m_batches.pop_back();
 		}
+		mp_mutex->unlock();
+		if (!batch) {
+			batch = new UDPBatch(m_sd, MAX_DATA_SIZE);
+		}
+		return batch;
+	}
+	void Driver::ReleaseBatch(UDPBatch *batch) {
+		mp_mutex->lock();
+		m_batches.push_back(batch);
+		mp_mutex->unlock();
 	}
 
 	Peer *Driver::find_client(struct sockaddr_in *address) {
-		std::vector<Peer *>::iterator it = m_connections.begin();
-		while (it != m_connections.end()) {
-			Peer *peer = *it;
-			const struct sockaddr_in peer_address = peer->getAddress().GetInAddr();
-			if (address->sin_port == peer_address.sin_port && address->sin_addr.s_addr == peer_address.sin_addr.s_addr) {
-				return peer;
-			}
-			it++;
-		}
-		return NULL;
+		mp_mutex->lock();
+		Peer *ret = m_peer_index.Find(address);
+		mp_mutex->unlock();
+		return ret;
 	}
 	Peer *Driver::find_or_create(struct sockaddr_in *address) {
-		std::vector<Peer *>::iterator it = m_connections.begin();
-		while (it != m_connections.end()) {
-			Peer *peer = *it;
-			const struct sockaddr_in peer_address = peer->getAddress().GetInAddr();
-			if (address->sin_port == peer_address.sin_port && address->sin_addr.s_addr == peer_address.sin_addr.s_addr) {
-				return peer;
-			}
-			it++;
+		mp_mutex->lock();
+		Peer *peer = m_peer_index.Find(address);
+		if (peer) {
+			peer->IncRef();
+			mp_mutex->unlock();
+			return peer;
 		}
 		Peer *ret = new Peer(this, address, m_sd);
-		m_connections.push_back(ret);
+		NetPeerListAdd(m_connections, ret);
+		m_peer_index.Insert(address, ret);
+		ret->ScheduleThink(ret->GetThinkDelay());
+		ret->IncRef();
+		mp_mutex->unlock();
 		return ret;
 	}
 
 
-	uint32_t Driver::getBindIP() {
-		return htonl(m_local_addr.sin_addr.s_addr);
+	int Driver::SendDatagram(const struct sockaddr_in *address, const void *data, int len) {
+		return UDPBatch::SendFromThread(m_sd, address, data, len);
 	}
 
-	void Driver::OnGotCookie(NNCookieType cookie, int client_idx, OS::Address address, OS::Address private_address) {
-		const std::vector < INetPeer * > peers = this->getPeers(true);
-		std::vector<INetPeer *>::const_iterator it = peers.begin();
-		while (it != peers.end()) {
-			Peer *p = (Peer *)*it;
-			if(p->GetCookie() == cookie && p->GetClientIndex() != client_idx && p->GetClientIndex() != -1) {
-				p->OnGotPeerAddress(address, private_address);
-			}
-			p->DecRef();
-			it++;
-		}
-	}
-
-	void Driver::TickConnections() {
-		std::vector<Peer *>::iterator it = m_connections.begin();
-		while (it != m_connections.end()) {
-			Peer *p = *it;
-			p->think(false);
-			it++;
-		}
+	uint32_t Driver::getBindIP() {
+		return htonl(m_local_addr.sin_addr.s_addr);
 	}
 
 	const std::vector<INetPeer *> Driver::getPeers(bool inc_ref) {
@@ -185,41 +210,4 @@ namespace NN {
 	int Driver::getListenerSocket() {
 		return m_sd;
 	}
-	OS::MetricInstance Driver::GetMetrics() {
-		OS::MetricInstance peer_metric;
-		OS::MetricValue arr_value2, value, peers;
-
-		mp_mutex->lock();
-
-		std::vector<Peer *>::iterator it = m_connections.begin();
-		while (it != m_connections.end()) {
-			INetPeer * peer = (INetPeer *)*it;
-			OS::Address address = *peer->getAddress();
-			value = peer->GetMetrics().value;
-
-			value.key = address.ToString(false);
-
-			peers.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, value));
-			it++;
-		}
-
-		while (!m_stats_queue.empty()) {
-			PeerStats stats = m_stats_queue.front();
-			m_stats_queue.pop();
-			peers.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, Peer::GetMetricItemFromStats(stats)));
-		}
-
-		peers.key = "peers";
-		arr_value2.type = OS::MetricType_Array;
-		peers.type = OS::MetricType_Array;
-		arr_value2.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, peers));
-
-
-		peer_metric.key = OS::Address(m_local_addr).ToString(false);
-		arr_value2.key = peer_metric.key;
-		peer_metric.value = arr_value2;
-
-		mp_mutex->unlock();
-		return peer_metric;
-	}
 }
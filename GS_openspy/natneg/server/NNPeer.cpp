@@ -4,9 +4,20 @@
 
 #include "structs.h"
 #include "NNBackend.h"
+#include <algorithm>
 
 
 namespace NN {
+	//milliseconds until retry_time has passed since the last try
+	static int GetRetryDelay(const struct timeval &last_try, int retry_time) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		long long elapsed = (now.tv_sec - last_try.tv_sec) * 1000LL + (now.tv_usec - last_try.tv_usec) / 1000;
+		if (elapsed >= retry_time) {
+			return 0;
+		}
+		return retry_time - elapsed;
+	}
 	Peer::Peer(Driver *driver, struct sockaddr_in *address_info, int sd) : INetPeer(driver, address_info, sd) {
 		m_delete_flag = false;
 		m_timeout_flag = false;
@@ -22,15 +33,24 @@ namespace NN {
 		m_got_init = false;
 		m_got_preinit = false;
 		m_sent_connect = false;
+		m_got_connect_ack = false;
+		m_preinit_retries = 0;
+		m_connect_retries = 0;
 		memset(&m_ert_test_time, 0, sizeof(m_ert_test_time));
 		memset(&m_init_time, 0, sizeof(m_init_time));
+		memset(&m_last_preinit_ready, 0, sizeof(m_last_preinit_ready));
+		memset(&m_last_connect, 0, sizeof(m_last_connect));
+		gettimeofday(&m_last_recv, NULL);
 		ResetMetrics();
+		m_peer_stats.pending_requests = 0; //not reset with the other stats, it's a count of what's in flight
 		m_peer_stats.m_address = *address_info;
+		mp_mutex = OS::CreateMutex();
 		OS::LogText(OS::ELogLevel_Info, "[%s] New connection",OS::Address(m_address_info).ToString().c_str());
 
 	}
 	Peer::~Peer() {
 		OS::LogText(OS::ELogLevel_Info, "[%s] Connection closed, connect sent: %d",OS::Address(m_address_info).ToString().c_str(), m_sent_connect);
+		delete mp_mutex;
 	}
 	void Peer::think(bool waiting_packet) {
 		struct timeval time_now;
@@ -57,7 +77,11 @@ namespace NN {
 			if (m_got_natify_request && time_now.tv_sec - m_ert_test_time.tv_sec > NN_NATIFY_WAIT_TIME) {
 				if (m_found_partner) {
 					if (m_got_preinit) {
-						SendPreInitPacket(NN_PREINIT_READY);
+						if (m_preinit_retries < PREINIT_RETRY_COUNT && GetRetryDelay(m_last_preinit_ready, PREINIT_RETRY_TIME) == 0) {
+							m_preinit_retries++;
+							gettimeofday(&m_last_preinit_ready, NULL);
+							SendPreInitPacket(NN_PREINIT_READY);
+						}
 					}
 					else {
 						SendConnectPacket(m_peer_address);
@@ -65,6 +89,37 @@ namespace NN {
 				}
 			}
 		}
+		if (m_sent_connect && !m_got_connect_ack && m_connect_retries < PING_RETRY_COUNT && GetRetryDelay(m_last_connect, PING_RETRY_TIME) == 0) {
+			m_connect_retries++;
+			gettimeofday(&m_last_connect, NULL);
+			WriteConnectPacket(m_peer_address);
+		}
+	}
+	int Peer::GetThinkDelay() {
+		int delay = GetDelayUntil(m_last_recv, NN_TIMEOUT_TIME);
+		if (m_init_time.tv_sec != 0) {
+			if (!m_got_init) {
+				delay = std::min(delay, GetDelayUntil(m_init_time, NN_INIT_WAIT_TIME));
+			}
+			if (!m_found_partner) {
+				delay = std::min(delay, GetDelayUntil(m_init_time, NN_DEADBEAT_TIME));
+			}
+		}
+		if (m_found_partner && m_got_natify_request) {
+			int natify_delay = GetDelayUntil(m_ert_test_time, NN_NATIFY_WAIT_TIME);
+			if (m_got_preinit) {
+				if (m_preinit_retries < PREINIT_RETRY_COUNT) {
+					delay = std::min(delay, std::max(natify_delay, GetRetryDelay(m_last_preinit_ready, PREINIT_RETRY_TIME)));
+				}
+			}
+			else if (!m_sent_connect) {
+				delay = std::min(delay, natify_delay);
+			}
+		}
+		if (m_sent_connect && !m_got_connect_ack && m_connect_retries < PING_RETRY_COUNT) {
+			delay = std::min(delay, GetRetryDelay(m_last_connect, PING_RETRY_TIME));
+		}
+		return delay;
 	}
 	void Peer::handle_packet(char *recvbuf, int len) {
 		if(len <= 0) {
@@ -110,6 +165,7 @@ namespace NN {
 			case NN_CONNECT_PING:
 			break;
 			case NN_CONNECT_ACK:
+				m_got_connect_ack = true;
 				if (m_client_version <= 2) {
 					m_delete_flag = true;
 				}
@@ -139,12 +195,12 @@ namespace NN {
 
 		OS::LogText(OS::ELogLevel_Info, "[%s] Got init - version: %d, client idx: %d, cookie: %d, game: %s", OS::Address(m_address_info).ToString().c_str(), packet->version, m_client_index, m_cookie, m_gamename.c_str());
 
-		SubmitClient();
-
-		
 		packet->packettype = NN_INITACK;
 		sendPacket(packet);
 
+		//a partner already on this node is connected straight away, after the ack
+		SubmitClient();
+
 		if (m_found_partner) {
 			SendConnectPacket(m_peer_address);
 		}
@@ -229,7 +285,7 @@ namespace NN {
 
 		m_peer_stats.packets_out++;
 		m_peer_stats.bytes_out += size;
-		sendto(m_sd,(char *)packet,size,0,(struct sockaddr *)&m_address_info,sizeof(struct sockaddr));
+		((Driver *)GetDriver())->SendDatagram(&m_address_info, packet, size);
 	}
 	OS::Address Peer::getAddress() {
 		return OS::Address(m_address_info);
@@ -268,7 +324,8 @@ namespace NN {
 			}
 		}
 
-		SubmitClient(); //resubmit for other client
+		//the natify wait or connect retries may now be due before the peer's next think
+		ScheduleThink(GetThinkDelay());
 	}
 	void Peer::sendPeerInitError(uint8_t error) {
 		NatNegPacket p;
@@ -286,6 +343,12 @@ namespace NN {
 		else {
 			return;
 		}
+		m_got_connect_ack = false;
+		m_connect_retries = 0;
+		gettimeofday(&m_last_connect, NULL);
+		WriteConnectPacket(address);
+	}
+	void Peer::WriteConnectPacket(OS::Address address) {
 		NatNegPacket p;
 		struct sockaddr_in remote_addr = address.GetInAddr();
 
@@ -313,77 +376,23 @@ namespace NN {
 		sendPacket(&p);
 	}
 	void Peer::SubmitClient() {
-		NNBackendRequest req;
-		req.type = NN::ENNQueryRequestType_SubmitClient;
-		this->IncRef();
-		req.peer = this;
-		m_peer_stats.pending_requests++;
-		NN::m_task_pool->AddRequest(req);
+		AddPendingRequest();
+		NN::m_cookie_table->Submit(this);
+		//a submit to redis counts as its own request, until the backend has run it
+		RemovePendingRequest();
 	}
-	OS::MetricInstance Peer::GetMetrics() {
-		OS::MetricInstance peer_metric;
-
-		peer_metric.value = GetMetricItemFromStats(m_peer_stats);
-		peer_metric.key = "peer";
-
-		ResetMetrics();
-
-		return peer_metric;
+	void Peer::AddPendingRequest() {
+		OS::CMutex::SafeIncr(&m_peer_stats.pending_requests);
 	}
-
-	OS::MetricValue Peer::GetMetricItemFromStats(PeerStats stats) {
-		OS::MetricValue arr_value, value;
-		value.value._str = stats.m_address.ToString(false);
-		value.key = "ip";
-		value.type = OS::MetricType_String;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.disconnected;
-		value.key = "disconnected";
-		value.type = OS::MetricType_Integer;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.type = OS::MetricType_Integer;
-		value.value._int = stats.bytes_in;
-		value.key = "bytes_in";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.bytes_out;
-		value.key = "bytes_out";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.packets_in;
-		value.key = "packets_in";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.packets_out;
-		value.key = "packets_out";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.pending_requests;
-		value.key = "pending_requests";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-		arr_value.type = OS::MetricType_Array;
-
-		value.type = OS::MetricType_String;
-		value.key = "gamename";
-		value.value._str = stats.from_game.gamename;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.type = OS::MetricType_Integer;
-		value.key = "version";
-		value.value._int = stats.version;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		arr_value.key = stats.m_address.ToString(false);
-		return arr_value;
+	void Peer::RemovePendingRequest() {
+		OS::CMutex::SafeDecr(&m_peer_stats.pending_requests);
 	}
+
 	void Peer::ResetMetrics() {
 		m_peer_stats.bytes_in = 0;
 		m_peer_stats.bytes_out = 0;
 		m_peer_stats.packets_in = 0;
 		m_peer_stats.packets_out = 0;
-		m_peer_stats.pending_requests = 0;
 		m_peer_stats.from_game.gameid = 0;
 		m_peer_stats.from_game.secretkey[0] = 0;
 		m_peer_stats.from_game.gamename[0] = 0;
@@ -15,7 +15,7 @@ namespace NN {
 	class Driver;
 
 	typedef struct _PeerStats {
-		int pending_requests;
+		uint32_t pending_requests; //submits the cookie table or the backend hasn't finished with
 		int version;
 
 		long long bytes_in;
@@ -36,8 +36,13 @@ namespace NN {
 		~Peer();
 		
 		void think(bool waiting_packet);
+		int GetThinkDelay();
 		void handle_packet(char *recvbuf, int len);		
 
+		//handle_packet, think and partner deliveries can run on different threads, they're serialized on the peer's mutex
+		void Lock() { mp_mutex->lock(); };
+		void Unlock() { mp_mutex->unlock(); };
+
 		int GetSocket() { return m_sd; };
 		OS::Address getAddress();
 		OS::Address getPrivateAddress() { return m_private_address; };
@@ -48,16 +53,16 @@ namespace NN {
 		uint8_t GetClientIndex() { return m_client_index; }
 
 		void OnGotPeerAddress(OS::Address address, OS::Address private_address);
+		void AddPendingRequest();
+		void RemovePendingRequest();
 		std::string getGamename() { return m_gamename; };
 
-		static OS::MetricValue GetMetricItemFromStats(PeerStats stats);
-		OS::MetricInstance GetMetrics();
-		PeerStats GetPeerStats() { if (m_delete_flag) m_peer_stats.disconnected = true; return m_peer_stats; };
 	protected:
 		void ResetMetrics();
 		static int packetSizeFromType(uint8_t type);
 
 		void SendConnectPacket(OS::Address address);
+		void WriteConnectPacket(OS::Address address);
 		void SendPreInitPacket(uint8_t state);
 		void sendPeerInitError(uint8_t error);
 
@@ -93,6 +98,14 @@ namespace NN {
 		bool m_got_natify_request;
 		bool m_got_preinit;
 		bool m_sent_connect;
+		bool m_got_connect_ack;
+
+		//once the partner is found, NN_PREINIT_READY is resent every PREINIT_RETRY_TIME, up to PREINIT_RETRY_COUNT times
+		struct timeval m_last_preinit_ready;
+		int m_preinit_retries;
+		//and NN_CONNECT every PING_RETRY_TIME until it's acked, up to PING_RETRY_COUNT times
+		struct timeval m_last_connect;
+		int m_connect_retries;
 
 		PeerStats m_peer_stats;
 	};
@@ -49,6 +49,7 @@ int main() {
     delete g_gameserver;
     delete g_driver;
 
+    Chat::ShutdownTaskPool();
     OS::Shutdown();
 
     return 0;
@@ -1,9 +1,12 @@
 #include "ChatBackend.h"
 #include "ChatPeer.h"
 #include <sstream>
+#include <algorithm>
 #include <OS/KVReader.h>
 #include <OS/legacy/helpers.h>
+#include <OS/Analytics/Instrument.h>
 namespace Chat {
+	OS::LatencyHistogram g_chat_request_span("chat_request", "Chat backend requests, from being submitted until they were done");
 
 	/*
 		SQL for basic channel permissions
@@ -36,57 +39,150 @@ namespace Chat {
 	const char *mp_chan_pk_name = "CHANID";
 	const char *mp_usermode_pk_name = "USERMODEID";
 	const char *mp_chanprops_pk_name = "CHANPROPSID";
+	const char *mp_node_pk_name = "CHATNODEID";
 	const char *chat_messaging_channel = "chat.messaging";
-	ChatBackendTask *ChatBackendTask::m_task_singleton = NULL;
-	ChatBackendTask::ChatBackendTask() {
-		m_flag_push_task = false;
+	OS::TaskPool<ChatBackendTask, ChatQueryRequest> *m_task_pool = NULL;
+
+	//shared by all workers
+	std::vector<Chat::Driver *> m_drivers;
+	int m_node_id = 0; //tags what this node publishes, so its own messages aren't delivered twice
+	std::map<int, std::vector<Peer *> > m_channel_members; //channel id -> local peers on it
+	OS::CMutex *mp_members_mutex = NULL;
+	std::map<std::string, int> m_channel_ids; //lowercased name -> id, of channels loaded by this node which haven't been deleted or left by every local peer
+	std::map<int, std::string> m_channel_names; //the reverse of m_channel_ids
+	OS::CMutex *mp_channel_keys_mutex = NULL;
+	std::map<Peer *, ChatPeerRequests> m_peer_requests;
+	OS::CMutex *mp_peer_requests_mutex = NULL;
+
+	redisAsyncContext *mp_redis_async_connection = NULL;
+	struct event_base *mp_event_base = NULL;
+	OS::CThread *mp_async_thread = NULL;
+
+	ChatBackendTask::ChatBackendTask(int thread_index) {
 		struct timeval t;
 		t.tv_usec = 0;
 		t.tv_sec = 3;
 
-		mp_redis_connection = redisConnectWithTimeout(OS_REDIS_SERV, OS_REDIS_PORT, t);
-		mp_redis_async_retrival_connection = redisConnectWithTimeout(OS_REDIS_SERV, OS_REDIS_PORT, t);
-
-		mp_async_thread = OS::CreateThread(setup_redis_async, this, true);
+		m_thread_index = thread_index;
 
-		mp_mutex = OS::CreateMutex();
-		mp_thread = OS::CreateThread(ChatBackendTask::TaskThread, this, true);
+		mp_redis_connection = redisConnectWithTimeout(OS_REDIS_SERV, OS_REDIS_PORT, t);
 
 		m_permission_name_map[EChanClientFlags_Owner] = "Channel Owner";
 		m_permission_name_map[EChanClientFlags_Op] = "Channel Operator";
 		m_permission_name_map[EChanClientFlags_HalfOp] = "Channel Half-Operator";
 		m_permission_name_map[EChanClientFlags_Voice] = "Channel Voice";
+
+		mp_mutex = OS::CreateMutex();
+		mp_thread = OS::CreateThread(ChatBackendTask::TaskThread, this, true);
 	}
 	ChatBackendTask::~ChatBackendTask() {
 		delete mp_thread;
-		delete mp_async_thread;
 		delete mp_mutex;
 
 		redisFree(mp_redis_connection);
-		redisFree(mp_redis_async_retrival_connection);
-		redisAsyncFree(mp_redis_async_connection);
-		event_base_free(mp_event_base);
 	}
-	void ChatBackendTask::flagPushTask() {
-		m_flag_push_task = true;
+
+	void ChatBackendTask::AddDriver(Chat::Driver *driver) {
+		m_drivers.push_back(driver);
 	}
-	ChatBackendTask *ChatBackendTask::getQueryTask() {
-		if(!ChatBackendTask::m_task_singleton) {
-			ChatBackendTask::m_task_singleton = new ChatBackendTask();
+	void ChatBackendTask::RemoveDriver(Chat::Driver *driver) {
+		std::vector<Chat::Driver *>::iterator it = std::find(m_drivers.begin(), m_drivers.end(), driver);
+		if(it != m_drivers.end()) {
+			m_drivers.erase(it);
+		}
+	}
+	void ChatBackendTask::SubmitRequest(ChatQueryRequest req, uint32_t channel_key) {
+		gettimeofday(&req.submit_time, NULL);
+		req.channel_key = channel_key;
+		if(req.peer == NULL) {
+			DispatchRequest(req);
+			return;
+		}
+		mp_peer_requests_mutex->lock();
+		ChatPeerRequests &requests = m_peer_requests[req.peer];
+		if(requests.in_flight > 0 && (requests.channel_key != channel_key || !requests.deferred.empty())) {
+			requests.deferred.push_back(req);
+		} else {
+			requests.channel_key = channel_key;
+			requests.in_flight++;
+			DispatchRequest(req);
 		}
-		return ChatBackendTask::m_task_singleton;
+		mp_peer_requests_mutex->unlock();
 	}
-	void ChatBackendTask::Shutdown() {
-		ChatBackendTask *task = getQueryTask();
-
-		delete task;
+	void ChatBackendTask::DispatchRequest(ChatQueryRequest req) {
+		if(req.channel_key != 0) {
+			m_task_pool->AddRequestByKey(req, req.channel_key);
+		} else {
+			m_task_pool->AddRequest(req, req.peer);
+		}
 	}
+	//called once the request's callback has returned, sends on the peer's held requests once nothing else of its is running
+	void ChatBackendTask::CompleteRequest(ChatQueryRequest req) {
+		if(req.peer == NULL) {
+			return;
+		}
+		mp_peer_requests_mutex->lock();
+		std::map<Peer *, ChatPeerRequests>::iterator it = m_peer_requests.find(req.peer);
+		if(it != m_peer_requests.end() && --(*it).second.in_flight == 0) {
+			ChatPeerRequests &requests = (*it).second;
+			if(requests.deferred.empty()) {
+				m_peer_requests.erase(it);
+			} else {
+				//everything up to the next change of key can run at once
+				requests.channel_key = requests.deferred.front().channel_key;
+				while(!requests.deferred.empty() && requests.deferred.front().channel_key == requests.channel_key) {
+					requests.in_flight++;
+					DispatchRequest(requests.deferred.front());
+					requests.deferred.pop_front();
+				}
+			}
+		}
+		mp_peer_requests_mutex->unlock();
+	}
+	uint32_t ChatBackendTask::GetChannelKey(std::string name) {
+		std::transform(name.begin(), name.end(), name.begin(), ::tolower);
 
-	void ChatBackendTask::AddDriver(Chat::Driver *driver) {
-		m_drivers.push_back(driver);
+		mp_channel_keys_mutex->lock();
+		std::map<std::string, int>::iterator it = m_channel_ids.find(name);
+		if(it != m_channel_ids.end()) {
+			uint32_t channel_id = (*it).second;
+			mp_channel_keys_mutex->unlock();
+			return channel_id;
+		}
+		mp_channel_keys_mutex->unlock();
+
+		//FNV-1a, channel names aren't case sensitive
+		uint32_t hash = 2166136261U;
+		for(unsigned int i=0;i<name.length();i++) {
+			hash ^= (uint8_t)name[i];
+			hash *= 16777619U;
+		}
+		return hash | 1;
 	}
-	void ChatBackendTask::RemoveDriver(Chat::Driver *driver) {
+	//set before the request's callback sees the channel, so anything submitted knowing its id is keyed the same
+	void ChatBackendTask::SetChannelKey(ChatChannelInfo channel) {
+		if(channel.channel_id == 0 || channel.name.empty()) {
+			return;
+		}
+		std::transform(channel.name.begin(), channel.name.end(), channel.name.begin(), ::tolower);
 
+		mp_channel_keys_mutex->lock();
+		std::map<std::string, int>::iterator it = m_channel_ids.find(channel.name);
+		if(it != m_channel_ids.end() && (*it).second != channel.channel_id) {
+			m_channel_names.erase((*it).second); //deleted by another node and recreated
+		}
+		m_channel_ids[channel.name] = channel.channel_id;
+		m_channel_names[channel.channel_id] = channel.name;
+		mp_channel_keys_mutex->unlock();
+	}
+	void ChatBackendTask::RemoveChannelKey(int channel_id) {
+		mp_channel_keys_mutex->lock();
+		std::map<int, std::string>::iterator it = m_channel_names.find(channel_id);
+		if(it != m_channel_names.end()) {
+			m_channel_ids.erase((*it).second);
+			m_channel_names.erase(it);
+		}
+		mp_channel_keys_mutex->unlock();
 	}
 
 	void ChatBackendTask::SubmitGetClientInfoByName(std::string name, ChatQueryCB cb, Peer *peer, void *extra) {
@@ -96,7 +192,7 @@ namespace Chat {
 		req.callback = cb;
 		req.peer = peer;
 		req.extra = extra;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req);
 	}
 	void ChatBackendTask::SubmitClientMessage(int target_id, std::string message, EChatMessageType message_type, ChatQueryCB cb, Peer *peer, void *extra) {
 		ChatQueryRequest req;
@@ -107,7 +203,7 @@ namespace Chat {
 		req.extra = extra;
 		req.message = message;
 		req.message_type = message_type;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req);
 	}
 	void ChatBackendTask::SubmitChannelMessage(int target_id, std::string message, EChatMessageType message_type, ChatQueryCB cb, Peer *peer, void *extra) {
 		ChatQueryRequest req;
@@ -118,7 +214,7 @@ namespace Chat {
 		req.extra = extra;
 		req.message = message;
 		req.message_type = message_type;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req, target_id);
 	}
 
 	void ChatBackendTask::SubmitFind_OrCreateChannel(ChatQueryCB cb, Peer *peer, void *extra, std::string channel) {
@@ -128,7 +224,7 @@ namespace Chat {
 		req.peer = peer;
 		req.extra = extra;
 		req.query_name = OS::strip_whitespace(channel);
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req, GetChannelKey(req.query_name));
 	}
 	void ChatBackendTask::SubmitFindChannel(ChatQueryCB cb, Peer *peer, void *extra, std::string channel) {
 		ChatQueryRequest req;
@@ -137,7 +233,7 @@ namespace Chat {
 		req.peer = peer;
 		req.extra = extra;
 		req.query_name = OS::strip_whitespace(channel);
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req, GetChannelKey(req.query_name));
 	}
 	void ChatBackendTask::SubmitFindChannelByID(ChatQueryCB cb, Peer *peer, void *extra, int id) {
 		ChatQueryRequest req;
@@ -146,7 +242,7 @@ namespace Chat {
 		req.peer = peer;
 		req.extra = extra;
 		req.query_data.channel_info.channel_id = id;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req, id);
 	}
 	void ChatBackendTask::PerformFind_OrCreateChannel(ChatQueryRequest task_params, bool no_create) {
 		struct Chat::_ChatQueryResponse resp;
@@ -208,47 +304,54 @@ namespace Chat {
 		req.query_data.channel_info.name = channel;
 		req.query_data.client_info.name = user;
 		req.set_keys = set_data_map;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req, GetChannelKey(channel));
 	}
 	void ChatBackendTask::LoadClientInfoByID(ChatClientInfo &info, int client_id) {
+		redisReply *reply;
 		info.client_id = client_id;
-		freeReplyObject(redisCommand(mp_redis_connection, "SELECT %d", OS::ERedisDB_Chat));
-		redisReply *reply = (redisReply *)redisCommand(mp_redis_connection, "HGET chat_client_%d nick", client_id);
-		if(reply->type == REDIS_REPLY_STRING) {
-			info.name = OS::strip_quotes(reply->str);
-		}
-		freeReplyObject(reply);
-		reply = (redisReply *)redisCommand(mp_redis_connection, "HGET chat_client_%d user", client_id);
-		if(reply->type == REDIS_REPLY_STRING) {
-			info.user = OS::strip_quotes(reply->str);
-		}
-		freeReplyObject(reply);
-		reply = (redisReply *)redisCommand(mp_redis_connection, "HGET chat_client_%d realname", client_id);
-		if(reply->type == REDIS_REPLY_STRING) {
-			info.realname = OS::strip_quotes(reply->str);
-		}
-		freeReplyObject(reply);
-		reply = (redisReply *)redisCommand(mp_redis_connection, "HGET chat_client_%d host", client_id);
-		if(reply->type == REDIS_REPLY_STRING) {
-			info.hostname = OS::strip_quotes(reply->str);
-		}
-		freeReplyObject(reply);
+		info.profileid = 0;
+		info.operflags = 0;
 
+		//the client hash and its custom keys are read in one round trip
+		redisAppendCommand(mp_redis_connection, "SELECT %d", OS::ERedisDB_Chat);
+		redisAppendCommand(mp_redis_connection, "HGETALL chat_client_%d", client_id);
+		redisAppendCommand(mp_redis_connection, "HGETALL chat_client_%d_custkeys", client_id);
 
-		reply = (redisReply *)redisCommand(mp_redis_connection, "HGET chat_client_%d ip", client_id);
-		if(reply->type == REDIS_REPLY_STRING) {
-			info.ip = OS::Address(OS::strip_quotes(std::string(reply->str)).c_str());
+		if(redisGetReply(mp_redis_connection, (void **)&reply) == REDIS_OK) {
+			freeReplyObject(reply);
 		}
-		freeReplyObject(reply);
-
-		info.profileid = 0;
-		reply = (redisReply *)redisCommand(mp_redis_connection, "HGET chat_client_%d profileid", client_id);
-		if(reply->type == REDIS_REPLY_STRING) {
-			info.profileid = atoi(OS::strip_quotes(reply->str).c_str());
+		if(redisGetReply(mp_redis_connection, (void **)&reply) == REDIS_OK) {
+			for(unsigned int i=0;i+1<reply->elements;i+=2) {
+				if(reply->element[i]->type != REDIS_REPLY_STRING || reply->element[i+1]->type != REDIS_REPLY_STRING) {
+					continue;
+				}
+				std::string key = reply->element[i]->str;
+				std::string value = OS::strip_quotes(reply->element[i+1]->str);
+				if(key.compare("nick") == 0) {
+					info.name = value;
+				} else if(key.compare("user") == 0) {
+					info.user = value;
+				} else if(key.compare("realname") == 0) {
+					info.realname = value;
+				} else if(key.compare("host") == 0) {
+					info.hostname = value;
+				} else if(key.compare("ip") == 0) {
+					info.ip = OS::Address(value.c_str());
+				} else if(key.compare("profileid") == 0) {
+					info.profileid = atoi(value.c_str());
+				}
+			}
+			freeReplyObject(reply);
+		}
+		if(redisGetReply(mp_redis_connection, (void **)&reply) == REDIS_OK) {
+			for(unsigned int i=0;i+1<reply->elements;i+=2) {
+				if(reply->element[i]->type == REDIS_REPLY_STRING && reply->element[i+1]->type == REDIS_REPLY_STRING) {
+					info.custom_keys[OS::strip_quotes(reply->element[i]->str)] = OS::strip_quotes(reply->element[i+1]->str);
+				}
+			}
+			freeReplyObject(reply);
 		}
-		freeReplyObject(reply);
 
-		info.operflags = 0;
 		if(info.profileid != 0) {
 			reply = (redisReply *)redisCommand(mp_redis_connection, "HGET chat_opers %d", info.profileid);
 			if(reply->type == REDIS_REPLY_STRING) {
@@ -256,21 +359,6 @@ namespace Chat {
 			}
 			freeReplyObject(reply);
 		}
-
-		reply = (redisReply *)redisCommand(mp_redis_connection, "HKEYS chat_client_%d_custkeys", client_id);
-		for(unsigned int i=0;i<reply->elements;i++) {
-			redisReply *key_reply = (redisReply *)redisCommand(mp_redis_connection, "HGET chat_client_%d_custkeys %s", client_id,OS::strip_quotes(reply->element[i]->str).c_str());
-			if(key_reply && key_reply->type == REDIS_REPLY_INTEGER) {
-				std::ostringstream s;
-				s << key_reply->integer;
-				info.custom_keys[OS::strip_quotes(reply->element[i]->str)] = s.str();
-			} else if(key_reply && key_reply->type == REDIS_REPLY_STRING) {
-				info.custom_keys[OS::strip_quotes(reply->element[i]->str)] = OS::strip_quotes(key_reply->str);
-			}
-			freeReplyObject(key_reply);
-		}
-		freeReplyObject(reply);
-
 	}
 	void ChatBackendTask::LoadClientInfoByName(ChatClientInfo &info, std::string name) {
 		int client_id = 0;
@@ -294,14 +382,49 @@ namespace Chat {
 		free((void *)b64_msg);
 	}
 	void ChatBackendTask::PerformSendChannelMessage(ChatQueryRequest task_params) {
-		std::string kv_user = ClientInfoToKVString(task_params.peer->getClientInfo());
+		ChatQueuedChannelMessage queued_msg;
 		ChatChannelInfo channel = GetChannelByID(task_params.query_data.channel_info.channel_id);
-		std::string kv_chan = ChannelInfoToKVString(channel);
-		const char *b64_msg = OS::BinToBase64Str((const uint8_t*)task_params.message.c_str(),task_params.message.length());
-		freeReplyObject(redisCommand(mp_redis_connection, "PUBLISH %s \\type\\send_channel_msg\\msg_type\\%d%s%s\\msg\\%s\n",
-			chat_messaging_channel, task_params.message_type, kv_user.c_str(), kv_chan.c_str(), b64_msg));
 
-		free((void *)b64_msg);
+		queued_msg.from_user = task_params.peer->getClientInfo();
+		queued_msg.message_type = task_params.message_type;
+		queued_msg.message = task_params.message;
+
+		SendChannelMessageToLocalMembers(channel, queued_msg.from_user, queued_msg.message.c_str(), queued_msg.message_type);
+
+		m_outgoing_channels[channel.channel_id] = channel;
+		m_outgoing_channel_messages[channel.channel_id].push_back(queued_msg);
+	}
+	void ChatBackendTask::FlushChannelMessages() {
+		std::map<int, std::vector<ChatQueuedChannelMessage> >::iterator it = m_outgoing_channel_messages.begin();
+		while(it != m_outgoing_channel_messages.end()) {
+			std::string kv_chan = ChannelInfoToKVString(m_outgoing_channels[(*it).first]);
+			std::vector<ChatQueuedChannelMessage> &messages = (*it).second;
+			std::ostringstream s;
+			int count = 0;
+			std::vector<ChatQueuedChannelMessage>::iterator it2 = messages.begin();
+			while(it2 != messages.end()) {
+				ChatQueuedChannelMessage msg = *it2;
+				std::ostringstream prefix;
+				prefix << count << "_";
+
+				const char *b64_msg = OS::BinToBase64Str((const uint8_t*)msg.message.c_str(),msg.message.length());
+				s << "\\" << prefix.str() << "msg_type\\" << msg.message_type;
+				s << "\\" << prefix.str() << "msg\\" << b64_msg;
+				s << ClientInfoToKVString(msg.from_user, prefix.str());
+				free((void *)b64_msg);
+
+				it2++;
+				if(++count == CHAT_MAX_BATCHED_MESSAGES || it2 == messages.end()) {
+					freeReplyObject(redisCommand(mp_redis_connection, "PUBLISH %s \\type\\send_channel_msgs\\node_id\\%d\\count\\%d%s%s\n",
+						chat_messaging_channel, m_node_id, count, kv_chan.c_str(), s.str().c_str()));
+					s.str("");
+					count = 0;
+				}
+			}
+			it++;
+		}
+		m_outgoing_channel_messages.clear();
+		m_outgoing_channels.clear();
 	}
 	void ChatBackendTask::SubmitClientInfo(ChatQueryCB cb, Peer *peer, void *extra) {
 		ChatQueryRequest req;
@@ -310,7 +433,7 @@ namespace Chat {
 		req.peer = peer;
 		req.extra = extra;
 		req.query_data.client_info = peer->getClientInfo();
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req);
 	}
 	void ChatBackendTask::SubmitAddUserToChannel(ChatQueryCB cb, Peer *peer, void *extra, ChatChannelInfo channel) {
 		ChatQueryRequest req;
@@ -320,7 +443,7 @@ namespace Chat {
 		req.extra = extra;
 		req.query_data.client_info = peer->getClientInfo();
 		req.query_data.channel_info = channel;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req, channel.channel_id);
 	}
 	void ChatBackendTask::SubmitRemoveUserFromChannel(ChatQueryCB cb, Peer *peer, void *extra, ChatChannelInfo channel, EChannelPartTypes reason, std::string reason_str) {
 		ChatQueryRequest req;
@@ -332,7 +455,7 @@ namespace Chat {
 		req.query_data.channel_info = channel;
 		req.part_reason = reason;
 		req.message = reason_str;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req, channel.channel_id);
 	}
 	void ChatBackendTask::SubmitGetChannelUsers(ChatQueryCB cb, Peer *peer, void *extra, ChatChannelInfo channel) {
 		ChatQueryRequest req;
@@ -342,7 +465,7 @@ namespace Chat {
 		req.extra = extra;
 		req.query_data.client_info = peer->getClientInfo();
 		req.query_data.channel_info = channel;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req, channel.channel_id);
 	}
 	void ChatBackendTask::SubmitGetChannelUser(ChatQueryCB cb, Peer *peer, void *extra, ChatChannelInfo channel, std::string name) {
 		ChatQueryRequest req;
@@ -353,7 +476,7 @@ namespace Chat {
 		req.query_data.client_info.name = name;
 		req.query_data.client_info.client_id = 0;
 		req.query_data.channel_info = channel;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req, channel.channel_id);
 	}
 	void ChatBackendTask::SubmitUpdateChannelModes(ChatQueryCB cb, Peer *peer, void *extra, uint32_t addmask, uint32_t removemask, ChatChannelInfo channel,
 		std::string password, int limit, std::vector<std::pair<std::string, ChanClientModeChange> > user_modechanges, ChatClientInfo client_info) {
@@ -369,7 +492,7 @@ namespace Chat {
 		req.chan_limit = limit;
 		req.chan_password = password;
 		req.user_modechanges = user_modechanges;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req, channel.channel_id);
 	}
 	void ChatBackendTask::SubmitSetChanProps(ChatQueryCB cb, Peer *peer, void *extra, ChatStoredChanProps chanprops) {
 		ChatQueryRequest req;
@@ -378,7 +501,7 @@ namespace Chat {
 		req.peer = peer;
 		req.extra = extra;
 		req.query_data.channel_props_data = chanprops;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req);
 	}
 	void ChatBackendTask::SubmitGetChanProps(ChatQueryCB cb, Peer *peer, void *extra, std::string mask) {
 		ChatQueryRequest req;
@@ -387,7 +510,7 @@ namespace Chat {
 		req.peer = peer;
 		req.extra = extra;
 		req.query_data.channel_props_data.channel_mask = mask;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req);
 	}
 	void ChatBackendTask::SubmitDeleteChanProps(ChatQueryCB cb, Peer *peer, void *extra, int id) {
 		ChatQueryRequest req;
@@ -396,7 +519,7 @@ namespace Chat {
 		req.peer = peer;
 		req.extra = extra;
 		req.query_data.channel_props_data.id = id;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req);
 	}
 	void ChatBackendTask::SubmitGetClientUsermodes(ChatQueryCB cb, Peer *peer, void *extra, std::string chanmask, ChatClientInfo client) {
 		ChatQueryRequest req;
@@ -406,7 +529,7 @@ namespace Chat {
 		req.extra = extra;
 		req.query_name = chanmask;
 		req.query_data.client_info = client;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req);
 	}
 	void ChatBackendTask::PerformSetChanProps(ChatQueryRequest task_params) {
 		freeReplyObject(redisCommand(mp_redis_connection, "SELECT %d", OS::ERedisDB_Chat));
@@ -458,18 +581,10 @@ namespace Chat {
 
 		freeReplyObject(redisCommand(mp_redis_connection, "HSET chat_channel_%d password \"DELETED_CHANNEL\"", channel_id)); //prevent anyone new from joining
 
-		int num_clients = 0;
 		ChatClientInfo client_info;
 		ChatChannelInfo channel_info = GetChannelByID(channel_id);
 
-		reply = (redisReply *)redisCommand(mp_redis_connection, "LLEN chan_%d_clients", channel_id);
-		if(reply && reply->type == REDIS_REPLY_INTEGER) {
-			num_clients = reply->integer;
-		} else if(reply && reply->type == REDIS_REPLY_STRING) {
-			num_clients = atoi(reply->str);
-		}
-
-		reply = (redisReply *)redisCommand(mp_redis_connection, "LRANGE chan_%d_clients 0 %d", channel_id, num_clients);
+		reply = (redisReply *)redisCommand(mp_redis_connection, "LRANGE chan_%d_clients 0 -1", channel_id);
 
 		for(unsigned int i=0;i<reply->elements;i++) {
 			redisReply *element = reply->element[i];
@@ -493,6 +608,8 @@ namespace Chat {
 		freeReplyObject(redisCommand(mp_redis_connection, "DEL chat_channel_%d", channel_id));
 		freeReplyObject(redisCommand(mp_redis_connection, "DEL chat_channel_%d_custkeys", channel_id));
 		freeReplyObject(redisCommand(mp_redis_connection, "DEL chan_%d_clients", channel_id));
+
+		RemoveChannelKey(channel_id);
 	}
 	ChatStoredChanProps ChatBackendTask::GetBestChanProps(std::string channel_mask) {
 		int cursor = 0;
@@ -706,7 +823,7 @@ namespace Chat {
 		req.query_data.client_info = peer->getClientInfo();
 		req.query_data.channel_info = channel;
 		req.message = topic;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req, channel.channel_id);
 	}
 	void ChatBackendTask::PerformUpdateChannelTopic(ChatQueryRequest task_params) {
 		ChatChannelInfo channel_info;
@@ -864,7 +981,7 @@ namespace Chat {
 		req.extra = extra;
 		req.query_data.client_info.client_id = client_id;
 		req.set_keys = set_data_map;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req);
 	}
 	void ChatBackendTask::SubmitClientDelete(ChatQueryCB cb, Peer *peer, void *extra, std::string reason) {
 		ChatQueryRequest req;
@@ -876,7 +993,7 @@ namespace Chat {
 
 		peer->GetChannelList(req.id_list);
 		req.client_info = peer->getClientInfo();
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req);
 	}
 	void ChatBackendTask::PerformUserDelete(ChatQueryRequest task_params) {
 		int client_id = task_params.client_info.client_id;
@@ -911,7 +1028,7 @@ namespace Chat {
 		req.extra = extra;
 		req.query_data.channel_info = channel;
 		req.set_keys = set_data_map;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req, channel.channel_id);
 	}
 	void ChatBackendTask::PerformSetChannelKeys(ChatQueryRequest task_params) {
 		redisReply *reply;
@@ -971,7 +1088,7 @@ namespace Chat {
 		req.peer = peer;
 		req.extra = extra;
 		req.query_data.client_info.profileid = profileid;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req);
 	}
 	void ChatBackendTask::PerformGetChatOperFlags(ChatQueryRequest task_params) {
 		struct Chat::_ChatQueryResponse resp;
@@ -993,34 +1110,35 @@ namespace Chat {
 	ChatChanClientInfo ChatBackendTask::GetChanClientInfo(int chan_id, int client_id) {
 		ChatChanClientInfo ret;
 		redisReply *reply;
-		freeReplyObject(redisCommand(mp_redis_connection, "SELECT %d", OS::ERedisDB_Chat));
-
-		ret.client_id = client_id;
 
-		reply = (redisReply *)redisCommand(mp_redis_connection, "HGET chan_%d_client_%d client_flags", chan_id, client_id);
-		if(reply && reply->type == REDIS_REPLY_INTEGER) {
-			ret.client_flags = reply->integer;
-		} else if(reply && reply->type == REDIS_REPLY_STRING) {
-			ret.client_flags = atoi(reply->str);
-		} else {
-			ret.client_id = 0; //for user is not in channel check
-		}
+		ret.client_id = 0; //for user is not in channel check
+		ret.client_flags = 0;
 
-		freeReplyObject(reply);
+		redisAppendCommand(mp_redis_connection, "SELECT %d", OS::ERedisDB_Chat);
+		redisAppendCommand(mp_redis_connection, "HGET chan_%d_client_%d client_flags", chan_id, client_id);
+		redisAppendCommand(mp_redis_connection, "HGETALL chan_%d_client_%d_custkeys", chan_id, client_id);
 
-		reply = (redisReply *)redisCommand(mp_redis_connection, "HKEYS chan_%d_client_%d_custkeys", chan_id, client_id);
-		for(unsigned int i=0;i<reply->elements;i++) {
-			redisReply *key_reply = (redisReply *)redisCommand(mp_redis_connection, "HGET chan_%d_client_%d_custkeys %s", chan_id, client_id,OS::strip_quotes(reply->element[i]->str).c_str());
-			if(key_reply && key_reply->type == REDIS_REPLY_INTEGER) {
-				std::ostringstream s;
-				s << key_reply->integer;
-				ret.custom_keys[OS::strip_quotes(reply->element[i]->str)] = s.str();
-			} else if(key_reply && key_reply->type == REDIS_REPLY_STRING) {
-				ret.custom_keys[OS::strip_quotes(reply->element[i]->str)] = OS::strip_quotes(key_reply->str);
+		if(redisGetReply(mp_redis_connection, (void **)&reply) == REDIS_OK) {
+			freeReplyObject(reply);
+		}
+		if(redisGetReply(mp_redis_connection, (void **)&reply) == REDIS_OK) {
+			if(reply->type == REDIS_REPLY_INTEGER) {
+				ret.client_flags = reply->integer;
+				ret.client_id = client_id;
+			} else if(reply->type == REDIS_REPLY_STRING) {
+				ret.client_flags = atoi(reply->str);
+				ret.client_id = client_id;
 			}
-			freeReplyObject(key_reply);
+			freeReplyObject(reply);
+		}
+		if(redisGetReply(mp_redis_connection, (void **)&reply) == REDIS_OK) {
+			for(unsigned int i=0;i+1<reply->elements;i+=2) {
+				if(reply->element[i]->type == REDIS_REPLY_STRING && reply->element[i+1]->type == REDIS_REPLY_STRING) {
+					ret.custom_keys[OS::strip_quotes(reply->element[i]->str)] = OS::strip_quotes(reply->element[i+1]->str);
+				}
+			}
+			freeReplyObject(reply);
 		}
-		freeReplyObject(reply);
 
 		LoadClientInfoByID(ret.client_info, client_id);
 
@@ -1028,17 +1146,9 @@ namespace Chat {
 	}
 	void ChatBackendTask::PerformGetChannelUsers(ChatQueryRequest task_params) {
 		redisReply *reply;
-		int num_clients = 0;
 		freeReplyObject(redisCommand(mp_redis_connection, "SELECT %d", OS::ERedisDB_Chat));
 
-		reply = (redisReply *)redisCommand(mp_redis_connection, "LLEN chan_%d_clients", task_params.query_data.channel_info.channel_id);
-		if(reply && reply->type == REDIS_REPLY_INTEGER) {
-			num_clients = reply->integer;
-		} else if(reply && reply->type == REDIS_REPLY_STRING) {
-			num_clients = atoi(reply->str);
-		}
-
-		reply = (redisReply *)redisCommand(mp_redis_connection, "LRANGE chan_%d_clients 0 %d", task_params.query_data.channel_info.channel_id, num_clients);
+		reply = (redisReply *)redisCommand(mp_redis_connection, "LRANGE chan_%d_clients 0 -1", task_params.query_data.channel_info.channel_id);
 
 		struct Chat::_ChatQueryResponse response;
 		for(unsigned int i=0;i<reply->elements;i++) {
@@ -1093,7 +1203,7 @@ namespace Chat {
 		req.peer = peer;
 		req.extra = extra;
 		req.query_data.usermode_data = usermode;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req);
 	}
 	void ChatBackendTask::SubmitGetSavedUserModes(ChatQueryCB cb, Peer *peer, void *extra, ChatStoredUserMode usermode) {
 		ChatQueryRequest req;
@@ -1102,7 +1212,7 @@ namespace Chat {
 		req.peer = peer;
 		req.extra = extra;
 		req.query_data.usermode_data = usermode;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req);
 	}
 	void ChatBackendTask::PerformSaveUserMode(ChatQueryRequest task_params) {
 		freeReplyObject(redisCommand(mp_redis_connection, "SELECT %d", OS::ERedisDB_Chat));
@@ -1176,7 +1286,7 @@ namespace Chat {
 		req.peer = peer;
 		req.extra = extra;
 		req.query_data.usermode_data.id = id;
-		getQueryTask()->AddRequest(req);
+		SubmitRequest(req);
 	}
 	void ChatBackendTask::PerformDeleteUserMode(ChatQueryRequest task_params) {
 		struct Chat::_ChatQueryResponse response;
@@ -1457,6 +1567,7 @@ namespace Chat {
 			freeReplyObject(key_reply);
 		}
 
+		SetChannelKey(ret);
 		return ret;
 	}
 	ChatChannelInfo ChatBackendTask::CreateChannel(std::string name) {
@@ -1483,6 +1594,8 @@ namespace Chat {
 		reply = (redisReply *)redisCommand(mp_redis_connection, "HSET chat_channel_%d name %s", ret.channel_id, name.c_str());
 		freeReplyObject(reply);
 
+		SetChannelKey(ret);
+
 		if(props.id != 0) {
 			return ApplyChannelPropsToChannel(ret, props, false);
 		} else {
@@ -1689,121 +1802,113 @@ namespace Chat {
 	}
 	void *ChatBackendTask::TaskThread(OS::CThread *thread) {
 		ChatBackendTask *task = (ChatBackendTask *)thread->getParams();
-		for(;;) {
-			if(task->m_request_list.size() > 0) {
-				std::vector<ChatQueryRequest>::iterator it = task->m_request_list.begin();
-				task->mp_mutex->lock();
-				while(it != task->m_request_list.end()) {
-					ChatQueryRequest task_params = *it;
-
-					it = task->m_request_list.erase(it);
-					switch(task_params.type) {
-						case EChatQueryRequestType_GetClientByName:
-							task->PerformGetClientInfoByName(task_params);
-						break;
-						case EChatQueryRequestType_UpdateOrInsertClient:
-							task->PerformUpdateOrInsertClient(task_params);
-						break;
-						case EChatQueryRequestType_SendClientMessage:
-							task->PerformSendClientMessage(task_params);
-						break;
-						case EChatQueryRequestType_SendChannelMessage:
-							task->PerformSendChannelMessage(task_params);
-						break;
-						case EChatQueryRequestType_Find_OrCreate_Channel:
-							task->PerformFind_OrCreateChannel(task_params);
-						break;
-						case EChatQueryRequestType_Find_Channel:
-							task->PerformFind_OrCreateChannel(task_params, true);
-						break;
-						case EChatQueryRequestType_AddUserToChannel:
-							task->PerformSendAddUserToChannel(task_params);
-						break;
-						case EChatQueryRequestType_RemoveUserFromChannel:
-							task->PerformSendRemoveUserFromChannel(task_params);
-						break;
-						case EChatQueryRequestType_GetChannelUsers:
-							task->PerformGetChannelUsers(task_params);
-						break;
-						case EChatQueryRequestType_GetChannelUser:
-							task->PerformGetChannelUser(task_params);
-						break;
-						case EChatQueryRequestType_UpdateChannelModes:
-							task->PerformUpdateChannelModes(task_params);
-						break;
-						case EChatQueryRequestType_UpdateChannelTopic:
-							task->PerformUpdateChannelTopic(task_params);
-						break;
-						case EChatQueryRequestType_SetChannelClientKeys:
-							task->PerformSetChannelClientKeys(task_params);
-						break;
-						case EChatQueryRequestType_SetClientKeys:
-							task->PerformSetClientKeys(task_params);
-						break;
-						case EChatQueryRequestType_SetChannelKeys:
-							task->PerformSetChannelKeys(task_params);
-						break;
-						case EChatQueryRequestType_UserDelete:
-							task->PerformUserDelete(task_params);
-						break;
-						case EChatQueryRequestType_GetChatOperFlags:
-							task->PerformGetChatOperFlags(task_params);
-						break;
-						case EChatQueryRequestType_GetUserModes:
-							task->PerformGetUserModes(task_params);
-						break;
-						case EChatQueryRequestType_SaveUserMode:
-							task->PerformSaveUserMode(task_params);
-						break;
-						case EChatQueryRequestType_DeleteUserMode:
-							task->PerformDeleteUserMode(task_params);
-						break;
-						case EChatQueryRequestType_SaveChanProps:
-							task->PerformSetChanProps(task_params);
-						break;
-						case EChatQueryRequestType_GetChanProps:
-							task->PerformGetChanProps(task_params);
-						break;
-						case EChatQueryRequestType_DeleteChanProps:
-							task->PerformDeleteChanProps(task_params);
-						break;
-						case EChatQueryRequestType_GetClientUsermodes:
-							task->PerformGetClientUsermodes(task_params);
-						break;
-						case EChatQueryRequestType_Find_ChannelByID:
-							task->PerformFindChannelByID(task_params);
-						break;
-					}
-					if(task->m_flag_push_task) {
-						task->m_flag_push_task = false;
-						it = task->m_request_list.begin();
-					}
-					continue;
+		struct timeval now;
+		while(task->HasRequests() || task->mp_thread_poller->wait()) {
+			ChatQueryRequest task_params;
+			//requests queued by callbacks while this runs are picked up in the same pass
+			while(task->PopRequest(task_params)) {
+				switch(task_params.type) {
+					case EChatQueryRequestType_GetClientByName:
+						task->PerformGetClientInfoByName(task_params);
+					break;
+					case EChatQueryRequestType_UpdateOrInsertClient:
+						task->PerformUpdateOrInsertClient(task_params);
+					break;
+					case EChatQueryRequestType_SendClientMessage:
+						task->PerformSendClientMessage(task_params);
+					break;
+					case EChatQueryRequestType_SendChannelMessage:
+						task->PerformSendChannelMessage(task_params);
+					break;
+					case EChatQueryRequestType_Find_OrCreate_Channel:
+						task->PerformFind_OrCreateChannel(task_params);
+					break;
+					case EChatQueryRequestType_Find_Channel:
+						task->PerformFind_OrCreateChannel(task_params, true);
+					break;
+					case EChatQueryRequestType_AddUserToChannel:
+						task->PerformSendAddUserToChannel(task_params);
+					break;
+					case EChatQueryRequestType_RemoveUserFromChannel:
+						task->PerformSendRemoveUserFromChannel(task_params);
+					break;
+					case EChatQueryRequestType_GetChannelUsers:
+						task->PerformGetChannelUsers(task_params);
+					break;
+					case EChatQueryRequestType_GetChannelUser:
+						task->PerformGetChannelUser(task_params);
+					break;
+					case EChatQueryRequestType_UpdateChannelModes:
+						task->PerformUpdateChannelModes(task_params);
+					break;
+					case EChatQueryRequestType_UpdateChannelTopic:
+						task->PerformUpdateChannelTopic(task_params);
+					break;
+					case EChatQueryRequestType_SetChannelClientKeys:
+						task->PerformSetChannelClientKeys(task_params);
+					break;
+					case EChatQueryRequestType_SetClientKeys:
+						task->PerformSetClientKeys(task_params);
+					break;
+					case EChatQueryRequestType_SetChannelKeys:
+						task->PerformSetChannelKeys(task_params);
+					break;
+					case EChatQueryRequestType_UserDelete:
+						task->PerformUserDelete(task_params);
+					break;
+					case EChatQueryRequestType_GetChatOperFlags:
+						task->PerformGetChatOperFlags(task_params);
+					break;
+					case EChatQueryRequestType_GetUserModes:
+						task->PerformGetUserModes(task_params);
+					break;
+					case EChatQueryRequestType_SaveUserMode:
+						task->PerformSaveUserMode(task_params);
+					break;
+					case EChatQueryRequestType_DeleteUserMode:
+						task->PerformDeleteUserMode(task_params);
+					break;
+					case EChatQueryRequestType_SaveChanProps:
+						task->PerformSetChanProps(task_params);
+					break;
+					case EChatQueryRequestType_GetChanProps:
+						task->PerformGetChanProps(task_params);
+					break;
+					case EChatQueryRequestType_DeleteChanProps:
+						task->PerformDeleteChanProps(task_params);
+					break;
+					case EChatQueryRequestType_GetClientUsermodes:
+						task->PerformGetClientUsermodes(task_params);
+					break;
+					case EChatQueryRequestType_Find_ChannelByID:
+						task->PerformFindChannelByID(task_params);
+					break;
 				}
-				task->mp_mutex->unlock();
+				gettimeofday(&now, NULL);
+				uint64_t latency = (uint64_t)(now.tv_sec - task_params.submit_time.tv_sec) * 1000000 + (now.tv_usec - task_params.submit_time.tv_usec);
+				g_chat_request_span.Record(latency);
+				CompleteRequest(task_params);
 			}
-			OS::Sleep(CHAT_BACKEND_TICK);
+			task->FlushChannelMessages();
 		}
 		return NULL;
 	}
 	void *ChatBackendTask::setup_redis_async(OS::CThread *thread) {
-		ChatBackendTask *task = (ChatBackendTask *)thread->getParams();
-		task->mp_event_base = event_base_new();
+		mp_event_base = event_base_new();
 
-	    task->mp_redis_async_connection = redisAsyncConnect("127.0.0.1", 6379);
+	    mp_redis_async_connection = redisAsyncConnect(OS_REDIS_SERV, OS_REDIS_PORT);
 
-	    redisLibeventAttach(task->mp_redis_async_connection, task->mp_event_base);
+	    redisLibeventAttach(mp_redis_async_connection, mp_event_base);
 
-	    redisAsyncCommand(task->mp_redis_async_connection, onRedisMessage, task, "SUBSCRIBE %s",chat_messaging_channel);
+	    redisAsyncCommand(mp_redis_async_connection, onRedisMessage, NULL, "SUBSCRIBE %s",chat_messaging_channel);
 
-	    event_base_dispatch(task->mp_event_base);
+	    event_base_dispatch(mp_event_base);
 		return NULL;
 	}
 
 
 	void ChatBackendTask::onRedisMessage(redisAsyncContext *c, void *reply, void *privdata) {
 	    redisReply *r = (redisReply*)reply;
-	    ChatBackendTask *task = (ChatBackendTask *)privdata;
 	    if (reply == NULL) return;
 		ChatChannelInfo channel_info;
 		ChatClientInfo client_info;
@@ -1839,30 +1944,36 @@ namespace Chat {
 		    			int target_id = kv_parser.GetValueInt("to_id");
 						ChatClientInfo user = ClientInfoFromKVString(r->element[2]->str);
 						OS::Base64StrToBin(msg.c_str(), &out, len);
-						task->SendClientMessageToDrivers(target_id,user, (const char *)out, chat_msg_type);
+						SendClientMessageToDrivers(target_id,user, (const char *)out, chat_msg_type);
 						free((void *)out);
-					} else if(strcmp(msg_type.c_str(), "send_channel_msg") == 0) {
-		    			if(!kv_parser.HasKey("msg")) {
-		    				return;
-		    			}
-		    			msg = kv_parser.GetValue("msg");
-		    			chat_msg_type = (EChatMessageType)kv_parser.GetValueInt("msg_type");
-						ChatClientInfo user = ClientInfoFromKVString(r->element[2]->str);
+					} else if(strcmp(msg_type.c_str(), "send_channel_msgs") == 0) {
+						//this node's own messages were delivered to its members when they were sent
+						if(kv_parser.GetValueInt("node_id") == m_node_id) {
+							return;
+						}
 						ChatChannelInfo channel = ChannelInfoFromKVString(r->element[2]->str);
-						OS::Base64StrToBin(msg.c_str(), &out, len);
-						task->SendChannelMessageToDrivers(channel,user, (const char *)out, (EChatMessageType)chat_msg_type);
-						free((void *)out);
+						int count = kv_parser.GetValueInt("count");
+						for(int i=0;i<count;i++) {
+							std::ostringstream prefix;
+							prefix << i << "_";
+							msg = kv_parser.GetValue(prefix.str() + "msg");
+							chat_msg_type = (EChatMessageType)kv_parser.GetValueInt(prefix.str() + "msg_type");
+							ChatClientInfo user = ClientInfoFromKVString(r->element[2]->str, prefix.str());
+							OS::Base64StrToBin(msg.c_str(), &out, len);
+							SendChannelMessageToLocalMembers(channel, user, (const char *)out, chat_msg_type);
+							free((void *)out);
+						}
 					} else if(strcmp(msg_type.c_str(), "user_join_channel") == 0) {
 						client_info = ClientInfoFromKVString(r->element[2]->str);
 						channel_info = ChannelInfoFromKVString(r->element[2]->str);
-						task->SendClientJoinChannelToDrivers(client_info, channel_info);
+						SendClientJoinChannelToDrivers(client_info, channel_info);
 					} else if(strcmp(msg_type.c_str(), "user_leave_channel") == 0) {
 						EChannelPartTypes part_reason = (EChannelPartTypes)kv_parser.GetValueInt("part_type");
 						msg = kv_parser.GetValue("reason");
 						client_info = ClientInfoFromKVString(r->element[2]->str);
 						channel_info = ChannelInfoFromKVString(r->element[2]->str);
 						OS::Base64StrToBin(msg.c_str(), &out, len);
-						task->SendClientPartChannelToDrivers(client_info, channel_info, part_reason, (const char *)out);
+						SendClientPartChannelToDrivers(client_info, channel_info, part_reason, (const char *)out);
 						free((void *)out);
 					} else if(strcmp(msg_type.c_str(), "channel_update_modeflags") == 0) {
 						if(kv_parser.HasKey("new_password")) {
@@ -1875,7 +1986,7 @@ namespace Chat {
 
 						change_data.new_limit = kv_parser.GetValueInt("new_limit");
 
-						task->SendChannelModeUpdateToDrivers(client_info, channel_info, change_data);
+						SendChannelModeUpdateToDrivers(client_info, channel_info, change_data);
 					} else if (strcmp(msg_type.c_str(), "channel_update_usermode_flags") == 0) {
 						type = kv_parser.GetValueInt("modeflags");
 						target_client_info = ClientInfoFromKVString(r->element[2]->str, "target");
@@ -1889,13 +2000,13 @@ namespace Chat {
 
 						change_data.client_modechanges.push_back(client_mode_info);
 
-						task->SendChannelModeUpdateToDrivers(client_info, channel_info, change_data);
+						SendChannelModeUpdateToDrivers(client_info, channel_info, change_data);
 
 					} else if(strcmp(msg_type.c_str(), "channel_update_topic") == 0) {
 						client_info = ClientInfoFromKVString(r->element[2]->str);
 						channel_info = ChannelInfoFromKVString(r->element[2]->str);
 
-						task->SendUpdateChannelTopicToDrivers(client_info, channel_info);
+						SendUpdateChannelTopicToDrivers(client_info, channel_info);
 					} else if(strcmp(msg_type.c_str(), "set_channel_client_keys") == 0) {
 		    			if(!kv_parser.HasKey("key_data")) {
 		    				return;
@@ -1909,7 +2020,7 @@ namespace Chat {
 
 						key_data = OS::KeyStringToMap(std::string((const char *)out));
 
-						task->SendSetChannelClientKeysToDrivers(client_info, channel_info, key_data);
+						SendSetChannelClientKeysToDrivers(client_info, channel_info, key_data);
 
 						free((void *)out);
 					} else if(strcmp(msg_type.c_str(), "set_channel_keys") == 0) {
@@ -1925,7 +2036,7 @@ namespace Chat {
 
 						key_data = OS::KeyStringToMap(std::string((const char *)out));
 
-						task->SendSetChannelKeysToDrivers(client_info, channel_info, key_data);
+						SendSetChannelKeysToDrivers(client_info, channel_info, key_data);
 
 						free((void *)out);
 					} else if(strcmp(msg_type.c_str(), "user_quit") == 0) {
@@ -1936,16 +2047,16 @@ namespace Chat {
 						client_info = ClientInfoFromKVString(r->element[2]->str);
 
 						OS::Base64StrToBin(msg.c_str(), &out, len);
-						task->SendUserQuitMessage(client_info, (const char *)out);
+						SendUserQuitMessage(client_info, (const char *)out);
 						free((void *)out);
 					} else if(strcmp(msg_type.c_str(), "save_usermode") == 0) {
 						client_info = ClientInfoFromKVString(r->element[2]->str); //setter
 						usermode = UsermodeFromKVString(r->element[2]->str);
-						task->SendSetUsermodeToDrivers(client_info, usermode);
+						SendSetUsermodeToDrivers(client_info, usermode);
 					} else if(strcmp(msg_type.c_str(),"delete_usermode") == 0) {
 						client_info = ClientInfoFromKVString(r->element[2]->str); //setter
 						usermode = UsermodeFromKVString(r->element[2]->str);
-						task->SendDelUsermodeToDrivers(client_info, usermode);
+						SendDelUsermodeToDrivers(client_info, usermode);
 					}
 	    		}
 	    	}
@@ -2234,13 +2345,53 @@ namespace Chat {
 			it++;
 		}
 	}
-	void ChatBackendTask::SendChannelMessageToDrivers(ChatChannelInfo channel, ChatClientInfo user, const char *msg, EChatMessageType message_type) {
-		std::vector<Chat::Driver *>::iterator it = m_drivers.begin();
-		while(it != m_drivers.end()) {
-			Chat::Driver *driver = *it;
-			driver->OnSendChannelMessage(channel, user, msg, message_type);
+	void ChatBackendTask::SendChannelMessageToLocalMembers(ChatChannelInfo channel, ChatClientInfo user, const char *msg, EChatMessageType message_type) {
+		mp_members_mutex->lock();
+		std::map<int, std::vector<Peer *> >::iterator it = m_channel_members.find(channel.channel_id);
+		if(it != m_channel_members.end()) {
+			std::vector<Peer *>::iterator it2 = (*it).second.begin();
+			while(it2 != (*it).second.end()) {
+				Peer *p = *it2;
+				p->OnRecvChannelMessage(user, channel, msg, message_type);
+				it2++;
+			}
+		}
+		mp_members_mutex->unlock();
+	}
+	void ChatBackendTask::AddLocalChannelMember(int channel_id, Peer *peer) {
+		mp_members_mutex->lock();
+		std::vector<Peer *> &members = m_channel_members[channel_id];
+		if(std::find(members.begin(), members.end(), peer) == members.end()) {
+			members.push_back(peer);
+		}
+		mp_members_mutex->unlock();
+	}
+	void ChatBackendTask::RemoveLocalChannelMember(int channel_id, Peer *peer) {
+		mp_members_mutex->lock();
+		std::map<int, std::vector<Peer *> >::iterator it = m_channel_members.find(channel_id);
+		if(it != m_channel_members.end()) {
+			std::vector<Peer *>::iterator it2 = std::find((*it).second.begin(), (*it).second.end(), peer);
+			if(it2 != (*it).second.end()) {
+				(*it).second.erase(it2);
+			}
+			if((*it).second.empty()) {
+				m_channel_members.erase(it);
+				RemoveChannelKey(channel_id);
+			}
+		}
+		mp_members_mutex->unlock();
+	}
+	void ChatBackendTask::RemoveLocalPeer(Peer *peer) {
+		std::vector<int> channels;
+		peer->GetChannelList(channels);
+
+		mp_members_mutex->lock();
+		std::vector<int>::iterator it = channels.begin();
+		while(it != channels.end()) {
+			RemoveLocalChannelMember(*it, peer);
 			it++;
 		}
+		mp_members_mutex->unlock();
 	}
 	void ChatBackendTask::SendClientJoinChannelToDrivers(ChatClientInfo client, ChatChannelInfo channel) {
 		std::vector<Chat::Driver *>::iterator it = m_drivers.begin();
@@ -2467,5 +2618,40 @@ namespace Chat {
 			it++;
 		}
 	}
+	void SetupTaskPool() {
+		struct timeval t;
+		t.tv_usec = 0;
+		t.tv_sec = 3;
+
+		redisContext *connection = redisConnectWithTimeout(OS_REDIS_SERV, OS_REDIS_PORT, t);
+		freeReplyObject(redisCommand(connection, "SELECT %d", OS::ERedisDB_Chat));
+		redisReply *reply = (redisReply *)redisCommand(connection, "INCR %s", mp_node_pk_name);
+		if(reply && reply->type == REDIS_REPLY_INTEGER) {
+			m_node_id = reply->integer;
+		}
+		freeReplyObject(reply);
+		redisFree(connection);
+
+		mp_members_mutex = OS::CreateMutex();
+		mp_channel_keys_mutex = OS::CreateMutex();
+		mp_peer_requests_mutex = OS::CreateMutex();
+
+		m_task_pool = new OS::TaskPool<ChatBackendTask, ChatQueryRequest>(NUM_CHAT_THREADS, OS::ETaskDispatch_Affinity);
+		OS::InstrumentRegistry::getSingleton()->AddCollector("chat_backend", m_task_pool);
+
+		//one subscriber for the node, its messages are handed straight to the drivers
+		mp_async_thread = OS::CreateThread(ChatBackendTask::setup_redis_async, NULL, true);
+	}
+	void ShutdownTaskPool() {
+		event_base_loopbreak(mp_event_base);
+		delete mp_async_thread;
+		redisAsyncFree(mp_redis_async_connection);
+		event_base_free(mp_event_base);
 
+		OS::InstrumentRegistry::getSingleton()->RemoveCollectors(m_task_pool);
+		delete m_task_pool;
+		delete mp_members_mutex;
+		delete mp_channel_keys_mutex;
+		delete mp_peer_requests_mutex;
+	}
 }
@@ -4,11 +4,13 @@
 
 #include <OS/OpenSpy.h>
 #include <OS/Task.h>
+#include <OS/TaskPool.h>
 #include <OS/Thread.h>
 #include <OS/Mutex.h>
 
 #include <vector>
 #include <map>
+#include <deque>
 #include <string>
 
 #include <hiredis/hiredis.h>
@@ -18,12 +20,12 @@
 #include <hiredis/adapters/libevent.h>
 #undef _WINSOCK2API_
 
-#define CHAT_BACKEND_TICK 200
+#define NUM_CHAT_THREADS 4
+#define CHAT_MAX_BATCHED_MESSAGES 64 //per channel, per publish
 
 namespace Chat {
 	class Driver;
 	class Peer;
-	extern redisContext *mp_redis_connection;
 
 	struct _ChatQueryRequest;
 	enum EChatBackendResponseError {
@@ -228,8 +230,23 @@ namespace Chat {
 		std::vector<int> id_list;
 		EChannelPartTypes part_reason;
 
+		struct timeval submit_time; //for the command latency metrics
+		uint32_t channel_key; //the worker key it was submitted with, 0 if it's keyed by its peer
 	} ChatQueryRequest;
 
+	//a peer's requests which haven't completed, see SubmitRequest
+	typedef struct {
+		uint32_t channel_key;
+		int in_flight;
+		std::deque<ChatQueryRequest> deferred;
+	} ChatPeerRequests;
+
+
+	typedef struct {
+		ChatClientInfo from_user;
+		EChatMessageType message_type;
+		std::string message;
+	} ChatQueuedChannelMessage;
 
 	typedef struct {
 		int old_modeflags;
@@ -249,13 +266,11 @@ namespace Chat {
 
 	class ChatBackendTask : public OS::Task<ChatQueryRequest> {
 		public:
-			ChatBackendTask();
+			ChatBackendTask(int thread_index);
 			~ChatBackendTask();
-			static ChatBackendTask *getQueryTask();
-			static void Shutdown();
 
-			void AddDriver(Chat::Driver *driver);
-			void RemoveDriver(Chat::Driver *driver);
+			static void AddDriver(Chat::Driver *driver);
+			static void RemoveDriver(Chat::Driver *driver);
 
 			static void SubmitGetClientInfoByName(std::string name, ChatQueryCB cb, Peer *peer, void *extra);
 			static void SubmitClientInfo(ChatQueryCB cb, Peer *peer, void *extra);
@@ -292,12 +307,35 @@ namespace Chat {
 			static bool TestClientUsermode(ChatClientInfo client, ChatStoredUserMode usermode);
 
 			static ChatStoredUserMode FlattenUsermodes(std::vector<ChatStoredUserMode> usermodes, ChatClientInfo client, std::string channel_mask = "X");
-			void flagPushTask();
 			static ChatClientInfo GetServerClient();
+
+			//local channel membership, kept as peers see their own joins and parts
+			static void AddLocalChannelMember(int channel_id, Peer *peer);
+			static void RemoveLocalChannelMember(int channel_id, Peer *peer);
+			static void RemoveLocalPeer(Peer *peer);
+
+			static void *setup_redis_async(OS::CThread *thread);
+
+			//time from submit until the request's callback returns, across all workers
 		private:
 			static void *TaskThread(OS::CThread *thread);
 
-			static void *setup_redis_async(OS::CThread *thread);
+			/*
+				Requests for a channel are keyed by its id, so they run on one worker in the order they were submitted.
+				Others, ie. nick changes, usermodes and quits, are keyed by their peer.
+				A peer's requests complete in the order it submitted them: one with a different key than the peer's
+				requests still running is held until they've completed, so a quit can't overtake the peer's last channel message.
+			*/
+			static void SubmitRequest(ChatQueryRequest req, uint32_t channel_key = 0);
+			static void DispatchRequest(ChatQueryRequest req);
+			static void CompleteRequest(ChatQueryRequest req);
+			/*
+				The id of a channel this node has loaded, by name. Until it has been loaded, only lookups by name can be
+				submitted for it, which are keyed by a hash of the name and so still run in order.
+			*/
+			static uint32_t GetChannelKey(std::string name);
+			static void SetChannelKey(ChatChannelInfo channel);
+			static void RemoveChannelKey(int channel_id);
 
 			static void onRedisMessage(redisAsyncContext *c, void *reply, void *privdata);
 
@@ -346,8 +384,8 @@ namespace Chat {
 
 			std::vector<ChatStoredUserMode> GetClientUsermodes(ChatClientInfo info, std::string channel_mask = "X");
 			ChatStoredUserMode GetFlattenedUsermodes(ChatClientInfo info, std::string channel_mask = "X");
-			void SendSetUsermodeToDrivers(ChatClientInfo remover, ChatStoredUserMode usermode);
-			void SendDelUsermodeToDrivers(ChatClientInfo remover, ChatStoredUserMode usermode);
+			static void SendSetUsermodeToDrivers(ChatClientInfo remover, ChatStoredUserMode usermode);
+			static void SendDelUsermodeToDrivers(ChatClientInfo remover, ChatStoredUserMode usermode);
 
 			ChatStoredChanProps GetChannelChanProps(std::string channel_name);
 			ChatChannelInfo ApplyChannelPropsToChannel(ChatChannelInfo channel, ChatStoredChanProps props, bool send_mq = true);
@@ -356,15 +394,16 @@ namespace Chat {
 			void LoadClientInfoByID(ChatClientInfo &info, int client_id);
 			void LoadClientInfoByName(ChatClientInfo &info, std::string name);
 
-			void SendClientMessageToDrivers(int target_id, ChatClientInfo user, const char *msg, EChatMessageType message_type);
-			void SendChannelMessageToDrivers(ChatChannelInfo channel, ChatClientInfo user, const char *msg, EChatMessageType message_type);			
-			void SendClientJoinChannelToDrivers(ChatClientInfo client, ChatChannelInfo channel);
-			void SendClientPartChannelToDrivers(ChatClientInfo client, ChatChannelInfo channel, EChannelPartTypes part_reason, std::string reason_str);
-			void SendChannelModeUpdateToDrivers(ChatClientInfo client_info, ChatChannelInfo channel_info, ChanModeChangeData change_data);
-			void SendUpdateChannelTopicToDrivers(ChatClientInfo client, ChatChannelInfo channel);			
-			void SendSetChannelClientKeysToDrivers(ChatClientInfo client, ChatChannelInfo channel, std::map<std::string, std::string> kv_data);
-			void SendSetChannelKeysToDrivers(ChatClientInfo client, ChatChannelInfo channel, const std::map<std::string, std::string> kv_data);
-			void SendUserQuitMessage(ChatClientInfo client, std::string quit_reason);
+			static void SendClientMessageToDrivers(int target_id, ChatClientInfo user, const char *msg, EChatMessageType message_type);
+			static void SendChannelMessageToLocalMembers(ChatChannelInfo channel, ChatClientInfo user, const char *msg, EChatMessageType message_type);
+			void FlushChannelMessages();
+			static void SendClientJoinChannelToDrivers(ChatClientInfo client, ChatChannelInfo channel);
+			static void SendClientPartChannelToDrivers(ChatClientInfo client, ChatChannelInfo channel, EChannelPartTypes part_reason, std::string reason_str);
+			static void SendChannelModeUpdateToDrivers(ChatClientInfo client_info, ChatChannelInfo channel_info, ChanModeChangeData change_data);
+			static void SendUpdateChannelTopicToDrivers(ChatClientInfo client, ChatChannelInfo channel);			
+			static void SendSetChannelClientKeysToDrivers(ChatClientInfo client, ChatChannelInfo channel, std::map<std::string, std::string> kv_data);
+			static void SendSetChannelKeysToDrivers(ChatClientInfo client, ChatChannelInfo channel, const std::map<std::string, std::string> kv_data);
+			static void SendUserQuitMessage(ChatClientInfo client, std::string quit_reason);
 
 			static std::string ChannelInfoToKVString(ChatChannelInfo info);
 			static ChatChannelInfo ChannelInfoFromKVString(const char *str);
@@ -377,20 +416,18 @@ namespace Chat {
 
 			void DeleteChannel(int channel_id, std::string reason = "Channel Deleted");
 
-			std::vector<Chat::Driver *> m_drivers;
 			redisContext *mp_redis_connection;
-			redisContext *mp_redis_async_retrival_connection;
-			redisAsyncContext *mp_redis_async_connection;
-			struct event_base *mp_event_base;
-
-			bool m_flag_push_task;
-
-			OS::CThread *mp_async_thread;
+			int m_thread_index;
 
-			static ChatBackendTask *m_task_singleton;
+			//channel messages for other nodes, published once per channel after each pass over the queue
+			std::map<int, std::vector<ChatQueuedChannelMessage> > m_outgoing_channel_messages;
+			std::map<int, ChatChannelInfo> m_outgoing_channels;
 
 			std::map<EChanClientFlags, std::string> m_permission_name_map;
 	};
+	extern OS::TaskPool<ChatBackendTask, ChatQueryRequest> *m_task_pool;
+	void SetupTaskPool();
+	void ShutdownTaskPool();
 };
 
 #endif //_MM_QUERY_H
\ No newline at end of file
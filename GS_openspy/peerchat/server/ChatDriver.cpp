@@ -36,13 +36,14 @@ namespace Chat {
 		}
 
 		gettimeofday(&m_server_start, NULL);
-		Chat::ChatBackendTask::getQueryTask()->AddDriver(this);
+		Chat::ChatBackendTask::AddDriver(this);
 	}
 	Driver::~Driver() {
-		Chat::ChatBackendTask::getQueryTask()->RemoveDriver(this);
+		Chat::ChatBackendTask::RemoveDriver(this);
 		std::vector<Peer *>::iterator it = m_connections.begin();
 		while (it != m_connections.end()) {
 			Peer *peer = *it;
+			Chat::ChatBackendTask::RemoveLocalPeer(peer);
 			delete peer;
 			it++;
 		}
@@ -57,6 +58,7 @@ namespace Chat {
 			else {
 				//delete if marked for deletiontel
 				it = m_connections.erase(it);
+				Chat::ChatBackendTask::RemoveLocalPeer(peer);
 				delete peer;
 				
 				continue;
@@ -176,17 +178,6 @@ namespace Chat {
 			it++;
 		}
 	}
-	void Driver::OnSendChannelMessage(ChatChannelInfo channel, ChatClientInfo from_user, const char *msg, EChatMessageType message_type) {
-		std::vector<Peer *>::iterator it = m_connections.begin();
-		while (it != m_connections.end()) {
-			Peer *p = *it;
-			ChatClientInfo info = p->getClientInfo();
-			if(p->IsOnChannel(channel)) {
-				p->OnRecvChannelMessage(from_user, channel, msg, message_type);
-			}
-			it++;
-		}
-	}
 	void Driver::SendJoinChannelMessage(ChatClientInfo client, ChatChannelInfo channel) {
 		std::vector<Peer *>::iterator it = m_connections.begin();
 		while (it != m_connections.end()) {
@@ -1,12 +1,14 @@
 #include "ChatPeer.h"
 #include "ChatServer.h"
 #include "ChatDriver.h"
+#include "ChatBackend.h"
 ChatServer::ChatServer() : INetServer() {
 	m_name = "s-os-1";
 }
 ChatServer::~ChatServer() {
 }
 void ChatServer::init() {
+	Chat::SetupTaskPool();
 }
 void ChatServer::tick() {
 	NetworkTick();
@@ -248,8 +248,7 @@ namespace Chat {
 			uint8_t *p = (uint8_t*)&out_buff;
 			int out_len = 0;
 			BufferWriteData(&p, &out_len, buff, len);
-			int c = send(m_sd, (const char *)&out_buff, out_len, MSG_NOSIGNAL);
-			if(c < 0) {
+			if(!SendData(&out_buff, out_len)) {
 				m_delete_flag = true;
 			}
 		}
@@ -428,7 +427,6 @@ namespace Chat {
 				it++;
 			}
 
-			ChatBackendTask::getQueryTask()->flagPushTask();
 			ChatBackendTask::SubmitUpdateChannelModes(NULL, peer, data->driver, 0, 0, data->channel_info, data->channel_info.password, data->channel_info.limit, client_modechanges,ChatBackendTask::GetServerClient());
 
 			end_cleanup:
@@ -444,7 +442,6 @@ namespace Chat {
 			}
 
 			data->usermode = ChatBackendTask::FlattenUsermodes(response.usermodes, ((IRCPeer *)peer)->m_client_info, data->channel_info.name);
-			ChatBackendTask::getQueryTask()->flagPushTask();
 			ChatBackendTask::SubmitGetChannelUsers(OnSyncUserMode_GetChannelUsersCallback, peer, data, data->channel_info);
 			return;
 
@@ -458,7 +455,6 @@ namespace Chat {
 				goto end_cleanup;
 			}
 			data->channel_info = response.channel_info;
-			ChatBackendTask::getQueryTask()->flagPushTask();
 			ChatBackendTask::SubmitGetClientUsermodes(OnChanUsermodeLookup_SyncCallback, peer, data, response.channel_info.name, ((IRCPeer *)peer)->m_client_info);
 			return;
 
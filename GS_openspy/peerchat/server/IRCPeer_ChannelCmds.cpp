@@ -63,7 +63,6 @@ namespace Chat {
 				goto end_cleanup;
 			}
 
-			ChatBackendTask::getQueryTask()->flagPushTask();
 			ChatBackendTask::SubmitRemoveUserFromChannel(NULL, irc_peer, driver, response.channel_info, EChannelPartTypes_Part, part_reason);
 
 			end_cleanup:
@@ -129,6 +128,7 @@ namespace Chat {
 
 			if(user.client_id == m_client_info.client_id) {
 				m_channel_list.push_back(channel.channel_id);
+				ChatBackendTask::AddLocalChannelMember(channel.channel_id, this);
 				send_channel_topic(channel);
 				send_channel_names(channel);
 			} else {
@@ -147,9 +147,10 @@ namespace Chat {
 			SendPacket((const uint8_t*)s.str().c_str(),s.str().length());
 
 			if(user.client_id == m_client_info.client_id) {
-				std::vector<int>::iterator it = std::find(m_channel_list.begin(), m_channel_list.end(), 5);
+				std::vector<int>::iterator it = std::find(m_channel_list.begin(), m_channel_list.end(), channel.channel_id);
 				if(it != m_channel_list.end())
 				    m_channel_list.erase(it);
+				ChatBackendTask::RemoveLocalChannelMember(channel.channel_id, this);
 				if(m_client_channel_hits.find(user.client_id) != m_client_channel_hits.end())
 					m_client_channel_hits[user.client_id].m_hits--;
 			}
@@ -212,12 +213,9 @@ namespace Chat {
 				goto end_cleanup;
 			}
 
-			ChatBackendTask::getQueryTask()->flagPushTask();
-
 			if(response.channel_info.channel_id == 0) {
 
 			} else {
-				ChatBackendTask::getQueryTask()->flagPushTask();
 				ChatBackendTask::SubmitGetChannelUsers(OnNamesCmd_FindUsersCallback, irc_peer, info, response.channel_info);
 				return;
 			}
@@ -721,7 +719,6 @@ namespace Chat {
 			if(irc_peer->send_callback_error(request, response)) {
 				goto end_cleanup;
 			}
-			ChatBackendTask::getQueryTask()->flagPushTask();
 			ChatBackendTask::SubmitGetChannelUser(OnGetCKeyCmd_FindChanUserCallback, irc_peer, cb_data, response.channel_info, *cb_data->target_user);
 
 			end_cleanup:
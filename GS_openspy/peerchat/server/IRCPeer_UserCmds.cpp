@@ -43,7 +43,6 @@ namespace Chat {
 				irc_peer->send_numeric(433, s.str(), true);
 			} else {
 				irc_peer->m_client_info.name = request.query_name;
-				ChatBackendTask::getQueryTask()->flagPushTask();
 				ChatBackendTask::SubmitClientInfo(OnNickCmd_SubmitClientInfo, peer, driver);
 			}
 			irc_peer->mp_mutex->unlock();
@@ -124,10 +123,8 @@ namespace Chat {
 				goto end_cleanup;
 			}
 			if(response.client_info.client_id != 0) {
-				ChatBackendTask::getQueryTask()->flagPushTask();
 				ChatBackendTask::SubmitClientMessage(response.client_info.client_id, cb_data->message, cb_data->message_type, NULL, peer, driver);
 			} else if(response.channel_info.channel_id != 0) {
-				ChatBackendTask::getQueryTask()->flagPushTask();
 				ChatBackendTask::SubmitChannelMessage(response.channel_info.channel_id, cb_data->message, cb_data->message_type, NULL, peer, driver);
 			}
 			end_cleanup:
@@ -350,7 +347,6 @@ namespace Chat {
 				s << ":SERVER!SERVER@* NOTICE " << irc_peer->m_client_info.name << " :Rights Granted" << std::endl;
 				irc_peer->SendPacket((const uint8_t *)s.str().c_str(),s.str().length());
 				irc_peer->m_client_info.operflags = response.operflags;
-				ChatBackendTask::getQueryTask()->flagPushTask();
 				ChatBackendTask::SubmitClientInfo(NULL, (Peer *)irc_peer, driver);
 			}
 		}
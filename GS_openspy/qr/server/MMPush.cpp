@@ -2,9 +2,11 @@
 #include "MMPush.h"
 
 #include <OS/Redis.h>
+#include <OS/Analytics/Instrument.h>
 #include <OS/legacy/helpers.h>
 #include "QRDriver.h"
 #include "QRPeer.h"
+#include "MMPushDelta.h"
 
 #include <sstream>
 #include <algorithm>
@@ -12,6 +14,8 @@
 #define MM_PUSH_EXPIRE_TIME 1800
 
 namespace MM {
+	OS::Counter g_heartbeat_deltas("qr_heartbeat_deltas", "Heartbeats which changed keys, written as a delta");
+	OS::Counter g_heartbeat_unchanged("qr_heartbeat_unchanged", "Heartbeats with no changes, which only refreshed expiry");
 	const char *sb_mm_channel = "serverbrowsing.servers";
 	OS::TaskPool<MMPushTask, MMPushRequest> *m_task_pool = NULL;
 	const char *mp_pk_name = "QRID";
@@ -109,19 +113,17 @@ namespace MM {
 	}
 	void *MMPushTask::TaskThread(OS::CThread *thread) {
 		MMPushTask *task = (MMPushTask *)thread->getParams();
-		while (!task->m_request_list.empty() || task->mp_thread_poller->wait()) {
-			task->mp_mutex->lock();
+		while (task->HasRequests() || task->mp_thread_poller->wait()) {
 			task->m_thread_awake = true;
-			while (!task->m_request_list.empty()) {
-				MMPushRequest task_params = task->m_request_list.front();
-				task->mp_mutex->unlock();
+			MMPushRequest task_params;
+			while (task->PopRequest(task_params)) {
 				task->mp_timer->start();
 				switch (task_params.type) {
 				case EMMPushRequestType_PushServer:
 					task->PerformPushServer(task_params);
 					break;
 				case EMMPushRequestType_UpdateServer:
-					task->PerformDeleteMissingKeysAndUpdateChanged(task_params);
+					task->PerformUpdateServerDelta(task_params);
 					break;
 				case EMMPushRequestType_UpdateServer_NoDiff:
 					task->PerformUpdateServer(task_params);
@@ -138,11 +140,8 @@ namespace MM {
 					OS::LogText(OS::ELogLevel_Info, "[%s] Thread type %d - time: %f", OS::Address(*task_params.peer->getAddress()).ToString().c_str(), task_params.type, task->mp_timer->time_elapsed() / 1000000.0);
 				}
 				task_params.peer->DecRef();
-				task->mp_mutex->lock();
-				task->m_request_list.pop();
 			}
 			task->m_thread_awake = false;
-			task->mp_mutex->unlock();
 		}
 		return NULL;
 	}
@@ -152,196 +151,56 @@ namespace MM {
 			request.peer->OnRegisteredServer(pk_id, request.extra);
 		}
 	}
-	void MMPushTask::PerformDeleteMissingKeysAndUpdateChanged(MMPushRequest request) {
-		//find missing keys and push deletes
-		std::map<std::string, std::string>::iterator it = request.old_server.m_keys.begin();
-		std::map<std::string, std::vector<std::string> >::iterator it2;
-		std::vector<std::string>::iterator it3;
-		std::vector<std::string> missing_keys, missing_team_keys, missing_player_keys;
-
-		Redis::Value v;
-		Redis::Response resp;
-		std::string name;
-		int idx = 0;
-		bool force_delete = false;
-		bool change_occured = false;
-		ServerInfo modified_server;
-
-		modified_server.groupid = 0;
-
-		while (it != request.old_server.m_keys.end()) {
-			std::pair<std::string, std::string> p = *it;
-			if(request.server.m_keys.find(p.first) == request.server.m_keys.end()) {
-				missing_keys.push_back(p.first);
-			}
-			it++;
-		}		
-
-		it2 = request.old_server.m_player_keys.begin();
-		while(it2 != request.old_server.m_player_keys.end()) {
-			std::pair<std::string, std::vector<std::string> > p = *it2;
-			if(request.server.m_player_keys.find(p.first) == request.server.m_player_keys.end()) {
-				missing_player_keys.push_back(p.first);
-			}
-			it2++;
-		}
-		
-		it2 = request.old_server.m_team_keys.begin();
-		while(it2 != request.old_server.m_team_keys.end()) {
-			std::pair<std::string, std::vector<std::string> > p = *it2;
-			if(request.server.m_team_keys.find(p.first) == request.server.m_team_keys.end()) {
-				missing_team_keys.push_back(p.first);
-			}
-			it2++;
+	void MMPushTask::PerformUpdateServerDelta(MMPushRequest request) {
+		std::map<int, ServerInfo>::iterator snapshot_it = m_server_snapshots.find(request.server.id);
+		if (snapshot_it == m_server_snapshots.end()) {
+			//pushed before this task saw it, so what redis holds is unknown, rewrite it whole
+			PerformUpdateServer(request);
+			return;
 		}
+		ServerInfo &old_server = snapshot_it->second;
 
-		
 		std::ostringstream ss;
 		ss << request.server.m_game.gamename << ":" << request.server.groupid << ":" << request.server.id << ":";
 		std::string server_key = ss.str();
 
+		//MULTI so a list request never sees half of a heartbeat
+		bool changed = false;
+		Redis::AppendCommand(mp_redis_connection, "SELECT %d", OS::ERedisDB_QR);
+		Redis::AppendCommand(mp_redis_connection, "MULTI");
+		changed |= AppendHashDelta(mp_redis_connection, server_key + "custkeys", old_server.m_keys, request.server.m_keys);
+		changed |= AppendSlotDeltas(mp_redis_connection, server_key + "custkeys_player_", old_server.m_player_keys, request.server.m_player_keys);
+		changed |= AppendSlotDeltas(mp_redis_connection, server_key + "custkeys_team_", old_server.m_team_keys, request.server.m_team_keys);
+		AppendExpires(server_key, request.server);
+		Redis::AppendCommand(mp_redis_connection, "EXEC");
 
-
-		Redis::Command(mp_redis_connection, 0, "SELECT %d", OS::ERedisDB_QR);
-		it3 = missing_keys.begin();
-		while(it3 != missing_keys.end()) {
-			std::string s = *it3;
-			Redis::Command(mp_redis_connection, 0, "HDEL %scustkeys %s", ss.str().c_str(),s.c_str());
-			it3++;
-		}
-
-		ss.str("");
-		while(true) {
-			force_delete = false;
-			if(request.server.m_player_keys.size() > 0) {
-				if(idx > (*request.server.m_player_keys.begin()).second.size()) {
-					force_delete = true;
-				}
-			}
-			ss << server_key << "custkeys_player_" << idx++;
-			resp = Redis::Command(mp_redis_connection, 0, "EXISTS %s", ss.str().c_str());
-			v = resp.values.front();
-			int ret = -1;
-			if (v.type == Redis::REDIS_RESPONSE_TYPE_INTEGER) {
-				ret = v.value._int;
-			}
-			else if (v.type == Redis::REDIS_RESPONSE_TYPE_STRING) {
-				ret = atoi(v.value._str.c_str());
-			}
-			if(ret <= 0) {
-				break;
-			}
-			if(force_delete) {
-				Redis::Command(mp_redis_connection, 0, "DEL %s", ss.str().c_str());
-				goto end;
-			}
-			it3 = missing_player_keys.begin();
-			while(it3 != missing_player_keys.end()) {
-				name = *it3;
-				Redis::Command(mp_redis_connection, 0, "HDEL %s %s", ss.str().c_str(), name.c_str());
-				it3++;
-			}
-
-
-			end:
-			ss.str("");
+		if (changed) {
+			g_heartbeat_deltas.Add();
+			Redis::AppendCommand(mp_redis_connection, "PUBLISH %s '\\update\\%s:%d:%d:'", sb_mm_channel, request.server.m_game.gamename, request.server.groupid, request.server.id);
 		}
-		
-		idx = 0;
-		ss.str("");
-		while(true) {
-			force_delete = false;
-			if(request.server.m_team_keys.size() > 0) {
-				if(idx > (*request.server.m_team_keys.begin()).second.size()) {
-					force_delete = true;
-				}
-			}
-
-			ss << server_key << "custkeys_team_" << idx++;
-			resp = Redis::Command(mp_redis_connection, 0, "EXISTS %s", ss.str().c_str());
-			v = resp.values.front();
-			int ret = -1;
-			if (v.type == Redis::REDIS_RESPONSE_TYPE_INTEGER) {
-				ret = v.value._int;
-			}
-			else if (v.type == Redis::REDIS_RESPONSE_TYPE_STRING) {
-				ret = atoi(v.value._str.c_str());
-			}
-			if(ret <= 0) {
-				break;
-			}
-			if(force_delete) {
-				Redis::Command(mp_redis_connection, 0, "DEL %s", ss.str().c_str());
-				goto end;
-			}
-			it3 = missing_team_keys.begin();
-			while(it3 != missing_team_keys.end()) {
-				std::string name = *it3;
-				Redis::Command(mp_redis_connection, 0, "HDEL %s %s", ss.str().c_str(), name.c_str());
-				it3++;
-			}
-			ss.str("");
+		else {
+			g_heartbeat_unchanged.Add();
 		}
+		Redis::Flush(mp_redis_connection);
 
-		//create ServerInfo struct with changed keys only
-		modified_server.m_game = request.server.m_game;
-		modified_server.id = request.server.id;
-		modified_server.m_address = request.server.m_address;
-		it = request.server.m_keys.begin();
-		while(it != request.server.m_keys.end()) {
-			std::pair<std::string, std::string> p = *it;
-			if(std::find(missing_keys.begin(), missing_keys.end(), p.first) == missing_keys.end()) {
-				if(request.server.m_keys[p.first].compare(request.old_server.m_keys[p.first]) != 0) {
-					modified_server.m_keys[p.first] = request.server.m_keys[p.first];
-					change_occured = true;
-				} 
-			}
-			it++;
-		}
+		old_server.m_keys.swap(request.server.m_keys);
+		old_server.m_player_keys.swap(request.server.m_player_keys);
+		old_server.m_team_keys.swap(request.server.m_team_keys);
+	}
+	void MMPushTask::AppendExpires(std::string server_key, ServerInfo &server) {
+		std::string ipinput = server.m_address.ToString(true);
+		Redis::AppendCommand(mp_redis_connection, "EXPIRE IPMAP_%s-%d %d", ipinput.c_str(), server.m_address.GetPort(), MM_PUSH_EXPIRE_TIME);
+		Redis::AppendCommand(mp_redis_connection, "EXPIRE %s %d", server_key.c_str(), MM_PUSH_EXPIRE_TIME);
+		Redis::AppendCommand(mp_redis_connection, "EXPIRE %scustkeys %d", server_key.c_str(), MM_PUSH_EXPIRE_TIME);
 
-		it2 = request.server.m_player_keys.begin();
-		while(it2 != request.server.m_player_keys.end()) {
-			std::pair<std::string, std::vector<std::string> > p = *it2;
-			if(std::find(missing_player_keys.begin(), missing_player_keys.end(), p.first) == missing_player_keys.end()) {
-				it3 = p.second.begin();
-				idx = 0;
-				while(it3 != p.second.end()) {
-					if(request.old_server.m_player_keys[p.first].size() > idx && request.server.m_player_keys[p.first].size() > idx && request.server.m_player_keys[p.first][idx].compare(request.old_server.m_player_keys[p.first][idx]) == 0) {
-						modified_server.m_player_keys[p.first].push_back(std::string());
-					} else {
-						modified_server.m_player_keys[p.first].push_back(request.server.m_player_keys[p.first][idx]);
-						change_occured = true;
-					}
-					idx++;
-					it3++;
-				}
-			}
-			it2++;
+		int num_slots = GetNumSlots(server.m_player_keys);
+		for (int i = 0; i < num_slots; i++) {
+			Redis::AppendCommand(mp_redis_connection, "EXPIRE %scustkeys_player_%d %d", server_key.c_str(), i, MM_PUSH_EXPIRE_TIME);
 		}
-
-		it2 = request.server.m_team_keys.begin();
-		while(it2 != request.server.m_team_keys.end()) {
-			std::pair<std::string, std::vector<std::string> > p = *it2;
-			if(std::find(missing_team_keys.begin(), missing_team_keys.end(), p.first) == missing_team_keys.end()) {
-				it3 = p.second.begin();
-				idx = 0;
-				while(it3 != p.second.end()) {
-					if(request.old_server.m_team_keys.size() > idx && request.server.m_team_keys.size() > idx && request.server.m_team_keys[p.first][idx].compare(request.old_server.m_team_keys[p.first][idx]) == 0) {
-						modified_server.m_team_keys[p.first].push_back(std::string());
-					} else {
-						modified_server.m_team_keys[p.first].push_back(request.server.m_team_keys[p.first][idx]);
-						change_occured = true;
-					}
-					idx++;
-					it3++;
-				}
-			}
-			it2++;
+		num_slots = GetNumSlots(server.m_team_keys);
+		for (int i = 0; i < num_slots; i++) {
+			Redis::AppendCommand(mp_redis_connection, "EXPIRE %scustkeys_team_%d %d", server_key.c_str(), i, MM_PUSH_EXPIRE_TIME);
 		}
-		PushServer(modified_server, false, request.server.id); //push to prevent expire
-
-		if(change_occured)
-			Redis::Command(mp_redis_connection, 0, "PUBLISH %s '\\update\\%s:%d:%d:'", sb_mm_channel, modified_server.m_game.gamename, modified_server.groupid, modified_server.id);
 	}
 	void MMPushTask::PerformUpdateServer(MMPushRequest request) {
 		DeleteServer(request.server, false);
@@ -349,6 +208,7 @@ namespace MM {
 	}
 	void MMPushTask::PerformDeleteServer(MMPushRequest request) {
 		DeleteServer(request.server, true);
+		m_server_snapshots.erase(request.server.id);
 	}
 	void MMPushTask::PerformGetGameInfo(MMPushRequest request) {
 		OS::GameData game_info = OS::GetGameByName(request.gamename.c_str(), mp_redis_connection);
@@ -372,100 +232,36 @@ namespace MM {
 		s << server.m_game.gamename << ":" << groupid << ":" << id << ":";
 		std::string server_key = s.str();
 
-		Redis::Command(mp_redis_connection, 0, "SELECT %d", OS::ERedisDB_QR);
-
-		if(pk_id == -1) {
-			Redis::Command(mp_redis_connection, 0, "HSET %s gameid %d", server_key.c_str(), server.m_game.gameid);
-			Redis::Command(mp_redis_connection, 0, "HSET %s id %d", server_key.c_str(), id);
-
-			Redis::Command(mp_redis_connection, 0, "HDEL %s deleted", server_key.c_str()); //incase resume
-		}
-
-		
 		std::string ipinput = server.m_address.ToString(true);
 
-
-
-		Redis::Command(mp_redis_connection, 0, "SET IPMAP_%s-%d %s", ipinput.c_str(), server.m_address.GetPort(), server_key.c_str());
-		Redis::Command(mp_redis_connection, 0, "EXPIRE IPMAP_%s-%d %d", ipinput.c_str(), server.m_address.GetPort(), MM_PUSH_EXPIRE_TIME);
-
+		Redis::AppendCommand(mp_redis_connection, "SELECT %d", OS::ERedisDB_QR);
 
 		if(pk_id == -1) {
-			Redis::Command(mp_redis_connection, 0, "HSET %s gameid %d", server_key.c_str(), server.m_game.gameid);
-			Redis::Command(mp_redis_connection, 0, "HSET %s wan_port %d", server_key.c_str(), server.m_address.GetPort());
-			Redis::Command(mp_redis_connection, 0, "HSET %s wan_ip \"%s\"", server_key.c_str(), ipinput.c_str());
+			Redis::AppendCommand(mp_redis_connection, "HSET %s gameid %d id %d wan_port %d wan_ip \"%s\"", server_key.c_str(), server.m_game.gameid, id, server.m_address.GetPort(), ipinput.c_str());
+			Redis::AppendCommand(mp_redis_connection, "HDEL %s deleted", server_key.c_str()); //incase resume
 		}
 		else {
-			Redis::Command(mp_redis_connection, 0, "ZINCRBY %s 1 \"%s\"", server.m_game.gamename, server_key.c_str());
-		}
-
-		Redis::Command(mp_redis_connection, 0, "HINCRBY %s num_beats 1", server_key.c_str());
-
-
-		Redis::Command(mp_redis_connection, 0, "EXPIRE %s %d", server_key.c_str(), MM_PUSH_EXPIRE_TIME);
-
-		std::map<std::string, std::string>::iterator it = server.m_keys.begin();
-		while (it != server.m_keys.end()) {
-			std::pair<std::string, std::string> p = *it;
-			Redis::Command(mp_redis_connection, 0, "HSET %scustkeys %s \"%s\"", server_key.c_str(), p.first.c_str(), OS::escapeJSON(p.second).c_str());
-			it++;
-		}
-		Redis::Command(mp_redis_connection, 0, "EXPIRE %scustkeys %d", server_key.c_str(), MM_PUSH_EXPIRE_TIME);
-
-		std::map<std::string, std::vector<std::string> >::iterator it2 = server.m_player_keys.begin();
-
-		int i = 0, max_idx = 0;
-		std::pair<std::string, std::vector<std::string> > p;
-		std::vector<std::string>::iterator it3;
-		while (it2 != server.m_player_keys.end()) {
-			p = *it2;
-			it3 = p.second.begin();
-			while (it3 != p.second.end()) {
-				std::string s = *it3;
-				if(s.length() > 0) {
-					Redis::Command(mp_redis_connection, 0, "HSET %scustkeys_player_%d %s \"%s\"", server_key.c_str(), i, p.first.c_str(), OS::escapeJSON(s).c_str());
-				}
-				i++;
-				it3++;
-			}
-			max_idx= i;
-			i = 0;
-			it2++;
-		}
-
-		for(i=0;i<max_idx;i++) {
-			Redis::Command(mp_redis_connection, 0, "EXPIRE %scustkeys_player_%d %d", server_key.c_str(), i, MM_PUSH_EXPIRE_TIME);
+			Redis::AppendCommand(mp_redis_connection, "ZINCRBY %s 1 \"%s\"", server.m_game.gamename, server_key.c_str());
 		}
-		i=0;
-
 
-		it2 = server.m_team_keys.begin();
-		while (it2 != server.m_team_keys.end()) {
-			p = *it2;
-			it3 = p.second.begin();
-			while (it3 != p.second.end()) {
+		Redis::AppendCommand(mp_redis_connection, "SET IPMAP_%s-%d %s", ipinput.c_str(), server.m_address.GetPort(), server_key.c_str());
+		Redis::AppendCommand(mp_redis_connection, "HINCRBY %s num_beats 1", server_key.c_str());
 
-				std::string s = *it3;
-				if(s.length() > 0) {
-					Redis::Command(mp_redis_connection, 0, "HSET %scustkeys_team_%d %s \"%s\"", server_key.c_str(), i, p.first.c_str(), OS::escapeJSON(s).c_str());
-					i++;
-				}
-				it3++;
-			}
-			max_idx= i;
-			i = 0;
-			it2++;
-		}
-		for(i=0;i<max_idx;i++) {
-			Redis::Command(mp_redis_connection, 0, "EXPIRE %scustkeys_team_%d %d", server_key.c_str(), i, MM_PUSH_EXPIRE_TIME);
-		}
-		i=0;
+		//everything is new to redis here, so the delta from nothing is the full set of keys
+		ServerInfo empty_server;
+		AppendHashDelta(mp_redis_connection, server_key + "custkeys", empty_server.m_keys, server.m_keys);
+		AppendSlotDeltas(mp_redis_connection, server_key + "custkeys_player_", empty_server.m_player_keys, server.m_player_keys);
+		AppendSlotDeltas(mp_redis_connection, server_key + "custkeys_team_", empty_server.m_team_keys, server.m_team_keys);
+		AppendExpires(server_key, server);
 
-		Redis::Command(mp_redis_connection, 0, "SELECT %d", OS::ERedisDB_QR);
 		if (publish) {
-			Redis::Command(mp_redis_connection, 0, "ZADD %s %d \"%s\"", server.m_game.gamename, pk_id, server_key.c_str());
-			Redis::Command(mp_redis_connection, 0, "PUBLISH %s '\\new\\%s'", sb_mm_channel, server_key.c_str());
+			Redis::AppendCommand(mp_redis_connection, "ZADD %s %d \"%s\"", server.m_game.gamename, pk_id, server_key.c_str());
+			Redis::AppendCommand(mp_redis_connection, "PUBLISH %s '\\new\\%s'", sb_mm_channel, server_key.c_str());
 		}
+		Redis::Flush(mp_redis_connection);
+
+		//later heartbeats from this server come to this task, and are diffed against this
+		m_server_snapshots[id] = server;
 
 		return id;
 
@@ -497,13 +293,13 @@ namespace MM {
 			else if (v.type == Redis::REDIS_RESPONSE_TYPE_STRING && v.value._str.compare("1") == 0) {
 				return;
 			}
-			Redis::Command(mp_redis_connection, 0, "HSET %s:%d:%d: deleted 1", server.m_game.gamename, server.groupid, server.id);
-			Redis::Command(mp_redis_connection, 0, "EXPIRE %s:%d:%d: %d", server.m_game.gamename, server.groupid, server.id, MM_PUSH_EXPIRE_TIME);
-			Redis::Command(mp_redis_connection, 0, "PUBLISH %s '\\del\\%s:%d:%d:'", sb_mm_channel, server.m_game.gamename, groupid, id);
+			Redis::AppendCommand(mp_redis_connection, "HSET %s:%d:%d: deleted 1", server.m_game.gamename, server.groupid, server.id);
+			Redis::AppendCommand(mp_redis_connection, "EXPIRE %s:%d:%d: %d", server.m_game.gamename, server.groupid, server.id, MM_PUSH_EXPIRE_TIME);
+			Redis::AppendCommand(mp_redis_connection, "PUBLISH %s '\\del\\%s:%d:%d:'", sb_mm_channel, server.m_game.gamename, groupid, id);
 		}
 		else {
-			Redis::Command(mp_redis_connection, 0, "DEL %s:%d:%d:", server.m_game.gamename, server.groupid, server.id);
-			Redis::Command(mp_redis_connection, 0, "DEL %s:%d:%d:custkeys", server.m_game.gamename, server.groupid, server.id);
+			Redis::AppendCommand(mp_redis_connection, "DEL %s:%d:%d:", server.m_game.gamename, server.groupid, server.id);
+			Redis::AppendCommand(mp_redis_connection, "DEL %s:%d:%d:custkeys", server.m_game.gamename, server.groupid, server.id);
 
 			int i = 0;
 			int groupid = server.groupid;
@@ -518,7 +314,7 @@ namespace MM {
 				it3 = p.second.begin();
 				while (it3 != p.second.end()) { //XXX: will be duplicate deletes but better than writing stuff to delete indivually atm, rewrite later though
 					std::string s = *it3;
-					Redis::Command(mp_redis_connection, 0, "DEL %s:%d:%d:custkeys_player_%d", server.m_game.gamename, groupid, id, i);
+					Redis::AppendCommand(mp_redis_connection, "DEL %s:%d:%d:custkeys_player_%d", server.m_game.gamename, groupid, id, i);
 					i++;
 					it3++;
 				}
@@ -534,7 +330,7 @@ namespace MM {
 				it3 = p.second.begin();
 				while (it3 != p.second.end()) { //XXX: will be duplicate deletes but better than writing stuff to delete indivually atm, rewrite later though
 					std::string s = *it3;
-					Redis::Command(mp_redis_connection, 0, "DEL %s:%d:%d:custkeys_team_%d", server.m_game.gamename, groupid, id, i);
+					Redis::AppendCommand(mp_redis_connection, "DEL %s:%d:%d:custkeys_team_%d", server.m_game.gamename, groupid, id, i);
 					i++;
 					it3++;
 				}
@@ -543,6 +339,7 @@ namespace MM {
 				it2++;
 			}
 		}
+		Redis::Flush(mp_redis_connection);
 	}
 	int MMPushTask::GetServerID() {
 		Redis::Command(mp_redis_connection, 0, "SELECT %d", OS::ERedisDB_QR);
@@ -566,10 +363,13 @@ namespace MM {
 		mp_redis_async_retrival_connection = Redis::Connect(OS::g_redisAddress, t);
 		mp_async_thread = OS::CreateThread(setup_redis_async, server, true);
 
-		m_task_pool = new OS::TaskPool<MMPushTask, MMPushRequest>(NUM_MM_PUSH_THREADS);
+		m_task_pool = new OS::TaskPool<MMPushTask, MMPushRequest>(NUM_MM_PUSH_THREADS, OS::ETaskDispatch_Affinity);
 		server->SetTaskPool(m_task_pool);
+
+		OS::InstrumentRegistry::getSingleton()->AddCollector("qr_backend", m_task_pool);
 	}
 	void Shutdown() {
+		OS::InstrumentRegistry::getSingleton()->RemoveCollectors(m_task_pool);
 
 	}
 	int MMPushTask::TryFindServerID(ServerInfo server) {
@@ -43,7 +43,6 @@ namespace MM {
 		EMMPushRequestType type;
 		QR::Peer *peer;
 		ServerInfo server;
-		ServerInfo old_server;
 		std::string gamename;
 		void *extra;
 	} MMPushRequest;
@@ -63,9 +62,11 @@ namespace MM {
 			void PerformDeleteServer(MMPushRequest request);
 			void PerformGetGameInfo(MMPushRequest request);
 
-			//server update functions
-			void PerformDeleteMissingKeysAndUpdateChanged(MMPushRequest request);
-			
+			//writes only what changed since the server's snapshot, in one MULTI
+			void PerformUpdateServerDelta(MMPushRequest request);
+
+			void AppendExpires(std::string server_key, ServerInfo &server);
+
 			int PushServer(ServerInfo server, bool publish, int pk_id = -1);
 			void UpdateServer(ServerInfo server);
 			void DeleteServer(ServerInfo server, bool publish);
@@ -79,6 +80,9 @@ namespace MM {
 
 			int m_thread_index;
 
+			//by server id, what was last written to redis, requests are dispatched by peer so a server always comes to the same task
+			std::map<int, ServerInfo> m_server_snapshots;
+
 
 	};
 
@@ -0,0 +1,106 @@
+#include "MMPushDelta.h"
+
+#include <sstream>
+
+namespace MM {
+	static const std::string empty_value;
+
+	bool AppendHashDelta(Redis::Connection *connection, std::string key, const std::map<std::string, std::string> &old_keys, const std::map<std::string, std::string> &new_keys) {
+		std::ostringstream hset, hdel;
+		int num_set = 0, num_del = 0;
+
+		//both maps are sorted, so one merged walk finds the added, changed and removed keys
+		std::map<std::string, std::string>::const_iterator old_it = old_keys.begin(), new_it = new_keys.begin();
+		while (old_it != old_keys.end() || new_it != new_keys.end()) {
+			if (new_it == new_keys.end() || (old_it != old_keys.end() && old_it->first < new_it->first)) {
+				hdel << " " << old_it->first;
+				num_del++;
+				old_it++;
+			}
+			else if (old_it == old_keys.end() || new_it->first < old_it->first) {
+				hset << " " << new_it->first << " \"" << OS::escapeJSON(new_it->second) << "\"";
+				num_set++;
+				new_it++;
+			}
+			else {
+				if (old_it->second.compare(new_it->second) != 0) {
+					hset << " " << new_it->first << " \"" << OS::escapeJSON(new_it->second) << "\"";
+					num_set++;
+				}
+				old_it++;
+				new_it++;
+			}
+		}
+		if (num_set > 0) {
+			Redis::AppendCommand(connection, "HSET %s%s", key.c_str(), hset.str().c_str());
+		}
+		if (num_del > 0) {
+			Redis::AppendCommand(connection, "HDEL %s%s", key.c_str(), hdel.str().c_str());
+		}
+		return num_set > 0 || num_del > 0;
+	}
+	bool AppendSlotDeltas(Redis::Connection *connection, std::string key_prefix, const std::map<std::string, std::vector<std::string> > &old_keys, const std::map<std::string, std::vector<std::string> > &new_keys) {
+		int old_slots = GetNumSlots(old_keys), new_slots = GetNumSlots(new_keys);
+		bool changed = false;
+		for (int i = 0; i < new_slots; i++) {
+			std::ostringstream hset, hdel;
+			int num_set = 0, num_del = 0;
+
+			//slots are rows of the key columns, empty values aren't stored
+			std::map<std::string, std::vector<std::string> >::const_iterator old_it = old_keys.begin(), new_it = new_keys.begin();
+			while (old_it != old_keys.end() || new_it != new_keys.end()) {
+				bool take_old = new_it == new_keys.end() || (old_it != old_keys.end() && old_it->first <= new_it->first);
+				bool take_new = old_it == old_keys.end() || (new_it != new_keys.end() && new_it->first <= old_it->first);
+				const std::string &name = take_new ? new_it->first : old_it->first;
+				const std::string &old_value = take_old && i < (int)old_it->second.size() ? old_it->second[i] : empty_value;
+				const std::string &new_value = take_new && i < (int)new_it->second.size() ? new_it->second[i] : empty_value;
+				if (old_value.compare(new_value) != 0) {
+					if (new_value.length() > 0) {
+						hset << " " << name << " \"" << OS::escapeJSON(new_value) << "\"";
+						num_set++;
+					}
+					else {
+						hdel << " " << name;
+						num_del++;
+					}
+				}
+				if (take_old) {
+					old_it++;
+				}
+				if (take_new) {
+					new_it++;
+				}
+			}
+
+			if (num_set > 0) {
+				Redis::AppendCommand(connection, "HSET %s%d%s", key_prefix.c_str(), i, hset.str().c_str());
+			}
+			if (num_del > 0) {
+				Redis::AppendCommand(connection, "HDEL %s%d%s", key_prefix.c_str(), i, hdel.str().c_str());
+			}
+			changed |= num_set > 0 || num_del > 0;
+		}
+
+		//players who left, UNLINK frees them off the redis main thread
+		if (old_slots > new_slots) {
+			std::ostringstream unlink;
+			for (int i = new_slots; i < old_slots; i++) {
+				unlink << " " << key_prefix << i;
+			}
+			Redis::AppendCommand(connection, "UNLINK%s", unlink.str().c_str());
+			changed = true;
+		}
+		return changed;
+	}
+	int GetNumSlots(const std::map<std::string, std::vector<std::string> > &keys) {
+		int num_slots = 0;
+		std::map<std::string, std::vector<std::string> >::const_iterator it = keys.begin();
+		while (it != keys.end()) {
+			if ((int)it->second.size() > num_slots) {
+				num_slots = it->second.size();
+			}
+			it++;
+		}
+		return num_slots;
+	}
+}
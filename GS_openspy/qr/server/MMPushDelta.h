@@ -0,0 +1,21 @@
+#ifndef _MMPUSHDELTA_H
+#define _MMPUSHDELTA_H
+#include <OS/OpenSpy.h>
+#include <map>
+#include <vector>
+#include <string>
+#include <OS/Redis.h>
+
+namespace MM {
+	/*
+		The commands turning a server's keys as redis last saw them into its new keys, appended to the connection
+		for the caller to Flush. Kept apart from MMPushTask so osbench times the same commands QR sends.
+	*/
+
+	//append HSET/HDEL for the added, changed and removed keys, return true if there were any
+	bool AppendHashDelta(Redis::Connection *connection, std::string key, const std::map<std::string, std::string> &old_keys, const std::map<std::string, std::string> &new_keys);
+	//the same per player/team slot, slots past the new count are UNLINKed
+	bool AppendSlotDeltas(Redis::Connection *connection, std::string key_prefix, const std::map<std::string, std::vector<std::string> > &old_keys, const std::map<std::string, std::vector<std::string> > &new_keys);
+	int GetNumSlots(const std::map<std::string, std::vector<std::string> > &keys);
+}
+#endif //_MMPUSHDELTA_H
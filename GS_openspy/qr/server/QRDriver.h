@@ -5,6 +5,8 @@
 #include <OS/OpenSpy.h>
 #include <OS/Mutex.h>
 #include <OS/Net/NetDriver.h>
+#include <OS/Net/NetPeerIndex.h>
+#include <OS/Net/UDPBatch.h>
 
 #include "QRPeer.h"
 
@@ -18,7 +20,7 @@
 #endif
 
 #define MAX_DATA_SIZE 1400
-#define DRIVER_THREAD_TIME 1000
+#define DRIVER_REAP_TIME 100 //how often deleted peers which are still referenced are checked on
 namespace QR {
 	class Peer;
 	typedef struct _PeerStats PeerStats;
@@ -35,30 +37,40 @@ namespace QR {
 		uint32_t getDeltaTime();
 
 		Peer *find_client(struct sockaddr_in *address);
+		//returns the peer with a reference the caller drops
 		Peer *find_or_create(struct sockaddr_in *address, int version = 2);
 
+		int SendDatagram(const struct sockaddr_in *address, const void *data, int len);
+
 		const std::vector<int> getSockets();
 		int GetNumConnections();
 
 		const std::vector<INetPeer *> getPeers(bool inc_ref = false);
-		OS::MetricInstance GetMetrics();
+
+		void OnPeerThink(INetPeer *peer);
 	private:
-		static void *TaskThread(OS::CThread *thread);
-		void TickConnections();
+		static void OnReapTimer(void *extra);
+		UDPBatch *AcquireBatch();
+		void ReleaseBatch(UDPBatch *batch);
+		void DeletePeer(Peer *peer);
 
 		int m_sd;
 
 		std::vector<Peer *> m_connections;
 		std::vector<Peer *> m_peers_to_delete;
+		NetPeerIndex<Peer> m_peer_index;
 		
 		struct sockaddr_in m_local_addr;
 
 		struct timeval m_server_start;
 
-		std::queue<PeerStats> m_stats_queue; //pending stats to be sent(deleted clients)
+
+		//idle batches, a reactor thread draining the socket takes one so concurrent drains don't share buffers
+		std::vector<UDPBatch *> m_batches;
+
+		OS::TimerWheelEntry m_reap_timer;
 
 		OS::CMutex *mp_mutex;
-		OS::CThread *mp_thread;
 
 	};
 }
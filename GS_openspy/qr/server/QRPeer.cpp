@@ -7,7 +7,10 @@
 
 
 namespace QR {
+	OS::LatencyHistogram g_heartbeat_parse_span("heartbeat_parse", "Decoding a heartbeat's keys, before it is pushed");
+
 	Peer::Peer(Driver *driver, struct sockaddr_in *address_info, int sd, int version) : INetPeer(driver, address_info, sd) {
+		mp_driver = driver;
 		m_server_pushed = false;
 		m_delete_flag = false;
 		m_timeout_flag = false;
@@ -33,11 +36,14 @@ namespace QR {
 
 		memset(&m_last_heartbeat,0,sizeof(m_last_heartbeat));
 
+		mp_mutex = OS::CreateMutex();
+
 		OS::LogText(OS::ELogLevel_Info, "[%s] New connection version: %d",OS::Address(m_address_info).ToString().c_str(), m_version);
 	}
 	Peer::~Peer() {
 		Delete();
 		OS::LogText(OS::ELogLevel_Info, "[%s] Connection closed, timeout: %d",OS::Address(m_address_info).ToString().c_str(), m_timeout_flag);
+		delete mp_mutex;
 	}
 	bool Peer::isTeamString(const char *string) {
 		int len = strlen(string);
@@ -48,53 +54,6 @@ namespace QR {
 		}
 		return false;
 	}
-	OS::MetricValue Peer::GetMetricItemFromStats(PeerStats stats) {
-		OS::MetricValue arr_value, value;
-		value.value._str = stats.m_address.ToString(false);
-		value.key = "ip";
-		value.type = OS::MetricType_String;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.disconnected;
-		value.key = "disconnected";
-		value.type = OS::MetricType_Integer;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));		
-
-		value.type = OS::MetricType_Integer;
-		value.value._int = stats.bytes_in;
-		value.key = "bytes_in";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.bytes_out;
-		value.key = "bytes_out";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.packets_in;
-		value.key = "packets_in";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.packets_out;
-		value.key = "packets_out";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.pending_requests;
-		value.key = "pending_requests";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-		arr_value.type = OS::MetricType_Array;
-			
-		value.type = OS::MetricType_String;	
-		value.key = "gamename";
-		value.value._str = stats.from_game.gamename;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.type = OS::MetricType_Integer;	
-		value.key = "version";
-		value.value._int = stats.version;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		arr_value.key = stats.m_address.ToString(false);
-		return arr_value;
-	}
 	void Peer::ResetMetrics() {
 		m_peer_stats.bytes_in = 0;
 		m_peer_stats.bytes_out = 0;
@@ -102,16 +61,6 @@ namespace QR {
 		m_peer_stats.packets_out = 0;
 		m_peer_stats.pending_requests = 0;
 	}
-	OS::MetricInstance Peer::GetMetrics() {
-		OS::MetricInstance peer_metric;
-
-		peer_metric.value = GetMetricItemFromStats(m_peer_stats);
-		peer_metric.key = "peer";
-
-		ResetMetrics();
-
-		return peer_metric;
-	}
 	void Peer::SubmitDirtyServer() {
 		if(!m_server_info_dirty)
 			return;
@@ -119,7 +68,6 @@ namespace QR {
 		gettimeofday(&current_time, NULL);
 		if (current_time.tv_sec - m_last_heartbeat.tv_sec > HB_THROTTLE_TIME) {
 			MM::MMPushRequest req;
-			req.old_server = m_server_info;
 			m_server_info = m_dirty_server_info;
 			m_server_info_dirty = false;
 			req.peer = this;
@@ -128,8 +76,14 @@ namespace QR {
 			req.peer->IncRef();
 			req.type = MM::EMMPushRequestType_UpdateServer;
 			m_peer_stats.pending_requests++;
-			MM::m_task_pool->AddRequest(req);
+			MM::m_task_pool->AddRequest(req, this);
+		}
+	}
+	int Peer::GetDirtyServerDelay() {
+		if (!m_server_info_dirty) {
+			return NET_PEER_MAX_THINK_DELAY;
 		}
+		return GetDelayUntil(m_last_heartbeat, HB_THROTTLE_TIME);
 	}
 	void Peer::Delete() {
 		if (m_server_pushed) {
@@ -139,7 +93,7 @@ namespace QR {
 			req.peer->IncRef();
 			req.type = MM::EMMPushRequestType_DeleteServer;
 			m_peer_stats.pending_requests++;
-			MM::m_task_pool->AddRequest(req);
+			MM::m_task_pool->AddRequest(req, this);
 		}
 		m_server_pushed = false;
 		m_delete_flag = true;
@@ -3,6 +3,7 @@
 #include "../main.h"
 #include <OS/Net/NetPeer.h>
 #include "MMPush.h"
+#include <OS/Analytics/Instrument.h>
 
 #define REQUEST_KEY_LEN 4
 #define CHALLENGE_LEN 20
@@ -38,6 +39,10 @@ namespace QR {
 		virtual void think(bool listener_waiting) = 0;
 		virtual void handle_packet(char *recvbuf, int len) = 0;		
 
+		//handle_packet and think can run on different reactor threads, the driver serializes them on the peer's mutex
+		void Lock() { mp_mutex->lock(); };
+		void Unlock() { mp_mutex->unlock(); };
+
 		const struct sockaddr_in *getAddress() { return &m_address_info; }
 		bool ShouldDelete() { return m_delete_flag; };
 		void SetDelete(bool del) { m_delete_flag = del; };
@@ -52,13 +57,13 @@ namespace QR {
 		virtual void OnGetGameInfo(OS::GameData game_info, void *extra) = 0;
 		virtual void OnRegisteredServer(int pk_id, void *extra) = 0;
 
-		static OS::MetricValue GetMetricItemFromStats(PeerStats stats);
-		OS::MetricInstance GetMetrics();
-		PeerStats GetPeerStats() { if(m_delete_flag) m_peer_stats.disconnected = true; return m_peer_stats; };
 
 		bool ServerDirty() { return m_server_info_dirty; };
 		void SubmitDirtyServer();
 	protected:
+		//milliseconds until SubmitDirtyServer is out of the heartbeat throttle
+		int GetDirtyServerDelay();
+
 		void ResetMetrics();
 
 		bool isTeamString(const char *string);
@@ -80,5 +85,6 @@ namespace QR {
 
 		PeerStats m_peer_stats;
 	};
+	extern OS::LatencyHistogram g_heartbeat_parse_span;
 }
 #endif //_QRPEER_H
\ No newline at end of file
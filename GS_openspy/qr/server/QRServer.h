@@ -20,9 +20,6 @@ namespace QR {
 		void shutdown();
 		void SetTaskPool(OS::TaskPool<MM::MMPushTask, MM::MMPushRequest> *pool);
 		Peer *find_client(struct sockaddr_in *address);
-		OS::MetricInstance GetMetrics();
-	private:
-		struct timeval m_last_analytics_submit_time;
 	};
 }
 #endif //_CHCGAMESERVER_H
\ No newline at end of file
@@ -11,6 +11,7 @@
 #include <OS/legacy/helpers.h>
 
 #include <sstream>
+#include <algorithm>
 #include <OS/KVReader.h>
 
 namespace QR {
@@ -47,6 +48,16 @@ namespace QR {
 		}
 	}
 
+	int V1Peer::GetThinkDelay() {
+		int delay = GetDelayUntil(m_last_ping, QR1_PING_TIME);
+		if (delay == 0) {
+			//m_last_ping only moves once the echo is answered
+			delay = QR1_PING_RETRY_TIME;
+		}
+		delay = std::min(delay, GetDelayUntil(m_last_recv, QR1_PING_TIME * 2));
+		return std::min(delay, GetDirtyServerDelay());
+	}
+
 	void V1Peer::handle_packet(char *recvbuf, int len) {
 		if (len < 0) {
 			Delete();
@@ -59,28 +70,36 @@ namespace QR {
 		m_peer_stats.packets_in++;
 		m_peer_stats.bytes_in += len;
 
-		OS::KVReader data_parser = OS::KVReader(std::string(recvbuf));
+		OS::KVReader data_parser(recvbuf, strlen(recvbuf));
 		if (data_parser.Size() < 1) {
 			Delete();
 			return;
 		}
-		std::string command = data_parser.GetKeyByIdx(0);
 
 		//gettimeofday(&m_last_recv, NULL); //not here due to spoofing
 
-		if (command.compare("heartbeat") == 0) {
-			handle_heartbeat(recvbuf, len);
-		}
-		else if (command.compare("echo") == 0) {
-			handle_echo(recvbuf, len);
-		}
-		else if (command.compare("validate") == 0) {
-			handle_validate(recvbuf, len);
+		switch (data_parser.GetKeyHashByIdx(0)) {
+			case OS::KVHash("heartbeat"):
+				if (data_parser.IsKeyByIdx(0, "heartbeat")) {
+					handle_heartbeat(recvbuf, len);
+					return;
+				}
+				break;
+			case OS::KVHash("echo"):
+				if (data_parser.IsKeyByIdx(0, "echo")) {
+					handle_echo(recvbuf, len);
+					return;
+				}
+				break;
+			case OS::KVHash("validate"):
+				if (data_parser.IsKeyByIdx(0, "validate")) {
+					handle_validate(recvbuf, len);
+					return;
+				}
+				break;
 		}
-		else {
-			if (m_query_state != EV1_CQS_Complete) {
-				handle_ready_query_state(recvbuf, len);
-			}
+		if (m_query_state != EV1_CQS_Complete) {
+			handle_ready_query_state(recvbuf, len);
 		}
 	}
 
@@ -194,7 +213,6 @@ namespace QR {
 			if (current_time.tv_sec - m_last_heartbeat.tv_sec > HB_THROTTLE_TIME || req.type == MM::EMMPushRequestType_PushServer) {
 				req.peer = this;
 				req.server = m_dirty_server_info;
-				req.old_server = m_server_info;
 				m_server_info = m_dirty_server_info;
 
 				req.peer->IncRef();
@@ -202,7 +220,7 @@ namespace QR {
 				m_server_info_dirty = false;
 				gettimeofday(&m_last_heartbeat, NULL);
 				m_peer_stats.pending_requests++;
-				MM::m_task_pool->AddRequest(req);
+				MM::m_task_pool->AddRequest(req, this);
 			} else {
 				m_server_info_dirty = true;
 			}
@@ -240,11 +258,13 @@ namespace QR {
 	void V1Peer::handle_heartbeat(char *recvbuf, int len) {
 		
 		std::string gamename;
+		uint64_t parse_start = OS::GetMonotonicTimeUS();
 		OS::KVReader data_parser = OS::KVReader(std::string(recvbuf));
 		int query_port = data_parser.GetValueInt("heartbeat");
 		int state_changed = data_parser.GetValueInt("statechanged");
 
 		gamename = data_parser.GetValue("gamename");
+		g_heartbeat_parse_span.Record(OS::GetMonotonicTimeUS() - parse_start);
 
 		OS::LogText(OS::ELogLevel_Info, "[%s] HB: %s", OS::Address(m_address_info).ToString().c_str(), recvbuf);
 		//m_server_info.m_game = OS::GetGameByName(gamename.c_str());
@@ -262,7 +282,7 @@ namespace QR {
 			req.peer->IncRef();
 			req.type = MM::EMMPushRequestType_GetGameInfoByGameName;
 			m_peer_stats.pending_requests++;
-			MM::m_task_pool->AddRequest(req);
+			MM::m_task_pool->AddRequest(req, this);
 		}
 	}
 	void V1Peer::OnGetGameInfo(OS::GameData game_info, void *extra) {
@@ -336,7 +356,7 @@ namespace QR {
 		m_peer_stats.packets_out++;
 		m_peer_stats.bytes_out += send_str.length()+1;
 
-		int c = sendto(m_sd, send_str.c_str(), send_str.length()+1, 0, (struct sockaddr *)&m_address_info, sizeof(sockaddr_in));
+		int c = mp_driver->SendDatagram(&m_address_info, send_str.c_str(), send_str.length()+1);
 		if (c < 0) {
 			Delete();
 		}
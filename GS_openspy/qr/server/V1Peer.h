@@ -11,6 +11,7 @@
 
 #define MAX_OUTGOING_REQUEST_SIZE 1024
 #define QR1_PING_TIME 300
+#define QR1_PING_RETRY_TIME 1000 //the echo is resent this often until the server answers it
 namespace QR {
 	class Driver;
 
@@ -28,6 +29,7 @@ namespace QR {
 		~V1Peer();
 		
 		void think(bool listener_waiting);
+		int GetThinkDelay();
 
 		void handle_packet(char *recvbuf, int len);
 
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sstream>
+#include <algorithm>
 #include "QRServer.h"
 
 
@@ -52,7 +53,7 @@ namespace QR {
 		m_peer_stats.packets_out++;
 		m_peer_stats.bytes_out += buffer.size();
 
-		sendto(m_sd,(const char *)buffer.GetHead(),buffer.size(),0,(struct sockaddr *)&m_address_info, sizeof(sockaddr_in));
+		mp_driver->SendDatagram(&m_address_info, buffer.GetHead(), buffer.size());
 	}
 	void V2Peer::handle_packet(char *recvbuf, int len) {
 		OS::Buffer buffer(recvbuf, len);
@@ -114,7 +115,7 @@ namespace QR {
 				req.type = MM::EMMPushRequestType_PushServer;
 				m_server_pushed = true;
 				m_peer_stats.pending_requests++;
-				MM::m_task_pool->AddRequest(req);
+				MM::m_task_pool->AddRequest(req, this);
 			}
 			m_sent_challenge = true;
 		}
@@ -133,8 +134,9 @@ namespace QR {
 	}
 	void V2Peer::handle_heartbeat(OS::Buffer &buffer) {
 		unsigned int i = 0;
+		uint64_t parse_start = OS::GetMonotonicTimeUS();
 
-		MM::ServerInfo server_info, old_server_info = m_server_info;
+		MM::ServerInfo server_info;
 		server_info.m_game = m_server_info.m_game;
 		server_info.m_address = m_server_info.m_address;
 		server_info.id = m_server_info.id;
@@ -218,6 +220,7 @@ namespace QR {
 
 		OS::LogText(OS::ELogLevel_Info, "[%s] HB Keys: %s", OS::Address(m_address_info).ToString().c_str(), ss.str().c_str());
 		ss.str("");
+		g_heartbeat_parse_span.Record(OS::GetMonotonicTimeUS() - parse_start);
 
 		m_dirty_server_info = server_info;
 
@@ -237,11 +240,10 @@ namespace QR {
 					m_server_info = server_info;
 					gettimeofday(&m_last_heartbeat, NULL);
 					req.server = m_server_info;
-					req.old_server = old_server_info;
 					req.peer->IncRef();
 					req.type = MM::EMMPushRequestType_UpdateServer;
 					m_peer_stats.pending_requests++;
-					MM::m_task_pool->AddRequest(req);
+					MM::m_task_pool->AddRequest(req, this);
 				} else {
 					m_server_info_dirty = true;
 				}
@@ -257,7 +259,7 @@ namespace QR {
 			req.gamename = server_info.m_keys["gamename"];
 			req.type = MM::EMMPushRequestType_GetGameInfoByGameName;
 			m_peer_stats.pending_requests++;
-			MM::m_task_pool->AddRequest(req);
+			MM::m_task_pool->AddRequest(req, this);
 		}
 	}
 	void V2Peer::handle_available(OS::Buffer &buffer) {
@@ -271,7 +273,7 @@ namespace QR {
 		OS::LogText(OS::ELogLevel_Info, "[%s] Got available request: %s", OS::Address(m_address_info).ToString().c_str(), req.gamename.c_str());
 		req.type = MM::EMMPushRequestType_GetGameInfoByGameName;
 		m_peer_stats.pending_requests++;
-		MM::m_task_pool->AddRequest(req);
+		MM::m_task_pool->AddRequest(req, this);
 	}
 	void V2Peer::OnGetGameInfo(OS::GameData game_info, void *extra) {
 		m_peer_stats.from_game = game_info;
@@ -306,7 +308,7 @@ namespace QR {
 					req.peer->IncRef();
 					req.type = MM::EMMPushRequestType_UpdateServer_NoDiff;
 					m_peer_stats.pending_requests++;
-					MM::m_task_pool->AddRequest(req);
+					MM::m_task_pool->AddRequest(req, this);
 				}
 			}
 		}
@@ -371,6 +373,11 @@ namespace QR {
 		}
 	}
 
+	int V2Peer::GetThinkDelay() {
+		int delay = std::min(GetDelayUntil(m_last_ping, QR2_PING_TIME), GetDelayUntil(m_last_recv, QR2_PING_TIME));
+		return std::min(delay, GetDirtyServerDelay());
+	}
+
 	void V2Peer::send_challenge() {
 		OS::Buffer buffer;
 
@@ -22,6 +22,7 @@ namespace QR {
 		~V2Peer();
 		
 		void think(bool listener_waiting);
+		int GetThinkDelay();
 
 		void handle_packet(char *recvbuf, int len);
 
@@ -13,7 +13,7 @@
 #else
 #include <sys/time.h>
 #endif
-#define DRIVER_THREAD_TIME 1000
+#define DRIVER_REAP_TIME 100 //how often deleted peers which are still referenced are checked on
 namespace SM {
 	class Peer;
 
@@ -36,16 +36,16 @@ namespace SM {
 
 		const std::vector<INetPeer *> getPeers(bool inc_ref = false);
 
-		OS::MetricInstance GetMetrics();
+
+		void OnPeerThink(INetPeer *peer);
 	private:
-		static void *TaskThread(OS::CThread *thread);
-		void TickConnections();
+		static void OnReapTimer(void *extra);
+		void DeletePeer(Peer *peer);
 
 		int m_sd;
 		std::vector<SM::Peer *> m_peers_to_delete;
 
 		//safe for now, until pointers one day get added
-		std::queue<PeerStats> m_stats_queue; //pending stats to be sent(deleted clients)
 
 		std::vector<Peer *> m_connections;
 		
@@ -53,8 +53,8 @@ namespace SM {
 
 		struct timeval m_server_start;
 
+		OS::TimerWheelEntry m_reap_timer;
 		OS::CMutex *mp_mutex;
-		OS::CThread *mp_thread;
 	};
 }
 #endif //_SBDRIVER_H
\ No newline at end of file
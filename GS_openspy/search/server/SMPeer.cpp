@@ -26,6 +26,7 @@ namespace SM {
 		mp_mutex = OS::CreateMutex();
 		ResetMetrics();
 		gettimeofday(&m_last_ping, NULL);
+		gettimeofday(&m_last_recv, NULL);
 		OS::LogText(OS::ELogLevel_Info, "[%s] New connection", OS::Address(m_address_info).ToString().c_str());
 	}
 	Peer::~Peer() {
@@ -78,35 +79,48 @@ namespace SM {
 			m_delete_flag = true;
 		}
 	}
+	int Peer::GetThinkDelay() {
+		//nothing is pinged, only the timeout is due
+		return GetDelayUntil(m_last_recv, SM_PING_TIME*2);
+	}
 	void Peer::handle_packet(char *data, int len) {
-		char command[32];
-		if(!find_param(0, data,(char *)&command, sizeof(command))) {
+		printf("Handle: %s\n", data);
+
+		OS::KVReader data_parser(data, len);
+		if(data_parser.Size() < 1) {
 			m_delete_flag = true;
 			return;
 		}
-		printf("Handle: %s\n", data);
-
-		OS::KVReader data_parser = OS::KVReader(data);
-		if(!strcmp("search", command)) {
-			handle_search(data_parser);
-		} else if(!strcmp("others", command)) {
-			handle_others(data_parser);
-		} else if(!strcmp("otherslist", command)) {
-			handle_otherslist(data_parser);
-		} else if(!strcmp("valid", command)) {
-			handle_valid(data_parser);
-		} else if(!strcmp("nicks", command)) {
-			handle_nicks(data_parser);
-		} else if(!strcmp("pmatch", command)) {
-
-		} else if(!strcmp("check", command)) {
-			handle_check(data_parser);
-		} else if(!strcmp("newuser", command)) {
-			handle_newuser(data_parser);
-		} else if(!strcmp("uniquesearch", command)) {
-			
-		} else if(!strcmp("profilelist", command)) {
-			
+		switch(data_parser.GetKeyHashByIdx(0)) {
+			case OS::KVHash("search"):
+				if(data_parser.IsKeyByIdx(0, "search"))
+					handle_search(data_parser);
+				break;
+			case OS::KVHash("others"):
+				if(data_parser.IsKeyByIdx(0, "others"))
+					handle_others(data_parser);
+				break;
+			case OS::KVHash("otherslist"):
+				if(data_parser.IsKeyByIdx(0, "otherslist"))
+					handle_otherslist(data_parser);
+				break;
+			case OS::KVHash("valid"):
+				if(data_parser.IsKeyByIdx(0, "valid"))
+					handle_valid(data_parser);
+				break;
+			case OS::KVHash("nicks"):
+				if(data_parser.IsKeyByIdx(0, "nicks"))
+					handle_nicks(data_parser);
+				break;
+			case OS::KVHash("check"):
+				if(data_parser.IsKeyByIdx(0, "check"))
+					handle_check(data_parser);
+				break;
+			case OS::KVHash("newuser"):
+				if(data_parser.IsKeyByIdx(0, "newuser"))
+					handle_newuser(data_parser);
+				break;
+			//pmatch, uniquesearch and profilelist aren't handled
 		}
 
 		gettimeofday(&m_last_recv, NULL);
@@ -137,7 +151,7 @@ namespace SM {
 
 		((Peer *)peer)->m_delete_flag = true;
 	}
-	void Peer::handle_newuser(OS::KVReader data_parser) {
+	void Peer::handle_newuser(OS::KVReader &data_parser) {
 		std::string nick;
 		std::string uniquenick;
 		std::string email;
@@ -176,7 +190,7 @@ namespace SM {
 
 		((Peer *)peer)->m_delete_flag = true;
 	}
-	void Peer::handle_check(OS::KVReader data_parser) {
+	void Peer::handle_check(OS::KVReader &data_parser) {
 
 		std::string nick;
 		std::string uniquenick;
@@ -207,7 +221,7 @@ namespace SM {
 		if(dpass)
 			free((void *)dpass);
 	}
-	void Peer::handle_search(OS::KVReader data_parser) {
+	void Peer::handle_search(OS::KVReader &data_parser) {
 		OS::ProfileSearchRequest request;
 		char temp[GP_REASON_LEN + 1];
 		int temp_int;
@@ -295,7 +309,7 @@ namespace SM {
 
 		((Peer *)peer)->m_delete_flag = true;
 	}
-	void Peer::handle_others(OS::KVReader data_parser) {
+	void Peer::handle_others(OS::KVReader &data_parser) {
 		OS::ProfileSearchRequest request;
 		int profileid = data_parser.GetValueInt("profileid");
 		int namespaceid = data_parser.GetValueInt("namespaceid");
@@ -339,7 +353,7 @@ namespace SM {
 
 		((Peer *)peer)->m_delete_flag = true;
 	}
-	void Peer::handle_otherslist(OS::KVReader data_parser) {
+	void Peer::handle_otherslist(OS::KVReader &data_parser) {
 		std::string pid_buffer;
 		OS::ProfileSearchRequest request;
 
@@ -377,7 +391,7 @@ namespace SM {
 
 		((Peer *)peer)->m_delete_flag = true;
 	}
-	void Peer::handle_valid(OS::KVReader data_parser) {
+	void Peer::handle_valid(OS::KVReader &data_parser) {
 		OS::UserSearchRequest request;
 		request.type = OS::EUserRequestType_Search;
 		if (data_parser.HasKey("userid")) {
@@ -401,7 +415,7 @@ namespace SM {
 		OS::m_user_search_task_pool->AddRequest(request);
 	}
 
-	void Peer::handle_nicks(OS::KVReader data_parser) {
+	void Peer::handle_nicks(OS::KVReader &data_parser) {
 		OS::ProfileSearchRequest request;
 		request.type = OS::EProfileSearch_Profiles;
 		if (data_parser.HasKey("userid")) {
@@ -472,58 +486,10 @@ namespace SM {
 			buffer.WriteBuffer((void *)"\\final\\", 7);
 		}
 		//OS::LogText(OS::ELogLevel_Info, "Sending: %s", out_buff);
-		int c = send(m_sd, (const char *)buffer.GetHead(), buffer.size(), MSG_NOSIGNAL);
-		if (c < 0) {
+		if (!SendData(buffer.GetHead(), buffer.size())) {
 			m_delete_flag = true;
 		}
 	}
-	OS::MetricValue Peer::GetMetricItemFromStats(PeerStats stats) {
-		OS::MetricValue arr_value, value;
-		value.value._str = stats.m_address.ToString(false);
-		value.key = "ip";
-		value.type = OS::MetricType_String;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.disconnected;
-		value.key = "disconnected";
-		value.type = OS::MetricType_Integer;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.type = OS::MetricType_Integer;
-		value.value._int = stats.bytes_in;
-		value.key = "bytes_in";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.bytes_out;
-		value.key = "bytes_out";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.packets_in;
-		value.key = "packets_in";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.packets_out;
-		value.key = "packets_out";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.total_requests;
-		value.key = "pending_requests";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-		arr_value.type = OS::MetricType_Array;
-
-		value.type = OS::MetricType_String;
-		value.key = "gamename";
-		value.value._str = stats.from_game.gamename;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.type = OS::MetricType_Integer;
-		value.key = "version";
-		value.value._int = stats.version;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		arr_value.key = stats.m_address.ToString(false);
-		return arr_value;
-	}
 	void Peer::ResetMetrics() {
 		m_peer_stats.bytes_in = 0;
 		m_peer_stats.bytes_out = 0;
@@ -531,14 +497,4 @@ namespace SM {
 		m_peer_stats.packets_out = 0;
 		m_peer_stats.total_requests = 0;
 	}
-	OS::MetricInstance Peer::GetMetrics() {
-		OS::MetricInstance peer_metric;
-
-		peer_metric.value = GetMetricItemFromStats(m_peer_stats);
-		peer_metric.key = "peer";
-
-		ResetMetrics();
-
-		return peer_metric;
-	}
 }
\ No newline at end of file
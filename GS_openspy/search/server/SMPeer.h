@@ -73,6 +73,7 @@ namespace SM {
 		~Peer();
 		
 		void think(bool packet_waiting);
+		int GetThinkDelay();
 		void handle_packet(char *data, int len);
 		const struct sockaddr_in *getAddress() { return &m_address_info; }
 
@@ -83,30 +84,27 @@ namespace SM {
 
 		void SendPacket(const uint8_t *buff, int len, bool attach_final = true);
 
-		static OS::MetricValue GetMetricItemFromStats(PeerStats stats);
-		OS::MetricInstance GetMetrics();
-		PeerStats GetPeerStats() { if (m_delete_flag) m_peer_stats.disconnected = true; return m_peer_stats; };
 	private:
 
-		void handle_search(OS::KVReader data_parser);
+		void handle_search(OS::KVReader &data_parser);
 		static void m_search_callback(OS::EProfileResponseType response_reason, std::vector<OS::Profile> results, std::map<int, OS::User> result_users, void *extra, INetPeer *peer);
 
 		static void m_search_buddies_callback(OS::EProfileResponseType response_reason, std::vector<OS::Profile> results, std::map<int, OS::User> result_users, void *extra, INetPeer *peer);
-		void handle_others(OS::KVReader data_parser);
+		void handle_others(OS::KVReader &data_parser);
 
 		static void m_search_buddies_reverse_callback(OS::EProfileResponseType response_reason, std::vector<OS::Profile> results, std::map<int, OS::User> result_users, void *extra, INetPeer *peer);
-		void handle_otherslist(OS::KVReader data_parser);
+		void handle_otherslist(OS::KVReader &data_parser);
 
 		static void m_search_valid_callback(OS::EUserResponseType response_type, std::vector<OS::User> results, void *extra, INetPeer *peer);
-		void handle_valid(OS::KVReader data_parser);
+		void handle_valid(OS::KVReader &data_parser);
 
 		static void m_nick_email_auth_cb(bool success, OS::User user, OS::Profile profile, OS::AuthData auth_data, void *extra, int operation_id, INetPeer *peer);
-		void handle_check(OS::KVReader data_parser);
+		void handle_check(OS::KVReader &data_parser);
 
 		static void m_newuser_cb(bool success, OS::User user, OS::Profile profile, OS::AuthData auth_data, void *extra, int operation_id, INetPeer *peer);
-		void handle_newuser(OS::KVReader data_parser);
+		void handle_newuser(OS::KVReader &data_parser);
 
-		void handle_nicks(OS::KVReader data_parser);
+		void handle_nicks(OS::KVReader &data_parser);
 		static void m_nicks_cb(OS::EProfileResponseType response_reason, std::vector<OS::Profile> results, std::map<int, OS::User> result_users, void *extra, INetPeer *peer);
 
 		PeerStats m_peer_stats;
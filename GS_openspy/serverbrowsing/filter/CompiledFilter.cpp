@@ -0,0 +1,482 @@
+#include "CompiledFilter.h"
+#include <algorithm>
+
+CompiledFilter::CompiledFilter() : m_empty(true), m_max_depth(0) {
+
+}
+CompiledFilter::CompiledFilter(const char *filter) : m_empty(true), m_max_depth(0) {
+	if(filter == NULL || strlen(filter) == 0) {
+		return;
+	}
+	m_empty = false;
+
+	std::vector<CToken> tokens = CToken::filterToTokenList(filter);
+	std::vector<CToken>::iterator it = tokens.begin();
+	int depth = 0;
+	while(it != tokens.end()) {
+		CToken token = *it;
+		FilterInstruction ins;
+		ins.arg = 0;
+		switch(token.getType()) {
+			case EToken_Variable: {
+				std::vector<std::string>::iterator var_it = std::find(m_variables.begin(), m_variables.end(), token.getString());
+				ins.op = EFilterOp_PushVariable;
+				ins.arg = var_it - m_variables.begin();
+				if(var_it == m_variables.end()) {
+					m_variables.push_back(token.getString());
+				}
+				break;
+			}
+			case EToken_Integer:
+				ins.op = EFilterOp_PushInt;
+				ins.arg = token.getInt();
+				break;
+			case EToken_Float:
+				ins.op = EFilterOp_PushFloat;
+				break;
+			case EToken_String:
+				ins.op = EFilterOp_PushString;
+				ins.arg = m_constants.size();
+				m_constants.push_back(token.getString());
+				break;
+			case EToken_Equals: ins.op = EFilterOp_Equals; break;
+			case EToken_NotEquals: ins.op = EFilterOp_NotEquals; break;
+			case EToken_GreaterEquals: ins.op = EFilterOp_GreaterEquals; break;
+			case EToken_LessEquals: ins.op = EFilterOp_LessEquals; break;
+			case EToken_Less: ins.op = EFilterOp_Less; break;
+			case EToken_Greater: ins.op = EFilterOp_Greater; break;
+			case EToken_And: ins.op = EFilterOp_And; break;
+			case EToken_Or: ins.op = EFilterOp_Or; break;
+			case EToken_Add: ins.op = EFilterOp_Add; break;
+			case EToken_Subtract: ins.op = EFilterOp_Subtract; break;
+			case EToken_Multiply: ins.op = EFilterOp_Multiply; break;
+			case EToken_Divide: ins.op = EFilterOp_Divide; break;
+			default: //evaluate() skips anything else
+				it++;
+				continue;
+		}
+		m_program.push_back(ins);
+
+		//stack depth doesn't depend on the values, so the worst case is known up front
+		switch(ins.op) {
+			case EFilterOp_PushInt:
+			case EFilterOp_PushFloat:
+			case EFilterOp_PushString:
+			case EFilterOp_PushVariable:
+				depth++;
+				break;
+			case EFilterOp_Add:
+			case EFilterOp_Subtract:
+			case EFilterOp_Multiply:
+			case EFilterOp_Divide:
+				depth = depth > 2 ? depth - 1 : depth + 1;
+				break;
+			default:
+				depth = depth >= 2 ? depth - 1 : depth + 1;
+				break;
+		}
+		if(depth > m_max_depth) {
+			m_max_depth = depth;
+		}
+		it++;
+	}
+}
+FilterValue CompiledFilter::BindValue(const std::string &value) {
+	FilterValue ret;
+	const char *var = value.c_str();
+	if((atoi(var) != 0 || (var[0] == '0' && var[1] == 0)) && value.find('.') == std::string::npos) {
+		ret.type = EToken_Integer;
+		ret.ival = atoi(var);
+		ret.sval = NULL;
+		ret.slen = 0;
+	} else {
+		ret.type = EToken_String;
+		ret.ival = 0;
+		ret.sval = var;
+		ret.slen = value.length();
+	}
+	return ret;
+}
+bool CompiledFilter::Matches(const std::map<std::string, std::string> &kvList) const {
+	if(m_empty) {
+		return true;
+	}
+	FilterValue local_values[FILTER_MAX_STACK];
+	std::vector<FilterValue> heap_values;
+	FilterValue *values = local_values;
+	if(m_variables.size() > FILTER_MAX_STACK) {
+		heap_values.resize(m_variables.size());
+		values = &heap_values[0];
+	}
+
+	for(size_t i = 0; i < m_variables.size(); i++) {
+		std::map<std::string, std::string>::const_iterator it = kvList.find(m_variables[i]);
+		if(it != kvList.end()) {
+			values[i] = BindValue(it->second);
+		} else {
+			values[i].type = EToken_String;
+			values[i].ival = 0;
+			values[i].sval = "";
+			values[i].slen = 0;
+		}
+	}
+	return Evaluate(values);
+}
+
+//same conversion as tokenToString
+static void ValueToString(const FilterValue &value, char *buff, int buff_len, const char *&str, int &len) {
+	switch(value.type) {
+		case EToken_Integer:
+			len = snprintf(buff, buff_len, "%d", value.ival);
+			str = buff;
+			break;
+		case EToken_String:
+			str = value.sval;
+			len = value.slen;
+			break;
+		default:
+			str = "";
+			len = 0;
+			break;
+	}
+}
+static void SetValue(FilterValue &value, ETokenType type, int ival, const char *sval, int slen) {
+	value.type = type;
+	value.ival = ival;
+	value.sval = sval;
+	value.slen = slen;
+}
+//comparison of the two topmost operands, t2 being the top
+static void ApplyComparison(EFilterOp op, const FilterValue &t1, const FilterValue &t2, FilterValue &result) {
+	bool val = true;
+	if(t1.type == EToken_Integer && t2.type == EToken_Integer) {
+		switch(op) {
+			case EFilterOp_Equals: val = t1.ival == t2.ival; break;
+			case EFilterOp_NotEquals: val = t1.ival != t2.ival; break;
+			case EFilterOp_GreaterEquals: val = t1.ival >= t2.ival; break;
+			case EFilterOp_LessEquals: val = t1.ival <= t2.ival; break;
+			case EFilterOp_Less: val = t1.ival < t2.ival; break;
+			case EFilterOp_Greater: val = t1.ival > t2.ival; break;
+			case EFilterOp_And: val = t1.ival && t2.ival; break;
+			case EFilterOp_Or: val = t1.ival || t2.ival; break;
+			default: break;
+		}
+	} else if((t1.type == EToken_String || t2.type == EToken_String) && op <= EFilterOp_LessEquals) {
+		//<, >, AND and OR don't compare strings
+		char buff1[16], buff2[16];
+		const char *s1, *s2;
+		int len1, len2;
+		ValueToString(t1, buff1, sizeof(buff1), s1, len1);
+		ValueToString(t2, buff2, sizeof(buff2), s2, len2);
+		switch(op) {
+			case EFilterOp_Equals: val = len1 == len2 && memcmp(s1, s2, len1) == 0; break;
+			case EFilterOp_NotEquals: val = !(len1 == len2 && memcmp(s1, s2, len1) == 0); break;
+			case EFilterOp_GreaterEquals: val = len1 >= len2; break;
+			case EFilterOp_LessEquals: val = len1 <= len2; break;
+			default: break;
+		}
+	}
+	SetValue(result, EToken_Integer, val, NULL, 0);
+}
+//operands are taken in the same (reversed) order as evaluate(), lh being the top
+static void ApplyArithmetic(EFilterOp op, const FilterValue &lh, const FilterValue &rh, FilterValue &result) {
+	SetValue(result, EToken_None, 0, NULL, 0);
+	int rval = rh.type == EToken_Integer ? rh.ival : 0;
+	//evaluate() crashes dividing by zero, here it results in None
+	if(rval == 0 && (op == EFilterOp_Divide || (op == EFilterOp_Multiply && lh.type == EToken_Integer))) {
+		return;
+	}
+	if(lh.type == EToken_Float) {
+		result.type = EToken_Float;
+		return;
+	}
+	if(lh.type != EToken_Integer) {
+		return;
+	}
+	result.type = EToken_Integer;
+	switch(op) {
+		case EFilterOp_Add: result.ival = lh.ival + rval; break;
+		case EFilterOp_Subtract: result.ival = lh.ival - rval; break;
+		case EFilterOp_Multiply: //evaluate() divides here as well
+		case EFilterOp_Divide: result.ival = lh.ival / rval; break;
+		default: break;
+	}
+}
+bool CompiledFilter::Evaluate(const FilterValue *values) const {
+	if(m_empty) {
+		return true;
+	}
+	FilterValue local_stack[FILTER_MAX_STACK];
+	std::vector<FilterValue> heap_stack;
+	FilterValue *stack = local_stack;
+	if(m_max_depth > FILTER_MAX_STACK) {
+		heap_stack.resize(m_max_depth);
+		stack = &heap_stack[0];
+	}
+	int sp = 0;
+
+	std::vector<FilterInstruction>::const_iterator it = m_program.begin();
+	while(it != m_program.end()) {
+		const FilterInstruction &ins = *it;
+		it++;
+
+		FilterValue result;
+		switch(ins.op) {
+			case EFilterOp_PushInt:
+				SetValue(result, EToken_Integer, ins.arg, NULL, 0);
+				break;
+			case EFilterOp_PushFloat:
+				SetValue(result, EToken_Float, 0, NULL, 0);
+				break;
+			case EFilterOp_PushString:
+				SetValue(result, EToken_String, 0, m_constants[ins.arg].c_str(), m_constants[ins.arg].length());
+				break;
+			case EFilterOp_PushVariable:
+				result = values[ins.arg];
+				break;
+			case EFilterOp_Equals:
+			case EFilterOp_NotEquals:
+			case EFilterOp_GreaterEquals:
+			case EFilterOp_LessEquals:
+			case EFilterOp_Less:
+			case EFilterOp_Greater:
+			case EFilterOp_And:
+			case EFilterOp_Or:
+				if(sp >= 2) {
+					sp -= 2;
+					ApplyComparison(ins.op, stack[sp], stack[sp + 1], result);
+				} else {
+					SetValue(result, EToken_Integer, 1, NULL, 0);
+				}
+				break;
+			case EFilterOp_Add:
+			case EFilterOp_Subtract:
+			case EFilterOp_Multiply:
+			case EFilterOp_Divide:
+				if(sp > 2) {
+					sp -= 2;
+					ApplyArithmetic(ins.op, stack[sp + 1], stack[sp], result);
+				} else {
+					SetValue(result, EToken_None, 0, NULL, 0);
+				}
+				break;
+		}
+		stack[sp++] = result;
+	}
+	return sp > 0 && stack[sp - 1].type == EToken_Integer && stack[sp - 1].ival != 0;
+}
+
+/*
+	One operand stack slot holding FILTER_BLOCK_SIZE rows
+*/
+typedef struct {
+	ETokenType type[FILTER_BLOCK_SIZE];
+	int ival[FILTER_BLOCK_SIZE];
+	const char *sval[FILTER_BLOCK_SIZE];
+	int slen[FILTER_BLOCK_SIZE];
+	bool all_int;
+} FilterBlock;
+
+static void FillBlock(FilterBlock &block, int num_rows, ETokenType type, int ival, const char *sval, int slen) {
+	for(int i = 0; i < num_rows; i++) {
+		block.type[i] = type;
+		block.ival[i] = ival;
+		block.sval[i] = sval;
+		block.slen[i] = slen;
+	}
+	block.all_int = type == EToken_Integer;
+}
+static FilterValue GetBlockValue(const FilterBlock &block, int row) {
+	FilterValue ret;
+	SetValue(ret, block.type[row], block.ival[row], block.sval[row], block.slen[row]);
+	return ret;
+}
+static void SetBlockValue(FilterBlock &block, int row, const FilterValue &value) {
+	block.type[row] = value.type;
+	block.ival[row] = value.ival;
+	block.sval[row] = value.sval;
+	block.slen[row] = value.slen;
+}
+static void UpdateAllInt(FilterBlock &block, int num_rows) {
+	int num_int = 0;
+	for(int i = 0; i < num_rows; i++) {
+		num_int += block.type[i] == EToken_Integer;
+	}
+	block.all_int = num_int == num_rows;
+}
+//the loops are kept free of branches so the compiler can vectorize them
+static void CompareInts(EFilterOp op, const int *a, const int *b, int *out, int num_rows) {
+	int i;
+	switch(op) {
+		case EFilterOp_Equals: for(i = 0; i < num_rows; i++) out[i] = a[i] == b[i]; break;
+		case EFilterOp_NotEquals: for(i = 0; i < num_rows; i++) out[i] = a[i] != b[i]; break;
+		case EFilterOp_GreaterEquals: for(i = 0; i < num_rows; i++) out[i] = a[i] >= b[i]; break;
+		case EFilterOp_LessEquals: for(i = 0; i < num_rows; i++) out[i] = a[i] <= b[i]; break;
+		case EFilterOp_Less: for(i = 0; i < num_rows; i++) out[i] = a[i] < b[i]; break;
+		case EFilterOp_Greater: for(i = 0; i < num_rows; i++) out[i] = a[i] > b[i]; break;
+		case EFilterOp_And: for(i = 0; i < num_rows; i++) out[i] = (a[i] != 0) & (b[i] != 0); break;
+		case EFilterOp_Or: for(i = 0; i < num_rows; i++) out[i] = (a[i] != 0) | (b[i] != 0); break;
+		default: break;
+	}
+}
+void CompiledFilter::EvaluateColumns(const FilterColumn * const *columns, int num_rows, std::vector<uint32_t> &matches) const {
+	matches.assign((num_rows + 31) / 32, 0);
+	if(m_empty) {
+		for(int i = 0; i < num_rows; i++) {
+			matches[i / 32] |= 1u << (i % 32);
+		}
+		return;
+	}
+	std::vector<FilterBlock> stack(m_max_depth > 0 ? m_max_depth : 1);
+	for(int base = 0; base < num_rows; base += FILTER_BLOCK_SIZE) {
+		int count = num_rows - base;
+		if(count > FILTER_BLOCK_SIZE) {
+			count = FILTER_BLOCK_SIZE;
+		}
+		int sp = 0;
+		std::vector<FilterInstruction>::const_iterator it = m_program.begin();
+		while(it != m_program.end()) {
+			const FilterInstruction &ins = *it;
+			it++;
+			switch(ins.op) {
+				case EFilterOp_PushInt:
+					FillBlock(stack[sp++], count, EToken_Integer, ins.arg, NULL, 0);
+					break;
+				case EFilterOp_PushFloat:
+					FillBlock(stack[sp++], count, EToken_Float, 0, NULL, 0);
+					break;
+				case EFilterOp_PushString:
+					FillBlock(stack[sp++], count, EToken_String, 0, m_constants[ins.arg].c_str(), m_constants[ins.arg].length());
+					break;
+				case EFilterOp_PushVariable: {
+					const FilterColumn *column = columns[ins.arg];
+					FilterBlock &block = stack[sp++];
+					memcpy(block.type, &column->type[base], count * sizeof(ETokenType));
+					memcpy(block.ival, &column->ival[base], count * sizeof(int));
+					memcpy(block.sval, &column->sval[base], count * sizeof(const char *));
+					memcpy(block.slen, &column->slen[base], count * sizeof(int));
+					UpdateAllInt(block, count);
+					break;
+				}
+				case EFilterOp_Equals:
+				case EFilterOp_NotEquals:
+				case EFilterOp_GreaterEquals:
+				case EFilterOp_LessEquals:
+				case EFilterOp_Less:
+				case EFilterOp_Greater:
+				case EFilterOp_And:
+				case EFilterOp_Or:
+					if(sp >= 2) {
+						//result replaces t1
+						FilterBlock &t1 = stack[sp - 2], &t2 = stack[sp - 1];
+						sp--;
+						if(t1.all_int && t2.all_int) {
+							CompareInts(ins.op, t1.ival, t2.ival, t1.ival, count);
+						} else {
+							FilterValue result;
+							for(int i = 0; i < count; i++) {
+								ApplyComparison(ins.op, GetBlockValue(t1, i), GetBlockValue(t2, i), result);
+								t1.ival[i] = result.ival;
+							}
+						}
+						for(int i = 0; i < count; i++) {
+							t1.type[i] = EToken_Integer;
+						}
+						t1.all_int = true;
+					} else {
+						FillBlock(stack[sp++], count, EToken_Integer, 1, NULL, 0);
+					}
+					break;
+				case EFilterOp_Add:
+				case EFilterOp_Subtract:
+				case EFilterOp_Multiply:
+				case EFilterOp_Divide:
+					if(sp > 2) {
+						//result replaces rh
+						FilterBlock &rh = stack[sp - 2], &lh = stack[sp - 1];
+						sp--;
+						if(lh.all_int && rh.all_int && ins.op == EFilterOp_Add) {
+							for(int i = 0; i < count; i++) rh.ival[i] = lh.ival[i] + rh.ival[i];
+						} else if(lh.all_int && rh.all_int && ins.op == EFilterOp_Subtract) {
+							for(int i = 0; i < count; i++) rh.ival[i] = lh.ival[i] - rh.ival[i];
+						} else {
+							FilterValue result;
+							for(int i = 0; i < count; i++) {
+								ApplyArithmetic(ins.op, GetBlockValue(lh, i), GetBlockValue(rh, i), result);
+								SetBlockValue(rh, i, result);
+							}
+							UpdateAllInt(rh, count);
+						}
+					} else {
+						FillBlock(stack[sp++], count, EToken_None, 0, NULL, 0);
+					}
+					break;
+			}
+		}
+		if(sp > 0) {
+			FilterBlock &top = stack[sp - 1];
+			for(int i = 0; i < count; i++) {
+				if(top.type[i] == EToken_Integer && top.ival[i] != 0) {
+					matches[(base + i) / 32] |= 1u << ((base + i) % 32);
+				}
+			}
+		}
+	}
+}
+void SetFilterColumnValue(FilterColumn &column, int row, const FilterValue &value) {
+	if(row >= (int)column.type.size()) {
+		column.type.resize(row + 1, EToken_None);
+		column.ival.resize(row + 1, 0);
+		column.sval.resize(row + 1, NULL);
+		column.slen.resize(row + 1, 0);
+	}
+	column.type[row] = value.type;
+	column.ival[row] = value.ival;
+	column.sval[row] = value.sval;
+	column.slen[row] = value.slen;
+}
+
+FilterCache::FilterCache(int max_size) {
+	m_max_size = max_size;
+	mp_mutex = OS::CreateMutex();
+	m_num_hits = 0;
+	m_num_misses = 0;
+}
+FilterCache::~FilterCache() {
+	delete mp_mutex;
+}
+CompiledFilter FilterCache::Get(const char *filter) {
+	if(filter == NULL || filter[0] == 0) {
+		return CompiledFilter();
+	}
+	std::string key = filter;
+	mp_mutex->lock();
+	std::map<std::string, LRUList::iterator>::iterator it = m_index.find(key);
+	if(it != m_index.end()) {
+		m_lru.splice(m_lru.begin(), m_lru, it->second);
+		CompiledFilter ret = it->second->second;
+		m_num_hits++;
+		mp_mutex->unlock();
+		return ret;
+	}
+	m_num_misses++;
+	mp_mutex->unlock();
+
+	CompiledFilter compiled(filter);
+
+	mp_mutex->lock();
+	if(m_index.find(key) == m_index.end()) {
+		m_lru.push_front(std::pair<std::string, CompiledFilter>(key, compiled));
+		m_index[key] = m_lru.begin();
+		if((int)m_lru.size() > m_max_size) {
+			m_index.erase(m_lru.back().first);
+			m_lru.pop_back();
+		}
+	}
+	mp_mutex->unlock();
+	return compiled;
+}
+FilterCache *FilterCache::getSingleton() {
+	static FilterCache *cache = new FilterCache();
+	return cache;
+}
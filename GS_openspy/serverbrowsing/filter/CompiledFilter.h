@@ -0,0 +1,115 @@
+#ifndef OS_FILTER_COMPILED_H
+#define OS_FILTER_COMPILED_H
+#include "CToken.h"
+#include <OS/OpenSpy.h>
+#include <list>
+
+#define FILTER_CACHE_SIZE 256
+#define FILTER_MAX_STACK 64
+#define FILTER_BLOCK_SIZE 256 //rows evaluated at once by EvaluateColumns
+
+enum EFilterOp {
+	EFilterOp_PushInt,
+	EFilterOp_PushFloat, //only the type is kept, see FilterValue
+	EFilterOp_PushString, //index into the constant table
+	EFilterOp_PushVariable, //index into the variable slots
+	//ops up to EFilterOp_LessEquals also compare strings
+	EFilterOp_Equals,
+	EFilterOp_NotEquals,
+	EFilterOp_GreaterEquals,
+	EFilterOp_LessEquals,
+	EFilterOp_Less,
+	EFilterOp_Greater,
+	EFilterOp_And,
+	EFilterOp_Or,
+	EFilterOp_Add,
+	EFilterOp_Subtract,
+	EFilterOp_Multiply,
+	EFilterOp_Divide,
+};
+
+typedef struct {
+	EFilterOp op;
+	int arg;
+} FilterInstruction;
+
+/*
+	Typed operand, strings are not NUL terminated and are owned by whatever the value was bound from
+*/
+typedef struct {
+	ETokenType type; //EToken_Integer, EToken_String, EToken_Float or EToken_None
+	//evaluate() never compares floats, and arithmetic on them can only produce another float, so their value doesn't matter
+	int ival;
+	const char *sval;
+	int slen;
+} FilterValue;
+
+/*
+	Bound values of one variable across many servers, stored per field so they can be scanned in bulk
+*/
+typedef struct {
+	std::vector<ETokenType> type;
+	std::vector<int> ival;
+	std::vector<const char *> sval;
+	std::vector<int> slen;
+} FilterColumn;
+
+//grows the column as needed
+void SetFilterColumnValue(FilterColumn &column, int row, const FilterValue &value);
+
+/*
+	A filter string tokenized and converted to RPN once, then evaluated against any number of servers.
+	Variables are bound to slots at compile time, so a server only has its keys looked up once per variable,
+	and evaluation runs over a fixed operand stack without allocating.
+	Results match evaluate() for the same token list.
+*/
+class CompiledFilter {
+public:
+	CompiledFilter();
+	CompiledFilter(const char *filter);
+
+	bool Matches(const std::map<std::string, std::string> &kvList) const;
+	//values has one entry per GetVariables() name
+	bool Evaluate(const FilterValue *values) const;
+	/*
+		Evaluates the first num_rows rows of columns, given in GetVariables() order, and sets bit N of matches for each row N which passes.
+		Each instruction runs over FILTER_BLOCK_SIZE rows at a time, with integer only operands handled by plain loops over the columns.
+	*/
+	void EvaluateColumns(const FilterColumn * const *columns, int num_rows, std::vector<uint32_t> &matches) const;
+
+	const std::vector<std::string> &GetVariables() const { return m_variables; };
+	bool IsEmpty() const { return m_empty; };
+
+	//converts a key value the same way resolve_variable does
+	static FilterValue BindValue(const std::string &value);
+private:
+	bool m_empty;
+	std::vector<FilterInstruction> m_program;
+	std::vector<std::string> m_constants;
+	std::vector<std::string> m_variables;
+	int m_max_depth;
+};
+
+/*
+	LRU of compiled filters keyed on the filter string, shared by every query thread
+*/
+class FilterCache {
+public:
+	FilterCache(int max_size = FILTER_CACHE_SIZE);
+	~FilterCache();
+	CompiledFilter Get(const char *filter);
+
+	uint64_t GetNumHits() { return m_num_hits; };
+	uint64_t GetNumMisses() { return m_num_misses; };
+
+	static FilterCache *getSingleton();
+private:
+	typedef std::list<std::pair<std::string, CompiledFilter> > LRUList;
+	LRUList m_lru;
+	std::map<std::string, LRUList::iterator> m_index;
+	int m_max_size;
+	OS::CMutex *mp_mutex;
+	uint64_t m_num_hits;
+	uint64_t m_num_misses;
+};
+#endif //OS_FILTER_COMPILED_H
@@ -1,16 +1,9 @@
 #include "filter.h"
 #include "CToken.h"
 
-//this must be changed so that the filter list isn't reallocated constantly for each server.. this is just temp
-bool filterMatches(const char *filter, std::map<std::string, std::string>& kvList) {
-	//std::vector<CToken *> filterToTokenList(const char *filter, std::vector<void *> &token_data);
-	if(filter == NULL || strlen(filter) == 0) {
-		return true;
-	}
-	std::vector<CToken> token_list = CToken::filterToTokenList((const char *)filter);
-
-	bool ret = evaluate(token_list, kvList);
+#include "CompiledFilter.h"
 
-	//freeTokenList(token_list);
-	return ret;	
+//compiled filters are cached, callers testing many servers should still compile once with FilterCache and call Matches directly
+bool filterMatches(const char *filter, std::map<std::string, std::string>& kvList) {
+	return FilterCache::getSingleton()->Get(filter).Matches(kvList);
 }
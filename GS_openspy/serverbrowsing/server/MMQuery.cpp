@@ -11,18 +11,52 @@
 #include <algorithm>
 
 #include <serverbrowsing/filter/filter.h>
+#include <serverbrowsing/filter/CompiledFilter.h>
 
-#include <OS/Cache/GameCache.h>
+#include <OS/RedisParser.h>
+
+#include "ServerListCache.h"
 
 namespace MM {
 
 	OS::TaskPool<MMQueryTask, MMQueryRequest> *m_task_pool = NULL;
-	OS::GameCache *m_game_cache;
 	Redis::Connection *mp_redis_async_retrival_connection;
 	OS::CThread *mp_async_thread;
 	Redis::Connection *mp_redis_async_connection;
 	MMQueryTask *mp_async_lookup_task = NULL;
 	const char *sb_mm_channel = "serverbrowsing.servers";
+	OS::LatencyHistogram g_filter_eval_span("filter_eval", "Time spent matching a list request's filter against the game's servers, once per request");
+
+	/*
+		Returns a whole server record per key in one round trip, KEYS are server keys, ARGV is include_deleted, all_keys.
+		Each entry is {-1} (key gone), {0} (deleted) or {1, gameid, id, wan_port, wan_ip, custkeys, [player keys, team keys]}
+		Kept on one line without double quotes so it can be sent as an inline command.
+	*/
+	const char *mm_server_snapshot_script = "local r = {} "
+		"for i, k in ipairs(KEYS) do "
+			"if redis.call('EXISTS', k) == 0 then "
+				"r[i] = {-1} "
+			"elseif ARGV[1] ~= '1' and redis.call('HGET', k, 'deleted') == '1' then "
+				"r[i] = {0} "
+			"else "
+				"local h = redis.call('HMGET', k, 'gameid', 'id', 'wan_port', 'wan_ip') "
+				"local e = {1, h[1], h[2], h[3], h[4], redis.call('HGETALL', k .. 'custkeys')} "
+				"if ARGV[2] == '1' then "
+					"for t, name in ipairs({'custkeys_player_', 'custkeys_team_'}) do "
+						"local list = {} "
+						"local n = 0 "
+						"while redis.call('EXISTS', k .. name .. n) == 1 do "
+							"list[n + 1] = redis.call('HGETALL', k .. name .. n) "
+							"n = n + 1 "
+						"end "
+						"e[6 + t] = list "
+					"end "
+				"end "
+				"r[i] = e "
+			"end "
+		"end "
+		"return r";
+	std::string mm_server_snapshot_sha;
 
 	void *setup_redis_async(OS::CThread *thread) {
 		struct timeval t;
@@ -42,18 +76,18 @@ namespace MM {
 		t.tv_usec = 0;
 		t.tv_sec = 60;
 
-		OS::DataCacheTimeout gameCacheTimeout;
-		gameCacheTimeout.max_keys = 50;
-		gameCacheTimeout.timeout_time_secs = 7200;
-
 		mp_redis_async_retrival_connection = Redis::Connect(OS::g_redisAddress, t);
+		LoadServerSnapshotScript(mp_redis_async_retrival_connection);
 		mp_async_thread = OS::CreateThread(setup_redis_async, NULL, true);
 		OS::Sleep(200);
 
-		m_game_cache = new OS::GameCache(NUM_MM_QUERY_THREADS+1, gameCacheTimeout);
+		mp_server_list_cache = new ServerListCache();
 
 		m_task_pool = new OS::TaskPool<MMQueryTask, MMQueryRequest>(NUM_MM_QUERY_THREADS);
 		server->SetTaskPool(m_task_pool);
+
+		OS::InstrumentRegistry::getSingleton()->AddCollector("sb_backend", m_task_pool);
+		OS::InstrumentRegistry::getSingleton()->AddCollector("sb_server_list_cache", mp_server_list_cache);
 	}
 
 
@@ -72,11 +106,18 @@ namespace MM {
 	    			find_param(1, temp_str, (char *)&server_key, sizeof(server_key));
 					free((void *)temp_str);
 
+					if(strcmp(msg_type,"del") == 0) {
+						mp_server_list_cache->RemoveServer(server_key);
+					}
+
 	    			server = mp_async_lookup_task->GetServerByKey(server_key, mp_redis_async_retrival_connection, strcmp(msg_type,"del") == 0);
 	    			if(!server) return;
 
 					MM::Server server_cpy = *server;
 					delete server;
+					if(strcmp(msg_type,"new") == 0 || strcmp(msg_type,"update") == 0) {
+						mp_server_list_cache->UpdateServer(server_cpy);
+					}
 	    			std::vector<SB::Driver *>::iterator it = task->m_drivers.begin();
 	    			while(it != task->m_drivers.end()) {
 	    				SB::Driver *driver = *it;
@@ -135,323 +176,198 @@ namespace MM {
 	}
 
 	void MMQueryTask::Shutdown() {
-
+		OS::InstrumentRegistry::getSingleton()->RemoveCollectors(m_task_pool);
+		OS::InstrumentRegistry::getSingleton()->RemoveCollectors(mp_server_list_cache);
 	}
 
 	//////////////////////////////////////////////////
 	/// Async MM Query code
-	void MMQueryTask::AppendServerEntry(std::string entry_name, ServerListQuery *ret, bool all_keys, bool include_deleted, Redis::Connection *redis_ctx, const sServerListReq *req) {
-		Redis::Response reply;
-		int cursor = 0;
-		int idx = 0;
-		uint8_t last_type = Redis::REDIS_RESPONSE_TYPE_NULL;
-		std::string key;
+	void LoadServerSnapshotScript(Redis::Connection *redis_ctx) {
+		const Redis::ReplyValue *reply = Redis::CommandReply(redis_ctx, "SCRIPT LOAD \"%s\"", mm_server_snapshot_script);
+		if (reply && reply->type == Redis::REDIS_RESPONSE_TYPE_STRING) {
+			mm_server_snapshot_sha = std::string(reply->str, reply->len);
+		}
+		else {
+			OS::LogText(OS::ELogLevel_Critical, "Failed to load server snapshot script");
+		}
+	}
+	/*
+		Runs the snapshot script over a batch of server keys, the reply is only valid until the next command on redis_ctx
+	*/
+	const Redis::ReplyValue *FetchServerSnapshots(std::vector<std::string> &entry_names, bool all_keys, bool include_deleted, Redis::Connection *redis_ctx) {
 		std::ostringstream s;
-
-		Redis::Value v, arr;
-
-		std::map<std::string, std::string> all_cust_keys; //used for filtering
-
-		if(!redis_ctx) {
-			redis_ctx = mp_redis_connection;
+		s << "EVALSHA " << mm_server_snapshot_sha << " " << entry_names.size();
+		std::vector<std::string>::iterator it = entry_names.begin();
+		while (it != entry_names.end()) {
+			s << " \"" << *it << "\"";
+			it++;
 		}
+		s << " " << include_deleted << " " << all_keys;
+		std::string cmd = s.str();
 
-		/*
-		XXX: add redis error checks, cleanup on error, etc
-		*/
-
-
-		//freeReplyObject(redisCommand(redis_ctx, "SELECT %d", OS::ERedisDB_QR));
 		Redis::Command(redis_ctx, 0, "SELECT %d", OS::ERedisDB_QR);
-
-		std::vector<std::string>::iterator it = ret->requested_fields.begin();
-
-		//skip deleted servers
-		if (!include_deleted) {
-			reply = Redis::Command(redis_ctx, 0, "HGET %s deleted", entry_name.c_str());
-			v = reply.values[0];
-			if (v.type == Redis::REDIS_RESPONSE_TYPE_INTEGER && v.value._int == 1) {
-				return;
-			}
-			else if (v.type == Redis::REDIS_RESPONSE_TYPE_STRING && v.value._str.compare("1") == 0) {
-				return;
+		const Redis::ReplyValue *reply = Redis::CommandReply(redis_ctx, "%s", cmd.c_str());
+		if (reply && reply->type == Redis::REDIS_RESPONSE_TYPE_ERROR && reply->len >= 8 && strncmp(reply->str, "NOSCRIPT", 8) == 0) {
+			//script cache was flushed (redis restart etc), the sha stays the same
+			Redis::Command(redis_ctx, 0, "SCRIPT LOAD \"%s\"", mm_server_snapshot_script);
+			reply = Redis::CommandReply(redis_ctx, "%s", cmd.c_str());
+		}
+		return reply;
+	}
+	std::string ReplyString(const Redis::ReplyValue *v) {
+		if (v->type == Redis::REDIS_RESPONSE_TYPE_STRING) {
+			return std::string(v->str, v->len);
+		}
+		return std::string();
+	}
+	void ReplyToKVFields(const Redis::ReplyValue *arr, std::map<std::string, std::string> &kv_fields, std::vector<std::string> &captured_fields) {
+		if (arr->type != Redis::REDIS_RESPONSE_TYPE_ARRAY)
+			return;
+		for (int i = 0; i + 1 < arr->len; i += 2) {
+			std::string key = ReplyString(&arr->elements[i]);
+			kv_fields[key] = ReplyString(&arr->elements[i + 1]);
+			if (std::find(captured_fields.begin(), captured_fields.end(), key) == captured_fields.end()) {
+				captured_fields.push_back(key);
 			}
 		}
+	}
+	void MMQueryTask::AppendServerEntry(std::string entry_name, ServerListQuery *ret, bool all_keys, bool include_deleted, Redis::Connection *redis_ctx, const sServerListReq *req) {
+		std::vector<std::string> entry_names;
+		entry_names.push_back(entry_name);
+		AppendServerEntries(entry_names, ret, all_keys, include_deleted, redis_ctx, req);
+	}
+	bool MMQueryTask::AppendServerEntries(std::vector<std::string> entry_names, ServerListQuery *ret, bool all_keys, bool include_deleted, Redis::Connection *redis_ctx, const sServerListReq *req) {
+		bool complete = true;
+		if(!redis_ctx) {
+			redis_ctx = mp_redis_connection;
+		}
+		CompiledFilter filter;
+		if (req) {
+			filter = FilterCache::getSingleton()->Get(req->filter.c_str());
+		}
 
-
-		Server *server = new MM::Server();
-
-		reply = Redis::Command(redis_ctx, 0, "HGET %s gameid", entry_name.c_str());
-
-		if (reply.values.size() == 0 || reply.values.front().type == Redis::REDIS_RESPONSE_TYPE_ERROR)
-			goto error_cleanup;
-
-		v = reply.values.front();
-		if(v.type == Redis::REDIS_RESPONSE_TYPE_STRING) {
-			std::string gameid_reply = (v.value._str).c_str();
-			int gameid = atoi(gameid_reply.c_str());
-			if (req) {
-				server->game = req->m_for_game;
+		size_t batch_start = 0;
+		while (batch_start < entry_names.size()) {
+			size_t batch_end = batch_start + MM_SERVER_SNAPSHOT_BATCH_SIZE;
+			if (batch_end > entry_names.size()) {
+				batch_end = entry_names.size();
 			}
-			else {				
-				if (!m_game_cache->LookupGameByID(gameid, server->game)) {
-					server->game = OS::GetGameByID(gameid, redis_ctx);
-					m_game_cache->AddGame(m_thread_index, server->game);
-				}				
+			std::vector<std::string> batch(entry_names.begin() + batch_start, entry_names.begin() + batch_end);
+			batch_start = batch_end;
+
+			std::vector<Server *> servers;
+			std::vector<int> gameids;
+			std::vector<std::string> missing_keys;
+			std::vector<std::map<std::string, std::string> > all_cust_keys; //used for filtering
+
+			//copy everything out of the reply before issuing any other command
+			const Redis::ReplyValue *reply = FetchServerSnapshots(batch, all_keys, include_deleted, redis_ctx);
+			if (!reply || reply->type != Redis::REDIS_RESPONSE_TYPE_ARRAY || reply->len != (int)batch.size()) {
+				complete = false;
+				continue;
 			}
-			
-			Redis::Command(redis_ctx, 0, "SELECT %d", OS::ERedisDB_QR);
-		}
-
-		server->key = entry_name;
-
-		Redis::Command(redis_ctx, 0, "ZINCRBY %s -1 \"%s\"", server->game.gamename, entry_name.c_str());
-
-
-		reply = Redis::Command(redis_ctx, 0, "HGET %s id", entry_name.c_str());
-		if (reply.values.size() == 0 || reply.values.front().type == Redis::REDIS_RESPONSE_TYPE_ERROR)
-			goto error_cleanup;
-
-		v = reply.values.front();
-
-		if (v.type == Redis::REDIS_RESPONSE_TYPE_STRING)
-			server->id = atoi((v.value._str).c_str());
-
-		reply = Redis::Command(redis_ctx, 0, "HGET %s wan_port", entry_name.c_str());
-
-		if (reply.values.size() == 0 || reply.values.front().type == Redis::REDIS_RESPONSE_TYPE_ERROR)
-			goto error_cleanup;
-
-		v = reply.values.front();
-
-		if(v.type== Redis::REDIS_RESPONSE_TYPE_STRING)
-			server->wan_address.port = atoi((v.value._str).c_str());
-
-		reply = Redis::Command(redis_ctx, 0, "HGET %s wan_ip", entry_name.c_str());
-
-		if (reply.values.size() == 0 || reply.values.front().type == Redis::REDIS_RESPONSE_TYPE_ERROR)
-			goto error_cleanup;
-
-		v = reply.values.front();
-
-		if(v.type == Redis::REDIS_RESPONSE_TYPE_STRING)
-			server->wan_address.ip = inet_addr((v.value._str).c_str());
-
-		if(all_keys) {
-			do {
-				reply = Redis::Command(redis_ctx, 0, "HSCAN %scustkeys %d MATCH *", entry_name.c_str(), cursor);
-				if (reply.values.size() == 0 || reply.values.front().type == Redis::REDIS_RESPONSE_TYPE_ERROR || reply.values[0].arr_value.values.size() < 2)
-					goto error_cleanup;
-
-				v = reply.values[0].arr_value.values[0].second;
-				arr = reply.values[0].arr_value.values[1].second;
+			for (int i = 0; i < reply->len; i++) {
+				const Redis::ReplyValue *entry = &reply->elements[i];
+				if (entry->type != Redis::REDIS_RESPONSE_TYPE_ARRAY || entry->len < 1)
+					continue;
 
-				if (arr.type == Redis::REDIS_RESPONSE_TYPE_ARRAY) {
-					if(v.type == Redis::REDIS_RESPONSE_TYPE_STRING) {
-						cursor = atoi(v.value._str.c_str());
-					} else if(v.type == Redis::REDIS_RESPONSE_TYPE_INTEGER) {
-						cursor = v.arr_value.values[0].second.value._int;
-					}
+				//-1: server key is gone, 0: deleted
+				if (entry->elements[0]._int == -1) {
+					missing_keys.push_back(batch[i]);
+					continue;
+				}
+				if (entry->elements[0]._int != 1 || entry->len < 6)
+					continue;
 
-					for(int i=0;i<arr.arr_value.values.size();i+=2) {
+				Server *server = new MM::Server();
+				server->key = batch[i];
+				server->id = atoi(ReplyString(&entry->elements[2]).c_str());
+				server->wan_address.port = atoi(ReplyString(&entry->elements[3]).c_str());
+				if (entry->elements[4].type == Redis::REDIS_RESPONSE_TYPE_STRING)
+					server->wan_address.ip = inet_addr(ReplyString(&entry->elements[4]).c_str());
 
-						if(arr.arr_value.values[1].first != Redis::REDIS_RESPONSE_TYPE_STRING)
-							continue;
+				ReplyToKVFields(&entry->elements[5], server->kvFields, ret->captured_basic_fields);
+				all_cust_keys.push_back(server->kvFields);
 
-						std::string key = arr.arr_value.values[i].second.value._str;
-						if (arr.arr_value.values[i+1].first == Redis::REDIS_RESPONSE_TYPE_STRING) {
-							server->kvFields[key] = (arr.arr_value.values[i + 1].second.value._str);
-						}
-						else if(arr.arr_value.values[i + 1].first == Redis::REDIS_RESPONSE_TYPE_INTEGER) {
-							server->kvFields[key] = arr.arr_value.values[i + 1].second.value._int;
+				if (all_keys && entry->len >= 8) {
+					if (entry->elements[6].type == Redis::REDIS_RESPONSE_TYPE_ARRAY) {
+						for (int idx = 0; idx < entry->elements[6].len; idx++) {
+							ReplyToKVFields(&entry->elements[6].elements[idx], server->kvPlayers[idx], ret->captured_player_fields);
 						}
-
-						if(std::find(ret->captured_basic_fields.begin(), ret->captured_basic_fields.end(), arr.arr_value.values[i + 1].second.value._str) == ret->captured_basic_fields.end()) {
-							ret->captured_basic_fields.push_back(arr.arr_value.values[i].second.value._str);
+					}
+					if (entry->elements[7].type == Redis::REDIS_RESPONSE_TYPE_ARRAY) {
+						for (int idx = 0; idx < entry->elements[7].len; idx++) {
+							ReplyToKVFields(&entry->elements[7].elements[idx], server->kvTeams[idx], ret->captured_team_fields);
 						}
 					}
 				}
-			} while (cursor != 0);
-			cursor = 0;
-			do {
-				s << entry_name << "custkeys_player_" << idx;
-				key = s.str();
-
-				reply = Redis::Command(redis_ctx, 0, "EXISTS %s", key.c_str());
-				if (reply.values.size() == 0 || reply.values.front().type == Redis::REDIS_RESPONSE_TYPE_ERROR)
-					break;
-
-				v = reply.values.front();
-				if (v.type == Redis::REDIS_RESPONSE_TYPE_INTEGER) {
-					if (!v.value._int)
-						break;
-				}
-				else if (v.type == Redis::REDIS_RESPONSE_TYPE_STRING) {
-					if (!atoi(v.value._str.c_str()))
-						break;
-				}
-
-				cursor = 0;
-				do {
-					reply = Redis::Command(redis_ctx, 0, "HSCAN %s %d MATCH *", key.c_str(), cursor);
-
-					if (reply.values[0].arr_value.values.size() < 2) {
-						goto error_cleanup;
-					}
-
-					v = reply.values[0].arr_value.values[0].second;
-					arr = reply.values[0].arr_value.values[1].second;
-					if (arr.arr_value.values.size() < 2)
-						break;
-
-					for (int i = 0; i<arr.arr_value.values.size(); i += 2) {
-
-						if (arr.arr_value.values[1].first != Redis::REDIS_RESPONSE_TYPE_STRING)
-							continue;
-
-						std::string key = arr.arr_value.values[i].second.value._str;
-						if (arr.arr_value.values[i + 1].first == Redis::REDIS_RESPONSE_TYPE_STRING) {
-							server->kvPlayers[idx][key] = (arr.arr_value.values[i + 1].second.value._str);
-						}
-						else if (arr.arr_value.values[i + 1].first == Redis::REDIS_RESPONSE_TYPE_INTEGER) {
-							server->kvPlayers[idx][key] = arr.arr_value.values[i + 1].second.value._int;
-						}
-
-						if (std::find(ret->captured_team_fields.begin(), ret->captured_team_fields.end(), arr.arr_value.values[i].second.value._str) == ret->captured_team_fields.end()) {
-							ret->captured_player_fields.push_back(arr.arr_value.values[i].second.value._str);
+				else if (!all_keys) {
+					//add only keys which were requested
+					server->kvFields.clear();
+					std::map<std::string, std::string>::iterator it = all_cust_keys.back().begin();
+					while (it != all_cust_keys.back().end()) {
+						std::pair<std::string, std::string> p = *it;
+						if (std::find(ret->requested_fields.begin(), ret->requested_fields.end(), p.first) != ret->requested_fields.end()) {
+							server->kvFields[p.first] = p.second;
 						}
+						it++;
 					}
-					s.str("");
-				} while (cursor != 0);
-				idx++;
-			} while (true);
-			s.str("");
-
-			idx = 0;
-
-			do {
-				s << entry_name << "custkeys_team_" << idx;
-				key = s.str();
-
-				reply = Redis::Command(redis_ctx, 0, "EXISTS %s", key.c_str());
-				if (reply.values.size() == 0 || reply.values.front().type == Redis::REDIS_RESPONSE_TYPE_ERROR)
-					break;
+				}
 
-				v = reply.values.front();
-				if (v.type == Redis::REDIS_RESPONSE_TYPE_INTEGER) {
-					if (!v.value._int)
-						break;
+				if (entry->elements[1].type == Redis::REDIS_RESPONSE_TYPE_STRING) {
+					gameids.push_back(atoi(ReplyString(&entry->elements[1]).c_str()));
 				}
-				else if (v.type == Redis::REDIS_RESPONSE_TYPE_STRING) {
-					if (!atoi(v.value._str.c_str()))
-						break;
+				else {
+					gameids.push_back(-1);
 				}
+				servers.push_back(server);
+			}
 
-				cursor = 0;
-				do {
-					reply = Redis::Command(redis_ctx, 0, "HSCAN %s %d MATCH *", key.c_str(), cursor);
-					if (reply.values.size() < 2|| reply.values.front().type == Redis::REDIS_RESPONSE_TYPE_ERROR || reply.values[0].arr_value.values.size() < 2)
-						break;
-
-					v = reply.values[0];
-					arr = reply.values[1];
-
-					if (v.type == Redis::REDIS_RESPONSE_TYPE_ARRAY) {
-						if (v.arr_value.values.size() <= 0) {
-							break;
-						}
-						for (int i = 0; i<arr.arr_value.values.size(); i += 2) {
-
-							if (arr.arr_value.values[1].first != Redis::REDIS_RESPONSE_TYPE_STRING)
-								continue;
-
-							std::string key = arr.arr_value.values[i].second.value._str;
-							if (arr.arr_value.values[i + 1].first == Redis::REDIS_RESPONSE_TYPE_STRING) {
-								server->kvTeams[idx][key] = (arr.arr_value.values[i + 1].second.value._str);
-							}
-							else if (arr.arr_value.values[i + 1].first == Redis::REDIS_RESPONSE_TYPE_INTEGER) {
-								server->kvTeams[idx][key] = arr.arr_value.values[i + 1].second.value._int;
-							}
-
-							if(std::find(ret->captured_team_fields.begin(), ret->captured_team_fields.end(), arr.arr_value.values[i].second.value._str) == ret->captured_team_fields.end()) {
-								ret->captured_team_fields.push_back(arr.arr_value.values[i].second.value._str);
-							}
-						}
-					}
-					s.str("");
-				} while(cursor != 0);
-				idx++;
-			} while(true);
-
-			idx = 0;
-			all_cust_keys = server->kvFields;
-		} else {
-			do {
-				reply = Redis::Command(redis_ctx, 0, "HSCAN %scustkeys %d MATCH *", entry_name.c_str(), cursor);
-				if (reply.values.size() == 0 || reply.values.front().type == Redis::REDIS_RESPONSE_TYPE_ERROR || reply.values[0].arr_value.values.size() < 2)
-					goto error_cleanup;
-
-				v = reply.values[0].arr_value.values[0].second;
-				arr = reply.values[0].arr_value.values[1].second;
-
-				if (arr.type == Redis::REDIS_RESPONSE_TYPE_ARRAY) {
-					if (v.type == Redis::REDIS_RESPONSE_TYPE_STRING) {
-						cursor = atoi(v.value._str.c_str());
+			uint64_t filter_time = 0;
+			for (size_t i = 0; i < servers.size(); i++) {
+				Server *server = servers[i];
+				if (gameids[i] != -1) {
+					if (req) {
+						server->game = req->m_for_game;
 					}
-					else if (v.type == Redis::REDIS_RESPONSE_TYPE_INTEGER) {
-						cursor = v.arr_value.values[0].second.value._int;
-					}
-
-					for (int i = 0; i<arr.arr_value.values.size(); i += 2) {
-
-						if (arr.arr_value.values[1].first != Redis::REDIS_RESPONSE_TYPE_STRING)
-							continue;
-
-						std::string key = arr.arr_value.values[i].second.value._str;
-						if (arr.arr_value.values[i + 1].first == Redis::REDIS_RESPONSE_TYPE_STRING) {
-							server->kvFields[key] = (arr.arr_value.values[i + 1].second.value._str);
-						}
-						else if (arr.arr_value.values[i + 1].first == Redis::REDIS_RESPONSE_TYPE_INTEGER) {
-							server->kvFields[key] = arr.arr_value.values[i + 1].second.value._int;
-						}
-
-						if (std::find(ret->captured_basic_fields.begin(), ret->captured_basic_fields.end(), arr.arr_value.values[i].second.value._str) == ret->captured_basic_fields.end()) {
-							ret->captured_basic_fields.push_back(arr.arr_value.values[i].second.value._str);
-						}
+					else {
+						server->game = OS::GetGameByID(gameids[i], redis_ctx);
 					}
 				}
-			} while(cursor != 0);
-
-
-			all_cust_keys = server->kvFields;
-			server->kvFields.clear(); //remove all keys
-			std::map<std::string, std::string>::iterator it = all_cust_keys.begin();
-			while(it != all_cust_keys.end()) {
-				std::pair<std::string, std::string> p = *it;
 
-				//add only keys which were requested
-				if(std::find(ret->requested_fields.begin(), ret->requested_fields.end(), p.first) != ret->requested_fields.end()) {
-					server->kvFields[p.first] = p.second;
+				uint64_t filter_start = OS::GetMonotonicTimeUS();
+				bool matches = filter.Matches(all_cust_keys[i]);
+				filter_time += OS::GetMonotonicTimeUS() - filter_start;
+				if (!matches) {
+					delete server;
+					servers[i] = NULL;
+					continue;
 				}
-				it++;
+				if (req && req->max_results != 0 && ret->list.size() >= req->max_results) {
+					delete server;
+					servers[i] = NULL;
+					continue;
+				}
+				ret->list.push_back(server);
 			}
-		}
+			g_filter_eval_span.Record(filter_time);
 
-		if(!req || filterMatches(req->filter.c_str(), all_cust_keys)) {
-			if (!req || (ret->list.size() < req->max_results || req->max_results == 0)) {
-				ret->list.push_back(server);
+			Redis::AppendCommand(redis_ctx, "SELECT %d", OS::ERedisDB_QR);
+			for (size_t i = 0; i < servers.size(); i++) {
+				if (servers[i]) {
+					Redis::AppendCommand(redis_ctx, "ZINCRBY %s -1 \"%s\"", servers[i]->game.gamename, servers[i]->key.c_str());
+				}
 			}
+			if (req) {
+				std::vector<std::string>::iterator it = missing_keys.begin();
+				while (it != missing_keys.end()) {
+					Redis::AppendCommand(redis_ctx, "ZREM %s \"%s\"", req->m_for_game.gamename, (*it).c_str());
+					it++;
+				}
+			}
+			Redis::Flush(redis_ctx);
 		}
-		else {
-			delete server;
-		}
-		goto true_exit;
-
-	error_cleanup:
-			delete server;
-	true_exit:
-		Redis::Command(redis_ctx, 0, "SELECT %d", OS::ERedisDB_QR);
-
+		return complete;
 	}
 	bool MMQueryTask::FindAppend_PlayerKVFields(Server *server, std::string entry_name, std::string key, int index, Redis::Connection *redis_ctx)
 	 {
@@ -533,10 +449,7 @@ namespace MM {
 			server->game = request->req.m_for_game;
 		}
 		else {
-			if (!m_game_cache->LookupGameByID(atoi((v.value._str).c_str()), server->game)) {
-				server->game = OS::GetGameByID(atoi((v.value._str).c_str()), redis_ctx);
-				m_game_cache->AddGame(m_thread_index, server->game);
-			}
+			server->game = OS::GetGameByID(atoi((v.value._str).c_str()), redis_ctx);
 		}
 		
 		Redis::Command(redis_ctx, 0, "SELECT %d", OS::ERedisDB_SBGroups); //change context back to SB db id
@@ -610,23 +523,46 @@ namespace MM {
 		delete server;
 
 	}
-	ServerListQuery MMQueryTask::GetServers(const sServerListReq *req, const MMQueryRequest *request) {
+	ServerListQuery MMQueryTask::GetServers(const sServerListReq *req, const MMQueryRequest *request, bool *success) {
 		ServerListQuery ret;
+		bool complete = true;
+		if (success) {
+			*success = false;
+		}
 
 		Redis::Response reply;
 		Redis::Value v, arr;
 
 		ret.requested_fields = req->field_list;
 
+		//answer from memory, the first request for a game loads it
+		if (request && !req->no_list_cache) {
+			if (mp_server_list_cache->WaitForGame(req->m_for_game)) {
+				ReloadServerCache(req->m_for_game, true);
+			}
+			if (mp_server_list_cache->GetServers(req, &ret)) {
+				ret.first_set = true;
+				ret.last_set = true;
+				request->peer->OnRetrievedServers(*request, ret, request->extra);
+				MM::MMQueryTask::FreeServerListQuery(&ret);
+				ret.list.clear();
+				if (success) {
+					*success = true;
+				}
+				return ret;
+			}
+		}
+
 		Redis::Command(mp_redis_connection, 0, "SELECT %d", OS::ERedisDB_QR);
 		
 		int cursor = 0;
 		bool sent_servers = false;
+		std::vector<std::string> server_keys;
 
 		do {
 			ServerListQuery streamed_ret;
 			streamed_ret.requested_fields = ret.requested_fields;
-			reply = Redis::Command(mp_redis_connection, 0, "ZSCAN %s %d", req->m_for_game.gamename, cursor);
+			reply = Redis::Command(mp_redis_connection, 0, "ZSCAN %s %d COUNT %d", req->m_for_game.gamename, cursor, MM_SERVER_SNAPSHOT_BATCH_SIZE);
 			if (Redis::CheckError(reply))
 				goto error_cleanup;
 
@@ -652,27 +588,15 @@ namespace MM {
 				streamed_ret.last_set = true;
 			}
 
+			server_keys.clear();
 			for(int i=0;i<arr.arr_value.values.size();i+=2) {
-				std::string server_key = arr.arr_value.values[i].second.value._str;
-				reply = Redis::Command(mp_redis_connection, 0, "EXISTS %s", server_key.c_str());
-				
-				if (Redis::CheckError(reply) || reply.values.size() == 0) {
-					continue;
-				}
-				else {
-					v = reply.values[0];
-					if ((v.type == Redis::REDIS_RESPONSE_TYPE_INTEGER && v.value._int == 0) || (v.type == Redis::REDIS_RESPONSE_TYPE_STRING && v.value._str.compare("0") == 0)) {
-						Redis::Command(mp_redis_connection, 0, "ZREM %s \"%s\"", req->m_for_game.gamename, server_key.c_str());
-						continue;
-					}
-				}
-
-				if (request) {
-					AppendServerEntry(server_key, &streamed_ret, req->all_keys, false, mp_redis_connection, req);
-				}
-				else {
-					AppendServerEntry(server_key, &ret, req->all_keys, false, mp_redis_connection, req);
-				}
+				server_keys.push_back(arr.arr_value.values[i].second.value._str);
+			}
+			if (request) {
+				complete = AppendServerEntries(server_keys, &streamed_ret, req->all_keys, false, mp_redis_connection, req) && complete;
+			}
+			else {
+				complete = AppendServerEntries(server_keys, &ret, req->all_keys, false, mp_redis_connection, req) && complete;
 			}
 			if (request && (!streamed_ret.list.empty() || streamed_ret.last_set)) {
 				if (!sent_servers) {
@@ -686,6 +610,10 @@ namespace MM {
 			MM::MMQueryTask::FreeServerListQuery(&streamed_ret);
 		} while(cursor != 0);
 
+		if (success) {
+			*success = complete;
+		}
+
 		error_cleanup:
 			return ret;
 	}
@@ -803,6 +731,27 @@ namespace MM {
 		}
 	}
 
+	void MMQueryTask::ReloadServerCache(OS::GameData game, bool first_load) {
+		sServerListReq req;
+		req.m_for_game = game;
+		req.all_keys = true;
+		req.max_results = 0;
+		req.no_list_cache = true;
+
+		//a failed scan or snapshot leaves the game's previous entry in place, rather than replacing it with a partial list
+		bool success = false;
+		ServerListQuery ret = GetServers(&req, NULL, &success);
+		if (success) {
+			mp_server_list_cache->LoadGame(game, ret.list, first_load);
+		}
+		else {
+			mp_server_list_cache->LoadGameFailed(game, first_load);
+		}
+		MM::MMQueryTask::FreeServerListQuery(&ret);
+	}
+	void MMQueryTask::PerformReconcileServerCache(MMQueryRequest request) {
+		ReloadServerCache(request.req.m_for_game, false);
+	}
 	void MMQueryTask::PerformServersQuery(MMQueryRequest request) {
 		GetServers(&request.req, &request);
 	}
@@ -840,36 +789,21 @@ namespace MM {
 	}
 	void MMQueryTask::PerformGetGameInfoPairByGameName(MMQueryRequest request) {
 		OS::GameData games[2];
-		if (!m_game_cache->LookupGameByName(request.gamenames[0], games[0])) {
-			games[0] = OS::GetGameByName(request.gamenames[0].c_str(), this->mp_redis_connection);
-			m_game_cache->AddGame(m_thread_index, games[0]);
-		}		
-		if (!m_game_cache->LookupGameByName(request.gamenames[1], games[1])) {
-			games[1] = OS::GetGameByName(request.gamenames[1].c_str(), this->mp_redis_connection);
-			m_game_cache->AddGame(m_thread_index, games[1]);
-		}
+		games[0] = OS::GetGameByName(request.gamenames[0].c_str(), this->mp_redis_connection);
+		games[1] = OS::GetGameByName(request.gamenames[1].c_str(), this->mp_redis_connection);
 		
 		request.peer->OnRecievedGameInfoPair(games[0], games[1], request.extra);
 	}
 	void MMQueryTask::PerformGetGameInfoByGameName(MMQueryRequest request) {
-		OS::GameData game;
-		OS::GameCacheKey key;
-		if (!m_game_cache->LookupGameByName(request.gamenames[0], game)) {
-			game = OS::GetGameByName(request.gamenames[0].c_str(), this->mp_redis_connection);
-			key.gamename = request.gamenames[0];
-			key.id = game.gameid;
-			m_game_cache->AddItem(m_thread_index, key, game);
-		}
+		OS::GameData game = OS::GetGameByName(request.gamenames[0].c_str(), this->mp_redis_connection);
 		request.peer->OnRecievedGameInfo(game, request.extra);
 	}
 	void *MMQueryTask::TaskThread(OS::CThread *thread) {
 		MMQueryTask *task = (MMQueryTask *)thread->getParams();
-		while(!task->m_request_list.empty() || task->mp_thread_poller->wait()) {
-			task->mp_mutex->lock();
+		while(task->HasRequests() || task->mp_thread_poller->wait()) {
 			task->m_thread_awake = true;
-			while (!task->m_request_list.empty()) {
-				MMQueryRequest task_params = task->m_request_list.front();
-				task->mp_mutex->unlock();
+			MMQueryRequest task_params;
+			while (task->PopRequest(task_params)) {
 				task->mp_timer->start();
 				switch (task_params.type) {
 				case EMMQueryRequestType_GetServers:
@@ -893,25 +827,23 @@ namespace MM {
 				case EMMQueryRequestType_GetGameInfoPairByGameName:
 					task->PerformGetGameInfoPairByGameName(task_params);
 					break;
+				case EMMQueryRequestType_ReconcileServerCache:
+					task->PerformReconcileServerCache(task_params);
+					break;
 				}
 				task->mp_timer->stop();
 				if(task_params.peer) {
 					OS::LogText(OS::ELogLevel_Info, "[%s] Thread type %d - time: %f", OS::Address(*task_params.peer->getAddress()).ToString().c_str(), task_params.type, task->mp_timer->time_elapsed()  / 1000000.0);	
+					task_params.peer->DecRef();
 				}
-				
-				task_params.peer->DecRef();
-				task->mp_mutex->lock();
-				task->m_request_list.pop();
 			}
-			m_game_cache->timeoutMap(task->m_thread_index);
 			task->m_thread_awake = false;
-			task->mp_mutex->unlock();
 		}
 		return NULL;
 	}
 	void MMQueryTask::debug_dump() {
 		mp_mutex->lock();
-		printf("Task [%p] awake: %d, num_tasks: %d\n", this, m_thread_awake, m_request_list.size());
+		printf("Task [%p] awake: %d, num_tasks: %d\n", this, m_thread_awake, GetListSize());
 		mp_mutex->unlock();
 	}
 }
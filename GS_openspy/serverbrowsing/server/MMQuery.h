@@ -8,6 +8,7 @@
 #include <OS/Thread.h>
 #include <OS/Mutex.h>
 #include <OS/Redis.h>
+#include <OS/Analytics/Instrument.h>
 #include <vector>
 #include <map>
 #include <string>
@@ -93,6 +94,7 @@ namespace MM {
 		EMMQueryRequestType_SubmitData,
 		EMMQueryRequestType_GetGameInfoByGameName,
 		EMMQueryRequestType_GetGameInfoPairByGameName, //get 2 game names in same thread
+		EMMQueryRequestType_ReconcileServerCache, //reload req.m_for_game into the server list cache
 	};
 	typedef struct _MMQueryRequest {
 		EMMQueryRequestType type;
@@ -141,6 +143,7 @@ namespace MM {
 			static void *TaskThread(OS::CThread *thread);
 
 			void AppendServerEntry(std::string entry_name, ServerListQuery *ret, bool all_keys, bool include_deleted, Redis::Connection *redis_ctx, const sServerListReq *req);
+			bool AppendServerEntries(std::vector<std::string> entry_names, ServerListQuery *ret, bool all_keys, bool include_deleted, Redis::Connection *redis_ctx, const sServerListReq *req);
 			void AppendGroupEntry(const char *entry_name, ServerListQuery *ret, Redis::Connection *redis_ctx, bool all_keys, const MMQueryRequest *request);
 
 			bool FindAppend_ServKVFields(Server *server, std::string entry_name, std::string key, Redis::Connection *redis_ctx);
@@ -150,7 +153,8 @@ namespace MM {
 			Server *GetServerByKey(std::string key, Redis::Connection *redis_ctx = NULL, bool include_deleted = false);
 			Server *GetServerByIP(OS::Address address, OS::GameData game, Redis::Connection *redis_ctx = NULL);
 
-			ServerListQuery GetServers(const sServerListReq *req, const MMQueryRequest *request = NULL);
+			//success is set when every scan and snapshot batch was read, so the list is the game's whole list
+			ServerListQuery GetServers(const sServerListReq *req, const MMQueryRequest *request = NULL, bool *success = NULL);
 			ServerListQuery GetGroups(const sServerListReq *req, const MMQueryRequest *request = NULL);
 
 			void PerformServersQuery(MMQueryRequest request);
@@ -160,6 +164,10 @@ namespace MM {
 			void PerformGetServerByIP(MMQueryRequest request);
 			void PerformGetGameInfoPairByGameName(MMQueryRequest request);
 			void PerformGetGameInfoByGameName(MMQueryRequest request);
+			void PerformReconcileServerCache(MMQueryRequest request);
+
+			//first_load is set when WaitForGame made this thread the game's loader
+			void ReloadServerCache(OS::GameData game, bool first_load);
 			
 			std::vector<SB::Driver *> m_drivers;
 			Redis::Connection *mp_redis_connection;
@@ -170,9 +178,12 @@ namespace MM {
 	};
 
 	#define NUM_MM_QUERY_THREADS 8
+	#define MM_SERVER_SNAPSHOT_BATCH_SIZE 100 //servers fetched per EVALSHA
 	extern OS::TaskPool<MMQueryTask, MMQueryRequest> *m_task_pool;
+	extern OS::LatencyHistogram g_filter_eval_span;
 	void SetupTaskPool(SBServer *server);
 	void *setup_redis_async(OS::CThread *thread);
+	void LoadServerSnapshotScript(Redis::Connection *redis_ctx);
 
 };
 
@@ -0,0 +1,175 @@
+#include "PushSubscriptionIndex.h"
+#include "SBPeer.h"
+#include "V2Peer.h"
+#include <OS/Analytics/Instrument.h>
+#include <algorithm>
+
+namespace SB {
+	OS::Gauge g_push_subscription_groups("sb_push_subscription_groups", "Distinct game, filter and field list groups peers are subscribed to push updates for");
+	OS::Gauge g_push_subscribers("sb_push_subscribers", "Peers subscribed to push updates");
+	OS::Counter g_push_events("sb_push_events", "Server new, update and delete events fanned out to push subscribers");
+	OS::Counter g_push_filter_evaluations("sb_push_filter_evaluations", "Group filters run against a server for push events");
+	OS::Counter g_push_messages_sent("sb_push_messages_sent", "Push messages handed to peers");
+
+	PushSubscriptionIndex::PushSubscriptionIndex() {
+		mp_mutex = OS::CreateMutex();
+	}
+	PushSubscriptionIndex::~PushSubscriptionIndex() {
+		delete mp_mutex;
+	}
+	std::string PushSubscriptionIndex::NormalizeFilter(const std::string &filter) {
+		std::string ret;
+		char quote = 0;
+		bool pending_space = false;
+		for(size_t i = 0; i < filter.length(); i++) {
+			char ch = filter[i];
+			if(quote) {
+				ret += ch;
+				if(ch == quote) {
+					quote = 0;
+				}
+				continue;
+			}
+			if(isspace((unsigned char)ch)) {
+				pending_space = true;
+				continue;
+			}
+			//whitespace only matters between two words, eg "a and b"
+			if(pending_space && !ret.empty() && (isalnum((unsigned char)ret[ret.length()-1]) || ret[ret.length()-1] == '_') && (isalnum((unsigned char)ch) || ch == '_')) {
+				ret += ' ';
+			}
+			pending_space = false;
+			if(ch == '\'' || ch == '"') {
+				quote = ch;
+			}
+			ret += ch;
+		}
+		return ret;
+	}
+	std::string PushSubscriptionIndex::GetSubscriptionKey(const MM::sServerListReq &req) {
+		//field names can't contain a backslash, they're split on it
+		std::string key = NormalizeFilter(req.filter);
+		std::vector<std::string>::const_iterator it = req.field_list.begin();
+		while (it != req.field_list.end()) {
+			key += '\\';
+			key += *it;
+			it++;
+		}
+		return key;
+	}
+	void PushSubscriptionIndex::Subscribe(Peer *peer, const MM::sServerListReq &req) {
+		int gameid = req.m_for_game.gameid;
+		std::string key = GetSubscriptionKey(req);
+
+		mp_mutex->lock();
+		RemovePeer(peer);
+
+		SubscriptionMap &game_subscriptions = m_subscriptions[gameid];
+		SubscriptionMap::iterator it = game_subscriptions.find(key);
+		if (it == game_subscriptions.end()) {
+			PushSubscription subscription;
+			subscription.filter = req.filter;
+			subscription.field_list = req.field_list;
+			subscription.compiled_filter = FilterCache::getSingleton()->Get(req.filter.c_str());
+			it = game_subscriptions.insert(std::pair<std::string, PushSubscription>(key, subscription)).first;
+			g_push_subscription_groups.Incr();
+		}
+		it->second.peers.push_back(peer);
+		m_peer_subscriptions[peer] = std::pair<int, std::string>(gameid, key);
+		g_push_subscribers.Incr();
+		mp_mutex->unlock();
+	}
+	void PushSubscriptionIndex::Unsubscribe(Peer *peer) {
+		mp_mutex->lock();
+		RemovePeer(peer);
+		mp_mutex->unlock();
+	}
+	void PushSubscriptionIndex::RemovePeer(Peer *peer) {
+		std::map<Peer *, std::pair<int, std::string> >::iterator peer_it = m_peer_subscriptions.find(peer);
+		if (peer_it == m_peer_subscriptions.end()) {
+			return;
+		}
+		std::map<int, SubscriptionMap>::iterator game_it = m_subscriptions.find(peer_it->second.first);
+		if (game_it != m_subscriptions.end()) {
+			SubscriptionMap::iterator it = game_it->second.find(peer_it->second.second);
+			if (it != game_it->second.end()) {
+				std::vector<Peer *> &peers = it->second.peers;
+				peers.erase(std::remove(peers.begin(), peers.end(), peer), peers.end());
+				if (peers.empty()) {
+					game_it->second.erase(it);
+					g_push_subscription_groups.Decr();
+				}
+			}
+			if (game_it->second.empty()) {
+				m_subscriptions.erase(game_it);
+			}
+		}
+		m_peer_subscriptions.erase(peer_it);
+		g_push_subscribers.Decr();
+	}
+	void PushSubscriptionIndex::SendDeleteServer(MM::Server *server) {
+		mp_mutex->lock();
+		g_push_events.Add();
+		std::map<int, SubscriptionMap>::iterator game_it = m_subscriptions.find(server->game.gameid);
+		if (game_it != m_subscriptions.end()) {
+			//peers only act on deletes for servers they've been sent, so there's nothing to filter
+			SubscriptionMap::iterator it = game_it->second.begin();
+			while (it != game_it->second.end()) {
+				std::vector<Peer *>::iterator peer_it = it->second.peers.begin();
+				while (peer_it != it->second.peers.end()) {
+					(*peer_it)->informDeleteServers(server);
+					peer_it++;
+				}
+				it++;
+			}
+		}
+		mp_mutex->unlock();
+	}
+	void PushSubscriptionIndex::SendNewServer(MM::Server *server) {
+		SendServer(server, false);
+	}
+	void PushSubscriptionIndex::SendUpdateServer(MM::Server *server) {
+		SendServer(server, true);
+	}
+	void PushSubscriptionIndex::SendServer(MM::Server *server, bool update) {
+		mp_mutex->lock();
+		g_push_events.Add();
+		std::map<int, SubscriptionMap>::iterator game_it = m_subscriptions.find(server->game.gameid);
+		if (game_it == m_subscriptions.end()) {
+			mp_mutex->unlock();
+			return;
+		}
+
+		//the push message carries the full rules whatever the field list, so one copy serves every group
+		OS::Buffer message;
+		bool message_written = false;
+
+		SubscriptionMap::iterator it = game_it->second.begin();
+		while (it != game_it->second.end()) {
+			PushSubscription &subscription = it->second;
+			g_push_filter_evaluations.Add();
+			if (subscription.compiled_filter.Matches(server->kvFields)) {
+				if (!message_written) {
+					if (!V2Peer::WritePushServerMessage(server, message)) {
+						break;
+					}
+					message_written = true;
+				}
+				std::vector<Peer *>::iterator peer_it = subscription.peers.begin();
+				while (peer_it != subscription.peers.end()) {
+					Peer *peer = *peer_it;
+					if (update) {
+						peer->informUpdateServers(server, message);
+					}
+					else {
+						peer->informNewServers(server, message);
+					}
+					g_push_messages_sent.Add();
+					peer_it++;
+				}
+			}
+			it++;
+		}
+		mp_mutex->unlock();
+	}
+}
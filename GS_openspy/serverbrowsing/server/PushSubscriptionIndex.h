@@ -0,0 +1,49 @@
+#ifndef _SB_PUSHSUBSCRIPTIONINDEX_H
+#define _SB_PUSHSUBSCRIPTIONINDEX_H
+#include "MMQuery.h"
+#include <OS/Mutex.h>
+#include <serverbrowsing/filter/CompiledFilter.h>
+
+namespace SB {
+	class Peer;
+
+	/*
+		Peers which asked for push updates, grouped by the game, filter and field list of their last list request.
+		A server event runs each group's filter once and is serialized once, so each peer is only left with its cache check and encryption.
+	*/
+	class PushSubscriptionIndex {
+	public:
+		PushSubscriptionIndex();
+		~PushSubscriptionIndex();
+
+		//moves the peer to the group for req, replacing any previous subscription
+		void Subscribe(Peer *peer, const MM::sServerListReq &req);
+		void Unsubscribe(Peer *peer);
+
+		void SendDeleteServer(MM::Server *server);
+		void SendNewServer(MM::Server *server);
+		void SendUpdateServer(MM::Server *server);
+
+	private:
+		typedef struct {
+			std::string filter;
+			std::vector<std::string> field_list;
+			CompiledFilter compiled_filter;
+			std::vector<Peer *> peers;
+		} PushSubscription;
+		typedef std::map<std::string, PushSubscription> SubscriptionMap;
+
+		void SendServer(MM::Server *server, bool update);
+		void RemovePeer(Peer *peer);
+
+		//strips whitespace outside of string literals, so equivalent filters share a group
+		static std::string NormalizeFilter(const std::string &filter);
+		static std::string GetSubscriptionKey(const MM::sServerListReq &req);
+
+		std::map<int, SubscriptionMap> m_subscriptions; //keyed on gameid
+		std::map<Peer *, std::pair<int, std::string> > m_peer_subscriptions;
+
+		OS::CMutex *mp_mutex;
+	};
+}
+#endif //_SB_PUSHSUBSCRIPTIONINDEX_H
@@ -4,6 +4,7 @@
 #include  <algorithm>
 
 #include "SBServer.h"
+#include <OS/Net/NetServer.h>
 #include <OS/legacy/buffwriter.h>
 
 #include "SBPeer.h"
@@ -46,14 +47,18 @@ namespace SB {
 
 		m_version = version;
 
+		OS::TimerWheel::InitEntry(&m_reap_timer, Driver::OnReapTimer, this);
+		OS::TimerWheel::InitEntry(&m_push_timer, Driver::OnPushTimer, this);
+
 		mp_mutex = OS::CreateMutex();
-		mp_thread = OS::CreateThread(Driver::TaskThread, this, true);
 
 		makeNonBlocking(m_sd);
 
 	}
 	Driver::~Driver() {
 		//end all MMQuery tasks first, otherwise can crash here
+		m_server->GetTimerWheel()->Cancel(&m_reap_timer);
+		m_server->GetTimerWheel()->Cancel(&m_push_timer);
 		std::vector<Peer *>::iterator it = m_connections.begin();
 		while (it != m_connections.end()) {
 			Peer *peer = *it;
@@ -61,62 +66,88 @@ namespace SB {
 			delete peer;
 			it++;
 		}
-		delete mp_thread;
 		delete mp_mutex;
 	}
-	void *Driver::TaskThread(OS::CThread *thread) {
-		Driver *driver = (Driver *)thread->getParams();
-		for(;;) {
-			driver->mp_mutex->lock();
-			std::vector<Peer *>::iterator it = driver->m_connections.begin();
-			while (it != driver->m_connections.end()) {
-				Peer *peer = *it;
-				if (peer->ShouldDelete() && std::find(driver->m_peers_to_delete.begin(), driver->m_peers_to_delete.end(), peer) == driver->m_peers_to_delete.end()) {
-					//marked for delection, dec reference and delete when zero
-					it = driver->m_connections.erase(it);
-					peer->DecRef();
-
-					driver->m_server->UnregisterSocket(peer);
-
-					driver->m_stats_queue.push(peer->GetPeerStats());
-					driver->m_peers_to_delete.push_back(peer);
-					continue;
-				}
-				it++;
-			}
+	void Driver::OnPeerThink(INetPeer *inet_peer) {
+		Peer *peer = (Peer *)inet_peer;
+		mp_mutex->lock();
+		if (!peer->ShouldDelete()) {
+			peer->think(false);
+		}
+		if (peer->ShouldDelete()) {
+			DeletePeer(peer);
+		}
+		else {
+			peer->ScheduleThink(peer->GetThinkDelay());
+		}
+		mp_mutex->unlock();
+	}
+	void Driver::DeletePeer(Peer *peer) {
+		std::vector<Peer *>::iterator it = std::find(m_connections.begin(), m_connections.end(), peer);
+		if (it == m_connections.end()) {
+			return;
+		}
+		//marked for delection, dec reference and delete when zero
+		m_connections.erase(it);
+		peer->CancelThink();
+		peer->DecRef();
+
+		DeletedPeer deleted;
+		deleted.peer = peer;
+		deleted.close_time = time(NULL) + DRIVER_CLOSE_TIMEOUT;
+		deleted.registered = peer->HasPendingSend();
+		if (!deleted.registered) {
+			m_server->UnregisterSocket(peer);
+		}
 
-			it = driver->m_peers_to_delete.begin();
-			while (it != driver->m_peers_to_delete.end()) {
-				SB::Peer *p = *it;
-				if (p->GetRefCount() == 0) {
-					delete p;
-					it = driver->m_peers_to_delete.erase(it);
-					continue;
-				}
-				it++;
+		m_peers_to_delete.push_back(deleted);
+		m_server->GetTimerWheel()->Schedule(&m_reap_timer, DRIVER_REAP_TIME, true);
+	}
+	void Driver::OnReapTimer(void *extra) {
+		Driver *driver = (Driver *)extra;
+		driver->mp_mutex->lock();
+		time_t now = time(NULL);
+		std::vector<DeletedPeer>::iterator it = driver->m_peers_to_delete.begin();
+		while (it != driver->m_peers_to_delete.end()) {
+			SB::Peer *p = it->peer;
+			//a failed socket empties its queue, so this also covers clients which went away
+			if (it->registered && (!p->HasPendingSend() || now >= it->close_time)) {
+				driver->m_server->UnregisterSocket(p);
+				it->registered = false;
 			}
-
-			MM::Server serv;
-			while (!driver->m_server_delete_queue.empty()) {
-				serv = driver->m_server_delete_queue.front();
-				driver->m_server_delete_queue.pop();
-				driver->SendDeleteServer(&serv);
+			if (!it->registered && p->GetRefCount() == 0) {
+				delete p;
+				it = driver->m_peers_to_delete.erase(it);
+				continue;
 			}
+			it++;
+		}
+		if (!driver->m_peers_to_delete.empty()) {
+			driver->m_server->GetTimerWheel()->Schedule(&driver->m_reap_timer, DRIVER_REAP_TIME, true);
+		}
+		driver->mp_mutex->unlock();
+	}
+	void Driver::OnPushTimer(void *extra) {
+		Driver *driver = (Driver *)extra;
+		driver->mp_mutex->lock();
+		MM::Server serv;
+		while (!driver->m_server_delete_queue.empty()) {
+			serv = driver->m_server_delete_queue.front();
+			driver->m_server_delete_queue.pop();
+			driver->SendDeleteServer(&serv);
+		}
 
-			while (!driver->m_server_new_queue.empty()) {
-				serv = driver->m_server_new_queue.front();
-				driver->m_server_new_queue.pop();
-				driver->SendNewServer(&serv);
-			}
-			while (!driver->m_server_update_queue.empty()) {
-				serv = driver->m_server_update_queue.front();
-				driver->m_server_update_queue.pop();
-				driver->SendUpdateServer(&serv);
-			}
-			driver->TickConnections();
-			driver->mp_mutex->unlock();
-			OS::Sleep(DRIVER_THREAD_TIME);
+		while (!driver->m_server_new_queue.empty()) {
+			serv = driver->m_server_new_queue.front();
+			driver->m_server_new_queue.pop();
+			driver->SendNewServer(&serv);
+		}
+		while (!driver->m_server_update_queue.empty()) {
+			serv = driver->m_server_update_queue.front();
+			driver->m_server_update_queue.pop();
+			driver->SendUpdateServer(&serv);
 		}
+		driver->mp_mutex->unlock();
 	}
 	void Driver::think(bool listen_waiting) {
 		if (listen_waiting) {
@@ -140,6 +171,7 @@ namespace SB {
 				mp_mutex->lock();
 				m_connections.push_back(mp_peer);
 				m_server->RegisterSocket(mp_peer);
+				mp_peer->ScheduleThink(mp_peer->GetThinkDelay());
 				mp_mutex->unlock();
 				//mp_peer->think(true);
 			}
@@ -191,51 +223,31 @@ namespace SB {
 		return sockets;
 	}
 
-	void Driver::TickConnections() {
-		std::vector<Peer *>::iterator it = m_connections.begin();
-		while (it != m_connections.end()) {
-			Peer *p = *it;
-			p->think(false);
-			it++;
-		}
-	}
 	void Driver::SendDeleteServer(MM::Server *server) {
-		std::vector<Peer *>::iterator it = m_connections.begin();
-		while (it != m_connections.end()) {
-			Peer *p = *it;
-			p->informDeleteServers(server);
-			it++;
-		}
+		m_push_subscriptions.SendDeleteServer(server);
 	}
 	void Driver::SendNewServer(MM::Server *server) {
-		std::vector<Peer *>::iterator it = m_connections.begin();
-		while (it != m_connections.end()) {
-			Peer *p = *it;
-			p->informNewServers(server);
-			it++;
-		}
+		m_push_subscriptions.SendNewServer(server);
 	}
 	void Driver::SendUpdateServer(MM::Server *server) {
-		std::vector<Peer *>::iterator it = m_connections.begin();
-		while (it != m_connections.end()) {
-			Peer *p = *it;
-			p->informUpdateServers(server);
-			it++;
-		}
+		m_push_subscriptions.SendUpdateServer(server);
 	}
 	void Driver::AddDeleteServer(MM::Server serv) {
 		mp_mutex->lock();
 		m_server_delete_queue.push(serv);
+		m_server->GetTimerWheel()->Schedule(&m_push_timer, 0, true);
 		mp_mutex->unlock();
 	}
 	void Driver::AddNewServer(MM::Server serv) {
 		mp_mutex->lock();
 		m_server_new_queue.push(serv);
+		m_server->GetTimerWheel()->Schedule(&m_push_timer, 0, true);
 		mp_mutex->unlock();
 	}
 	void Driver::AddUpdateServer(MM::Server serv) {
 		mp_mutex->lock();
 		m_server_update_queue.push(serv);
+		m_server->GetTimerWheel()->Schedule(&m_push_timer, 0, true);
 		mp_mutex->unlock();
 	}
 	const std::vector<INetPeer *> Driver::getPeers(bool inc_ref) {
@@ -253,45 +265,6 @@ namespace SB {
 		return peers;
 	}
 
-
-	//m_stats_queue
-	OS::MetricInstance Driver::GetMetrics() {
-		OS::MetricInstance peer_metric;
-		OS::MetricValue arr_value2, value, peers;
-
-		mp_mutex->lock();
-
-		std::vector<Peer *>::iterator it = m_connections.begin();
-		while (it != m_connections.end()) {
-			INetPeer * peer = (INetPeer *)*it;
-			OS::Address address = *peer->getAddress();
-			value = peer->GetMetrics().value;
-
-			value.key = address.ToString(false);
-
-			peers.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, value));			
-			it++;
-		}
-
-		while(!m_stats_queue.empty()) {
-			PeerStats stats = m_stats_queue.front();
-			m_stats_queue.pop();
-			peers.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, Peer::GetMetricItemFromStats(stats)));
-		}
-
-		peers.key = "peers";
-		arr_value2.type = OS::MetricType_Array;
-		peers.type = OS::MetricType_Array;
-		arr_value2.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, peers));
-	
-
-		peer_metric.key = OS::Address(m_local_addr).ToString(false);
-		arr_value2.key = peer_metric.key;
-		peer_metric.value = arr_value2;
-		
-		mp_mutex->unlock();
-		return peer_metric;
-	}
 	void Driver::debug_dump() {
 		printf("Driver: %p\n", this);
 		printf("Peers: \n");
@@ -8,6 +8,7 @@
 #include "V2Peer.h"
 #include "V1Peer.h"
 #include "MMQuery.h"
+#include "PushSubscriptionIndex.h"
 
 #include <map>
 #include <queue>
@@ -18,7 +19,8 @@
 #endif
 
 #define SB_PING_TIME 30
-#define DRIVER_THREAD_TIME 1000
+#define DRIVER_REAP_TIME 100 //how often deleted peers which are still referenced are checked on
+#define DRIVER_CLOSE_TIMEOUT 30 //seconds a deleted peer's socket stays registered for its send queue to drain
 
 namespace SB {
 	class Peer;
@@ -48,11 +50,15 @@ namespace SB {
 		void AddNewServer(MM::Server serv);
 		void AddUpdateServer(MM::Server serv);
 
-		OS::MetricInstance GetMetrics();
+		PushSubscriptionIndex *GetPushSubscriptions() { return &m_push_subscriptions; };
+
 		void debug_dump();
+
+		void OnPeerThink(INetPeer *peer);
 	private:
-		static void *TaskThread(OS::CThread *thread);
-		void TickConnections();
+		static void OnReapTimer(void *extra);
+		static void OnPushTimer(void *extra);
+		void DeletePeer(Peer *peer);
 
 		int m_sd;
 		int m_version;
@@ -65,16 +71,28 @@ namespace SB {
 
 		int m_sb_version;
 
-		std::vector<SB::Peer *> m_peers_to_delete;
+		/*
+			Deleted peers stay registered until their send queue has drained, so the end of a list still reaches a slow client,
+			or until DRIVER_CLOSE_TIMEOUT has passed. They're freed once unregistered and no longer referenced.
+		*/
+		typedef struct {
+			SB::Peer *peer;
+			time_t close_time;
+			bool registered;
+		} DeletedPeer;
+		std::vector<DeletedPeer> m_peers_to_delete;
 
 		//safe for now, until pointers one day get added
 		std::queue<MM::Server> m_server_delete_queue;
 		std::queue<MM::Server> m_server_new_queue;
 		std::queue<MM::Server> m_server_update_queue;
-		std::queue<PeerStats> m_stats_queue; //pending stats to be sent(deleted clients)
+
+		PushSubscriptionIndex m_push_subscriptions;
+
+		OS::TimerWheelEntry m_reap_timer;
+		OS::TimerWheelEntry m_push_timer; //fans the queued server events out as soon as the event loop comes around
 		
 		OS::CMutex *mp_mutex;
-		OS::CThread *mp_thread;
 
 	};
 
@@ -5,6 +5,8 @@
 #include <OS/legacy/buffwriter.h>
 
 namespace SB {
+	OS::LatencyHistogram g_list_send_span("list_send", "Encoding and queueing a server list response");
+
 	Peer::Peer(Driver *driver, struct sockaddr_in *address_info, int sd, int version) : INetPeer(driver, address_info, sd) {
 		mp_driver = driver;
 		m_address_info = *address_info;
@@ -35,15 +37,10 @@ namespace SB {
 		delete mp_mutex;
 	}
 
-	bool Peer::serverMatchesLastReq(MM::Server *server, bool require_push_flag) {
-		/*
-		if(require_push_flag && !m_last_list_req.push_updates) {
-			return false;
-		}*/
-		if(server->game.gameid == m_last_list_req.m_for_game.gameid) {
-			return true;
-		}
-		return false;
+	int Peer::GetThinkDelay() {
+		int delay = GetDelayUntil(m_last_ping, SB_PING_TIME);
+		int timeout_delay = GetDelayUntil(m_last_recv, SB_PING_TIME * 2);
+		return delay < timeout_delay ? delay : timeout_delay;
 	}
 	sServerCache Peer::FindServerByIP(OS::Address address) {
 		sServerCache ret;
@@ -142,53 +139,6 @@ namespace SB {
 		}
 	}
 
-	OS::MetricValue Peer::GetMetricItemFromStats(PeerStats stats) {
-		OS::MetricValue arr_value, value;
-		value.value._str = stats.m_address.ToString(false);
-		value.key = "ip";
-		value.type = OS::MetricType_String;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.disconnected;
-		value.key = "disconnected";
-		value.type = OS::MetricType_Integer;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));		
-
-		value.type = OS::MetricType_Integer;
-		value.value._int = stats.bytes_in;
-		value.key = "bytes_in";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.bytes_out;
-		value.key = "bytes_out";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.packets_in;
-		value.key = "packets_in";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.packets_out;
-		value.key = "packets_out";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.value._int = stats.total_requests;
-		value.key = "pending_requests";
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-		arr_value.type = OS::MetricType_Array;
-			
-		value.type = OS::MetricType_String;	
-		value.key = "gamename";
-		value.value._str = stats.from_game.gamename;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		value.type = OS::MetricType_Integer;	
-		value.key = "version";
-		value.value._int = stats.version;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_String, value));
-
-		arr_value.key = stats.m_address.ToString(false);
-		return arr_value;
-	}
 	void Peer::ResetMetrics() {
 		m_peer_stats.bytes_in = 0;
 		m_peer_stats.bytes_out = 0;
@@ -196,14 +146,4 @@ namespace SB {
 		m_peer_stats.packets_out = 0;
 		m_peer_stats.total_requests = 0;
 	}
-	OS::MetricInstance Peer::GetMetrics() {
-		OS::MetricInstance peer_metric;
-
-		peer_metric.value = GetMetricItemFromStats(m_peer_stats);
-		peer_metric.key = "peer";
-
-		ResetMetrics();
-
-		return peer_metric;
-	}
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define _SBPEER_H
 #include "../main.h"
 #include <OS/Net/NetPeer.h>
+#include <OS/Buffer.h>
 
 #include "MMQuery.h"
 
@@ -52,12 +53,15 @@ namespace SB {
 
 		bool ShouldDelete() { return m_delete_flag; };
 		bool IsTimeout() { return m_timeout_flag; }
+		int GetThinkDelay();
 		
-		bool serverMatchesLastReq(MM::Server *server, bool require_push_flag = true);
-
+		/*
+			Called by the push subscription index, for servers which matched the filter of the peer's last list request.
+			push_message is the serialized server, shared by every peer the event goes to.
+		*/
 		virtual void informDeleteServers(MM::Server *server) = 0;
-		virtual void informNewServers(MM::Server *server) = 0;
-		virtual void informUpdateServers(MM::Server *server) = 0;
+		virtual void informNewServers(MM::Server *server, OS::Buffer &push_message) = 0;
+		virtual void informUpdateServers(MM::Server *server, OS::Buffer &push_message) = 0;
 
 		virtual void OnRetrievedServers(const struct MM::_MMQueryRequest request, struct MM::ServerListQuery results, void *extra) = 0;
 		virtual void OnRetrievedServerInfo(const struct MM::_MMQueryRequest request, struct MM::ServerListQuery results, void *extra) = 0;
@@ -65,9 +69,6 @@ namespace SB {
 		virtual void OnRecievedGameInfo(const OS::GameData game_data, void *extra) = 0;
 		virtual void OnRecievedGameInfoPair(const OS::GameData game_data_first, const OS::GameData game_data_second, void *extra) = 0;
 
-		static OS::MetricValue GetMetricItemFromStats(PeerStats stats);
-		OS::MetricInstance GetMetrics();
-		PeerStats GetPeerStats() { if(m_delete_flag) m_peer_stats.disconnected = true; return m_peer_stats; };
 	protected:
 		void cacheServer(MM::Server *server, bool full_keys = false);
 		void DeleteServerFromCacheByIP(OS::Address address);
@@ -105,5 +106,6 @@ namespace SB {
 
 
 	};
+	extern OS::LatencyHistogram g_list_send_span;
 }
 #endif //_SAMPRAKPEER_H
\ No newline at end of file
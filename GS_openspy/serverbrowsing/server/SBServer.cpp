@@ -2,9 +2,10 @@
 #include "SBServer.h"
 #include "SBDriver.h"
 #include <OS/OpenSpy.h>
+#include "ServerListCache.h"
 
 SBServer::SBServer() : INetServer() {
-	gettimeofday(&m_last_analytics_submit_time, NULL);
+	gettimeofday(&m_last_cache_reconcile_time, NULL);
 }
 SBServer::~SBServer() {
 }
@@ -14,9 +15,9 @@ void SBServer::init() {
 void SBServer::tick() {
 	struct timeval current_time;
 	gettimeofday(&current_time, NULL);
-	if(current_time.tv_sec - m_last_analytics_submit_time.tv_sec > ANALYTICS_SUBMIT_TIME) {
-		OS::AnalyticsManager::getSingleton()->SubmitServer(this);
-		gettimeofday(&m_last_analytics_submit_time, NULL);
+	if(current_time.tv_sec - m_last_cache_reconcile_time.tv_sec > SERVER_CACHE_RECONCILE_CHECK_TIME) {
+		MM::QueueServerCacheReconcile();
+		gettimeofday(&m_last_cache_reconcile_time, NULL);
 	}
 
 	std::vector<INetDriver *>::iterator it = m_net_drivers.begin();
@@ -44,27 +45,6 @@ void SBServer::SetTaskPool(OS::TaskPool<MM::MMQueryTask, MM::MMQueryRequest> *po
 		it++;
 	}
 }
-OS::MetricInstance SBServer::GetMetrics() {
-	OS::MetricInstance peer_metric;
-	OS::MetricValue value, arr_value, arr_value2, container_val;
-	
-	std::vector<INetDriver *>::iterator it2 = m_net_drivers.begin();
-	int idx = 0;
-	while (it2 != m_net_drivers.end()) {
-		SB::Driver *driver = (SB::Driver *)*it2;
-		arr_value2 = driver->GetMetrics().value;
-		it2++;
-		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, arr_value2));
-	}
-
-	arr_value.type = OS::MetricType_Array;
-	arr_value.key = std::string(OS::g_hostName) + std::string(":") + std::string(OS::g_appName);
-
-	container_val.type = OS::MetricType_Array;
-	container_val.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Array, arr_value));
-	peer_metric.value = container_val;
-	return peer_metric;
-}
 
 void SBServer::debug_dump() {
 	std::vector<INetDriver *>::iterator it2 = m_net_drivers.begin();
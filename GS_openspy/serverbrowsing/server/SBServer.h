@@ -5,7 +5,8 @@
 #include <OS/TaskPool.h>
 #include "MMQuery.h"
 
-#include <OS/Analytics/AnalyticsMgr.h>
+
+#define SERVER_CACHE_RECONCILE_CHECK_TIME 5
 class SBServer : public INetServer {
 public:
 	SBServer();
@@ -14,11 +15,10 @@ public:
 	void tick();
 	void shutdown();
 	void SetTaskPool(OS::TaskPool<MM::MMQueryTask, MM::MMQueryRequest> *pool);
-	OS::MetricInstance GetMetrics();
 
 	void debug_dump();
 private:
-	struct timeval m_last_analytics_submit_time;	
+	struct timeval m_last_cache_reconcile_time;
 	OS::TaskPool<MM::MMQueryTask, MM::MMQueryRequest> *mp_task_pool;
 };
 #endif //_CHCGAMESERVER_H
\ No newline at end of file
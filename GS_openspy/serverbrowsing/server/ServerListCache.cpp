@@ -0,0 +1,509 @@
+#include "ServerListCache.h"
+#include <serverbrowsing/filter/CompiledFilter.h>
+#include <algorithm>
+
+namespace MM {
+	ServerListCache *mp_server_list_cache = NULL;
+
+	ServerListCache::GameEntry::GameEntry() {
+		memory_usage = 0;
+		last_loaded = 0;
+		last_used = 0;
+		loaded = false;
+		loading = false;
+		mp_mutex = OS::CreateMutex();
+		mp_load_mutex = OS::CreateMutex();
+	}
+	ServerListCache::GameEntry::~GameEntry() {
+		delete mp_mutex;
+		delete mp_load_mutex;
+	}
+	ServerListCache::ServerListCache() {
+		mp_mutex = OS::CreateMutex();
+		m_num_hits = 0;
+		m_num_misses = 0;
+		m_num_updates = 0;
+		m_num_reconciles = 0;
+	}
+	ServerListCache::~ServerListCache() {
+		delete mp_mutex;
+	}
+	std::string ServerListCache::GameNameFromKey(std::string key) {
+		//server keys are gamename:groupid:id:
+		size_t pos = key.find(':');
+		if (pos == std::string::npos) {
+			return key;
+		}
+		return key.substr(0, pos);
+	}
+	size_t ServerListCache::EstimateSize(const Server &server) {
+		const size_t node_overhead = 64; //map node and string headers
+		size_t size = sizeof(Server) + server.key.length() + node_overhead;
+		std::map<std::string, std::string>::const_iterator it = server.kvFields.begin();
+		while (it != server.kvFields.end()) {
+			size += it->first.length() + it->second.length() + node_overhead;
+			it++;
+		}
+		std::map<int, std::map<std::string, std::string> >::const_iterator it2 = server.kvPlayers.begin();
+		while (it2 != server.kvPlayers.end()) {
+			size += node_overhead;
+			it = it2->second.begin();
+			while (it != it2->second.end()) {
+				size += it->first.length() + it->second.length() + node_overhead;
+				it++;
+			}
+			it2++;
+		}
+		it2 = server.kvTeams.begin();
+		while (it2 != server.kvTeams.end()) {
+			size += node_overhead;
+			it = it2->second.begin();
+			while (it != it2->second.end()) {
+				size += it->first.length() + it->second.length() + node_overhead;
+				it++;
+			}
+			it2++;
+		}
+		return size;
+	}
+	std::shared_ptr<ServerListCache::GameEntry> ServerListCache::FindGame(std::string gamename) {
+		std::shared_ptr<GameEntry> ret;
+		mp_mutex->lock();
+		std::map<std::string, std::shared_ptr<GameEntry> >::iterator it = m_games.find(gamename);
+		if (it != m_games.end()) {
+			ret = it->second;
+		}
+		mp_mutex->unlock();
+		return ret;
+	}
+	void ServerListCache::AddServer(GameEntry &entry, std::shared_ptr<const Server> server) {
+		std::map<std::string, CachedServer>::iterator existing = entry.servers.find(server->key);
+		if (existing != entry.servers.end()) {
+			EraseServer(entry, existing);
+		}
+		CachedServer &cached = entry.servers[server->key];
+		cached.server = server;
+		if (!entry.free_rows.empty()) {
+			cached.row = entry.free_rows.back();
+			entry.free_rows.pop_back();
+			entry.rows[cached.row] = &cached;
+		}
+		else {
+			cached.row = entry.rows.size();
+			entry.rows.push_back(&cached);
+		}
+		std::map<std::string, FilterColumn>::iterator it = entry.columns.begin();
+		while (it != entry.columns.end()) {
+			BindRow(entry, it->second, it->first, cached.row);
+			it++;
+		}
+		entry.memory_usage += EstimateSize(*server);
+	}
+	void ServerListCache::EraseServer(GameEntry &entry, std::map<std::string, CachedServer>::iterator it) {
+		int row = it->second.row;
+		entry.memory_usage -= EstimateSize(*it->second.server);
+		entry.servers.erase(it);
+
+		//don't leave the columns pointing into the erased server
+		entry.rows[row] = NULL;
+		entry.free_rows.push_back(row);
+		std::map<std::string, FilterColumn>::iterator col_it = entry.columns.begin();
+		while (col_it != entry.columns.end()) {
+			BindRow(entry, col_it->second, col_it->first, row);
+			col_it++;
+		}
+	}
+	void ServerListCache::ApplyUpdate(GameEntry &entry, const PendingUpdate &update) {
+		if (update.server) {
+			AddServer(entry, update.server);
+			return;
+		}
+		std::map<std::string, CachedServer>::iterator it = entry.servers.find(update.key);
+		if (it != entry.servers.end()) {
+			EraseServer(entry, it);
+		}
+	}
+	void ServerListCache::ClearGame(GameEntry &entry) {
+		entry.servers.clear();
+		entry.rows.clear();
+		entry.free_rows.clear();
+		entry.columns.clear();
+		entry.memory_usage = 0;
+	}
+	void ServerListCache::BindRow(GameEntry &entry, FilterColumn &column, const std::string &name, int row) {
+		FilterValue value;
+		value.type = EToken_String;
+		value.ival = 0;
+		value.sval = "";
+		value.slen = 0;
+		CachedServer *cached = entry.rows[row];
+		if (cached) {
+			std::map<std::string, std::string>::const_iterator it = cached->server->kvFields.find(name);
+			if (it != cached->server->kvFields.end()) {
+				value = CompiledFilter::BindValue(it->second);
+			}
+		}
+		SetFilterColumnValue(column, row, value);
+	}
+	FilterColumn *ServerListCache::GetColumn(GameEntry &entry, const std::string &name) {
+		std::map<std::string, FilterColumn>::iterator it = entry.columns.find(name);
+		if (it != entry.columns.end()) {
+			return &it->second;
+		}
+		if (entry.columns.size() >= MM_SERVER_CACHE_MAX_COLUMNS) {
+			entry.columns.clear();
+		}
+		FilterColumn &column = entry.columns[name];
+		for (size_t i = 0; i < entry.rows.size(); i++) {
+			BindRow(entry, column, name, i);
+		}
+		return &column;
+	}
+	bool ServerListCache::WaitForGame(OS::GameData game) {
+		std::shared_ptr<GameEntry> entry = FindGame(game.gamename);
+		if (!entry) {
+			//the load lock is taken before the game is visible, so anyone who finds it waits until LoadGame or LoadGameFailed
+			std::shared_ptr<GameEntry> new_entry(new GameEntry());
+			new_entry->game = game;
+			new_entry->last_used = time(NULL);
+			new_entry->loading = true;
+			new_entry->mp_load_mutex->lock();
+
+			mp_mutex->lock();
+			std::map<std::string, std::shared_ptr<GameEntry> >::iterator it = m_games.find(game.gamename);
+			if (it == m_games.end()) {
+				m_games[game.gamename] = new_entry;
+				mp_mutex->unlock();
+				return true;
+			}
+			entry = it->second;
+			mp_mutex->unlock();
+			new_entry->mp_load_mutex->unlock();
+		}
+
+		entry->mp_mutex->lock();
+		bool loaded = entry->loaded;
+		entry->mp_mutex->unlock();
+		if (!loaded) {
+			entry->mp_load_mutex->lock();
+			entry->mp_load_mutex->unlock();
+		}
+		return false;
+	}
+	bool ServerListCache::GetServers(const sServerListReq *req, ServerListQuery *ret) {
+		CompiledFilter filter = FilterCache::getSingleton()->Get(req->filter.c_str());
+		std::shared_ptr<GameEntry> entry_ref = FindGame(req->m_for_game.gamename);
+		mp_mutex->lock();
+		if (entry_ref) {
+			m_num_hits++;
+		}
+		else {
+			m_num_misses++;
+		}
+		mp_mutex->unlock();
+		if (!entry_ref) {
+			return false;
+		}
+
+		GameEntry &entry = *entry_ref;
+		std::vector<std::shared_ptr<const Server> > matched;
+		entry.mp_mutex->lock();
+		if (!entry.loaded) {
+			entry.mp_mutex->unlock();
+			return false;
+		}
+		entry.last_used = time(NULL);
+
+		std::vector<uint32_t> matches;
+		uint64_t filter_start = OS::GetMonotonicTimeUS();
+		const std::vector<std::string> &variables = filter.GetVariables();
+		if (variables.size() <= MM_SERVER_CACHE_MAX_COLUMNS) {
+			//creating a column can drop the others, so only take pointers once all of them exist
+			std::vector<std::string>::const_iterator var_it = variables.begin();
+			while (var_it != variables.end()) {
+				GetColumn(entry, *var_it);
+				var_it++;
+			}
+			std::vector<const FilterColumn *> columns;
+			var_it = variables.begin();
+			while (var_it != variables.end()) {
+				columns.push_back(GetColumn(entry, *var_it));
+				var_it++;
+			}
+			filter.EvaluateColumns(columns.empty() ? NULL : &columns[0], entry.rows.size(), matches);
+		}
+		else {
+			matches.assign((entry.rows.size() + 31) / 32, 0);
+			for (size_t row = 0; row < entry.rows.size(); row++) {
+				if (entry.rows[row] && filter.Matches(entry.rows[row]->server->kvFields)) {
+					matches[row / 32] |= 1u << (row % 32);
+				}
+			}
+		}
+		g_filter_eval_span.Record(OS::GetMonotonicTimeUS() - filter_start);
+
+		for (size_t row = 0; row < entry.rows.size(); row++) {
+			if (entry.rows[row] == NULL || !(matches[row / 32] & (1u << (row % 32)))) {
+				continue;
+			}
+			if (req->max_results != 0 && matched.size() >= req->max_results) {
+				break;
+			}
+			matched.push_back(entry.rows[row]->server);
+		}
+		entry.mp_mutex->unlock();
+
+		//the matched servers are kept alive by their references, updates replace them rather than changing them
+		std::vector<std::shared_ptr<const Server> >::iterator match_it = matched.begin();
+		while (match_it != matched.end()) {
+			const Server &cached = **match_it;
+			match_it++;
+
+			Server *server = new MM::Server();
+			server->key = cached.key;
+			server->id = cached.id;
+			server->wan_address = cached.wan_address;
+			server->lan_address = cached.lan_address;
+			server->region = cached.region;
+			server->game = req->m_for_game;
+
+			std::map<std::string, std::string>::const_iterator kv_it = cached.kvFields.begin();
+			while (kv_it != cached.kvFields.end()) {
+				if (std::find(ret->captured_basic_fields.begin(), ret->captured_basic_fields.end(), kv_it->first) == ret->captured_basic_fields.end()) {
+					ret->captured_basic_fields.push_back(kv_it->first);
+				}
+				//add only keys which were requested
+				if (req->all_keys || std::find(ret->requested_fields.begin(), ret->requested_fields.end(), kv_it->first) != ret->requested_fields.end()) {
+					server->kvFields[kv_it->first] = kv_it->second;
+				}
+				kv_it++;
+			}
+
+			if (req->all_keys) {
+				server->kvPlayers = cached.kvPlayers;
+				server->kvTeams = cached.kvTeams;
+				std::map<int, std::map<std::string, std::string> >::const_iterator it2 = cached.kvPlayers.begin();
+				while (it2 != cached.kvPlayers.end()) {
+					kv_it = it2->second.begin();
+					while (kv_it != it2->second.end()) {
+						if (std::find(ret->captured_player_fields.begin(), ret->captured_player_fields.end(), kv_it->first) == ret->captured_player_fields.end()) {
+							ret->captured_player_fields.push_back(kv_it->first);
+						}
+						kv_it++;
+					}
+					it2++;
+				}
+				it2 = cached.kvTeams.begin();
+				while (it2 != cached.kvTeams.end()) {
+					kv_it = it2->second.begin();
+					while (kv_it != it2->second.end()) {
+						if (std::find(ret->captured_team_fields.begin(), ret->captured_team_fields.end(), kv_it->first) == ret->captured_team_fields.end()) {
+							ret->captured_team_fields.push_back(kv_it->first);
+						}
+						kv_it++;
+					}
+					it2++;
+				}
+			}
+			ret->list.push_back(server);
+		}
+		return true;
+	}
+	void ServerListCache::LoadGame(OS::GameData game, std::vector<Server *> servers, bool first_load) {
+		std::shared_ptr<GameEntry> entry_ref = FindGame(game.gamename);
+		if (!entry_ref) {
+			//dropped as idle while it was reconciled
+			return;
+		}
+		GameEntry &entry = *entry_ref;
+		entry.mp_mutex->lock();
+		if (!first_load && !entry.loaded) {
+			//dropped and listed again while it was reconciled, the new entry has its own loader
+			entry.mp_mutex->unlock();
+			return;
+		}
+		ClearGame(entry);
+
+		entry.game = game;
+		entry.last_loaded = time(NULL);
+
+		std::vector<Server *>::iterator it2 = servers.begin();
+		while (it2 != servers.end()) {
+			AddServer(entry, std::shared_ptr<const Server>(new Server(**it2)));
+			it2++;
+		}
+
+		//the scan can predate any of these, so they're applied over it in the order they arrived
+		std::vector<PendingUpdate>::iterator it = entry.pending_updates.begin();
+		while (it != entry.pending_updates.end()) {
+			ApplyUpdate(entry, *it);
+			it++;
+		}
+		entry.pending_updates.clear();
+
+		entry.loaded = true;
+		entry.loading = false;
+		entry.mp_mutex->unlock();
+		if (first_load) {
+			entry.mp_load_mutex->unlock();
+		}
+
+		mp_mutex->lock();
+		m_num_reconciles++;
+		mp_mutex->unlock();
+	}
+	void ServerListCache::LoadGameFailed(OS::GameData game, bool first_load) {
+		std::shared_ptr<GameEntry> entry_ref = FindGame(game.gamename);
+		if (!entry_ref) {
+			return;
+		}
+		GameEntry &entry = *entry_ref;
+		entry.mp_mutex->lock();
+		if (!first_load && !entry.loaded) {
+			entry.mp_mutex->unlock();
+			return;
+		}
+		entry.loading = false;
+		entry.pending_updates.clear();
+		entry.mp_mutex->unlock();
+
+		if (first_load) {
+			//nothing to serve, the next list request tries again
+			mp_mutex->lock();
+			std::map<std::string, std::shared_ptr<GameEntry> >::iterator it = m_games.find(game.gamename);
+			if (it != m_games.end() && it->second == entry_ref) {
+				m_games.erase(it);
+			}
+			mp_mutex->unlock();
+			entry.mp_load_mutex->unlock();
+		}
+	}
+	void ServerListCache::UpdateServer(Server server) {
+		PendingUpdate update;
+		update.key = server.key;
+		update.server = std::shared_ptr<const Server>(new Server(server));
+
+		std::shared_ptr<GameEntry> entry_ref = FindGame(GameNameFromKey(server.key));
+		if (!entry_ref) {
+			return;
+		}
+		entry_ref->mp_mutex->lock();
+		ApplyUpdate(*entry_ref, update);
+		if (entry_ref->loading) {
+			entry_ref->pending_updates.push_back(update);
+		}
+		entry_ref->mp_mutex->unlock();
+
+		mp_mutex->lock();
+		m_num_updates++;
+		mp_mutex->unlock();
+	}
+	void ServerListCache::RemoveServer(std::string key) {
+		PendingUpdate update;
+		update.key = key;
+
+		std::shared_ptr<GameEntry> entry_ref = FindGame(GameNameFromKey(key));
+		if (!entry_ref) {
+			return;
+		}
+		entry_ref->mp_mutex->lock();
+		ApplyUpdate(*entry_ref, update);
+		if (entry_ref->loading) {
+			entry_ref->pending_updates.push_back(update);
+		}
+		entry_ref->mp_mutex->unlock();
+
+		mp_mutex->lock();
+		m_num_updates++;
+		mp_mutex->unlock();
+	}
+	std::vector<OS::GameData> ServerListCache::GetGamesToReconcile() {
+		std::vector<OS::GameData> ret;
+		time_t now = time(NULL);
+		mp_mutex->lock();
+		std::map<std::string, std::shared_ptr<GameEntry> >::iterator it = m_games.begin();
+		while (it != m_games.end()) {
+			GameEntry &entry = *it->second;
+			entry.mp_mutex->lock();
+			//a game being loaded has a thread waiting on it
+			if (!entry.loading && now - entry.last_used > MM_SERVER_CACHE_IDLE_TIME) {
+				entry.mp_mutex->unlock();
+				m_games.erase(it++);
+				continue;
+			}
+			if (!entry.loading && now - entry.last_loaded > MM_SERVER_CACHE_RECONCILE_TIME) {
+				entry.loading = true;
+				ret.push_back(entry.game);
+			}
+			entry.mp_mutex->unlock();
+			it++;
+		}
+		mp_mutex->unlock();
+		return ret;
+	}
+	OS::MetricValue ServerListCache::GetMetrics() {
+		OS::MetricValue arr_value, value;
+		mp_mutex->lock();
+
+		value.type = OS::MetricType_Integer;
+		value.value._int = m_games.size();
+		value.key = "games";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		//rows and filter columns are small enough to just count here
+		size_t num_servers = 0, memory_usage = 0;
+		std::map<std::string, std::shared_ptr<GameEntry> >::iterator it = m_games.begin();
+		while (it != m_games.end()) {
+			GameEntry &entry = *it->second;
+			entry.mp_mutex->lock();
+			size_t row_size = sizeof(CachedServer *) + entry.columns.size() * (sizeof(ETokenType) + sizeof(int) + sizeof(const char *) + sizeof(int));
+			memory_usage += entry.memory_usage + entry.rows.size() * row_size;
+			num_servers += entry.servers.size();
+			entry.mp_mutex->unlock();
+			it++;
+		}
+		value.value._int = num_servers;
+		value.key = "servers";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = memory_usage;
+		value.key = "memory_bytes";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = m_num_hits;
+		value.key = "hits";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = m_num_misses;
+		value.key = "misses";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = m_num_updates;
+		value.key = "updates";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		value.value._int = m_num_reconciles;
+		value.key = "reconciles";
+		arr_value.arr_value.values.push_back(std::pair<OS::MetricType, struct OS::_Value>(OS::MetricType_Integer, value));
+
+		mp_mutex->unlock();
+
+		arr_value.key = "server_cache";
+		arr_value.type = OS::MetricType_Array;
+		return arr_value;
+	}
+	void QueueServerCacheReconcile() {
+		std::vector<OS::GameData> games = mp_server_list_cache->GetGamesToReconcile();
+		std::vector<OS::GameData>::iterator it = games.begin();
+		while (it != games.end()) {
+			MMQueryRequest req;
+			req.type = EMMQueryRequestType_ReconcileServerCache;
+			req.req.m_for_game = *it;
+			req.peer = NULL;
+			req.driver = NULL;
+			req.extra = NULL;
+			m_task_pool->AddRequest(req);
+			it++;
+		}
+	}
+}
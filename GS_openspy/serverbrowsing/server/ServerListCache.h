@@ -0,0 +1,109 @@
+#ifndef _MM_SERVERLISTCACHE_H
+#define _MM_SERVERLISTCACHE_H
+#include "MMQuery.h"
+#include <OS/Analytics/Metric.h>
+#include <serverbrowsing/filter/CompiledFilter.h>
+#include <memory>
+
+#define MM_SERVER_CACHE_RECONCILE_TIME 60 //seconds between full reloads of a cached game
+#define MM_SERVER_CACHE_IDLE_TIME 900 //games which haven't been listed for this long are dropped
+#define MM_SERVER_CACHE_MAX_COLUMNS 32 //filter columns kept per game before they're all dropped and rebuilt on demand
+
+namespace MM {
+	/*
+		In memory copy of the live servers of every game which has recently been listed.
+		A game is loaded in full from redis on its first list request, then kept current by the new/update/del
+		events on the serverbrowsing channel, and reloaded every MM_SERVER_CACHE_RECONCILE_TIME to catch anything missed.
+
+		Each server of a game owns a row, and every key used in a filter gets a column of bound values built on first use,
+		so a list request evaluates its filter over whole columns rather than looking up keys server by server.
+
+		The cache wide lock only guards the game map, each game has its own lock. Cached servers are never modified,
+		an update replaces them, so a list request copies the servers it matched after letting go of the game's lock.
+	*/
+	class ServerListCache {
+	public:
+		ServerListCache();
+		~ServerListCache();
+
+		/*
+			Appends copies of the matching servers to ret, returns false if the game isn't loaded
+		*/
+		bool GetServers(const sServerListReq *req, ServerListQuery *ret);
+		/*
+			Waits for the first load of the game if another thread is running it.
+			Returns true if the game isn't cached yet, the caller is then its loader and must call LoadGame or LoadGameFailed,
+			other threads wait for it instead of loading the game again.
+		*/
+		bool WaitForGame(OS::GameData game);
+
+		/*
+			Replaces everything known about the game, then replays the updates received since the load was started.
+			first_load is set by the thread WaitForGame returned true to, otherwise this is a reconcile
+		*/
+		void LoadGame(OS::GameData game, std::vector<Server *> servers, bool first_load);
+		//keeps the game's current entry, and lets the next GetGamesToReconcile retry it. a failed first load drops the game
+		void LoadGameFailed(OS::GameData game, bool first_load);
+		//ignored if the server's game isn't loaded
+		void UpdateServer(Server server);
+		void RemoveServer(std::string key);
+
+		/*
+			Drops idle games, and returns the games due for a reconcile pass. Their updates are buffered until it's done
+		*/
+		std::vector<OS::GameData> GetGamesToReconcile();
+
+		OS::MetricValue GetMetrics();
+	private:
+		typedef struct {
+			std::shared_ptr<const Server> server;
+			int row;
+		} CachedServer;
+		typedef struct {
+			std::string key;
+			std::shared_ptr<const Server> server; //NULL if the server was removed
+		} PendingUpdate;
+		struct GameEntry {
+			GameEntry();
+			~GameEntry();
+
+			OS::GameData game;
+			std::map<std::string, CachedServer> servers;
+			//row N of each column belongs to rows[N], NULL rows are free
+			std::vector<CachedServer *> rows;
+			std::vector<int> free_rows;
+			std::map<std::string, FilterColumn> columns;
+			size_t memory_usage;
+			time_t last_loaded;
+			time_t last_used;
+			bool loaded; //false until the first load finishes
+			bool loading; //a load is queued or running, updates are also kept in pending_updates to be replayed over it
+			std::vector<PendingUpdate> pending_updates;
+			OS::CMutex *mp_mutex;
+			OS::CMutex *mp_load_mutex; //held by the thread running the first load
+		};
+
+		static std::string GameNameFromKey(std::string key);
+		static size_t EstimateSize(const Server &server);
+		std::shared_ptr<GameEntry> FindGame(std::string gamename);
+		//replaces the server if it's already cached
+		static void AddServer(GameEntry &entry, std::shared_ptr<const Server> server);
+		static void EraseServer(GameEntry &entry, std::map<std::string, CachedServer>::iterator it);
+		static void ApplyUpdate(GameEntry &entry, const PendingUpdate &update);
+		static void ClearGame(GameEntry &entry);
+		static void BindRow(GameEntry &entry, FilterColumn &column, const std::string &name, int row);
+		static FilterColumn *GetColumn(GameEntry &entry, const std::string &name);
+
+		std::map<std::string, std::shared_ptr<GameEntry> > m_games;
+		OS::CMutex *mp_mutex;
+
+		uint64_t m_num_hits;
+		uint64_t m_num_misses;
+		uint64_t m_num_updates;
+		uint64_t m_num_reconciles;
+	};
+
+	extern ServerListCache *mp_server_list_cache;
+	void QueueServerCacheReconcile();
+}
+#endif //_MM_SERVERLISTCACHE_H
@@ -104,10 +104,10 @@ namespace SB {
 		void V1Peer::informDeleteServers(MM::Server *server) {
 
 		}
-		void V1Peer::informNewServers(MM::Server *server) {
+		void V1Peer::informNewServers(MM::Server *server, OS::Buffer &push_message) {
 
 		}
-		void V1Peer::informUpdateServers(MM::Server *server) {
+		void V1Peer::informUpdateServers(MM::Server *server, OS::Buffer &push_message) {
 
 		}
 		void V1Peer::send_error(bool disconnect, const char *fmt, ...) {
@@ -157,30 +157,36 @@ namespace SB {
 				m_waiting_packets.push(std::string(data));
 				return;
 			}
-			OS::KVReader kv_parser = OS::KVReader(std::string(data));
+			OS::KVReader kv_parser(data, strlen(data));
 
 			if (kv_parser.Size() < 1) {
 				m_delete_flag = true;
 				return;
 			}
 
-			std::string command;
 			gettimeofday(&m_last_recv, NULL);
 
-			command = kv_parser.GetKeyByIdx(0);
-			if(strcmp(command.c_str(),"gamename") == 0 && !m_validated) {
-				handle_gamename(data, len);
-			}
-			else if (strcmp(command.c_str(), "list") == 0) {
-				handle_list(data, len);
-			}
-			else if (strcmp(command.c_str(), "queryid") == 0) {
-
-			}
-			else {
-				//send_error(true, "Cannot handle request");
-				OS::LogText(OS::ELogLevel_Info, "[%s] Got Unknown request %s", OS::Address(m_address_info).ToString().c_str(), data);
+			switch (kv_parser.GetKeyHashByIdx(0)) {
+				case OS::KVHash("gamename"):
+					if (kv_parser.IsKeyByIdx(0, "gamename") && !m_validated) {
+						handle_gamename(data, len);
+						return;
+					}
+					break;
+				case OS::KVHash("list"):
+					if (kv_parser.IsKeyByIdx(0, "list")) {
+						handle_list(data, len);
+						return;
+					}
+					break;
+				case OS::KVHash("queryid"):
+					if (kv_parser.IsKeyByIdx(0, "queryid")) {
+						return;
+					}
+					break;
 			}
+			//send_error(true, "Cannot handle request");
+			OS::LogText(OS::ELogLevel_Info, "[%s] Got Unknown request %s", OS::Address(m_address_info).ToString().c_str(), data);
 		}
 		void V1Peer::OnRetrievedServerInfo(const struct MM::_MMQueryRequest request, struct MM::ServerListQuery results, void *extra) {
 			SendServerInfo(results);
@@ -199,6 +205,8 @@ namespace SB {
 		void V1Peer::OnRecievedGameInfo(const OS::GameData game_data, void *extra) {
 			int type = (int)extra;
 			m_waiting_gamedata = 2;
+			//the packets held back for the game data are handled on the next think
+			ScheduleThink(0);
 			if (type == 1) {
 				if (game_data.gameid == 0) {
 					send_error(true, "Invalid target gamename");
@@ -371,6 +379,7 @@ namespace SB {
 			SendPacket((const uint8_t *)buffer.GetHead(), buffer.size(), results.last_set);
 		}
 		void V1Peer::SendServers(MM::ServerListQuery results) {
+			OS::Span span(&g_list_send_span);
 			OS::Buffer buffer;
 
 
@@ -382,10 +391,11 @@ namespace SB {
 				buffer.WriteShort(serv->wan_address.port);
 				it++;
 			}
+			SendPacket((const uint8_t *)buffer.GetHead(), buffer.size(), results.last_set);
+			//only once the list is queued, so the driver sees it pending and keeps the socket open until it's sent
 			if (results.last_set) {
 				m_delete_flag = true;
 			}
-			SendPacket((const uint8_t *)buffer.GetHead(), buffer.size(), results.last_set);
 		}
 		void V1Peer::SendPacket(const uint8_t *buff, int len, bool attach_final, bool skip_encryption) {
 			OS::Buffer buffer;
@@ -404,8 +414,7 @@ namespace SB {
 			m_peer_stats.bytes_out += buffer.size();
 			m_peer_stats.packets_out++;
 
-			int c = send(m_sd, (const char *)buffer.GetHead(), buffer.size(), MSG_NOSIGNAL);
-			if(c < 0) {
+			if(!SendData(buffer.GetHead(), buffer.size())) {
 				m_delete_flag = true;
 			}
 		}
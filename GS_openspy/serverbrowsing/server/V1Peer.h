@@ -19,8 +19,8 @@ namespace SB {
 		
 
 		void informDeleteServers(MM::Server *server);
-		void informNewServers(MM::Server *server);
-		void informUpdateServers(MM::Server *server);
+		void informNewServers(MM::Server *server, OS::Buffer &push_message);
+		void informUpdateServers(MM::Server *server, OS::Buffer &push_message);
 	protected:
 
 		void OnRetrievedServers(const struct MM::_MMQueryRequest request, struct MM::ServerListQuery results, void *extra);
@@ -26,8 +26,11 @@ namespace SB {
 		m_got_game_pair = false;
 
 		memset(&m_crypt_state,0,sizeof(m_crypt_state));
+
+		m_send_queue.SetWatermarks(SB_SEND_HIGH_WATERMARK, SB_SEND_LOW_WATERMARK);
 	}
 	V2Peer::~V2Peer() {
+		mp_driver->GetPushSubscriptions()->Unsubscribe(this);
 	}
 	void V2Peer::handle_packet(char *data, int len) {
 		if(len == 0)
@@ -190,10 +193,10 @@ namespace SB {
 	/*		
 		TODO: save this with game data and load it from that
 	*/
-	void V2Peer::WriteOptimizedField(struct MM::ServerListQuery servers, std::string field_name, OS::Buffer &buffer, std::map<std::string, int> &field_types) {
+	void V2Peer::WriteOptimizedField(const struct MM::ServerListQuery &servers, std::string field_name, OS::Buffer &buffer, std::map<std::string, int> &field_types) {
 		
 		uint8_t var = KEYTYPE_STRING;
-		std::vector<MM::Server *>::iterator it = servers.list.begin();
+		std::vector<MM::Server *>::const_iterator it = servers.list.begin();
 		int highest_value = 0;
 		bool is_digit = false;
 		char * pEnd = NULL;
@@ -239,6 +242,7 @@ namespace SB {
 		/*
 		TODO: make support split packets
 		*/
+		OS::Span span(&g_list_send_span);
 		OS::Buffer buffer;
 
 		if (list_req.source_ip != 0) {
@@ -368,13 +372,12 @@ namespace SB {
 
 		m_peer_stats.packets_out++;
 
-		int c = 0;
-		if((c = send(m_sd, (const char *)buffer.GetHead(), buffer.size(), MSG_NOSIGNAL)) < 0) {
-			OS::LogText(OS::ELogLevel_Info, "[%s] Send Exit: %d", OS::Address(m_address_info).ToString().c_str(),c);
+		if(!SendData(buffer.GetHead(), buffer.size())) {
+			OS::LogText(OS::ELogLevel_Info, "[%s] Send Exit, queued: %d", OS::Address(m_address_info).ToString().c_str(), GetSendQueueSize());
 			m_delete_flag = true;
 		}
 		else {
-			m_peer_stats.bytes_out += c;
+			m_peer_stats.bytes_out += buffer.size();
 		}
 	}
 	void V2Peer::ProcessListRequest(OS::Buffer &buffer) {
@@ -404,6 +407,9 @@ namespace SB {
 	}
 	void V2Peer::OnRecievedGameInfoPair(const OS::GameData game_data_first, const OS::GameData game_data_second, void *extra) {
 		m_in_message = false;
+
+		//this request replaces the last one's push subscription, even if it turns out to be invalid
+		mp_driver->GetPushSubscriptions()->Unsubscribe(this);
 			
 		MM::MMQueryRequest req;
 
@@ -427,6 +433,10 @@ namespace SB {
 
 		m_got_game_pair = true;
 
+		if (m_last_list_req.push_updates) {
+			mp_driver->GetPushSubscriptions()->Subscribe(this, m_last_list_req);
+		}
+
 		if (!m_last_list_req.no_server_list) {
 			if (m_last_list_req.send_groups) {
 				req.type = MM::EMMQueryRequestType_GetGroups;
@@ -543,6 +553,24 @@ namespace SB {
 		}
 		cacheServer(server);
 
+		if(push) {
+			buffer->WriteByte(PUSH_SERVER_MESSAGE);
+		}
+
+		if (WriteServerData(server, buffer, usepopularlist, full_keys, optimized_fields, no_keys, m_last_list_req.field_list) && !first_set) {
+			SendPacket((uint8_t *)buffer->GetHead(), buffer->size(), push);
+			buffer->reset();
+		}
+
+		if (!sendBuffer) {
+			delete buffer;
+		}
+	}
+	bool V2Peer::WritePushServerMessage(MM::Server *server, OS::Buffer &buffer) {
+		buffer.WriteByte(PUSH_SERVER_MESSAGE);
+		return WriteServerData(server, &buffer, false, true, NULL, false, std::vector<std::string>());
+	}
+	bool V2Peer::WriteServerData(MM::Server *server, OS::Buffer *buffer, bool usepopularlist, bool full_keys, const std::map<std::string, int> *optimized_fields, bool no_keys, const std::vector<std::string> &field_list) {
 		uint8_t flags = 0;
 		uint32_t private_ip = 0;
 		uint16_t private_port = 0;
@@ -587,14 +615,8 @@ namespace SB {
 			}
 		}
 		
-		if(push) {
-			buffer->WriteByte(PUSH_SERVER_MESSAGE);
-		}
-
-		
-
 		if (server->wan_address.GetIP() == -1) {
-			goto end;
+			return false;
 		}
 
 		buffer->WriteByte(flags); //flags
@@ -612,8 +634,8 @@ namespace SB {
 		}
 
 		if(flags & HAS_KEYS_FLAG) {
-			std::vector<std::string>::iterator tok_it = m_last_list_req.field_list.begin();
-			while (tok_it != m_last_list_req.field_list.end()) {
+			std::vector<std::string>::const_iterator tok_it = field_list.begin();
+			while (tok_it != field_list.end()) {
 				std::vector<std::string>::iterator push_it = server->game.popular_values.end();
 				std::string value;
 				if(server->kvFields.find((*tok_it)) != server->kvFields.end()) {
@@ -714,14 +736,7 @@ namespace SB {
 			}
 		}
 
-		if (!first_set) {
-			SendPacket((uint8_t *)buffer->GetHead(), buffer->size(), push);
-			buffer->reset();
-		}
-		end:
-		if (!sendBuffer) {
-			delete buffer;
-		}
+		return true;
 	}
 	void V2Peer::informDeleteServers(MM::Server *server) {
 		OS::Buffer buffer;
@@ -736,27 +751,18 @@ namespace SB {
 		buffer.WriteShort(server->wan_address.port);
 		SendPacket((uint8_t *)buffer.GetHead(), buffer.size(), true);
 	}
-	void V2Peer::informNewServers(MM::Server *server) {
+	void V2Peer::informNewServers(MM::Server *server, OS::Buffer &push_message) {
 		sServerCache cache = FindServerByKey(server->key);
 		if(cache.key[0] != 0 || !m_last_list_req.push_updates || m_in_message) return;
-		if(server) {
-			if(serverMatchesLastReq(server)) {
-				cacheServer(server);
-				sendServerData(server, false, true, NULL, true, NULL, false, true);
-			}
-		}
+		cacheServer(server);
+		SendPacket((uint8_t *)push_message.GetHead(), push_message.size(), true);
 	}
-	void V2Peer::informUpdateServers(MM::Server *server) {
+	void V2Peer::informUpdateServers(MM::Server *server, OS::Buffer &push_message) {
 		if(!m_last_list_req.push_updates || m_in_message) return;
-		sServerCache cache = FindServerByKey(server->key);
 
 		//client never recieved server notification, add to cache and send anyways, as it will be registered as a new server by the SB SDK
-		if(cache.key[0] == 0 && server && serverMatchesLastReq(server)) {
-			cacheServer(server);
-		}
-		if(server && serverMatchesLastReq(server)) {
-			sendServerData(server, false, true, NULL, true, NULL, false, true);
-		}
+		cacheServer(server);
+		SendPacket((uint8_t *)push_message.GetHead(), push_message.size(), true);
 	}
 
 	void V2Peer::SendPushKeys() {
@@ -776,9 +782,6 @@ namespace SB {
 		if (m_delete_flag) {
 			return;
 		}
-		if(die) {
-			m_delete_flag = true;
-		}
 		va_list args;
 		va_start(args, fmt);
 
@@ -789,7 +792,8 @@ namespace SB {
 
 		m_peer_stats.bytes_out += len+1;
 		m_peer_stats.packets_out++;
-		if (send(m_sd, (const char *)&send_str, len+1, MSG_NOSIGNAL) < 0)
+		//flagged after queueing, so the driver keeps the socket open until the error is sent
+		if (!SendData(&send_str, len+1) || die)
 			m_delete_flag = true;
 
 		OS::LogText(OS::ELogLevel_Info, "[%s] Got Error %s, fatal: %d", OS::Address(m_address_info).ToString().c_str(), send_str, die);
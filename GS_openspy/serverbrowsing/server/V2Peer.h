@@ -39,6 +39,10 @@
 
 #define LIST_CHALLENGE_LEN 8
 
+//full server lists are large, so allow more to queue before reads from the client are held back
+#define SB_SEND_HIGH_WATERMARK 1048576
+#define SB_SEND_LOW_WATERMARK 262144
+
 
 //game server flags
 #define UNSOLICITED_UDP_FLAG	1
@@ -57,10 +61,13 @@ namespace SB {
 				~V2Peer();
 				void think(bool packet_waiting);
 				void informDeleteServers(MM::Server *server);
-				void informNewServers(MM::Server *server);
-				void informUpdateServers(MM::Server *server);
+				void informNewServers(MM::Server *server, OS::Buffer &push_message);
+				void informUpdateServers(MM::Server *server, OS::Buffer &push_message);
 				void OnRecievedGameInfo(const OS::GameData game_data, void *extra);
 				void OnRecievedGameInfoPair(const OS::GameData game_data_first, const OS::GameData game_data_second, void *extra);
+
+				//writes the PUSH_SERVER_MESSAGE sent for new and updated servers, returns false if the server can't be sent
+				static bool WritePushServerMessage(MM::Server *server, OS::Buffer &buffer);
 			private:
 
 
@@ -86,7 +93,9 @@ namespace SB {
 				void SendListQueryResp(struct MM::ServerListQuery servers, const MM::sServerListReq list_req, bool usepopularlist = true, bool send_fullkeys = false);
 				
 				void sendServerData(MM::Server *server, bool usepopularlist, bool push, OS::Buffer *sendBuffer, bool full_keys = false, const std::map<std::string, int> *optimized_fields = NULL, bool no_keys = false, bool first_set = false);
-				void WriteOptimizedField(struct MM::ServerListQuery servers, std::string field_name, OS::Buffer &buffer, std::map<std::string, int> &field_types);
+				//serializes the server without sending it, returns false if it has no address to send
+				static bool WriteServerData(MM::Server *server, OS::Buffer *buffer, bool usepopularlist, bool full_keys, const std::map<std::string, int> *optimized_fields, bool no_keys, const std::vector<std::string> &field_list);
+				void WriteOptimizedField(const struct MM::ServerListQuery &servers, std::string field_name, OS::Buffer &buffer, std::map<std::string, int> &field_types);
 				void SendPushKeys();
 				void send_error(bool die, const char *fmt, ...);
 
@@ -35,6 +35,9 @@ class GameService(BaseService):
         self.redis_game_ctx.hset("{}:{}".format(new_data["gamename"],new_data["id"]), "queryport", new_data["queryport"])
         self.redis_game_ctx.hset("{}:{}".format(new_data["gamename"],new_data["id"]), "disabled_services", new_data["disabledservices"])
 
+        #servers keep every game in memory, this reloads it there
+        self.redis_game_ctx.publish("gamemaster.games", "\\update\\{}:{}".format(new_data["gamename"],new_data["id"]))
+
     def sync_group_to_redis(self, new_data, old_data):
         new_game = Game.select().where(Game.id == new_data["gameid"]).get()
         old_game = Game.select().where(Game.id == old_data["gameid"]).get()